@@ -17,7 +17,10 @@
  ** \author Come Raczy
  **/
 #include "common/Debug.hh"
+#include "common/MemoryBudget.hh"
 #include "common/SystemCompatibility.hh"
+#include "common/TaskScheduler.hh"
+#include "io/MemoryFileStore.hh"
 #include "options/AlignOptions.hh"
 #include "package/InstallationPaths.hh"
 #include "reference/ReferenceMetadata.hh"
@@ -54,11 +57,13 @@ void align(const isaac::options::AlignOptions &options)
     {
         ISAAC_THREAD_CERR << "align: NUMA-aware memory management disabled." << std::endl;
     }
+    isaac::common::TaskScheduler::configure(options.jobs);
 
     const uint64_t availableMemory = options.memoryLimit * 1024 * 1024 * 1024;
     if (isaac::options::AlignOptions::memoryLimitUnlimited !=  options.memoryLimit)
     {
         ISAAC_THREAD_CERR << "align: Setting memory limit to " << availableMemory << " bytes." << std::endl;
+        isaac::common::MemoryBudget::configure(availableMemory);
         if (!isaac::common::ulimitV(availableMemory))
         {
             // We're the parent process in a fork and it's time to terminate;
@@ -67,6 +72,12 @@ void align(const isaac::options::AlignOptions &options)
         // We're the child process in a fork, just keep running.
     }
 
+    if (options.inMemoryBins)
+    {
+        ISAAC_THREAD_CERR << "align: Keeping up to " << options.inMemoryBins << " megabytes of bins in memory." << std::endl;
+        isaac::io::MemoryFileStore::configure(options.inMemoryBins * 1024 * 1024);
+    }
+
     isaac::workflow::AlignWorkflow workflow(
         options.argv,
         options.description,
@@ -128,11 +139,16 @@ void align(const isaac::options::AlignOptions &options)
         options.inputLoadersMax,
         options.tempSaversMax,
         options.tempLoadersMax,
+        options.tempLoadersAdaptive,
+        options.tempDirectIo,
         options.outputSaversMax,
         options.realignGaps,
         options.realignMapqMin,
         options.knownIndelsPath,
         options.bamGzipLevel,
+        options.outputFormat,
+        options.bamIndexFormat,
+        options.csiMinShift,
         options.bamPuFormat,
         options.bamProduceMd5,
         options.bamHeaderTags,
@@ -151,7 +167,9 @@ void align(const isaac::options::AlignOptions &options)
         options.fullBclQScoreTable,
         options.optionalFeatures,
         options.pessimisticMapQ,
-        options.detectTemplateBlockSize);
+        options.detectTemplateBlockSize,
+        options.reportsDuringBam,
+        options.fastqParallelExtraction);
 
     const boost::filesystem::path stateFilePath = options.tempDirectory / "AlignerState.txt";
 
@@ -28,8 +28,9 @@
 #include "alignment/BinMetadata.hh"
 #include "BinIndexMap.hh"
 #include "common/Memory.hh"
-#include "io/FileBufCache.hh"
+#include "common/MemoryBudget.hh"
 #include "io/Fragment.hh"
+#include "io/PooledFileWriter.hh"
 
 
 namespace isaac
@@ -174,6 +175,10 @@ private:
     static const unsigned CLUSTER_BINS_MAX = FRAGMENT_BINS_MAX * 2;
     // bytes to store before flushing
     static const std::size_t BUFFER_BYTES_MAX =  4096;
+    // bin files are not read until Build. Push them out to disk in windows of this size instead of keeping in page cache
+    static const std::size_t WRITE_BEHIND_BYTES = 8 * 1024 * 1024;
+    // every fragment in a full buffer starts with a header
+    static const std::size_t BUFFER_FRAGMENTS_MAX = BUFFER_BYTES_MAX / sizeof(io::FragmentHeader) + 1;
     static const unsigned UNMAPPED_BIN = -1U;
 
     static const unsigned READS_MAX = 2;
@@ -187,16 +192,32 @@ private:
     // Large number of mutexes is something to consider. In particular one mutex per file might be the best choice
     // Right now with mutex size of 40 bytes this keeps all of them in one page.
     boost::array<boost::mutex, 4096 / sizeof(boost::mutex)> binMutex_;
-    std::vector<io::FileBufWithReopen> files_;
+    // a bin file per unique bin path. Only a bounded number of them are open at any time
+    io::PooledFileWriter writer_;
+    std::size_t fileCount_;
     std::vector<int> binFiles_;
 
+    struct FileWriteStats
+    {
+        FileWriteStats() : firstBin_(0), bytes_(0), microseconds_(0){}
+        unsigned firstBin_;
+        uint64_t bytes_;
+        // time spent in flushing thread buffers into the file
+        uint64_t microseconds_;
+    };
+    // [file]. Protected by the same binMutex_ as the corresponding file
+    std::vector<FileWriteStats> fileStats_;
+
     typedef common::StaticVector<unsigned, CLUSTER_BINS_MAX> FragmentBins;
 
     // buffer writes on each thread so that the locking and random file writes are a lesser issue
     // guaranteed to fit the bin list, so overflows only on adding new fragments
     typedef common::StaticVector<char, BUFFER_BYTES_MAX + CLUSTER_BINS_MAX * sizeof(unsigned)> FileBuffer;
     typedef std::vector<FileBuffer> FileBuffers;
+    // fragments of a FileBuffer that go into the file
+    typedef common::StaticVector<iovec, BUFFER_FRAGMENTS_MAX> FilePieces;
     std::vector<FileBuffers> threadFileBuffers_;
+    common::MemoryReservation bufferMemory_;
 
     static void bufferBinIndexes(
         const FragmentBins &bins,
@@ -221,7 +242,7 @@ private:
         const io::FragmentAccessor &fragment,
         const BinIndexList &binIndexList,
         alignment::BinMetadataList &binMetadataList,
-        const unsigned fileIndex);
+        FilePieces &pieces);
 
     void flushBuffer(
         FileBuffer &buffer,
@@ -230,7 +251,6 @@ private:
 
     void getFragmentStorageBins(const io::FragmentAccessor &fragment, FragmentBins &bins);
 
-    void reopenBin(const BinMetadata &binMetadata, std::size_t file);
     void openBinFile(const BinMetadata &binMetadata, std::size_t file);
     void registerFragment(const io::FragmentAccessor& fragment,
                           const bool splitRead, BinMetadata& binMetadata);
@@ -0,0 +1,41 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BamIndexFormat.hh
+ **
+ ** Kinds of index produced alongside the bam files.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BAM_BAM_INDEX_FORMAT_HH
+#define iSAAC_BAM_BAM_INDEX_FORMAT_HH
+
+namespace isaac
+{
+namespace bam
+{
+
+/// Bit mask. Any combination of the formats can be produced in the same pass.
+enum BamIndexFormat
+{
+    BAM_INDEX_NONE = 0,
+    /// sorted.bam.bai. Contigs must not exceed 512 Mbp
+    BAM_INDEX_BAI = 1,
+    /// sorted.bam.csi with configurable min_shift and depth derived from the longest contig
+    BAM_INDEX_CSI = 2
+};
+
+} // namespace bam
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BAM_BAM_INDEX_FORMAT_HH
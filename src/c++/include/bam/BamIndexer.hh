@@ -22,12 +22,15 @@
 #define iSAAC_BAM_BAM_INDEXER_HH
 
 #include <fstream>
+#include <map>
 #include <vector>
 #include <boost/foreach.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 
+#include "bam/BamIndexFormat.hh"
 #include "common/Debug.hh"
 #include "build/FragmentAccessorBamAdapter.hh"
 
@@ -644,29 +647,113 @@ struct UnresolvedBinIndexChunk
     uint32_t  refId;
 };
 
-class BamIndexPart
+/**
+ * \brief Hierarchical binning shared by BAI and CSI. Level 0 has a single bin covering 1 << (minShift + 3 * depth)
+ *        bases, each next level splits the bins in 8. BAI is the special case of minShift 14 and depth 5.
+ */
+class BinningScheme
 {
-    static const uint32_t BAM_INDEXER_MAX_CHUNKS = BAM_MAX_BIN * MAX_CLUSTER_PER_INDEX_BIN;         
-    static const uint32_t BAM_MIN_CHUNK_GAP = 32768;
-
 public:
-    BamIndexPart();
-    void processFragment( const build::FragmentAccessorBamAdapter& alignment, uint32_t serializedLength );
+    static const unsigned BAI_MIN_SHIFT = 14;
+    static const unsigned BAI_DEPTH = 5;
+    // keeps the bin numbers of any realistic contig length within uint32_t
+    static const unsigned CSI_MIN_SHIFT_MAX = 32;
+
+    BinningScheme(const unsigned minShift = BAI_MIN_SHIFT, const unsigned depth = BAI_DEPTH) :
+        minShift_(minShift), depth_(depth){}
+
+    /**
+     * \return smallest depth at which the binning covers contigs of maxContigLength
+     */
+    static unsigned getDepth(const unsigned minShift, const uint64_t maxContigLength);
+
+    unsigned getMinShift() const {return minShift_;}
+    unsigned getDepth() const {return depth_;}
+    uint64_t getMaxContigLength() const {return 1UL << (minShift_ + depth_ * 3);}
+    /// bin that holds the mapped/unmapped statistics
+    uint32_t getPseudoBin() const {return ((1U << ((depth_ + 1) * 3)) - 1) / 7 + 1;}
+
+    /**
+     * \return smallest bin that fully contains [beg, end)
+     */
+    uint32_t reg2bin(const int64_t beg, int64_t end) const
+    {
+        --end;
+        unsigned shift = minShift_;
+        uint32_t levelOffset = ((1U << (depth_ * 3)) - 1) / 7;
+        for (unsigned level = depth_; level > 0; --level, shift += 3, levelOffset -= 1U << (level * 3))
+        {
+            if (beg >> shift == end >> shift)
+            {
+                return levelOffset + (beg >> shift);
+            }
+        }
+        return 0;
+    }
 
-//private:
-    void initStructures();
-    void addToBinIndexChunks( const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset, const uint32_t bin, const uint32_t refId );
-    void addToLinearIndex( const uint32_t pos, const UnresolvedOffset virtualOffset );
+    /**
+     * \return first linear index window covered by the bin
+     */
+    uint64_t getBinFirstWindow(const uint32_t bin) const
+    {
+        unsigned level = 0;
+        uint32_t levelOffset = 0;
+        while (level < depth_ && bin >= levelOffset + (1U << (level * 3)))
+        {
+            levelOffset += 1U << (level * 3);
+            ++level;
+        }
+        return uint64_t(bin - levelOffset) << ((depth_ - level) * 3);
+    }
 
+private:
+    unsigned minShift_;
+    unsigned depth_;
+};
 
-    UnresolvedOffset localUncompressedOffset_;
+/**
+ * \brief Bins and linear index of one binning scheme collected from a contiguous piece of uncompressed bam data
+ */
+struct BinningIndexPart
+{
+    BinningIndexPart(const BinningScheme &scheme, const uint64_t maxContigLength);
+
+    void addAlignment(
+        const uint32_t refId, const uint64_t pos, const uint32_t seqLen, const uint32_t observedLength,
+        const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset);
+
+    BinningScheme scheme_;
 
     // Bin index
     std::vector<UnresolvedBinIndexChunk> chunks_;
 
-    // Linear index
+    // Linear index, one entry per 1 << scheme_.getMinShift() bases
     std::vector< UnresolvedOffset > linearIndex_;
 
+private:
+    static const uint32_t BAM_INDEXER_MAX_CHUNKS = BAM_MAX_BIN * MAX_CLUSTER_PER_INDEX_BIN;
+    static const uint32_t BAM_MIN_CHUNK_GAP = 32768;
+
+    void addToBinIndexChunks( const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset, const uint32_t bin, const uint32_t refId );
+    void addToLinearIndex( const uint64_t pos, const UnresolvedOffset virtualOffset );
+};
+
+class BamIndex;
+
+class BamIndexPart
+{
+public:
+    /**
+     * \brief Creates the part that collects the index data for each of the formats produced by bamIndex
+     */
+    BamIndexPart(const BamIndex &bamIndex);
+    void processFragment( const build::FragmentAccessorBamAdapter& alignment, uint32_t serializedLength );
+
+    UnresolvedOffset localUncompressedOffset_;
+
+    // one per index file produced for the bam
+    std::vector<BinningIndexPart> binnings_;
+
     // Stats reported in last bin
     uint64_t bamStatsMapped_, bamStatsNmapped_;
 };
@@ -693,8 +780,16 @@ class BamIndex
 public:
     // Creates invalid object which is not to be used
     BamIndex();
-    // Creates proper object with output file attached
-    BamIndex(const boost::filesystem::path &bamPath, const uint32_t bamRefCount, const uint32_t bamHeaderCompressedLength);
+    /**
+     * \brief Creates proper object with output files attached
+     *
+     * \param format            combination of BamIndexFormat values. BAI is skipped with a warning when
+     *                          maxContigLength exceeds what it can address
+     * \param csiMinShift       size of the smallest CSI bin and linear index window is 1 << csiMinShift
+     * \param maxContigLength   length of the longest contig in the bam header
+     */
+    BamIndex(const boost::filesystem::path &bamPath, const uint32_t bamRefCount, const uint32_t bamHeaderCompressedLength,
+             const unsigned format, const unsigned csiMinShift, const uint64_t maxContigLength);
     void processIndexPart(const bam::BamIndexPart &bamIndexPart,
                           const BgzfBuffer &bgzfBuffer);
 
@@ -703,35 +798,54 @@ public:
         outputIndexFile();
     }
 
+    uint64_t getMaxContigLength() const {return maxContigLength_;}
+    const std::vector<BinningScheme> &getSchemes() const {return schemes_;}
+
 private:
-    void initStructures();
+    /**
+     * \brief Merged bins and linear index of a single index file. CSI files are bgzf-compressed.
+     */
+    struct Binning
+    {
+        Binning(const BinningScheme &scheme, const bool csi, const boost::filesystem::path &path);
+
+        const BinningScheme scheme_;
+        const bool csi_;
+        const boost::filesystem::path path_;
+        std::ofstream file_;
+        boost::iostreams::filtering_ostream stream_;
+
+        // Bin index. Sparse as CSI may have millions of bins
+        std::map<uint32_t, std::vector< VirtualOffsetPair > > binIndex_;
+
+        // Linear index
+        std::vector< VirtualOffset > linearIndex_;
+
+        void write(const void *data, const std::size_t bytes);
+    };
+
     void outputIndexFile();
-    void outputBaiHeader();
-    void outputBaiFooter();
-    void outputBaiChromosomeIndex();
+    void outputHeader(Binning &binning);
+    void outputFooter(Binning &binning);
+    void outputChromosomeIndex(Binning &binning);
+    void outputChromosomeIndex();
 
     void printBgzfInfo( const BgzfBuffer bgzfBuffer );
     void printBamIndexPartInfo( const bam::BamIndexPart &bamIndexPart );
 
-    void mergeBinIndex( const std::vector<UnresolvedBinIndexChunk>& binIndexChunks, const BgzfBuffer &bgzfBuffer );
-    void mergeLinearIndex( const std::vector<UnresolvedOffset>& linearIndexToMerge, const BgzfBuffer &bgzfBuffer );
-    void addToBinIndex( const UnresolvedBinIndexChunk& chunk, const BgzfBuffer &bgzfBuffer );
+    void mergeBinIndex( Binning &binning, const std::vector<UnresolvedBinIndexChunk>& binIndexChunks, const BgzfBuffer &bgzfBuffer );
+    void mergeLinearIndex( Binning &binning, const std::vector<UnresolvedOffset>& linearIndexToMerge, const BgzfBuffer &bgzfBuffer );
+    void addToBinIndex( Binning &binning, const UnresolvedBinIndexChunk& chunk, const BgzfBuffer &bgzfBuffer );
     void clearStructures();
     void resetBgzfParsing();
     VirtualOffset resolveOffset(UnresolvedOffset unresolvedPos, const BgzfBuffer &bgzfBuffer);
 
     uint32_t bamRefCount_;
     uint32_t lastProcessedRefId_;
-    std::ofstream baiStream_;
+    uint64_t maxContigLength_;
 
-    // Bin index
-    std::vector< std::vector< VirtualOffsetPair > > binIndex_;
-    // As binIndex_ might have quite a few entries, speed up cleanup and counting by tracking whether
-    // anything has been put into it with binIndexEmpty_
-    bool binIndexEmpty_;
-
-    // Linear index
-    std::vector< VirtualOffset > linearIndex_;
+    std::vector<BinningScheme> schemes_;
+    boost::ptr_vector<Binning> binnings_;
 
     // Stats reported in last bin
     uint64_t bamStatsMapped_, bamStatsNmapped_, bamStatsGlobalNoCoordinates_;
@@ -268,8 +268,8 @@ public:
 
     template <typename CollectorT>
     bool parse(
-        std::vector<char>::const_iterator &uncompressedIt,
-        std::vector<char>::const_iterator uncompressedEnd,
+        const char *&uncompressedIt,
+        const char *uncompressedEnd,
         CollectorT &collector)
     {
         bool moreDataNeeded = true;
@@ -289,7 +289,7 @@ public:
             {
                 while(uncompressedEnd != uncompressedIt)
                 {
-                    std::vector<char>::const_iterator last = uncompressedIt;
+                    const char *last = uncompressedIt;
                     moreDataNeeded = parseBamRecord(uncompressedIt, uncompressedEnd, collector);
                     if(!moreDataNeeded || last == uncompressedIt)
                     {
@@ -307,21 +307,21 @@ public:
 
 private:
     bool skipHeader(
-        std::vector<char>::const_iterator &it,
-        std::vector<char>::const_iterator end);
+        const char *&it,
+        const char *end);
 
     bool skipReferences(
-        std::vector<char>::const_iterator &it,
-        std::vector<char>::const_iterator end);
+        const char *&it,
+        const char *end);
 
     template <typename ProcessorT>
     bool parseBamRecord(
-        std::vector<char>::const_iterator &it,
-        std::vector<char>::const_iterator end,
+        const char *&it,
+        const char *end,
         ProcessorT &process)
     {
         static const unsigned BLOCK_SIZE_WIDTH = 4;
-        const std::vector<char>::const_iterator blockIt = it;
+        const char *blockIt = it;
         int block_size = 0;
         if (std::size_t(std::distance(it, end)) < BLOCK_SIZE_WIDTH)
         {
@@ -337,7 +337,7 @@ private:
         }
 
         ISAAC_ASSERT_MSG(block_size >= int(sizeof(BamBlockHeader)), "bam record size is smaller than the minimum required block_size:" << block_size << " sizeof(BamBlockHeader):" << sizeof(BamBlockHeader));
-        const BamBlockHeader &block = *reinterpret_cast<const BamBlockHeader *>(&*it - BLOCK_SIZE_WIDTH);
+        const BamBlockHeader &block = *reinterpret_cast<const BamBlockHeader *>(it - BLOCK_SIZE_WIDTH);
 
         const bool lastBlock = std::size_t(std::distance(it + block_size, end)) <= BLOCK_SIZE_WIDTH ||
             std::distance(it + block_size + BLOCK_SIZE_WIDTH, end) < (common::extractLittleEndian<unsigned>(it + block_size));
@@ -0,0 +1,135 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramEncoder.hh
+ **
+ ** \brief Filtering stream that turns uncompressed bam data into CRAM 3.0 containers. Can be used in place of
+ **        BgzfCompressor.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BAM_CRAM_ENCODER_HH
+#define iSAAC_BAM_CRAM_ENCODER_HH
+
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "io/Cram.hh"
+
+namespace isaac
+{
+namespace bam
+{
+
+namespace bios=boost::iostreams;
+
+/**
+ * \brief Consumes the bam header and bam records the way serializeHeader and serializeAlignment produce them.
+ *        The bam header is turned into the CRAM file definition and SAM header container. The records are
+ *        collected into single-slice containers, one reference per container, and encoded against the reference
+ *        bases. Containers are emitted as soon as they are complete and on flush.
+ *
+ * The data series all go into their own gzip-compressed external blocks. Read names, mate information and
+ * quality scores are preserved. Each copy of the encoder starts with empty buffers, just like BgzfCompressor does.
+ */
+class CramEncoder
+{
+public:
+    typedef char char_type;
+    struct category : bios::multichar_output_filter_tag , bios::flushable_tag {};
+
+    static const unsigned RECORDS_PER_CONTAINER = 10000;
+    // rough upper bound of the container, compression header and slice header block bytes
+    static const unsigned CONTAINER_OVERHEAD = 4096;
+
+    /**
+     * \param references  reference sequences in the order of bam refId. Must stay valid while the encoder is
+     *                    in use.
+     */
+    CramEncoder(const io::cram::References &references, const int gzipLevel);
+    CramEncoder(const CramEncoder &that);
+
+    template <typename Sink>
+    std::streamsize write(Sink &snk, const char* s, std::streamsize n);
+
+    void close() {}
+
+    template<typename Sink>
+    bool flush(Sink& snk);
+
+private:
+    const io::cram::References *references_;
+    const int gzipLevel_;
+    // uncompressed bam data not yet encoded
+    std::vector<char> pending_;
+    // offset of the first record in pending_ that has not been scanned yet
+    std::size_t scanned_;
+    // complete records among the scanned ones
+    unsigned scannedRecords_;
+    int32_t scannedRefId_;
+    int64_t recordCounter_;
+    // encoded data ready to go into the sink
+    std::vector<char> encoded_;
+
+    /**
+     * \brief Encodes whatever complete containers are available in pending_ into encoded_.
+     *
+     * \param flush if true, all complete records are encoded even if there are not enough of them to fill a
+     *              container
+     */
+    void encode(const bool flush);
+    bool encodeHeader();
+    void encodeContainer(const char *begin, const char *end, const unsigned records);
+
+    template<typename Sink>
+    bool writeEncoded(Sink& snk);
+};
+
+template <typename Sink>
+std::streamsize CramEncoder::write(Sink &snk, const char* s, std::streamsize n)
+{
+    pending_.insert(pending_.end(), s, s + n);
+    encode(false);
+    return writeEncoded(snk) ? n : 0;
+}
+
+template<typename Sink>
+bool CramEncoder::flush(Sink& snk)
+{
+    encode(true);
+    return writeEncoded(snk);
+}
+
+template<typename Sink>
+bool CramEncoder::writeEncoded(Sink& snk)
+{
+    if (!encoded_.empty())
+    {
+        if (std::streamsize(encoded_.size()) != bios::write(snk, &encoded_.front(), encoded_.size()))
+        {
+            return false;
+        }
+        encoded_.clear();
+    }
+    return true;
+}
+
+/**
+ * \brief Writes the CRAM end of file container
+ */
+void serializeCramFooter(std::ostream &os);
+
+} // namespace bam
+} // namespace isaac
+
+
+#endif // iSAAC_BAM_CRAM_ENCODER_HH
@@ -0,0 +1,63 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramIndexer.hh
+ **
+ ** \brief Produces the crai index of the cram file from the containers being written into it
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BAM_CRAM_INDEXER_HH
+#define iSAAC_BAM_CRAM_INDEXER_HH
+
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace isaac
+{
+namespace bam
+{
+
+/**
+ * \brief Writes one line per slice into gzip-compressed cramPath.crai. The data given to processContainers must
+ *        be the complete containers in the order in which they follow the cram header in the file.
+ */
+class CramIndex : boost::noncopyable
+{
+public:
+    /// Index that ignores everything
+    CramIndex();
+    /**
+     * \param headerLength  bytes of the file definition and SAM header container preceding the data containers
+     */
+    CramIndex(const boost::filesystem::path &cramPath, const uint64_t headerLength);
+
+    void processContainers(const char *begin, const char *end);
+
+    void flush();
+
+private:
+    boost::filesystem::path path_;
+    std::ofstream file_;
+    boost::iostreams::filtering_ostream stream_;
+    // file offset of the next container
+    uint64_t offset_;
+};
+
+} // namespace bam
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BAM_CRAM_INDEXER_HH
@@ -0,0 +1,158 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfInflatePipeline.hh
+ **
+ ** \brief Reads and inflates bgzf file into a ring of buffers ahead of the client.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BGZF_BGZF_INFLATE_PIPELINE_HH
+#define iSAAC_BGZF_BGZF_INFLATE_PIPELINE_HH
+
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "bgzf/BgzfReader.hh"
+#include "io/FileBufWithReopen.hh"
+
+namespace isaac
+{
+namespace bgzf
+{
+
+/**
+ * \brief One reader thread splits the compressed stream into batches of bgzf blocks. Inflater threads decompress
+ *        the batches straight into their final location in the ring of buffers. The client receives complete
+ *        buffers in file order and parses them in place.
+ *
+ * Each buffer has headroom in front of the uncompressed data that the client is free to use for the data carried
+ * over from the previous buffer.
+ *
+ * The way data is split between buffers depends only on the bgzf block sizes and the buffer capacity, not on the
+ * number of threads.
+ *
+ * All buffers and threads are allocated by the constructor.
+ */
+class BgzfInflatePipeline : boost::noncopyable
+{
+public:
+    struct Buffer
+    {
+        Buffer() : data_(0), headroom_(0), end_(0), pendingBatches_(0), sealed_(false), free_(true) {}
+        /// first byte of the headroom
+        char *data_;
+        /// first byte of the uncompressed data
+        char *begin() const {return data_ + headroom_;}
+        /// end of the uncompressed data
+        char *end() const {return data_ + headroom_ + end_;}
+
+    private:
+        friend class BgzfInflatePipeline;
+        std::size_t headroom_;
+        // bytes of uncompressed data assigned to the buffer so far
+        std::size_t end_;
+        // batches assigned to the buffer and not yet inflated
+        unsigned pendingBatches_;
+        // no more batches will be assigned to the buffer
+        bool sealed_;
+        // neither filled by the pipeline, nor held by the client
+        bool free_;
+    };
+
+    BgzfInflatePipeline(
+        const unsigned inflatersCount,
+        const unsigned buffersCount,
+        const std::size_t bufferCapacity,
+        const std::size_t headroom,
+        const unsigned blocksPerBatch);
+
+    ~BgzfInflatePipeline();
+
+    /**
+     * \brief Stops processing the previous file if any, releases all buffers and starts reading filePath
+     */
+    void open(const boost::filesystem::path &filePath);
+
+    /**
+     * \brief Waits for the next buffer in the file order
+     *
+     * \return 0 at the end of file. The buffer stays valid until released.
+     */
+    Buffer *next();
+
+    /**
+     * \brief Returns the buffer to the pipeline. Buffers must be released in the order they were received.
+     */
+    void release(Buffer &buffer);
+
+private:
+    struct Batch
+    {
+        Batch() : compressedSize_(0), uncompressedSize_(0), buffer_(0), offset_(0) {}
+        std::vector<char> compressed_;
+        std::size_t compressedSize_;
+        std::size_t uncompressedSize_;
+        Buffer *buffer_;
+        // offset of the uncompressed data within the buffer
+        std::size_t offset_;
+    };
+
+    const std::size_t bufferCapacity_;
+    const unsigned blocksPerBatch_;
+    std::unique_ptr<char[]> memory_;
+    std::vector<Buffer> buffers_;
+    std::vector<Batch> batches_;
+    std::vector<Batch *> freeBatches_;
+    std::vector<Batch *> inflateQueue_;
+    std::vector<BgzfReader> inflaters_;
+
+    io::FileBufWithReopen fileBuffer_;
+    std::istream is_;
+    // block read that did not fit into the buffer being filled
+    std::vector<char> carryBlock_;
+    std::size_t carryBlockSize_;
+    unsigned carryUncompressedSize_;
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool terminate_;
+    // reader thread is allowed to read
+    bool reading_;
+    // reader thread is reading outside of the lock
+    bool readerBusy_;
+    // batches being inflated outside of the lock
+    unsigned inflatersBusy_;
+    bool eof_;
+    std::exception_ptr error_;
+    unsigned fillBuffer_;
+    unsigned nextBuffer_;
+
+    // must be initialized last as the threads start straight away
+    boost::thread_group threads_;
+
+    void stop(boost::unique_lock<boost::mutex> &lock);
+    std::size_t readBatch(Batch &batch, const std::size_t bufferBytesLeft, bool &bufferFull);
+    void readerThread();
+    void inflaterThread(BgzfReader &inflater);
+};
+
+} // namespace bgzf
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BGZF_BGZF_INFLATE_PIPELINE_HH
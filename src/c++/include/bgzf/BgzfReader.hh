@@ -70,6 +70,17 @@ public:
     }
     unsigned readNextBlock(std::istream &is);
     void uncompressCurrentBlock(char* p, const std::size_t size);
+    /**
+     * \brief Inflates a sequence of bgzf blocks into p. size must be the total of their ISIZE fields
+     */
+    void uncompress(const char *compressed, const std::size_t compressedSize, char* p, const std::size_t size);
+
+    /**
+     * \brief Reads one bgzf block into block which must have room for COMPRESSED_BGZF_BLOCK_SIZE bytes
+     *
+     * \return number of bytes read or 0 when the end of stream is reached
+     */
+    static std::size_t readBlock(std::istream &is, char *block, unsigned &uncompressedSize);
 
     void reserveBuffers()
     {
@@ -86,7 +86,6 @@ public:
             realignMapqMin_(realignMapqMin),
             knownIndels_(knownIndels),
             realignerGaps_(getGapGroupsCount()),
-            inputFileBuf_(),
             bamAdapter_(
                 maxReadLength, tileMetadataList, barcodeMetadataList,
                 contigMap, contigLists, forcedDodgyAlignmentScore, flowCellLayoutList, includeTags, pessimisticMapQ,
@@ -135,13 +134,6 @@ public:
         // that in reality split deletions are harder to detect than regular ones.
         
         splitInfoList_.reserve(bin_.getEstimatedSplitCount(REALIGN_NONE != realignGaps_) * 2);
-
-        // summarize chunk sizes to get offsets
-        if (!inputFileBuf_.open(bin_.getPathString().c_str(), std::ios_base::binary|std::ios_base::in))
-        {
-            BOOST_THROW_EXCEPTION(
-                common::IoException(errno, (boost::format("Failed to open file %s: %s") % bin_.getPathString() % strerror(errno)).str()));
-        }
     }
 
     void finalize();
@@ -189,7 +181,6 @@ public:
 
     SplitInfoList splitInfoList_;
     std::vector<gapRealigner::RealignerGaps> realignerGaps_;
-    std::filebuf inputFileBuf_;
     FragmentAccessorBamAdapter bamAdapter_;
 
 private:
@@ -29,6 +29,8 @@
 #include "alignment/BinMetadata.hh"
 #include "build/FragmentIndex.hh"
 #include "build/BinData.hh"
+#include "io/AsyncFileReader.hh"
+#include "io/MemoryFileStore.hh"
 
 namespace isaac
 {
@@ -38,16 +40,32 @@ namespace build
 class BinLoader
 {
 public:
-    BinLoader()
+    /**
+     * \param reader   reader to use for the bin file. Counters of the reader describe the last loadData
+     */
+    BinLoader(io::AsyncFileReader &reader) : reader_(reader), inMemory_(false)
     {
     }
 
     void loadData(BinData &data);
 
 private:
+    io::AsyncFileReader &reader_;
+    // bin files that the aligner kept in memory are read from there instead of reader_
+    io::MemoryFileStore::Reader memoryReader_;
+    bool inMemory_;
+
+    void open(const alignment::BinMetadata &bin, const uint64_t bytes);
+    std::size_t read(char *buffer, const std::size_t bytes)
+    {
+        return inMemory_ ? memoryReader_.read(buffer, bytes) : reader_.read(buffer, bytes);
+    }
+    void close();
+    uint64_t tell() const {return inMemory_ ? memoryReader_.tell() : reader_.tell();}
+
     void loadUnalignedData(BinData &binData);
     void loadAlignedData(BinData &binData);
-    std::size_t loadFragment(BinData &binData, std::istream &isData);
+    std::size_t loadFragment(BinData &binData);
     void storeFragmentIndex(const io::FragmentAccessor& mateFragment,
                             uint64_t mateOffset, uint64_t offset,
                             BinData& binData);
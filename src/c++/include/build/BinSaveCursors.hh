@@ -0,0 +1,84 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BinSaveCursors.hh
+ **
+ ** \brief Tracks the next bin to be written into each Build output file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_BIN_SAVE_CURSORS_HH
+#define iSAAC_BUILD_BIN_SAVE_CURSORS_HH
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "alignment/BinMetadata.hh"
+
+namespace isaac
+{
+namespace build
+{
+
+/**
+ * \brief One cursor per output file pointing at the next bin that file expects.
+ *
+ * Each output file receives the bins in order, but the files don't wait for each other: a thread that
+ * has finished a bin can write it into any file whose cursor has reached that bin.
+ *
+ * Not thread safe. Build calls it under its state mutex.
+ */
+class BinSaveCursors
+{
+public:
+    typedef alignment::BinMetadataCRefList::const_iterator BinIterator;
+
+    BinSaveCursors(
+        const std::size_t fileCount,
+        const BinIterator binsBegin,
+        const BinIterator binsEnd);
+
+    std::size_t getFileCount() const {return nextUnsavedBinIts_.size();}
+
+    /**
+     * \brief Waits until one of the files not yet in savedFiles is ready to receive binIt data
+     *
+     * \return index of the output file that can be saved
+     */
+    std::size_t waitForSlot(
+        boost::unique_lock<boost::mutex> &lock,
+        boost::condition_variable &stateChangedCondition,
+        const bool &forceTermination,
+        const BinIterator binIt,
+        const std::vector<bool> &savedFiles) const;
+
+    /**
+     * \brief Moves the cursor of fileIndex past the bins that have just been written into it
+     */
+    void returnSlot(const std::size_t fileIndex, const BinIterator binsEndIt);
+
+    bool allSaved() const;
+
+private:
+    const BinIterator binsEnd_;
+    // [output file], position of a bin in binRefs_ for each output file
+    std::vector<BinIterator> nextUnsavedBinIts_;
+
+    std::size_t findReady(const BinIterator binIt, const std::vector<bool> &savedFiles) const;
+};
+
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_BIN_SAVE_CURSORS_HH
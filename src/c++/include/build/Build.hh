@@ -20,6 +20,8 @@
 #ifndef iSAAC_BUILD_BUILD_HH
 #define iSAAC_BUILD_BUILD_HH
 
+#include <chrono>
+
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -27,14 +29,21 @@
 
 #include "demultiplexing/BarcodePathMap.hh"
 #include "alignment/BinMetadata.hh"
+#include "bam/CramIndexer.hh"
 #include "alignment/TemplateLengthStatistics.hh"
+#include "build/BinSaveCursors.hh"
 #include "build/BinSorter.hh"
 #include "build/BuildStats.hh"
 #include "build/BuildContigMap.hh"
+#include "build/ConcurrencyBalancer.hh"
+#include "build/OutputFormat.hh"
+#include "common/MemoryBudget.hh"
 #include "common/Threads.hpp"
 #include "flowcell/BarcodeMetadata.hh"
 #include "flowcell/Layout.hh"
 #include "flowcell/TileMetadata.hh"
+#include "io/AsyncFileReader.hh"
+#include "io/Cram.hh"
 #include "io/FileSinkWithMd5.hh"
 #include "reference/ReferenceMetadata.hh"
 #include "reference/SortedReferenceMetadata.hh"
@@ -63,6 +72,10 @@ class Build
     std::vector<unsigned> computeSlotWaitingBins_;
     const unsigned maxSavers_;
     const int bamGzipLevel_;
+    const OutputFormat outputFormat_;
+    // combination of bam::BamIndexFormat values
+    const unsigned bamIndexFormat_;
+    const unsigned csiMinShift_;
     const std::string &bamPuFormat_;
     const bool bamProduceMd5_;
     const std::vector<std::string> &bamHeaderTags_;
@@ -86,6 +99,8 @@ class Build
     boost::mutex stateMutex_;
     boost::condition_variable stateChangedCondition_;
     bool forceTermination_;
+    const std::chrono::steady_clock::time_point startTime_;
+    ConcurrencyBalancer concurrencyBalancer_;
 
     common::ThreadVector threads_;
 
@@ -93,8 +108,12 @@ class Build
 
     //pair<[barcode], [output file]>, first maps barcode indexes to unique paths in second
     demultiplexing::BarcodePathMap barcodeBamMapping_;
+    //[output file], reference contigs in the order of bam header. Empty unless the output is cram
+    std::vector<io::cram::References> cramReferences_;
     //[output file], one stream per bam file path
     boost::ptr_vector<bam::BamIndex> bamIndexes_;
+    //[output file], crai indexes. Don't do anything unless the output is cram
+    boost::ptr_vector<bam::CramIndex> cramIndexes_;
     std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > bamFileStreams_;
 
     BuildStats stats_;
@@ -106,6 +125,12 @@ class Build
     // Geometry: [thread][bam file]. Streams for compressing bam data into threadBgzfBuffers_
     boost::ptr_vector<boost::ptr_vector<boost::iostreams::filtering_ostream> > threadBgzfStreams_;
     boost::ptr_vector<boost::ptr_vector<bam::BamIndexPart> > threadBamIndexParts_;
+    // Geometry: [thread]. Budget taken by the bin data and by the bgzf buffers of the bin the thread processes
+    boost::ptr_vector<common::MemoryReservation> threadBinMemory_;
+    boost::ptr_vector<common::MemoryReservation> threadBgzfMemory_;
+    // one reader per load slot that can exist at a time. Taken with the load slot and returned with it
+    boost::ptr_vector<io::AsyncFileReader> binReaders_;
+    std::vector<io::AsyncFileReader *> freeBinReaders_;
 
     const build::gapRealigner::Gaps knownIndels_;
     ParallelGapRealigner gapRealigner_;
@@ -143,10 +168,15 @@ public:
           const unsigned maxLoaders,
           const unsigned maxComputers,
           const unsigned maxSavers,
+          const bool adaptiveConcurrency,
+          const bool directIo,
           const build::GapRealignerMode realignGaps,
           const unsigned realignMapqMin,
           const boost::filesystem::path &knownIndelsPath,
           const int bamGzipLevel,
+          const OutputFormat outputFormat,
+          const unsigned bamIndexFormat,
+          const unsigned csiMinShift,
           const std::string &bamPuFormat,
           const bool bamProduceMd5,
           const std::vector<std::string> &bamHeaderTags,
@@ -182,10 +212,14 @@ public:
 
     const demultiplexing::BarcodePathMap &getBarcodeBamMapping() const {return barcodeBamMapping_;}
 private:
+    std::vector<io::cram::References> createCramReferences(
+        const flowcell::BarcodeMetadataList &barcodeMetadataList) const;
+
     std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> >  createOutputFileStreams(
         const flowcell::TileMetadataList &tileMetadataList,
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
-        boost::ptr_vector<bam::BamIndex> &bamIndexes) const;
+        boost::ptr_vector<bam::BamIndex> &bamIndexes,
+        boost::ptr_vector<bam::CramIndex> &cramIndexes) const;
 
     void reserveBuffers(
         boost::unique_lock<boost::mutex> &lock,
@@ -210,6 +244,7 @@ private:
     bool handleBinAllocationFailure(
         bool warningTraced,
         const alignment::BinMetadata &bin,
+        const unsigned binStatsIndex,
         const ExceptionType  &e,
         const ExceptionDataT &errorData);
 
@@ -222,13 +257,18 @@ private:
         common::ScopedMallocBlock &mallocBlock,
         const std::size_t threadNumber);
 
-    void waitForLoadSlot(
+    io::AsyncFileReader &waitForLoadSlot(
         boost::unique_lock<boost::mutex> &lock,
         const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
         const alignment::BinMetadataCRefList::const_iterator binsEnd,
-        alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt);
+        alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt,
+        BinTimeline &timeline);
+
+    void returnLoadSlot(const bool exceptionUnwinding, io::AsyncFileReader &binReader);
+
+    uint64_t getElapsedMicroseconds() const;
 
-    void returnLoadSlot(const bool exceptionUnwinding);
+    void balanceConcurrency(const alignment::BinMetadataCRefList::const_iterator nextUnloadedBinIt);
 
     bool yieldIfPossible(
         boost::unique_lock<boost::mutex>& lock,
@@ -247,26 +287,25 @@ private:
 
     void returnComputeSlot(const bool exceptionUnwinding);
 
-    void waitForSaveSlot(
-        boost::unique_lock<boost::mutex> &lock,
-        const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
-        alignment::BinMetadataCRefList::const_iterator &nextUnserializedBinIt);
-
     void returnSaveSlot(
-        alignment::BinMetadataCRefList::const_iterator &nextUnserializedBinIt,
+        BinSaveCursors &saveCursors,
+        const std::size_t fileIndex,
         const alignment::BinMetadataCRefList::const_iterator thisThreadBinEndIt,
         const bool exceptionUnwinding);
 
     void sortBinParallel(alignment::BinMetadataCRefList::iterator &nextUnprocessedBinIt,
                          alignment::BinMetadataCRefList::const_iterator &nextUnallocatedBinIt,
                          alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt,
-                         alignment::BinMetadataCRefList::const_iterator &nextUnserializedBinIt,
+                         BinSaveCursors &saveCursors,
                          common::ScopedMallocBlock &mallocBlock,
                          const std::size_t threadNumber);
 
     void saveAndReleaseBuffers(
         boost::unique_lock<boost::mutex> &lock,
-        const boost::filesystem::path &filePath,
+        const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
+        const alignment::BinMetadataCRefList::const_iterator thisThreadBinsEndIt,
+        BinSaveCursors &saveCursors,
+        BinTimeline &timeline,
         const std::size_t threadNumber);
 
     void saveBuffer(
@@ -274,6 +313,7 @@ private:
         std::ostream &bamStream,
         const bam::BamIndexPart &bamIndexPart,
         bam::BamIndex &bamIndex,
+        bam::CramIndex &cramIndex,
         const boost::filesystem::path &filePath);
 
     uint64_t estimateBinCompressedDataRequirements(
@@ -47,6 +47,59 @@ inline const BinBarcodeStats operator +(BinBarcodeStats left, const BinBarcodeSt
     return left;
 }
 
+/**
+ * \brief Wall clock times of bin processing stages in microseconds since the start of Build.
+ *        Zero means the stage has not been reached.
+ */
+struct BinTimeline
+{
+    BinTimeline() :
+        allocateStart_(0), allocateEnd_(0), loadStart_(0), loadEnd_(0),
+        computeStart_(0), computeEnd_(0), saveStart_(0), saveEnd_(0),
+        loadSlotStall_(0), saveSlotStall_(0), allocationFailures_(0), loadedBytes_(0), loadIoWait_(0){}
+    uint64_t allocateStart_;
+    uint64_t allocateEnd_;
+    uint64_t loadStart_;
+    uint64_t loadEnd_;
+    uint64_t computeStart_;
+    uint64_t computeEnd_;
+    uint64_t saveStart_;
+    uint64_t saveEnd_;
+    /// time spent waiting for a load slot after the bin became next in line for loading
+    uint64_t loadSlotStall_;
+    /// time spent waiting for the preceding bins to be saved
+    uint64_t saveSlotStall_;
+    /// number of times handleBinAllocationFailure was called for the bin
+    unsigned allocationFailures_;
+    uint64_t loadedBytes_;
+    /// time the loader spent waiting for the read-ahead to deliver the data
+    uint64_t loadIoWait_;
+
+    bool processed() const {return saveEnd_;}
+};
+
+/**
+ * \brief Records the adjustment of concurrency limits made during Build
+ */
+struct ConcurrencyChange
+{
+    ConcurrencyChange(
+        const uint64_t time,
+        const unsigned loadSlots,
+        const unsigned computeSlots,
+        const uint64_t loadThroughput,
+        const char *reason) :
+            time_(time), loadSlots_(loadSlots), computeSlots_(computeSlots),
+            loadThroughput_(loadThroughput), reason_(reason){}
+    uint64_t time_;
+    unsigned loadSlots_;
+    unsigned computeSlots_;
+    /// bytes per second loaded during the observation window that prompted the change
+    uint64_t loadThroughput_;
+    /// static string
+    const char *reason_;
+};
+
 inline unsigned highestBinIndex(const alignment::BinMetadataCRefList &binMetadataList)
 {
     unsigned ret = 0;
@@ -65,8 +118,12 @@ public:
         const alignment::BinMetadataCRefList &binMetadataList,
         const flowcell::BarcodeMetadataList &barcodeMetadataList) :
             barcodeMetadataList_(barcodeMetadataList),
-            binBarcodeStats_(barcodeMetadataList_.size() * binMetadataList.size())
+            binBarcodeStats_(barcodeMetadataList_.size() * binMetadataList.size()),
+            binTimelines_(binMetadataList.size()),
+            allocationFailures_(0)
     {
+        // one initial record plus at most one change per loaded bin. Avoids allocations under memory control
+        concurrencyChanges_.reserve(binMetadataList.size() + 1);
     }
 
     void incrementTotalFragments(
@@ -97,6 +154,38 @@ public:
         return binBarcodeStats_.at(binBarcodeIndex(binIndex, barcodeIndex)).uniqueFragments_;
     }
 
+    BinTimeline &binTimeline(const unsigned binIndex)
+    {
+        return binTimelines_.at(binIndex);
+    }
+
+    const BinTimeline &getBinTimeline(const unsigned binIndex) const
+    {
+        return binTimelines_.at(binIndex);
+    }
+
+    void incrementAllocationFailures(const unsigned binIndex)
+    {
+        ++binTimelines_.at(binIndex).allocationFailures_;
+        ++allocationFailures_;
+    }
+
+    uint64_t getAllocationFailures() const
+    {
+        return allocationFailures_;
+    }
+
+    void addConcurrencyChange(const ConcurrencyChange &change)
+    {
+        ISAAC_ASSERT_MSG(concurrencyChanges_.size() < concurrencyChanges_.capacity(), "Unexpected number of concurrency changes");
+        concurrencyChanges_.push_back(change);
+    }
+
+    const std::vector<ConcurrencyChange> &getConcurrencyChanges() const
+    {
+        return concurrencyChanges_;
+    }
+
     BuildStats &operator +=(const BuildStats &right)
     {
         std::transform(binBarcodeStats_.begin(), binBarcodeStats_.end(),
@@ -106,12 +195,18 @@ public:
 
     BuildStats & operator =(const BuildStats &that) {
         binBarcodeStats_ = that.binBarcodeStats_;
+        binTimelines_ = that.binTimelines_;
+        concurrencyChanges_ = that.concurrencyChanges_;
+        allocationFailures_ = that.allocationFailures_;
         return *this;
     }
 
 private:
     const flowcell::BarcodeMetadataList &barcodeMetadataList_;
     std::vector<BinBarcodeStats>  binBarcodeStats_;
+    std::vector<BinTimeline> binTimelines_;
+    std::vector<ConcurrencyChange> concurrencyChanges_;
+    uint64_t allocationFailures_;
 
     unsigned binBarcodeIndex(const unsigned binIndex, const unsigned barcodeIndex) const
     {
@@ -0,0 +1,117 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ConcurrencyBalancer.hh
+ **
+ ** \brief Decides how to split Build threads between loading and computing based on observed timings.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_CONCURRENCY_BALANCER_HH
+#define iSAAC_BUILD_CONCURRENCY_BALANCER_HH
+
+#include <cstdint>
+
+namespace isaac
+{
+namespace build
+{
+
+/**
+ * \brief Observes bin load and compute timings and suggests moving a thread slot between load and compute.
+ *
+ * Slots are moved towards loading while loading is the bottleneck and more concurrent loads keep improving
+ * the aggregate load throughput. Once throughput stops improving, the last move is reverted and the number of load
+ * slots is capped so that the storage is not overloaded again. Slots are returned to compute when computing
+ * becomes the bottleneck.
+ *
+ * Not thread safe. Build calls it under its state mutex.
+ */
+class ConcurrencyBalancer
+{
+public:
+    enum Decision
+    {
+        Keep = 0,
+        MoreLoaders = 1,
+        MoreComputers = -1
+    };
+
+    /// minimum relative throughput improvement that justifies keeping an extra load slot
+    static const double THROUGHPUT_GAIN_MIN;
+
+    ConcurrencyBalancer(
+        const bool enabled,
+        const unsigned loadSlots,
+        const unsigned computeSlots);
+
+    void binLoaded(
+        const uint64_t now,
+        const uint64_t bytes,
+        const uint64_t loadMicroseconds,
+        const uint64_t loadSlotStallMicroseconds);
+
+    void binComputed(const uint64_t computeMicroseconds);
+
+    void allocationFailed() {++windowAllocationFailures_;}
+
+    /**
+     * \brief Called after each loaded bin. Once enough observations are collected, suggests a change.
+     *
+     * \param availableMemory       free physical memory. Extra loaders are not suggested when it does not cover
+     *                              nextBinMemory
+     * \param nextBinMemory         memory required for the next bin that will be loaded
+     */
+    Decision decide(
+        const uint64_t now,
+        const uint64_t availableMemory,
+        const uint64_t nextBinMemory);
+
+    /// Must be called by the client when it has applied the decision.
+    void applied(const Decision decision);
+
+    bool isEnabled() const {return enabled_;}
+    unsigned getLoadSlots() const {return loadSlots_;}
+    unsigned getComputeSlots() const {return computeSlots_;}
+    /// bytes per second loaded during the last complete observation window
+    uint64_t getLastThroughput() const {return lastThroughput_;}
+    const char *getLastReason() const {return lastReason_;}
+
+private:
+    const bool enabled_;
+    unsigned loadSlots_;
+    unsigned computeSlots_;
+    unsigned loadSlotsCeiling_;
+    Decision lastApplied_;
+    // decision of the previous window, applied or not
+    Decision lastDecision_;
+    uint64_t lastThroughput_;
+    uint64_t throughputBeforeLastApplied_;
+    const char *lastReason_;
+
+    uint64_t windowStart_;
+    unsigned windowLoads_;
+    unsigned windowComputes_;
+    uint64_t windowBytes_;
+    uint64_t windowLoadMicroseconds_;
+    uint64_t windowComputeMicroseconds_;
+    uint64_t windowStallMicroseconds_;
+    unsigned windowAllocationFailures_;
+
+    void resetWindow(const uint64_t now);
+};
+
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_CONCURRENCY_BALANCER_HH
@@ -40,6 +40,12 @@ struct FDuplicateFilter
     const demultiplexing::BarcodePathMap::BarcodeSampleIndexMap &barcodeSampleIndex_;
     FDuplicateFilter(const demultiplexing::BarcodePathMap::BarcodeSampleIndexMap &barcodeSampleIndex):
         barcodeSampleIndex_(barcodeSampleIndex){}
+
+    uint64_t getLibrary(const PairEndIndex &idx) const
+    {
+        return singleLibrarySamples ? barcodeSampleIndex_.at(idx.barcode_) : idx.barcode_;
+    }
+
     bool less(const PackedFragmentBuffer &fragments,
                      const FStrandFragmentIndex &left,
                      const FStrandFragmentIndex &right) const
@@ -59,12 +65,8 @@ struct FDuplicateFilter
 
                 if (left.mate_.info_.value_ == right.mate_.info_.value_)
                 {
-                    const io::FragmentAccessor &leftFragment = fragments.getFragment(left);
-                    const io::FragmentAccessor &rightFragment = fragments.getFragment(right);
-                    const uint64_t leftLibrary = singleLibrarySamples ?
-                        barcodeSampleIndex_.at(leftFragment.barcode_) : leftFragment.barcode_;
-                    const uint64_t rightLibrary = singleLibrarySamples ?
-                        barcodeSampleIndex_.at(rightFragment.barcode_) : rightFragment.barcode_;
+                    const uint64_t leftLibrary = getLibrary(left);
+                    const uint64_t rightLibrary = getLibrary(right);
                     //same library must be grouped together as we dupe-remove only within the library
                     if (leftLibrary < rightLibrary)
                         {return true;}
@@ -77,8 +79,7 @@ struct FDuplicateFilter
 
                         if (left.duplicateClusterRank_ == right.duplicateClusterRank_)
                         {
-                            if (leftFragment.tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + leftFragment.clusterId_ <
-                                rightFragment.tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + rightFragment.clusterId_)
+                            if (left.globalClusterId_ < right.globalClusterId_)
                                 {return true;}
                         }
                     }
@@ -96,20 +97,11 @@ struct FDuplicateFilter
             left.mate_.anchor_.value_ == right.mate_.anchor_.value_ &&
             left.mate_.info_.value_ == right.mate_.info_.value_)
         {
-            const io::FragmentAccessor &leftFragment = fragments.getFragment(left);
-            const io::FragmentAccessor &rightFragment = fragments.getFragment(right);
-
             // In a weird case when both ends of a pair are facing the same way and align at the same position,
             // this condition prevents one being discarded as duplicated of another
-            if (leftFragment.tile_ != rightFragment.tile_ ||
-                leftFragment.clusterId_ != rightFragment.clusterId_)
+            if (left.globalClusterId_ != right.globalClusterId_)
             {
-                const uint64_t leftLibrary = singleLibrarySamples ?
-                    barcodeSampleIndex_.at(leftFragment.barcode_) : leftFragment.barcode_;
-                const uint64_t rightLibrary = singleLibrarySamples ?
-                    barcodeSampleIndex_.at(rightFragment.barcode_) : rightFragment.barcode_;
-
-                return leftLibrary == rightLibrary;
+                return getLibrary(left) == getLibrary(right);
             }
         }
         return false;
@@ -122,6 +114,12 @@ struct RSDuplicateFilter
     const demultiplexing::BarcodePathMap::BarcodeSampleIndexMap &barcodeSampleIndex_;
     RSDuplicateFilter(const demultiplexing::BarcodePathMap::BarcodeSampleIndexMap &barcodeSampleIndex):
         barcodeSampleIndex_(barcodeSampleIndex){}
+
+    uint64_t getLibrary(const PairEndIndex &idx) const
+    {
+        return singleLibrarySamples ? barcodeSampleIndex_.at(idx.barcode_) : idx.barcode_;
+    }
+
     bool less(const PackedFragmentBuffer &fragments,
                      const RStrandOrShadowFragmentIndex &left,
                      const RStrandOrShadowFragmentIndex &right) const
@@ -141,12 +139,8 @@ struct RSDuplicateFilter
 
                 if (left.mate_.info_.value_ == right.mate_.info_.value_)
                 {
-                    const io::FragmentAccessor &leftFragment = fragments.getFragment(left);
-                    const io::FragmentAccessor &rightFragment = fragments.getFragment(right);
-                    const uint64_t leftLibrary = singleLibrarySamples ?
-                        barcodeSampleIndex_.at(leftFragment.barcode_) : leftFragment.barcode_;
-                    const uint64_t rightLibrary = singleLibrarySamples ?
-                        barcodeSampleIndex_.at(rightFragment.barcode_) : rightFragment.barcode_;
+                    const uint64_t leftLibrary = getLibrary(left);
+                    const uint64_t rightLibrary = getLibrary(right);
                     //same library must be grouped together as we dupe-remove only within the library
                     if (leftLibrary < rightLibrary)
                         {return true;}
@@ -159,11 +153,8 @@ struct RSDuplicateFilter
 
                         if (left.duplicateClusterRank_ == right.duplicateClusterRank_)
                         {
-                            if (fragments.getFragment(left).tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + fragments.getFragment(left).clusterId_ <
-                                fragments.getFragment(right).tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + fragments.getFragment(right).clusterId_)
-                            {
-                                return true;
-                            }
+                            if (left.globalClusterId_ < right.globalClusterId_)
+                                {return true;}
                         }
                     }
                 }
@@ -180,20 +171,11 @@ struct RSDuplicateFilter
             left.mate_.anchor_.value_ == right.mate_.anchor_.value_ &&
             left.mate_.info_.value_ == right.mate_.info_.value_)
         {
-            const io::FragmentAccessor &leftFragment = fragments.getFragment(left);
-            const io::FragmentAccessor &rightFragment = fragments.getFragment(right);
-
             // In a weird case when both ends of a pair are facing the same way and align at the same position,
             // this condition prevents one being discarded as duplicated of another
-            if (leftFragment.tile_ != rightFragment.tile_ ||
-                leftFragment.clusterId_ != rightFragment.clusterId_)
+            if (left.globalClusterId_ != right.globalClusterId_)
             {
-                const uint64_t leftLibrary = singleLibrarySamples ?
-                    barcodeSampleIndex_.at(leftFragment.barcode_) : leftFragment.barcode_;
-                const uint64_t rightLibrary = singleLibrarySamples ?
-                    barcodeSampleIndex_.at(rightFragment.barcode_) : rightFragment.barcode_;
-
-                return leftLibrary == rightLibrary;
+                return getLibrary(left) == getLibrary(right);
             }
         }
         else
@@ -32,6 +32,11 @@ namespace build
 // Use this as a way to convert from tile local cluster id to a cluster id that is supposedly unique within flowcell.
 static const uint64_t INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE = 1000000000;
 
+inline uint64_t getGlobalClusterId(const io::FragmentAccessor &fragment)
+{
+    return fragment.tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + fragment.clusterId_;
+}
+
 
 struct FragmentIndex
 {
@@ -116,16 +121,24 @@ inline std::ostream &operator <<(std::ostream& os, const FragmentIndexMate& mate
 }
 
 // base binary layout for an end of a pair
+// Carries copies of all the fragment fields that duplicate ranking needs so that sorting and filtering
+// does not have to go to the fragment data.
 struct PairEndIndex : public FragmentIndex
 {
     PairEndIndex(reference::ReferencePosition fStrandPos,
                  const FragmentIndexMate &mate,
-                 const uint64_t duplicateClusterRank):
-                     FragmentIndex(fStrandPos), mate_(mate), duplicateClusterRank_(duplicateClusterRank)
+                 const uint64_t duplicateClusterRank,
+                 const unsigned barcode,
+                 const uint64_t globalClusterId):
+                     FragmentIndex(fStrandPos), mate_(mate), duplicateClusterRank_(duplicateClusterRank),
+                     globalClusterId_(globalClusterId), barcode_(barcode)
     {}
 
     FragmentIndexMate mate_;
     uint64_t duplicateClusterRank_;
+    // see getGlobalClusterId
+    uint64_t globalClusterId_;
+    unsigned barcode_;
 };
 
 inline std::ostream &operator <<(std::ostream& os, const PairEndIndex& idx)
@@ -134,6 +147,8 @@ inline std::ostream &operator <<(std::ostream& os, const PairEndIndex& idx)
         idx.fStrandPos_ << ", " <<
         idx.mate_ << ", " <<
         idx.duplicateClusterRank_ << "dcr, " <<
+        idx.barcode_ << "bc, " <<
+        idx.globalClusterId_ << "gci, " <<
         idx.dataOffset_ << "do, " <<
         idx.mateDataOffset_ << "mdo " <<
         ")" << &idx;
@@ -144,11 +159,13 @@ struct FStrandFragmentIndex : public PairEndIndex
 {
     FStrandFragmentIndex(reference::ReferencePosition fStrandPos,
                          const FragmentIndexMate &mate,
-                         const uint64_t duplicateClusterRank):
-                             PairEndIndex(fStrandPos, mate, duplicateClusterRank)
+                         const uint64_t duplicateClusterRank,
+                         const unsigned barcode,
+                         const uint64_t globalClusterId):
+                             PairEndIndex(fStrandPos, mate, duplicateClusterRank, barcode, globalClusterId)
     {}
 };
-BOOST_STATIC_ASSERT(48 == sizeof(FStrandFragmentIndex));
+BOOST_STATIC_ASSERT(64 == sizeof(FStrandFragmentIndex));
 
 inline std::ostream &operator <<(std::ostream& os, const FStrandFragmentIndex& idx)
 {
@@ -156,6 +173,8 @@ inline std::ostream &operator <<(std::ostream& os, const FStrandFragmentIndex& i
         idx.fStrandPos_ << ", " <<
         idx.mate_ << ", " <<
         idx.duplicateClusterRank_ << "dcr, " <<
+        idx.barcode_ << "bc, " <<
+        idx.globalClusterId_ << "gci, " <<
         idx.dataOffset_ << "do, " <<
         idx.mateDataOffset_ << "mdo " <<
         ")" << &idx;
@@ -170,13 +189,15 @@ struct RStrandOrShadowFragmentIndex : public PairEndIndex
         reference::ReferencePosition fStrandPos,
         io::FragmentIndexAnchor anchor,
         const FragmentIndexMate &mate,
-        const uint64_t duplicateClusterRank):
-            PairEndIndex(fStrandPos, mate, duplicateClusterRank),
+        const uint64_t duplicateClusterRank,
+        const unsigned barcode,
+        const uint64_t globalClusterId):
+            PairEndIndex(fStrandPos, mate, duplicateClusterRank, barcode, globalClusterId),
             anchor_(anchor)
     {}
 };
 
-BOOST_STATIC_ASSERT(56 == sizeof(RStrandOrShadowFragmentIndex));
+BOOST_STATIC_ASSERT(72 == sizeof(RStrandOrShadowFragmentIndex));
 
 inline std::ostream &operator <<(std::ostream& os, const RStrandOrShadowFragmentIndex& idx)
 {
@@ -185,6 +206,8 @@ inline std::ostream &operator <<(std::ostream& os, const RStrandOrShadowFragment
         idx.anchor_ << ", " <<
         idx.mate_ << ", " <<
         idx.duplicateClusterRank_ << "dcr, " <<
+        idx.barcode_ << "bc, " <<
+        idx.globalClusterId_ << "gci, " <<
         idx.dataOffset_ << "do, " <<
         idx.mateDataOffset_ << "mdo " <<
         ")" << &idx;
@@ -24,6 +24,7 @@
 
 #include "alignment/Cigar.hh"
 #include "alignment/TemplateLengthStatistics.hh"
+#include "build/gapRealigner/MismatchProfiles.hh"
 #include "build/gapRealigner/RealignerGaps.hh"
 #include "build/PackedFragmentBuffer.hh"
 #include "flowcell/BarcodeMetadata.hh"
@@ -66,6 +67,12 @@ private:
 
     gapRealigner::RealignerGaps fragmentGaps_;
 
+    // longer reads get realigned without the help of the caches below
+    static const unsigned REALIGNED_READ_LENGTH_MAX = 1024;
+    // distinct alignment diagonals expected per fragment. Ones above this are compared base by base
+    static const unsigned MISMATCH_PROFILES_MAX = 64;
+    gapRealigner::MismatchProfiles mismatchProfiles_;
+
 public:
     typedef gapRealigner::Gap GapType;
     GapRealigner(
@@ -83,7 +90,14 @@ public:
             mismatchCost_(mismatchCost),
             gapOpenCost_(gapOpenCost),
             gapExtendCost_(gapExtendCost),
-            barcodeMetadataList_(barcodeMetadataList)
+            barcodeMetadataList_(barcodeMetadataList),
+            gapChoiceCacheGeneration_(0),
+            gapChoiceCacheLastGeneration_(0),
+            gapChoiceCacheReference_(0),
+            gapChoiceCacheLeftClipped_(0),
+            gapChoiceCacheRightClipped_(0),
+            gapChoiceCacheHits_(0),
+            gapChoiceCacheMisses_(0)
     {
         reserve();
     }
@@ -93,6 +107,10 @@ public:
         currentAttemptGaps_.reserve(MAX_GAPS_AT_A_TIME * 10);
         // number of existing gaps to be expected in one fragment. No need to be particularly precise.
         fragmentGaps_.reserve(currentAttemptGaps_.capacity());
+        gapChoiceCache_.resize(GAP_CHOICE_CACHE_SIZE);
+        gapChoiceCacheGaps_.reserve(currentAttemptGaps_.capacity());
+        gapChoiceCacheBases_.reserve(REALIGNED_READ_LENGTH_MAX);
+        mismatchProfiles_.reserve(REALIGNED_READ_LENGTH_MAX, MISMATCH_PROFILES_MAX);
     }
 
     bool realign(
@@ -266,6 +284,47 @@ private:
         const int originalMismatchesPercent,
         const int64_t undoneAlignmentPos,
         GapChoice& bestChoice);
+
+    GapChoice verifyGapsChoiceCached(
+        const GapChoiceBitmask &choice,
+        const gapRealigner::GapsRange &gaps,
+        const reference::ReferencePosition newBeginPos,
+        const io::FragmentAccessor &fragment,
+        const reference::ContigList &reference);
+
+    void validateGapChoiceCache(
+        const gapRealigner::GapsRange &gaps,
+        const io::FragmentAccessor &fragment,
+        const reference::ContigList &reference);
+
+    /**
+     * \brief Results of verifyGapsChoice remain valid for as long as the fragment bases, clipping and the set of gaps
+     *        stay the same. In indel-dense regions piles of fragments start at the same position and carry identical
+     *        sequence. The cache allows such fragments to reuse the evaluations instead of recounting mismatches.
+     */
+    struct CachedGapChoice
+    {
+        CachedGapChoice() : generation_(0) {}
+        unsigned generation_;
+        GapChoice choice_;
+    };
+    // must be a power of 2
+    static const unsigned GAP_CHOICE_CACHE_SIZE = 4096;
+    std::vector<CachedGapChoice> gapChoiceCache_;
+    // entries with generation_ different from this are invalid. 0 means cache is disabled for the current fragment
+    unsigned gapChoiceCacheGeneration_;
+    unsigned gapChoiceCacheLastGeneration_;
+    gapRealigner::Gaps gapChoiceCacheGaps_;
+    std::vector<unsigned char> gapChoiceCacheBases_;
+    const reference::ContigList *gapChoiceCacheReference_;
+    unsigned gapChoiceCacheLeftClipped_;
+    unsigned gapChoiceCacheRightClipped_;
+    uint64_t gapChoiceCacheHits_;
+    uint64_t gapChoiceCacheMisses_;
+
+public:
+    uint64_t getGapChoiceCacheHits() const {return gapChoiceCacheHits_;}
+    uint64_t getGapChoiceCacheMisses() const {return gapChoiceCacheMisses_;}
 };
 
 } // namespace build
@@ -0,0 +1,39 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file OutputFormat.hh
+ **
+ ** Formats of the files produced by Build.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_OUTPUT_FORMAT_HH
+#define iSAAC_BUILD_OUTPUT_FORMAT_HH
+
+namespace isaac
+{
+namespace build
+{
+
+enum OutputFormat
+{
+    /// bgzf-compressed bam and bai index
+    OUTPUT_BAM,
+    /// CRAM 3.0 encoded against the reference. No index is produced
+    OUTPUT_CRAM
+};
+
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_OUTPUT_FORMAT_HH
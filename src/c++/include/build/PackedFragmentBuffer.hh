@@ -43,21 +43,35 @@ public:
             uint64_t mateDataOffset,
             const unsigned *cigarBegin,
             const unsigned *cigarEnd,
-            const bool reverse):
+            const bool reverse,
+            const uint64_t bamOrderKey):
                 pos_(pos), dataOffset_(dataOffset), mateDataOffset_(mateDataOffset),
-                cigarBegin_(cigarBegin), cigarEnd_(cigarEnd), reverse_(reverse),
+                cigarBegin_(cigarBegin), cigarEnd_(cigarEnd), bamOrderKey_(bamOrderKey), reverse_(reverse),
                 splitInfoOffset_(0), splitInfoCount_(0)
         {}
 
         Index(const FStrandFragmentIndex &idx, const io::FragmentAccessor &fragment) :
             Index(idx.fStrandPos_, idx.dataOffset_, idx.mateDataOffset_,
-                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse()){}
+                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse(), makeBamOrderKey(fragment)){}
         Index(const RStrandOrShadowFragmentIndex &idx, const io::FragmentAccessor &fragment) :
             Index(idx.fStrandPos_, idx.dataOffset_, idx.mateDataOffset_,
-                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse()){}
+                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse(), makeBamOrderKey(fragment)){}
         Index(const SeFragmentIndex &idx, const io::FragmentAccessor &fragment) :
             Index(idx.fStrandPos_, idx.dataOffset_, idx.dataOffset_,
-                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse()){}
+                  fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse(), makeBamOrderKey(fragment)){}
+
+        /**
+         * \brief Packs the fragment fields that order fragments aligned at the same position so that
+         *        orderForBam does not need to access fragment data.
+         *
+         * global cluster id, then singleton before shadow, then first read before second.
+         */
+        static uint64_t makeBamOrderKey(const io::FragmentAccessor &fragment)
+        {
+            const uint64_t globalClusterId = getGlobalClusterId(fragment);
+            ISAAC_ASSERT_MSG(!(globalClusterId >> 62), "Global cluster id too large to pack: " << globalClusterId);
+            return (globalClusterId << 2) | (uint64_t(fragment.flags_.unmapped_) << 1) | fragment.flags_.secondRead_;
+        }
 
         bool hasMate() const
         {
@@ -94,6 +108,8 @@ public:
         typedef const uint32_t * CigarIterator;
         CigarIterator cigarBegin_;
         CigarIterator cigarEnd_;
+        // see makeBamOrderKey
+        uint64_t bamOrderKey_;
         bool reverse_;
         // offset into list of SplitInfo structures
         unsigned splitInfoOffset_;
@@ -185,31 +201,7 @@ public:
 
     bool orderForBam(const Index &left, const Index &right) const
     {
-        if (left.pos_ < right.pos_)
-        {
-            return true;
-        }
-        else if (left.pos_ == right.pos_)
-        {
-            const io::FragmentAccessor &leftFragment = getFragment(left);
-            const io::FragmentAccessor &rightFragment = getFragment(right);
-            const uint64_t leftGlobalClusterId = leftFragment.tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + leftFragment.clusterId_;
-            const uint64_t rightGlobalClusterId = rightFragment.tile_ * INSANELY_HIGH_NUMBER_OF_CLUSTERS_PER_TILE + rightFragment.clusterId_;
-
-            return
-                leftGlobalClusterId < rightGlobalClusterId ||
-                (leftGlobalClusterId == rightGlobalClusterId &&
-                    // ensure singleton and shadow stay together and shadow follows the singleton
-                    (leftFragment.flags_.unmapped_ < rightFragment.flags_.unmapped_ ||
-                        (leftFragment.flags_.unmapped_ == rightFragment.flags_.unmapped_ &&
-                            // SAAC-378 ensure second read comes after first to generate consistent bam files between different runs
-                            leftFragment.flags_.secondRead_ < rightFragment.flags_.secondRead_
-                        )
-                    )
-                );
-        }
-
-        return false;
+        return left.pos_ < right.pos_ || (left.pos_ == right.pos_ && left.bamOrderKey_ < right.bamOrderKey_);
     }
 };
 
@@ -72,8 +72,22 @@ public:
     }
 
     void threadRealignGaps(boost::unique_lock<boost::mutex> &lock, BinData &binData, BinData::iterator &nextUnprocessed, uint64_t threadNumber);
+
+    uint64_t getGapChoiceCacheHits() const
+    {
+        return std::accumulate(threadGapRealigners_.begin(), threadGapRealigners_.end(), uint64_t(0),
+                               boost::bind(std::plus<uint64_t>(), _1, boost::bind(&GapRealigner::getGapChoiceCacheHits, _2)));
+    }
+
+    uint64_t getGapChoiceCacheMisses() const
+    {
+        return std::accumulate(threadGapRealigners_.begin(), threadGapRealigners_.end(), uint64_t(0),
+                               boost::bind(std::plus<uint64_t>(), _1, boost::bind(&GapRealigner::getGapChoiceCacheMisses, _2)));
+    }
 private:
     static const std::size_t THREAD_CIGAR_MAX =1024;
+    static const std::size_t READS_AT_A_TIME = 1024;
+    static const std::size_t READS_AT_A_TIME_MIN = 16;
     const bool clipSemialigned_;
     const flowcell::BarcodeMetadataList &barcodeMetadataList_;
     const isaac::reference::ContigLists &contigLists_;
@@ -82,6 +96,8 @@ private:
     std::vector<GapRealigner> threadGapRealigners_;
     boost::mutex cigarBufferMutex_;
 
+    BinData::iterator nextWindow(BinData &binData, BinData::iterator &nextUnprocessed) const;
+
     void realign(
         isaac::build::GapRealigner& realigner,
         io::FragmentAccessor& fragment, PackedFragmentBuffer::Index &index,
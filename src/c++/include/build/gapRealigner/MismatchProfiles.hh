@@ -0,0 +1,108 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MismatchProfiles.hh
+ **
+ ** Gap realigner implementation details.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_BUILD_GAP_REALIGNER_MISMATCH_PROFILES_HH
+#define iSAAC_BUILD_GAP_REALIGNER_MISMATCH_PROFILES_HH
+
+#include <vector>
+
+#include "reference/Contig.hh"
+#include "reference/ReferencePosition.hh"
+
+namespace isaac
+{
+namespace build
+{
+namespace gapRealigner
+{
+
+/**
+ * \brief Bit masks of read-to-reference mismatches, one per alignment diagonal.
+ *
+ * Every gap combination evaluated for a fragment maps the segments of the read onto the reference with a
+ * shift determined by the gaps preceding the segment. The number of distinct shifts is small compared to the number
+ * of combinations, so the read is compared against each shifted reference once, 16 bases per instruction, and the
+ * mismatches of any segment are then counted with popcount over the relevant bits.
+ *
+ * Mismatch semantics follow alignment::countEditDistanceMismatches: any difference between the read base and
+ * the reference base counts, reference positions past the contig end are not counted.
+ */
+class MismatchProfiles
+{
+public:
+    MismatchProfiles() : readLength_(0), wordsPerProfile_(0), reference_(0), bclBases_(0), profiles_(0), enabled_(false)
+    {
+    }
+
+    /// preallocates memory. No allocations happen after this.
+    void reserve(const unsigned readLengthMax, const unsigned profilesMax);
+
+    /**
+     * \brief discards profiles of the previous fragment.
+     *
+     * \param bases         bcl bases of the fragment
+     */
+    void reset(
+        const reference::ContigList &reference,
+        const unsigned char *bases,
+        const unsigned readLength);
+
+    /**
+     * \return number of mismatches between the read bases starting at readOffset and reference starting at pos
+     */
+    unsigned countMismatches(
+        const unsigned readOffset,
+        const reference::ReferencePosition pos,
+        const unsigned length);
+
+    /// number of diagonals compared against the reference for the current fragment
+    unsigned getProfilesCount() const {return profiles_;}
+
+private:
+    static const unsigned BITS_PER_WORD = 64;
+
+    struct Diagonal
+    {
+        Diagonal(const unsigned contigId, const int64_t shift) : contigId_(contigId), shift_(shift) {}
+        unsigned contigId_;
+        // reference position of the first read base
+        int64_t shift_;
+        bool operator ==(const Diagonal &that) const {return contigId_ == that.contigId_ && shift_ == that.shift_;}
+    };
+
+    unsigned readLength_;
+    unsigned wordsPerProfile_;
+    const reference::ContigList *reference_;
+    const unsigned char *bclBases_;
+    // read bases converted into the reference alphabet
+    std::vector<char> readBases_;
+    std::vector<Diagonal> diagonals_;
+    std::vector<uint64_t> masks_;
+    unsigned profiles_;
+    bool enabled_;
+
+    const uint64_t *getProfile(const Diagonal &diagonal);
+    void buildProfile(const Diagonal &diagonal, uint64_t *mask) const;
+};
+
+} // namespace gapRealigner
+} // namespace build
+} // namespace isaac
+
+#endif // #ifndef iSAAC_BUILD_GAP_REALIGNER_MISMATCH_PROFILES_HH
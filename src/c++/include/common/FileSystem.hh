@@ -37,7 +37,7 @@ inline bool isDotGzPath(const boost::filesystem::path& path)
 {
     static const char dotGz[] = {'.', 'g', 'z'};
     return path.string().length() > sizeof(dotGz) &&
-        0 == path.string().compare(path.string().size() - sizeof(dotGz), sizeof(dotGz), dotGz);
+        0 == path.string().compare(path.string().size() - sizeof(dotGz), sizeof(dotGz), dotGz, sizeof(dotGz));
 }
 
 char getDirectorySeparatorChar();
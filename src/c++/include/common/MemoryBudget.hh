@@ -0,0 +1,161 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryBudget.hh
+ **
+ ** \brief Process-wide accounting of the memory taken by the major data structures.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_MEMORY_BUDGET_HH
+#define iSAAC_COMMON_MEMORY_BUDGET_HH
+
+#include <boost/array.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace isaac
+{
+namespace common
+{
+
+/**
+ * \brief Keeps track of the memory reserved by each subsystem against a common limit. Reservations that would
+ *        exceed the limit fail with MemoryException, which, being a bad_alloc, is handled by the code that copes
+ *        with allocation failures anyway. Tracks the high-water mark of each subsystem for the statistics.
+ */
+class MemoryBudget : boost::noncopyable
+{
+public:
+    enum Subsystem
+    {
+        Reference,
+        Hash,
+        TileBuffers,
+        FragmentBinner,
+        BuildBins,
+        Bgzf,
+        BinsInMemory,
+        UnpairedReads,
+        SubsystemCount
+    };
+
+    /**
+     * \param limit bytes that all subsystems together are allowed to reserve. 0 means no limit
+     */
+    explicit MemoryBudget(const uint64_t limit);
+
+    /**
+     * \brief Sets the limit of the process-wide budget
+     */
+    static void configure(const uint64_t limit);
+
+    /**
+     * \return process-wide budget. Unless configure is called, has no limit
+     */
+    static MemoryBudget &instance();
+
+    static const char *getSubsystemName(const Subsystem subsystem);
+
+    /**
+     * \throws MemoryException if the reservation does not fit the limit
+     */
+    void reserve(const Subsystem subsystem, const uint64_t bytes);
+
+    /**
+     * \return false if the reservation does not fit the limit, in which case nothing is reserved
+     */
+    bool tryReserve(const Subsystem subsystem, const uint64_t bytes);
+
+    void release(const Subsystem subsystem, const uint64_t bytes);
+
+    uint64_t getLimit() const {return limit_;}
+    /**
+     * \return bytes that can still be reserved
+     */
+    uint64_t getAvailable() const;
+    uint64_t getReserved() const;
+    uint64_t getReserved(const Subsystem subsystem) const;
+    /**
+     * \return the largest amount of bytes the subsystem had reserved at any point in time
+     */
+    uint64_t getHighWater(const Subsystem subsystem) const;
+    /**
+     * \return the largest amount of bytes all subsystems together had reserved at any point in time
+     */
+    uint64_t getHighWater() const;
+
+private:
+    mutable boost::mutex mutex_;
+    uint64_t limit_;
+    uint64_t reserved_;
+    uint64_t highWater_;
+    boost::array<uint64_t, SubsystemCount> subsystemReserved_;
+    boost::array<uint64_t, SubsystemCount> subsystemHighWater_;
+
+    bool reserveLocked(const Subsystem subsystem, const uint64_t bytes);
+};
+
+/**
+ * \brief Bytes reserved by a subsystem, released on destruction
+ */
+class MemoryReservation : boost::noncopyable
+{
+public:
+    explicit MemoryReservation(
+        const MemoryBudget::Subsystem subsystem, const uint64_t bytes = 0, MemoryBudget &budget = MemoryBudget::instance()) :
+        budget_(budget), subsystem_(subsystem), bytes_(0)
+    {
+        resize(bytes);
+    }
+
+    ~MemoryReservation()
+    {
+        release();
+    }
+
+    /**
+     * \brief Reserves or releases the difference between the current and the requested reservation
+     *
+     * \throws MemoryException if growing does not fit the limit. The reservation stays unchanged in this case
+     */
+    void resize(const uint64_t bytes)
+    {
+        if (bytes > bytes_)
+        {
+            budget_.reserve(subsystem_, bytes - bytes_);
+        }
+        else
+        {
+            budget_.release(subsystem_, bytes_ - bytes);
+        }
+        bytes_ = bytes;
+    }
+
+    void release()
+    {
+        resize(0);
+    }
+
+    uint64_t getBytes() const {return bytes_;}
+
+private:
+    MemoryBudget &budget_;
+    const MemoryBudget::Subsystem subsystem_;
+    uint64_t bytes_;
+};
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_MEMORY_BUDGET_HH
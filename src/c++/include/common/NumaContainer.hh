@@ -71,6 +71,7 @@ public:
     }
 
     const ReplicaT &node0Container() const {return nodeContainers_.front();}
+    std::size_t getReplicaCount() const {return nodeContainers_.size();}
     const ReplicaT &threadNodeContainer() const {return nodeContainers_.at(common::ThreadVector::getThreadNumaNode());}
 //        return hashes_[(common::ThreadVector::getThreadNumaNode()+1) % 2].findMatches(kmer);
 };
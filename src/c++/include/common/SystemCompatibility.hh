@@ -106,6 +106,9 @@ uint64_t getFileSize(const PathCharType *filePath);
 /// Determine the processor time
 int64_t clock();
 
+/// Physical memory in bytes that can be given to the process without swapping, including reclaimable page cache
+uint64_t getAvailablePhysicalMemory();
+
 /// Check if the architecture is little endian
 bool isLittleEndian();
 
@@ -155,6 +158,23 @@ int linuxFallocate(int fd, std::size_t offset, std::size_t len);
  */
 int linuxFtruncate(int fd, std::size_t len);
 
+/**
+ * \brief Starts asynchronous writeback of len bytes at offset. Does not wait for the writeback to complete. Does
+ *        nothing where sync_file_range is not available.
+ *
+ * \return 0 on success
+ */
+int linuxStartWriteBehind(int fd, std::size_t offset, std::size_t len);
+
+/**
+ * \brief Waits for len bytes at offset to reach the disk and drops them from page cache. Called for the window
+ *        preceding the one just started, keeps the page cache from filling up with data that will not be read soon.
+ *        Does nothing where sync_file_range is not available.
+ *
+ * \return 0 on success
+ */
+int linuxFinishWriteBehind(int fd, std::size_t offset, std::size_t len);
+
 } // namespace common
 } // namespace isaac
 
@@ -0,0 +1,229 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file TaskScheduler.hh
+ **
+ ** \brief Work-stealing scheduler shared by the whole process.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_COMMON_TASK_SCHEDULER_HH
+#define iSAAC_COMMON_TASK_SCHEDULER_HH
+
+#include <atomic>
+#include <deque>
+#include <map>
+
+#include <boost/function.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace common
+{
+
+class TaskGroup;
+
+/**
+ * \brief Pool of worker threads, each with its own queue of tasks. Workers take tasks from the back of their own
+ *        queue and, when it is empty, steal from the front of the queues of other workers, preferring the workers
+ *        bound to the same NUMA node. Threads waiting for a TaskGroup execute queued tasks instead of blocking,
+ *        which allows parallel loops and task groups to nest without exhausting the pool.
+ *
+ * Unlike BasicThreadVector, tasks don't get a thread number. Per-thread state indexed by thread number is not safe
+ * with the scheduler as a waiting thread can pick up another task of the same loop.
+ */
+class TaskScheduler : boost::noncopyable
+{
+public:
+    typedef boost::function<void()> Function;
+
+    /**
+     * \param workers number of threads to create. Threads are spread over NUMA nodes the same way
+     *                BasicThreadVector does it
+     */
+    explicit TaskScheduler(const unsigned workers);
+    ~TaskScheduler();
+
+    /**
+     * \brief Sets the size of the process-wide scheduler. Must be called before the first call to instance()
+     */
+    static void configure(const unsigned workers);
+
+    /**
+     * \return process-wide scheduler. Unless configure is called, has one worker per hardware thread
+     */
+    static TaskScheduler &instance();
+
+    unsigned getWorkers() const {return workers_.size();}
+
+    /**
+     * \brief Calls func(rangeBegin, rangeEnd) for consecutive subranges of [begin, end) no longer than grain.
+     *        Returns when all subranges are processed. The calling thread processes subranges too.
+     */
+    template <typename F>
+    void parallelFor(const std::size_t begin, const std::size_t end, const std::size_t grain, F func);
+
+private:
+    friend class TaskGroup;
+
+    struct Task
+    {
+        Task() : group_(0){}
+        Task(const Function &function, TaskGroup *group) : function_(function), group_(group){}
+        Function function_;
+        TaskGroup *group_;
+    };
+
+    struct Worker
+    {
+        explicit Worker(const unsigned index) : index_(index), node_(-1){}
+        const unsigned index_;
+        // node to which the thread is bound as seen in runOnNode_
+        int node_;
+        boost::mutex mutex_;
+        std::deque<Task> tasks_;
+        // other workers in the order in which they get robbed. Same node first.
+        std::vector<Worker *> victims_;
+    };
+
+    boost::ptr_vector<Worker> workers_;
+    boost::ptr_vector<boost::thread> threads_;
+    // workers grouped by node, for threads that are not workers to find the queues close to them
+    std::map<int, std::vector<Worker *> > nodeWorkers_;
+
+    boost::mutex idleMutex_;
+    boost::condition_variable idleCondition_;
+    // tasks pushed but not taken yet. Workers sleep when there are none.
+    std::atomic<std::size_t> queuedTasks_;
+    std::atomic<unsigned> nextExternalQueue_;
+    unsigned startedWorkers_;
+    bool started_;
+    bool terminateRequested_;
+
+    static iSAAC_THREAD_LOCAL Worker *currentWorker_;
+    static iSAAC_THREAD_LOCAL TaskScheduler *currentScheduler_;
+
+    Worker *getCurrentWorker() const {return this == currentScheduler_ ? currentWorker_ : 0;}
+    const std::vector<Worker *> &getExternalVictims() const;
+
+    void push(const Task &task);
+    bool pop(Task &task);
+    /**
+     * \brief executes one queued task if there is one
+     *
+     * \return false if no task was found
+     */
+    bool runOne();
+    void execute(Task &task);
+    void waitForWork(const std::atomic<std::size_t> *pending);
+    void taskGroupDone();
+    void workerThread(Worker &worker);
+};
+
+/**
+ * \brief Set of tasks the caller can wait for. The first exception thrown by a task is rethrown by wait.
+ */
+class TaskGroup : boost::noncopyable
+{
+public:
+    explicit TaskGroup(TaskScheduler &scheduler = TaskScheduler::instance()) : scheduler_(scheduler), pending_(0){}
+    /**
+     * \brief waits for the remaining tasks as they may refer to the objects of the scope being left
+     */
+    ~TaskGroup();
+
+    template <typename F> void run(F func)
+    {
+        ++pending_;
+        scheduler_.push(TaskScheduler::Task(func, this));
+    }
+
+    /**
+     * \brief Executes queued tasks until all tasks of the group are complete.
+     */
+    void wait();
+
+private:
+    friend class TaskScheduler;
+    TaskScheduler &scheduler_;
+    std::atomic<std::size_t> pending_;
+    boost::mutex exceptionMutex_;
+    boost::exception_ptr firstException_;
+
+    void done(const boost::exception_ptr &exception);
+};
+
+/**
+ * \brief Tasks with dependencies. A task is started when all the tasks it depends on are complete. Tasks that
+ *        don't depend on each other run in parallel.
+ */
+class TaskGraph : boost::noncopyable
+{
+public:
+    typedef std::size_t NodeId;
+
+    NodeId add(const TaskScheduler::Function &function);
+
+    /**
+     * \brief node will not start until prerequisite is complete
+     */
+    void depends(const NodeId node, const NodeId prerequisite);
+
+    /**
+     * \brief Executes all the tasks and returns when they are complete. If a task throws, the tasks that depend
+     *        on it are not executed and the exception is rethrown.
+     */
+    void run(TaskScheduler &scheduler = TaskScheduler::instance());
+
+private:
+    struct Node
+    {
+        explicit Node(const TaskScheduler::Function &function) : function_(function), prerequisites_(0), waitingFor_(0){}
+        TaskScheduler::Function function_;
+        std::vector<NodeId> dependents_;
+        unsigned prerequisites_;
+        std::atomic<unsigned> waitingFor_;
+    };
+    boost::ptr_vector<Node> nodes_;
+
+    void runNode(TaskGroup &group, const NodeId nodeId, std::atomic<std::size_t> &completed);
+};
+
+template <typename F>
+void TaskScheduler::parallelFor(const std::size_t begin, std::size_t end, const std::size_t grain, F func)
+{
+    ISAAC_ASSERT_MSG(grain, "Grain must be positive");
+    TaskGroup group(*this);
+    // queue the upper halves for others to steal, keep splitting the lower half
+    while (end - begin > grain)
+    {
+        const std::size_t middle = begin + (end - begin) / 2;
+        const std::size_t upperEnd = end;
+        group.run([this, middle, upperEnd, grain, func](){parallelFor(middle, upperEnd, grain, func);});
+        end = middle;
+    }
+    if (begin != end)
+    {
+        func(begin, end);
+    }
+    group.wait();
+}
+
+} // namespace common
+} // namespace isaac
+
+#endif // #ifndef iSAAC_COMMON_TASK_SCHEDULER_HH
@@ -64,7 +64,7 @@ inline std::ostream & operator <<(std::ostream &os, const oligo::Bases<BITS_PER_
  **
  ** From LSB to MSB:
  **   - cluster:    31 (2,147,483,648)
- **   - barcode:    12 (        4,096)
+ **   - barcode:    16 (       65,536)
  **   - tile   :    12 (        4,096)
  **   - mismatches   2 (            4)
  **
@@ -85,7 +85,7 @@ public:
     // width in bits for each field
     static const unsigned MISMATCHES_WIDTH = 2;
     static const unsigned CLUSTER_WIDTH = 31;
-    static const unsigned BARCODE_WIDTH = 12;
+    static const unsigned BARCODE_WIDTH = 16;
     static const unsigned TILE_WIDTH = 12;
     // masks for the values in each field
     static const uint64_t MISMATCHES_MASK = ~(~0UL<<MISMATCHES_WIDTH);
@@ -106,8 +106,8 @@ public:
     {
         using boost::mpl::equal_to;
         using boost::mpl::int_;
-        BOOST_MPL_ASSERT((equal_to<int_<57>, int_<MISMATCHES_WIDTH + CLUSTER_WIDTH + BARCODE_WIDTH + TILE_WIDTH> >));
-        BOOST_MPL_ASSERT((equal_to<int_<57>, int_<TILE_WIDTH + TILE_SHIFT> >));
+        BOOST_MPL_ASSERT((equal_to<int_<61>, int_<MISMATCHES_WIDTH + CLUSTER_WIDTH + BARCODE_WIDTH + TILE_WIDTH> >));
+        BOOST_MPL_ASSERT((equal_to<int_<61>, int_<TILE_WIDTH + TILE_SHIFT> >));
         using boost::format;
         using isaac::common::PreConditionException;
         if ((TILE_MASK < tile) ||
@@ -154,7 +154,8 @@ public:
     {
         ISAAC_ASSERT_MSG(
             flowcell::Layout::Bcl == flowcellLayout.getFormat() ||
-            flowcell::Layout::BclBgzf == flowcellLayout.getFormat(), "Only bcl barcode loading is supported");
+            flowcell::Layout::BclBgzf == flowcellLayout.getFormat() ||
+            flowcell::Layout::Cbcl == flowcellLayout.getFormat(), "Only bcl barcode loading is supported");
         ISAAC_ASSERT_MSG(MAX_BARCODE_LENGTH >= flowcellLayout.getBarcodeLength(), "barcode cannot be longer than " << MAX_BARCODE_LENGTH << " bases");
 
         boost::lock_guard<boost::mutex> lock(mutex_);
@@ -20,6 +20,9 @@
 #ifndef iSAAC_DEMULTIPLEXING_BARCODE_RESOLVER_HH
 #define iSAAC_DEMULTIPLEXING_BARCODE_RESOLVER_HH
 
+#include <unordered_map>
+
+#include "common/Threads.hpp"
 #include "demultiplexing/Barcode.hh"
 #include "demultiplexing/DemultiplexingStats.hh"
 #include "flowcell/BarcodeMetadata.hh"
@@ -30,17 +33,87 @@ namespace isaac
 namespace demultiplexing
 {
 
+/**
+ * \brief Open-addressing table of barcode sequences. Lookup is O(1) and does not modify the table, so any
+ *        number of threads can query it at the same time.
+ */
+class BarcodeHashTable
+{
+public:
+    /**
+     * \param sizeMax maximum number of distinct sequences that will be inserted
+     */
+    explicit BarcodeHashTable(const std::size_t sizeMax);
+
+    /**
+     * \return pointer to the slot holding the sequence and true if the barcode has been inserted or false
+     *         if the slot was occupied by the same sequence already.
+     */
+    std::pair<Barcode *, bool> insert(const Barcode &barcode);
+
+    /**
+     * \return pointer to the barcode matching the sequence or 0 if there is none
+     */
+    const Barcode *find(const Kmer sequence) const
+    {
+        for (std::size_t slot = hash(sequence); ; slot = (slot + 1) & slotMask_)
+        {
+            const Barcode &barcode = slots_[slot];
+            if (sequence == barcode.getSequence())
+            {
+                return &barcode;
+            }
+            if (EMPTY_SLOT == barcode.getSequence())
+            {
+                return 0;
+            }
+        }
+    }
+
+    std::size_t size() const {return size_;}
+
+private:
+    // Barcode kmers never use the top bit, so the sequence of all ones can mark a free slot
+    static const Kmer EMPTY_SLOT = ~Kmer(0);
+    std::size_t slotMask_;
+    unsigned shift_;
+    std::size_t size_;
+    std::vector<Barcode> slots_;
+
+    std::size_t hash(const Kmer sequence) const
+    {
+        // Fibonacci hashing spreads the neighbouring mismatch variants across the table
+        return (sequence * 0x9E3779B97F4A7C15UL) >> shift_;
+    }
+};
+
+/**
+ * \brief Resolves each barcode component (such as i7 and i5 of dual-index barcodes) in its own table of
+ *        mismatch variants and then looks up the sample by the combination of the component matches. The
+ *        tables grow with the number of distinct component sequences rather than with the product of the
+ *        component variant counts.
+ */
 class BarcodeResolver: boost::noncopyable
 {
 public:
+    // bits of the sample lookup key taken by each component
+    static const unsigned COMPONENT_ID_BITS = 16;
+    static const unsigned COMPONENTS_MAX = 64 / COMPONENT_ID_BITS;
+
     BarcodeResolver(
         const flowcell::BarcodeMetadataList &allBarcodeMetadata,
         const flowcell::BarcodeMetadataList &barcodeGroup);
 
     /**
-     * \brief updates the tile information in 'result' with the corresponding barcodeMetadataList_ indexes
+     * \brief updates the tile information in 'result' with the corresponding barcodeMetadataList_ indexes.
+     *        The order of barcodes is preserved.
+     *
+     * \param threads   threads to look up the barcodes on
+     * \param threadsMax number of threads to use
      */
     void resolve(
+        common::ThreadVector &threads,
+        const unsigned threadsMax,
         Barcodes &barcodes,
         demultiplexing::DemultiplexingStats &demultiplexingStats);
 
@@ -62,15 +135,35 @@ public:
                                                       const unsigned iteration);
 
 private:
+    struct Component
+    {
+        Component(const unsigned shift, const unsigned length, const std::size_t variantsMax) :
+            shift_(shift), mask_(~(~Kmer(0) << (length * BITS_PER_BASE))), variants_(variantsMax){}
+        // position of the component in the barcode kmer
+        unsigned shift_;
+        Kmer mask_;
+        // mismatch variants of the distinct component sequences. BarcodeId barcode is the component id.
+        BarcodeHashTable variants_;
+    };
+
     const flowcell::BarcodeMetadataList &allBarcodeMetadata_;
-    const Barcodes mismatchBarcodes_;
     const unsigned unknownBarcodeIndex_;
+    std::vector<Component> components_;
+    // combinations of component ids of the sample sheet barcodes. BarcodeId barcode is the barcode index.
+    BarcodeHashTable samples_;
     std::vector<uint64_t> barcodeHits_;
+    // per-thread sequences that did not match any of the mismatch barcodes, with hit counts
+    typedef std::unordered_map<Kmer, uint64_t> UnknownHits;
+    std::vector<UnknownHits> threadUnknownHits_;
 
-    Barcodes::iterator recordSameBarcodeHits(
-        const Barcodes::iterator dataBarcodeIterator,
-        const Barcodes::const_iterator dataBarcodesEnd,
-        demultiplexing::DemultiplexingStats& demultiplexingStats);
+    void buildComponentTables(const flowcell::BarcodeMetadataList &barcodeGroup);
+
+    bool getSampleKey(const Kmer sequence, Kmer &key, unsigned &mismatches) const;
+
+    void resolveThread(
+        Barcodes &barcodes,
+        const unsigned threadNumber,
+        const unsigned threadsTotal);
 };
 
 } // namespace demultiplexing
@@ -0,0 +1,87 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclLayout.hh
+ **
+ ** Specialization of Layout attributes for NovaSeq cbcl base calls.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_FLOWCELL_CBCL_LAYOUT_HH
+#define iSAAC_FLOWCELL_CBCL_LAYOUT_HH
+
+#include "flowcell/BclLayoutAttributes.hh"
+#include "flowcell/Layout.hh"
+
+namespace isaac
+{
+namespace flowcell
+{
+
+namespace cbcl
+{
+    static const unsigned LANE_NUMBER_MAX = 8;
+    static const unsigned TILE_NUMBER_MAX = 99999;
+    static const unsigned CYCLE_NUMBER_MAX = 9999;
+
+    /**
+     * \brief Cbcl files hold all the tiles of one surface. Surface is the first digit of the tile number
+     */
+    inline unsigned getTileSurface(const unsigned tile)
+    {
+        return 10000 <= tile ? tile / 10000 : tile / 1000;
+    }
+}
+
+/// L00N/C<cycle>.1/L00N_<surface>.cbcl. Tile is only used to determine the surface.
+template<>
+void Layout::getLaneTileCycleAttribute<Layout::Cbcl, BclFilePathAttributeTag>(
+    const unsigned lane, const unsigned tile, const unsigned cycle, boost::filesystem::path &result) const;
+
+template<>
+void Layout::getLaneTileAttribute<Layout::Cbcl, FiltersFilePathAttributeTag>(
+    const unsigned lane, const unsigned tile, boost::filesystem::path &result) const;
+
+template<>
+void Layout::getLaneAttribute<Layout::Cbcl, PositionsFilePathAttributeTag>(
+    const unsigned lane, boost::filesystem::path &result) const;
+
+template<>
+inline boost::filesystem::path Layout::getLongestAttribute<Layout::Cbcl, BclFilePathAttributeTag>() const
+{
+    boost::filesystem::path cbclFilePath;
+    getLaneTileCycleAttribute<Layout::Cbcl, BclFilePathAttributeTag>(
+        cbcl::LANE_NUMBER_MAX, cbcl::TILE_NUMBER_MAX, cbcl::CYCLE_NUMBER_MAX, cbclFilePath);
+    return cbclFilePath;
+}
+
+template<>
+inline boost::filesystem::path Layout::getLongestAttribute<Layout::Cbcl, FiltersFilePathAttributeTag>() const
+{
+    boost::filesystem::path filtersFilePath;
+    getLaneTileAttribute<Layout::Cbcl, FiltersFilePathAttributeTag>(cbcl::LANE_NUMBER_MAX, cbcl::TILE_NUMBER_MAX, filtersFilePath);
+    return filtersFilePath;
+}
+
+template<>
+inline boost::filesystem::path Layout::getLongestAttribute<Layout::Cbcl, PositionsFilePathAttributeTag>() const
+{
+    boost::filesystem::path positionsFilePath;
+    getLaneAttribute<Layout::Cbcl, PositionsFilePathAttributeTag>(cbcl::LANE_NUMBER_MAX, positionsFilePath);
+    return positionsFilePath;
+}
+
+} // namespace flowcell
+} // namespace isaac
+
+#endif // #ifndef iSAAC_FLOWCELL_CBCL_LAYOUT_HH
@@ -84,7 +84,8 @@ public:
         Bam,
         Bcl,
         BclBgzf,
-        Fastq
+        Fastq,
+        Cbcl
     };
     typedef boost::variant<BclFlowcellData, FastqFlowcellData, BamFlowcellData> FormatSpecificData;
 
@@ -0,0 +1,149 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncFileReader.hh
+ **
+ ** \brief Sequential file reader that reads ahead on a helper thread into aligned buffers, optionally bypassing
+ **        page cache.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_ASYNC_FILE_READER_HH
+#define iSAAC_IO_ASYNC_FILE_READER_HH
+
+#include <cstdint>
+#include <memory>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Reads a range of a file sequentially. While the client consumes one block, the next one is read by the
+ *        helper thread.
+ *
+ * With directIo, the file is opened with O_DIRECT so that the data does not go through page cache. If the file
+ * system does not support O_DIRECT, or refuses O_DIRECT reads with EINVAL, the file is read through page cache
+ * and the pages are dropped from the cache once read.
+ *
+ * All buffers and the helper thread are allocated by the constructor. open, read and close do not allocate dynamic
+ * memory.
+ */
+class AsyncFileReader : boost::noncopyable
+{
+public:
+    /// O_DIRECT requires buffer addresses, file offsets and read sizes aligned at the logical block size
+    static const std::size_t DIRECT_IO_ALIGNMENT = 4096;
+    static const std::size_t DEFAULT_BLOCK_BYTES = 4 * 1024 * 1024;
+    /// pass as bytes to open to read from offset to the end of the file
+    static const uint64_t UNTIL_EOF = -1UL;
+
+    struct Counters
+    {
+        Counters() : bytes_(0), readMicroseconds_(0), waitMicroseconds_(0), direct_(false) {}
+        /// bytes delivered to the client
+        uint64_t bytes_;
+        /// time the helper thread spent in reading
+        uint64_t readMicroseconds_;
+        /// time the client spent waiting for the data to arrive
+        uint64_t waitMicroseconds_;
+        /// true if the file was opened with O_DIRECT
+        bool direct_;
+    };
+
+    AsyncFileReader(const bool directIo, const std::size_t blockBytes = DEFAULT_BLOCK_BYTES);
+    ~AsyncFileReader();
+
+    /**
+     * \brief Opens the file and starts reading bytes from offset. Closes the previously open file if any.
+     */
+    void open(const char *path, const uint64_t offset, uint64_t bytes);
+
+    /**
+     * \brief Copies the next bytes of the range into buffer.
+     *
+     * \return number of bytes copied. Less than bytes only when the end of the range or the end of file is reached
+     */
+    std::size_t read(char *buffer, std::size_t bytes);
+
+    /**
+     * \brief Waits for the outstanding read to complete and closes the file.
+     */
+    void close();
+
+    /// Counters accumulate over all files opened since the last reset
+    void resetCounters() {counters_ = Counters();}
+
+    /// file offset of the next byte read will return
+    uint64_t tell() const {return tell_;}
+    const Counters &getCounters() const {return counters_;}
+    const char *getPath() const {return path_;}
+
+private:
+    struct Block
+    {
+        Block() : data_(0), requested_(false), ready_(false), last_(false), fileOffset_(0), begin_(0), end_(0), errno_(0) {}
+        char *data_;
+        bool requested_;
+        bool ready_;
+        /// no data follows the end_ of this block
+        bool last_;
+        uint64_t fileOffset_;
+        std::size_t begin_;
+        std::size_t end_;
+        int errno_;
+    };
+
+    const bool directIo_;
+    const std::size_t blockBytes_;
+    std::unique_ptr<char, void (*)(void *)> buffer_;
+    Block blocks_[2];
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool terminate_;
+
+    int fd_;
+    const char *path_;
+    uint64_t rangeBegin_;
+    uint64_t rangeEnd_;
+    // aligned file offset of the next block to be requested
+    uint64_t nextRequestOffset_;
+    // block the client is consuming
+    unsigned current_;
+    uint64_t tell_;
+    Counters counters_;
+
+    // must be initialized last as the thread starts straight away
+    boost::thread thread_;
+
+    void request(const unsigned blockIndex);
+    Block &waitReady(const unsigned blockIndex);
+    void readBlock(Block &block);
+    /**
+     * \brief Replaces the O_DIRECT descriptor with a buffered one. Called by the helper thread with mutex_ locked
+     *
+     * \return false if the file could not be reopened
+     */
+    bool reopenBuffered();
+    void threadFunc();
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_ASYNC_FILE_READER_HH
@@ -0,0 +1,119 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncGzipDecompressor.hh
+ **
+ ** \brief Decompresses gzip stream on a helper thread ahead of the client.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_ASYNC_GZIP_DECOMPRESSOR_HH
+#define iSAAC_IO_ASYNC_GZIP_DECOMPRESSOR_HH
+
+#include <exception>
+#include <istream>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "io/InflateGzipDecompressor.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Inflates a regular (single or multi-member) gzip stream into one block while the client consumes
+ *        the other one. Reading and inflating the compressed data is then overlapped with parsing the
+ *        uncompressed data.
+ *
+ * All buffers are allocated by the constructor. The helper thread is started by the first start(), so that
+ * instances that never decompress anything don't hold a thread.
+ */
+class AsyncGzipDecompressor : boost::noncopyable
+{
+public:
+    static const std::size_t DEFAULT_BLOCK_BYTES = 4 * 1024 * 1024;
+
+    AsyncGzipDecompressor(const std::size_t blockBytes = DEFAULT_BLOCK_BYTES);
+    ~AsyncGzipDecompressor();
+
+    /**
+     * \brief Starts decompressing compressedStream on the helper thread. Launches the thread on first call.
+     *        compressedStream must remain valid until reset or destruction.
+     */
+    void start(std::istream &compressedStream);
+
+    /**
+     * \brief Stops decompression and discards the data that has not been read by the client.
+     */
+    void reset();
+
+    /**
+     * \brief Copies up to amount of uncompressed bytes into buffer.
+     *
+     * \return number of bytes copied. Less than amount only when the end of compressed data is reached
+     */
+    std::size_t read(char *buffer, std::size_t amount);
+
+    /// true when all the uncompressed data has been delivered to the client
+    bool isEof() const {return eof_;}
+
+private:
+    typedef std::vector<char> BufferType;
+
+    struct Block
+    {
+        Block() : ready_(false), last_(false), begin_(0), end_(0) {}
+        BufferType data_;
+        bool ready_;
+        bool last_;
+        std::size_t begin_;
+        std::size_t end_;
+        std::exception_ptr error_;
+    };
+
+    InflateGzipDecompressor<BufferType> inflater_;
+    Block blocks_[2];
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool terminate_;
+
+    std::istream *compressedStream_;
+    // helper thread fills blocks while this is set
+    bool active_;
+    // helper thread is inflating outside of the lock
+    bool inflating_;
+    // next block the helper thread will fill
+    unsigned produce_;
+    // block the client is consuming
+    unsigned consume_;
+    bool eof_;
+
+    // not-a-thread until the first start
+    boost::thread thread_;
+
+    void fill(Block &block);
+    void threadFunc();
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_ASYNC_GZIP_DECOMPRESSOR_HH
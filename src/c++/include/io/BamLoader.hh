@@ -20,10 +20,13 @@
 #ifndef iSAAC_IO_BAM_LOADER_HH
 #define iSAAC_IO_BAM_LOADER_HH
 
+#include <memory>
+
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 
-#include "bgzf/BgzfReader.hh"
+#include "bgzf/BgzfInflatePipeline.hh"
+#include "io/CramDecodePipeline.hh"
 #include "flowcell/ReadMetadata.hh"
 #include "bam/BamParser.hh"
 #include "reference/ReferencePosition.hh"
@@ -41,6 +44,11 @@ struct BamLoaderException : common::IoException
     BamLoaderException(const std::string &message) : common::IoException(EINVAL, message){}
 };
 
+/**
+ * \brief Parses bam records in place in the buffers inflated by BgzfInflatePipeline or decoded from cram by
+ *        CramDecodePipeline. The records of the buffer parsed during the previous pass stay available until the
+ *        current buffer is parsed.
+ */
 class BamLoader
 {
     // give more than one thread a chance to unpack a decent number of bgzf blocks.
@@ -50,253 +58,92 @@ class BamLoader
     // that will result in the same buffer size through the run.
     static const unsigned BGZF_BLOCKS_PER_CLUSTER_BLOCK = 10000;
     static const unsigned UNPARSED_BYTES_MAX = 1024*100;
+    // small batches keep all inflaters busy until the end of each buffer
+    static const unsigned BGZF_BLOCKS_PER_BATCH = 16;
+    // previous, current and at least one being inflated ahead
+    static const unsigned PIPELINE_BUFFERS = 3;
 
-    bgzf::ParallelBgzfReader bgzfReader_;
+    // cram containers decoded into one buffer. Keeps the buffers about as big as the bgzf ones for typical containers
+    static const unsigned CRAM_CONTAINERS_PER_BUFFER = 64;
 
-    // previous pass content of currentPassBam_. Assumed that processor is interested to
-    // be able to access both buffers at the same time in order to deal with pairs (or reads) that
-    // overlap the buffer boundary
-    std::vector<char> lastPassBam_;
+    template <typename PipelineT>
+    struct Passes
+    {
+        Passes() : last_(0), current_(0){}
+        // buffer parsed by the previous pass. Its records are valid until removeOld is called for it
+        typename PipelineT::Buffer *last_;
+        // buffer being parsed
+        typename PipelineT::Buffer *current_;
+    };
+
+    const unsigned coresMax_;
+    const cram::References references_;
+    bgzf::BgzfInflatePipeline pipeline_;
+    // created when the first cram file is opened
+    std::unique_ptr<CramDecodePipeline> cramPipeline_;
+    bool cram_;
+
+    Passes<bgzf::BgzfInflatePipeline> bgzfPasses_;
+    Passes<CramDecodePipeline> cramPasses_;
+    // bytes at the end of the last pass buffer that did not make a complete record
     unsigned lastUnparsedBytes_;
+    // position in the current pass buffer where the parsing resumes
+    const char *unparsedBegin_;
 
     bam::BamParser bamParser_;
 
-    const std::size_t decompressParseParallelization_;
-    std::vector<unsigned> unparsedBytes_;
-    std::vector<std::vector<char> > decompressionBuffers_;
-    common::ThreadVector &decompressParseParallelizationThreads_;
-    boost::mutex mutex_;
-    boost::condition_variable stateChangedCondition_;
-    unsigned nextDecompressorThread_;
-    unsigned nextParserThread_;
-
 public:
     static const std::size_t BUFFER_SIZE = UNPARSED_BYTES_MAX + bgzf::BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE * BGZF_BLOCKS_PER_CLUSTER_BLOCK;
 
+    /**
+     * \param references  reference sequences to decode cram files against. Empty list makes all cram reference
+     *                    bases N, which is sufficient for obtaining the read metadata.
+     */
     BamLoader(
         std::size_t maxPathLength,
-        common::ThreadVector &threads,
-        const unsigned coresMax);
+        const unsigned coresMax,
+        const cram::References &references);
 
-    void open(const boost::filesystem::path &bamPath)
-    {
-        lastUnparsedBytes_ = 0;
-        nextDecompressorThread_ = 0;
-        nextParserThread_ = 0;
-        bgzfReader_.open(bamPath);
-        bamParser_.reset();
-        std::fill(unparsedBytes_.begin(), unparsedBytes_.end(), 0);
-        std::for_each(decompressionBuffers_.begin(), decompressionBuffers_.end(), boost::bind(&std::vector<char>::clear, _1));
-    }
+    /**
+     * \brief Opens bam or cram file. The format is determined from the file contents
+     */
+    void open(const boost::filesystem::path &bamPath);
 
     template <typename ProcessorT>
-    void load(ProcessorT processor);
-
-private:
-    template <typename RecordProcessorT>
-    void parallelLoad(const unsigned threadNumber,
-        bool &wantMoreData, bool &exception, RecordProcessorT processor);
-    template <typename RecordProcessorRemoveOldT>
-    void swapBuffers(RecordProcessorRemoveOldT removeOld, std::vector<char> &current, unsigned &unparsedBytes);
-    void waitForLoadSlot(boost::unique_lock<boost::mutex> &lock, bool &exception, const unsigned threadNumber);
-    void returnLoadSlot(bool &terminateAll, const bool exceptionStackUnwinding);
-    bool waitForParseSlot(boost::unique_lock<boost::mutex> &lock, bool &wantMoreData, bool &exception, const unsigned threadNumber);
-    void returnParseSlot(const bool suspending, bool &terminateAll, const bool exceptionStackUnwinding);
-    void reserveBuffers(std::size_t maxPathLength);
-};
-
-
-/**
- * \brief Exchanges last and current buffers. Resets current buffer, removes all index entries that
- *        have been processed by the previous pass
- */
-template <typename RecordProcessorRemoveOldT>
-void BamLoader::swapBuffers(RecordProcessorRemoveOldT removeOld, std::vector<char> &current, unsigned &unparsedBytes)
-{
-    if (!lastPassBam_.empty())
-    {
-        // .base() does not work with debug glibc for gcc 4.8
-        // removeOld requires pointers to determine whether the object belongs to the memory block being freed.
-        // Iterators will not work
-        removeOld(&lastPassBam_.front(), &lastPassBam_.back()+1);
-    }
-    lastPassBam_.swap(current);
-    lastUnparsedBytes_ = unparsedBytes;
-    unparsedBytes = 0;
-    current.clear();
-}
-
-inline void BamLoader::waitForLoadSlot(boost::unique_lock<boost::mutex> &lock, bool &exception, const unsigned threadNumber)
-{
-    while(nextDecompressorThread_ != threadNumber)
+    void load(ProcessorT processor)
     {
-        if (exception)
+        if (cram_)
         {
-            BOOST_THROW_EXCEPTION(BamLoaderException(
-                (boost::format("Terminating waitForLoadSlot on thread %d as another thread had an exception") % threadNumber).str()));
-        }
-        stateChangedCondition_.wait(lock);
-    }
-}
-
-inline void BamLoader::returnLoadSlot(bool &terminateAll, const bool exceptionStackUnwinding)
-{
-    if (exceptionStackUnwinding)
-    {
-        terminateAll = true;
-    }
-    else
-    {
-        nextDecompressorThread_ = (nextDecompressorThread_ + 1) % decompressParseParallelization_;
-    }
-    stateChangedCondition_.notify_all();
-}
-
-inline bool BamLoader::waitForParseSlot(boost::unique_lock<boost::mutex> &lock, bool &wantMoreData, bool &exception, const unsigned threadNumber)
-{
-    while(wantMoreData && nextParserThread_ != threadNumber)
-    {
-        if (exception)
-        {
-            BOOST_THROW_EXCEPTION(BamLoaderException(
-                (boost::format("Terminating waitForParseSlot on thread %d as another thread had an exception") % threadNumber).str()));
-        }
-
-        stateChangedCondition_.wait(lock);
-    }
-
-    return wantMoreData;
-}
-
-inline void BamLoader::returnParseSlot(const bool suspending, bool &terminateAll, const bool exceptionStackUnwinding)
-{
-    if (exceptionStackUnwinding)
-    {
-        terminateAll = true;
-    }
-    else
-    {
-        if (!suspending)
-        {
-            nextParserThread_ = (nextParserThread_ + 1) % decompressParseParallelization_;
+            load(*cramPipeline_, cramPasses_, processor);
         }
         else
         {
-            ISAAC_THREAD_CERR << "BamLoader::returnParseSlot nextParserThread_:" << nextParserThread_ << std::endl;
+            load(pipeline_, bgzfPasses_, processor);
         }
     }
-    stateChangedCondition_.notify_all();
-    // otherwise, the thread will need to repeat parsing as some of the data did not fit into processor
-}
 
-template <typename RecordProcessorT>
-void BamLoader::parallelLoad(
-    const unsigned threadNumber,
-    bool &wantMoreData, bool &exception,
-    RecordProcessorT processor)
-{
-    boost::unique_lock<boost::mutex> lock(mutex_);
-
-    while (!exception && wantMoreData)
-    {
-        if(decompressionBuffers_[threadNumber].empty())
-        {
-            waitForLoadSlot(lock, exception, threadNumber);
-            ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&BamLoader::returnLoadSlot, this, boost::ref(exception), _1))
-            {
-                decompressionBuffers_[threadNumber].resize(UNPARSED_BYTES_MAX);
-                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-                if (!bgzfReader_.readMoreData(decompressionBuffers_[threadNumber]))
-                {
-                    decompressionBuffers_[threadNumber].clear();
-                    ISAAC_THREAD_CERR << "no more data on thread " << threadNumber << std::endl;
-                    // don't return just here. Let the code below do one
-                    // last swapBuffer to flush the last piece of unpaired reads
-                }
-                ISAAC_THREAD_CERR << "read " << decompressionBuffers_[threadNumber].size() << " bytes, done on thread " << threadNumber << std::endl;
-            }
-        }
-        else
-        {
-            // This means we've filled decompressionBuffer_ during last parallelLoad call, but the parser was not able to finish
-            // processing currentPassBam_. Just wait until it is done
-            ISAAC_THREAD_CERR << "Thread " << threadNumber << " already has " << decompressionBuffers_[threadNumber].size() << " bytes" << std::endl;
-        }
+private:
+    template <typename PipelineT, typename ProcessorT>
+    void load(PipelineT &pipeline, Passes<PipelineT> &passes, ProcessorT processor);
 
-        if (!waitForParseSlot(lock, wantMoreData, exception, threadNumber))
-        {
-            break;
-        }
+    template <typename PipelineT, typename RecordProcessorRemoveOldT>
+    void releaseLastPass(PipelineT &pipeline, Passes<PipelineT> &passes, RecordProcessorRemoveOldT removeOld);
+};
 
-        bool suspending = false;
-        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&BamLoader::returnParseSlot, this, boost::ref(suspending), boost::ref(exception), _1))
-        {
-            if (!decompressionBuffers_[threadNumber].empty())
-            {
-                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-                std::vector<char>::const_iterator unparsedBegin;
-                if (unparsedBytes_[threadNumber])
-                {
-                    ISAAC_ASSERT_MSG(!lastUnparsedBytes_, "lastUnparsedBytes_ must be 0 on resume. Got: " << lastUnparsedBytes_);
-                    if (-1U == unparsedBytes_[threadNumber])
-                    {
-                        ISAAC_THREAD_CERR << "force-resuming on thread " << threadNumber << " unparsed: " << unparsedBytes_[threadNumber] << std::endl;
-                        unparsedBegin = decompressionBuffers_[threadNumber].end();
-                    }
-                    else
-                    {
-                        unparsedBegin = decompressionBuffers_[threadNumber].end() - unparsedBytes_[threadNumber];
-                        ISAAC_THREAD_CERR << "resuming on thread " << threadNumber << " unparsed: " << unparsedBytes_[threadNumber] << std::endl;
-                    }
-                }
-                else
-                {
-                    ISAAC_ASSERT_MSG(lastUnparsedBytes_ <= UNPARSED_BYTES_MAX, "Too much unparsed from previous step: " << lastUnparsedBytes_);
-                    std::copy(lastPassBam_.end() - lastUnparsedBytes_, lastPassBam_.end(), decompressionBuffers_[threadNumber].begin() + UNPARSED_BYTES_MAX - lastUnparsedBytes_);
-                    unparsedBegin = decompressionBuffers_[threadNumber].begin() + UNPARSED_BYTES_MAX - lastUnparsedBytes_;
-                    lastUnparsedBytes_ = 0;
-                }
-                wantMoreData = bamParser_.parse(unparsedBegin, decompressionBuffers_[threadNumber].end(), boost::get<0>(processor));
-                // TODO: here the assumption is that unparsedBytes_ will point at the last bam block that did not end in the buffer.
-                // Currently processor does not stop in the middle of indexing, but if it did that, we'd be forced to
-                // potentially copy more than UNPARSED_BYTES_MAX of data into the next buffer.
-                unparsedBytes_[threadNumber] = std::distance<std::vector<char>::const_iterator>(unparsedBegin, decompressionBuffers_[threadNumber].end());
 
-                if (wantMoreData)
-                {
-                    swapBuffers(boost::get<1>(processor), decompressionBuffers_[threadNumber], unparsedBytes_[threadNumber]);
-                    ISAAC_ASSERT_MSG(lastUnparsedBytes_ <= UNPARSED_BYTES_MAX, "Too much unparsed from this step: " << lastUnparsedBytes_);
-                    suspending = false;
-                }
-                else
-                {
-                    if(!unparsedBytes_[threadNumber])
-                    {
-                        ISAAC_THREAD_CERR << "force-suspending on thread " << threadNumber << " wantMoreData: " << wantMoreData << " lastUnparsedBytes_:" << lastUnparsedBytes_ << std::endl;
-                        unparsedBytes_[threadNumber] = -1U;
-                    }
-                    else
-                    {
-                        ISAAC_THREAD_CERR << "suspending on thread " << threadNumber << " unparsed: " << unparsedBytes_[threadNumber] << " lastUnparsedBytes_:" << lastUnparsedBytes_ << std::endl;
-                    }
-                    suspending = true;
-                }
-            }
-            else
-            {
-                ISAAC_ASSERT_MSG(bgzfReader_.isEof(), "Expected end of compressed bam data stream");
-                if (lastUnparsedBytes_)
-                {
-                    BOOST_THROW_EXCEPTION(BamLoaderException(
-                        (boost::format("Reached the end of the bam file with %d bytes unparsed. Truncated Bam?") % lastUnparsedBytes_).str()));
-                }
-                // no more data to process
-                // ensure processor has a chance to deal with the last batch of blocks
-                swapBuffers(boost::get<1>(processor), decompressionBuffers_[threadNumber], unparsedBytes_[threadNumber]);
-                // break the loop
-                wantMoreData = false;
-            }
-        }
+/**
+ * \brief Lets the processor deal with the records of the last pass buffer and returns the buffer to the pipeline
+ */
+template <typename PipelineT, typename RecordProcessorRemoveOldT>
+void BamLoader::releaseLastPass(PipelineT &pipeline, Passes<PipelineT> &passes, RecordProcessorRemoveOldT removeOld)
+{
+    if (passes.last_)
+    {
+        // removeOld requires pointers to determine whether the object belongs to the memory block being freed.
+        // The records carried over from the previous buffer live in the headroom
+        removeOld(passes.last_->data_, passes.last_->end());
+        pipeline.release(*passes.last_);
+        passes.last_ = 0;
     }
 }
 
@@ -312,20 +159,53 @@ void BamLoader::parallelLoad(
  *                   boost::get<1>(processor) is called whenever the parsed data is about to be freed:
  *                      removeOld(const BamBlockHeader *begin, const BamBlockHeader *end) where begin and end
  *                      specify the range of earlier supplied &block pointers that will become invalid.
+ *
+ * When processBlock returns false, load returns and the next call resumes from the following record.
  */
-template <typename ProcessorT>
-void BamLoader::load(ProcessorT processor)
+template <typename PipelineT, typename ProcessorT>
+void BamLoader::load(PipelineT &pipeline, Passes<PipelineT> &passes, ProcessorT processor)
 {
-    bool wantMoreData = true;
-    bool exception = false;
+    while (true)
+    {
+        if (!passes.current_)
+        {
+            passes.current_ = pipeline.next();
+            if (!passes.current_)
+            {
+                if (lastUnparsedBytes_)
+                {
+                    BOOST_THROW_EXCEPTION(BamLoaderException(
+                        (boost::format("Reached the end of the bam file with %d bytes unparsed. Truncated Bam?") % lastUnparsedBytes_).str()));
+                }
+                // ensure processor has a chance to deal with the last batch of blocks
+                releaseLastPass(pipeline, passes, boost::get<1>(processor));
+                return;
+            }
+            // the record that did not fit into the last pass buffer goes in front of the current one
+            unparsedBegin_ = passes.current_->begin() - lastUnparsedBytes_;
+            if (lastUnparsedBytes_)
+            {
+                std::copy(passes.last_->end() - lastUnparsedBytes_, passes.last_->end(), passes.current_->begin() - lastUnparsedBytes_);
+                lastUnparsedBytes_ = 0;
+            }
+        }
 
-    decompressParseParallelizationThreads_.execute(
-        boost::bind(&BamLoader::parallelLoad<ProcessorT>, this,
-                    _1, boost::ref(wantMoreData), boost::ref(exception),
-                    processor),
-        // parse has to be sequential, so maximum 2 threads can do the decompress/parse parallelization
-        std::min(decompressParseParallelizationThreads_.size(), decompressParseParallelization_));
+        const bool wantMoreData = bamParser_.parse(unparsedBegin_, passes.current_->end(), boost::get<0>(processor));
+        if (!wantMoreData)
+        {
+            return;
+        }
 
+        lastUnparsedBytes_ = std::distance<const char *>(unparsedBegin_, passes.current_->end());
+        if (lastUnparsedBytes_ > UNPARSED_BYTES_MAX)
+        {
+            BOOST_THROW_EXCEPTION(BamLoaderException(
+                (boost::format("Bam record is too long: %d bytes") % lastUnparsedBytes_).str()));
+        }
+        releaseLastPass(pipeline, passes, boost::get<1>(processor));
+        passes.last_ = passes.current_;
+        passes.current_ = 0;
+    }
 }
 //#pragma GCC pop_options
 
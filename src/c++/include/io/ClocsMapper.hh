@@ -12,7 +12,8 @@
  **
  ** \file ClocsMapper.hh
  **
- ** Helper class for mapping compressed position files into memory.
+ ** Helper class for mapping compressed position files into memory. The bins are expanded into positions
+ ** only when the positions are requested.
  **
  ** \author Roman Petrovski
  **/
@@ -20,8 +21,11 @@
 #ifndef iSAAC_IO_CLOCS_MAPPER_HH
 #define iSAAC_IO_CLOCS_MAPPER_HH
 
+#include <boost/format.hpp>
+
 #include "common/Debug.hh"
 #include "flowcell/TileMetadata.hh"
+#include "io/MappedFile.hh"
 
 namespace isaac
 {
@@ -31,15 +35,13 @@ namespace io
 class ClocsMapper
 {
 public:
-    ClocsMapper() :
-        fileBufCache_(1, std::ios_base::in | std::ios_base::binary), clusterCount_(0)
+    ClocsMapper() : clusterCount_(0)
     {
     }
 
     void mapTile(const boost::filesystem::path &clocsFilePath, const unsigned clusterCount)
     {
         clusterCount_ = clusterCount;
-        tileData_.clear();
         load(clocsFilePath, V1);
     }
 
@@ -51,14 +53,12 @@ public:
 
     void reserveBuffers(const size_t reservePathLength, const unsigned maxClusterCount)
     {
-        fileBufCache_.reservePathBuffers(reservePathLength);
-        tileData_.reserve(FILE_BYTES_MAX);
+        file_.reservePathBuffer(reservePathLength);
     }
 
     void unreserve()
     {
-        std::vector<char>().swap(tileData_);
-        fileBufCache_.unreserve();
+        file_.unmap();
     }
 private:
     // Bizarre format documented here http://ukch-confluence.illumina.com/display/SWD/RTA+clocs+file+format
@@ -93,9 +93,8 @@ private:
     static const int BLOCK_BYTES_MAX = 1 + 255 * 2;// count of clusters plus max number of clusters times two bytes
     static const std::size_t FILE_BYTES_MAX = sizeof(V0Header::Header) + BLOCKS_PER_LINE * BLOCKS_PER_COLUMN * BLOCK_BYTES_MAX;
 
-    io::FileBufCache<io::FileBufWithReopen> fileBufCache_;
+    MappedFile file_;
     unsigned clusterCount_;
-    std::vector<char> tileData_;
     enum Version
     {
         V1 = 1
@@ -104,14 +103,19 @@ private:
     template <typename InsertIteratorT>
     void getPositions(InsertIteratorT it, unsigned clusters) const
     {
-        const V0Header &header = reinterpret_cast<const V0Header &>(tileData_.front());
+        const V0Header &header = reinterpret_cast<const V0Header &>(*file_.data());
 
         const V0Header::Block *currentBlock = header.blocks_;
         int currentBlockX = 0;
         int currentBlockY = 0;
         while (clusters)
         {
-            ISAAC_ASSERT_MSG(reinterpret_cast<const char *>(currentBlock) <= &tileData_.back(), "Went outside the clocs file content.");
+            if (reinterpret_cast<const char *>(currentBlock) >= file_.end() ||
+                reinterpret_cast<const char *>(currentBlock->xy_ + currentBlock->clusters_) > file_.end())
+            {
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+                    "Clocs file %s ends before all %d clusters are described") % file_.getPath() % clusterCount_).str()));
+            }
             unsigned char currentBlockClusters = currentBlock->clusters_;
             const V0Header::Block::BlockOffset *currentBlockCluster = currentBlock->xy_;
             while (currentBlockClusters--)
@@ -135,32 +139,26 @@ private:
 
     void load(const boost::filesystem::path &clocsFilePath, Version assumedVersion)
     {
-        std::istream is(fileBufCache_.get(clocsFilePath));
-        if (!is)
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open %s: %s") % clocsFilePath % strerror(errno)).str()));
-        }
+        file_.map(clocsFilePath);
 
-        std::size_t fileSize = common::getFileSize(clocsFilePath.c_str());
-        if (fileSize > FILE_BYTES_MAX)
+        if (file_.size() > FILE_BYTES_MAX)
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Clocs file is bigger than supported maximum %s: %d") % clocsFilePath % fileSize).str()));
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Clocs file is bigger than supported maximum %s: %d") % clocsFilePath % file_.size()).str()));
         }
 
-        tileData_.resize(fileSize);
-        if (!is.read(&tileData_.front(), fileSize))
+        if (file_.size() < sizeof(V0Header::Header))
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes from %s") %
-                fileSize % clocsFilePath ).str()));
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Failed to read %d bytes from %s") %
+                sizeof(V0Header::Header) % clocsFilePath ).str()));
         }
 
-        const V0Header &header = reinterpret_cast<const V0Header &>(tileData_.front());
+        const V0Header &header = reinterpret_cast<const V0Header &>(*file_.data());
         if (header.header_.version_ !=  assumedVersion)
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Unsupported clocs file version %s: %d") % clocsFilePath % int(header.header_.version_)).str()));
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Unsupported clocs file version %s: %d") % clocsFilePath % int(header.header_.version_)).str()));
         }
 
-        ISAAC_THREAD_CERR << "Read " << clusterCount_ << " position values from clocs file version " << assumedVersion << ": " << clocsFilePath << std::endl;
+        ISAAC_THREAD_CERR << "Mapped " << clusterCount_ << " position values from clocs file version " << assumedVersion << ": " << clocsFilePath << std::endl;
     }
 };
 
@@ -0,0 +1,216 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file Cram.hh
+ **
+ ** \brief CRAM 3.0 containers, blocks and the decoder that turns CRAM containers into bam records.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_CRAM_HH
+#define iSAAC_IO_CRAM_HH
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "common/Exceptions.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+struct CramException : common::IoException
+{
+    CramException(const std::string &message) : common::IoException(EINVAL, message){}
+};
+
+namespace cram
+{
+
+enum BlockMethod
+{
+    RAW = 0,
+    GZIP = 1,
+    BZIP2 = 2,
+    LZMA = 3,
+    RANS = 4
+};
+
+enum BlockContentType
+{
+    FILE_HEADER = 0,
+    COMPRESSION_HEADER = 1,
+    MAPPED_SLICE = 2,
+    EXTERNAL_DATA = 4,
+    CORE_DATA = 5
+};
+
+enum CodecId
+{
+    NULL_CODEC = 0,
+    EXTERNAL = 1,
+    HUFFMAN = 3,
+    BYTE_ARRAY_LEN = 4,
+    BYTE_ARRAY_STOP = 5,
+    BETA = 6,
+    SUBEXP = 7,
+    GAMMA = 9
+};
+
+// CF data series bits
+static const int CF_QUALITY_ARRAY = 0x01;
+static const int CF_DETACHED = 0x02;
+static const int CF_MATE_DOWNSTREAM = 0x04;
+static const int CF_NO_SEQUENCE = 0x08;
+
+// MF data series bits
+static const int MF_REVERSE = 0x01;
+static const int MF_UNMAPPED = 0x02;
+
+static const int32_t MULTIPLE_REFERENCES = -2;
+
+/// "CRAM", major, minor and 20 bytes of file id
+static const std::size_t FILE_DEFINITION_LENGTH = 26;
+static const std::size_t EOF_CONTAINER_LENGTH = 38;
+extern const char EOF_CONTAINER[EOF_CONTAINER_LENGTH];
+
+void putItf8(std::vector<char> &buffer, const int32_t value);
+void putLtf8(std::vector<char> &buffer, const int64_t value);
+void putInt32(std::vector<char> &buffer, const int32_t value);
+
+const char *getItf8(const char *p, const char *end, int32_t &value);
+const char *getLtf8(const char *p, const char *end, int64_t &value);
+const char *getInt32(const char *p, const char *end, int32_t &value);
+
+struct ContainerHeader
+{
+    ContainerHeader() : length_(0), refId_(0), start_(0), span_(0), records_(0), recordCounter_(0), bases_(0), blocks_(0){}
+    // bytes of blocks following the header
+    int32_t length_;
+    int32_t refId_;
+    // 1-based
+    int32_t start_;
+    int32_t span_;
+    int32_t records_;
+    int64_t recordCounter_;
+    int64_t bases_;
+    int32_t blocks_;
+    // slice offsets relative to the end of the container header
+    std::vector<int32_t> landmarks_;
+};
+
+/**
+ * \return false if the stream is at its end before the first byte of the header
+ */
+bool readContainerHeader(std::istream &is, ContainerHeader &header);
+void putContainerHeader(std::vector<char> &buffer, const ContainerHeader &header);
+
+struct Block
+{
+    Block() : method_(RAW), contentType_(EXTERNAL_DATA), contentId_(0){}
+    unsigned char method_;
+    unsigned char contentType_;
+    int32_t contentId_;
+    // uncompressed
+    std::vector<char> data_;
+};
+
+/**
+ * \brief Parses the block at p and uncompresses its data
+ *
+ * \return pointer to the first byte after the block
+ */
+const char *readBlock(const char *p, const char *end, Block &block);
+
+/**
+ * \brief Appends a block compressed with gzip unless that does not make it any smaller
+ */
+void putBlock(
+    std::vector<char> &buffer,
+    const BlockContentType contentType,
+    const int32_t contentId,
+    const std::vector<char> &data,
+    const int gzipLevel);
+
+/**
+ * \brief Reference sequence to diff the read bases against. Bases are expected in upper case with anything that is
+ *        not ACGT being N. 0 bases_ make all reference bases N.
+ */
+struct Reference
+{
+    Reference(const std::string &name, const std::size_t length, const char *bases) :
+        name_(name), length_(length), bases_(bases){}
+    std::string name_;
+    std::size_t length_;
+    const char *bases_;
+
+    char base(const int64_t pos) const
+    {
+        return (bases_ && 0 <= pos && std::size_t(pos) < length_) ? bases_[pos] : 'N';
+    }
+};
+typedef std::vector<Reference> References;
+
+/**
+ * \brief Checks the first bytes of the file for the cram magic
+ */
+bool isCram(const boost::filesystem::path &path);
+
+/**
+ * \brief Reads the file definition and the SAM header container
+ *
+ * \return SAM header text
+ */
+std::string readFileHeader(std::istream &is);
+
+} // namespace cram
+
+/**
+ * \brief Turns CRAM containers into sequences of uncompressed bam records. decodeContainer does not modify the
+ *        decoder state and is safe to call from multiple threads.
+ */
+class CramDecoder
+{
+public:
+    /**
+     * \brief Maps @SQ lines of the SAM header onto references by name and length.
+     *
+     * \param references  When empty, all reference bases are decoded as N, which is good enough to obtain the
+     *                    read metadata.
+     */
+    void open(const std::string &samHeader, const cram::References &references);
+
+    /**
+     * \brief appends bam records decoded from the container data to bam
+     */
+    void decodeContainer(
+        const cram::ContainerHeader &header,
+        const char *data,
+        const char *dataEnd,
+        std::vector<char> &bam) const;
+
+private:
+    static const cram::Reference noReference_;
+    // reference for each @SQ line of the header
+    std::vector<const cram::Reference *> sqReferences_;
+    std::vector<std::string> readGroups_;
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_CRAM_HH
@@ -0,0 +1,156 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramDecodePipeline.hh
+ **
+ ** \brief Reads and decodes CRAM containers into a ring of bam buffers ahead of the client.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_CRAM_DECODE_PIPELINE_HH
+#define iSAAC_IO_CRAM_DECODE_PIPELINE_HH
+
+#include <exception>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "io/Cram.hh"
+#include "io/FileBufWithReopen.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief One reader thread splits the CRAM stream into containers and assigns them to the buffer being filled.
+ *        Decoder threads turn the containers into bam records. The client receives complete buffers in file order
+ *        with the records of all the buffer containers laid out contiguously.
+ *
+ * The stream looks to the client like an uncompressed bam file: the first buffer starts with an empty bam header.
+ * Each buffer has headroom in front of the records that the client is free to use for the data carried over from
+ * the previous buffer, same as with BgzfInflatePipeline.
+ *
+ * The way records are split between buffers depends only on the container boundaries, not on the number of
+ * threads.
+ */
+class CramDecodePipeline : boost::noncopyable
+{
+public:
+    struct Buffer;
+
+private:
+    struct Container
+    {
+        Container() : buffer_(0) {}
+        Buffer *buffer_;
+        cram::ContainerHeader header_;
+        std::vector<char> compressed_;
+        std::vector<char> decoded_;
+    };
+
+public:
+    struct Buffer
+    {
+        Buffer() : data_(0), headroom_(0), containersUsed_(0), pendingContainers_(0), sealed_(false), free_(true) {}
+        /// first byte of the headroom
+        char *data_;
+        /// first byte of the bam data
+        char *begin() const {return data_ + headroom_;}
+        /// end of the bam data
+        char *end() const {return data_ + bam_.size();}
+
+    private:
+        friend class CramDecodePipeline;
+        std::size_t headroom_;
+        // headroom followed by the decoded records of all containers
+        std::vector<char> bam_;
+        std::vector<Container> containers_;
+        // containers assigned to the buffer so far
+        unsigned containersUsed_;
+        // containers assigned to the buffer and not yet decoded
+        unsigned pendingContainers_;
+        // no more containers will be assigned to the buffer
+        bool sealed_;
+        // neither filled by the pipeline, nor held by the client
+        bool free_;
+    };
+
+    CramDecodePipeline(
+        const unsigned decodersCount,
+        const unsigned buffersCount,
+        const unsigned containersPerBuffer,
+        const std::size_t headroom);
+
+    ~CramDecodePipeline();
+
+    /**
+     * \brief Stops processing the previous file if any, releases all buffers and starts reading filePath
+     *
+     * \param references  reference sequences to decode the reads against. Must stay valid until the next open.
+     */
+    void open(const boost::filesystem::path &filePath, const cram::References &references);
+
+    /**
+     * \brief Waits for the next buffer in the file order
+     *
+     * \return 0 at the end of file. The buffer stays valid until released.
+     */
+    Buffer *next();
+
+    /**
+     * \brief Returns the buffer to the pipeline. Buffers must be released in the order they were received.
+     */
+    void release(Buffer &buffer);
+
+private:
+    const unsigned containersPerBuffer_;
+    std::vector<Buffer> buffers_;
+    std::vector<Container *> decodeQueue_;
+    CramDecoder decoder_;
+
+    io::FileBufWithReopen fileBuffer_;
+    std::istream is_;
+
+    boost::mutex mutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool terminate_;
+    // reader thread is allowed to read
+    bool reading_;
+    // reader thread is reading outside of the lock
+    bool readerBusy_;
+    // containers being decoded outside of the lock
+    unsigned decodersBusy_;
+    bool eof_;
+    std::exception_ptr error_;
+    unsigned fillBuffer_;
+    unsigned nextBuffer_;
+    // the first buffer of the file has not been given to the client yet
+    bool headerPending_;
+
+    // must be initialized last as the threads start straight away
+    boost::thread_group threads_;
+
+    void stop(boost::unique_lock<boost::mutex> &lock);
+    bool readContainer(Container &container);
+    void readerThread();
+    void decoderThread();
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_CRAM_DECODE_PIPELINE_HH
@@ -33,7 +33,12 @@ namespace io
 
 class FastqLoader
 {
+    // number of records each reader parses ahead before the bcl gets extracted by all the threads
+    static const std::size_t RECORDS_PER_BATCH = 64 * 1024;
+
     const unsigned inputLoadersMax_;
+    // parse on one thread per file, extract on all threads. Requires more than two inputLoadersMax_
+    const bool parallelExtraction_;
     std::vector<boost::shared_ptr<FastqReader> >  readReaders_;
     bool paired_;
     common::ThreadVector &threads_;
@@ -44,13 +49,17 @@ public:
      */
     /**
      * \brief Creates uninitialized fastq loader
+     *
+     * \param parallelExtraction  Use loadClustersParallel when more than two inputLoadersMax are allowed
      */
     FastqLoader(
         const bool allowVariableLength,
         const std::size_t maxPathLength,
         common::ThreadVector &threads,
-        const unsigned inputLoadersMax) :
+        const unsigned inputLoadersMax,
+        const bool parallelExtraction = false) :
         inputLoadersMax_(inputLoadersMax),
+        parallelExtraction_(parallelExtraction && 2 < inputLoadersMax_),
         // notice that single-ended fastq will use only half the allowed threads to decompress bgzf.
         // That is not correct way to do it, but not particularly important. We mainly care here for
         // inputLoadersMax_=1 scenario which is important for debugging and such.
@@ -90,7 +99,11 @@ public:
     template <typename InsertIt>
     unsigned loadClusters(unsigned clusterCount, const unsigned nameLengthMax, const flowcell::ReadMetadataList &readMetadataList, InsertIt it)
     {
-        if (1 == readMetadataList.size())
+        if (parallelExtraction_)
+        {
+            return loadClustersParallel(clusterCount, nameLengthMax, readMetadataList, it);
+        }
+        else if (1 == readMetadataList.size())
         {
             return loadSingleRead(*readReaders_[0], clusterCount, readMetadataList.at(0), 0, nameLengthMax, it);
         }
@@ -127,6 +140,85 @@ public:
 
     }
 private:
+    /**
+     * \brief Parses batches of records on one thread per fastq file, then has all the threads extract the bcl of
+     *        the batch straight into the cluster locations.
+     */
+    template <typename InsertIt>
+    unsigned loadClustersParallel(
+        const unsigned clusterCount, const unsigned nameLengthMax,
+        const flowcell::ReadMetadataList &readMetadataList, InsertIt it)
+    {
+        const unsigned readers = readMetadataList.size();
+        ISAAC_ASSERT_MSG(1 == readers || 2 == readers, "Only paired and single-ended data is supported");
+        const std::size_t clusterLength = flowcell::getTotalReadLength(readMetadataList) + nameLengthMax;
+
+        unsigned loaded = 0;
+        while (clusterCount != loaded)
+        {
+            threads_.execute(boost::bind(&FastqLoader::threadIndexRecords, this, clusterCount - loaded, _1), readers);
+            const std::size_t batch = 1 == readers ? readReaders_[0]->getIndexedRecords() :
+                std::min(readReaders_[0]->getIndexedRecords(), readReaders_[1]->getIndexedRecords());
+            if (!batch)
+            {
+                break;
+            }
+
+            threads_.execute(boost::bind(&FastqLoader::threadExtractClusters<InsertIt>, this,
+                                         batch, nameLengthMax, boost::cref(readMetadataList), clusterLength,
+                                         it + loaded * clusterLength, _1, _2),
+                             std::min<unsigned>(inputLoadersMax_, threads_.size()));
+
+            for (unsigned reader = 0; readers != reader; ++reader)
+            {
+                readReaders_[reader]->releaseRecords(batch);
+            }
+            loaded += batch;
+        }
+
+        if (2 == readers && readReaders_[0]->getIndexedRecords() != readReaders_[1]->getIndexedRecords())
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Mismatching number of cluster read for r1/r2 = %d/%d, files: %s/%s") %
+                (loaded + readReaders_[0]->getIndexedRecords()) % (loaded + readReaders_[1]->getIndexedRecords()) %
+                readReaders_[0]->getPath() % readReaders_[1]->getPath()).str()));
+        }
+
+        return loaded;
+    }
+
+    void threadIndexRecords(const unsigned recordsMax, const int threadNumber)
+    {
+        readReaders_.at(threadNumber)->indexRecords(recordsMax);
+    }
+
+    template <typename InsertIt>
+    void threadExtractClusters(
+        const std::size_t batch,
+        const unsigned nameLengthMax,
+        const flowcell::ReadMetadataList &readMetadataList,
+        const std::size_t clusterLength,
+        const InsertIt batchBegin,
+        const std::size_t threadNumber,
+        const std::size_t threadsTotal) const
+    {
+        const std::size_t end = batch * (threadNumber + 1) / threadsTotal;
+        for (std::size_t cluster = batch * threadNumber / threadsTotal; end != cluster; ++cluster)
+        {
+            InsertIt it = batchBegin + cluster * clusterLength;
+            for (unsigned read = 0; readMetadataList.size() != read; ++read)
+            {
+                const FastqReader &reader = *readReaders_[read];
+                const FastqReader::Record &record = reader.getIndexedRecord(cluster);
+                it = reader.extractBcl(record, readMetadataList[read], it);
+                // read name goes after the last read bases
+                if (nameLengthMax && readMetadataList.size() == read + 1)
+                {
+                    it = reader.extractReadName(record, nameLengthMax, it);
+                }
+            }
+        }
+    }
+
     template <typename InsertIt>
     static unsigned loadSingleRead(FastqReader &reader, unsigned clusterCount,
                             const flowcell::ReadMetadata &readMetadata,
@@ -181,6 +273,10 @@ private:
     void initializeReaderThread(const int threadNumber, const bool allowVariableLength, const std::size_t maxPathLength)
     {
         readReaders_.at(threadNumber).reset(new FastqReader(allowVariableLength, std::max(1U, inputLoadersMax_/2), maxPathLength));
+        if (parallelExtraction_)
+        {
+            readReaders_.at(threadNumber)->reserveRecords(RECORDS_PER_BATCH);
+        }
     }
 };
 
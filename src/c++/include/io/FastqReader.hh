@@ -33,7 +33,7 @@
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
 #include "flowcell/ReadMetadata.hh"
-#include "io/InflateGzipDecompressor.hh"
+#include "io/AsyncGzipDecompressor.hh"
 #include "io/FileBufCache.hh"
 #include "oligo/Nucleotides.hh"
 
@@ -61,6 +61,22 @@ public:
     // give each thread a chance to unpack a sensible number of bgzf blocks. Otherwise thread synchronization
     // slows the whole thing down
     static const unsigned BGZF_BLOCKS_PER_THREAD = 1024;
+    // number of line end offsets collected by one pass over the buffer
+    static const std::size_t LINE_END_INDEX_CAPACITY = 16 * 1024;
+
+    /**
+     * \brief Location of a parsed record in the uncompressed data. Offsets are counted from the start of the file
+     *        so that they remain valid when the buffer is refilled.
+     */
+    struct Record
+    {
+        std::size_t headerBegin_;
+        std::size_t headerEnd_;
+        std::size_t baseCallsBegin_;
+        std::size_t baseCallsEnd_;
+        std::size_t qScoresBegin_;
+        std::size_t end_;
+    };
 
 private:
     const std::size_t uncompressedBufferSize_;
@@ -70,7 +86,8 @@ private:
     FileBufWithReopen fileBuffer_;
     std::istream is_;
     typedef std::vector<char> BufferType;
-    io::InflateGzipDecompressor<BufferType> gzReader_;
+    // plain gzip is inflated ahead on a separate thread. bgzf is inflated in parallel by bgzfReader_
+    io::AsyncGzipDecompressor gzReader_;
     bgzf::ParallelBgzfReader bgzfReader_;
 
     //boost::filesystem::path forces intermediate string construction during reassignment...
@@ -89,20 +106,71 @@ private:
     BufferType::const_iterator endIt_;
     bool zeroLengthRead_;
 
+    // offsets of '\n' and '\r' in buffer_ collected ahead of parsing in 16-byte chunks
+    std::vector<std::size_t> lineEnds_;
+    // first entry of lineEnds_ that has not been passed by the parser yet
+    std::size_t lineEndsPos_;
+    // buffer_ offset at which the next indexing pass starts
+    std::size_t indexedEnd_;
+
+    // records parsed ahead by indexRecords. The data of records starting from recordsBegin_ is kept in buffer_
+    std::vector<Record> records_;
+    std::size_t recordsBegin_;
+
     static const oligo::Translator<true, INCORRECT_FASTQ_BASE> translator_;
 
 public:
-    FastqReader(const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength);
+    /**
+     * \param uncompressedBufferSize  0 sizes the buffer for BGZF_BLOCKS_PER_THREAD on each of threadsMax
+     */
+    FastqReader(
+        const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength,
+        const std::size_t uncompressedBufferSize = 0);
 
     void open(const boost::filesystem::path &fastqPath, const char q0Base);
 
     void next();
 
     template <typename InsertIt>
-    InsertIt extractBcl(const flowcell::ReadMetadata &readMetadata, InsertIt it) const;
+    InsertIt extractBcl(const flowcell::ReadMetadata &readMetadata, InsertIt it) const
+    {
+        return extractBcl(getRecord(), readMetadata, it);
+    }
 
     template <typename InsertIt>
-    InsertIt extractReadName(const unsigned nameLengthMax, InsertIt it) const;
+    InsertIt extractReadName(const unsigned nameLengthMax, InsertIt it) const
+    {
+        return extractReadName(getRecord(), nameLengthMax, it);
+    }
+
+    /**
+     * \brief Extraction of any record kept in the buffer. extractBcl and extractReadName are const and don't
+     *        change the reader state. Different records can be extracted on different threads at the same time
+     */
+    template <typename InsertIt>
+    InsertIt extractBcl(const Record &record, const flowcell::ReadMetadata &readMetadata, InsertIt it) const;
+
+    template <typename InsertIt>
+    InsertIt extractReadName(const Record &record, const unsigned nameLengthMax, InsertIt it) const;
+
+    /// preallocates space for indexRecords
+    void reserveRecords(const std::size_t recordsMax) {records_.reserve(recordsMax);}
+
+    /**
+     * \brief Parses records until recordsMax are indexed, the data ends, reserved space is exhausted or the
+     *        indexed records occupy half of the buffer. The data of indexed records stays in the buffer until
+     *        released.
+     *
+     * \return number of indexed records that have not been released yet
+     */
+    std::size_t indexRecords(const std::size_t recordsMax);
+
+    std::size_t getIndexedRecords() const {return records_.size() - recordsBegin_;}
+
+    const Record &getIndexedRecord(const std::size_t index) const {return records_[recordsBegin_ + index];}
+
+    /// allow the buffer space of the first count indexed records to be reused
+    void releaseRecords(const std::size_t count);
 
     const std::string getPath() const
     {
@@ -133,7 +201,23 @@ public:
 private:
     typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info;
 
+    Record getRecord() const
+    {
+        const Record ret = {getOffset(headerBegin_), getOffset(headerEnd_), getOffset(baseCallsBegin_),
+                            getOffset(baseCallsEnd_), getOffset(qScoresBegin_), getOffset(endIt_)};
+        return ret;
+    }
+
+    /// inverse of getOffset
+    BufferType::const_iterator at(const std::size_t offset) const
+    {
+        return buffer_.begin() + (offset - (filePos_ - buffer_.size()));
+    }
+
     void resetBuffer();
+    void resetLineEnds();
+    void indexLineEnds(const std::size_t from);
+    BufferType::const_iterator findNewLine(const BufferType::const_iterator it);
     std::size_t getOffset(BufferType::const_iterator it) const;
     void findHeader();
     void findSequence();
@@ -141,20 +225,46 @@ private:
     void findQScoresEnd();
     bool fetchMore();
 
-    std::size_t readCompressedFastq(std::istream &is, char *buffer, std::size_t amount);
+    std::size_t readCompressedFastq(char *buffer, std::size_t amount);
     std::size_t readBgzfFastq(std::istream &is, char *buffer, std::size_t amount);
     std::size_t readFlatFastq(std::istream &is, char *buffer, std::size_t amount);
+
+    std::size_t translateBcl(const char *baseCalls, const char *qScores, const std::size_t length, char *bcl) const;
+
+    /// vectorized translation is possible only when the clusters are stored in contiguous memory
+    template <typename InsertIt>
+    static char *contiguousOutput(const InsertIt &) {return 0;}
+    template <typename ContainerT>
+    static char *contiguousOutput(const __gnu_cxx::__normal_iterator<char *, ContainerT> &it) {return &*it;}
+    static char *contiguousOutput(char *it) {return it;}
 };
 
 template <typename InsertIt>
-InsertIt FastqReader::extractBcl(const flowcell::ReadMetadata &readMetadata, InsertIt it) const
+InsertIt FastqReader::extractBcl(const Record &record, const flowcell::ReadMetadata &readMetadata, InsertIt it) const
 {
     const InsertIt start = it;
-    BufferType::const_iterator baseCallsIt = baseCallsBegin_;
-    BufferType::const_iterator qScoresIt = qScoresBegin_;
+    const BufferType::const_iterator endIt = at(record.end_);
+    BufferType::const_iterator baseCallsIt = at(record.baseCallsBegin_);
+    BufferType::const_iterator qScoresIt = at(record.qScoresBegin_);
     std::vector<unsigned>::const_iterator cycleIterator = readMetadata.getCycles().begin();
     unsigned currentCycle = readMetadata.getFirstReadCycle();
-    for(;endIt_ != qScoresIt && readMetadata.getCycles().end() != cycleIterator; ++baseCallsIt, ++qScoresIt, ++currentCycle)
+
+    // the bulk of the data goes through the vectorized translation. Anything unusual, including the
+    // format errors, is left to the per-base loop below
+    const std::vector<unsigned> &cycles = readMetadata.getCycles();
+    char *const bcl = contiguousOutput(it);
+    const std::size_t length = std::min<std::size_t>(cycles.size(), std::distance(qScoresIt, endIt));
+    if (bcl && !cycles.empty() && currentCycle == cycles.front() &&
+        cycles.back() - cycles.front() + 1 == cycles.size() &&
+        length && length <= record.baseCallsEnd_ - record.baseCallsBegin_ &&
+        length == translateBcl(&*baseCallsIt, &*qScoresIt, length, bcl))
+    {
+        std::advance(it, length);
+        cycleIterator += length;
+        qScoresIt = endIt;
+    }
+
+    for(;endIt != qScoresIt && readMetadata.getCycles().end() != cycleIterator; ++baseCallsIt, ++qScoresIt, ++currentCycle)
     {
 //        ISAAC_THREAD_CERR << "cycle " << *cycleIterator << std::endl;
         if (*cycleIterator != currentCycle)
@@ -195,8 +305,8 @@ InsertIt FastqReader::extractBcl(const flowcell::ReadMetadata &readMetadata, Ins
             BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Read length (%d) "
                 " is different from expected %d in %s:%u. Record %s") %
                 extracted % readMetadata.getCycles().size() %
-                getPath() % getRecordOffset() %
-                std::string(headerBegin_, endIt_)).str()));
+                getPath() % record.headerBegin_ %
+                std::string(at(record.headerBegin_), endIt)).str()));
         }
         else
         {
@@ -220,22 +330,24 @@ InsertIt FastqReader::extractBcl(const flowcell::ReadMetadata &readMetadata, Ins
  * \return it + nameLengthMax
  */
 template <typename InsertIt>
-InsertIt FastqReader::extractReadName(const unsigned nameLengthMax, InsertIt it) const
+InsertIt FastqReader::extractReadName(const Record &record, const unsigned nameLengthMax, InsertIt it) const
 {
     static const char whitespace[] = {' ', '\t'};
+    const BufferType::const_iterator headerBegin = at(record.headerBegin_);
+    const BufferType::const_iterator headerEnd = at(record.headerEnd_);
     const std::size_t nameAvailable = std::distance(
-        headerBegin_+1, std::find_first_of(headerBegin_+1, headerEnd_, whitespace, whitespace + sizeof(whitespace)));
-//    ISAAC_THREAD_CERR << "extractReadName header " << std::string(headerBegin_+1, headerEnd_) << " nameAvailable:" << nameAvailable << std::endl;
+        headerBegin+1, std::find_first_of(headerBegin+1, headerEnd, whitespace, whitespace + sizeof(whitespace)));
+//    ISAAC_THREAD_CERR << "extractReadName header " << std::string(headerBegin+1, headerEnd) << " nameAvailable:" << nameAvailable << std::endl;
     if (nameLengthMax > nameAvailable)
     {
-        it = std::copy(headerBegin_+1, headerBegin_ + 1 + nameAvailable, it);
+        it = std::copy(headerBegin+1, headerBegin + 1 + nameAvailable, it);
         it = std::fill_n(it, nameLengthMax - nameAvailable, 0);
-//        ISAAC_THREAD_CERR << "extractReadName " << std::string(headerBegin_+1, headerBegin_ + 1 + nameAvailable) << " nameLengthMax:" << nameLengthMax << std::endl;
+//        ISAAC_THREAD_CERR << "extractReadName " << std::string(headerBegin+1, headerBegin + 1 + nameAvailable) << " nameLengthMax:" << nameLengthMax << std::endl;
     }
     else
     {
-        it = std::copy(headerBegin_ + 1 + nameAvailable - nameLengthMax, headerBegin_ + 1 + nameAvailable, it);
-//        ISAAC_THREAD_CERR << "extractReadName " << std::string(headerBegin_ + 1 + nameAvailable - nameLengthMax, headerBegin_ + 1 + nameAvailable) << " nameLengthMax:" << nameLengthMax << std::endl;
+        it = std::copy(headerBegin + 1 + nameAvailable - nameLengthMax, headerBegin + 1 + nameAvailable, it);
+//        ISAAC_THREAD_CERR << "extractReadName " << std::string(headerBegin + 1 + nameAvailable - nameLengthMax, headerBegin + 1 + nameAvailable) << " nameLengthMax:" << nameLengthMax << std::endl;
     }
     return it;
 }
@@ -163,6 +163,9 @@ public:
     }
 
     std::ios_base::openmode mode() const {return mode_;}
+
+    /// \return operating system descriptor of the open file
+    int fileDescriptor() {return fileno(this->_M_file.file());}
     /**
      * \brief Reserves a file handle in a specified mode. This mode will be used during any subsequent reopen.
      *        Currently by opening /dev/null.
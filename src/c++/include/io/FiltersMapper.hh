@@ -12,7 +12,7 @@
  **
  ** \file FiltersMapper.hh
  **
- ** Helper class for mapping Filter files into memory.
+ ** Helper class for mapping Filter files into memory. The pf values are decoded from the mapped file on request.
  **
  ** \author Roman Petrovski
  **/
@@ -20,8 +20,11 @@
 #ifndef iSAAC_IO_FILTERS_MAPPER_HH
 #define iSAAC_IO_FILTERS_MAPPER_HH
 
+#include <boost/format.hpp>
+
 #include "common/Debug.hh"
 #include "flowcell/TileMetadata.hh"
+#include "io/MappedFile.hh"
 
 namespace isaac
 {
@@ -33,8 +36,8 @@ class FiltersMapper
 public:
     FiltersMapper(const bool ignoreMissingFilterFiles) :
         ignoreMissingFilterFiles_(ignoreMissingFilterFiles),
-        fileBufCache_(1, std::ios_base::in | std::ios_base::binary),
         clusterCount_(0),
+        tileValues_(0),
         version_(FirstUnsupported)
     {
         ISAAC_TRACE_STAT("FiltersMapper::FiltersMapper")
@@ -50,29 +53,61 @@ public:
         const uint64_t clusterOffset = ONE_TILE_PER_FILE)
     {
         clusterCount_ = clusterCount;
-        tileData_.clear();
+        tileValues_ = 0;
         version_ = load(filtersFilePath, clusterOffset, Autodetect);
     }
 
     template <typename InsertIteratorT>
     void getPf(InsertIteratorT it) const
     {
-        versionSpecific<GetPfAction>(version_, boost::cref(tileData_), it, clusterCount_, UNUSED);
+        if (!tileValues_)
+        {
+            // missing filter file
+            std::fill_n(it, clusterCount_, 1);
+        }
+        else
+        {
+            versionSpecific<GetPfAction>(version_, tileValues_, it, clusterCount_, UNUSED);
+        }
     }
 
     void reserveBuffers(const size_t reservePathLength, const unsigned maxClusterCount)
     {
-        fileBufCache_.reservePathBuffers(reservePathLength);
-        tileData_.reserve(getMaxPossibleExpectedFileSize(maxClusterCount));
+        file_.reservePathBuffer(reservePathLength);
+    }
+
+    /**
+     * \return number of clusters described by the filter file header
+     */
+    static unsigned getClusterCount(const boost::filesystem::path &filtersFilePath)
+    {
+        MappedFile file;
+        file.map(filtersFilePath);
+        const V0Header::Header &v0Header = *reinterpret_cast<const V0Header::Header *>(file.data());
+        // V2 and V3 start with 0 for disambiguation
+        const std::size_t headerBytes = file.size() < sizeof(V0Header::Header) || v0Header.clusters ?
+            sizeof(V0Header::Header) : sizeof(V2Header::Header);
+        if (file.size() < headerBytes)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Filter file is too short %s: %d bytes") %
+                filtersFilePath % file.size()).str()));
+        }
+        return v0Header.clusters ? v0Header.clusters : reinterpret_cast<const V2Header::Header *>(file.data())->clusters;
+    }
+
+    void unreserve()
+    {
+        file_.unmap();
     }
 
 private:
     typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info;
     static const uint64_t ONE_TILE_PER_FILE = -1UL;
     const bool ignoreMissingFilterFiles_;
-    io::FileBufCache<io::FileBufWithReopen> fileBufCache_;
+    MappedFile file_;
     unsigned clusterCount_;
-    std::vector<char> tileData_;
+    // first pf value of the tile within file_. 0 if the filter file is missing
+    const char *tileValues_;
     enum Version
     {
         Autodetect = -1,
@@ -180,65 +215,35 @@ private:
 
 
     template <typename HeaderT>
-    static std::size_t getExpectedFileSize(const unsigned clusters)
-    {
-        return sizeof(typename HeaderT::Header) + clusters * sizeof(typename HeaderT::value_type);
-    }
-
-    template <typename HeaderT>
-    struct GetExpectedFileSizeAction
-    {
-        typedef void result_type;
-        void operator()(const unsigned clusters, unsigned &size, UnusedT, UnusedT) const
-        {
-            size = getExpectedFileSize<HeaderT>(clusters);
-        }
-    };
-
-    static unsigned getVersionExpectedFileSize(const Version assumedVersion, unsigned maxClusterCount)
-    {
-        unsigned expectedFileSize = 0;
-        versionSpecific<GetExpectedFileSizeAction>(assumedVersion, maxClusterCount, boost::ref(expectedFileSize), UNUSED, UNUSED);
-        return expectedFileSize;
-    }
-
-    template <typename HeaderT>
-    struct ReadDataAction
+    struct LocateTileAction
     {
         typedef void result_type;
         void operator()(
-            std::istream &is,
-            std::vector<char> &tileData,
+            const MappedFile &file,
+            const char *&tileValues,
             const unsigned clusterCount,
             const uint64_t clusterOffset) const
         {
-            unsigned expectedFileSize = getExpectedFileSize<HeaderT>(clusterCount);
-            tileData.resize(expectedFileSize);
-
-            if (!is.read(&tileData.front(), sizeof(HeaderT)))
+            const HeaderT &header = reinterpret_cast<const HeaderT&>(*file.data());
+            if (ONE_TILE_PER_FILE == clusterOffset && header.header.clusters != clusterCount)
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d header bytes") %
-                    sizeof(HeaderT)).str()));
-            }
-
-            if (ONE_TILE_PER_FILE != clusterOffset)
-            {
-                // patch the clusters number as multitile filter files contain the total number of clusters
-                HeaderT &header = reinterpret_cast<HeaderT&>(tileData.front());
-                header.header.clusters = clusterCount;
-                const uint64_t clusterByteOffset = clusterOffset * sizeof(typename HeaderT::value_type);
-                if (!is.seekg(clusterByteOffset, is.cur))
-                {
-                    BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to seek %d bytes") %
-                        clusterByteOffset).str()));
-                }
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+                    "Number of clusters in the filter file (%d) does not match the expected: %d") %
+                    header.header.clusters % clusterCount).str()));
             }
 
-            if (!is.read(&tileData.front() + sizeof(HeaderT), expectedFileSize - sizeof(HeaderT)))
+            const uint64_t valuesOffset = sizeof(typename HeaderT::Header) +
+                (ONE_TILE_PER_FILE == clusterOffset ? 0 : clusterOffset) * sizeof(typename HeaderT::value_type);
+            const uint64_t valuesBytes = uint64_t(clusterCount) * sizeof(typename HeaderT::value_type);
+            if (file.size() < valuesOffset + valuesBytes)
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes") %
-                    expectedFileSize).str()));
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+                    "Filter file is too short (%d bytes) to contain %d values at offset %d") %
+                    file.size() % clusterCount % valuesOffset).str()));
             }
+            // get the kernel reading while the bcl data is being transposed
+            file.willNeed(valuesOffset, valuesBytes);
+            tileValues = file.data() + valuesOffset;
         }
     };
 
@@ -247,49 +252,42 @@ private:
     {
         typedef void result_type;
         template<typename InsertIteratorT>
-        void operator()(const std::vector<char> &tileData, InsertIteratorT it, const unsigned clusters, UnusedT) const
+        void operator()(const char *tileValues, InsertIteratorT it, const unsigned clusters, UnusedT) const
         {
-            const HeaderT &header = reinterpret_cast<const HeaderT&>(tileData.front());
-            ISAAC_ASSERT_MSG(header.header.clusters == clusters, "Requested number of pf values (" << clusters <<
-                ") does not match the loaded:" << unsigned(header.header.clusters));
-            std::copy(header.values, header.values + clusters, it);
+            const typename HeaderT::value_type *values =
+                reinterpret_cast<const typename HeaderT::value_type *>(tileValues);
+            std::copy(values, values + clusters, it);
         }
     };
 
-    Version detectVersion(const boost::filesystem::path &filterFilePath, std::istream &is) const
+    Version detectVersion(const boost::filesystem::path &filterFilePath) const
     {
         Version assumedVersion(V0);
-        unsigned int clusterCount(0);
-        if (!is.read(reinterpret_cast<char *>(&clusterCount), 4))
+        if (file_.size() < sizeof(V0Header::Header))
         {
             BOOST_THROW_EXCEPTION(
-                common::IoException(errno, (boost::format("Failed to read cluster count from filters file %s: %s") % filterFilePath % strerror(errno)).str()));
+                common::IoException(EINVAL, (boost::format("Failed to read cluster count from filters file %s: file too short") % filterFilePath).str()));
         }
+        const unsigned int clusterCount = reinterpret_cast<const V0Header::Header *>(file_.data())->clusters;
 
         if (!clusterCount)
         {
             // V2 or V3
-            unsigned int version(0);
-            if (!is.read(reinterpret_cast<char *>(&version), 4))
+            if (file_.size() < sizeof(V2Header::Header))
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read version from %s: %s") % filterFilePath % strerror(errno)).str()));
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Failed to read version from %s: file too short") % filterFilePath).str()));
             }
+            const unsigned int version = reinterpret_cast<const V2Header::Header *>(file_.data())->version;
             if (V2 != version && V3 != version)
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Unexpected filter file version (%d). from %s:") % version % filterFilePath ).str()));
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Unexpected filter file version (%d). from %s:") % version % filterFilePath ).str()));
             }
             assumedVersion = static_cast<Version>(version);
         }
         else
         {
             // V0 or V1
-            const std::istream::pos_type valuesStartPos = is.tellg();
-            if (!is.seekg(0, std::ios::end))
-            {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to seek to end of " + filterFilePath.string()));
-            }
-            const std::istream::pos_type fileEndPos = is.tellg();
-            const uint64_t valueBytes = fileEndPos - valuesStartPos;
+            const uint64_t valueBytes = file_.size() - sizeof(V0Header::Header);
             if (clusterCount_ == valueBytes)
             {
                 assumedVersion = V0;
@@ -300,14 +298,10 @@ private:
             }
             else
             {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Unexpected file length (%d +%d) when detecting filter file format version for % clusters. from %s:") %
-                    valuesStartPos % fileEndPos % clusterCount_ % filterFilePath ).str()));
+                BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Unexpected file length (%d +%d) when detecting filter file format version for % clusters. from %s:") %
+                    sizeof(V0Header::Header) % file_.size() % clusterCount_ % filterFilePath ).str()));
             }
         }
-        if (!is.seekg(0, std::ios::beg))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to seek back to beginning of file " + filterFilePath.string()));
-        }
         return assumedVersion;
     }
 
@@ -328,51 +322,31 @@ private:
                 {
                     assumedVersion = V0;
                 }
-                unsigned expectedFileSize = getVersionExpectedFileSize(assumedVersion, clusterCount_);
-                tileData_.resize(expectedFileSize);
-                std::fill(tileData_.begin(), tileData_.end(), 1);
-                reinterpret_cast<V0Header &>(tileData_.front()).header.clusters = clusterCount_;
-
                 ISAAC_THREAD_CERR << "Assuming " << clusterCount_ << " clusters pass filter due to missing " << filterFilePath << std::endl;
             }
         }
         else
         {
-            std::istream is(fileBufCache_.get(filterFilePath));
-            if (!is)
-            {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open %s: %s") % filterFilePath % strerror(errno)).str()));
-            }
-
-            if (Autodetect == assumedVersion)
-            {
-                assumedVersion = detectVersion(filterFilePath, is);
-            }
+            // lane-level filter files stay mapped for all the tiles of the lane
+            file_.map(filterFilePath);
 
             try
             {
-                versionSpecific<ReadDataAction>(assumedVersion, boost::ref(is), boost::ref(tileData_), clusterCount_, clusterOffset);
+                if (Autodetect == assumedVersion)
+                {
+                    assumedVersion = detectVersion(filterFilePath);
+                }
+                versionSpecific<LocateTileAction>(assumedVersion, boost::cref(file_), boost::ref(tileValues_), clusterCount_, clusterOffset);
             }
             catch (boost::exception &e)
             {
                 e << errmsg_info(" While reading from " + filterFilePath.string());
                 throw;
             }
-            ISAAC_THREAD_CERR << "Read " << clusterCount_ << " filter values from filter file version " << assumedVersion << ": " << filterFilePath << std::endl;
+            ISAAC_THREAD_CERR << "Mapped " << clusterCount_ << " filter values from filter file version " << assumedVersion << ": " << filterFilePath << std::endl;
         }
         return assumedVersion;
     }
-
-    static unsigned getMaxPossibleExpectedFileSize(unsigned maxClusterCount)
-    {
-        unsigned expectedFileSize = 0;
-        for (Version v = FirstSupported; v < FirstUnsupported; v = Version(v+1))
-        {
-            expectedFileSize = std::max(expectedFileSize, getVersionExpectedFileSize(v, maxClusterCount));
-        }
-        return expectedFileSize;
-    }
-
 };
 
 
@@ -12,7 +12,7 @@
  **
  ** \file LocsMapper.hh
  **
- ** Helper class for mapping compressed position files into memory.
+ ** Helper class for mapping position files into memory. The positions are decoded from the mapped file on request.
  **
  ** \author Roman Petrovski
  **/
@@ -20,8 +20,11 @@
 #ifndef iSAAC_IO_LOCS_MAPPER_HH
 #define iSAAC_IO_LOCS_MAPPER_HH
 
+#include <boost/format.hpp>
+
 #include "common/Debug.hh"
 #include "flowcell/TileMetadata.hh"
+#include "io/MappedFile.hh"
 
 namespace isaac
 {
@@ -31,8 +34,7 @@ namespace io
 class LocsMapper
 {
 public:
-    LocsMapper() :
-        fileBufCache_(1, std::ios_base::in | std::ios_base::binary), clusterCount_(0)
+    LocsMapper() : clusterCount_(0), tileXy_(0)
     {
     }
 
@@ -41,7 +43,7 @@ public:
                  const uint64_t clusterOffset = ONE_TILE_PER_FILE)
     {
         clusterCount_ = clusterCount;
-        tileData_.clear();
+        tileXy_ = 0;
         load(clocsFilePath, clusterOffset, V1);
     }
 
@@ -53,14 +55,12 @@ public:
 
     void reserveBuffers(const size_t reservePathLength, const unsigned maxClusterCount)
     {
-        fileBufCache_.reservePathBuffers(reservePathLength);
-        tileData_.reserve(sizeof(V0Header) + sizeof(Xy) * maxClusterCount);
+        file_.reservePathBuffer(reservePathLength);
     }
 
     void unreserve()
     {
-        std::vector<char>().swap(tileData_);
-        fileBufCache_.unreserve();
+        file_.unmap();
     }
 private:
     static const uint64_t ONE_TILE_PER_FILE = -1UL;
@@ -82,9 +82,10 @@ private:
     };
 #pragma pack(pop)
 
-    io::FileBufCache<io::FileBufWithReopen> fileBufCache_;
+    MappedFile file_;
     unsigned clusterCount_;
-    std::vector<char> tileData_;
+    // first position of the tile within file_
+    const Xy *tileXy_;
     enum Version
     {
         V1 = 1
@@ -93,7 +94,7 @@ private:
     template <typename InsertIteratorT>
     void getPositions(InsertIteratorT it, unsigned clusters) const
     {
-        const Xy *currentBlockClusters = reinterpret_cast<const Xy *>(reinterpret_cast<const V0Header *>(&tileData_.front()) + 1);
+        const Xy *currentBlockClusters = tileXy_;
 
         while (clusters--)
         {
@@ -109,63 +110,42 @@ private:
         const uint64_t clusterOffset,
         Version assumedVersion)
     {
-        std::istream is(fileBufCache_.get(locsFilePath));
-        if (!is)
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open %s: %s") % locsFilePath % strerror(errno)).str()));
-        }
-
-        std::size_t dataSize = sizeof(V0Header) + clusterCount_ * sizeof(Xy);//common::getFileSize(locsFilePath.c_str());
-        if (dataSize > tileData_.capacity())
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("locs file is bigger than supported maximum %s: %d. Expected max: ") % locsFilePath % dataSize % tileData_.capacity()).str()));
-        }
+        // lane-level locs files stay mapped for all the tiles of the lane
+        file_.map(locsFilePath);
 
-        tileData_.resize(dataSize);
-        if (!is.read(&tileData_.front(), sizeof(V0Header)))
+        if (file_.size() < sizeof(V0Header))
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d header bytes from %s") %
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Failed to read %d header bytes from %s") %
                 sizeof(V0Header) % locsFilePath ).str()));
         }
 
-        V0Header &header = reinterpret_cast<V0Header &>(tileData_.front());
+        const V0Header &header = reinterpret_cast<const V0Header &>(*file_.data());
         if (header.version_ != boost::uint32_t(assumedVersion))
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Unsupported locs file version %s: %d") % locsFilePath % int(header.version_)).str()));
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Unsupported locs file version %s: %d") % locsFilePath % int(header.version_)).str()));
         }
 
-        if (ONE_TILE_PER_FILE != clusterOffset)
-        {
-            // patch the clusters number as multitile filter files contain the total number of clusters
-            header.clusters_ = clusterCount_;
-            const uint64_t clusterByteOffset = clusterOffset * sizeof(Xy);
-            if (!is.seekg(clusterByteOffset, is.cur))
-            {
-                BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to seek %d bytes in %s") %
-                    clusterByteOffset % locsFilePath.string()).str()));
-            }
-        }
-
-        if (header.clusters_ !=  clusterCount_)
+        const uint64_t tileClusterOffset = ONE_TILE_PER_FILE == clusterOffset ? 0 : clusterOffset;
+        // multitile locs files contain the total number of clusters
+        if (ONE_TILE_PER_FILE == clusterOffset ? header.clusters_ != clusterCount_ : header.clusters_ < tileClusterOffset + clusterCount_)
         {
             BOOST_THROW_EXCEPTION(common::IoException(
-                errno, (boost::format("Unexpected locs file number of clusters %s: %d. Expected: %d") %
-                    locsFilePath % int(header.clusters_) % clusterCount_).str()));
+                EINVAL, (boost::format("Unexpected locs file number of clusters %s: %d. Expected: %d at offset %d") %
+                    locsFilePath % int(header.clusters_) % clusterCount_ % tileClusterOffset).str()));
         }
 
-        if (!is.read(&tileData_.front() + sizeof(V0Header), tileData_.size() - sizeof(V0Header)))
+        const uint64_t xyOffset = sizeof(V0Header) + tileClusterOffset * sizeof(Xy);
+        const uint64_t xyBytes = uint64_t(clusterCount_) * sizeof(Xy);
+        if (file_.size() < xyOffset + xyBytes)
         {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes from %s") %
-                (dataSize - sizeof(V0Header)) % locsFilePath ).str()));
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Failed to read %d bytes from %s. File size %d") %
+                xyBytes % locsFilePath % file_.size()).str()));
         }
 
-        if (tileData_.size() - sizeof(V0Header) != std::size_t(is.gcount()))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes from %s. Read %d") %
-                (tileData_.size() - sizeof(V0Header)) % locsFilePath % is.gcount() ).str()));
-        }
+        file_.willNeed(xyOffset, xyBytes);
+        tileXy_ = reinterpret_cast<const Xy *>(file_.data() + xyOffset);
 
-        ISAAC_THREAD_CERR << "Read " << clusterCount_ << " position values from locs file version " <<
+        ISAAC_THREAD_CERR << "Mapped " << clusterCount_ << " position values from locs file version " <<
             assumedVersion << ": " << locsFilePath << " cluster offset:" << clusterOffset << std::endl;
     }
 };
@@ -0,0 +1,75 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MappedFile.hh
+ **
+ ** \brief Read-only memory mapping of a whole file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_MAPPED_FILE_HH
+#define iSAAC_IO_MAPPED_FILE_HH
+
+#include <cstdint>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Maps the whole file read-only. Mapping the same path again keeps the existing mapping, so that
+ *        lane-level files are mapped once for all the tiles they contain, and the pages already touched for one
+ *        tile are not read again for the next.
+ *
+ * Nothing is read at map time. The data is paged in when the client accesses it.
+ */
+class MappedFile : boost::noncopyable
+{
+public:
+    MappedFile() : data_(0), size_(0) {}
+    ~MappedFile() {unmap();}
+
+    /**
+     * \brief Maps filePath unless it is the file already mapped. Unmaps the previous file otherwise.
+     */
+    void map(const boost::filesystem::path &filePath);
+
+    void unmap();
+
+    /**
+     * \brief Hints the kernel to start reading the range, as it will be accessed soon.
+     */
+    void willNeed(const uint64_t offset, const uint64_t bytes) const;
+
+    /// reserves the path buffer so that map does not need to allocate for paths not longer than reservePathLength
+    void reservePathBuffer(const std::size_t reservePathLength) {path_.reserve(reservePathLength);}
+
+    const char *data() const {return data_;}
+    uint64_t size() const {return size_;}
+    const char *end() const {return data_ + size_;}
+    const std::string &getPath() const {return path_;}
+
+private:
+    std::string path_;
+    const char *data_;
+    uint64_t size_;
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_MAPPED_FILE_HH
@@ -0,0 +1,157 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryFileStore.hh
+ **
+ ** \brief Temporary files that are kept in memory instead of the file system.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_MEMORY_FILE_STORE_HH
+#define iSAAC_IO_MEMORY_FILE_STORE_HH
+
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Process-wide set of files identified by their paths. The contents are stored in chunks of anonymous
+ *        memory mappings, so appending does not go through malloc and the pages end up on the NUMA node of the
+ *        thread that writes them.
+ *
+ * Chunks are reserved against the BinsInMemory subsystem of the process-wide memory budget. An append that does
+ * not fit the limit of the store or the budget fails leaving the file unchanged, so that the writer can move the
+ * file to the file system.
+ *
+ * Appends to the same file must be serialized by the caller. Reading is allowed once writing is over.
+ */
+class MemoryFileStore : boost::noncopyable
+{
+    struct Chunk
+    {
+        Chunk *next_;
+        std::size_t used_;
+        char data_[];
+    };
+
+public:
+    static const std::size_t CHUNK_BYTES = 4 * 1024 * 1024;
+
+    class File
+    {
+        friend class MemoryFileStore;
+        Chunk *first_;
+        Chunk *last_;
+        uint64_t size_;
+    public:
+        File() : first_(0), last_(0), size_(0){}
+        uint64_t getSize() const {return size_;}
+    };
+
+    /**
+     * \brief Sequential reads of a range of an in-memory file
+     */
+    class Reader
+    {
+        const Chunk *chunk_;
+        std::size_t chunkOffset_;
+        uint64_t tell_;
+        uint64_t remaining_;
+    public:
+        Reader() : chunk_(0), chunkOffset_(0), tell_(0), remaining_(0){}
+        void open(const File &file, const uint64_t offset, const uint64_t bytes);
+        std::size_t read(char *buffer, std::size_t bytes);
+        void close() {chunk_ = 0; remaining_ = 0;}
+        uint64_t tell() const {return tell_;}
+    };
+
+    /**
+     * \param limit bytes the files can take together. 0 disables the store
+     */
+    explicit MemoryFileStore(const uint64_t limit);
+    ~MemoryFileStore();
+
+    static void configure(const uint64_t limit);
+    static MemoryFileStore &instance();
+
+    bool isEnabled() const {return limit_;}
+
+    /**
+     * \brief Makes path an empty in-memory file
+     */
+    File &create(const std::string &path);
+
+    /**
+     * \return 0 if path is not in memory. Does not allocate dynamic memory
+     */
+    const File *find(const std::string &path) const;
+
+    /**
+     * \brief Appends all pieces or nothing. Does not allocate dynamic memory
+     *
+     * \return false if the data does not fit the limit of the store or the memory budget
+     */
+    bool append(File &file, const iovec *pieces, const std::size_t count);
+
+    /**
+     * \brief Passes the contents of file to consume in chunks. consume(const char *data, std::size_t bytes)
+     */
+    template <typename ConsumerT>
+    static void forEachChunk(const File &file, ConsumerT consume)
+    {
+        for (const Chunk *chunk = file.first_; chunk; chunk = chunk->next_)
+        {
+            consume(chunk->data_, chunk->used_);
+        }
+    }
+
+    /**
+     * \brief Frees the memory of the file. The path is not found after this
+     */
+    void remove(const std::string &path);
+
+    /**
+     * \brief Removes all files
+     */
+    void clear();
+
+    uint64_t getBytes() const;
+
+private:
+    static const std::size_t CHUNK_DATA_BYTES = CHUNK_BYTES - sizeof(Chunk);
+
+    uint64_t limit_;
+    mutable boost::mutex mutex_;
+    // chunk bytes of all files
+    uint64_t bytes_;
+    std::map<std::string, File> files_;
+
+    bool reserve(const std::size_t chunks);
+    void release(const std::size_t chunks);
+    void free(File &file);
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_MEMORY_FILE_STORE_HH
@@ -0,0 +1,194 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file PooledFileWriter.hh
+ **
+ ** \brief Appends data to a large number of files through a bounded number of open descriptors.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_IO_POOLED_FILE_WRITER_HH
+#define iSAAC_IO_POOLED_FILE_WRITER_HH
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "io/MemoryFileStore.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+/**
+ * \brief Each file gets a write-combining buffer. Data that does not fit the buffer goes to the file together with
+ *        the buffer contents in one pwritev. Descriptors are opened when data needs to be written and the least
+ *        recently used ones are closed when the number of open descriptors reaches the limit.
+ *
+ * When memoryFiles is enabled, files are created in it and move to the file system only when an append does not
+ * fit the memory.
+ *
+ * Writes into the same file must be serialized by the caller. Different files can be written concurrently.
+ * write and flush don't allocate dynamic memory.
+ *
+ * With writeBehindBytes, write and flush only record the windows of the file that are complete. The writeback is
+ * started and waited for by writeBehind, which the caller is expected to invoke outside of the lock that serializes
+ * the writes so that waiting for the disk does not hold up the other writers of the file.
+ */
+class PooledFileWriter : boost::noncopyable
+{
+public:
+    static const std::size_t BUFFER_ALIGNMENT = 4096;
+    static const std::size_t DEFAULT_BUFFER_BYTES = 64 * 1024;
+
+    struct Counters
+    {
+        Counters() : opens_(0), writeCalls_(0), bytes_(0), spills_(0){}
+        uint64_t opens_;
+        uint64_t writeCalls_;
+        uint64_t bytes_;
+        /// in-memory files moved to the file system
+        uint64_t spills_;
+    };
+
+    /**
+     * \param maxOpenFiles      descriptors to keep open at most. Exceeded only when all open files are being written
+     * \param writeBehindBytes  when not 0, writeBehind pushes the data out of page cache in windows of this size
+     */
+    PooledFileWriter(
+        const unsigned maxOpenFiles,
+        const std::size_t bufferBytes = DEFAULT_BUFFER_BYTES,
+        const std::size_t writeBehindBytes = 0,
+        MemoryFileStore &memoryFiles = MemoryFileStore::instance());
+    ~PooledFileWriter();
+
+    /**
+     * \brief Closes all files and prepares slots for the new ones. Buffered data is discarded
+     */
+    void reset(const std::size_t files);
+
+    /**
+     * \brief Makes file an empty file at path, pre-allocating fallocateBytes if not 0
+     */
+    void create(const std::size_t file, const boost::filesystem::path &path, const uint64_t fallocateBytes);
+
+    void write(const std::size_t file, const char *data, const std::size_t bytes)
+    {
+        const iovec piece = {const_cast<char *>(data), bytes};
+        write(file, &piece, 1);
+    }
+
+    /**
+     * \brief Appends pieces to the file in the order in which they are given
+     */
+    void write(const std::size_t file, const iovec *pieces, const std::size_t count);
+
+    /**
+     * \brief Writes out the buffered data of the file
+     */
+    void flush(const std::size_t file);
+    void flush();
+
+    /**
+     * \brief Starts the writeback of the complete windows written into the file since the previous call and drops
+     *        the windows preceding them from page cache once they are on the disk.
+     *
+     * Can be called concurrently with writes into the same file. Returns straight away if another thread is
+     * writing behind the same file.
+     */
+    void writeBehind(const std::size_t file);
+
+    /**
+     * \brief Closes all descriptors. Data that has not been flushed is discarded
+     */
+    void close() noexcept;
+
+    std::size_t getBufferBytes() const {return bufferBytes_;}
+    /// file size including the buffered data
+    uint64_t getSize(const std::size_t file) const
+    {
+        const File &f = files_.at(file);
+        return f.memory_ ? f.memory_->getSize() : f.offset_ + f.buffered_;
+    }
+
+    /// counters accumulate since the construction or the last reset of counters
+    Counters getCounters() const;
+    void resetCounters();
+
+private:
+    static const std::size_t NONE = -1UL;
+
+    struct File
+    {
+        File() : memory_(0), fd_(-1), users_(0), offset_(0), writtenBehind_(0), writeBehindDue_(0),
+            writingBehind_(false), buffer_(0, &free), buffered_(0), newer_(NONE), older_(NONE){}
+        std::string path_;
+        // not 0 while the file is kept in memory
+        MemoryFileStore::File *memory_;
+        int fd_;
+        // writes in progress. The descriptor is not closed while there are any
+        unsigned users_;
+        // file offset for the data that is buffered
+        uint64_t offset_;
+        // file offset up to which the writeback has been started
+        uint64_t writtenBehind_;
+        // end of the last complete write-behind window. Protected by poolMutex_
+        uint64_t writeBehindDue_;
+        // a thread is in writeBehind for this file. Protected by poolMutex_
+        bool writingBehind_;
+        std::unique_ptr<char, void (*)(void *)> buffer_;
+        std::size_t buffered_;
+        // neighbours in the list of open files, most recently used first
+        std::size_t newer_;
+        std::size_t older_;
+    };
+
+    const unsigned maxOpenFiles_;
+    const std::size_t bufferBytes_;
+    const std::size_t writeBehindBytes_;
+    MemoryFileStore &memoryFiles_;
+    std::vector<File> files_;
+
+    // protects descriptors and the list of open files
+    boost::mutex poolMutex_;
+    unsigned openFiles_;
+    std::size_t newest_;
+    std::size_t oldest_;
+
+    std::atomic<uint64_t> opens_;
+    std::atomic<uint64_t> writeCalls_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> spills_;
+
+    void openCreated(const std::size_t file, const uint64_t fallocateBytes);
+    void spill(const std::size_t file);
+    int acquire(const std::size_t file);
+    void release(const std::size_t file);
+    void unlink(const std::size_t file);
+    bool closeOldestUnused();
+    void writeOut(const std::size_t file, iovec *pieces, std::size_t count);
+};
+
+} // namespace io
+} // namespace isaac
+
+#endif // #ifndef iSAAC_IO_POOLED_FILE_WRITER_HH
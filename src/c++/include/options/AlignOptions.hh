@@ -50,6 +50,8 @@ private:
     void verifyMandatoryPaths(boost::program_options::variables_map &vm);
     void parseParallelization();
     build::GapRealignerMode parseGapRealignment();
+    build::OutputFormat parseOutputFormat();
+    unsigned parseBamIndexFormat();
     void parseExecutionTargets();
     void parseMemoryControl();
     void parseGapScoring();
@@ -163,6 +165,9 @@ public:
     unsigned inputLoadersMax;
     unsigned tempSaversMax;
     unsigned tempLoadersMax;
+    bool tempLoadersAdaptive;
+    bool tempDirectIo;
+    uint64_t inMemoryBins;
     unsigned outputSaversMax;
     std::string realignGapsString;
     build::GapRealignerMode realignGaps;
@@ -170,6 +175,11 @@ public:
     std::string knownIndelsPathString;
     boost::filesystem::path knownIndelsPath;
     int bamGzipLevel;
+    std::string outputFormatString;
+    build::OutputFormat outputFormat;
+    std::string bamIndexFormatString;
+    unsigned bamIndexFormat;
+    unsigned csiMinShift;
     std::vector<std::string> bamHeaderTags;
     std::string bamPuFormat;
     bool bamProduceMd5;
@@ -193,6 +203,8 @@ public:
     workflow::AlignWorkflow::OptionalFeatures optionalFeatures;
     bool pessimisticMapQ;
     unsigned detectTemplateBlockSize;
+    bool reportsDuringBam;
+    bool fastqParallelExtraction;
     bool disableResume;
 };
 
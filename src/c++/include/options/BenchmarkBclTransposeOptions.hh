@@ -0,0 +1,47 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkBclTransposeOptions.hh
+ **
+ ** Command line options for 'benchmarkBclTranspose'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_OPTIONS_BENCHMARK_BCL_TRANSPOSE_OPTIONS_HH
+#define iSAAC_OPTIONS_BENCHMARK_BCL_TRANSPOSE_OPTIONS_HH
+
+#include "common/Program.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+class BenchmarkBclTransposeOptions : public isaac::common::Options
+{
+public:
+    BenchmarkBclTransposeOptions();
+private:
+    std::string usagePrefix() const {return "benchmarkBclTranspose";}
+    void postProcess(boost::program_options::variables_map &vm);
+public:
+    unsigned clusters;
+    unsigned cycles;
+    unsigned jobs;
+    unsigned repeat;
+};
+
+} // namespace options
+} // namespace isaac
+
+#endif // #ifndef iSAAC_OPTIONS_BENCHMARK_BCL_TRANSPOSE_OPTIONS_HH
@@ -278,6 +278,30 @@ public:
 
     const ContigLists &node0Container() const {return replicas_.node0Container();}
     const ContigLists &threadNodeContainer() const {return replicas_.threadNodeContainer();}
+
+    /// bytes taken by the linear references on all nodes
+    uint64_t getMemoryFootprint() const
+    {
+        uint64_t ret = 0;
+        for (const ContigList &contigList : replicas_.node0Container())
+        {
+            ret += contigList.endOffset();
+        }
+        return ret * replicas_.getReplicaCount();
+    }
+
+    /// bytes loadContigs will take for the references on all nodes. Does not underestimate
+    static uint64_t estimateMemoryFootprint(const SortedReferenceMetadataList &sortedReferenceMetadataList, const std::size_t spacing)
+    {
+        uint64_t ret = 0;
+        for (const SortedReferenceMetadata &sortedReferenceMetadata : sortedReferenceMetadataList)
+        {
+            const SortedReferenceMetadata::Contigs &contigs = sortedReferenceMetadata.getContigs();
+            // each contig is preceded by spacing and padded to ISAAC_CONTIG_LENGTH_MIN
+            ret += genomeLength(contigs) + (contigs.size() + 1) * (spacing + ISAAC_CONTIG_LENGTH_MIN);
+        }
+        return ret * (common::isNumaAvailable() ? common::getNumaNodeCount() : 1);
+    }
 //    operator const ContigLists &()const {return replicas_.threadNodeContainer();}
 };
 
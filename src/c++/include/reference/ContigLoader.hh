@@ -20,8 +20,11 @@
 #ifndef iSAAC_REFERENCE_CONTIGS_LOADER_HH
 #define iSAAC_REFERENCE_CONTIGS_LOADER_HH
 
+#include <atomic>
+
 #include <boost/format.hpp>
 
+#include "common/TaskScheduler.hh"
 #include "common/Threads.hpp"
 #include "reference/Contig.hh"
 #include "reference/SortedReferenceMetadata.hh"
@@ -92,28 +95,67 @@ template <typename ShouldLoadF> reference::ContigList loadContigs(
 }
 
 /**
- * \brief loads the fasta file contigs into memory on multiple threads
+ * \brief loads the fasta file contigs of all references into memory. The contigs of all references are
+ *        loaded in a single pass by at most loadersMax tasks of the process-wide scheduler
  */
 template <typename AllowLoadContigT, typename IsDecoyT> reference::ContigLists loadContigs(
     const reference::SortedReferenceMetadataList &sortedReferenceMetadataList,
     const std::size_t spacing,
     const AllowLoadContigT &allowLoadContig,
     const IsDecoyT &isDecoy,
-    common::ThreadVector &&loadThreads)
+    const unsigned loadersMax)
 {
     ISAAC_TRACE_STAT("loadContigs ");
 
-    reference::ContigLists ret;
-    ret.reserve(sortedReferenceMetadataList.size());
-
+    std::vector<SortedReferenceMetadata::Contigs> xmlContigLists;
+    xmlContigLists.reserve(sortedReferenceMetadataList.size());
+    std::vector<ContigList> contigLists;
+    contigLists.reserve(sortedReferenceMetadataList.size());
+    // pair<contig list, contig to load into it>
+    std::vector<std::pair<ContigList *, const SortedReferenceMetadata::Contig *> > contigsToLoad;
     for(const reference::SortedReferenceMetadata &sortedReferenceMetadata : sortedReferenceMetadataList)
     {
-        SortedReferenceMetadata::Contigs decoysMarkedContigs = sortedReferenceMetadata.getContigs();
+        xmlContigLists.push_back(sortedReferenceMetadata.getContigs());
+        SortedReferenceMetadata::Contigs &decoysMarkedContigs = xmlContigLists.back();
         std::for_each(decoysMarkedContigs.begin(), decoysMarkedContigs.end(),
                       [&isDecoy](SortedReferenceMetadata::Contig &contig){contig.decoy_ = isDecoy(contig.name_);});
+        contigLists.push_back(ContigList(decoysMarkedContigs, spacing));
+        for (const SortedReferenceMetadata::Contig &xmlContig : decoysMarkedContigs)
+        {
+            if (allowLoadContig(xmlContig))
+            {
+                contigsToLoad.push_back(std::make_pair(&contigLists.back(), &xmlContig));
+            }
+        }
+    }
 
-        ContigList contigList = loadContigs(decoysMarkedContigs, spacing, allowLoadContig, loadThreads);
+    std::atomic<std::size_t> nextContigToLoad(0);
+    common::TaskGroup loaders;
+    for (unsigned loader = 0; loader < std::min<std::size_t>(loadersMax, contigsToLoad.size()); ++loader)
+    {
+        loaders.run([&contigsToLoad, &nextContigToLoad]()
+        {
+            for (std::size_t i = nextContigToLoad++; contigsToLoad.size() > i; i = nextContigToLoad++)
+            {
+                ContigList &contigList = *contigsToLoad.at(i).first;
+                const reference::SortedReferenceMetadata::Contig &xmlContig = *contigsToLoad.at(i).second;
+                ContigList::UpdateRange rwContig = contigList.getUpdateRange(xmlContig.index_);
+                loadContig(xmlContig, rwContig);
+                const unsigned traceStep = pow(10, int(log10((contigList.size() + 99) / 100)));
+                if (!(xmlContig.index_ % traceStep))
+                {
+                    ISAAC_THREAD_CERR << (boost::format("Contig(%3d:%8d) %s : %s\n") % xmlContig.index_ % xmlContig.totalBases_ % xmlContig.name_ % xmlContig.filePath_).str();
+                }
+            }
+        });
+    }
+    loaders.wait();
 
+    reference::ContigLists ret;
+    ret.reserve(sortedReferenceMetadataList.size());
+
+    for(ContigList &contigList : contigLists)
+    {
         const std::size_t decoys =
             std::count_if(contigList.begin(), contigList.end(), [](const ContigList::Contig &contig){return contig.isDecoy();});
         ISAAC_THREAD_CERR << "Loaded " << contigList.size() << " contigs of which " << decoys << " are decoys" << std::endl;
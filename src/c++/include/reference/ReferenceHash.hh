@@ -147,6 +147,18 @@ public:
         return ret;
     }
 
+    /// bytes taken by the table
+    uint64_t getMemoryFootprint() const
+    {
+        return offsets_.size() * sizeof(Offset) + positions_.size() * sizeof(typename Positions::value_type);
+    }
+
+    /// bytes the table will take for a genome of genomeLength. There is at most one k-mer per genome position
+    static uint64_t estimateMemoryFootprint(const uint64_t bucketCount, const uint64_t genomeLength)
+    {
+        return bucketCount * sizeof(Offset) + genomeLength * sizeof(typename Positions::value_type);
+    }
+
     MatchRange getEmptyRange() const
     {
         return std::make_pair(positions_.end(), positions_.end());
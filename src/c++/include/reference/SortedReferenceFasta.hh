@@ -22,6 +22,7 @@
 
 #include <boost/filesystem.hpp>
 
+#include "common/TaskScheduler.hh"
 #include "reference/SortedReferenceMetadata.hh"
 
 namespace isaac
@@ -30,7 +31,7 @@ namespace reference
 {
 SortedReferenceMetadata loadReferenceMetadataFromFasta(
     const boost::filesystem::path &xmlPath,
-    common::ThreadVector &threads);
+    common::TaskScheduler &scheduler);
 
 } // namespace reference
 } // namespace isaac
@@ -20,6 +20,11 @@
 #ifndef iSAAC_RTA_BCL_BGZF_TILE_READER_HH
 #define iSAAC_RTA_BCL_BGZF_TILE_READER_HH
 
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <chrono>
+
 #include <boost/format.hpp>
 #include <boost/iostreams/device/file.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -49,6 +54,26 @@ class CycleTileOffsetMap
 class BclBgzfTileReader
 {
 public:
+    /// data of a tile can extend into the bgzf block where the next tile starts
+    static const unsigned BGZF_BLOCK_SIZE_MAX = 0x10000;
+
+    struct LoadStats
+    {
+        LoadStats() : tileCycles_(0), compressedBytes_(0), microseconds_(0) {}
+        unsigned tileCycles_;
+        uint64_t compressedBytes_;
+        /// time spent reading and decompressing
+        uint64_t microseconds_;
+
+        LoadStats &operator +=(const LoadStats &that)
+        {
+            tileCycles_ += that.tileCycles_;
+            compressedBytes_ += that.compressedBytes_;
+            microseconds_ += that.microseconds_;
+            return *this;
+        }
+    };
+
     BclBgzfTileReader(const BclBgzfTileReader &that) :
         ignoreMissingBcls_(that.ignoreMissingBcls_),
         tileBciIndexMap_(that.tileBciIndexMap_),
@@ -93,22 +118,35 @@ public:
         }
         else
         {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
             std::istream source(
                 openFilePath_ == cycleFilePath_ ? &bclFileBuffer_ :
-                    // keep the cycle file open as we're continuing to read the next tile from the same file
-                    bclFileBuffer_.reopen(cycleFilePath_.c_str(), io::FileBufWithReopen::SequentialOnce));
+                    // keep the cycle file open as we're continuing to read the next tile from the same file.
+                    // Page cache is released per tile so that the prefetched data of the next tile is not dropped
+                    bclFileBuffer_.reopen(cycleFilePath_.c_str(), io::FileBufWithReopen::sequential));
             openFilePath_ = cycleFilePath_.c_str(); // avoid string buffer sharing on copy
             *reinterpret_cast<boost::uint32_t*>(cycleBuffer) = tile.getClusterCount();
 
+            const rta::CycleBciMapper &cycleBciMapper = cycleBciMappers_.at(cycle);
+            const unsigned bciTileIndex = tileBciIndexMap_.at(tile.getOriginalIndex());
+            const rta::CycleBciMapper::VirtualOffset tileOffset = cycleBciMapper.getTileOffset(bciTileIndex);
             const unsigned clusters = loadCompressedBcl(
-                source, cycleFilePath_,
-                cycleBciMappers_.at(cycle).getTileOffset(tileBciIndexMap_.at(tile.getOriginalIndex())),
+                source, cycleFilePath_, tileOffset,
                 cycleBuffer + sizeof(boost::uint32_t), tile.getClusterCount());
 //            ISAAC_THREAD_CERR << "Read " << clusters << " clusters from " << cycleFilePath_ << std::endl;
+
+            const uint64_t tileEnd = prefetchNextTile(cycleBciMapper, bciTileIndex);
+            loadStats_.compressedBytes_ += tileEnd - tileOffset.compressedOffset;
+            ++loadStats_.tileCycles_;
+            loadStats_.microseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
             return clusters;
         }
     }
 
+    const LoadStats &getLoadStats() const {return loadStats_;}
+    void resetLoadStats() {loadStats_ = LoadStats();}
+
 private:
     const bool ignoreMissingBcls_;
     const std::vector<unsigned> &tileBciIndexMap_;
@@ -117,9 +155,36 @@ private:
     boost::filesystem::path cycleFilePath_;
     io::FileBufWithReopen bclFileBuffer_;
     boost::filesystem::path openFilePath_;
+    LoadStats loadStats_;
 
     typedef boost::error_info<struct tag_errmsg, std::string> errmsg_info;
 
+    /**
+     * \brief Releases page cache of the tile that has just been loaded and asks the kernel to start reading the
+     *        next tile of the open cycle file, so that the next tile load does not wait for the disk.
+     *
+     * \return compressed offset at which the next tile starts or the file size for the last tile
+     */
+    uint64_t prefetchNextTile(const rta::CycleBciMapper &cycleBciMapper, const unsigned bciTileIndex)
+    {
+        const int fd = bclFileBuffer_.fileDescriptor();
+        const uint64_t tileBegin = cycleBciMapper.getTileOffset(bciTileIndex).compressedOffset;
+        if (cycleBciMapper.getTilesCount() == bciTileIndex + 1)
+        {
+            posix_fadvise(fd, tileBegin, 0, POSIX_FADV_DONTNEED);
+            struct stat fileStat;
+            return fstat(fd, &fileStat) ? tileBegin : std::max<uint64_t>(tileBegin, fileStat.st_size);
+        }
+
+        const uint64_t nextTileBegin = cycleBciMapper.getTileOffset(bciTileIndex + 1).compressedOffset;
+        const uint64_t nextTileEnd = cycleBciMapper.getTilesCount() == bciTileIndex + 2 ?
+            0 : cycleBciMapper.getTileOffset(bciTileIndex + 2).compressedOffset + BGZF_BLOCK_SIZE_MAX;
+        // the block at nextTileBegin is shared with the next tile
+        posix_fadvise(fd, tileBegin, nextTileBegin - tileBegin, POSIX_FADV_DONTNEED);
+        posix_fadvise(fd, nextTileBegin, nextTileEnd ? nextTileEnd - nextTileBegin : 0, POSIX_FADV_WILLNEED);
+        return nextTileBegin;
+    }
+
     void reserveBuffers(
         const std::size_t reservePathLength)
     {
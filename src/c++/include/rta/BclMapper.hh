@@ -29,12 +29,14 @@
 #include "common/FileSystem.hh"
 #include "common/Memory.hh"
 #include "common/Numa.hh"
+#include "common/TaskScheduler.hh"
 #include "common/Threads.hpp"
 #include "flowcell/Layout.hh"
 #include "flowcell/TileMetadata.hh"
 
 #include "io/InflateGzipDecompressor.hh"
 #include "io/FileBufCache.hh"
+#include "rta/BclTranspose.hh"
 
 namespace isaac
 {
@@ -60,14 +62,11 @@ public:
         extractCluster(clusterIndex, getTileSize(1), insertIterator);
     }
 
-    template <typename InsertIteratorT>
-    void transpose(InsertIteratorT insertIterator) const
+    template <typename RandomAccessIteratorT>
+    void transpose(RandomAccessIteratorT outputIterator) const
     {
-        const unsigned increment = getTileSize(1);
-        for (unsigned clusterIndex = 0; clusterCount_ > clusterIndex; ++ clusterIndex)
-        {
-            insertIterator = extractCluster(clusterIndex, increment, insertIterator);
-        }
+        transposeBcl(getBclBufferStart(0) + getClusterOffset(0), getTileSize(1), getCyclesCount(),
+                     0, clusterCount_, &*outputIterator, getCyclesCount());
     }
 
     static unsigned int getClusterCount(const boost::filesystem::path &bclFilePath)
@@ -101,6 +100,10 @@ public:
     unsigned getCyclesCount() const {return cycleNumbers_;}
 
 protected:
+    /**
+     * \brief Gathers one cluster. Cycles are a tile apart, so there is nothing for transposeBcl to share between
+     *        the loads. Used for single clusters only, whole tiles go through transpose.
+     */
     template <typename InsertIteratorT>
     InsertIteratorT extractCluster(unsigned clusterIndex, const unsigned increment, InsertIteratorT insertIterator) const
     {
@@ -204,7 +207,6 @@ class ParallelBclMapper : BclMapper
     const unsigned maxInputLoaders_;
     std::vector<ReaderT> &threadReaders_;
     std::vector<unsigned> cycleNumbers_;
-    const std::size_t transposeThreadCount_;
 public:
     using BclMapper::transpose;
     using BclMapper::getCyclesCount;
@@ -217,8 +219,7 @@ public:
         threads_(threads),
         maxInputLoaders_(maxInputLoaders),
         threadReaders_(threadReaders),
-        cycleNumbers_(maxCycles),
-        transposeThreadCount_(std::min<std::size_t>(threads_.size(), boost::thread::hardware_concurrency()))
+        cycleNumbers_(maxCycles)
     {
         ISAAC_TRACE_STAT("ParallelBclMapper::ParallelBclMapper for maxInputLoaders=" << maxInputLoaders)
     }
@@ -244,33 +245,29 @@ public:
             cycleNumbers_.end()), std::min<unsigned>(cycleNumbers_.size(), maxInputLoaders_));
     }
 
+    /**
+     * \brief Transposes the tile into cluster-major layout on the process-wide task scheduler. Each subrange is made
+     *        of whole TRANSPOSE_BLOCK_CLUSTERS blocks so that no cache line of cycle data is shared between threads.
+     *        Loaders of different tiles transpose concurrently without oversubscribing the cores.
+     */
     template <typename RandomAccessIteratorT>
     void transpose(RandomAccessIteratorT outputIterator) const
     {
-        threads_.execute(
-            [this, outputIterator](const unsigned threadNumber, const unsigned threadsTotal)
+        common::TaskScheduler &scheduler = common::TaskScheduler::instance();
+        const std::size_t clusterCount = getGeometryClusterCount();
+        const std::size_t blocks = (clusterCount + TRANSPOSE_BLOCK_CLUSTERS - 1) / TRANSPOSE_BLOCK_CLUSTERS;
+        // about one subrange per worker
+        const std::size_t grain = std::max<std::size_t>(1, (blocks + scheduler.getWorkers() - 1) / scheduler.getWorkers());
+        scheduler.parallelFor(
+            0, blocks, grain,
+            [this, outputIterator, clusterCount](const std::size_t blockBegin, const std::size_t blockEnd)
             {
-                const unsigned chunkSize = (getGeometryClusterCount() + threadsTotal - 1) / threadsTotal;
-                const unsigned clusterBegin = chunkSize * threadNumber;
-                const unsigned clusterEnd = std::min(getGeometryClusterCount(), chunkSize * (threadNumber + 1));
-                // if there are less clusters than threads, let only thread 0 do the job
-                if (clusterBegin || !threadNumber)
-                {
-                    const unsigned increment = getTileSize(1);
-                    RandomAccessIteratorT oi = outputIterator + clusterBegin * getCyclesCount();
-                    for (unsigned clusterIndex = clusterBegin; clusterEnd > clusterIndex; ++clusterIndex)
-                    {
-                        oi = extractCluster(clusterIndex, increment, oi);
-                    }
-                }
-            },
-            transposeThreadCount_);
-
-//        const unsigned increment = getTileSize(1);
-//        for (unsigned clusterIndex = 0; clusterCount_ > clusterIndex; ++ clusterIndex)
-//        {
-//            extractCluster(clusterIndex, increment, insertIterator);
-//        }
+                const std::size_t clusterBegin = blockBegin * TRANSPOSE_BLOCK_CLUSTERS;
+                const std::size_t clusterEnd = std::min(clusterCount, blockEnd * TRANSPOSE_BLOCK_CLUSTERS);
+                RandomAccessIteratorT oi = outputIterator + clusterBegin * getCyclesCount();
+                transposeBcl(getBclBufferStart(0) + getClusterOffset(clusterBegin), getTileSize(1), getCyclesCount(),
+                             0, clusterEnd - clusterBegin, &*oi, getCyclesCount());
+            });
     }
 
 private:
@@ -0,0 +1,73 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclTranspose.hh
+ **
+ ** \brief Conversion of cycle-major bcl data into cluster-major layout.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_RTA_BCL_TRANSPOSE_HH
+#define iSAAC_RTA_BCL_TRANSPOSE_HH
+
+#include <cstddef>
+
+namespace isaac
+{
+namespace rta
+{
+
+/**
+ * \brief Clusters processed by one block of transposeBcl. Cycles of a tile are megabytes apart, so the block
+ *        must be wide enough for each touched page of cycle data to do useful work, while the cluster-major
+ *        output of the block stays within L2 for read lengths up to a few hundred cycles.
+ */
+static const std::size_t TRANSPOSE_BLOCK_CLUSTERS = 2048;
+
+/**
+ * \brief Transposes clusters [clusterBegin, clusterEnd) from cycle-major into cluster-major layout.
+ *
+ * The data is processed in blocks of TRANSPOSE_BLOCK_CLUSTERS clusters by all cycles. Within the block, 16 cycles
+ * by 16 clusters are transposed in registers.
+ *
+ * \param cycles         address of the first cluster of the first cycle
+ * \param cycleStride    distance in bytes between the first clusters of the consecutive cycles
+ * \param cycleCount     number of cycles to transpose
+ * \param clusters       address of the first cycle of cluster 0 in the output
+ * \param clusterStride  distance in bytes between the consecutive clusters in the output
+ */
+void transposeBcl(
+    const char *cycles,
+    const std::size_t cycleStride,
+    const unsigned cycleCount,
+    const std::size_t clusterBegin,
+    const std::size_t clusterEnd,
+    char *clusters,
+    const std::size_t clusterStride);
+
+/**
+ * \brief Byte by byte equivalent of transposeBcl.
+ */
+void transposeBclStrided(
+    const char *cycles,
+    const std::size_t cycleStride,
+    const unsigned cycleCount,
+    const std::size_t clusterBegin,
+    const std::size_t clusterEnd,
+    char *clusters,
+    const std::size_t clusterStride);
+
+} // namespace rta
+} // namespace isaac
+
+#endif // #ifndef iSAAC_RTA_BCL_TRANSPOSE_HH
@@ -0,0 +1,248 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclTileReader.hh
+ **
+ ** Reads tile cycles out of NovaSeq cbcl files.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_RTA_CBCL_TILE_READER_HH
+#define iSAAC_RTA_CBCL_TILE_READER_HH
+
+#include <array>
+#include <cstdint>
+
+#include <boost/format.hpp>
+
+#include "flowcell/CbclLayout.hh"
+#include "flowcell/TileMetadata.hh"
+#include "io/FiltersMapper.hh"
+#include "io/InflateGzipDecompressor.hh"
+#include "io/FileBufWithReopen.hh"
+
+namespace isaac
+{
+namespace rta
+{
+
+/**
+ * \brief Cbcl file header. The header is followed by the gzip-compressed blocks of each tile in the order of
+ *        tile records. Each uncompressed block stores two clusters per byte, first cluster in the low nibble.
+ *        Each nibble has the base in bits 0-1 and the quality score bin in bits 2-3.
+ */
+class CbclHeader
+{
+public:
+    static const unsigned SUPPORTED_VERSION = 1;
+    /// 4 bits per quality bin allows at most 16 bins
+    static const unsigned QSCORE_BINS_MAX = 16;
+
+    struct TileRecord
+    {
+        unsigned tile_;
+        unsigned clusters_;
+        unsigned uncompressedBytes_;
+        unsigned compressedBytes_;
+        /// file offset of the compressed block
+        uint64_t offset_;
+    };
+
+    CbclHeader() : headerBytes_(0), nonPfClustersExcluded_(false)
+    {
+        qScores_.fill(0);
+        tiles_.reserve(TILE_RECORDS_RESERVE);
+    }
+
+    /**
+     * \brief Reads the header from the beginning of the stream. Does not allocate memory unless the number of tiles
+     *        exceeds the reserved one.
+     */
+    void read(std::istream &is, const boost::filesystem::path &filePath);
+
+    /// \return 0 if the tile is not in the file
+    const TileRecord *findTile(const unsigned tile) const;
+
+    const std::vector<TileRecord> &getTiles() const {return tiles_;}
+    bool nonPfClustersExcluded() const {return nonPfClustersExcluded_;}
+
+    /**
+     * \brief Converts one byte of cbcl data into two bcl bytes, first cluster in the low byte. Quality bin 0
+     *        becomes no-call
+     */
+    uint16_t translate(const unsigned char packed) const {return byteToBcl_[packed];}
+
+private:
+    static const unsigned TILE_RECORDS_RESERVE = 1024;
+
+    uint32_t headerBytes_;
+    bool nonPfClustersExcluded_;
+    std::array<unsigned char, QSCORE_BINS_MAX> qScores_;
+    std::vector<TileRecord> tiles_;
+    std::array<uint16_t, 256> byteToBcl_;
+
+    unsigned char nibbleToBcl(const unsigned char nibble) const
+    {
+        const unsigned char qBin = nibble >> 2;
+        return qBin ? (std::min<unsigned char>(qScores_[qBin], 63) << 2) | (nibble & 3) : 0;
+    }
+};
+
+/**
+ * \brief Reader for use with ParallelBclMapper and BarcodeLoader. Inflates the tile block of the cycle cbcl file
+ *        and expands it into one bcl byte per cluster. When the instrument excluded non-pf clusters from the cbcl
+ *        files, the non-pf clusters are filled with no-calls according to the tile filter file.
+ */
+class CbclTileReader
+{
+public:
+    CbclTileReader(const CbclTileReader &that);
+
+    CbclTileReader(
+        const std::size_t reservePathLength,
+        const bool ignoreMissingBcls,
+        const bool ignoreMissingFilters,
+        const unsigned maxClusters);
+
+    unsigned readTileCycle(
+        const flowcell::Layout &flowcellLayout,
+        const flowcell::TileMetadata &tile,
+        const unsigned cycle,
+        char *cycleBuffer, const std::size_t bufferSize)
+    {
+        flowcellLayout.getLaneTileCycleAttribute<flowcell::Layout::Cbcl, flowcell::BclFilePathAttributeTag>(
+            tile.getLane(), tile.getTile(), cycle, cycleFilePath_);
+        ISAAC_ASSERT_MSG(tile.getClusterCount() < bufferSize, "Insufficient buffer to read all clusters for " <<
+                         cycleFilePath_ << " bufferSize:" << bufferSize << tile);
+
+        *reinterpret_cast<uint32_t*>(cycleBuffer) = tile.getClusterCount();
+        char *bcl = cycleBuffer + sizeof(uint32_t);
+        if (ignoreMissingBcls_ && !boost::filesystem::exists(cycleFilePath_))
+        {
+            ISAAC_THREAD_CERR << "WARNING: Ignoring missing cbcl file: " << cycleFilePath_ << std::endl;
+            std::fill(bcl, bcl + tile.getClusterCount(), 0);
+            return tile.getClusterCount();
+        }
+
+        std::istream source(
+            openFilePath_ == cycleFilePath_ ? &cbclFileBuffer_ :
+                cbclFileBuffer_.reopen(cycleFilePath_.c_str(), io::FileBufWithReopen::normal));
+        if (!source)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open " + cycleFilePath_.string()));
+        }
+        if (openFilePath_ != cycleFilePath_)
+        {
+            header_.read(source, cycleFilePath_);
+            openFilePath_ = cycleFilePath_.c_str(); // avoid string buffer sharing on copy
+        }
+
+        const CbclHeader::TileRecord *record = header_.findTile(tile.getTile());
+        if (!record)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format("Tile %d is not found in %s") %
+                tile.getTile() % cycleFilePath_).str()));
+        }
+
+        if (header_.nonPfClustersExcluded())
+        {
+            loadPf(flowcellLayout, tile);
+        }
+        const unsigned storedClusters = header_.nonPfClustersExcluded() ?
+            std::count_if(pf_.begin(), pf_.end(), [](const char pf){return pf & 1;}) : tile.getClusterCount();
+        inflateTile(source, *record, storedClusters);
+
+        if (header_.nonPfClustersExcluded())
+        {
+            expandPf(bcl);
+        }
+        else
+        {
+            expand(storedClusters, bcl);
+        }
+        return tile.getClusterCount();
+    }
+
+    /**
+     * \brief Reads header of the cbcl file.
+     */
+    static void readHeader(const boost::filesystem::path &cbclFilePath, CbclHeader &header);
+
+    /**
+     * \return number of clusters in the tile, or 0 if the tile is not present in the cbcl header.
+     */
+    static unsigned getTileClusterCount(
+        const flowcell::Layout &flowcellLayout,
+        const CbclHeader &header,
+        const unsigned lane,
+        const unsigned tile)
+    {
+        const CbclHeader::TileRecord *record = header.findTile(tile);
+        if (!record)
+        {
+            return 0;
+        }
+        if (!header.nonPfClustersExcluded())
+        {
+            return record->clusters_;
+        }
+        // only pf clusters are stored. The filter file knows the number of clusters in the tile
+        boost::filesystem::path filterFilePath;
+        flowcellLayout.getLaneTileAttribute<flowcell::Layout::Cbcl, flowcell::FiltersFilePathAttributeTag>(
+            lane, tile, filterFilePath);
+        return io::FiltersMapper::getClusterCount(filterFilePath);
+    }
+
+private:
+    static const std::size_t DECOMPRESSOR_BUFFER_BYTES = 0x10000;
+    const bool ignoreMissingBcls_;
+    const bool ignoreMissingFilters_;
+    const unsigned maxClusters_;
+    io::InflateGzipDecompressor<std::vector<char> > decompressor_;
+    boost::filesystem::path cycleFilePath_;
+    boost::filesystem::path openFilePath_;
+    boost::filesystem::path filterFilePath_;
+    boost::filesystem::path pfFilePath_;
+    io::FileBufWithReopen cbclFileBuffer_;
+    CbclHeader header_;
+    std::vector<char> packed_;
+    io::FiltersMapper filtersMapper_;
+    std::vector<char> pf_;
+
+    void reserveBuffers(const std::size_t reservePathLength);
+
+    void loadPf(const flowcell::Layout &flowcellLayout, const flowcell::TileMetadata &tile)
+    {
+        flowcellLayout.getLaneTileAttribute<flowcell::Layout::Cbcl, flowcell::FiltersFilePathAttributeTag>(
+            tile.getLane(), tile.getTile(), filterFilePath_);
+        // all cycles of the tile need the same pf flags
+        if (pfFilePath_ != filterFilePath_)
+        {
+            pf_.clear();
+            filtersMapper_.mapTile(filterFilePath_, tile.getClusterCount());
+            filtersMapper_.getPf(std::back_inserter(pf_));
+            pfFilePath_ = filterFilePath_.c_str();
+        }
+    }
+
+    void inflateTile(std::istream &source, const CbclHeader::TileRecord &record, const unsigned storedClusters);
+    /// translates packed_ into one bcl byte per cluster
+    void expand(const unsigned clusters, char *bcl) const;
+    /// translates packed_ into one bcl byte per cluster. Fills clusters that don't pass filter with no-calls.
+    void expandPf(char *bcl) const;
+};
+
+} // namespace rta
+} // namespace isaac
+
+#endif // #ifndef iSAAC_RTA_CBCL_TILE_READER_HH
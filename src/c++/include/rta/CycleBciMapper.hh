@@ -100,6 +100,11 @@ public:
         return tileOffsets_.at(tileIndex);
     }
 
+    unsigned getTilesCount() const
+    {
+        return tileOffsets_.size();
+    }
+
 private:
     std::vector<VirtualOffset> tileOffsets_;
 };
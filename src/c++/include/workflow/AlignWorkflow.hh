@@ -35,6 +35,8 @@
 #include "alignment/TemplateLengthStatistics.hh"
 #include "alignment/matchFinder/TileClusterInfo.hh"
 #include "build/BinSorter.hh"
+#include "build/OutputFormat.hh"
+#include "common/MemoryBudget.hh"
 #include "common/Threads.hpp"
 #include "demultiplexing/BarcodeLoader.hh"
 #include "demultiplexing/BarcodeResolver.hh"
@@ -137,11 +139,16 @@ public:
         const unsigned inputLoadersMax,
         const unsigned tempSaversMax,
         const unsigned tempLoadersMax,
+        const bool tempLoadersAdaptive,
+        const bool tempDirectIo,
         const unsigned outputSaversMax,
         const build::GapRealignerMode realignGaps,
         const unsigned realignMapqMin,
         const boost::filesystem::path &knownIndelsPath,
         const int bamGzipLevel,
+        const build::OutputFormat outputFormat,
+        const unsigned bamIndexFormat,
+        const unsigned csiMinShift,
         const std::string &bamPuFormat,
         const bool bamProduceMd5,
         const std::vector<std::string> &bamHeaderTags,
@@ -160,7 +167,9 @@ public:
         const boost::array<char, 256> &fullBclQScoreTable,
         const OptionalFeatures optionalFeatures,
         const bool pessimisticMapQ,
-        const unsigned detectTemplateBlockSize);
+        const unsigned detectTemplateBlockSize,
+        const bool reportsDuringBam,
+        const bool fastqParallelExtraction);
 
     /**
      * \brief Runs end-to-end alignment from the beginning
@@ -239,9 +248,6 @@ private:
     const unsigned expectedCoverage_;
     const unsigned int estimatedFragmentSize_;
     const double expectedBgzfCompressionRatio_;
-    const uint64_t targetFragmentsPerBin_;
-    const uint64_t targetBinLength_;
-    const uint64_t targetBinSize_;
     const unsigned clustersAtATimeMax_;
     const int mapqThreshold_;
     const bool perTileTls_;
@@ -270,11 +276,16 @@ private:
     const unsigned inputLoadersMax_;
     const unsigned tempSaversMax_;
     const unsigned tempLoadersMax_;
+    const bool tempLoadersAdaptive_;
+    const bool tempDirectIo_;
     const unsigned outputSaversMax_;
     const build::GapRealignerMode realignGaps_;
     const unsigned realignMapqMin_;
     const boost::filesystem::path &knownIndelsPath_;
     const int bamGzipLevel_;
+    const build::OutputFormat outputFormat_;
+    const unsigned bamIndexFormat_;
+    const unsigned csiMinShift_;
     const std::string &bamPuFormat_;
     const bool bamProduceMd5_;
     const std::vector<std::string> &bamHeaderTags_;
@@ -294,7 +305,13 @@ private:
 
     const reference::ReferenceMetadataList &referenceMetadataList_;
     const reference::SortedReferenceMetadataList sortedReferenceMetadataList_;
+    // reserved before the references are loaded
+    common::MemoryReservation referenceMemory_;
     const reference::NumaContigLists contigLists_;
+    // sized after the reference is reserved so that the bins don't count on memory the reference occupies
+    const uint64_t targetFragmentsPerBin_;
+    const uint64_t targetBinLength_;
+    const uint64_t targetBinSize_;
 
     State state_;
     alignWorkflow::FoundMatchesMetadata foundMatchesMetadata_;
@@ -302,11 +319,14 @@ private:
     std::vector<alignment::TemplateLengthStatistics> barcodeTemplateLengthStatistics_;
     demultiplexing::BarcodePathMap barcodeBamMapping_;
     const unsigned detectTemplateBlockSize_;
+    // alignment reports are generated during bam generation. AlignDone is followed by BamDone
+    const bool reportsDuringBam_;
+    // see FastqLoader::loadClustersParallel
+    const bool fastqParallelExtraction_;
 
 
     static reference::SortedReferenceMetadataList loadSortedReferenceXml(
-        const reference::ReferenceMetadataList &referenceMetadataList,
-        const unsigned coresMax);
+        const reference::ReferenceMetadataList &referenceMetadataList);
 
     void findMatches(
         alignWorkflow::FoundMatchesMetadata &foundMatches,
@@ -314,6 +334,7 @@ private:
         std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const;
     void cleanupBins() const;
     void generateAlignmentReports() const;
+    void generateBamWithAlignmentReports();
     const demultiplexing::BarcodePathMap generateBam(
         const SelectedMatchesMetadata &binPaths,
         const std::vector<alignment::TemplateLengthStatistics> &barcodeTemplateLengthStatistics) const;
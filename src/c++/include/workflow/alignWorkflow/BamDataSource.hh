@@ -51,16 +51,19 @@ public:
         const std::size_t maxPathLength,
         common::ThreadVector &threads,
         const unsigned coresMax,
+        const io::cram::References &references,
         const boost::filesystem::path &tempDirectoryPath,
         const std::size_t maxBamFileLength,
         const std::size_t maxFlowcellIdLength,
         const std::size_t maxReadNameLength,
         const std::size_t minClusterLength,
-        const std::size_t minReadLength) :
-        bamLoader_(maxPathLength, threads, coresMax),
+        const std::size_t minReadLength,
+        const std::size_t unpairedMemoryBudget) :
+        bamLoader_(maxPathLength, coresMax, references),
         clusterExtractor_(tempDirectoryPath, maxBamFileLength, maxFlowcellIdLength, maxReadNameLength, minClusterLength, cleanupIntermediary,
                           // assume each uncompressed bam record is roughly sizeof(header) + (read length * 2). Double the estimate.
-                          bamLoader_.BUFFER_SIZE / (sizeof(bam::BamBlockHeader) + minReadLength * 2) * 2)
+                          bamLoader_.BUFFER_SIZE / (sizeof(bam::BamBlockHeader) + minReadLength * 2) * 2,
+                          unpairedMemoryBudget, threads, coresMax)
     {
         flowcellId_.reserve(maxFlowcellIdLength);
     }
@@ -88,6 +91,8 @@ private:
 
 class BamBaseCallsSource : virtual public TileSource, virtual public BarcodeSource
 {
+    // fraction of available memory that unpaired reads are paired in
+    static const unsigned UNPAIRED_MEMORY_FRACTION = 4;
 protected:
     const flowcell::Layout &bamFlowcellLayout_;
 private:
@@ -108,6 +113,7 @@ public:
         const bool cleanupIntermediary,
         const unsigned coresMax,
         const flowcell::Layout &bamFlowcellLayout,
+        const io::cram::References &references,
         common::ThreadVector &threads);
 
     // TileSource implementation
@@ -179,6 +185,7 @@ public:
         const bool cleanupIntermediary,
         const unsigned coresMax,
         const flowcell::Layout &bamFlowcellLayout,
+        const io::cram::References &references,
         common::ThreadVector &threads) :
             BamBaseCallsSource(tempDirectoryPath,
                 availableMemory,
@@ -186,6 +193,7 @@ public:
                 cleanupIntermediary,
                 coresMax,
                 bamFlowcellLayout,
+                references,
                 threads)
     {
         tileLoadThread_ = std::thread([this](){loadTilesThread();});
@@ -0,0 +1,111 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclDataSource.hh
+ **
+ ** \brief Encapsulation of BaseCalls folder with NovaSeq cbcl and filter files as seed and cluster data source
+ **
+ ** \author Roman Petrovski
+ **/
+
+#ifndef iSAAC_WORKFLOW_ALIGN_WORKFLOW_CBCL_DATA_SOURCE_HH
+#define iSAAC_WORKFLOW_ALIGN_WORKFLOW_CBCL_DATA_SOURCE_HH
+
+#include "demultiplexing/BarcodeLoader.hh"
+#include "flowcell/BarcodeMetadata.hh"
+#include "flowcell/Layout.hh"
+#include "flowcell/TileMetadata.hh"
+#include "io/LocsMapper.hh"
+#include "io/FiltersMapper.hh"
+#include "rta/CbclTileReader.hh"
+#include "rta/BclMapper.hh"
+#include "workflow/alignWorkflow/DataSource.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace alignWorkflow
+{
+
+class CbclBaseCallsSource : public BarcodeSource, public TileSource
+{
+    const flowcell::Layout &flowcell_;
+    common::ThreadVector &bclLoadThreads_;
+
+    // temporaries to avoid memory allocations during data processing
+    boost::filesystem::path filterFilePath_;
+    boost::filesystem::path positionsFilePath_;
+
+    const flowcell::TileMetadataList flowcellTiles_;
+    flowcell::TileMetadataList::const_iterator undiscoveredTiles_;
+
+    std::vector<rta::CbclTileReader> threadReaders_;
+    rta::ParallelBclMapper<rta::CbclTileReader> bclMapper_;
+    io::FiltersMapper filtersMapper_;
+    io::LocsMapper locsMapper_;
+    demultiplexing::BarcodeLoader<rta::CbclTileReader> barcodeLoader_;
+
+public:
+    CbclBaseCallsSource(
+        const flowcell::Layout &flowcell,
+        const bool ignoreMissingBcls,
+        const bool ignoreMissingFilters,
+        common::ThreadVector &bclLoadThreads,
+        const unsigned inputLoadersMax,
+        const bool extractClusterXy);
+
+    unsigned getMaxTileClusters() const { return flowcell::getMaxTileClusters(flowcellTiles_);}
+
+    flowcell::TileMetadataList discoverTiles();
+
+    // prepare bclData buffers to receive new tile data
+    void resetBclData(
+        const flowcell::TileMetadata& tileMetadata,
+        alignment::BclClusters& bclData) const;
+
+    void loadClusters(
+        const flowcell::TileMetadata &tileMetadata,
+        alignment::BclClusters &bclData);
+
+    // BarcodeSource implementation
+    virtual void loadBarcodes(
+        const flowcell::Layout &flowcell,
+        const unsigned unknownBarcodeIndex,
+        const flowcell::TileMetadataList &tiles,
+        demultiplexing::Barcodes &barcodes);
+
+private:
+    /**
+     * \brief Tiles and their cluster counts come from the headers of the first data cycle cbcl files
+     *
+     * \return vector of tiles ordered by: flowcellId_, lane_, tile_
+     */
+    static flowcell::TileMetadataList getTiles(const flowcell::Layout &flowcellLayout);
+
+    void bclToClusters(
+        const flowcell::TileMetadata &tileMetadata,
+        alignment::BclClusters &bclData) const;
+};
+
+template <>
+struct DataSourceTraits<CbclBaseCallsSource>
+{
+    static const bool SUPPORTS_XY = true;
+};
+
+
+} // namespace alignWorkflow
+} // namespace workflow
+} // namespace isaac
+
+#endif // #ifndef iSAAC_WORKFLOW_ALIGN_WORKFLOW_CBCL_DATA_SOURCE_HH
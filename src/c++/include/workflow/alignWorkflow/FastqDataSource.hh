@@ -68,7 +68,8 @@ public:
         const unsigned coresMax,
         const flowcell::BarcodeMetadataList &barcodeMetadataList,
         const flowcell::Layout &fastqFlowcellLayout,
-        common::ThreadVector &threads);
+        common::ThreadVector &threads,
+        const bool parallelExtraction);
     ~FastqBaseCallsSource();
 
     // TileSource implementation
@@ -185,7 +185,8 @@ public:
         const bool preSortBins,
         const bool preAllocateBins,
         const std::string &binRegexString,
-        const unsigned detectTemplateBlockSize);
+        const unsigned detectTemplateBlockSize,
+        const bool fastqParallelExtraction);
 
     template <typename KmerT>
     void perform(
@@ -250,6 +251,7 @@ private:
 
     const reference::SortedReferenceMetadataList &sortedReferenceMetadataList_;
     const bool extractClusterXy_;
+    const bool fastqParallelExtraction_;
 
     const bool debugAlignments_;
     const unsigned maxGapsPerRead_;
@@ -170,7 +170,7 @@ private:
 };
 
 // For some reason this needs the below abomination on windows, so, just don't have it and explicitly specialize
-// with BclBaseCallsSource and BclBgzfBaseCallsSource
+// with BclBaseCallsSource, BclBgzfBaseCallsSource and CbclBaseCallsSource
 //#ifndef _WIN32
 //template <>
 //#endif
@@ -189,6 +189,11 @@ struct DataSourceTraits<MultiTileBaseCallsSource<BclBgzfBaseCallsSource> > : pub
 {
 };
 
+template <>
+struct DataSourceTraits<MultiTileBaseCallsSource<CbclBaseCallsSource> > : public DataSourceTraits<CbclBaseCallsSource>
+{
+};
+
 
 } // namespace alignWorkflow
 } // namespace workflow
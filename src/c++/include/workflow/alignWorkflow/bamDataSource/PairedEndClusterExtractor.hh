@@ -20,18 +20,16 @@
 #ifndef iSAAC_WORKFLOW_ALIGN_WORKFLOW_BAM_DATA_SOURCE_PAIRED_END_CLUSTER_EXTRACTOR_HH
 #define iSAAC_WORKFLOW_ALIGN_WORKFLOW_BAM_DATA_SOURCE_PAIRED_END_CLUSTER_EXTRACTOR_HH
 
-#include <cmath>
-
 #include <boost/crc.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/mpl/vector.hpp>
-#include <boost/mpl/front.hpp>
-#include <boost/mpl/back.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include "bam/Bam.hh"
 #include "bam/BamParser.hh"
 #include "common/FastIo.hh"
 #include "common/FileSystem.hh"
+#include "common/MemoryBudget.hh"
+#include "common/Threads.hpp"
 #include "flowcell/ReadMetadata.hh"
 #include "io/FileBufCache.hh"
 #include "reference/ReferencePosition.hh"
@@ -259,72 +257,83 @@ private:
     }
 };
 
+/**
+ * \brief Unpaired reads evicted from the bam buffers are partitioned by read name hash into buckets on disk. Once the
+ *        bam is exhausted, batches of buckets are loaded and paired in memory in parallel.
+ *
+ * The number of buckets is chosen so that a batch of buckets loaded at the same time fits into the memory budget
+ * assuming none of the input reads pair in the bam buffers, which is the case for coordinate-sorted input.
+ */
 class UnpairedReadsCache
 {
-    template <unsigned requiredWidth>
-    struct CrcSelector
-    {
-        template <unsigned minVal, unsigned maxVal, unsigned val>
-        struct MinMax
-        {
-            BOOST_STATIC_CONSTANT(unsigned, value
-             = (val < minVal) ? minVal : (val > maxVal) ? maxVal : val);
-        };
-
-        typedef boost::mpl::vector<
-            boost::crc_optimal<5, 0x09>,
-            boost::crc_optimal<6, 0x03>,
-            boost::crc_optimal<7, 0x09> > AllowedCrcs;
-
-        typedef typename boost::mpl::front<AllowedCrcs>::type FrontCrc;
-        typedef typename boost::mpl::back<AllowedCrcs>::type BackCrc;
-
-        typedef typename boost::mpl::at_c<AllowedCrcs, (MinMax<FrontCrc::bit_count, BackCrc::bit_count, requiredWidth>::value - FrontCrc::bit_count)  >::type Selection;
-
-        static unsigned getStringCrc(const char *string, const std::size_t stringLength)
-        {
-            Selection crc;
-            crc.process_bytes(string, stringLength);
-            return crc.checksum();
-        }
-    };
-
-    const unsigned crcWidth_;
+    // assume bcl and name of a read stored in the bucket takes up to twice the space of its compressed bam record
+    static const std::size_t BUCKET_BYTES_PER_BAM_BYTE = 2;
+    // memory for all buckets paired at the same time when no budget is given
+    static const std::size_t BUCKET_BYTES_DEFAULT = 1024UL * 1024UL * 1024UL * 3UL;
+    static const std::size_t BUCKET_BYTES_MIN = 1024UL * 1024UL * 64UL;
+    // all buckets are kept open while bam is being read.
+    static const unsigned BUCKET_BITS_MAX = 8;
+
+    common::ThreadVector &threads_;
+    const unsigned pairingThreads_;
+    const std::size_t bucketBytesMax_;
+    const unsigned bucketBits_;
     const std::size_t maxReadNameLength_;
+    const std::size_t minClusterLength_;
     const bool cleanupIntermediary_;
     const boost::filesystem::path &tempDirectoryPath_;
+    const std::size_t maxTempFilePathLength_;
     std::vector<common::PathStringType> tempFilePaths_;
     std::vector<std::size_t> tempFileSizes_;
-    std::vector<common::PathStringType>::const_iterator extractorFileIterator_;
+    // first bucket of the batch currently being extracted
+    std::size_t batchBegin_;
+    // extractor in the batch currently being extracted
+    std::size_t batchExtractor_;
     bool extracting_;
     std::vector<io::FileBufHolder<io::FileBufWithReopen> > tempFiles_;
     common::PathStringType tempFilePathBuffer_;
-    TempFileClusterExtractor extractor_;
-    // aim to have ~3 gigabyte temp files assuming none of the input reads pair
-    static const std::size_t UNPAIRED_BUFFER_SIZE = 1024UL * 1024UL * 1024UL * 3UL;
+    // bucket buffers are allocated only when there are unpaired reads to extract
+    boost::ptr_vector<TempFileClusterExtractor> extractors_;
+    common::MemoryReservation extractorsMemory_;
 public:
+    /**
+     * \param memoryBudget  bytes that all buckets loaded at the same time are allowed to occupy. 0 - BUCKET_BYTES_DEFAULT.
+     *                      Reserved against the process-wide budget once the buckets are about to be paired
+     * \param pairingThreadsMax  maximum number of buckets to load and pair in parallel
+     */
     UnpairedReadsCache(
         const boost::filesystem::path &tempDirectoryPath,
         const std::size_t maxBamFileSize,
         const std::size_t maxFlowcellIdLength,
         const std::size_t maxReadNameLength,
         const std::size_t minClusterLength,
-        const bool cleanupIntermediary) :
-            crcWidth_(log2(std::max<std::size_t>(1, maxBamFileSize / UNPAIRED_BUFFER_SIZE))),
+        const bool cleanupIntermediary,
+        const std::size_t memoryBudget,
+        common::ThreadVector &threads,
+        const unsigned pairingThreadsMax) :
+            threads_(threads),
+            pairingThreads_(std::max(1U, std::min<unsigned>(pairingThreadsMax, threads.size()))),
+            bucketBytesMax_(std::max(BUCKET_BYTES_MIN, (memoryBudget ? memoryBudget : BUCKET_BYTES_DEFAULT) / pairingThreads_)),
+            bucketBits_(getBucketBits(maxBamFileSize * BUCKET_BYTES_PER_BAM_BYTE, bucketBytesMax_)),
             maxReadNameLength_(maxReadNameLength),
+            minClusterLength_(minClusterLength),
             cleanupIntermediary_(cleanupIntermediary),
             tempDirectoryPath_(tempDirectoryPath),
-            tempFilePaths_(1 << getEffectiveCrcWidth<7>(crcWidth_)),
+            maxTempFilePathLength_(getMaxTempFilePathLength(maxFlowcellIdLength)),
+            tempFilePaths_(1 << bucketBits_),
             tempFileSizes_(tempFilePaths_.size(), 0),
-            extractorFileIterator_(tempFilePaths_.end()),
+            batchBegin_(tempFilePaths_.size()),
+            batchExtractor_(0),
             extracting_(false),
             tempFiles_(
-                1 << getEffectiveCrcWidth<7>(crcWidth_),
+                tempFilePaths_.size(),
                 io::FileBufHolder<io::FileBufWithReopen>(std::ios_base::out | std::ios_base::app | std::ios_base::binary,
-                                                         getMaxTempFilePathLength(maxFlowcellIdLength))),
-            extractor_(getMaxTempFilePathLength(maxFlowcellIdLength), UNPAIRED_BUFFER_SIZE, minClusterLength)
+                                                         maxTempFilePathLength_)),
+            extractorsMemory_(common::MemoryBudget::UnpairedReads)
     {
-        tempFilePathBuffer_.reserve(getMaxTempFilePathLength(maxFlowcellIdLength));
+        ISAAC_THREAD_CERR << "Unpaired reads: " << tempFilePaths_.size() << " buckets of up to " <<
+            bucketBytesMax_ / 1024 / 1024 << " megabytes, " << pairingThreads_ << " paired at a time" << std::endl;
+        tempFilePathBuffer_.reserve(maxTempFilePathLength_);
         BOOST_FOREACH(common::PathStringType &tempPath, tempFilePaths_)
         {
             tempPath.reserve(tempFilePathBuffer_.capacity());
@@ -374,6 +383,7 @@ public:
             tempFileSizes_[i] = 0;
             ++i;
         }
+        batchBegin_ = tempFilePaths_.size();
         extracting_ = false;
     }
 
@@ -382,9 +392,15 @@ public:
         ISAAC_THREAD_CERR << "startExtractingUnpaired " << std::endl;
         std::for_each(tempFiles_.begin(), tempFiles_.end(), boost::bind(&io::FileBufHolder<io::FileBufWithReopen>::flush, _1));
 
-        extractorFileIterator_ = tempFilePaths_.begin();
-        extractor_.open(
-            *extractorFileIterator_, tempFileSizes_[extractorFileIterator_ - tempFilePaths_.begin()]);
+        // each extractor preallocates bucketBytesMax_. Don't hold that memory while the bam is being read
+        const std::size_t extractorsMax = std::min<std::size_t>(pairingThreads_, tempFilePaths_.size());
+        extractorsMemory_.resize(extractorsMax * bucketBytesMax_);
+        while (extractorsMax != extractors_.size())
+        {
+            extractors_.push_back(new TempFileClusterExtractor(maxTempFilePathLength_, bucketBytesMax_, minClusterLength_));
+        }
+
+        openBatch(0);
         extracting_ = true;
     }
 
@@ -403,17 +419,15 @@ public:
         ClusterInsertIt &clusterIt,
         PfInsertIt &pfIt)
     {
-        while (tempFilePaths_.end() != extractorFileIterator_ && clusterCount)
+        while (tempFilePaths_.size() != batchBegin_ && clusterCount)
         {
-            clusterCount = extractor_.extractClusters(r1Length, r2Length, nameLengthMax, clusterCount, clusterIt, pfIt);
+            clusterCount = extractors_[batchExtractor_].extractClusters(
+                r1Length, r2Length, nameLengthMax, clusterCount, clusterIt, pfIt);
             if (clusterCount)
             {
-                ++extractorFileIterator_;
-                if (tempFilePaths_.end() != extractorFileIterator_)
+                if (getBatchSize() == ++batchExtractor_)
                 {
-                    extractor_.open(
-                        *extractorFileIterator_,
-                        tempFileSizes_[extractorFileIterator_ - tempFilePaths_.begin()]);
+                    openBatch(batchBegin_ + getBatchSize());
                 }
             }
         }
@@ -422,18 +436,57 @@ public:
 
 
 private:
-    const common::PathCharType* makeTempFilePath(const std::string &flowcellId, unsigned crc)
+    static unsigned getBucketBits(const std::size_t expectedBytes, const std::size_t bucketBytesMax)
+    {
+        unsigned ret = 0;
+        while (BUCKET_BITS_MAX > ret && (bucketBytesMax << ret) < expectedBytes)
+        {
+            ++ret;
+        }
+        return ret;
+    }
+
+    std::size_t getBatchSize() const
+    {
+        return std::min<std::size_t>(pairingThreads_, tempFilePaths_.size() - batchBegin_);
+    }
+
+    /**
+     * \brief Loads and sorts the buckets of the batch starting at batchBegin in parallel
+     */
+    void openBatch(const std::size_t batchBegin)
     {
-        return makeTempFilePath(flowcellId, crc, tempFilePathBuffer_).c_str();
+        batchBegin_ = batchBegin;
+        batchExtractor_ = 0;
+        if (tempFilePaths_.size() != batchBegin_)
+        {
+            threads_.execute(
+                [this](const unsigned threadNumber, const unsigned threadsTotal)
+                {
+                    const std::size_t bucket = batchBegin_ + threadNumber;
+                    if (bucketBytesMax_ < tempFileSizes_[bucket])
+                    {
+                        ISAAC_THREAD_CERR << "WARNING: unpaired reads bucket exceeds memory budget: " <<
+                            tempFileSizes_[bucket] << " > " << bucketBytesMax_ << " " << tempFilePaths_[bucket] << std::endl;
+                    }
+                    extractors_[threadNumber].open(tempFilePaths_[bucket], tempFileSizes_[bucket]);
+                },
+                getBatchSize());
+        }
     }
 
-    const common::PathStringType& makeTempFilePath(const std::string &flowcellId, unsigned crc, common::PathStringType& buffer)
+    const common::PathCharType* makeTempFilePath(const std::string &flowcellId, unsigned bucket)
+    {
+        return makeTempFilePath(flowcellId, bucket, tempFilePathBuffer_).c_str();
+    }
+
+    const common::PathStringType& makeTempFilePath(const std::string &flowcellId, unsigned bucket, common::PathStringType& buffer)
     {
         buffer = tempDirectoryPath_.c_str();
         buffer += common::getDirectorySeparatorChar();
         buffer += common::PathStringType(flowcellId.begin(), flowcellId.end());
         buffer += iSAAC_TSTRING("-unpaired-");
-        common::appendUnsignedInteger(buffer, crc);
+        common::appendUnsignedInteger(buffer, bucket);
         buffer += iSAAC_TSTRING(".tmp");
         return buffer;
     }
@@ -444,45 +497,14 @@ private:
         return makeTempFilePath(std::string(maxFlowcellIdLength, 'a'), 9999, buffer).size();
     }
 
-    template <unsigned N>
-    static unsigned getNameCrc(unsigned crcWidth, const char *name, const std::size_t nameLength)
+    unsigned getNameBucket(const char *name, const std::size_t nameLength) const
     {
-        ISAAC_ASSERT_MSG(crcWidth <= N, "Requested crcWidth is too big: " << crcWidth << " max: " << N);
-        if (N == crcWidth)
-        {
-            return CrcSelector<N>::getStringCrc(name, nameLength);
-        }
-
-        return getNameCrc<N-1>(crcWidth, name, nameLength);
+        boost::crc_32_type crc;
+        crc.process_bytes(name, nameLength);
+        return crc.checksum() & ((1U << bucketBits_) - 1);
     }
-
-    template <unsigned N>
-    static unsigned getEffectiveCrcWidth(unsigned requiredWidth)
-    {
-        ISAAC_ASSERT_MSG(requiredWidth <= N, "Requested crcWidth is too big: " << requiredWidth << " max: " << N);
-        if (N == requiredWidth)
-        {
-            return CrcSelector<N>::Selection::bit_count;
-        }
-
-        return getEffectiveCrcWidth<N-1>(requiredWidth);
-    }
-
 };
 
-template <>
-inline unsigned UnpairedReadsCache::getNameCrc<0>(unsigned crcWidth, const char *name, const std::size_t nameLength)
-{
-    return CrcSelector<0U>::getStringCrc(name, nameLength);
-}
-
-template <>
-inline unsigned UnpairedReadsCache::getEffectiveCrcWidth<0>(unsigned requiredWidth)
-{
-    return CrcSelector<0U>::Selection::bit_count;
-}
-
-
 class PairedEndClusterExtractor :
     std::vector<IndexRecord>
 {
@@ -499,7 +521,10 @@ public:
         const std::size_t maxReadNameLength,
         const std::size_t minClusterLength,
         const bool cleanupIntermediary,
-        const std::size_t expectedClustersPerClusterBlock) :
+        const std::size_t expectedClustersPerClusterBlock,
+        const std::size_t unpairedMemoryBudget,
+        common::ThreadVector &threads,
+        const unsigned pairingThreadsMax) :
             firstUnextracted_(end()),
             unpairedReadCache_(
                 tempDirectoryPath,
@@ -507,7 +532,10 @@ public:
                 maxFlowcellIdLength,
                 maxReadNameLength,
                 minClusterLength,
-                cleanupIntermediary)
+                cleanupIntermediary,
+                unpairedMemoryBudget,
+                threads,
+                pairingThreadsMax)
     {
         ISAAC_THREAD_CERR << "Reserving IndexRecord buffer for " << expectedClustersPerClusterBlock << " records" << std::endl;
         reserve(expectedClustersPerClusterBlock);
@@ -16,12 +16,14 @@
  **/
 
 #include <cerrno>
+#include <chrono>
 #include <fstream>
 #include <boost/foreach.hpp>
 #include <boost/function_output_iterator.hpp>
 
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
+#include "common/SystemCompatibility.hh"
 #include "alignment/BinMetadata.hh"
 #include "alignment/matchSelector/BinningFragmentStorage.hh"
 
@@ -34,6 +36,8 @@ namespace matchSelector
 
 const unsigned FragmentBinner::FRAGMENT_BINS_MAX;
 const unsigned FragmentBinner::UNMAPPED_BIN;
+const std::size_t FragmentBinner::WRITE_BEHIND_BYTES;
+const std::size_t FragmentBinner::BUFFER_FRAGMENTS_MAX;
 
 FragmentBinner::FragmentBinner(
     const bool keepUnaligned,
@@ -44,7 +48,11 @@ FragmentBinner::FragmentBinner(
         expectedBinSize_(expectedBinSize),
         binIndexMap_(binIndexMap),
         binZeroRecordsBinned_(0),
-        threadFileBuffers_(threads)
+        // leave the other half of descriptors to the rest of the process
+        writer_(std::max(1U, common::getMaxOpenFiles() / 2), io::PooledFileWriter::DEFAULT_BUFFER_BYTES, WRITE_BEHIND_BYTES),
+        fileCount_(0),
+        threadFileBuffers_(threads),
+        bufferMemory_(common::MemoryBudget::FragmentBinner)
 {
 }
 
@@ -150,30 +158,28 @@ void FragmentBinner::flushSingle(
     const io::FragmentAccessor &fragment,
     const BinIndexList &binIndexList,
     alignment::BinMetadataList &binMetadataList,
-    const unsigned fileIndex)
+    FilePieces &pieces)
 {
-    unsigned lastBinIndex = -1U;
     for (unsigned i = 0; binIndexList.indexCount_ != i; ++i)
     {
-        lastBinIndex = binIndexList.indexes_[i];
         registerFragment(
                 fragment,
                 // looks like some historical check for unaligned bin. Currently 
                 // results in massive undercounting of split alignments. Commented out: //0 != i &&
                 fragment.isAligned() && fragment.flags_.splitAlignment_,
-                binMetadataList[lastBinIndex]);
+                binMetadataList[binIndexList.indexes_[i]]);
     }
 
-    io::FileBufWithReopen &file = files_.at(fileIndex);
-
-#ifdef ISAAC_TEMP_STORE_DISABLED
-    return;
-#endif //ISAAC_TEMP_STORE_DISABLED
-
-    if (fragment.getTotalLength() != file.sputn(
-            reinterpret_cast<const char*>(&fragment), fragment.getTotalLength()))
+    const char *begin = reinterpret_cast<const char*>(&fragment);
+    // mates are next to each other in the buffer
+    if (!pieces.empty() && static_cast<const char*>(pieces.back().iov_base) + pieces.back().iov_len == begin)
+    {
+        pieces.back().iov_len += fragment.getTotalLength();
+    }
+    else
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to write into " + binMetadataList[lastBinIndex].getPathString()));
+        const iovec piece = {const_cast<char*>(begin), fragment.getTotalLength()};
+        pieces.push_back(piece);
     }
 }
 
@@ -184,6 +190,8 @@ void FragmentBinner::flushBuffer(
 {
 //    ISAAC_THREAD_CERR << "flushBuffer fileIndex: " << fileIndex << " for " << buffer.size() << std::endl;
     boost::unique_lock<boost::mutex> lock(binMutex_[fileIndex % binMutex_.size()]);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    FilePieces pieces;
     for (const char *p = &buffer.front(); &buffer.front() + buffer.size() != p;)
     {
         const io::FragmentAccessor &fragment0 = reinterpret_cast<const io::FragmentAccessor &>(*p);
@@ -194,18 +202,36 @@ void FragmentBinner::flushBuffer(
             ISAAC_ASSERT_MSG(fragment1.flags_.initialized_, "Attempt to store an uninitialised " << fragment1);
 
             const BinIndexList &binIndexList = *reinterpret_cast<const BinIndexList *>(fragment1.end());
-            flushSingle(fragment0, binIndexList, binMetadataList, fileIndex);
-            flushSingle(fragment1, binIndexList, binMetadataList, fileIndex);
+            flushSingle(fragment0, binIndexList, binMetadataList, pieces);
+            flushSingle(fragment1, binIndexList, binMetadataList, pieces);
             p = reinterpret_cast<const char*>(&binIndexList.indexes_[binIndexList.indexCount_]);
         }
         else
         {
             const BinIndexList &binIndexList = *reinterpret_cast<const BinIndexList *>(fragment0.end());
-            flushSingle(fragment0, binIndexList, binMetadataList, fileIndex);
+            flushSingle(fragment0, binIndexList, binMetadataList, pieces);
             p = reinterpret_cast<const char*>(&binIndexList.indexes_[binIndexList.indexCount_]);
         }
     }
+
+#ifndef ISAAC_TEMP_STORE_DISABLED
+    writer_.write(fileIndex, &pieces.front(), pieces.size());
+#endif //ISAAC_TEMP_STORE_DISABLED
     buffer.clear();
+
+    FileWriteStats &stats = fileStats_[fileIndex];
+    for (const iovec &piece : pieces)
+    {
+        stats.bytes_ += piece.iov_len;
+    }
+    stats.microseconds_ += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    lock.unlock();
+
+#ifndef ISAAC_TEMP_STORE_DISABLED
+    // waiting for the disk must not block the other threads flushing into the same file
+    writer_.writeBehind(fileIndex);
+#endif //ISAAC_TEMP_STORE_DISABLED
 //    ISAAC_THREAD_CERR << "flushBuffer fileIndex: " << fileIndex << " for " << buffer.size() << " done" << std::endl;
 }
 
@@ -330,20 +356,8 @@ void FragmentBinner::getFragmentStorageBins(const io::FragmentAccessor &fragment
 void FragmentBinner::openBinFile(const BinMetadata &binMetadata, std::size_t file)
 {
     ISAAC_THREAD_CERR << "openBin file: " << file << " for " << binMetadata << std::endl;
-    // make sure file is empty first time we decide to put data in it.
-    // boost::filesystem::remove for some stupid reason needs to allocate strings for this...
-    if (common::deleteFile(binMetadata.getPath().c_str()) && ENOENT != errno)
-    {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to unlink " + binMetadata.getPath().string()));
-    }
-    files_[file].reopen(binMetadata.getPath().c_str(),
-                        expectedBinSize_,
-                        io::FileBufWithReopen::SequentialOnce);
-
-    if (!files_[file].is_open())
-    {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open bin file " + binMetadata.getPathString()));
-    }
+    writer_.create(file, binMetadata.getPath(), expectedBinSize_);
+    fileStats_[file].firstBin_ = binMetadata.getIndex();
 }
 
 static std::size_t uniquePathCount(
@@ -364,7 +378,9 @@ void FragmentBinner::open(
     const BinMetadataList::iterator binsBegin,
     const BinMetadataList::iterator binsEnd)
 {
-    std::vector<io::FileBufWithReopen>(uniquePathCount(binsBegin, binsEnd), io::FileBufWithReopen(std::ios_base::out | std::ios_base::app | std::ios_base::binary)).swap(files_);
+    fileCount_ = uniquePathCount(binsBegin, binsEnd);
+    writer_.reset(fileCount_);
+    std::vector<FileWriteStats>(fileCount_).swap(fileStats_);
     binFiles_.resize(std::max_element(binsBegin, binsEnd, [](const BinMetadata& left, const BinMetadata& right){return left.getIndex() < right.getIndex();})->getIndex() + 1);
     
     ISAAC_TRACE_STAT("TemplateBuilder before Reopening output files");
@@ -394,11 +410,13 @@ void FragmentBinner::open(
         last = current;
     }
 
+    bufferMemory_.resize(uint64_t(threadFileBuffers_.size()) * fileCount_ * sizeof(FileBuffer) +
+                         uint64_t(fileCount_) * writer_.getBufferBytes());
     for (FileBuffers &fileBuffers : threadFileBuffers_)
     {
         fileBuffers.clear();
-        ISAAC_THREAD_CERR << "allocating " << files_.size() * sizeof(FileBuffer) << " bytes" << std::endl;
-        fileBuffers.resize(files_.size());
+        ISAAC_THREAD_CERR << "allocating " << fileCount_ * sizeof(FileBuffer) << " bytes" << std::endl;
+        fileBuffers.resize(fileCount_);
     }
 
     ISAAC_THREAD_CERR << "Reopening output files done for " << std::distance(binsBegin, binsEnd) << " bins, reopened " << file << " files" << std::endl;
@@ -407,7 +425,7 @@ void FragmentBinner::open(
 
 void FragmentBinner::flush(BinMetadataList &binMetadataList)
 {
-    ISAAC_THREAD_CERR << "flushing " << files_.size() << " output buffers for " << threadFileBuffers_.size() << " threads "<< std::endl;
+    ISAAC_THREAD_CERR << "flushing " << fileCount_ << " output buffers for " << threadFileBuffers_.size() << " threads "<< std::endl;
     for (FileBuffers &buffers : threadFileBuffers_)
     {
         unsigned fileIndex = 0;
@@ -420,19 +438,49 @@ void FragmentBinner::flush(BinMetadataList &binMetadataList)
             ++fileIndex;
         }
     }
-    ISAAC_THREAD_CERR << "flushing " << files_.size() << " output buffers done for " << threadFileBuffers_.size() << " threads "<< std::endl;
+    writer_.flush();
+    ISAAC_THREAD_CERR << "flushing " << fileCount_ << " output buffers done for " << threadFileBuffers_.size() << " threads "<< std::endl;
 }
 
 void FragmentBinner::close() noexcept
 {
-    ISAAC_THREAD_CERR << "truncating " << files_.size() << " output files for " << std::endl;
-
-    // make sure everything is written out for those that are open
-    std::for_each(files_.begin(), files_.end(), boost::bind(&io::FileBufWithReopen::close, _1));
+    ISAAC_THREAD_CERR << "truncating " << fileCount_ << " output files for " << std::endl;
+
+    writer_.close();
+    const io::PooledFileWriter::Counters counters = writer_.getCounters();
+    ISAAC_THREAD_CERR << "Bin files: " << counters.opens_ << " opens, " << counters.writeCalls_ << " writes, " <<
+        counters.bytes_ << " bytes, " << counters.spills_ << " moved out of memory for " << fileCount_ << " files" << std::endl;
+    writer_.resetCounters();
+
+    // one line per pass. There can be thousands of bins
+    std::size_t filesWritten = 0;
+    FileWriteStats total;
+    FileWriteStats slowest;
+    for (FileWriteStats &stats : fileStats_)
+    {
+        if (stats.bytes_)
+        {
+            ++filesWritten;
+            total.bytes_ += stats.bytes_;
+            total.microseconds_ += stats.microseconds_;
+            if (slowest.microseconds_ < stats.microseconds_)
+            {
+                slowest = stats;
+            }
+        }
+        stats = FileWriteStats();
+    }
+    if (filesWritten)
+    {
+        ISAAC_THREAD_CERR << "Wrote " << total.bytes_ << " bytes into " << filesWritten << " bin files in " <<
+            total.microseconds_ / 1000 << "ms (" <<
+            (total.microseconds_ ? total.bytes_ / total.microseconds_ : 0) << "MB/s), slowest: " <<
+            slowest.bytes_ << " bytes for bin " << slowest.firstBin_ << " in " << slowest.microseconds_ / 1000 << "ms" << std::endl;
+    }
 
     std::fill(binFiles_.begin(), binFiles_.end(), UNMAPPED_BIN);
 
-    ISAAC_THREAD_CERR << "truncating done for " << files_.size() << " output files" << std::endl;
+    ISAAC_THREAD_CERR << "truncating done for " << fileCount_ << " output files" << std::endl;
 }
 
 } //namespace matchSelector
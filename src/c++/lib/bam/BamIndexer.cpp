@@ -17,8 +17,10 @@
  ** \author Lilian Janin
  **/
 
-#include "bam/BamIndexer.hh"
 #include "alignment/Cigar.hh"
+#include "bam/Bam.hh"
+#include "bam/BamIndexer.hh"
+#include "bgzf/BgzfCompressor.hh"
 
 
 namespace isaac
@@ -27,51 +29,42 @@ namespace bam
 {
 
 
-BamIndexPart::BamIndexPart()
-    : localUncompressedOffset_( 0 )
-    , bamStatsMapped_( 0 )
-    , bamStatsNmapped_( 0 )
+unsigned BinningScheme::getDepth(const unsigned minShift, const uint64_t maxContigLength)
 {
-    initStructures();
+    unsigned depth = 0;
+    // same as samtools: leave some room for reads hanging off the end of the contig
+    for (uint64_t levelSpan = 1UL << minShift; maxContigLength + 256 > levelSpan; levelSpan <<= 3)
+    {
+        ++depth;
+    }
+    return depth;
 }
 
-void BamIndexPart::initStructures()
+BinningIndexPart::BinningIndexPart(const BinningScheme &scheme, const uint64_t maxContigLength)
+    : scheme_(scheme)
 {
     chunks_.reserve( BAM_INDEXER_MAX_CHUNKS );
-    linearIndex_.reserve( BAM_MAX_CONTIG_LENGTH / 16384 );
+    linearIndex_.reserve( (std::min(maxContigLength, scheme_.getMaxContigLength()) >> scheme_.getMinShift()) + 1 );
 }
 
-void BamIndexPart::processFragment( const build::FragmentAccessorBamAdapter& alignment, uint32_t serializedLength )
+void BinningIndexPart::addAlignment(
+    const uint32_t refId, const uint64_t pos, const uint32_t seqLen, const uint32_t observedLength,
+    const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset)
 {
-    if (alignment.pos() >= 0)
-    {
-        uint32_t observedLength = alignment.observedLength();
-        const uint32_t bin(bam_reg2bin(alignment.pos(), alignment.pos() + alignment.seqLen())); // it would be more correct to use observedLength instead of alignment.seqLen(), but samtools is doing it this way.
-
-        addToBinIndexChunks( localUncompressedOffset_, localUncompressedOffset_ + serializedLength, bin, alignment.refId() );
-        addToLinearIndex( alignment.pos(), localUncompressedOffset_ );
-        if (observedLength > 0)
-        {
-            addToLinearIndex( alignment.pos() + observedLength - 1, localUncompressedOffset_ );
-        }
-    }
+    // it would be more correct to use observedLength instead of seqLen, but samtools is doing it this way.
+    const uint32_t bin(scheme_.reg2bin(pos, pos + seqLen));
 
-    // Update bamStats for samtools' special bin
-    if (alignment.unmapped())
+    addToBinIndexChunks( virtualOffset, virtualEndOffset, bin, refId );
+    addToLinearIndex( pos, virtualOffset );
+    if (observedLength > 0)
     {
-        ++bamStatsNmapped_;
-    }
-    else
-    {
-        ++bamStatsMapped_;
+        addToLinearIndex( pos + observedLength - 1, virtualOffset );
     }
-
-    localUncompressedOffset_ += serializedLength;
 }
 
-void BamIndexPart::addToBinIndexChunks( const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset, const uint32_t bin, const uint32_t refId )
+void BinningIndexPart::addToBinIndexChunks( const UnresolvedOffset virtualOffset, const UnresolvedOffset virtualEndOffset, const uint32_t bin, const uint32_t refId )
 {
-    ISAAC_ASSERT_MSG( bin < BAM_MAX_BIN, "Invalid bin number in uncompressed BAM" );
+    ISAAC_ASSERT_MSG( bin < scheme_.getPseudoBin(), "Invalid bin number in uncompressed BAM" );
 
     if (!chunks_.empty() &&
         bin == chunks_.back().bin &&
@@ -93,13 +86,13 @@ void BamIndexPart::addToBinIndexChunks( const UnresolvedOffset virtualOffset, co
     }
 }
 
-void BamIndexPart::addToLinearIndex( const uint32_t pos, const UnresolvedOffset virtualOffset )
+void BinningIndexPart::addToLinearIndex( const uint64_t pos, const UnresolvedOffset virtualOffset )
 {
-    if (pos >= BAM_MAX_CONTIG_LENGTH)
+    if (pos >= scheme_.getMaxContigLength())
     {
-        ISAAC_ASSERT_MSG( pos < BAM_MAX_CONTIG_LENGTH, "Alignment position greater than the maximum allowed by BAM index: " << pos);
+        ISAAC_ASSERT_MSG( pos < scheme_.getMaxContigLength(), "Alignment position greater than the maximum allowed by BAM index: " << pos);
     }
-    const uint32_t linearBin = pos>>14;
+    const uint64_t linearBin = pos >> scheme_.getMinShift();
     if ( linearIndex_.size() <= linearBin )
     {
         const UnresolvedOffset lastValue = linearIndex_.empty()?0xFFFFFFFFFFFFFFFF:linearIndex_.back();
@@ -111,13 +104,73 @@ void BamIndexPart::addToLinearIndex( const uint32_t pos, const UnresolvedOffset
     }
 }
 
+BamIndexPart::BamIndexPart(const BamIndex &bamIndex)
+    : localUncompressedOffset_( 0 )
+    , bamStatsMapped_( 0 )
+    , bamStatsNmapped_( 0 )
+{
+    binnings_.reserve(bamIndex.getSchemes().size());
+    BOOST_FOREACH(const BinningScheme &scheme, bamIndex.getSchemes())
+    {
+        binnings_.push_back(BinningIndexPart(scheme, bamIndex.getMaxContigLength()));
+    }
+}
+
+void BamIndexPart::processFragment( const build::FragmentAccessorBamAdapter& alignment, uint32_t serializedLength )
+{
+    if (alignment.pos() >= 0)
+    {
+        const uint32_t observedLength = alignment.observedLength();
+        BOOST_FOREACH(BinningIndexPart &binning, binnings_)
+        {
+            binning.addAlignment(alignment.refId(), alignment.pos(), alignment.seqLen(), observedLength,
+                                 localUncompressedOffset_, localUncompressedOffset_ + serializedLength);
+        }
+    }
+
+    // Update bamStats for samtools' special bin
+    if (alignment.unmapped())
+    {
+        ++bamStatsNmapped_;
+    }
+    else
+    {
+        ++bamStatsMapped_;
+    }
+
+    localUncompressedOffset_ += serializedLength;
+}
+
+
+BamIndex::Binning::Binning(const BinningScheme &scheme, const bool csi, const boost::filesystem::path &path)
+    : scheme_(scheme)
+    , csi_(csi)
+    , path_(path)
+    , file_(path.c_str(), std::ios_base::binary)
+{
+    if (!file_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error opening bam index file for writing: " + path.string()));
+    }
+    if (csi_)
+    {
+        stream_.push(bgzf::BgzfCompressor(bios::gzip::default_compression), 65535, 0);
+    }
+    stream_.push(file_);
+}
+
+void BamIndex::Binning::write(const void *data, const std::size_t bytes)
+{
+    if (!stream_.write(reinterpret_cast<const char*>(data), bytes))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam index file " + path_.string()));
+    }
+}
 
 BamIndex::BamIndex()
     : bamRefCount_( 0 )
     , lastProcessedRefId_( 0xFFFFFFFF )
-    , baiStream_()
-    , binIndex_( BAM_MAX_BIN )
-    , binIndexEmpty_(true)
+    , maxContigLength_( 0 )
     , bamStatsMapped_( 0 )
     , bamStatsNmapped_( 0 )
     , bamStatsGlobalNoCoordinates_( 0 )
@@ -130,12 +183,12 @@ BamIndex::BamIndex()
 }
 
 
-BamIndex::BamIndex(const boost::filesystem::path &bamPath, const uint32_t bamRefCount, const uint32_t bamHeaderCompressedLength)
+BamIndex::BamIndex(
+    const boost::filesystem::path &bamPath, const uint32_t bamRefCount, const uint32_t bamHeaderCompressedLength,
+    const unsigned format, const unsigned csiMinShift, const uint64_t maxContigLength)
     : bamRefCount_( bamRefCount )
     , lastProcessedRefId_( 0xFFFFFFFF )
-    , baiStream_( (bamPath.string() + ".bai").c_str() )
-    , binIndex_( BAM_MAX_BIN )
-    , binIndexEmpty_(true)
+    , maxContigLength_( maxContigLength )
     , bamStatsMapped_( 0 )
     , bamStatsNmapped_( 0 )
     , bamStatsGlobalNoCoordinates_( 0 )
@@ -145,27 +198,38 @@ BamIndex::BamIndex(const boost::filesystem::path &bamPath, const uint32_t bamRef
     , currentBgzfBlockCompressedSize_( 0 )
     , currentBgzfBlockUncompressedSize_( 0 )
 {
-    if( !baiStream_)
+    if (format & BAM_INDEX_BAI)
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error opening bam index file for writing"));
+        if (BAM_MAX_CONTIG_LENGTH < maxContigLength_)
+        {
+            ISAAC_THREAD_CERR << "WARNING: Not producing bai for " << bamPath << " as it cannot index contigs longer than " <<
+                BAM_MAX_CONTIG_LENGTH << " bases. Longest contig: " << maxContigLength_ << std::endl;
+        }
+        else
+        {
+            schemes_.push_back(BinningScheme());
+            binnings_.push_back(new Binning(schemes_.back(), false, bamPath.string() + ".bai"));
+        }
+    }
+    if (format & BAM_INDEX_CSI)
+    {
+        schemes_.push_back(BinningScheme(csiMinShift, BinningScheme::getDepth(csiMinShift, maxContigLength_)));
+        binnings_.push_back(new Binning(schemes_.back(), true, bamPath.string() + ".csi"));
     }
-    initStructures();
-    outputBaiHeader();
-}
 
-void BamIndex::initStructures()
-{
-    ISAAC_ASSERT_MSG( binIndex_.size() == BAM_MAX_BIN, "Unexpected number of bins in Bam index" );
-    for (uint32_t i=0; i<BAM_MAX_BIN; ++i)
+    BOOST_FOREACH(Binning &binning, binnings_)
     {
-        binIndex_[i].reserve( MAX_CLUSTER_PER_INDEX_BIN );
+        outputHeader(binning);
     }
-    binIndexEmpty_ = true;
-    linearIndex_.reserve( BAM_MAX_CONTIG_LENGTH / 16384 );
 }
 
 void BamIndex::outputIndexFile()
 {
+    if (binnings_.empty())
+    {
+        return;
+    }
+
     if (lastProcessedRefId_ == 0xFFFFFFFF)
     {
         lastProcessedRefId_ = 0;
@@ -175,111 +239,146 @@ void BamIndex::outputIndexFile()
     {
         ISAAC_ASSERT_MSG (lastProcessedRefId_ < bamRefCount_,
                           "Bam indexer processed more chromosomes than was declared in Bam header" );
-        outputBaiChromosomeIndex();
+        outputChromosomeIndex();
         lastProcessedRefId_++;
     }
-    outputBaiFooter();
+    BOOST_FOREACH(Binning &binning, binnings_)
+    {
+        outputFooter(binning);
+    }
+}
+
+void BamIndex::outputHeader(Binning &binning)
+{
+    if (binning.csi_)
+    {
+        const int32_t minShift = binning.scheme_.getMinShift();
+        const int32_t depth = binning.scheme_.getDepth();
+        const int32_t lAux = 0;
+        binning.write("CSI\1", 4);
+        binning.write(&minShift, 4);
+        binning.write(&depth, 4);
+        binning.write(&lAux, 4);
+    }
+    else
+    {
+        binning.write("BAI\1", 4);
+    }
+    binning.write(&bamRefCount_, 4);
 }
 
-void BamIndex::outputBaiHeader()
+void BamIndex::outputChromosomeIndex()
 {
-    if (!baiStream_.write("BAI\1", 4) ||
-        !baiStream_.write(reinterpret_cast<const char*>(&bamRefCount_), 4))
+    BOOST_FOREACH(Binning &binning, binnings_)
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam index header"));
+        outputChromosomeIndex(binning);
     }
+    // reset variables to make them ready to process the next chromosome
+    clearStructures();
 }
 
-void BamIndex::outputBaiChromosomeIndex()
+void BamIndex::outputChromosomeIndex(Binning &binning)
 {
-#pragma pack(push, 1)
-    struct {
-        uint32_t binNum;
-        uint32_t nClusters;
-        uint64_t offBeg, offEnd;
-        uint64_t mapped, nmapped;
-    } specialBin = { BAM_MAX_BIN, 2, 0, 0, bamStatsMapped_, bamStatsNmapped_ };
-#pragma pack(pop)
-
-    uint32_t nBin = binIndexEmpty_ ? 0 : std::count_if( binIndex_.begin(),
-                                                        binIndex_.end(),
-                                                        boost::bind(&std::vector< VirtualOffsetPair >::empty, _1) == false );
+    uint64_t offBeg = 0;
+    uint64_t offEnd = 0;
+
+    uint32_t nBin = binning.binIndex_.size();
 
     if (nBin > 0 || bamStatsMapped_ > 0 || bamStatsNmapped_ > 0)
     {
         ++nBin; // Add samtools' special bin to the count
-        if (!baiStream_.write(reinterpret_cast<const char*>(&nBin), 4))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam chromosome index"));
-        }
+        binning.write(&nBin, 4);
 
-        unsigned int i=0;
-        BOOST_FOREACH( const std::vector< VirtualOffsetPair >& binIndexEntry, binIndex_ )
+        typedef std::map<uint32_t, std::vector< VirtualOffsetPair > >::value_type BinIndexEntry;
+        BOOST_FOREACH( const BinIndexEntry &binIndexEntry, binning.binIndex_ )
         {
-            if ( !binIndexEntry.empty() )
+            const uint32_t nChunk = binIndexEntry.second.size();
+            binning.write(&binIndexEntry.first, 4);
+            if (binning.csi_)
             {
-                const uint32_t nChunk = binIndexEntry.size();
-                if (!baiStream_.write(reinterpret_cast<const char*>(&i), 4) ||
-                    !baiStream_.write(reinterpret_cast<const char*>(&nChunk), 4) ||
-                    !baiStream_.write(reinterpret_cast<const char*>(&binIndexEntry[0]), nChunk*16))
-                {
-                    BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam chromosome index"));
-                }
-
-                // Fill in samtools' "specialBin" bamStats
-                if (specialBin.offBeg > binIndexEntry[0].first.get() || specialBin.offBeg == 0)
-                {
-                    specialBin.offBeg = binIndexEntry[0].first.get();
-                }
-                if (specialBin.offEnd < binIndexEntry[nChunk-1].second.get() || specialBin.offEnd == 0)
-                {
-                    specialBin.offEnd = binIndexEntry[nChunk-1].second.get();
-                }
+                // smallest offset of the reads overlapping the first window of the bin
+                const uint64_t window = binning.scheme_.getBinFirstWindow(binIndexEntry.first);
+                const uint64_t loffset = window < binning.linearIndex_.size() ? binning.linearIndex_[window].get() : 0;
+                binning.write(&loffset, 8);
+            }
+            binning.write(&nChunk, 4);
+            binning.write(&binIndexEntry.second.front(), nChunk * 16);
+
+            // Fill in samtools' "specialBin" bamStats
+            if (offBeg > binIndexEntry.second.front().first.get() || offBeg == 0)
+            {
+                offBeg = binIndexEntry.second.front().first.get();
+            }
+            if (offEnd < binIndexEntry.second.back().second.get() || offEnd == 0)
+            {
+                offEnd = binIndexEntry.second.back().second.get();
             }
-            ++i;
         }
 
         // Write special samtools bin
-        baiStream_.write(reinterpret_cast<const char*>(&specialBin), sizeof(specialBin));
+        const uint32_t specialBin = binning.scheme_.getPseudoBin();
+        const uint32_t nClusters = 2;
+        const uint64_t loffset = 0;
+        binning.write(&specialBin, 4);
+        if (binning.csi_)
+        {
+            binning.write(&loffset, 8);
+        }
+        binning.write(&nClusters, 4);
+        binning.write(&offBeg, 8);
+        binning.write(&offEnd, 8);
+        binning.write(&bamStatsMapped_, 8);
+        binning.write(&bamStatsNmapped_, 8);
     }
     else
     {
-        baiStream_.write(reinterpret_cast<const char*>(&nBin), 4); // nBin==0
+        binning.write(&nBin, 4); // nBin==0
     }
 
-    // Write linear index
-    const uint32_t nIntv = linearIndex_.size();
-
-    if (!baiStream_.write(reinterpret_cast<const char*>(&nIntv), 4) ||
-        (!linearIndex_.empty() && !baiStream_.write(reinterpret_cast<const char*>(&linearIndex_.front()), nIntv*8)))
+    if (!binning.csi_)
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam linear index"));
+        // Write linear index
+        const uint32_t nIntv = binning.linearIndex_.size();
+        binning.write(&nIntv, 4);
+        if (!binning.linearIndex_.empty())
+        {
+            binning.write(&binning.linearIndex_.front(), nIntv * 8);
+        }
     }
-    // reset variables to make them ready to process the next chromosome
-    clearStructures();
 }
 
-void BamIndex::outputBaiFooter()
+void BamIndex::outputFooter(Binning &binning)
 {
     // output number of coor-less reads (special samtools field)
-    if (!baiStream_.write(reinterpret_cast<const char*>(&bamStatsGlobalNoCoordinates_), 8))
+    binning.write(&bamStatsGlobalNoCoordinates_, 8);
+    if (!binning.stream_.strict_sync())
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error flushing bam index file " + binning.path_.string()));
+    }
+    if (binning.csi_)
     {
-        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam index footer"));
+        serializeBgzfFooter(binning.file_);
+    }
+    binning.file_.flush();
+    if (!binning.file_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing bam index footer " + binning.path_.string()));
     }
 }
 
 void BamIndex::processIndexPart(const bam::BamIndexPart &bamIndexPart,
                                 const BgzfBuffer &bgzfBuffer)
 {
-    if (bgzfBuffer.empty())
+    if (bgzfBuffer.empty() || binnings_.empty())
     {
         return;
     }
 
-    if (!bamIndexPart.chunks_.empty())
+    ISAAC_ASSERT_MSG(bamIndexPart.binnings_.size() == binnings_.size(), "Bam index part does not match the bam index");
+    if (!bamIndexPart.binnings_.front().chunks_.empty())
     {
         // Block of mapped reads
-        uint32_t refId = bamIndexPart.chunks_[0].refId;
+        uint32_t refId = bamIndexPart.binnings_.front().chunks_[0].refId;
         while (lastProcessedRefId_ != refId)
         {
             if (lastProcessedRefId_ == 0xFFFFFFFF)
@@ -291,14 +390,17 @@ void BamIndex::processIndexPart(const bam::BamIndexPart &bamIndexPart,
             {
                 ISAAC_ASSERT_MSG (lastProcessedRefId_ < refId,
                                   "Bam indexer tries to process more chromosomes than was declared in Bam header" );
-                outputBaiChromosomeIndex();
+                outputChromosomeIndex();
                 lastProcessedRefId_++;
             }
         }
 
-        resetBgzfParsing();
-        mergeBinIndex( bamIndexPart.chunks_, bgzfBuffer );
-        mergeLinearIndex( bamIndexPart.linearIndex_, bgzfBuffer );
+        for (std::size_t i = 0; binnings_.size() > i; ++i)
+        {
+            resetBgzfParsing();
+            mergeBinIndex( binnings_.at(i), bamIndexPart.binnings_.at(i).chunks_, bgzfBuffer );
+            mergeLinearIndex( binnings_.at(i), bamIndexPart.binnings_.at(i).linearIndex_, bgzfBuffer );
+        }
 
         bamStatsMapped_ += bamIndexPart.bamStatsMapped_;
         bamStatsNmapped_ += bamIndexPart.bamStatsNmapped_;
@@ -360,66 +462,61 @@ void BamIndex::processIndexPart(const bam::BamIndexPart &bamIndexPart,
 //    }
 //}
 
-void BamIndex::mergeBinIndex( const std::vector<UnresolvedBinIndexChunk>& binIndexChunks, const BgzfBuffer &bgzfBuffer )
+void BamIndex::mergeBinIndex( Binning &binning, const std::vector<UnresolvedBinIndexChunk>& binIndexChunks, const BgzfBuffer &bgzfBuffer )
 {
     BOOST_FOREACH( const UnresolvedBinIndexChunk& chunk, binIndexChunks )
     {
-        addToBinIndex( chunk, bgzfBuffer );
+        addToBinIndex( binning, chunk, bgzfBuffer );
     }
 }
 
-void BamIndex::mergeLinearIndex( const std::vector<UnresolvedOffset>& linearIndexToMerge, const BgzfBuffer &bgzfBuffer )
+void BamIndex::mergeLinearIndex( Binning &binning, const std::vector<UnresolvedOffset>& linearIndexToMerge, const BgzfBuffer &bgzfBuffer )
 {
-    if (linearIndex_.size() < linearIndexToMerge.size())
+    std::vector< VirtualOffset > &linearIndex = binning.linearIndex_;
+    if (linearIndex.size() < linearIndexToMerge.size())
     {
-        linearIndex_.resize( linearIndexToMerge.size() );
+        linearIndex.resize( linearIndexToMerge.size() );
     }
     for (unsigned i = 0; i < linearIndexToMerge.size(); ++i)
     {
         if (linearIndexToMerge[i] != 0xFFFFFFFFFFFFFFFF)
         {
             VirtualOffset off = resolveOffset( linearIndexToMerge[i], bgzfBuffer );
-            if (off.get() < linearIndex_[i].get() || linearIndex_[i].get() == 0)
+            if (off.get() < linearIndex[i].get() || linearIndex[i].get() == 0)
             {
-                linearIndex_[i] = off;
+                linearIndex[i] = off;
             }
         }
     }
 }
 
-void BamIndex::addToBinIndex( const UnresolvedBinIndexChunk& chunk, const BgzfBuffer &bgzfBuffer )
+void BamIndex::addToBinIndex( Binning &binning, const UnresolvedBinIndexChunk& chunk, const BgzfBuffer &bgzfBuffer )
 {
-    ISAAC_ASSERT_MSG( binIndex_.size() == BAM_MAX_BIN, "Unexpected number of bins in Bam index" );
-    ISAAC_ASSERT_MSG( chunk.bin < BAM_MAX_BIN, "Invalid bin number in uncompressed BAM" );
+    ISAAC_ASSERT_MSG( chunk.bin < binning.scheme_.getPseudoBin(), "Invalid bin number in uncompressed BAM" );
 
     VirtualOffset start = resolveOffset(chunk.startPos, bgzfBuffer);
     VirtualOffset end   = resolveOffset(chunk.endPos, bgzfBuffer);
 
-    if (!binIndex_[chunk.bin].empty() && binIndex_[chunk.bin].back().second.compressedOffset() == start.compressedOffset())
+    std::vector< VirtualOffsetPair > &binIndexEntry = binning.binIndex_[chunk.bin];
+    if (!binIndexEntry.empty() && binIndexEntry.back().second.compressedOffset() == start.compressedOffset())
     {
         // Small chunks reduction
-        binIndex_[chunk.bin].back().second = end;
+        binIndexEntry.back().second = end;
     }
     else
     {
-        binIndex_[chunk.bin].push_back(std::make_pair(start, end));
+        binIndexEntry.push_back(std::make_pair(start, end));
     }
-    binIndexEmpty_ = false;
 }
 
 void BamIndex::clearStructures()
 {
     bamStatsMapped_ = bamStatsNmapped_ = 0;
-    ISAAC_ASSERT_MSG( binIndex_.size() == BAM_MAX_BIN, "Unexpected number of bins in Bam index" );
-    if (!binIndexEmpty_)
+    BOOST_FOREACH(Binning &binning, binnings_)
     {
-        BOOST_FOREACH( std::vector< VirtualOffsetPair >& binIndexEntry, binIndex_)
-        {
-            binIndexEntry.clear();
-        }
+        binning.binIndex_.clear();
+        binning.linearIndex_.clear();
     }
-    binIndexEmpty_ = true;
-    linearIndex_.clear();
 
     resetBgzfParsing();
 }
@@ -28,8 +28,8 @@ namespace bam
 {
 
 bool BamParser::skipHeader(
-    std::vector<char>::const_iterator &it,
-    std::vector<char>::const_iterator end)
+    const char *&it,
+    const char *end)
 {
     if (-1U == headerBytesToSkip_)
     {
@@ -61,8 +61,8 @@ bool BamParser::skipHeader(
 }
 
 bool BamParser::skipReferences(
-    std::vector<char>::const_iterator &it,
-    std::vector<char>::const_iterator end)
+    const char *&it,
+    const char *end)
 {
     if (end == it)
     {
@@ -91,7 +91,7 @@ bool BamParser::skipReferences(
             return true;
         }
 
-        const std::vector<char>::const_iterator itRef = it;
+        const char *itRef = it;
         it = common::extractLittleEndian(it, l_name);
         if (std::size_t(std::distance(it, end)) < l_name + sizeof(int))
         {
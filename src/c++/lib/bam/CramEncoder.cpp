@@ -0,0 +1,682 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramEncoder.cpp
+ **
+ ** \brief Filtering stream that turns uncompressed bam data into CRAM 3.0 containers.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <map>
+
+#include <boost/foreach.hpp>
+
+#include "bam/Bam.hh"
+#include "bam/CramEncoder.hh"
+#include "common/Debug.hh"
+#include "common/Endianness.hh"
+#include "common/MD5Sum.hh"
+
+namespace isaac
+{
+namespace bam
+{
+
+namespace cram = io::cram;
+
+namespace
+{
+
+enum ContentId
+{
+    BF_ID = 1, CF_ID, RL_ID, AP_ID, RG_ID, RN_ID, MF_ID, NS_ID, NP_ID, TS_ID, TL_ID, FN_ID, FC_ID, FP_ID, DL_ID, BS_ID,
+    IN_ID, RS_ID, PD_ID, HC_ID, SC_ID, MQ_ID, BA_ID, QS_ID,
+    CONTENT_ID_END
+};
+
+struct DataSeriesEncoding
+{
+    const char *key_;
+    ContentId id_;
+    // BYTE_ARRAY_STOP with 0 stop byte instead of EXTERNAL
+    bool byteArray_;
+};
+
+static const DataSeriesEncoding DATA_SERIES[] =
+{
+    {"BF", BF_ID, false}, {"CF", CF_ID, false}, {"RL", RL_ID, false}, {"AP", AP_ID, false}, {"RG", RG_ID, false},
+    {"RN", RN_ID, true}, {"MF", MF_ID, false}, {"NS", NS_ID, false}, {"NP", NP_ID, false}, {"TS", TS_ID, false},
+    {"TL", TL_ID, false}, {"FN", FN_ID, false}, {"FC", FC_ID, false}, {"FP", FP_ID, false}, {"DL", DL_ID, false},
+    {"BS", BS_ID, false}, {"IN", IN_ID, true}, {"RS", RS_ID, false}, {"PD", PD_ID, false}, {"HC", HC_ID, false},
+    {"SC", SC_ID, true}, {"MQ", MQ_ID, false}, {"BA", BA_ID, false}, {"QS", QS_ID, false},
+};
+
+static const unsigned BAM_FUNMAP = 0x4;
+static const unsigned BAM_FMUNMAP = 0x8;
+static const unsigned BAM_FMREVERSE = 0x20;
+
+/**
+ * \brief Fields of a serialized bam record
+ */
+struct BamRecord
+{
+    explicit BamRecord(const char *p) :
+        size_(sizeof(int32_t) + common::extractLittleEndian<int32_t>(p)),
+        refId_(common::extractLittleEndian<int32_t>(p + 4)),
+        pos_(common::extractLittleEndian<int32_t>(p + 8)),
+        binMqNl_(common::extractLittleEndian<uint32_t>(p + 12)),
+        flagNc_(common::extractLittleEndian<uint32_t>(p + 16)),
+        lSeq_(common::extractLittleEndian<int32_t>(p + 20)),
+        nextRefId_(common::extractLittleEndian<int32_t>(p + 24)),
+        nextPos_(common::extractLittleEndian<int32_t>(p + 28)),
+        tlen_(common::extractLittleEndian<int32_t>(p + 32)),
+        name_(p + 36),
+        cigar_(name_ + nameLength()),
+        seq_(reinterpret_cast<const unsigned char *>(cigar_ + cigarLength() * sizeof(uint32_t))),
+        qual_(reinterpret_cast<const char *>(seq_ + (lSeq_ + 1) / 2)),
+        aux_(qual_ + lSeq_),
+        end_(p + size_)
+    {
+    }
+
+    std::size_t size_;
+    int32_t refId_;
+    int32_t pos_;
+    uint32_t binMqNl_;
+    uint32_t flagNc_;
+    int32_t lSeq_;
+    int32_t nextRefId_;
+    int32_t nextPos_;
+    int32_t tlen_;
+    const char *name_;
+    const char *cigar_;
+    const unsigned char *seq_;
+    const char *qual_;
+    const char *aux_;
+    const char *end_;
+
+    unsigned nameLength() const {return binMqNl_ & 0xff;}
+    unsigned mapq() const {return (binMqNl_ >> 8) & 0xff;}
+    unsigned flag() const {return flagNc_ >> 16;}
+    unsigned cigarLength() const {return flagNc_ & 0xffff;}
+    uint32_t cigar(const unsigned i) const {return common::extractLittleEndian<uint32_t>(cigar_ + i * sizeof(uint32_t));}
+    char base(const int32_t i) const
+    {
+        static const char BAM_BASES[] = "=ACMGRSVTWYHKDBN";
+        return BAM_BASES[(seq_[i / 2] >> (i % 2 ? 0 : 4)) & 0x0f];
+    }
+
+    /// 0-based, exclusive end of the alignment on the reference
+    int32_t referenceEnd() const
+    {
+        int32_t ret = pos_;
+        if (!(flag() & BAM_FUNMAP))
+        {
+            for (unsigned i = 0; cigarLength() != i; ++i)
+            {
+                // M, D, N, = and X consume reference
+                static const unsigned CONSUMES_REFERENCE = 1 << 0 | 1 << 2 | 1 << 3 | 1 << 7 | 1 << 8;
+                if (CONSUMES_REFERENCE & (1 << (cigar(i) & 0xf)))
+                {
+                    ret += cigar(i) >> 4;
+                }
+            }
+        }
+        return std::max(ret, pos_ + 1);
+    }
+};
+
+static std::size_t auxValueLength(const char type, const char *value, const char *end)
+{
+    switch (type)
+    {
+    case 'A': case 'c': case 'C':
+        return 1;
+    case 's': case 'S':
+        return 2;
+    case 'i': case 'I': case 'f':
+        return 4;
+    case 'Z': case 'H':
+        return std::find(value, end, 0) - value + 1;
+    case 'B':
+    {
+        const std::size_t count = common::extractLittleEndian<uint32_t>(value + 1);
+        return 1 + sizeof(uint32_t) + count * auxValueLength(value[0], 0, 0);
+    }
+    default:
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, std::string("Unsupported bam tag type: ") + type));
+    }
+    return 0;
+}
+
+static unsigned baseIndex(const char base)
+{
+    switch (base)
+    {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    case 'N': return 4;
+    default: return 5;
+    }
+}
+
+/**
+ * \brief Collects the data series of a single-slice container
+ */
+class ContainerEncoder
+{
+public:
+    ContainerEncoder(const cram::Reference &reference, const int32_t sliceStart) :
+        series_(CONTENT_ID_END), reference_(reference), prevAp_(sliceStart), bases_(0)
+    {
+    }
+
+    void encodeRecord(const BamRecord &record);
+
+    void putCompressionHeader(std::vector<char> &block) const;
+    /**
+     * \return the content ids of the external blocks put
+     */
+    std::vector<int32_t> putExternalBlocks(std::vector<char> &buffer, const int gzipLevel) const;
+
+    int64_t bases() const {return bases_;}
+
+private:
+    std::vector<std::vector<char> > series_;
+    std::map<int32_t, std::vector<char> > tags_;
+    // tag dictionary lines and their indexes
+    std::map<std::string, int32_t> tagLines_;
+    std::vector<std::string> orderedTagLines_;
+
+    const cram::Reference &reference_;
+    int32_t prevAp_;
+    int64_t bases_;
+
+    // feature count and in-read position of the last feature of the current record
+    int32_t features_;
+    int32_t prevFeaturePos_;
+    std::string tagLine_;
+
+    void putInt(const ContentId id, const int32_t value) {cram::putItf8(series_[id], value);}
+    void putByte(const ContentId id, const char value) {series_[id].push_back(value);}
+    void putFeature(const char code, const int32_t readPos);
+    void encodeTags(const BamRecord &record);
+    void encodeFeatures(const BamRecord &record);
+};
+
+void ContainerEncoder::putFeature(const char code, const int32_t readPos)
+{
+    putByte(FC_ID, code);
+    // in-read position is 1-based
+    putInt(FP_ID, readPos + 1 - prevFeaturePos_);
+    prevFeaturePos_ = readPos + 1;
+    ++features_;
+}
+
+void ContainerEncoder::encodeTags(const BamRecord &record)
+{
+    tagLine_.clear();
+    for (const char *tag = record.aux_; record.end_ > tag;)
+    {
+        const char *value = tag + 3;
+        const std::size_t length = auxValueLength(tag[2], value, record.end_);
+        if (std::size_t(record.end_ - value) < length)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Truncated bam tag"));
+        }
+        tagLine_.append(tag, value);
+        const int32_t key = int32_t(static_cast<unsigned char>(tag[0])) << 16 |
+            int32_t(static_cast<unsigned char>(tag[1])) << 8 | static_cast<unsigned char>(tag[2]);
+        std::vector<char> &block = tags_[key];
+        cram::putItf8(block, length);
+        block.insert(block.end(), value, value + length);
+        tag = value + length;
+    }
+
+    std::map<std::string, int32_t>::const_iterator it = tagLines_.find(tagLine_);
+    if (tagLines_.end() == it)
+    {
+        it = tagLines_.insert(std::make_pair(tagLine_, int32_t(orderedTagLines_.size()))).first;
+        orderedTagLines_.push_back(tagLine_);
+    }
+    putInt(TL_ID, it->second);
+}
+
+void ContainerEncoder::encodeFeatures(const BamRecord &record)
+{
+    features_ = 0;
+    prevFeaturePos_ = 0;
+    int32_t readPos = 0;
+    int64_t refPos = record.pos_;
+    for (unsigned i = 0; record.cigarLength() != i; ++i)
+    {
+        const uint32_t length = record.cigar(i) >> 4;
+        switch (record.cigar(i) & 0xf)
+        {
+        // M, = and X
+        case 0: case 7: case 8:
+            for (uint32_t j = 0; length != j; ++j, ++readPos, ++refPos)
+            {
+                const char readBase = record.base(readPos);
+                const char referenceBase = reference_.base(refPos);
+                const unsigned readIndex = baseIndex(readBase);
+                const unsigned referenceIndex = baseIndex(referenceBase);
+                if (4 <= referenceIndex || 4 < readIndex)
+                {
+                    // reference N is likely to be an IUPAC code folded by the reference loader. Keep the
+                    // read base verbatim so that decoding against the original fasta gives the same read.
+                    putFeature('B', readPos);
+                    putByte(BA_ID, readBase);
+                    putByte(QS_ID, record.qual_[readPos]);
+                }
+                else if (readIndex != referenceIndex)
+                {
+                    putFeature('X', readPos);
+                    // substitution codes enumerate ACGTN without the reference base
+                    putByte(BS_ID, readIndex - (readIndex > referenceIndex));
+                }
+            }
+            break;
+        // I and S
+        case 1: case 4:
+        {
+            const bool insertion = 1 == (record.cigar(i) & 0xf);
+            const ContentId id = insertion ? IN_ID : SC_ID;
+            putFeature(insertion ? 'I' : 'S', readPos);
+            for (uint32_t j = 0; length != j; ++j, ++readPos)
+            {
+                putByte(id, record.base(readPos));
+            }
+            putByte(id, 0);
+            break;
+        }
+        case 2:
+            putFeature('D', readPos);
+            putInt(DL_ID, length);
+            refPos += length;
+            break;
+        case 3:
+            putFeature('N', readPos);
+            putInt(RS_ID, length);
+            refPos += length;
+            break;
+        case 5:
+            putFeature('H', readPos);
+            putInt(HC_ID, length);
+            break;
+        case 6:
+            putFeature('P', readPos);
+            putInt(PD_ID, length);
+            break;
+        default:
+            BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "Unsupported cigar operation in bam record"));
+        }
+    }
+    ISAAC_ASSERT_MSG(record.lSeq_ == readPos, "Cigar does not match the sequence length in bam record " << record.name_);
+    putInt(FN_ID, features_);
+}
+
+void ContainerEncoder::encodeRecord(const BamRecord &record)
+{
+    ISAAC_ASSERT_MSG(record.lSeq_, "Bam records without sequence are not supported by CRAM encoder " << record.name_);
+    const unsigned flag = record.flag();
+    putInt(BF_ID, flag);
+    putInt(CF_ID, cram::CF_QUALITY_ARRAY | cram::CF_DETACHED);
+    putInt(RL_ID, record.lSeq_);
+    putInt(AP_ID, record.pos_ + 1 - prevAp_);
+    prevAp_ = record.pos_ + 1;
+    // read group is kept verbatim among the tags
+    putInt(RG_ID, -1);
+    series_[RN_ID].insert(series_[RN_ID].end(), record.name_, record.name_ + record.nameLength());
+    putInt(MF_ID, (flag & BAM_FMREVERSE ? cram::MF_REVERSE : 0) | (flag & BAM_FMUNMAP ? cram::MF_UNMAPPED : 0));
+    putInt(NS_ID, record.nextRefId_);
+    putInt(NP_ID, record.nextPos_ + 1);
+    putInt(TS_ID, record.tlen_);
+    encodeTags(record);
+
+    if (!(flag & BAM_FUNMAP))
+    {
+        encodeFeatures(record);
+        putInt(MQ_ID, record.mapq());
+    }
+    else
+    {
+        for (int32_t i = 0; record.lSeq_ != i; ++i)
+        {
+            putByte(BA_ID, record.base(i));
+        }
+    }
+    series_[QS_ID].insert(series_[QS_ID].end(), record.qual_, record.qual_ + record.lSeq_);
+    bases_ += record.lSeq_;
+}
+
+static void putEncoding(std::vector<char> &buffer, const int32_t codec, const std::vector<char> &parameters)
+{
+    cram::putItf8(buffer, codec);
+    cram::putItf8(buffer, parameters.size());
+    buffer.insert(buffer.end(), parameters.begin(), parameters.end());
+}
+
+static void putExternalEncoding(std::vector<char> &buffer, const int32_t contentId)
+{
+    std::vector<char> parameters;
+    cram::putItf8(parameters, contentId);
+    putEncoding(buffer, cram::EXTERNAL, parameters);
+}
+
+/**
+ * \brief Appends the map of entries prefixed with its byte size and the number of entries
+ */
+static void putMap(std::vector<char> &buffer, const int32_t entries, const std::vector<char> &map)
+{
+    std::vector<char> counted;
+    cram::putItf8(counted, entries);
+    counted.insert(counted.end(), map.begin(), map.end());
+    cram::putItf8(buffer, counted.size());
+    buffer.insert(buffer.end(), counted.begin(), counted.end());
+}
+
+void ContainerEncoder::putCompressionHeader(std::vector<char> &block) const
+{
+    std::vector<char> map;
+    const char booleans[][2] = {{'R', 'N'}, {'A', 'P'}, {'R', 'R'}};
+    for (const char *key : booleans)
+    {
+        map.insert(map.end(), key, key + 2);
+        map.push_back(1);
+    }
+    map.push_back('S');
+    map.push_back('M');
+    // ACGTN without the reference base get codes 0 to 3 in that order
+    map.insert(map.end(), 5, 0x1b);
+    map.push_back('T');
+    map.push_back('D');
+    std::vector<char> dictionary;
+    BOOST_FOREACH(const std::string &tagLine, orderedTagLines_)
+    {
+        dictionary.insert(dictionary.end(), tagLine.begin(), tagLine.end());
+        dictionary.push_back(0);
+    }
+    cram::putItf8(map, dictionary.size());
+    map.insert(map.end(), dictionary.begin(), dictionary.end());
+    putMap(block, 5, map);
+
+    map.clear();
+    BOOST_FOREACH(const DataSeriesEncoding &dataSeries, DATA_SERIES)
+    {
+        map.insert(map.end(), dataSeries.key_, dataSeries.key_ + 2);
+        if (dataSeries.byteArray_)
+        {
+            std::vector<char> parameters(1, 0);
+            cram::putItf8(parameters, dataSeries.id_);
+            putEncoding(map, cram::BYTE_ARRAY_STOP, parameters);
+        }
+        else
+        {
+            putExternalEncoding(map, dataSeries.id_);
+        }
+    }
+    putMap(block, sizeof(DATA_SERIES) / sizeof(DATA_SERIES[0]), map);
+
+    map.clear();
+    for (const std::pair<const int32_t, std::vector<char> > &tag : tags_)
+    {
+        cram::putItf8(map, tag.first);
+        // lengths and values share the block
+        std::vector<char> parameters;
+        putExternalEncoding(parameters, tag.first);
+        putExternalEncoding(parameters, tag.first);
+        putEncoding(map, cram::BYTE_ARRAY_LEN, parameters);
+    }
+    putMap(block, tags_.size(), map);
+}
+
+std::vector<int32_t> ContainerEncoder::putExternalBlocks(std::vector<char> &buffer, const int gzipLevel) const
+{
+    std::vector<int32_t> ret;
+    for (int32_t id = BF_ID; CONTENT_ID_END != id; ++id)
+    {
+        if (!series_[id].empty())
+        {
+            cram::putBlock(buffer, cram::EXTERNAL_DATA, id, series_[id], gzipLevel);
+            ret.push_back(id);
+        }
+    }
+    for (const std::pair<const int32_t, std::vector<char> > &tag : tags_)
+    {
+        cram::putBlock(buffer, cram::EXTERNAL_DATA, tag.first, tag.second, gzipLevel);
+        ret.push_back(tag.first);
+    }
+    return ret;
+}
+
+/**
+ * \brief Appends the md5 of the reference bases the slice is encoded against. The reference loader folds IUPAC
+ *        codes into N, so an N in the range may stand for a different base in the original fasta and the md5 of
+ *        the loaded bases would not match the one readers compute. Such slices get all zeroes, which readers
+ *        don't verify, and so do the slices without reference bases.
+ */
+static void putReferenceMd5(
+    std::vector<char> &block, const cram::Reference &reference, const int32_t sliceStart, const int32_t span)
+{
+    static const std::size_t MD5_LENGTH = 16;
+    // reads hanging off the end of the contig extend the span past the reference bases
+    const std::size_t begin = std::min<std::size_t>(sliceStart - 1, reference.length_);
+    const std::size_t end = std::min<std::size_t>(begin + span, reference.length_);
+    if (!reference.bases_ || begin == end ||
+        reference.bases_ + end != std::find(reference.bases_ + begin, reference.bases_ + end, 'N'))
+    {
+        block.insert(block.end(), MD5_LENGTH, 0);
+        return;
+    }
+    common::MD5Sum md5;
+    md5.update(reference.bases_ + begin, end - begin);
+    const common::MD5Sum::Digest digest = md5.getDigest();
+    block.insert(block.end(), digest.data, digest.data + MD5_LENGTH);
+}
+
+} // namespace
+
+CramEncoder::CramEncoder(const io::cram::References &references, const int gzipLevel) :
+    references_(&references),
+    gzipLevel_(gzipLevel),
+    scanned_(0),
+    scannedRecords_(0),
+    scannedRefId_(0),
+    recordCounter_(0)
+{
+}
+
+CramEncoder::CramEncoder(const CramEncoder &that) :
+    references_(that.references_),
+    gzipLevel_(that.gzipLevel_),
+    scanned_(0),
+    scannedRecords_(0),
+    scannedRefId_(0),
+    recordCounter_(0)
+{
+}
+
+bool CramEncoder::encodeHeader()
+{
+    static const std::size_t MAGIC_AND_LENGTH = 8;
+    const char *const begin = &pending_.front();
+    const char *const end = begin + pending_.size();
+    if (MAGIC_AND_LENGTH > pending_.size())
+    {
+        return false;
+    }
+    const int32_t textLength = common::extractLittleEndian<int32_t>(begin + 4);
+    const char *p = begin + MAGIC_AND_LENGTH + textLength;
+    if (end - p < int32_t(sizeof(int32_t)))
+    {
+        return false;
+    }
+    // the references are declared in the SAM header text. Only the size of the binary list is of interest.
+    int32_t references = common::extractLittleEndian<int32_t>(p);
+    for (p += sizeof(int32_t); references; --references)
+    {
+        if (end - p < int32_t(sizeof(int32_t)) ||
+            end - p < int32_t(2 * sizeof(int32_t)) + common::extractLittleEndian<int32_t>(p))
+        {
+            return false;
+        }
+        p += 2 * sizeof(int32_t) + common::extractLittleEndian<int32_t>(p);
+    }
+
+    static const char FILE_DEFINITION[cram::FILE_DEFINITION_LENGTH] = {'C', 'R', 'A', 'M', 3, 0};
+    encoded_.insert(encoded_.end(), FILE_DEFINITION, FILE_DEFINITION + sizeof(FILE_DEFINITION));
+
+    std::vector<char> text;
+    cram::putInt32(text, textLength);
+    text.insert(text.end(), begin + MAGIC_AND_LENGTH, begin + MAGIC_AND_LENGTH + textLength);
+    std::vector<char> block;
+    cram::putBlock(block, cram::FILE_HEADER, 0, text, 0);
+
+    cram::ContainerHeader header;
+    header.length_ = block.size();
+    header.blocks_ = 1;
+    cram::putContainerHeader(encoded_, header);
+    encoded_.insert(encoded_.end(), block.begin(), block.end());
+
+    pending_.erase(pending_.begin(), pending_.begin() + (p - begin));
+    return true;
+}
+
+void CramEncoder::encode(const bool flush)
+{
+    static const char BAM_MAGIC[] = {'B', 'A', 'M', 1};
+    // block_size of a record never looks like the bam magic
+    if (!scanned_ && pending_.size() >= sizeof(BAM_MAGIC) &&
+        std::equal(BAM_MAGIC, BAM_MAGIC + sizeof(BAM_MAGIC), pending_.begin()) && !encodeHeader())
+    {
+        return;
+    }
+
+    static const std::size_t REF_ID_END = 2 * sizeof(int32_t);
+    while (pending_.size() - scanned_ >= REF_ID_END)
+    {
+        const char *record = &pending_[scanned_];
+        const std::size_t size = sizeof(int32_t) + common::extractLittleEndian<int32_t>(record);
+        if (pending_.size() - scanned_ < size)
+        {
+            break;
+        }
+        const int32_t refId = common::extractLittleEndian<int32_t>(record + sizeof(int32_t));
+        if (scannedRecords_ && (scannedRefId_ != refId || RECORDS_PER_CONTAINER == scannedRecords_))
+        {
+            encodeContainer(&pending_.front(), &pending_.front() + scanned_, scannedRecords_);
+            pending_.erase(pending_.begin(), pending_.begin() + scanned_);
+            scanned_ = 0;
+            scannedRecords_ = 0;
+            continue;
+        }
+        scannedRefId_ = refId;
+        scanned_ += size;
+        ++scannedRecords_;
+    }
+
+    if (flush && scannedRecords_)
+    {
+        encodeContainer(&pending_.front(), &pending_.front() + scanned_, scannedRecords_);
+        pending_.erase(pending_.begin(), pending_.begin() + scanned_);
+        scanned_ = 0;
+        scannedRecords_ = 0;
+    }
+}
+
+void CramEncoder::encodeContainer(const char *begin, const char *end, const unsigned records)
+{
+    static const cram::Reference noReference("", 0, 0);
+    const int32_t refId = BamRecord(begin).refId_;
+    const cram::Reference &reference =
+        (0 <= refId && references_->size() > std::size_t(refId)) ? references_->at(refId) : noReference;
+
+    int32_t sliceStart = 0;
+    int32_t sliceEnd = 0;
+    if (0 <= refId)
+    {
+        sliceStart = BamRecord(begin).pos_ + 1;
+        for (const char *p = begin; end != p;)
+        {
+            const BamRecord record(p);
+            sliceStart = std::min(sliceStart, record.pos_ + 1);
+            sliceEnd = std::max(sliceEnd, record.referenceEnd());
+            p = record.end_;
+        }
+    }
+
+    ContainerEncoder containerEncoder(reference, sliceStart);
+    for (const char *p = begin; end != p;)
+    {
+        const BamRecord record(p);
+        containerEncoder.encodeRecord(record);
+        p = record.end_;
+    }
+
+    std::vector<char> data;
+    std::vector<char> block;
+    containerEncoder.putCompressionHeader(block);
+    cram::putBlock(data, cram::COMPRESSION_HEADER, 0, block, 0);
+    const int32_t sliceOffset = data.size();
+
+    std::vector<char> externalBlocks;
+    const std::vector<int32_t> contentIds = containerEncoder.putExternalBlocks(externalBlocks, gzipLevel_);
+
+    const int32_t span = 0 <= refId ? sliceEnd + 1 - sliceStart : 0;
+    block.clear();
+    cram::putItf8(block, refId);
+    cram::putItf8(block, sliceStart);
+    cram::putItf8(block, span);
+    cram::putItf8(block, records);
+    cram::putLtf8(block, recordCounter_);
+    // core block and the external ones
+    cram::putItf8(block, contentIds.size() + 1);
+    cram::putItf8(block, contentIds.size());
+    BOOST_FOREACH(const int32_t contentId, contentIds)
+    {
+        cram::putItf8(block, contentId);
+    }
+    // no embedded reference
+    cram::putItf8(block, -1);
+    putReferenceMd5(block, reference, sliceStart, span);
+    cram::putBlock(data, cram::MAPPED_SLICE, 0, block, 0);
+    cram::putBlock(data, cram::CORE_DATA, 0, std::vector<char>(), 0);
+    data.insert(data.end(), externalBlocks.begin(), externalBlocks.end());
+
+    cram::ContainerHeader header;
+    header.length_ = data.size();
+    header.refId_ = refId;
+    header.start_ = sliceStart;
+    header.span_ = span;
+    header.records_ = records;
+    header.recordCounter_ = recordCounter_;
+    header.bases_ = containerEncoder.bases();
+    header.blocks_ = 3 + contentIds.size();
+    header.landmarks_.push_back(sliceOffset);
+    cram::putContainerHeader(encoded_, header);
+    encoded_.insert(encoded_.end(), data.begin(), data.end());
+
+    recordCounter_ += records;
+}
+
+void serializeCramFooter(std::ostream &os)
+{
+    serialize(os, io::cram::EOF_CONTAINER, io::cram::EOF_CONTAINER_LENGTH);
+}
+
+} // namespace bam
+} // namespace isaac
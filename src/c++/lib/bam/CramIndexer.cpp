@@ -0,0 +1,93 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramIndexer.cpp
+ **
+ ** \brief See CramIndexer.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/stream.hpp>
+
+#include "bam/CramIndexer.hh"
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "io/Cram.hh"
+
+namespace isaac
+{
+namespace bam
+{
+
+namespace bios=boost::iostreams;
+
+CramIndex::CramIndex() : offset_(0)
+{
+}
+
+CramIndex::CramIndex(const boost::filesystem::path &cramPath, const uint64_t headerLength) :
+    path_(cramPath.string() + ".crai"),
+    file_(path_.c_str(), std::ios_base::binary),
+    offset_(headerLength)
+{
+    if (!file_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Error opening cram index file for writing: " + path_.string()));
+    }
+    stream_.push(bios::gzip_compressor());
+    stream_.push(file_);
+}
+
+void CramIndex::processContainers(const char *begin, const char *end)
+{
+    if (path_.empty())
+    {
+        return;
+    }
+    bios::stream<bios::array_source> is(begin, end - begin);
+    io::cram::ContainerHeader header;
+    for (std::streamoff containerBegin = 0; io::cram::readContainerHeader(is, header); containerBegin = is.tellg())
+    {
+        const std::streamoff headerEnd = is.tellg();
+        ISAAC_ASSERT_MSG(end - begin >= headerEnd + header.length_,
+                         "Incomplete cram container given for indexing " << path_);
+        for (std::size_t slice = 0; header.landmarks_.size() != slice; ++slice)
+        {
+            const int32_t sliceEnd = header.landmarks_.size() == slice + 1 ?
+                header.length_ : header.landmarks_.at(slice + 1);
+            stream_ << header.refId_ << '\t' << header.start_ << '\t' << header.span_ << '\t' <<
+                offset_ + containerBegin << '\t' << header.landmarks_.at(slice) << '\t' <<
+                sliceEnd - header.landmarks_.at(slice) << '\n';
+        }
+        if (!stream_)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "Error writing cram index file " + path_.string()));
+        }
+        is.seekg(header.length_, std::ios_base::cur);
+    }
+    offset_ += end - begin;
+}
+
+void CramIndex::flush()
+{
+    if (!path_.empty())
+    {
+        stream_.reset();
+        file_.close();
+    }
+}
+
+} // namespace bam
+} // namespace isaac
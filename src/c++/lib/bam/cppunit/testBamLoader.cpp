@@ -0,0 +1,264 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/tuple/tuple.hpp>
+
+#include "RegistryName.hh"
+#include "testBamLoader.hh"
+
+#include "bam/Bam.hh"
+#include "bgzf/BgzfCompressor.hh"
+#include "io/BamLoader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBamLoader, registryName("BamLoader"));
+
+namespace bios = boost::iostreams;
+
+namespace
+{
+
+const unsigned CORES = 3;
+
+void appendInt(std::string &s, const int value)
+{
+    for (unsigned i = 0; 4 != i; ++i)
+    {
+        s.push_back(char(unsigned(value) >> (i * 8)));
+    }
+}
+
+std::string makeHeader()
+{
+    const std::string text = "@HD\tVN:1.4\tSO:unsorted\n@SQ\tSN:chr1\tLN:1000\n";
+    std::string ret = "BAM\1";
+    appendInt(ret, text.size());
+    ret += text;
+    // n_ref
+    appendInt(ret, 1);
+    appendInt(ret, 5);
+    ret.append("chr1", 5);
+    appendInt(ret, 1000);
+    return ret;
+}
+
+std::string makeName(const unsigned i)
+{
+    return "record" + std::to_string(i);
+}
+
+/**
+ * \brief Unaligned record with lSeq bases. Lengths vary so that records fall across bgzf block boundaries at
+ *        different offsets
+ */
+std::string makeRecord(const std::string &name, const unsigned lSeq)
+{
+    std::string block;
+    // refID, pos
+    appendInt(block, -1);
+    appendInt(block, -1);
+    // bin_mq_nl
+    appendInt(block, (4680 << 16) | (name.size() + 1));
+    // flag_nc: unmapped, no cigar
+    appendInt(block, 0x4 << 16);
+    appendInt(block, lSeq);
+    // next_refID, next_pos, tlen
+    appendInt(block, -1);
+    appendInt(block, -1);
+    appendInt(block, 0);
+    block += name;
+    block.push_back('\0');
+    // ACAC...
+    block.append((lSeq + 1) / 2, char(0x12));
+    block.append(lSeq, char(30));
+
+    std::string ret;
+    appendInt(ret, block.size());
+    return ret + block;
+}
+
+unsigned recordLength(const unsigned i)
+{
+    return 1 + i % 301;
+}
+
+std::string makeRecords(const unsigned count)
+{
+    std::string ret;
+    for (unsigned i = 0; count != i; ++i)
+    {
+        ret += makeRecord(makeName(i), recordLength(i));
+    }
+    return ret;
+}
+
+struct Collected
+{
+    Collected() : lastBlocks_(0), removeOldCalls_(0){}
+    std::vector<std::string> names_;
+    std::vector<const isaac::bam::BamBlockHeader *> blocks_;
+    unsigned lastBlocks_;
+    unsigned removeOldCalls_;
+};
+
+/**
+ * \brief Loads until the end of the file or until stopAfter records are seen
+ *
+ * \return number of records seen
+ */
+unsigned load(isaac::io::BamLoader &loader, Collected &collected, const unsigned stopAfter)
+{
+    unsigned ret = 0;
+    loader.load(
+        boost::make_tuple(
+            [&](const isaac::bam::BamBlockHeader &block, const bool lastBlock)
+            {
+                collected.names_.push_back(std::string(block.nameBegin(), block.nameEnd() - 1));
+                CPPUNIT_ASSERT_EQUAL(int(recordLength(collected.names_.size() - 1)), block.getLSeq());
+                collected.blocks_.push_back(&block);
+                collected.lastBlocks_ += lastBlock;
+                return stopAfter != ++ret;
+            },
+            [&](const char *begin, const char *end)
+            {
+                ++collected.removeOldCalls_;
+                for (const isaac::bam::BamBlockHeader *block : collected.blocks_)
+                {
+                    CPPUNIT_ASSERT(begin <= reinterpret_cast<const char *>(block));
+                    CPPUNIT_ASSERT(end >= reinterpret_cast<const char *>(block) + block->blockLength());
+                }
+                collected.blocks_.clear();
+            }));
+    return ret;
+}
+
+std::vector<std::string> makeNames(const unsigned count)
+{
+    std::vector<std::string> ret;
+    for (unsigned i = 0; count != i; ++i)
+    {
+        ret.push_back(makeName(i));
+    }
+    return ret;
+}
+
+} // namespace
+
+void TestBamLoader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestBamLoader::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+boost::filesystem::path TestBamLoader::writeBam(const std::string &name, const std::string &records) const
+{
+    const boost::filesystem::path ret = tempDir_ / name;
+    const std::string data = makeHeader() + records;
+    {
+        bios::filtering_ostream os;
+        os.push(isaac::bgzf::BgzfCompressor());
+        os.push(bios::file_sink(ret.string(), std::ios_base::binary));
+        os.write(data.data(), data.size());
+        CPPUNIT_ASSERT(os);
+    }
+    std::ofstream os(ret.c_str(), std::ios_base::binary | std::ios_base::app);
+    isaac::bam::serializeBgzfFooter(os);
+    CPPUNIT_ASSERT(os);
+    return ret;
+}
+
+void TestBamLoader::testRecords()
+{
+    // about ten bgzf blocks
+    const unsigned count = 3000;
+    const boost::filesystem::path path = writeBam("records.bam", makeRecords(count));
+
+    isaac::io::BamLoader loader(0, CORES, isaac::io::cram::References());
+    loader.open(path);
+    Collected collected;
+    CPPUNIT_ASSERT_EQUAL(count, load(loader, collected, -1U));
+    CPPUNIT_ASSERT(makeNames(count) == collected.names_);
+    // all records fit in one buffer
+    CPPUNIT_ASSERT_EQUAL(1U, collected.lastBlocks_);
+    CPPUNIT_ASSERT_EQUAL(1U, collected.removeOldCalls_);
+    CPPUNIT_ASSERT(collected.blocks_.empty());
+
+    // header only
+    loader.open(writeBam("empty.bam", std::string()));
+    Collected empty;
+    CPPUNIT_ASSERT_EQUAL(0U, load(loader, empty, -1U));
+    CPPUNIT_ASSERT(empty.names_.empty());
+}
+
+void TestBamLoader::testResume()
+{
+    const unsigned count = 1000;
+    isaac::io::BamLoader loader(0, CORES, isaac::io::cram::References());
+    loader.open(writeBam("resume.bam", makeRecords(count)));
+
+    static const unsigned STOP_AFTER = 7;
+    Collected collected;
+    unsigned calls = 0;
+    while (STOP_AFTER == load(loader, collected, STOP_AFTER))
+    {
+        ++calls;
+        // records are not freed while the loading is suspended
+        CPPUNIT_ASSERT_EQUAL(0U, collected.removeOldCalls_);
+    }
+    CPPUNIT_ASSERT_EQUAL(count / STOP_AFTER, calls);
+    CPPUNIT_ASSERT(makeNames(count) == collected.names_);
+    CPPUNIT_ASSERT_EQUAL(1U, collected.removeOldCalls_);
+}
+
+void TestBamLoader::testReopen()
+{
+    const boost::filesystem::path first = writeBam("first.bam", makeRecords(500));
+    const boost::filesystem::path second = writeBam("second.bam", makeRecords(200));
+
+    isaac::io::BamLoader loader(0, CORES, isaac::io::cram::References());
+    loader.open(first);
+    Collected abandoned;
+    CPPUNIT_ASSERT_EQUAL(10U, load(loader, abandoned, 10));
+
+    // the header of the second file is parsed and nothing of the first one comes through
+    loader.open(second);
+    Collected collected;
+    CPPUNIT_ASSERT_EQUAL(200U, load(loader, collected, -1U));
+    CPPUNIT_ASSERT(makeNames(200) == collected.names_);
+
+    loader.open(first);
+    Collected again;
+    CPPUNIT_ASSERT_EQUAL(500U, load(loader, again, -1U));
+    CPPUNIT_ASSERT(makeNames(500) == again.names_);
+}
+
+void TestBamLoader::testTruncated()
+{
+    // last record is missing its tail
+    std::string records = makeRecords(100);
+    records.resize(records.size() - 10);
+
+    isaac::io::BamLoader loader(0, CORES, isaac::io::cram::References());
+    loader.open(writeBam("truncated.bam", records));
+    Collected collected;
+    CPPUNIT_ASSERT_THROW(load(loader, collected, -1U), isaac::io::BamLoaderException);
+    CPPUNIT_ASSERT(makeNames(99) == collected.names_);
+}
@@ -0,0 +1,44 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BAM_TEST_BAM_LOADER_HH
+#define iSAAC_BAM_TEST_BAM_LOADER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+class TestBamLoader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBamLoader );
+    CPPUNIT_TEST( testRecords );
+    CPPUNIT_TEST( testResume );
+    CPPUNIT_TEST( testReopen );
+    CPPUNIT_TEST( testTruncated );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    boost::filesystem::path writeBam(const std::string &name, const std::string &records) const;
+public:
+    void setUp();
+    void tearDown();
+    void testRecords();
+    void testResume();
+    void testReopen();
+    void testTruncated();
+};
+
+#endif // #ifndef iSAAC_BAM_TEST_BAM_LOADER_HH
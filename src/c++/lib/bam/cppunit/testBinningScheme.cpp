@@ -0,0 +1,229 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "RegistryName.hh"
+#include "testBinningScheme.hh"
+
+#include "bam/BamIndexer.hh"
+#include "bgzf/BgzfCompressor.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBinningScheme, registryName("BinningScheme"));
+
+namespace bios = boost::iostreams;
+
+using isaac::bam::BinningScheme;
+
+namespace
+{
+
+// expected values below are the ones of hts_reg2bin, hts_bin_bot and the meta bin of htslib
+
+/// 600Mbp, does not fit bai
+const uint64_t LONG_CONTIG_LENGTH = 600000000;
+
+template <typename T> T readValue(std::istream &is)
+{
+    T ret = 0;
+    CPPUNIT_ASSERT(is.read(reinterpret_cast<char *>(&ret), sizeof(ret)));
+    return ret;
+}
+
+uint64_t virtualOffset(const uint64_t compressedOffset, const unsigned uncompressedOffset)
+{
+    return compressedOffset << 16 | uncompressedOffset;
+}
+
+} // namespace
+
+void TestBinningScheme::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestBinningScheme::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestBinningScheme::testGetDepth()
+{
+    // 256 bases of slack past the end of the contig, same as samtools
+    CPPUNIT_ASSERT_EQUAL(0U, BinningScheme::getDepth(14, 0));
+    CPPUNIT_ASSERT_EQUAL(0U, BinningScheme::getDepth(14, (1 << 14) - 256));
+    CPPUNIT_ASSERT_EQUAL(1U, BinningScheme::getDepth(14, (1 << 14) - 255));
+    CPPUNIT_ASSERT_EQUAL(5U, BinningScheme::getDepth(14, (1 << 29) - 256));
+    CPPUNIT_ASSERT_EQUAL(6U, BinningScheme::getDepth(14, 1 << 29));
+    CPPUNIT_ASSERT_EQUAL(6U, BinningScheme::getDepth(14, LONG_CONTIG_LENGTH));
+    CPPUNIT_ASSERT_EQUAL(5U, BinningScheme::getDepth(17, LONG_CONTIG_LENGTH));
+    // human chr1 with the htslib default for csi
+    CPPUNIT_ASSERT_EQUAL(5U, BinningScheme::getDepth(14, 248956422));
+}
+
+void TestBinningScheme::testBai()
+{
+    const BinningScheme bai;
+    CPPUNIT_ASSERT_EQUAL(14U, bai.getMinShift());
+    CPPUNIT_ASSERT_EQUAL(5U, bai.getDepth());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(isaac::bam::BAM_MAX_CONTIG_LENGTH), bai.getMaxContigLength());
+    CPPUNIT_ASSERT_EQUAL(37450U, bai.getPseudoBin());
+
+    CPPUNIT_ASSERT_EQUAL(4681U, bai.reg2bin(0, 1));
+    CPPUNIT_ASSERT_EQUAL(4681U, bai.reg2bin(0, 1 << 14));
+    CPPUNIT_ASSERT_EQUAL(4682U, bai.reg2bin(1 << 14, (1 << 14) + 1));
+    CPPUNIT_ASSERT_EQUAL(585U, bai.reg2bin(16383, 16385));
+    CPPUNIT_ASSERT_EQUAL(4689U, bai.reg2bin(1 << 17, (1 << 17) + 100));
+    CPPUNIT_ASSERT_EQUAL(586U, bai.reg2bin((1 << 17) + 16383, (1 << 17) + 16385));
+    CPPUNIT_ASSERT_EQUAL(73U, bai.reg2bin(0, (1 << 20) - 1));
+    CPPUNIT_ASSERT_EQUAL(9U, bai.reg2bin(0, (1 << 23)));
+    CPPUNIT_ASSERT_EQUAL(1U, bai.reg2bin(0, (1 << 26)));
+    CPPUNIT_ASSERT_EQUAL(0U, bai.reg2bin(0, 1 << 29));
+    CPPUNIT_ASSERT_EQUAL(0U, bai.reg2bin((1 << 26) - 1, (1 << 26) + 1));
+    CPPUNIT_ASSERT_EQUAL(37448U, bai.reg2bin((1 << 29) - 1, 1 << 29));
+    CPPUNIT_ASSERT_EQUAL(4681U + 6103U, bai.reg2bin(100000000, 100000100));
+
+    // first 16kbp window of each level
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), bai.getBinFirstWindow(0));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), bai.getBinFirstWindow(1));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4096), bai.getBinFirstWindow(2));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(28672), bai.getBinFirstWindow(8));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(512), bai.getBinFirstWindow(10));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(64), bai.getBinFirstWindow(74));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), bai.getBinFirstWindow(585));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(8), bai.getBinFirstWindow(586));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), bai.getBinFirstWindow(4681));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(6103), bai.getBinFirstWindow(4681 + 6103));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(32767), bai.getBinFirstWindow(37448));
+}
+
+void TestBinningScheme::testLongContig()
+{
+    const BinningScheme csi(14, BinningScheme::getDepth(14, LONG_CONTIG_LENGTH));
+    CPPUNIT_ASSERT_EQUAL(6U, csi.getDepth());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1) << 32, csi.getMaxContigLength());
+    CPPUNIT_ASSERT_EQUAL(299594U, csi.getPseudoBin());
+
+    // the extra level shifts all bin numbers
+    CPPUNIT_ASSERT_EQUAL(37449U, csi.reg2bin(0, 1));
+    CPPUNIT_ASSERT_EQUAL(4681U, csi.reg2bin(16383, 16385));
+    CPPUNIT_ASSERT_EQUAL(37449U + 36621U, csi.reg2bin(LONG_CONTIG_LENGTH, LONG_CONTIG_LENGTH + 100));
+    CPPUNIT_ASSERT_EQUAL(4681U + 4577U, csi.reg2bin(36621 * 16384 - 100, 36621 * 16384 + 100));
+    CPPUNIT_ASSERT_EQUAL(585U + 572U, csi.reg2bin(LONG_CONTIG_LENGTH - 100000, LONG_CONTIG_LENGTH));
+    // spans the bai-addressable range
+    CPPUNIT_ASSERT_EQUAL(1U, csi.reg2bin(0, 1 << 29));
+    CPPUNIT_ASSERT_EQUAL(2U, csi.reg2bin(1 << 29, 1 << 30));
+    CPPUNIT_ASSERT_EQUAL(9U + 8U, csi.reg2bin(1 << 29, LONG_CONTIG_LENGTH));
+    CPPUNIT_ASSERT_EQUAL(0U, csi.reg2bin((1 << 29) - 1, (1 << 29) + 1));
+
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), csi.getBinFirstWindow(1));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(32768), csi.getBinFirstWindow(2));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(36621), csi.getBinFirstWindow(37449 + 36621));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4577 * 8), csi.getBinFirstWindow(4681 + 4577));
+    CPPUNIT_ASSERT_EQUAL(uint64_t((1 << 18) - 1), csi.getBinFirstWindow(299592));
+
+    // larger windows keep the bai depth
+    const BinningScheme wide(17, BinningScheme::getDepth(17, LONG_CONTIG_LENGTH));
+    CPPUNIT_ASSERT_EQUAL(37450U, wide.getPseudoBin());
+    CPPUNIT_ASSERT_EQUAL(4681U + 4577U, wide.reg2bin(LONG_CONTIG_LENGTH, LONG_CONTIG_LENGTH + 100));
+}
+
+void TestBinningScheme::testCsiLayout()
+{
+    const boost::filesystem::path bamPath = tempDir_ / "test.bam";
+    const uint32_t bamHeaderCompressedLength = 100;
+    // the contig is too long for bai, only csi is produced
+    isaac::bam::BamIndex bamIndex(bamPath, 1, bamHeaderCompressedLength,
+                                  isaac::bam::BAM_INDEX_BAI | isaac::bam::BAM_INDEX_CSI, 14, LONG_CONTIG_LENGTH);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), bamIndex.getSchemes().size());
+    CPPUNIT_ASSERT_EQUAL(6U, bamIndex.getSchemes().front().getDepth());
+
+    // three 40-byte records in a single bgzf block. The second one crosses a 16kbp window boundary
+    isaac::bam::BamIndexPart part(bamIndex);
+    isaac::bam::BinningIndexPart &binning = part.binnings_.front();
+    binning.addAlignment(0, 100, 50, 50, 0, 40);
+    binning.addAlignment(0, 147450, 10, 10, 40, 80);
+    binning.addAlignment(0, LONG_CONTIG_LENGTH, 100, 100, 80, 120);
+    part.bamStatsMapped_ = 3;
+
+    std::vector<char> compressed;
+    {
+        bios::filtering_ostream os;
+        os.push(isaac::bgzf::BgzfCompressor());
+        os.push(bios::back_inserter(compressed));
+        const std::vector<char> records(120, 'r');
+        os.write(&records.front(), records.size());
+    }
+    isaac::bam::BgzfBuffer bgzfBuffer;
+    bgzfBuffer.reserve(compressed.size());
+    bgzfBuffer.insert(bgzfBuffer.end(), compressed.begin(), compressed.end());
+
+    bamIndex.processIndexPart(part, bgzfBuffer);
+    bamIndex.flush();
+    CPPUNIT_ASSERT(!boost::filesystem::exists(bamPath.string() + ".bai"));
+
+    std::ifstream file((bamPath.string() + ".csi").c_str(), std::ios_base::binary);
+    bios::filtering_istream is;
+    is.push(bios::gzip_decompressor());
+    is.push(file);
+
+    char magic[4] = {0};
+    CPPUNIT_ASSERT(is.read(magic, sizeof(magic)));
+    CPPUNIT_ASSERT_EQUAL(std::string("CSI\1"), std::string(magic, sizeof(magic)));
+    CPPUNIT_ASSERT_EQUAL(14, readValue<int32_t>(is));
+    CPPUNIT_ASSERT_EQUAL(6, readValue<int32_t>(is));
+    // l_aux
+    CPPUNIT_ASSERT_EQUAL(0, readValue<int32_t>(is));
+    // n_ref
+    CPPUNIT_ASSERT_EQUAL(1, readValue<int32_t>(is));
+    CPPUNIT_ASSERT_EQUAL(4U, readValue<uint32_t>(is));
+
+    const uint64_t blockEnd = virtualOffset(bamHeaderCompressedLength + compressed.size(), 0);
+    // each bin is followed by the smallest offset of the reads overlapping its first window
+    struct Bin {uint32_t bin_; uint64_t loffset_; uint64_t begin_; uint64_t end_;} const expected[] = {
+        {4681 + 1, virtualOffset(bamHeaderCompressedLength, 40),
+            virtualOffset(bamHeaderCompressedLength, 40), virtualOffset(bamHeaderCompressedLength, 80)},
+        {37449, virtualOffset(bamHeaderCompressedLength, 0),
+            virtualOffset(bamHeaderCompressedLength, 0), virtualOffset(bamHeaderCompressedLength, 40)},
+        {37449 + 36621, virtualOffset(bamHeaderCompressedLength, 80),
+            virtualOffset(bamHeaderCompressedLength, 80), blockEnd},
+    };
+    for (const Bin &bin : expected)
+    {
+        CPPUNIT_ASSERT_EQUAL(bin.bin_, readValue<uint32_t>(is));
+        CPPUNIT_ASSERT_EQUAL(bin.loffset_, readValue<uint64_t>(is));
+        CPPUNIT_ASSERT_EQUAL(1U, readValue<uint32_t>(is));
+        CPPUNIT_ASSERT_EQUAL(bin.begin_, readValue<uint64_t>(is));
+        CPPUNIT_ASSERT_EQUAL(bin.end_, readValue<uint64_t>(is));
+    }
+
+    // pseudo bin with its loffset, then mapped and unmapped counts
+    CPPUNIT_ASSERT_EQUAL(299594U, readValue<uint32_t>(is));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), readValue<uint64_t>(is));
+    CPPUNIT_ASSERT_EQUAL(2U, readValue<uint32_t>(is));
+    CPPUNIT_ASSERT_EQUAL(virtualOffset(bamHeaderCompressedLength, 0), readValue<uint64_t>(is));
+    CPPUNIT_ASSERT_EQUAL(blockEnd, readValue<uint64_t>(is));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(3), readValue<uint64_t>(is));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), readValue<uint64_t>(is));
+
+    // no linear index, the n_no_coor closes the file
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), readValue<uint64_t>(is));
+    CPPUNIT_ASSERT_EQUAL(std::char_traits<char>::eof(), is.get());
+}
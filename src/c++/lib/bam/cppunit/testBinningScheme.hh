@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BAM_TEST_BINNING_SCHEME_HH
+#define iSAAC_BAM_TEST_BINNING_SCHEME_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestBinningScheme : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBinningScheme );
+    CPPUNIT_TEST( testGetDepth );
+    CPPUNIT_TEST( testBai );
+    CPPUNIT_TEST( testLongContig );
+    CPPUNIT_TEST( testCsiLayout );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testGetDepth();
+    void testBai();
+    void testLongContig();
+    void testCsiLayout();
+};
+
+#endif // #ifndef iSAAC_BAM_TEST_BINNING_SCHEME_HH
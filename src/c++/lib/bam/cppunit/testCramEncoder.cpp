@@ -0,0 +1,321 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <sstream>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "RegistryName.hh"
+#include "testCramEncoder.hh"
+
+#include "bam/Bam.hh"
+#include "bam/CramEncoder.hh"
+#include "bam/CramIndexer.hh"
+#include "common/MD5Sum.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestCramEncoder, registryName("CramEncoder"));
+
+namespace bios = boost::iostreams;
+namespace cram = isaac::io::cram;
+
+namespace
+{
+
+void putInt32(std::vector<char> &buffer, const int32_t value)
+{
+    cram::putInt32(buffer, value);
+}
+
+enum CigarOp {M = 0, I = 1, D = 2, S = 4};
+
+struct Cigar
+{
+    CigarOp op_;
+    unsigned length_;
+};
+
+/**
+ * \brief serializes a bam record with the bin computed the same way the cram decoder does
+ */
+void putRecord(
+    std::vector<char> &buffer,
+    const int32_t refId,
+    const int32_t pos,
+    const std::string &name,
+    const unsigned flag,
+    const unsigned mapq,
+    const std::vector<Cigar> &cigar,
+    const std::string &seq,
+    const std::string &qual,
+    const int32_t nextRefId,
+    const int32_t nextPos,
+    const int32_t tlen,
+    const std::string &aux)
+{
+    int32_t end = pos;
+    for (const Cigar &op : cigar)
+    {
+        end += (M == op.op_ || D == op.op_) ? op.length_ : 0;
+    }
+
+    std::vector<char> record;
+    putInt32(record, refId);
+    putInt32(record, pos);
+    putInt32(record, unsigned(isaac::bam::bam_reg2bin(pos, std::max(end, pos + 1))) << 16 | mapq << 8 | (name.size() + 1));
+    putInt32(record, flag << 16 | cigar.size());
+    putInt32(record, seq.size());
+    putInt32(record, nextRefId);
+    putInt32(record, nextPos);
+    putInt32(record, tlen);
+    record.insert(record.end(), name.begin(), name.end());
+    record.push_back(0);
+    for (const Cigar &op : cigar)
+    {
+        putInt32(record, op.length_ << 4 | op.op_);
+    }
+    static const std::string BAM_BASES("=ACMGRSVTWYHKDBN");
+    for (std::size_t i = 0; seq.size() > i; i += 2)
+    {
+        record.push_back(BAM_BASES.find(seq[i]) << 4 | (seq.size() > i + 1 ? BAM_BASES.find(seq[i + 1]) : 0));
+    }
+    for (const char q : qual)
+    {
+        record.push_back(q - 33);
+    }
+    record.insert(record.end(), aux.begin(), aux.end());
+
+    putInt32(buffer, record.size());
+    buffer.insert(buffer.end(), record.begin(), record.end());
+}
+
+std::vector<Cigar> cigar(const CigarOp op, const unsigned length)
+{
+    return std::vector<Cigar>(1, Cigar{op, length});
+}
+
+void writeCram(const cram::References &references, const std::vector<char> &bam, std::vector<char> &cram)
+{
+    bios::filtering_ostream os;
+    os.push(isaac::bam::CramEncoder(references, 1));
+    os.push(bios::back_inserter(cram));
+    os.write(&bam.front(), bam.size());
+    os.strict_sync();
+    CPPUNIT_ASSERT(os);
+}
+
+} // namespace
+
+void TestCramEncoder::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+
+    chr1_.clear();
+    for (unsigned i = 0; 300 != i; ++i)
+    {
+        chr1_.push_back("ACGT"[(i * 7 + i / 5) % 4]);
+    }
+    chr1_[150] = 'N';
+    chr2_ = chr1_.substr(17, 120);
+    references_.clear();
+    references_.push_back(cram::Reference("chr1", chr1_.size(), chr1_.c_str()));
+    references_.push_back(cram::Reference("chr2", chr2_.size(), chr2_.c_str()));
+
+    const std::string text = "@HD\tVN:1.4\tSO:coordinate\n@SQ\tSN:chr1\tLN:300\n@SQ\tSN:chr2\tLN:120\n";
+    bamHeader_.assign({'B', 'A', 'M', 1});
+    putInt32(bamHeader_, text.size());
+    bamHeader_.insert(bamHeader_.end(), text.begin(), text.end());
+    putInt32(bamHeader_, references_.size());
+    for (const cram::Reference &reference : references_)
+    {
+        putInt32(bamHeader_, reference.name_.size() + 1);
+        bamHeader_.insert(bamHeader_.end(), reference.name_.begin(), reference.name_.end());
+        bamHeader_.push_back(0);
+        putInt32(bamHeader_, reference.length_);
+    }
+
+    const std::string aux("NMC\1", 4);
+    bamRecords_.clear();
+    // exact match, paired
+    putRecord(bamRecords_, 0, 10, "r1", 0x1 | 0x2 | 0x20 | 0x40, 60, cigar(M, 20), chr1_.substr(10, 20),
+              "IIIIIIIIIIIIIIIIIIII", 0, 100, 110, "");
+    // mismatches and a base the reference does not have
+    std::string seq = chr1_.substr(20, 12);
+    seq[3] = 'A' == seq[3] ? 'C' : 'A';
+    seq[7] = 'N';
+    putRecord(bamRecords_, 0, 20, "r2", 0x10, 37, cigar(M, 12), seq, "#$%&'()*+,-.", -1, -1, 0, aux);
+    // soft clip, insertion and deletion
+    std::vector<Cigar> indels = {{S, 3}, {M, 10}, {I, 2}, {M, 5}, {D, 4}, {M, 8}};
+    seq = "TTT" + chr1_.substr(40, 10) + "GG" + chr1_.substr(50, 5) + chr1_.substr(59, 8);
+    putRecord(bamRecords_, 0, 40, "r3", 0, 12, indels, seq, std::string(seq.size(), '5'), -1, -1, 0, "");
+    // over the reference N
+    putRecord(bamRecords_, 0, 140, "r4", 0x1 | 0x80, 60, cigar(M, 20), chr1_.substr(140, 20),
+              std::string(20, 'A'), 0, 10, -110, "");
+    putRecord(bamRecords_, 1, 0, "r5", 0, 60, cigar(M, 30), chr2_.substr(0, 30), std::string(30, '?'), -1, -1, 0, "");
+    putRecord(bamRecords_, 1, 90, "r6", 0, 60, cigar(M, 30), chr2_.substr(90, 30), std::string(30, '?'), -1, -1, 0, "");
+    // unmapped at the end of the file
+    putRecord(bamRecords_, -1, -1, "r7", 0x4, 0, std::vector<Cigar>(), "ACGTNACGT", "IIIIIIIII", -1, -1, 0, "");
+
+    cram_.clear();
+    writeCram(references_, bamHeader_, cram_);
+    cramHeaderLength_ = cram_.size();
+    std::vector<char> bam(bamHeader_);
+    bam.insert(bam.end(), bamRecords_.begin(), bamRecords_.end());
+    cram_.clear();
+    writeCram(references_, bam, cram_);
+}
+
+void TestCramEncoder::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestCramEncoder::testRoundTrip()
+{
+    std::istringstream is(std::string(cram_.begin(), cram_.end()));
+    const std::string samHeader = cram::readFileHeader(is);
+    CPPUNIT_ASSERT_EQUAL(std::string(bamHeader_.begin() + 8, bamHeader_.begin() + 8 + samHeader.size()), samHeader);
+    CPPUNIT_ASSERT_EQUAL(std::streamoff(cramHeaderLength_), std::streamoff(is.tellg()));
+
+    isaac::io::CramDecoder decoder;
+    decoder.open(samHeader, references_);
+    std::vector<char> decoded;
+    unsigned containers = 0;
+    cram::ContainerHeader header;
+    while (cram::readContainerHeader(is, header))
+    {
+        std::vector<char> data(header.length_);
+        CPPUNIT_ASSERT(is.read(&data.front(), data.size()));
+        decoder.decodeContainer(header, &data.front(), &data.back() + 1, decoded);
+        ++containers;
+    }
+    // one container per reference
+    CPPUNIT_ASSERT_EQUAL(3U, containers);
+    CPPUNIT_ASSERT_EQUAL(bamRecords_.size(), decoded.size());
+    CPPUNIT_ASSERT(bamRecords_ == decoded);
+}
+
+void TestCramEncoder::testReferenceMd5()
+{
+    std::istringstream is(std::string(cram_.begin(), cram_.end()));
+    cram::readFileHeader(is);
+    cram::ContainerHeader header;
+    unsigned mapped = 0;
+    while (cram::readContainerHeader(is, header))
+    {
+        std::vector<char> data(header.length_);
+        CPPUNIT_ASSERT(is.read(&data.front(), data.size()));
+        cram::Block compressionHeader;
+        const char *slice = cram::readBlock(&data.front(), &data.back() + 1, compressionHeader);
+        CPPUNIT_ASSERT_EQUAL(header.landmarks_.at(0), int32_t(slice - &data.front()));
+        cram::Block sliceHeader;
+        cram::readBlock(slice, &data.back() + 1, sliceHeader);
+        CPPUNIT_ASSERT_EQUAL(int(cram::MAPPED_SLICE), int(sliceHeader.contentType_));
+        const std::string md5(sliceHeader.data_.end() - 16, sliceHeader.data_.end());
+
+        isaac::common::MD5Sum expected;
+        if (1 == header.refId_)
+        {
+            expected.update(chr2_.c_str() + header.start_ - 1, header.span_);
+            const isaac::common::MD5Sum::Digest digest = expected.getDigest();
+            CPPUNIT_ASSERT_EQUAL(std::string(digest.data, digest.data + 16), md5);
+            ++mapped;
+        }
+        else
+        {
+            // unmapped, or the chr1 slice that covers the reference N
+            CPPUNIT_ASSERT_EQUAL(std::string(16, 0), md5);
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(1U, mapped);
+}
+
+void TestCramEncoder::testIupacReference()
+{
+    // the fasta has an IUPAC code where the loaded reference has N
+    std::string fastaChr1 = chr1_;
+    fastaChr1[150] = 'R';
+    cram::References fastaReferences;
+    fastaReferences.push_back(cram::Reference("chr1", fastaChr1.size(), fastaChr1.c_str()));
+    fastaReferences.push_back(cram::Reference("chr2", chr2_.size(), chr2_.c_str()));
+
+    std::istringstream is(std::string(cram_.begin(), cram_.end()));
+    isaac::io::CramDecoder decoder;
+    decoder.open(cram::readFileHeader(is), fastaReferences);
+    std::vector<char> decoded;
+    cram::ContainerHeader header;
+    while (cram::readContainerHeader(is, header))
+    {
+        std::vector<char> data(header.length_);
+        CPPUNIT_ASSERT(is.read(&data.front(), data.size()));
+        if (0 == header.refId_)
+        {
+            // a checksum of the loaded bases would not match the fasta ones
+            cram::Block compressionHeader;
+            const char *slice = cram::readBlock(&data.front(), &data.back() + 1, compressionHeader);
+            cram::Block sliceHeader;
+            cram::readBlock(slice, &data.back() + 1, sliceHeader);
+            CPPUNIT_ASSERT_EQUAL(std::string(16, 0), std::string(sliceHeader.data_.end() - 16, sliceHeader.data_.end()));
+        }
+        decoder.decodeContainer(header, &data.front(), &data.back() + 1, decoded);
+    }
+    // r4 has the read base over the IUPAC position stored verbatim
+    CPPUNIT_ASSERT(bamRecords_ == decoded);
+}
+
+void TestCramEncoder::testIndex()
+{
+    const boost::filesystem::path cramPath = tempDir_ / "sorted.cram";
+    {
+        isaac::bam::CramIndex index(cramPath, cramHeaderLength_);
+        // containers arrive in pieces of whole containers
+        std::istringstream is(std::string(cram_.begin() + cramHeaderLength_, cram_.end()));
+        cram::ContainerHeader header;
+        CPPUNIT_ASSERT(cram::readContainerHeader(is, header));
+        const std::size_t firstEnd = cramHeaderLength_ + std::size_t(is.tellg()) + header.length_;
+        index.processContainers(&cram_.front() + cramHeaderLength_, &cram_.front() + firstEnd);
+        index.processContainers(&cram_.front() + firstEnd, &cram_.back() + 1);
+        index.flush();
+    }
+
+    std::ifstream file((cramPath.string() + ".crai").c_str(), std::ios_base::binary);
+    CPPUNIT_ASSERT(file);
+    bios::filtering_istream crai;
+    crai.push(bios::gzip_decompressor());
+    crai.push(file);
+
+    std::istringstream is(std::string(cram_.begin(), cram_.end()));
+    cram::readFileHeader(is);
+    cram::ContainerHeader header;
+    for (std::streamoff offset = is.tellg(); cram::readContainerHeader(is, header); offset = is.tellg())
+    {
+        const std::streamoff headerEnd = is.tellg();
+        std::ostringstream expected;
+        expected << header.refId_ << '\t' << header.start_ << '\t' << header.span_ << '\t' << offset << '\t' <<
+            header.landmarks_.at(0) << '\t' << header.length_ - header.landmarks_.at(0);
+        std::string line;
+        CPPUNIT_ASSERT(std::getline(crai, line));
+        CPPUNIT_ASSERT_EQUAL(expected.str(), line);
+
+        // the slice header block sits at the landmark
+        is.seekg(headerEnd + header.landmarks_.at(0));
+        CPPUNIT_ASSERT_EQUAL(char(cram::RAW), char(is.get()));
+        CPPUNIT_ASSERT_EQUAL(char(cram::MAPPED_SLICE), char(is.get()));
+        is.seekg(headerEnd + header.length_);
+    }
+    std::string line;
+    CPPUNIT_ASSERT(!std::getline(crai, line));
+}
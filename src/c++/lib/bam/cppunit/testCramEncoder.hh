@@ -0,0 +1,53 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BAM_TEST_CRAM_ENCODER_HH
+#define iSAAC_BAM_TEST_CRAM_ENCODER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "io/Cram.hh"
+
+class TestCramEncoder : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestCramEncoder );
+    CPPUNIT_TEST( testRoundTrip );
+    CPPUNIT_TEST( testReferenceMd5 );
+    CPPUNIT_TEST( testIupacReference );
+    CPPUNIT_TEST( testIndex );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    std::string chr1_;
+    std::string chr2_;
+    isaac::io::cram::References references_;
+    std::vector<char> bamHeader_;
+    std::vector<char> bamRecords_;
+    std::vector<char> cram_;
+    // bytes of the file definition and SAM header container
+    std::size_t cramHeaderLength_;
+public:
+    void setUp();
+    void tearDown();
+    void testRoundTrip();
+    void testReferenceMd5();
+    void testIupacReference();
+    void testIndex();
+};
+
+#endif // #ifndef iSAAC_BAM_TEST_CRAM_ENCODER_HH
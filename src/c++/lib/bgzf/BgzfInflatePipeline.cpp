@@ -0,0 +1,335 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BgzfInflatePipeline.cpp
+ **
+ ** \brief See BgzfInflatePipeline.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "bgzf/BgzfInflatePipeline.hh"
+#include "common/Debug.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace bgzf
+{
+
+BgzfInflatePipeline::BgzfInflatePipeline(
+    const unsigned inflatersCount,
+    const unsigned buffersCount,
+    const std::size_t bufferCapacity,
+    const std::size_t headroom,
+    const unsigned blocksPerBatch) :
+    bufferCapacity_(bufferCapacity),
+    blocksPerBatch_(blocksPerBatch),
+    // not initialized. Pages are committed as the data is inflated into them
+    memory_(new char[buffersCount * (headroom + bufferCapacity)]),
+    buffers_(buffersCount),
+    batches_(inflatersCount * 2 + 1),
+    inflaters_(inflatersCount, BgzfReader(0)),
+    fileBuffer_(std::ios_base::binary|std::ios_base::in),
+    is_(&fileBuffer_),
+    carryBlock_(BgzfReader::COMPRESSED_BGZF_BLOCK_SIZE),
+    carryBlockSize_(0),
+    carryUncompressedSize_(0),
+    terminate_(false),
+    reading_(false),
+    readerBusy_(false),
+    inflatersBusy_(0),
+    eof_(true),
+    fillBuffer_(0),
+    nextBuffer_(0)
+{
+    ISAAC_ASSERT_MSG(BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE <= bufferCapacity_,
+                     "Buffer must fit at least one bgzf block. Got: " << bufferCapacity_);
+    ISAAC_ASSERT_MSG(2 < buffersCount, "At least one buffer must be available to the pipeline while the client holds two");
+    ISAAC_ASSERT_MSG(inflatersCount && blocksPerBatch_, "Invalid pipeline geometry");
+
+    for (unsigned i = 0; buffersCount != i; ++i)
+    {
+        buffers_[i].data_ = memory_.get() + i * (headroom + bufferCapacity_);
+        buffers_[i].headroom_ = headroom;
+    }
+    freeBatches_.reserve(batches_.size());
+    inflateQueue_.reserve(batches_.size());
+    BOOST_FOREACH(Batch &batch, batches_)
+    {
+        batch.compressed_.resize(blocksPerBatch_ * BgzfReader::COMPRESSED_BGZF_BLOCK_SIZE);
+        freeBatches_.push_back(&batch);
+    }
+
+    threads_.create_thread(boost::bind(&BgzfInflatePipeline::readerThread, this));
+    BOOST_FOREACH(BgzfReader &inflater, inflaters_)
+    {
+        threads_.create_thread(boost::bind(&BgzfInflatePipeline::inflaterThread, this, boost::ref(inflater)));
+    }
+}
+
+BgzfInflatePipeline::~BgzfInflatePipeline()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        stop(lock);
+        terminate_ = true;
+        stateChangedCondition_.notify_all();
+    }
+    threads_.join_all();
+}
+
+void BgzfInflatePipeline::stop(boost::unique_lock<boost::mutex> &lock)
+{
+    reading_ = false;
+    freeBatches_.insert(freeBatches_.end(), inflateQueue_.begin(), inflateQueue_.end());
+    inflateQueue_.clear();
+    while (readerBusy_ || inflatersBusy_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    BOOST_FOREACH(Buffer &buffer, buffers_)
+    {
+        buffer.end_ = 0;
+        buffer.pendingBatches_ = 0;
+        buffer.sealed_ = false;
+        buffer.free_ = true;
+    }
+    carryBlockSize_ = 0;
+    fillBuffer_ = nextBuffer_ = 0;
+    eof_ = true;
+    error_ = std::exception_ptr();
+}
+
+void BgzfInflatePipeline::open(const boost::filesystem::path &filePath)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stop(lock);
+    fileBuffer_.reopen(filePath.c_str(), io::FileBufWithReopen::SequentialOnce);
+    if (!fileBuffer_.is_open())
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open bgzf file: %s") % filePath).str()));
+    }
+    is_.clear();
+    is_.rdbuf(&fileBuffer_);
+    eof_ = false;
+    reading_ = true;
+    stateChangedCondition_.notify_all();
+    ISAAC_THREAD_CERR << "Opened bgzf stream on " << filePath << std::endl;
+}
+
+BgzfInflatePipeline::Buffer *BgzfInflatePipeline::next()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Buffer &buffer = buffers_[nextBuffer_];
+    // a failed batch may belong to this buffer even if the buffer looks complete
+    while (!error_ && (buffer.free_ || !buffer.sealed_ || buffer.pendingBatches_))
+    {
+        if (eof_ && buffer.free_)
+        {
+            return 0;
+        }
+        stateChangedCondition_.wait(lock);
+    }
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+    nextBuffer_ = (nextBuffer_ + 1) % buffers_.size();
+    return &buffer;
+}
+
+void BgzfInflatePipeline::release(Buffer &buffer)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(!buffer.free_ && buffer.sealed_, "Attempt to release a buffer not held by the client");
+    buffer.free_ = true;
+    stateChangedCondition_.notify_all();
+}
+
+/**
+ * \brief Reads up to blocksPerBatch_ blocks that fit into bufferBytesLeft. The block that does not fit is kept in
+ *        carryBlock_ for the next buffer.
+ *
+ * \return number of uncompressed bytes in the batch
+ */
+std::size_t BgzfInflatePipeline::readBatch(Batch &batch, const std::size_t bufferBytesLeft, bool &bufferFull)
+{
+    batch.compressedSize_ = 0;
+    batch.uncompressedSize_ = 0;
+    unsigned blocks = 0;
+    if (carryBlockSize_)
+    {
+        if (carryUncompressedSize_ > bufferBytesLeft)
+        {
+            bufferFull = true;
+            return 0;
+        }
+        std::copy(carryBlock_.begin(), carryBlock_.begin() + carryBlockSize_, batch.compressed_.begin());
+        batch.compressedSize_ = carryBlockSize_;
+        batch.uncompressedSize_ = carryUncompressedSize_;
+        carryBlockSize_ = 0;
+        ++blocks;
+    }
+
+    while (blocksPerBatch_ != blocks)
+    {
+        char *block = &batch.compressed_.front() + batch.compressedSize_;
+        unsigned uncompressedSize = 0;
+        const std::size_t blockSize = BgzfReader::readBlock(is_, block, uncompressedSize);
+        if (!blockSize)
+        {
+            break;
+        }
+        // empty blocks such as the end of file marker have nothing to inflate
+        if (uncompressedSize)
+        {
+            if (batch.uncompressedSize_ + uncompressedSize > bufferBytesLeft)
+            {
+                std::copy(block, block + blockSize, carryBlock_.begin());
+                carryBlockSize_ = blockSize;
+                carryUncompressedSize_ = uncompressedSize;
+                bufferFull = true;
+                break;
+            }
+            batch.compressedSize_ += blockSize;
+            batch.uncompressedSize_ += uncompressedSize;
+            ++blocks;
+        }
+    }
+    return batch.uncompressedSize_;
+}
+
+void BgzfInflatePipeline::readerThread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        Buffer &buffer = buffers_[fillBuffer_];
+        if (!reading_ || freeBatches_.empty() || (!buffer.free_ && buffer.sealed_))
+        {
+            // nothing to read, no batch to read into or the client has not released the buffer yet
+            stateChangedCondition_.wait(lock);
+            continue;
+        }
+        if (buffer.free_)
+        {
+            buffer.free_ = false;
+            buffer.sealed_ = false;
+            buffer.end_ = 0;
+        }
+
+        Batch &batch = *freeBatches_.back();
+        freeBatches_.pop_back();
+        bool bufferFull = false;
+        std::exception_ptr error;
+        readerBusy_ = true;
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            try
+            {
+                readBatch(batch, bufferCapacity_ - buffer.end_, bufferFull);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        readerBusy_ = false;
+
+        if (error)
+        {
+            error_ = error;
+            reading_ = false;
+        }
+
+        if (reading_ && batch.uncompressedSize_)
+        {
+            batch.buffer_ = &buffer;
+            batch.offset_ = buffer.end_;
+            buffer.end_ += batch.uncompressedSize_;
+            ++buffer.pendingBatches_;
+            inflateQueue_.push_back(&batch);
+        }
+        else
+        {
+            freeBatches_.push_back(&batch);
+        }
+
+        if (reading_)
+        {
+            const bool eof = !carryBlockSize_ && is_.eof();
+            if (bufferFull || eof)
+            {
+                if (buffer.end_)
+                {
+                    buffer.sealed_ = true;
+                    fillBuffer_ = (fillBuffer_ + 1) % buffers_.size();
+                }
+                else
+                {
+                    buffer.free_ = true;
+                }
+            }
+            if (eof)
+            {
+                eof_ = true;
+                reading_ = false;
+            }
+        }
+        stateChangedCondition_.notify_all();
+    }
+}
+
+void BgzfInflatePipeline::inflaterThread(BgzfReader &inflater)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        if (inflateQueue_.empty())
+        {
+            stateChangedCondition_.wait(lock);
+            continue;
+        }
+        Batch &batch = *inflateQueue_.front();
+        inflateQueue_.erase(inflateQueue_.begin());
+        std::exception_ptr error;
+        ++inflatersBusy_;
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            try
+            {
+                inflater.uncompress(&batch.compressed_.front(), batch.compressedSize_,
+                                    batch.buffer_->begin() + batch.offset_, batch.uncompressedSize_);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        --inflatersBusy_;
+        if (error && !error_)
+        {
+            error_ = error;
+            reading_ = false;
+        }
+        --batch.buffer_->pendingBatches_;
+        freeBatches_.push_back(&batch);
+        stateChangedCondition_.notify_all();
+    }
+}
+
+} // namespace bgzf
+} // namespace isaac
@@ -49,6 +49,39 @@ inline bool isValidHeader(const bgzf::Header &header)
         header.xfield.SI1 == 66U && header.xfield.SI2 == 67U;
 }
 
+std::size_t BgzfReader::readBlock(std::istream &is, char *block, unsigned &uncompressedSize)
+{
+    is.read(block, sizeof(bgzf::Header));
+    if (is.eof())
+    {
+        ISAAC_ASSERT_MSG(!is.gcount(), "BgzfReader::readBlock EOF while reading bgzf header");
+        return 0;
+    }
+    if (!is)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read bgzf file header: %s") %
+            strerror(errno)).str()));
+    }
+    const bgzf::Header &header = *reinterpret_cast<const bgzf::Header *>(block);
+    validateHeader(header);
+
+    const std::size_t ret = sizeof(bgzf::Header) + header.getCDATASize() + sizeof(bgzf::Footer);
+    ISAAC_ASSERT_MSG(COMPRESSED_BGZF_BLOCK_SIZE >= ret, "bgzf block is too big: " << ret);
+    if (!is.read(block + sizeof(bgzf::Header), header.getCDATASize() + sizeof(bgzf::Footer)))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes of bgzf CDATA : %s") %
+            header.getCDATASize() % strerror(errno)).str()));
+    }
+
+    uncompressedSize = 0;
+    if (header.getCDATASize())
+    {
+        const bgzf::Footer &footer = *reinterpret_cast<const bgzf::Footer*>(block + ret - sizeof(bgzf::Footer));
+        uncompressedSize = footer.getISIZE();
+    }
+    return ret;
+}
+
 unsigned BgzfReader::readNextBlock(std::istream &is)
 {
     compressedBlockBuffer_.clear();
@@ -56,37 +89,16 @@ unsigned BgzfReader::readNextBlock(std::istream &is)
     unsigned ret = 0;
     for (unsigned i = 0; i < blocksAtOnce_; ++i)
     {
-        compressedBlockBuffer_.resize(compressedBlockBuffer_.size() + sizeof(bgzf::Header));
-        is.read(&compressedBlockBuffer_.front() + compressedBlockBuffer_.size() - sizeof(bgzf::Header), sizeof(bgzf::Header));
-        if (is.eof())
+        const std::size_t oldSize = compressedBlockBuffer_.size();
+        compressedBlockBuffer_.resize(oldSize + COMPRESSED_BGZF_BLOCK_SIZE);
+        unsigned uncompressedSize = 0;
+        const std::size_t blockSize = readBlock(is, &compressedBlockBuffer_.front() + oldSize, uncompressedSize);
+        compressedBlockBuffer_.resize(oldSize + blockSize);
+        if (!blockSize)
         {
-            ISAAC_ASSERT_MSG(!is.gcount(), "BgzfReader::readNextBlock EOF while reading bgzf header");
             break;
         }
-        if (!is)
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read bgzf file header: %s") %
-                strerror(errno)).str()));
-        }
-        const bgzf::Header &header = *reinterpret_cast<bgzf::Header *>(
-            &compressedBlockBuffer_.front() + compressedBlockBuffer_.size() - sizeof(bgzf::Header));
-        validateHeader(header);
-
-        compressedBlockBuffer_.resize(compressedBlockBuffer_.size() + header.getCDATASize() + sizeof(bgzf::Footer));
-        if (!is.read(&compressedBlockBuffer_.front() + compressedBlockBuffer_.size() - header.getCDATASize() - sizeof(bgzf::Footer), header.getCDATASize() + sizeof(bgzf::Footer)))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to read %d bytes of bgzf CDATA : %s") %
-                header.getCDATASize() % strerror(errno)).str()));
-        }
-    //    ISAAC_THREAD_CERR << "header.getCDATASize() " << header.getCDATASize() << " bytes" << std::endl;
-
-        if (header.getCDATASize())
-        {
-            const bgzf::Footer &footer = *reinterpret_cast<bgzf::Footer*>(
-                &compressedBlockBuffer_.front() + compressedBlockBuffer_.size() - sizeof(bgzf::Footer));
-    //        ISAAC_ASSERT_MSG(footer.getISIZE(), "Unexpected ISIZE 0 for CDATA size " << header.getCDATASize());
-            ret += footer.getISIZE();
-        }
+        ret += uncompressedSize;
     }
 
     return ret;
@@ -117,8 +129,13 @@ bool BgzfReader::isBgzfCompressed(std::istream &is)
 
 void BgzfReader::uncompressCurrentBlock(char* p, std::size_t size)
 {
-    strm_.next_in = reinterpret_cast<Bytef *>(&compressedBlockBuffer_.front());
-    strm_.avail_in = compressedBlockBuffer_.size();
+    uncompress(&compressedBlockBuffer_.front(), compressedBlockBuffer_.size(), p, size);
+}
+
+void BgzfReader::uncompress(const char *compressed, const std::size_t compressedSize, char* p, const std::size_t size)
+{
+    strm_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed));
+    strm_.avail_in = compressedSize;
     strm_.next_out = reinterpret_cast<Bytef *>(p);
     strm_.avail_out = size;
     while (strm_.avail_out)
@@ -53,6 +53,32 @@ void verifyFragmentIntegrity(const io::FragmentAccessor &fragment)
 */
 }
 
+void BinLoader::open(const alignment::BinMetadata &bin, const uint64_t bytes)
+{
+    const io::MemoryFileStore::File *file = io::MemoryFileStore::instance().find(bin.getPathString());
+    inMemory_ = file;
+    if (inMemory_)
+    {
+        memoryReader_.open(*file, bin.getDataOffset(), bytes);
+    }
+    else
+    {
+        reader_.open(bin.getPath().c_str(), bin.getDataOffset(), bytes);
+    }
+}
+
+void BinLoader::close()
+{
+    if (inMemory_)
+    {
+        memoryReader_.close();
+    }
+    else
+    {
+        reader_.close();
+    }
+}
+
 void BinLoader::loadData(BinData &binData)
 {
     ISAAC_THREAD_CERR << "Loading unsorted data" << std::endl;
@@ -67,7 +93,18 @@ void BinLoader::loadData(BinData &binData)
         loadAlignedData(binData);
     }
 
-    ISAAC_THREAD_CERR << "Loading unsorted data done in " << (clock() - startLoad) / 1000 << "ms" << std::endl;
+    if (inMemory_)
+    {
+        ISAAC_THREAD_CERR << "Loading unsorted data done in " << (clock() - startLoad) / 1000 << "ms from memory for " <<
+            binData.bin_.getPath().c_str() << std::endl;
+        return;
+    }
+    const io::AsyncFileReader::Counters &counters = reader_.getCounters();
+    ISAAC_THREAD_CERR << "Loading unsorted data done in " << (clock() - startLoad) / 1000 << "ms. Read " <<
+        counters.bytes_ << " bytes in " << counters.readMicroseconds_ / 1000 << "ms (" <<
+        (counters.readMicroseconds_ ? counters.bytes_ / counters.readMicroseconds_ : 0) << "MB/s" <<
+        (counters.direct_ ? ", direct" : "") << "), waited " << counters.waitMicroseconds_ / 1000 << "ms for " <<
+        binData.bin_.getPath().c_str() << std::endl;
 }
 
 void BinLoader::loadUnalignedData(BinData &binData)
@@ -75,22 +112,14 @@ void BinLoader::loadUnalignedData(BinData &binData)
     if(binData.bin_.getDataSize())
     {
         ISAAC_THREAD_CERR << "Reading unaligned records from " << binData.bin_ << std::endl;
-        std::istream isData(&binData.inputFileBuf_);
-        if (!isData) {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open " + binData.bin_.getPathString()));
-        }
-
-        if (!isData.seekg(binData.bin_.getDataOffset(), std::ios_base::beg))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(
-                errno, (boost::format("Failed to seek to position %d in %s") % binData.bin_.getDataOffset() % binData.bin_.getPathString()).str()));
-        }
+        open(binData.bin_, binData.bin_.getDataSize());
         // TODO: this takes time to fill it up with 0... 2 seconds per bin easily
         binData.data_.resize(binData.bin_);
-        if (!isData.read(&binData.data_.front(), binData.bin_.getDataSize())) {
+        if (binData.bin_.getDataSize() != read(&binData.data_.front(), binData.bin_.getDataSize())) {
             BOOST_THROW_EXCEPTION(common::IoException(
                 errno, (boost::format("Failed to read %d bytes from %s") % binData.bin_.getDataSize() % binData.bin_.getPathString()).str()));
         }
+        close();
 
 /*
         unsigned count = 0;
@@ -114,13 +143,14 @@ void BinLoader::loadUnalignedData(BinData &binData)
 }
 
 
-std::size_t BinLoader::loadFragment(BinData &binData, std::istream &isData)
+std::size_t BinLoader::loadFragment(BinData &binData)
 {
     std::size_t offset = 0;
     io::FragmentHeader header;
-    if (!isData.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    const std::size_t headerBytes = read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (sizeof(header) != headerBytes)
     {
-        if (isData.eof())
+        if (!headerBytes)
         {
             return INVALID_OFFSET;
         }
@@ -129,7 +159,7 @@ std::size_t BinLoader::loadFragment(BinData &binData, std::istream &isData)
     }
 
     ISAAC_ASSERT_MSG(header.flags_.initialized_, "Uninitialized header read from " << binData.bin_ <<
-                     " isData.tellg() " << isData.tellg() <<
+                     " tell() " << tell() <<
                      " offset " << offset <<
                      " " << header);
 
@@ -141,7 +171,7 @@ std::size_t BinLoader::loadFragment(BinData &binData, std::istream &isData)
 //    binData.data_.resize(std::max(binData.data_.size(), offset + fragmentLength));
     ISAAC_ASSERT_MSG(binData.data_.capacity() >= offset + fragmentLength,
                      "Insufficient buffer " << binData.bin_ <<
-                     " isData.tellg() " << isData.tellg() <<
+                     " tell() " << tell() <<
                      " offset " << offset <<
                      " fragmentLength " << fragmentLength <<
                      " " << header);
@@ -150,7 +180,7 @@ std::size_t BinLoader::loadFragment(BinData &binData, std::istream &isData)
     io::FragmentAccessor &fragment = binData.data_.getFragment(offset);
     io::FragmentHeader &headerRef = fragment;
     headerRef = header;
-    if (!isData.read(reinterpret_cast<char*>(&fragment) + sizeof(header), fragmentLength - sizeof(header))) {
+    if (fragmentLength - sizeof(header) != read(reinterpret_cast<char*>(&fragment) + sizeof(header), fragmentLength - sizeof(header))) {
         BOOST_THROW_EXCEPTION(common::IoException(
             errno, (boost::format("Failed to read %d bytes from %s") % fragmentLength % binData.bin_.getPathString()).str()));
     }
@@ -174,7 +204,9 @@ void BinLoader::storeFragmentIndex(
                               fragment.flags_.mateReverse_,
                               fragment.mateStorageBin_,
                               fragment.mateAnchor_),
-            fragment.duplicateClusterRank_);
+            fragment.duplicateClusterRank_,
+            fragment.barcode_,
+            getGlobalClusterId(fragment));
         rsIdx.dataOffset_ = offset;
         rsIdx.mateDataOffset_ = mateOffset;
         binData.rIdx_.push_back(rsIdx);
@@ -187,7 +219,9 @@ void BinLoader::storeFragmentIndex(
                               fragment.flags_.mateReverse_,
                               fragment.mateStorageBin_,
                               fragment.mateAnchor_),
-            fragment.duplicateClusterRank_);
+            fragment.duplicateClusterRank_,
+            fragment.barcode_,
+            getGlobalClusterId(fragment));
         fIdx.dataOffset_ = offset;
         fIdx.mateDataOffset_ = mateOffset;
         binData.fIdx_.push_back(fIdx);
@@ -223,16 +257,9 @@ void BinLoader::loadAlignedData(BinData &binData)
     {
         ISAAC_THREAD_CERR << "Reading alignment records from " << binData.bin_ << std::endl;
         uint64_t dataSize = 0;
-        std::istream isData(&binData.inputFileBuf_);
-        if (!isData) {
-            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open " + binData.bin_.getPathString()));
-        }
         ISAAC_ASSERT_MSG(0 == binData.bin_.getDataOffset(), "Unexpected offset:" << binData.bin_);
-        if (!isData.seekg(binData.bin_.getDataOffset()))
-        {
-            BOOST_THROW_EXCEPTION(common::IoException(
-                errno, (boost::format("Failed to seek to position %d in %s") % binData.bin_.getDataOffset() % binData.bin_.getPathString()).str()));
-        }
+        // multiple bins can share the file. Read it all and skip what does not belong
+        open(binData.bin_, io::AsyncFileReader::UNTIL_EOF);
 
         binData.rIdx_.clear();
         binData.fIdx_.clear();
@@ -240,9 +267,9 @@ void BinLoader::loadAlignedData(BinData &binData)
 
         io::FragmentHeader lastFragmentHeader;
         io::FragmentHeader lastMateHeader;
-        for(std::size_t offset = loadFragment(binData, isData);
+        for(std::size_t offset = loadFragment(binData);
             INVALID_OFFSET != offset;
-            offset = loadFragment(binData, isData))
+            offset = loadFragment(binData))
         {
             const io::FragmentAccessor &fragment = binData.data_.getFragment(offset);
 
@@ -267,7 +294,7 @@ void BinLoader::loadAlignedData(BinData &binData)
             }
             else
             {
-                const std::size_t mateOffset = loadFragment(binData, isData);
+                const std::size_t mateOffset = loadFragment(binData);
 
                 ISAAC_ASSERT_MSG(INVALID_OFFSET != mateOffset, "Paired data is missing a mate in " << binData.bin_ << " fragment " << fragment);
                 const io::FragmentAccessor &mateFragment = binData.data_.getFragment(mateOffset);
@@ -305,6 +332,7 @@ void BinLoader::loadAlignedData(BinData &binData)
             // otherwise the fragment is not relevant, revert buffer back to before loading it
             binData.data_.resize(offset);
         }
+        close();
         ISAAC_THREAD_CERR << "Reading alignment records done from " << binData.bin_ << std::endl;
 
         ISAAC_ASSERT_MSG(binData.bin_.getDataSize() >= dataSize, "Too much data seen:" << dataSize << " for " << binData.bin_);
@@ -0,0 +1,88 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BinSaveCursors.cpp
+ **
+ ** \brief Tracks the next bin to be written into each Build output file.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+
+#include "build/BinSaveCursors.hh"
+#include "common/Debug.hh"
+#include "common/Threads.hpp"
+
+namespace isaac
+{
+namespace build
+{
+
+BinSaveCursors::BinSaveCursors(
+    const std::size_t fileCount,
+    const BinIterator binsBegin,
+    const BinIterator binsEnd) :
+    binsEnd_(binsEnd),
+    nextUnsavedBinIts_(fileCount, binsBegin)
+{
+}
+
+std::size_t BinSaveCursors::findReady(const BinIterator binIt, const std::vector<bool> &savedFiles) const
+{
+    ISAAC_ASSERT_MSG(savedFiles.size() == nextUnsavedBinIts_.size(), "Saved flags don't match the number of output files");
+    for (std::size_t fileIndex = 0; fileIndex < nextUnsavedBinIts_.size(); ++fileIndex)
+    {
+        if (!savedFiles[fileIndex] && binIt == nextUnsavedBinIts_[fileIndex])
+        {
+            return fileIndex;
+        }
+    }
+    return nextUnsavedBinIts_.size();
+}
+
+std::size_t BinSaveCursors::waitForSlot(
+    boost::unique_lock<boost::mutex> &lock,
+    boost::condition_variable &stateChangedCondition,
+    const bool &forceTermination,
+    const BinIterator binIt,
+    const std::vector<bool> &savedFiles) const
+{
+    while(true)
+    {
+        if (forceTermination)
+        {
+            BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
+        }
+        const std::size_t fileIndex = findReady(binIt, savedFiles);
+        if (nextUnsavedBinIts_.size() != fileIndex)
+        {
+            return fileIndex;
+        }
+        stateChangedCondition.wait(lock);
+    }
+}
+
+void BinSaveCursors::returnSlot(const std::size_t fileIndex, const BinIterator binsEndIt)
+{
+    nextUnsavedBinIts_.at(fileIndex) = binsEndIt;
+}
+
+bool BinSaveCursors::allSaved() const
+{
+    return nextUnsavedBinIts_.end() == std::find_if(
+        nextUnsavedBinIts_.begin(), nextUnsavedBinIts_.end(),
+        [this](const BinIterator it){return binsEnd_ != it;});
+}
+
+} // namespace build
+} // namespace isaac
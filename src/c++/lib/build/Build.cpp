@@ -26,17 +26,20 @@
  
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
+#include <boost/function.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/numeric/conversion/cast.hpp>
 #include <boost/regex.hpp>
 
 #include "bam/Bam.hh"
 #include "bam/BamIndexer.hh"
+#include "bam/CramEncoder.hh"
 #include "bgzf/BgzfCompressor.hh"
 #include "build/Build.hh"
 #include "build/IndelLoader.hh"
 #include "common/Debug.hh"
 #include "common/FileSystem.hh"
+#include "common/SystemCompatibility.hh"
 #include "common/Threads.hpp"
 #include "io/Fragment.hh"
 #include "reference/ContigLoader.hh"
@@ -87,8 +90,12 @@ uint64_t Build::estimateBinCompressedDataRequirements(
         }
     }
 
+    // cram containers are emitted at least every RECORDS_PER_CONTAINER records and each brings its own headers
+    const uint64_t containersOverhead = OUTPUT_CRAM == outputFormat_ ?
+        (thisOutputFileBarcodeElements / bam::CramEncoder::RECORDS_PER_CONTAINER + 1) * bam::CramEncoder::CONTAINER_OVERHEAD : 0;
+
     // assume all data will take the same fraction or less than the number derived from demultiplexed fragments.
-    return EMPTY_BGZF_BLOCK_SIZE +
+    return EMPTY_BGZF_BLOCK_SIZE + containersOverhead +
         ((getBinTotalSize(binMetadata) * thisOutputFileBarcodeElements +
             binMetadata.getTotalElements() - 1) / binMetadata.getTotalElements()) * expectedBgzfCompressionRatio_;
 }
@@ -101,10 +108,51 @@ inline bool orderBySampleIndex(
     return barcodeBamMapping.getSampleIndex(left.getIndex()) < barcodeBamMapping.getSampleIndex(right.getIndex());
 }
 
+/**
+ * \brief Collects the contigs of each output file in the order in which they appear in the bam header, so that
+ *        the cram encoder can find the reference bases by bam refId.
+ */
+std::vector<io::cram::References> Build::createCramReferences(
+    const flowcell::BarcodeMetadataList &barcodeMetadataList) const
+{
+    std::vector<io::cram::References> ret(barcodeBamMapping_.getTotalSamples());
+    if (OUTPUT_CRAM != outputFormat_)
+    {
+        return ret;
+    }
+
+    BOOST_FOREACH(const flowcell::BarcodeMetadata &barcode, barcodeMetadataList)
+    {
+        io::cram::References &references = ret.at(barcodeBamMapping_.getSampleIndex(barcode.getIndex()));
+        if (barcode.isUnmappedReference() || !references.empty())
+        {
+            continue;
+        }
+        const unsigned referenceIndex = barcode.getReferenceIndex();
+        const reference::ContigList &contigList = contigLists_.at(referenceIndex);
+        for (unsigned contigId = 0; contigList.size() != contigId; ++contigId)
+        {
+            if (contigMap_.isMapped(referenceIndex, contigId))
+            {
+                const reference::Contig &contig = contigList.at(contigId);
+                const unsigned refId = contigMap_.getMappedContigIndex(referenceIndex, contigId);
+                if (references.size() <= refId)
+                {
+                    references.resize(refId + 1, io::cram::Reference("", 0, 0));
+                }
+                references.at(refId) = io::cram::Reference(
+                    contig.getName(), contig.size(), contig.empty() ? 0 : &*contig.begin());
+            }
+        }
+    }
+    return ret;
+}
+
 std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > Build::createOutputFileStreams(
     const flowcell::TileMetadataList &tileMetadataList,
     const flowcell::BarcodeMetadataList &barcodeMetadataList,
-    boost::ptr_vector<bam::BamIndex> &bamIndexes) const
+    boost::ptr_vector<bam::BamIndex> &bamIndexes,
+    boost::ptr_vector<bam::CramIndex> &cramIndexes) const
 {
     unsigned sinkIndexToCreate = 0;
     std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > ret;
@@ -122,7 +170,7 @@ std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > Build::crea
             const boost::filesystem::path &bamPath = barcodeBamMapping_.getFilePath(barcode);
             if (!barcode.isUnmappedReference())
             {
-                ISAAC_THREAD_CERR << "Created BAM file: " << bamPath << std::endl;
+                ISAAC_THREAD_CERR << "Created " << (OUTPUT_CRAM == outputFormat_ ? "CRAM" : "BAM") << " file: " << bamPath << std::endl;
 
                 const reference::SortedReferenceMetadata &sampleReference =
                     sortedReferenceMetadataList_.at(barcode.getReferenceIndex());
@@ -131,7 +179,16 @@ std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > Build::crea
                 {
                     std::ostringstream oss(compressedHeader);
                     boost::iostreams::filtering_ostream bgzfStream;
-                    bgzfStream.push(bgzf::BgzfCompressor(bamGzipLevel_),65535,0);
+                    if (OUTPUT_CRAM == outputFormat_)
+                    {
+                        const io::cram::References &references =
+                            cramReferences_.at(barcodeBamMapping_.getSampleIndex(barcode.getIndex()));
+                        bgzfStream.push(bam::CramEncoder(references, bamGzipLevel_),65535,0);
+                    }
+                    else
+                    {
+                        bgzfStream.push(bgzf::BgzfCompressor(bamGzipLevel_),65535,0);
+                    }
                     bgzfStream.push(oss);
                     bam::serializeHeader(bgzfStream,
                                          argv_,
@@ -169,16 +226,34 @@ std::vector<boost::shared_ptr<boost::iostreams::filtering_ostream> > Build::crea
                             compressedHeader.size() % bamPath.string()).str()));
                 }
 
-                // Create BAM Indexer
-                unsigned headerCompressedLength = compressedHeader.size();
-                unsigned contigCount = sampleReference.getFilteredContigsCount(
-                    boost::bind(&BuildContigMap::isMapped, &contigMap_, barcode.getReferenceIndex(), _1));
-                bamIndexes.push_back(new bam::BamIndex(bamPath, contigCount, headerCompressedLength));
+                if (OUTPUT_CRAM == outputFormat_)
+                {
+                    // bai does not apply to cram
+                    bamIndexes.push_back(new bam::BamIndex());
+                    cramIndexes.push_back(new bam::CramIndex(bamPath, compressedHeader.size()));
+                }
+                else
+                {
+                    cramIndexes.push_back(new bam::CramIndex());
+                    // Create BAM Indexer
+                    unsigned headerCompressedLength = compressedHeader.size();
+                    const boost::function<bool(unsigned)> isMapped =
+                        boost::bind(&BuildContigMap::isMapped, &contigMap_, barcode.getReferenceIndex(), _1);
+                    const reference::SortedReferenceMetadata::Contigs contigs = sampleReference.getFilteredContigs(isMapped);
+                    uint64_t maxContigLength = 0;
+                    BOOST_FOREACH(const reference::SortedReferenceMetadata::Contig &contig, contigs)
+                    {
+                        maxContigLength = std::max(maxContigLength, contig.totalBases_);
+                    }
+                    bamIndexes.push_back(new bam::BamIndex(bamPath, contigs.size(), headerCompressedLength,
+                                                           bamIndexFormat_, csiMinShift_, maxContigLength));
+                }
             }
             else
             {
                 ret.push_back(boost::shared_ptr<boost::iostreams::filtering_ostream>());
                 bamIndexes.push_back(new bam::BamIndex());
+                cramIndexes.push_back(new bam::CramIndex());
                 ISAAC_THREAD_CERR << "Skipped BAM file due to unmapped barcode reference: " << bamPath << " " << barcode << std::endl;
             }
             ++sinkIndexToCreate;
@@ -298,10 +373,15 @@ Build::Build(const std::vector<std::string> &argv,
              const unsigned maxLoaders,
              const unsigned maxComputers,
              const unsigned maxSavers,
+             const bool adaptiveConcurrency,
+             const bool directIo,
              const build::GapRealignerMode realignGaps,
              const unsigned realignMapqMin,
              const boost::filesystem::path &knownIndelsPath,
              const int bamGzipLevel,
+             const OutputFormat outputFormat,
+             const unsigned bamIndexFormat,
+             const unsigned csiMinShift,
              const std::string &bamPuFormat,
              const bool bamProduceMd5,
              const std::vector<std::string> &bamHeaderTags,
@@ -340,6 +420,9 @@ Build::Build(const std::vector<std::string> &argv,
      allocatedBins_(0),
      maxSavers_(maxSavers),
      bamGzipLevel_(bamGzipLevel),
+     outputFormat_(outputFormat),
+     bamIndexFormat_(bamIndexFormat),
+     csiMinShift_(csiMinShift),
      bamPuFormat_(bamPuFormat),
      bamProduceMd5_(bamProduceMd5),
      bamHeaderTags_(bamHeaderTags),
@@ -359,11 +442,16 @@ Build::Build(const std::vector<std::string> &argv,
      includeTags_(includeTags),
      pessimisticMapQ_(pessimisticMapQ),
      forceTermination_(false),
+     startTime_(std::chrono::steady_clock::now()),
+     concurrencyBalancer_(adaptiveConcurrency, maxLoaders_, maxComputers_),
      threads_(maxComputers_ + maxLoaders_ + maxSavers_),
      contigLists_(contigLists),
-     barcodeBamMapping_(demultiplexing::mapBarcodesToFiles(outputDirectory_, barcodeMetadataList_, "sorted.bam")),
+     barcodeBamMapping_(demultiplexing::mapBarcodesToFiles(
+         outputDirectory_, barcodeMetadataList_, OUTPUT_CRAM == outputFormat_ ? "sorted.cram" : "sorted.bam")),
+     cramReferences_(createCramReferences(barcodeMetadataList_)),
      bamIndexes_(),
-     bamFileStreams_(createOutputFileStreams(tileMetadataList_, barcodeMetadataList_, bamIndexes_)),
+     cramIndexes_(),
+     bamFileStreams_(createOutputFileStreams(tileMetadataList_, barcodeMetadataList_, bamIndexes_, cramIndexes_)),
      stats_(binRefs_, barcodeMetadataList_),
      threadBgzfBuffers_(threads_.size(), BgzfBuffers(bamFileStreams_.size())),
      threadBgzfStreams_(threads_.size()),
@@ -389,6 +477,20 @@ Build::Build(const std::vector<std::string> &argv,
     {
         threadBamIndexParts_.push_back(new boost::ptr_vector<bam::BamIndexPart>(bamFileStreams_.size()));
     }
+    while(threadBinMemory_.size() < threads_.size())
+    {
+        threadBinMemory_.push_back(new common::MemoryReservation(common::MemoryBudget::BuildBins));
+        threadBgzfMemory_.push_back(new common::MemoryReservation(common::MemoryBudget::Bgzf));
+    }
+    // concurrencyBalancer_ can give all but one compute slot to loading
+    const std::size_t binReaders = std::min<std::size_t>(
+        threads_.size(), concurrencyBalancer_.isEnabled() ? maxLoaders_ + maxComputers_ - 1 : maxLoaders_);
+    freeBinReaders_.reserve(binReaders);
+    while(binReaders_.size() < binReaders)
+    {
+        binReaders_.push_back(new io::AsyncFileReader(directIo));
+        freeBinReaders_.push_back(&binReaders_.back());
+    }
 
     threads_.execute(boost::bind(&Build::allocateThreadData, this, _1));
 
@@ -416,16 +518,26 @@ void Build::run(common::ScopedMallocBlock &mallocBlock)
     alignment::BinMetadataCRefList::iterator nextUnprocessedBinIt(binRefs_.begin());
     alignment::BinMetadataCRefList::const_iterator nextUnallocatedBinIt(binRefs_.begin());
     alignment::BinMetadataCRefList::const_iterator nextUnloadedBinIt(binRefs_.begin());
-    alignment::BinMetadataCRefList::const_iterator nextUnsavedBinIt(binRefs_.begin());
+    // each output file receives the bins in order, but the files don't wait for each other
+    BinSaveCursors saveCursors(bamFileStreams_.size(), binRefs_.begin(), binRefs_.end());
+
+    stats_.addConcurrencyChange(ConcurrencyChange(
+        getElapsedMicroseconds(), maxLoaders_, maxComputers_, 0, concurrencyBalancer_.getLastReason()));
 
     threads_.execute(boost::bind(&Build::sortBinParallel, this,
                                 boost::ref(nextUnprocessedBinIt),
                                 boost::ref(nextUnallocatedBinIt),
                                 boost::ref(nextUnloadedBinIt),
-                                boost::ref(nextUnsavedBinIt),
+                                boost::ref(saveCursors),
                                 boost::ref(mallocBlock),
                                 _1));
 
+    if (REALIGN_NONE != realignGaps_)
+    {
+        ISAAC_THREAD_CERR << "Gap choice evaluations reused: " << gapRealigner_.getGapChoiceCacheHits() <<
+            " computed: " << gapRealigner_.getGapChoiceCacheMisses() << std::endl;
+    }
+
     unsigned fileIndex = 0;
     BOOST_FOREACH(const boost::filesystem::path &bamFilePath, barcodeBamMapping_.getPaths())
     {
@@ -434,11 +546,22 @@ void Build::run(common::ScopedMallocBlock &mallocBlock)
         std::ostream *stm = bamFileStreams_.at(fileIndex).get();
         if (stm)
         {
-            bam::serializeBgzfFooter(*stm);
-            stm->flush();
-            ISAAC_THREAD_CERR << "BAM file generated: " << bamFilePath.c_str() << "\n";
-            bamIndexes_.at(fileIndex).flush();
-            ISAAC_THREAD_CERR << "BAM index generated for " << bamFilePath.c_str() << "\n";
+            if (OUTPUT_CRAM == outputFormat_)
+            {
+                bam::serializeCramFooter(*stm);
+                stm->flush();
+                ISAAC_THREAD_CERR << "CRAM file generated: " << bamFilePath.c_str() << "\n";
+                cramIndexes_.at(fileIndex).flush();
+                ISAAC_THREAD_CERR << "CRAM index generated for " << bamFilePath.c_str() << "\n";
+            }
+            else
+            {
+                bam::serializeBgzfFooter(*stm);
+                stm->flush();
+                ISAAC_THREAD_CERR << "BAM file generated: " << bamFilePath.c_str() << "\n";
+                bamIndexes_.at(fileIndex).flush();
+                ISAAC_THREAD_CERR << "BAM index generated for " << bamFilePath.c_str() << "\n";
+            }
         }
         ++fileIndex;
     }
@@ -509,9 +632,28 @@ void Build::reserveBuffers(
     const unsigned binStatsIndex = std::distance<alignment::BinMetadataCRefList::const_iterator>(binRefs_.begin(), thisThreadBinIt);
     common::ScopedMallocBlockUnblock unblockMalloc(mallocBlock);
     ISAAC_TRACE_STAT("Before allocating data for " << bin);
-    reserveBuffers(
-        bin, binStatsIndex, contigLists_, bgzfStreams, bamIndexParts,
-        threadBgzfBuffers_.at(threadNumber), binDataPtr);
+    // take the budget first. MemoryException is a bad_alloc and the bin waits for others to release memory
+    common::MemoryReservation &binMemory = threadBinMemory_.at(threadNumber);
+    common::MemoryReservation &bgzfMemory = threadBgzfMemory_.at(threadNumber);
+    try
+    {
+        binMemory.resize(BinData::getMemoryRequirements(bin));
+        uint64_t bgzfBytes = 0;
+        for (unsigned outputFileIndex = 0; outputFileIndex < bamFileStreams_.size(); ++outputFileIndex)
+        {
+            bgzfBytes += estimateBinCompressedDataRequirements(bin, outputFileIndex);
+        }
+        bgzfMemory.resize(bgzfBytes);
+        reserveBuffers(
+            bin, binStatsIndex, contigLists_, bgzfStreams, bamIndexParts,
+            threadBgzfBuffers_.at(threadNumber), binDataPtr);
+    }
+    catch (...)
+    {
+        binMemory.release();
+        bgzfMemory.release();
+        throw;
+    }
     ISAAC_TRACE_STAT("After  allocating data for " << bin);
 }
 
@@ -566,7 +708,14 @@ void Build::reserveBuffers(
         while(bgzfStreams.size() < bamFileStreams_.size())
         {
             bgzfStreams.push_back(new boost::iostreams::filtering_ostream);
-            bgzfStreams.back().push(bgzf::BgzfCompressor(bamGzipLevel_), 65535, 0);
+            if (OUTPUT_CRAM == outputFormat_)
+            {
+                bgzfStreams.back().push(bam::CramEncoder(cramReferences_.at(bgzfStreams.size()-1), bamGzipLevel_), 65535, 0);
+            }
+            else
+            {
+                bgzfStreams.back().push(bgzf::BgzfCompressor(bamGzipLevel_), 65535, 0);
+            }
             bgzfStreams.back().push(
                 boost::iostreams::back_insert_device<bam::BgzfBuffer >(
                     bgzfBuffers.at(bgzfStreams.size()-1)));
@@ -576,7 +725,7 @@ void Build::reserveBuffers(
         ISAAC_ASSERT_MSG(!bamIndexParts.size(), "Expecting empty pool of bam index parts");
         while(bamIndexParts.size() < bamFileStreams_.size())
         {
-            bamIndexParts.push_back(new bam::BamIndexPart);
+            bamIndexParts.push_back(new bam::BamIndexPart(bamIndexes_.at(bamIndexParts.size())));
         }
     }
     catch (...)
@@ -616,6 +765,7 @@ template <typename ExceptionType, typename ExceptionDataT>
 bool Build::handleBinAllocationFailure(
     bool warningTraced,
     const alignment::BinMetadata &bin,
+    const unsigned binStatsIndex,
     const ExceptionType &e,
     const ExceptionDataT &errorData)
 {
@@ -624,6 +774,9 @@ bool Build::handleBinAllocationFailure(
         BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
     }
 
+    stats_.incrementAllocationFailures(binStatsIndex);
+    concurrencyBalancer_.allocationFailed();
+
     if (!allocatedBins_)
     {
         forceTermination_ = true;
@@ -657,6 +810,7 @@ boost::shared_ptr<BinData> Build::allocateBin(
 
     alignment::BinMetadataCRefList::iterator thisThreadBinIt = thisThreadBinsEndIt;
     alignment::BinMetadata &bin = *thisThreadBinIt;
+    const unsigned binStatsIndex = std::distance(binRefs_.begin(), thisThreadBinIt);
 
     // decide what part of data we can process on this thread
     while (++thisThreadBinsEndIt != binsEnd &&
@@ -700,17 +854,18 @@ boost::shared_ptr<BinData> Build::allocateBin(
                 totalBuffersNeeded += estimateBinCompressedDataRequirements(bin, outputFileIndex++);
             }
             warningTraced = handleBinAllocationFailure(
-                warningTraced, bin, a, BinData::getMemoryRequirements(bin) + totalBuffersNeeded);
+                warningTraced, bin, binStatsIndex, a, BinData::getMemoryRequirements(bin) + totalBuffersNeeded);
         }
         catch (boost::iostreams::zlib_error &z)
         {
-            warningTraced = handleBinAllocationFailure(warningTraced, bin, z, z.error());
+            warningTraced = handleBinAllocationFailure(warningTraced, bin, binStatsIndex, z, z.error());
         }
         catch (common::IoException &io)
         {
             if (EMFILE == io.getErrorNumber())
             {
-                warningTraced = handleBinAllocationFailure(warningTraced, bin, io, "Increase number of open files for better efficiency");
+                warningTraced = handleBinAllocationFailure(
+                    warningTraced, bin, binStatsIndex, io, "Increase number of open files for better efficiency");
             }
             else
             {
@@ -731,11 +886,12 @@ boost::shared_ptr<BinData> Build::allocateBin(
     return ret;
 }
 
-void Build::waitForLoadSlot(
+io::AsyncFileReader &Build::waitForLoadSlot(
     boost::unique_lock<boost::mutex> &lock,
     const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
     const alignment::BinMetadataCRefList::const_iterator thisThreadBinsEndIt,
-    alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt)
+    alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt,
+    BinTimeline &timeline)
 {
     bool warningTraced = false;
 
@@ -746,22 +902,35 @@ void Build::waitForLoadSlot(
             BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
         }
 
-        if (nextUnloadedBinIt == thisThreadBinIt && !warningTraced)
+        // waiting for the preceding bins to start loading is not a stall
+        const bool slotStall = nextUnloadedBinIt == thisThreadBinIt;
+        if (slotStall && !warningTraced)
         {
             ISAAC_THREAD_CERR << "WARNING: Holding up processing of bin: " <<
                 thisThreadBinIt->get().getPath().c_str() << " until a load slot is available" << std::endl;
             warningTraced = true;
         }
 
+        const uint64_t waitStart = getElapsedMicroseconds();
         stateChangedCondition_.wait(lock);
+        if (slotStall)
+        {
+            timeline.loadSlotStall_ += getElapsedMicroseconds() - waitStart;
+        }
     }
 
     nextUnloadedBinIt = thisThreadBinsEndIt;
     --maxLoaders_;
+
+    ISAAC_ASSERT_MSG(!freeBinReaders_.empty(), "More load slots than bin readers");
+    io::AsyncFileReader &ret = *freeBinReaders_.back();
+    freeBinReaders_.pop_back();
+    return ret;
 }
 
-void Build::returnLoadSlot(const bool exceptionUnwinding)
+void Build::returnLoadSlot(const bool exceptionUnwinding, io::AsyncFileReader &binReader)
 {
+    freeBinReaders_.push_back(&binReader);
     ++maxLoaders_;
     if (exceptionUnwinding)
     {
@@ -770,6 +939,52 @@ void Build::returnLoadSlot(const bool exceptionUnwinding)
     stateChangedCondition_.notify_all();
 }
 
+uint64_t Build::getElapsedMicroseconds() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime_).count();
+}
+
+/**
+ * \brief Moves a slot between loading and computing if concurrencyBalancer_ suggests so. Changes are only applied
+ *        when the slot being moved is not in use.
+ */
+void Build::balanceConcurrency(const alignment::BinMetadataCRefList::const_iterator nextUnloadedBinIt)
+{
+    if (!concurrencyBalancer_.isEnabled())
+    {
+        return;
+    }
+
+    const uint64_t nextBinMemory =
+        binRefs_.end() == nextUnloadedBinIt ? 0 : BinData::getMemoryRequirements(*nextUnloadedBinIt);
+    const ConcurrencyBalancer::Decision decision = concurrencyBalancer_.decide(
+        getElapsedMicroseconds(),
+        std::min(common::getAvailablePhysicalMemory(), common::MemoryBudget::instance().getAvailable()), nextBinMemory);
+
+    if (ConcurrencyBalancer::MoreLoaders == decision && maxComputers_)
+    {
+        --maxComputers_;
+        ++maxLoaders_;
+    }
+    else if (ConcurrencyBalancer::MoreComputers == decision && maxLoaders_)
+    {
+        --maxLoaders_;
+        ++maxComputers_;
+    }
+    else
+    {
+        return;
+    }
+
+    concurrencyBalancer_.applied(decision);
+    stats_.addConcurrencyChange(ConcurrencyChange(
+        getElapsedMicroseconds(), concurrencyBalancer_.getLoadSlots(), concurrencyBalancer_.getComputeSlots(),
+        concurrencyBalancer_.getLastThroughput(), concurrencyBalancer_.getLastReason()));
+    ISAAC_THREAD_CERR << "Switched to " << concurrencyBalancer_.getLoadSlots() << " load slots and " <<
+        concurrencyBalancer_.getComputeSlots() << " compute slots: " << concurrencyBalancer_.getLastReason() << std::endl;
+    stateChangedCondition_.notify_all();
+}
+
 /**
  * @return true if this thread was the first to set task to 'complete" state
  */
@@ -942,27 +1157,13 @@ void Build::returnComputeSlot(const bool exceptionUnwinding)
     stateChangedCondition_.notify_all();
 }
 
-void Build::waitForSaveSlot(
-    boost::unique_lock<boost::mutex> &lock,
-    const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
-    alignment::BinMetadataCRefList::const_iterator &nextUnsavedBinIt)
-{
-    while(nextUnsavedBinIt != thisThreadBinIt)
-    {
-        if (forceTermination_)
-        {
-            BOOST_THROW_EXCEPTION(common::ThreadingException("Terminating due to failures on other threads"));
-        }
-        stateChangedCondition_.wait(lock);
-    }
-}
-
 void Build::returnSaveSlot(
-    alignment::BinMetadataCRefList::const_iterator &nextUnsavedBinIt,
+    BinSaveCursors &saveCursors,
+    const std::size_t fileIndex,
     const alignment::BinMetadataCRefList::const_iterator thisThreadBinEndIt,
     const bool exceptionUnwinding)
 {
-    nextUnsavedBinIt = thisThreadBinEndIt;
+    saveCursors.returnSlot(fileIndex, thisThreadBinEndIt);
     if (exceptionUnwinding)
     {
         forceTermination_ = true;
@@ -973,7 +1174,7 @@ void Build::returnSaveSlot(
 void Build::sortBinParallel(alignment::BinMetadataCRefList::iterator &nextUnprocessedBinIt,
                             alignment::BinMetadataCRefList::const_iterator &nextUnallocatedBinIt,
                             alignment::BinMetadataCRefList::const_iterator &nextUnloadedBinIt,
-                            alignment::BinMetadataCRefList::const_iterator &nextUnsavedBinIt,
+                            BinSaveCursors &saveCursors,
                             common::ScopedMallocBlock &mallocBlock,
                             const std::size_t threadNumber)
 {
@@ -988,24 +1189,37 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::iterator &nextUnproc
 
         alignment::BinMetadataCRefList::iterator thisThreadBinIt = nextUnprocessedBinIt;
         alignment::BinMetadataCRefList::iterator thisThreadBinsEndIt = thisThreadBinIt;
+        BinTimeline &timeline = stats_.binTimeline(std::distance(binRefs_.begin(), thisThreadBinIt));
 
+        timeline.allocateStart_ = getElapsedMicroseconds();
         // wait and allocate memory required for loading and compressing this bin
         boost::shared_ptr<BinData> binDataPtr =
             allocateBin(lock, thisThreadBinsEndIt, nextUnprocessedBinIt, nextUnallocatedBinIt, binRefs_.end(), mallocBlock, threadNumber);
-        waitForLoadSlot(lock, thisThreadBinIt, thisThreadBinsEndIt, nextUnloadedBinIt);
-        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnLoadSlot, this, _1))
+        timeline.allocateEnd_ = getElapsedMicroseconds();
+        io::AsyncFileReader &binReader =
+            waitForLoadSlot(lock, thisThreadBinIt, thisThreadBinsEndIt, nextUnloadedBinIt, timeline);
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnLoadSlot, this, _1, boost::ref(binReader)))
         {
             ++loadingThreads;
+            timeline.loadStart_ = getElapsedMicroseconds();
     //        ISAAC_THREAD_CERR << "Threads:" << allocatedBins_ << "," << dedupingThreads << "," << realigningThreads << "," << serializingThreads << "," << savingThreads << "," << loadingThreads << std::endl;
             {
                 common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-                BinLoader binLoader;
+                binReader.resetCounters();
+                BinLoader binLoader(binReader);
                 binLoader.loadData(*binDataPtr);
             }
+            timeline.loadEnd_ = getElapsedMicroseconds();
+            timeline.loadedBytes_ = thisThreadBinIt->get().getDataSize();
+            timeline.loadIoWait_ = binReader.getCounters().waitMicroseconds_;
             --loadingThreads;
     //        ISAAC_THREAD_CERR << "Threads:" << allocatedBins_ << "," << dedupingThreads << "," << realigningThreads << "," << serializingThreads << "," << savingThreads << "," << loadingThreads << std::endl;
         }
+        concurrencyBalancer_.binLoaded(
+            timeline.loadEnd_, timeline.loadedBytes_, timeline.loadEnd_ - timeline.loadStart_, timeline.loadSlotStall_);
+        balanceConcurrency(nextUnloadedBinIt);
 
+        timeline.computeStart_ = getElapsedMicroseconds();
         {
             preemptComputeSlot(
                 lock, 1, std::distance(binRefs_.begin(), thisThreadBinIt),
@@ -1068,25 +1282,24 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::iterator &nextUnproc
                 },
                 threadNumber);
         }
+        timeline.computeEnd_ = getElapsedMicroseconds();
+        concurrencyBalancer_.binComputed(timeline.computeEnd_ - timeline.computeStart_);
         // give back some memory to allow other threads to load
         // data while we're waiting for our turn to save
         binDataPtr.reset();
+        threadBinMemory_.at(threadNumber).release();
         stateChangedCondition_.notify_all();
 
         ++savingThreads;
 //        ISAAC_THREAD_CERR << "Threads:" << allocatedBins_ << "," << dedupingThreads << "," << realigningThreads << "," << serializingThreads << "," << savingThreads << "," << loadingThreads << std::endl;
-        // wait for our turn to store bam data
-        waitForSaveSlot(lock, thisThreadBinIt, nextUnsavedBinIt);
-        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnSaveSlot, this, boost::ref(nextUnsavedBinIt), thisThreadBinsEndIt, _1))
-        {
-            saveAndReleaseBuffers(lock, thisThreadBinIt->get().getPath(), threadNumber);
-        }
+        // store bam data into each file as soon as the file has received everything that precedes our bin
+        saveAndReleaseBuffers(lock, thisThreadBinIt, thisThreadBinsEndIt, saveCursors, timeline, threadNumber);
         --savingThreads;
 //        ISAAC_THREAD_CERR << "Threads:" << allocatedBins_ << "," << dedupingThreads << "," << realigningThreads << "," << serializingThreads << "," << savingThreads << "," << loadingThreads << std::endl;
     }
 
     // Don't release thread until all saving is done. Use threads that don't get anything to process for preemptive tasks such as realignment.
-    while(!forceTermination_ && binRefs_.end() != nextUnsavedBinIt)
+    while(!forceTermination_ && !saveCursors.allSaved())
     {
         if (!yieldIfPossible(lock, threadNumber, 0))
         {
@@ -1096,23 +1309,35 @@ void Build::sortBinParallel(alignment::BinMetadataCRefList::iterator &nextUnproc
 }
 
 /**
- * \brief Save bgzf compressed buffers into corresponding sample files and and release associated memory
+ * \brief Save bgzf compressed buffers into corresponding sample files and and release associated memory.
+ *        Files are saved in the order in which they become available. Different threads can be saving
+ *        different files at the same time.
  */
 void Build::saveAndReleaseBuffers(
     boost::unique_lock<boost::mutex> &lock,
-    const boost::filesystem::path &filePath,
+    const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt,
+    const alignment::BinMetadataCRefList::const_iterator thisThreadBinsEndIt,
+    BinSaveCursors &saveCursors,
+    BinTimeline &timeline,
     const std::size_t threadNumber)
 {
-    unsigned index = 0;
-    BOOST_FOREACH(bam::BgzfBuffer &bgzfBuffer, threadBgzfBuffers_.at(threadNumber))
+    const boost::filesystem::path &filePath = thisThreadBinIt->get().getPath();
+    BgzfBuffers &bgzfBuffers = threadBgzfBuffers_.at(threadNumber);
+    std::vector<bool> savedFiles(bgzfBuffers.size(), false);
+    for (std::size_t saved = 0; saved < savedFiles.size(); ++saved)
     {
+        // wait for our turn to store bam data
+        const uint64_t saveWaitStart = getElapsedMicroseconds();
+        const std::size_t index = saveCursors.waitForSlot(
+            lock, stateChangedCondition_, forceTermination_, thisThreadBinIt, savedFiles);
+        const uint64_t saveStart = getElapsedMicroseconds();
+        timeline.saveStart_ = saved ? timeline.saveStart_ : saveStart;
+        timeline.saveSlotStall_ += saveStart - saveWaitStart;
+
+        bam::BgzfBuffer &bgzfBuffer = bgzfBuffers.at(index);
+        ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&Build::returnSaveSlot, this, boost::ref(saveCursors), index, thisThreadBinsEndIt, _1))
         {
             common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-//            ISAAC_THREAD_CERR << "Freezing thread " << threadNumber << " for bin " << filePath.c_str() << std::endl;
-//            while (true)
-//            {
-//                sleep(1);
-//            }
             std::ostream *stm = bamFileStreams_.at(index).get();
             if (!stm)
             {
@@ -1120,13 +1345,16 @@ void Build::saveAndReleaseBuffers(
             }
             else
             {
-                saveBuffer(bgzfBuffer, *stm, threadBamIndexParts_.at(threadNumber).at(index), bamIndexes_.at(index), filePath);
+                saveBuffer(bgzfBuffer, *stm, threadBamIndexParts_.at(threadNumber).at(index), bamIndexes_.at(index),
+                           cramIndexes_.at(index), filePath);
             }
+            // release rest of the memory that was reserved for this bin
+            bam::BgzfBuffer().swap(bgzfBuffer);
         }
-        // release rest of the memory that was reserved for this bin
-        bam::BgzfBuffer().swap(bgzfBuffer);
-        ++index;
+        savedFiles.at(index) = true;
     }
+    timeline.saveEnd_ = getElapsedMicroseconds();
+    threadBgzfMemory_.at(threadNumber).release();
     --allocatedBins_;
     threadBamIndexParts_.at(threadNumber).clear();
 }
@@ -1136,6 +1364,7 @@ void Build::saveBuffer(
     std::ostream &bamStream,
     const bam::BamIndexPart &bamIndexPart,
     bam::BamIndex &bamIndex,
+    bam::CramIndex &cramIndex,
     const boost::filesystem::path &filePath)
 {
     ISAAC_THREAD_CERR << "Saving " << bgzfBuffer.size() << " bytes of sorted data for bin " << filePath.c_str() << std::endl;
@@ -1145,7 +1374,17 @@ void Build::saveBuffer(
         BOOST_THROW_EXCEPTION(common::IoException(
             errno, (boost::format("Failed to write bgzf block of %d bytes into bam stream") % bgzfBuffer.size()).str()));
     }
-    bamIndex.processIndexPart( bamIndexPart, bgzfBuffer );
+    if (OUTPUT_CRAM == outputFormat_)
+    {
+        if (!bgzfBuffer.empty())
+        {
+            cramIndex.processContainers(&bgzfBuffer.front(), &bgzfBuffer.back() + 1);
+        }
+    }
+    else
+    {
+        bamIndex.processIndexPart( bamIndexPart, bgzfBuffer );
+    }
 
     ISAAC_THREAD_CERR << "Saving " << bgzfBuffer.size() << " bytes of sorted data for bin " << filePath.c_str() << " done in " << (clock() - start) / 1000 << "ms\n";
 }
@@ -21,6 +21,7 @@
 #include <boost/foreach.hpp>
 
 #include "BuildStatsXml.hh"
+#include "common/MemoryBudget.hh"
 #include "xml/XmlWriter.hh"
 
 namespace isaac
@@ -118,6 +119,70 @@ void BuildStatsXml::dumpContigs(
     }
 }
 
+void BuildStatsXml::dumpTimeline(xml::XmlWriter &xmlWriter)
+{
+    ISAAC_XML_WRITER_ELEMENT_BLOCK(xmlWriter, "Timeline")
+    {
+        xmlWriter.writeElement("AllocationFailures", buildStats_.getAllocationFailures());
+        BOOST_FOREACH(const ConcurrencyChange &change, buildStats_.getConcurrencyChanges())
+        {
+            ISAAC_XML_WRITER_ELEMENT_BLOCK(xmlWriter, "Concurrency")
+            {
+                xmlWriter.writeAttribute("time", change.time_);
+                xmlWriter.writeAttribute("loadSlots", change.loadSlots_);
+                xmlWriter.writeAttribute("computeSlots", change.computeSlots_);
+                xmlWriter.writeAttribute("loadThroughput", change.loadThroughput_);
+                xmlWriter.writeAttribute("reason", change.reason_);
+            }
+        }
+
+        for (std::size_t binStatsIndex = 0; bins_.size() != binStatsIndex; ++binStatsIndex)
+        {
+            const BinTimeline &timeline = buildStats_.getBinTimeline(binStatsIndex);
+            // bins merged into the preceding ones don't get processed on their own
+            if (timeline.processed())
+            {
+                const alignment::BinMetadata &bin = bins_.at(binStatsIndex);
+                ISAAC_XML_WRITER_ELEMENT_BLOCK(xmlWriter, "Bin")
+                {
+                    xmlWriter.writeAttribute("path", bin.getPath().filename().string());
+                    xmlWriter.writeElement("AllocateStart", timeline.allocateStart_);
+                    xmlWriter.writeElement("AllocateEnd", timeline.allocateEnd_);
+                    xmlWriter.writeElement("AllocationFailures", timeline.allocationFailures_);
+                    xmlWriter.writeElement("LoadSlotStall", timeline.loadSlotStall_);
+                    xmlWriter.writeElement("LoadStart", timeline.loadStart_);
+                    xmlWriter.writeElement("LoadEnd", timeline.loadEnd_);
+                    xmlWriter.writeElement("LoadedBytes", timeline.loadedBytes_);
+                    xmlWriter.writeElement("LoadIoWait", timeline.loadIoWait_);
+                    xmlWriter.writeElement("ComputeStart", timeline.computeStart_);
+                    xmlWriter.writeElement("ComputeEnd", timeline.computeEnd_);
+                    xmlWriter.writeElement("SaveSlotStall", timeline.saveSlotStall_);
+                    xmlWriter.writeElement("SaveStart", timeline.saveStart_);
+                    xmlWriter.writeElement("SaveEnd", timeline.saveEnd_);
+                }
+            }
+        }
+    }
+}
+
+void BuildStatsXml::dumpMemory(xml::XmlWriter &xmlWriter)
+{
+    const common::MemoryBudget &budget = common::MemoryBudget::instance();
+    ISAAC_XML_WRITER_ELEMENT_BLOCK(xmlWriter, "Memory")
+    {
+        xmlWriter.writeElement("Limit", budget.getLimit());
+        xmlWriter.writeElement("HighWater", budget.getHighWater());
+        for (unsigned subsystem = 0; subsystem < common::MemoryBudget::SubsystemCount; ++subsystem)
+        {
+            ISAAC_XML_WRITER_ELEMENT_BLOCK(xmlWriter, "Subsystem")
+            {
+                xmlWriter.writeAttribute("name", common::MemoryBudget::getSubsystemName(common::MemoryBudget::Subsystem(subsystem)));
+                xmlWriter.writeElement("HighWater", budget.getHighWater(common::MemoryBudget::Subsystem(subsystem)));
+            }
+        }
+    }
+}
+
 void BuildStatsXml::serialize(std::ostream &os)
 {
     ISAAC_THREAD_CERR << "Generating Build statistics" << std::endl;
@@ -180,6 +245,9 @@ void BuildStatsXml::serialize(std::ostream &os)
             xmlWriter.endElement(); //close Sample
             xmlWriter.endElement(); //close Project
         }
+
+        dumpTimeline(xmlWriter);
+        dumpMemory(xmlWriter);
     }
     ISAAC_THREAD_CERR << "Generating Build statistics done" << std::endl;
 }
@@ -43,6 +43,10 @@ class BuildStatsXml
         flowcell::BarcodeMetadataList::const_iterator sampleBarcodesBegin,
         flowcell::BarcodeMetadataList::const_iterator sampleBarcodesEnd);
 
+    void dumpTimeline(xml::XmlWriter &xmlWriter);
+    /// high-water marks of the process-wide memory budget
+    void dumpMemory(xml::XmlWriter &xmlWriter);
+
 public:
     BuildStatsXml(
         const reference::SortedReferenceMetadataList &sortedReferenceMetadataList,
@@ -0,0 +1,160 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file ConcurrencyBalancer.cpp
+ **
+ ** \brief Decides how to split Build threads between loading and computing based on observed timings.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+
+#include "build/ConcurrencyBalancer.hh"
+#include "common/Debug.hh"
+
+namespace isaac
+{
+namespace build
+{
+
+const double ConcurrencyBalancer::THROUGHPUT_GAIN_MIN = 0.05;
+
+ConcurrencyBalancer::ConcurrencyBalancer(
+    const bool enabled,
+    const unsigned loadSlots,
+    const unsigned computeSlots) :
+    enabled_(enabled),
+    loadSlots_(loadSlots),
+    computeSlots_(computeSlots),
+    loadSlotsCeiling_(loadSlots + computeSlots - 1),
+    lastApplied_(Keep),
+    lastDecision_(Keep),
+    lastThroughput_(0),
+    throughputBeforeLastApplied_(0),
+    lastReason_("initial")
+{
+    resetWindow(0);
+}
+
+void ConcurrencyBalancer::resetWindow(const uint64_t now)
+{
+    windowStart_ = now;
+    windowLoads_ = 0;
+    windowComputes_ = 0;
+    windowBytes_ = 0;
+    windowLoadMicroseconds_ = 0;
+    windowComputeMicroseconds_ = 0;
+    windowStallMicroseconds_ = 0;
+    windowAllocationFailures_ = 0;
+}
+
+void ConcurrencyBalancer::binLoaded(
+    const uint64_t now,
+    const uint64_t bytes,
+    const uint64_t loadMicroseconds,
+    const uint64_t loadSlotStallMicroseconds)
+{
+    if (!windowLoads_ && !windowStart_)
+    {
+        // first ever observation. Count the window from the moment the load started
+        windowStart_ = now - std::min(now, loadMicroseconds);
+    }
+    ++windowLoads_;
+    windowBytes_ += bytes;
+    windowLoadMicroseconds_ += loadMicroseconds;
+    windowStallMicroseconds_ += loadSlotStallMicroseconds;
+}
+
+void ConcurrencyBalancer::binComputed(const uint64_t computeMicroseconds)
+{
+    ++windowComputes_;
+    windowComputeMicroseconds_ += computeMicroseconds;
+}
+
+ConcurrencyBalancer::Decision ConcurrencyBalancer::decide(
+    const uint64_t now,
+    const uint64_t availableMemory,
+    const uint64_t nextBinMemory)
+{
+    // collect enough loads for the concurrent ones to overlap, and at least one compute to compare against
+    if (!enabled_ || windowLoads_ < std::max(2U, loadSlots_) || !windowComputes_ || now <= windowStart_)
+    {
+        return Keep;
+    }
+
+    lastThroughput_ = windowBytes_ * 1000000 / (now - windowStart_);
+
+    const uint64_t averageLoad = windowLoadMicroseconds_ / windowLoads_;
+    const uint64_t averageCompute = windowComputeMicroseconds_ / windowComputes_;
+    // loaders deliver loadSlots_ / averageLoad bins per microsecond while computers consume
+    // computeSlots_ / averageCompute.
+    const bool loadBound = averageLoad * computeSlots_ > averageCompute * loadSlots_;
+
+    Decision ret = Keep;
+    if (MoreLoaders == lastApplied_ &&
+        lastThroughput_ < throughputBeforeLastApplied_ * (1.0 + THROUGHPUT_GAIN_MIN))
+    {
+        // storage did not give more with the extra loader. Give it back and don't try again.
+        loadSlotsCeiling_ = loadSlots_ - 1;
+        ret = MoreComputers;
+        lastReason_ = "load throughput saturated";
+    }
+    else if (loadBound && windowStallMicroseconds_ && !windowAllocationFailures_ &&
+        loadSlots_ < loadSlotsCeiling_ && 1 < computeSlots_ && availableMemory > nextBinMemory)
+    {
+        ret = MoreLoaders;
+        lastReason_ = "load bound";
+    }
+    else if (!loadBound && 1 < loadSlots_ && (windowAllocationFailures_ || !windowStallMicroseconds_))
+    {
+        ret = MoreComputers;
+        lastReason_ = windowAllocationFailures_ ? "memory bound" : "compute bound";
+    }
+
+    // windows are short. Only report the ones that change the picture
+    if (ret != lastDecision_)
+    {
+        ISAAC_THREAD_CERR << "ConcurrencyBalancer: load slots " << loadSlots_ << " compute slots " << computeSlots_ <<
+            " throughput " << lastThroughput_ << "B/s average load " << averageLoad << "us average compute " <<
+            averageCompute << "us stalls " << windowStallMicroseconds_ << "us allocation failures " <<
+            windowAllocationFailures_ << " decision " << ret << std::endl;
+        lastDecision_ = ret;
+    }
+
+    throughputBeforeLastApplied_ = lastThroughput_;
+    // the client might not be able to apply the decision. Wait for it to confirm.
+    lastApplied_ = Keep;
+    resetWindow(now);
+    return ret;
+}
+
+void ConcurrencyBalancer::applied(const Decision decision)
+{
+    ISAAC_ASSERT_MSG(Keep != decision, "Keep is not expected to be applied");
+    if (MoreLoaders == decision)
+    {
+        ISAAC_ASSERT_MSG(1 < computeSlots_, "At least one compute slot must remain");
+        ++loadSlots_;
+        --computeSlots_;
+    }
+    else
+    {
+        ISAAC_ASSERT_MSG(1 < loadSlots_, "At least one load slot must remain");
+        --loadSlots_;
+        ++computeSlots_;
+    }
+    lastApplied_ = decision;
+}
+
+} // namespace build
+} // namespace isaac
@@ -474,9 +474,8 @@ GapRealigner::GapChoice GapRealigner::verifyGapsChoice(
 //            ISAAC_THREAD_CERR << " mappedBases=" << mappedBases << " basesLeft=" << basesLeft << std::endl;
 
             const unsigned length = mappedBases - std::min(mappedBases, leftClippedLeft);
-            const unsigned mm = alignment::countEditDistanceMismatches(reference,
-                                                fragment.basesBegin() + (fragment.readLength_ - basesLeft) + leftClippedLeft,
-                                                lastGapEndPos + leftClippedLeft, length);
+            const unsigned mm = mismatchProfiles_.countMismatches(
+                (fragment.readLength_ - basesLeft) + leftClippedLeft, lastGapEndPos + leftClippedLeft, length);
 
             ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "length: " << length);
 //            ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "countMismatches: " << mm);
@@ -537,8 +536,8 @@ GapRealigner::GapChoice GapRealigner::verifyGapsChoice(
         }
         else
         {
-            const unsigned mm = alignment::countEditDistanceMismatches(
-                reference, fragment.basesBegin() + (fragment.readLength_ - basesLeft) + leftClippedLeft, firstUnclippedPos, length);
+            const unsigned mm = mismatchProfiles_.countMismatches(
+                (fragment.readLength_ - basesLeft) + leftClippedLeft, firstUnclippedPos, length);
             ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "final countMismatches: " << mm);
             ret.mappedLength_ += length;
             ret.editDistance_ += mm;
@@ -1000,6 +999,79 @@ public:
     }
 };
 
+void GapRealigner::validateGapChoiceCache(
+    const gapRealigner::GapsRange &gaps,
+    const io::FragmentAccessor &fragment,
+    const reference::ContigList &reference)
+{
+    if (REALIGNED_READ_LENGTH_MAX < fragment.readLength_ ||
+        gapChoiceCacheGaps_.capacity() < gaps.size())
+    {
+        // don't let the cache reallocate. Just don't cache the unusual ones.
+        gapChoiceCacheGeneration_ = 0;
+        return;
+    }
+
+    if (gapChoiceCacheGeneration_ &&
+        &reference == gapChoiceCacheReference_ &&
+        fragment.leftClipped() == gapChoiceCacheLeftClipped_ &&
+        fragment.rightClipped() == gapChoiceCacheRightClipped_ &&
+        gapChoiceCacheBases_.size() == fragment.readLength_ &&
+        std::equal(gapChoiceCacheBases_.begin(), gapChoiceCacheBases_.end(), fragment.basesBegin()) &&
+        gapChoiceCacheGaps_.size() == gaps.size() &&
+        std::equal(gapChoiceCacheGaps_.begin(), gapChoiceCacheGaps_.end(), gaps.first,
+                   [](const gapRealigner::Gap &left, const gapRealigner::Gap &right)
+                   {
+                        return gapRealigner::Gap::comparePositionAndLength(left, right) && left.priority_ == right.priority_;
+                   }))
+    {
+        return;
+    }
+
+    if (!++gapChoiceCacheLastGeneration_)
+    {
+        // generation counter wrapped. Entries from the previous cycle might look valid.
+        BOOST_FOREACH(CachedGapChoice &cached, gapChoiceCache_)
+        {
+            cached.generation_ = 0;
+        }
+        gapChoiceCacheLastGeneration_ = 1;
+    }
+    gapChoiceCacheGeneration_ = gapChoiceCacheLastGeneration_;
+    gapChoiceCacheReference_ = &reference;
+    gapChoiceCacheLeftClipped_ = fragment.leftClipped();
+    gapChoiceCacheRightClipped_ = fragment.rightClipped();
+    gapChoiceCacheBases_.assign(fragment.basesBegin(), fragment.basesEnd());
+    gapChoiceCacheGaps_.assign(gaps.first, gaps.second);
+}
+
+GapRealigner::GapChoice GapRealigner::verifyGapsChoiceCached(
+    const GapChoiceBitmask &choice,
+    const gapRealigner::GapsRange &gaps,
+    const reference::ReferencePosition newBeginPos,
+    const io::FragmentAccessor &fragment,
+    const reference::ContigList &reference)
+{
+    if (!gapChoiceCacheGeneration_)
+    {
+        return verifyGapsChoice(choice, gaps, newBeginPos, fragment, reference);
+    }
+
+    const uint64_t hash = (choice * 0x9E3779B97F4A7C15UL) ^ (newBeginPos.getValue() * 0xC2B2AE3D27D4EB4FUL);
+    CachedGapChoice &cached = gapChoiceCache_[(hash >> 32) & (GAP_CHOICE_CACHE_SIZE - 1)];
+    if (gapChoiceCacheGeneration_ == cached.generation_ &&
+        choice == cached.choice_.choice_ && newBeginPos == cached.choice_.startPos_)
+    {
+        ++gapChoiceCacheHits_;
+        return cached.choice_;
+    }
+
+    ++gapChoiceCacheMisses_;
+    cached.choice_ = verifyGapsChoice(choice, gaps, newBeginPos, fragment, reference);
+    cached.generation_ = gapChoiceCacheGeneration_;
+    return cached.choice_;
+}
+
 bool GapRealigner::verifyGapsChoice(
     const GapChoiceBitmask &choice,
     const gapRealigner::GapsRange& gaps,
@@ -1028,7 +1100,7 @@ bool GapRealigner::verifyGapsChoice(
                 if (findStartPos(choice, gaps, binStartPos, binEndPos,
                                  pivotGapIndex, pivotGap.getBeginPos(), undoneAlignmentPos, newStarPos))
                 {
-                    const GapChoice thisChoice = verifyGapsChoice(choice, gaps, newStarPos, fragment, reference);
+                    const GapChoice thisChoice = verifyGapsChoiceCached(choice, gaps, newStarPos, fragment, reference);
                     if (isBetterChoice(thisChoice, originalMismatchesPercent, bestChoice))
                     {
                         ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, thisChoice << "better than " << bestChoice);
@@ -1048,7 +1120,7 @@ bool GapRealigner::verifyGapsChoice(
             if (findStartPos(choice, gaps, binStartPos, binEndPos,
                              pivotGapIndex + 1, pivotGap.getEndPos(false), undoneAlignmentPos, newStarPos))
             {
-                const GapChoice thisChoice = verifyGapsChoice(choice, gaps, newStarPos, fragment, reference);
+                const GapChoice thisChoice = verifyGapsChoiceCached(choice, gaps, newStarPos, fragment, reference);
                 if (isBetterChoice(thisChoice, originalMismatchesPercent, bestChoice))
                 {
                     ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, thisChoice << "better than " << bestChoice);
@@ -1088,6 +1160,9 @@ bool GapRealigner::findBetterGapsChoice(
     const int originalMismatchesPercent = bestChoice.mismatchesPercent_;
     ISAAC_THREAD_CERR_DEV_TRACE_CLUSTER_ID(fragment.clusterId_, "Initial bestChoice " << bestChoice);
 
+    validateGapChoiceCache(gaps, fragment, reference);
+    mismatchProfiles_.reset(reference, fragment.basesBegin(), fragment.readLength_);
+
     fragmentGaps_.clear();
     fragmentGaps_.addGaps(index.pos_, index.cigarBegin_, index.cigarEnd_);
     const gapRealigner::GapsRange fragmentGapsRange = fragmentGaps_.allGaps();
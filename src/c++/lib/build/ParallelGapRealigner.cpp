@@ -70,23 +70,47 @@ void ParallelGapRealigner::realign(
     }
 }
 
+/**
+ * \brief Hands out the next window of index entries to process.
+ *
+ * Window size shrinks with the amount of remaining work so that the threads joining late or finishing early pick up
+ * the remainder of indel-dense regions instead of waiting for one thread to complete a large block. The window end is
+ * moved forward over the entries sharing the start position with the last one, so that the fragments piling up at the
+ * same position get realigned by the same thread and reuse its gap choice evaluations.
+ */
+BinData::iterator ParallelGapRealigner::nextWindow(BinData &binData, BinData::iterator &nextUnprocessed) const
+{
+    const std::size_t remaining = std::distance(nextUnprocessed, binData.indexEnd());
+    const std::size_t windowSize = std::max<std::size_t>(
+        READS_AT_A_TIME_MIN, std::min<std::size_t>(READS_AT_A_TIME, remaining / (threadGapRealigners_.size() * 2)));
+    BinData::iterator windowEnd = nextUnprocessed + std::min(remaining, windowSize);
+    if (binData.indexEnd() != windowEnd)
+    {
+        const reference::ReferencePosition lastPos = (windowEnd - 1)->pos_;
+        while (binData.indexEnd() != windowEnd && lastPos == windowEnd->pos_)
+        {
+            ++windowEnd;
+        }
+    }
+    return windowEnd;
+}
+
 void ParallelGapRealigner::threadRealignGaps(boost::unique_lock<boost::mutex> &lock, BinData &binData, BinData::iterator &nextUnprocessed, uint64_t threadNumber)
 {
 //    ISAAC_THREAD_CERR << "threadRealignGaps this " << this  << std::endl;
 
     isaac::build::GapRealigner &realigner = threadGapRealigners_.at(threadNumber);
     isaac::alignment::Cigar &cigars = threadCigars_.at(threadNumber);
-    static const std::size_t READS_AT_A_TIME = 1024;
 
 //    int blockCount = 0;
     while (binData.indexEnd() != nextUnprocessed)
     {
         BinData::iterator ourBegin = nextUnprocessed;
-        const std::size_t readsToProcess = std::min<std::size_t>(READS_AT_A_TIME, std::distance(ourBegin, binData.indexEnd()));
-        nextUnprocessed += readsToProcess;
+        const BinData::iterator ourEnd = nextWindow(binData, nextUnprocessed);
+        nextUnprocessed = ourEnd;
         {
             common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
-            for (const BinData::iterator ourEnd = ourBegin + readsToProcess; ourEnd != ourBegin; ++ourBegin)
+            for (; ourEnd != ourBegin; ++ourBegin)
             {
                 PackedFragmentBuffer::Index &index = *ourBegin;
                 io::FragmentAccessor &fragment = binData.data_.getFragment(index);
@@ -0,0 +1,115 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <string>
+
+#include "build/BinLoader.hh"
+#include "io/AsyncFileReader.hh"
+#include "io/MemoryFileStore.hh"
+
+using namespace isaac;
+
+#include "RegistryName.hh"
+#include "testBinLoader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBinLoader, registryName("TestBinLoader"));
+
+// data of the bin written before the one being loaded
+static const std::size_t PRECEDING_BYTES = 100;
+
+static std::string makeData(const std::size_t bytes)
+{
+    std::string ret(bytes, 0);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret[i] = char(i * 13);
+    }
+    return ret;
+}
+
+/**
+ * \brief Loads the unaligned bin that follows PRECEDING_BYTES in path twice, to make sure the loader is reusable
+ */
+static void checkLoad(const boost::filesystem::path &path, const std::string &fileContents)
+{
+    flowcell::BarcodeMetadataList barcodeMetadataList(1);
+    barcodeMetadataList.at(0).setUnknown();
+    barcodeMetadataList.at(0).setIndex(0);
+    barcodeMetadataList.at(0).setReferenceIndex(0);
+
+    alignment::BinMetadata bin(
+        barcodeMetadataList.size(), 0, reference::ReferencePosition(reference::ReferencePosition::TooManyMatch), 0, path);
+    bin.incrementDataSize(uint64_t(0), PRECEDING_BYTES);
+    bin.startNew();
+    bin.incrementDataSize(uint64_t(0), fileContents.size() - PRECEDING_BYTES);
+
+    const demultiplexing::BarcodePathMap barcodeBamMapping;
+    const build::gapRealigner::Gaps knownIndels;
+    const flowcell::TileMetadataList tileMetadataList;
+    const build::BuildContigMap contigMap(
+        barcodeMetadataList, alignment::BinMetadataCRefList(), reference::SortedReferenceMetadataList(), false);
+    const reference::ContigLists contigLists;
+    const flowcell::FlowcellLayoutList flowcellLayoutList;
+
+    // small blocks to make the reads cross block boundaries
+    io::AsyncFileReader reader(false, io::AsyncFileReader::DIRECT_IO_ALIGNMENT);
+    build::BinLoader loader(reader);
+    for (unsigned pass = 0; 2 != pass; ++pass)
+    {
+        build::BinData binData(
+            0, barcodeBamMapping, barcodeMetadataList, build::REALIGN_NONE, 0, knownIndels, bin, 0,
+            tileMetadataList, contigMap, contigLists, 0, 0, flowcellLayoutList,
+            build::IncludeTags(false, false, false, false, false, false, false, false), false, 0, 0);
+        loader.loadData(binData);
+        CPPUNIT_ASSERT_EQUAL(bin.getDataSize(), uint64_t(binData.data_.size()));
+        CPPUNIT_ASSERT(std::equal(binData.data_.begin(), binData.data_.end(), fileContents.begin() + PRECEDING_BYTES));
+    }
+}
+
+void TestBinLoader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestBinLoader::tearDown()
+{
+    io::MemoryFileStore::instance().clear();
+    io::MemoryFileStore::configure(0);
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestBinLoader::testFromDisk()
+{
+    const boost::filesystem::path path = tempDir_ / "bin-unaligned.dat";
+    const std::string fileContents = makeData(PRECEDING_BYTES + io::AsyncFileReader::DIRECT_IO_ALIGNMENT * 3 + 17);
+    {
+        std::ofstream os(path.c_str());
+        os << fileContents;
+    }
+    checkLoad(path, fileContents);
+}
+
+void TestBinLoader::testFromMemory()
+{
+    // the path does not exist in the file system, the data can only come from the store
+    const boost::filesystem::path path = tempDir_ / "bin-in-memory.dat";
+    const std::string fileContents = makeData(PRECEDING_BYTES + io::MemoryFileStore::CHUNK_BYTES + 17);
+    io::MemoryFileStore::configure(io::MemoryFileStore::CHUNK_BYTES * 2);
+    io::MemoryFileStore &store = io::MemoryFileStore::instance();
+    const iovec piece = {const_cast<char *>(fileContents.data()), fileContents.size()};
+    CPPUNIT_ASSERT(store.append(store.create(path.string()), &piece, 1));
+
+    checkLoad(path, fileContents);
+}
@@ -0,0 +1,36 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BUILD_TEST_BIN_LOADER_HH
+#define iSAAC_BUILD_TEST_BIN_LOADER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestBinLoader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBinLoader );
+    CPPUNIT_TEST( testFromDisk );
+    CPPUNIT_TEST( testFromMemory );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testFromDisk();
+    void testFromMemory();
+};
+
+#endif // #ifndef iSAAC_BUILD_TEST_BIN_LOADER_HH
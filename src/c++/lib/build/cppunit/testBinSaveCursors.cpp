@@ -0,0 +1,249 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+#include <boost/thread.hpp>
+
+#include "build/BinSaveCursors.hh"
+#include "common/Threads.hpp"
+
+using namespace isaac;
+
+#include "RegistryName.hh"
+#include "testBinSaveCursors.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBinSaveCursors, registryName("TestBinSaveCursors"));
+
+static const std::size_t FILES = 3;
+static const std::size_t BINS = 24;
+static const unsigned THREADS = 6;
+
+/**
+ * \brief Mimics Build::sortBinParallel and Build::saveAndReleaseBuffers: threads take bins in order, finish them
+ *        in whatever order the compute takes and write each finished bin into every output file. The files are
+ *        written outside the lock, the same way Build does.
+ */
+class SaveSimulation
+{
+public:
+    SaveSimulation(const std::size_t fileCount, const std::size_t binCount) :
+        bins_(binCount), binRefs_(bins_.begin(), bins_.end()),
+        saveCursors_(fileCount, binRefs_.begin(), binRefs_.end()),
+        forceTermination_(false), nextUnprocessedBinIt_(binRefs_.begin()),
+        fileWriters_(fileCount, 0), concurrentFileWrites_(0), fileWrittenBins_(fileCount)
+    {
+    }
+
+    /// \param binsPerThread number of consecutive bins a thread takes at a time, the way allocateBin can group them
+    void run(const unsigned threads, const std::size_t binsPerThread)
+    {
+        boost::thread_group group;
+        for (unsigned i = 0; threads != i; ++i)
+        {
+            group.create_thread(boost::bind(&SaveSimulation::threadFunc, this, binsPerThread));
+        }
+        group.join_all();
+    }
+
+    bool allSaved() const {return saveCursors_.allSaved();}
+    const std::vector<std::size_t> &getFinishOrder() const {return finishOrder_;}
+    const std::vector<std::size_t> &getWrittenBins(const std::size_t fileIndex) const {return fileWrittenBins_.at(fileIndex);}
+    bool sawConcurrentFileWrites() const {return 0 != concurrentFileWrites_;}
+    const std::vector<std::string> &getErrors() const {return errors_;}
+
+private:
+    std::vector<alignment::BinMetadata> bins_;
+    const alignment::BinMetadataCRefList binRefs_;
+    build::BinSaveCursors saveCursors_;
+    boost::mutex stateMutex_;
+    boost::condition_variable stateChangedCondition_;
+    bool forceTermination_;
+    alignment::BinMetadataCRefList::const_iterator nextUnprocessedBinIt_;
+
+    // [file] number of threads currently writing the file. Must never exceed 1
+    std::vector<unsigned> fileWriters_;
+    // number of times a file was written while another file was being written by a different thread
+    unsigned concurrentFileWrites_;
+    // [file][bin index in the order of writing]
+    std::vector<std::vector<std::size_t> > fileWrittenBins_;
+    std::vector<std::size_t> finishOrder_;
+    std::vector<std::string> errors_;
+
+    std::size_t binIndex(const alignment::BinMetadataCRefList::const_iterator binIt) const
+    {
+        return std::distance(binRefs_.begin(), binIt);
+    }
+
+    void returnSaveSlot(
+        const std::size_t fileIndex,
+        const alignment::BinMetadataCRefList::const_iterator binsEndIt,
+        const bool exceptionUnwinding)
+    {
+        saveCursors_.returnSlot(fileIndex, binsEndIt);
+        if (exceptionUnwinding)
+        {
+            forceTermination_ = true;
+        }
+        stateChangedCondition_.notify_all();
+    }
+
+    void threadFunc(const std::size_t binsPerThread)
+    {
+        boost::unique_lock<boost::mutex> lock(stateMutex_);
+        while (binRefs_.end() != nextUnprocessedBinIt_)
+        {
+            const alignment::BinMetadataCRefList::const_iterator thisThreadBinIt = nextUnprocessedBinIt_;
+            nextUnprocessedBinIt_ += std::min<std::size_t>(binsPerThread, std::distance(nextUnprocessedBinIt_, binRefs_.end()));
+            const alignment::BinMetadataCRefList::const_iterator thisThreadBinsEndIt = nextUnprocessedBinIt_;
+            {
+                // earlier bins take longer so that the later ones finish first
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                boost::this_thread::sleep(boost::posix_time::milliseconds(
+                    (THREADS - binIndex(thisThreadBinIt) / binsPerThread % THREADS) * 5));
+            }
+            finishOrder_.push_back(binIndex(thisThreadBinIt));
+
+            std::vector<bool> savedFiles(saveCursors_.getFileCount(), false);
+            for (std::size_t saved = 0; saved < savedFiles.size(); ++saved)
+            {
+                const std::size_t index = saveCursors_.waitForSlot(
+                    lock, stateChangedCondition_, forceTermination_, thisThreadBinIt, savedFiles);
+                ISAAC_BLOCK_WITH_CLENAUP(boost::bind(&SaveSimulation::returnSaveSlot, this, index, thisThreadBinsEndIt, _1))
+                {
+                    if (fileWriters_[index]++)
+                    {
+                        errors_.push_back("file written by two threads at once");
+                    }
+                    concurrentFileWrites_ += std::accumulate(fileWriters_.begin(), fileWriters_.end(), 0U) > 1;
+                    {
+                        common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                        for (alignment::BinMetadataCRefList::const_iterator binIt = thisThreadBinIt;
+                            thisThreadBinsEndIt != binIt; ++binIt)
+                        {
+                            fileWrittenBins_[index].push_back(binIndex(binIt));
+                        }
+                        // give the other files a chance to be written meanwhile
+                        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+                    }
+                    --fileWriters_[index];
+                }
+                savedFiles.at(index) = true;
+            }
+        }
+
+        while(!forceTermination_ && !saveCursors_.allSaved())
+        {
+            stateChangedCondition_.wait(lock);
+        }
+    }
+};
+
+static void checkInOrder(const SaveSimulation &simulation)
+{
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), simulation.getErrors().size());
+    CPPUNIT_ASSERT(simulation.allSaved());
+    std::vector<std::size_t> expected(BINS);
+    for (std::size_t i = 0; BINS != i; ++i)
+    {
+        expected[i] = i;
+    }
+    for (std::size_t fileIndex = 0; FILES != fileIndex; ++fileIndex)
+    {
+        CPPUNIT_ASSERT(expected == simulation.getWrittenBins(fileIndex));
+    }
+}
+
+void TestBinSaveCursors::testSequential()
+{
+    SaveSimulation simulation(FILES, BINS);
+    CPPUNIT_ASSERT(!simulation.allSaved());
+    simulation.run(1, 1);
+    CPPUNIT_ASSERT(std::is_sorted(simulation.getFinishOrder().begin(), simulation.getFinishOrder().end()));
+    checkInOrder(simulation);
+}
+
+void TestBinSaveCursors::testOutOfOrder()
+{
+    {
+        SaveSimulation simulation(FILES, BINS);
+        simulation.run(THREADS, 1);
+        // make sure the bins really did finish out of order
+        CPPUNIT_ASSERT(!std::is_sorted(simulation.getFinishOrder().begin(), simulation.getFinishOrder().end()));
+        checkInOrder(simulation);
+        // one thread saving one file while another one saves a different file
+        CPPUNIT_ASSERT(simulation.sawConcurrentFileWrites());
+    }
+    {
+        // threads taking several bins at a time
+        SaveSimulation simulation(FILES, BINS);
+        simulation.run(THREADS, 5);
+        CPPUNIT_ASSERT(!std::is_sorted(simulation.getFinishOrder().begin(), simulation.getFinishOrder().end()));
+        checkInOrder(simulation);
+    }
+}
+
+void TestBinSaveCursors::testTermination()
+{
+    std::vector<alignment::BinMetadata> bins(2);
+    const alignment::BinMetadataCRefList binRefs(bins.begin(), bins.end());
+    build::BinSaveCursors saveCursors(FILES, binRefs.begin(), binRefs.end());
+    boost::mutex stateMutex;
+    boost::condition_variable stateChangedCondition;
+    bool forceTermination = false;
+
+    boost::unique_lock<boost::mutex> lock(stateMutex);
+    std::vector<bool> savedFiles(FILES, false);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), saveCursors.waitForSlot(
+        lock, stateChangedCondition, forceTermination, binRefs.begin(), savedFiles));
+    savedFiles[0] = true;
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), saveCursors.waitForSlot(
+        lock, stateChangedCondition, forceTermination, binRefs.begin(), savedFiles));
+    saveCursors.returnSlot(0, binRefs.begin() + 1);
+
+    // second bin can go into the first file only. The failure on another thread must wake up the waiting one.
+    bool threw = false;
+    boost::thread waiter([&]()
+    {
+        boost::unique_lock<boost::mutex> waiterLock(stateMutex);
+        std::vector<bool> waiterSavedFiles(FILES, true);
+        waiterSavedFiles[1] = false;
+        try
+        {
+            saveCursors.waitForSlot(waiterLock, stateChangedCondition, forceTermination, binRefs.begin() + 1, waiterSavedFiles);
+        }
+        catch (common::ThreadingException &)
+        {
+            threw = true;
+        }
+    });
+    {
+        common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    forceTermination = true;
+    stateChangedCondition.notify_all();
+    {
+        common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+        waiter.join();
+    }
+    CPPUNIT_ASSERT(threw);
+    CPPUNIT_ASSERT(!saveCursors.allSaved());
+    for (std::size_t fileIndex = 0; FILES != fileIndex; ++fileIndex)
+    {
+        saveCursors.returnSlot(fileIndex, binRefs.end());
+    }
+    CPPUNIT_ASSERT(saveCursors.allSaved());
+}
@@ -0,0 +1,34 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BUILD_TEST_BIN_SAVE_CURSORS_HH
+#define iSAAC_BUILD_TEST_BIN_SAVE_CURSORS_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestBinSaveCursors : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBinSaveCursors );
+    CPPUNIT_TEST( testSequential );
+    CPPUNIT_TEST( testOutOfOrder );
+    CPPUNIT_TEST( testTermination );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {}
+    void tearDown() {}
+    void testSequential();
+    void testOutOfOrder();
+    void testTermination();
+};
+
+#endif // #ifndef iSAAC_BUILD_TEST_BIN_SAVE_CURSORS_HH
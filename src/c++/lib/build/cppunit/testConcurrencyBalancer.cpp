@@ -0,0 +1,107 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include "build/ConcurrencyBalancer.hh"
+
+using namespace isaac::build;
+
+#include "RegistryName.hh"
+#include "testConcurrencyBalancer.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestConcurrencyBalancer, registryName("TestConcurrencyBalancer"));
+
+static const uint64_t PLENTY_OF_MEMORY = 1000000000UL;
+
+/**
+ * \brief Feeds a window of loads and computes finishing at 'now'
+ */
+static void observe(
+    ConcurrencyBalancer &balancer,
+    const uint64_t now,
+    const unsigned loads,
+    const uint64_t bytesPerLoad,
+    const uint64_t loadTime,
+    const uint64_t stall,
+    const uint64_t computeTime)
+{
+    for (unsigned i = 0; loads != i; ++i)
+    {
+        balancer.binLoaded(now, bytesPerLoad, loadTime, stall);
+        balancer.binComputed(computeTime);
+    }
+}
+
+void TestConcurrencyBalancer::testDisabled()
+{
+    ConcurrencyBalancer balancer(false, 2, 8);
+    observe(balancer, 1000000, 4, 1000000, 1000000, 1000, 1);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+}
+
+void TestConcurrencyBalancer::testLoadBound()
+{
+    ConcurrencyBalancer balancer(true, 2, 8);
+    // not enough observations yet
+    observe(balancer, 1000000, 1, 1000000, 1000000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+
+    observe(balancer, 1000000, 1, 1000000, 1000000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::MoreLoaders, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+    balancer.applied(ConcurrencyBalancer::MoreLoaders);
+    CPPUNIT_ASSERT_EQUAL(3U, balancer.getLoadSlots());
+    CPPUNIT_ASSERT_EQUAL(7U, balancer.getComputeSlots());
+
+    // not enough free memory for the next bin
+    observe(balancer, 2000000, 3, 1000000, 1000000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(2000000, 1000, PLENTY_OF_MEMORY));
+}
+
+void TestConcurrencyBalancer::testSaturated()
+{
+    ConcurrencyBalancer balancer(true, 2, 8);
+    observe(balancer, 1000000, 2, 1000000, 1000000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::MoreLoaders, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+    balancer.applied(ConcurrencyBalancer::MoreLoaders);
+
+    // same amount of data in the same time with one more loader
+    observe(balancer, 2000000, 3, 666666, 1500000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::MoreComputers, balancer.decide(2000000, PLENTY_OF_MEMORY, 1000));
+    balancer.applied(ConcurrencyBalancer::MoreComputers);
+    CPPUNIT_ASSERT_EQUAL(2U, balancer.getLoadSlots());
+
+    // still load bound, but the ceiling prevents trying again
+    observe(balancer, 3000000, 2, 1000000, 1000000, 1000, 1000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(3000000, PLENTY_OF_MEMORY, 1000));
+}
+
+void TestConcurrencyBalancer::testComputeBound()
+{
+    ConcurrencyBalancer balancer(true, 2, 8);
+    observe(balancer, 1000000, 2, 1000000, 1000, 0, 1000000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::MoreComputers, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+    balancer.applied(ConcurrencyBalancer::MoreComputers);
+    CPPUNIT_ASSERT_EQUAL(1U, balancer.getLoadSlots());
+    CPPUNIT_ASSERT_EQUAL(9U, balancer.getComputeSlots());
+
+    // last load slot always stays
+    observe(balancer, 2000000, 2, 1000000, 1000, 0, 1000000);
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(2000000, PLENTY_OF_MEMORY, 1000));
+}
+
+void TestConcurrencyBalancer::testMemoryBound()
+{
+    ConcurrencyBalancer balancer(true, 2, 8);
+    observe(balancer, 1000000, 2, 1000000, 1000000, 1000, 1000);
+    balancer.allocationFailed();
+    CPPUNIT_ASSERT_EQUAL(ConcurrencyBalancer::Keep, balancer.decide(1000000, PLENTY_OF_MEMORY, 1000));
+}
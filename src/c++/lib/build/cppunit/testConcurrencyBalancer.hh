@@ -0,0 +1,38 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_BUILD_TEST_CONCURRENCY_BALANCER_HH
+#define iSAAC_BUILD_TEST_CONCURRENCY_BALANCER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestConcurrencyBalancer : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestConcurrencyBalancer );
+    CPPUNIT_TEST( testDisabled );
+    CPPUNIT_TEST( testLoadBound );
+    CPPUNIT_TEST( testSaturated );
+    CPPUNIT_TEST( testComputeBound );
+    CPPUNIT_TEST( testMemoryBound );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp() {}
+    void tearDown() {}
+    void testDisabled();
+    void testLoadBound();
+    void testSaturated();
+    void testComputeBound();
+    void testMemoryBound();
+};
+
+#endif // #ifndef iSAAC_BUILD_TEST_CONCURRENCY_BALANCER_HH
@@ -121,141 +121,177 @@ void testNoDifferences(std::vector<IndexT> bin, std::vector<IndexT>  expectedUni
 TestDuplicateFiltering::TestDuplicateFiltering():
         //common pairs
         fLeft1Frp_(ReferencePosition(0, 0),
-                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3),
+                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3, 0, 0),
         fLeft2Frp_(ReferencePosition(0, 0),
-                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2),
+                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2, 0, 0),
         fLeft3Frp_(ReferencePosition(0, 0),
-                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3),
+                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3, 0, 0),
 
         rRight1Frp_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         rRight2Frp_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2),
+                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2, 0, 0),
         rRight3Frp_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
 
         fLeft1Ffp_(ReferencePosition(0, 0),
-                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3),
+                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3, 0, 0),
         fLeft2Ffp_(ReferencePosition(0, 0),
-                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 2),
+                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 2, 0, 0),
 
         fRight1Ffp_(ReferencePosition(0, 200),
-                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         fRight2Ffp_(ReferencePosition(0, 200),
-                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2),
+                    FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2, 0, 0),
 
         rLeft1Rrp_(ReferencePosition(0, 0), FragmentIndexAnchor(100),
-                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3),
+                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3, 0, 0),
         rLeft2Rrp_(ReferencePosition(0, 0), FragmentIndexAnchor(100),
-                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2),
+                   FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2, 0, 0),
 
         rRight1Rrp_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3),
+                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3, 0, 0),
         rRight2Rrp_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 2),
+                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 2, 0, 0),
 
         rLeft1Rfp_(ReferencePosition(0, 0), FragmentIndexAnchor(100),
-                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3),
+                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3, 0, 0),
         rLeft2Rfp_(ReferencePosition(0, 0), FragmentIndexAnchor(100),
-                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 2),
+                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 2, 0, 0),
         rLeft3Rfp_(ReferencePosition(0, 0), FragmentIndexAnchor(100),
-                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3),
+                   FragmentIndexMate(false, false, 0, FragmentIndexAnchor(200)), 3, 0, 0),
 
         fRight1Rfp_(ReferencePosition(0, 200),
-                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3),
+                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3, 0, 0),
         fRight2Rfp_(ReferencePosition(0, 200),
-                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 2),
+                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 2, 0, 0),
         fRight3Rfp_(ReferencePosition(0, 200),
-                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3),
+                    FragmentIndexMate(false, true, 1, FragmentIndexAnchor(100)), 3, 0, 0),
 
         // pairs with reverse-stranded mates stored in different bins
         fLeft1FrpMb1_(ReferencePosition(0, 0),
-                      FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3),
+                      FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 3, 0, 0),
         fLeft2FrpMb1_(ReferencePosition(0, 0),
-                      FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2),
+                      FragmentIndexMate(false, true, 1, FragmentIndexAnchor(300)), 2, 0, 0),
         fLeft3FrpMb0_(ReferencePosition(0, 0),
-                      FragmentIndexMate(false, true, 0, FragmentIndexAnchor(300)), 3),
+                      FragmentIndexMate(false, true, 0, FragmentIndexAnchor(300)), 3, 0, 0),
         fLeft4FrpMb0_(ReferencePosition(0, 0),
-                      FragmentIndexMate(false, true, 0, FragmentIndexAnchor(300)), 3),
+                      FragmentIndexMate(false, true, 0, FragmentIndexAnchor(300)), 3, 0, 0),
 
         rRight1FrpMb1_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         rRight2FrpMb1_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2),
+                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2, 0, 0),
         rRight3FrpMb0_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         rRight4FrpMb0_(ReferencePosition(0, 200), FragmentIndexAnchor(300),
-                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                       FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
 
 //        // FSingleton-shadow cases
         f1Fsh_(ReferencePosition(0, 0),
-               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x0123012301230123)), 3),
+               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x0123012301230123)), 3, 0, 0),
         f2Fsh_(ReferencePosition(0, 0),
-               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x0123012301230123)), 2),
+               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x0123012301230123)), 2, 0, 0),
         f3Fsh_(ReferencePosition(0, 0),
-               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x1230123012301230)), 3),
+               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x1230123012301230)), 3, 0, 0),
         f4Fsh_(ReferencePosition(0, 0),
-               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x1230123012301230)), 3),
+               FragmentIndexMate(true, false, 0, FragmentIndexAnchor(0x1230123012301230)), 3, 0, 0),
 
         sh1Fsh_(ReferencePosition(0, 0), FragmentIndexAnchor(0x0123012301230123),
-                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         sh2Fsh_(ReferencePosition(0, 0), FragmentIndexAnchor(0x0123012301230123),
-                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2),
+                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 2, 0, 0),
         sh3Fsh_(ReferencePosition(0, 0), FragmentIndexAnchor(0x1230123012301230),
-                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3),
+                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0),
         sh4Fsh_(ReferencePosition(0, 0), FragmentIndexAnchor(0x1230123012301230),
-                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3)
+                FragmentIndexMate(false, false, 0, FragmentIndexAnchor(0)), 3, 0, 0)
 
 {
     fLeft1Frp_.dataOffset_ = 0 * sizeof(isaac::io::FragmentHeader);
+    fLeft1Frp_.globalClusterId_ = fLeft1Frp_.dataOffset_;
     fLeft2Frp_.dataOffset_ = 1 * sizeof(isaac::io::FragmentHeader);
+    fLeft2Frp_.globalClusterId_ = fLeft2Frp_.dataOffset_;
     fLeft3Frp_.dataOffset_ = 2 * sizeof(isaac::io::FragmentHeader);
+    fLeft3Frp_.globalClusterId_ = fLeft3Frp_.dataOffset_;
 
     rRight1Frp_.dataOffset_ = 1000 * sizeof(isaac::io::FragmentHeader);
+    rRight1Frp_.globalClusterId_ = rRight1Frp_.dataOffset_;
     rRight2Frp_.dataOffset_ = 1001 * sizeof(isaac::io::FragmentHeader);
+    rRight2Frp_.globalClusterId_ = rRight2Frp_.dataOffset_;
     rRight3Frp_.dataOffset_ = 1002 * sizeof(isaac::io::FragmentHeader);
+    rRight3Frp_.globalClusterId_ = rRight3Frp_.dataOffset_;
 
     fLeft1Ffp_.dataOffset_ = 10 * sizeof(isaac::io::FragmentHeader);
+    fLeft1Ffp_.globalClusterId_ = fLeft1Ffp_.dataOffset_;
     fLeft2Ffp_.dataOffset_ = 11 * sizeof(isaac::io::FragmentHeader);
+    fLeft2Ffp_.globalClusterId_ = fLeft2Ffp_.dataOffset_;
 
     fRight1Ffp_.dataOffset_ = 1010 * sizeof(isaac::io::FragmentHeader);
+    fRight1Ffp_.globalClusterId_ = fRight1Ffp_.dataOffset_;
     fRight2Ffp_.dataOffset_ = 1011 * sizeof(isaac::io::FragmentHeader);
+    fRight2Ffp_.globalClusterId_ = fRight2Ffp_.dataOffset_;
 
     rLeft1Rrp_.dataOffset_ = 20 * sizeof(isaac::io::FragmentHeader);
+    rLeft1Rrp_.globalClusterId_ = rLeft1Rrp_.dataOffset_;
     rLeft2Rrp_.dataOffset_ = 21 * sizeof(isaac::io::FragmentHeader);
+    rLeft2Rrp_.globalClusterId_ = rLeft2Rrp_.dataOffset_;
 
     rRight1Rrp_.dataOffset_ = 1020 * sizeof(isaac::io::FragmentHeader);
+    rRight1Rrp_.globalClusterId_ = rRight1Rrp_.dataOffset_;
     rRight2Rrp_.dataOffset_ = 1021 * sizeof(isaac::io::FragmentHeader);
+    rRight2Rrp_.globalClusterId_ = rRight2Rrp_.dataOffset_;
 
     rLeft1Rfp_.dataOffset_ = 30 * sizeof(isaac::io::FragmentHeader);
+    rLeft1Rfp_.globalClusterId_ = rLeft1Rfp_.dataOffset_;
     rLeft2Rfp_.dataOffset_ = 31 * sizeof(isaac::io::FragmentHeader);
+    rLeft2Rfp_.globalClusterId_ = rLeft2Rfp_.dataOffset_;
     rLeft3Rfp_.dataOffset_ = 32 * sizeof(isaac::io::FragmentHeader);
+    rLeft3Rfp_.globalClusterId_ = rLeft3Rfp_.dataOffset_;
 
     fRight1Rfp_.dataOffset_ = 1030 * sizeof(isaac::io::FragmentHeader);
+    fRight1Rfp_.globalClusterId_ = fRight1Rfp_.dataOffset_;
     fRight2Rfp_.dataOffset_ = 1031 * sizeof(isaac::io::FragmentHeader);
+    fRight2Rfp_.globalClusterId_ = fRight2Rfp_.dataOffset_;
     fRight3Rfp_.dataOffset_ = 1032 * sizeof(isaac::io::FragmentHeader);
+    fRight3Rfp_.globalClusterId_ = fRight3Rfp_.dataOffset_;
 
     // pairs with reverse-stranded mates stored in different bins
     fLeft1FrpMb1_.dataOffset_ = 40 * sizeof(isaac::io::FragmentHeader);
+    fLeft1FrpMb1_.globalClusterId_ = fLeft1FrpMb1_.dataOffset_;
     fLeft2FrpMb1_.dataOffset_ = 41 * sizeof(isaac::io::FragmentHeader);
+    fLeft2FrpMb1_.globalClusterId_ = fLeft2FrpMb1_.dataOffset_;
     fLeft3FrpMb0_.dataOffset_ = 42 * sizeof(isaac::io::FragmentHeader);
+    fLeft3FrpMb0_.globalClusterId_ = fLeft3FrpMb0_.dataOffset_;
     fLeft4FrpMb0_.dataOffset_ = 43 * sizeof(isaac::io::FragmentHeader);
+    fLeft4FrpMb0_.globalClusterId_ = fLeft4FrpMb0_.dataOffset_;
 
     rRight1FrpMb1_.dataOffset_ = 1040 * sizeof(isaac::io::FragmentHeader);
+    rRight1FrpMb1_.globalClusterId_ = rRight1FrpMb1_.dataOffset_;
     rRight2FrpMb1_.dataOffset_ = 1041 * sizeof(isaac::io::FragmentHeader);
+    rRight2FrpMb1_.globalClusterId_ = rRight2FrpMb1_.dataOffset_;
     rRight3FrpMb0_.dataOffset_ = 1042 * sizeof(isaac::io::FragmentHeader);
+    rRight3FrpMb0_.globalClusterId_ = rRight3FrpMb0_.dataOffset_;
     rRight4FrpMb0_.dataOffset_ = 1043 * sizeof(isaac::io::FragmentHeader);
+    rRight4FrpMb0_.globalClusterId_ = rRight4FrpMb0_.dataOffset_;
 
 //        // FSingleton-shadow cases
     f1Fsh_.dataOffset_ = 50 * sizeof(isaac::io::FragmentHeader);
+    f1Fsh_.globalClusterId_ = f1Fsh_.dataOffset_;
     f2Fsh_.dataOffset_ = 51 * sizeof(isaac::io::FragmentHeader);
+    f2Fsh_.globalClusterId_ = f2Fsh_.dataOffset_;
     f3Fsh_.dataOffset_ = 52 * sizeof(isaac::io::FragmentHeader);
+    f3Fsh_.globalClusterId_ = f3Fsh_.dataOffset_;
     f4Fsh_.dataOffset_ = 53 * sizeof(isaac::io::FragmentHeader);
+    f4Fsh_.globalClusterId_ = f4Fsh_.dataOffset_;
 
     sh1Fsh_.dataOffset_ = 1050 * sizeof(isaac::io::FragmentHeader);
+    sh1Fsh_.globalClusterId_ = sh1Fsh_.dataOffset_;
     sh2Fsh_.dataOffset_ = 1051 * sizeof(isaac::io::FragmentHeader);
+    sh2Fsh_.globalClusterId_ = sh2Fsh_.dataOffset_;
     sh3Fsh_.dataOffset_ = 1052 * sizeof(isaac::io::FragmentHeader);
+    sh3Fsh_.globalClusterId_ = sh3Fsh_.dataOffset_;
     sh4Fsh_.dataOffset_ = 1053 * sizeof(isaac::io::FragmentHeader);
+    sh4Fsh_.globalClusterId_ = sh4Fsh_.dataOffset_;
 
 }
 
@@ -348,9 +348,32 @@ void addGaps(const std::string &ref, const std::string &gaps, RealignerGapsT &re
     }
 }
 
+const isaac::flowcell::BarcodeMetadataList &getBarcodeMetadataList()
+{
+    static isaac::flowcell::BarcodeMetadataList barcodeMetadataList(1);
+    barcodeMetadataList.at(0).setUnknown();
+    barcodeMetadataList.at(0).setIndex(0);
+    barcodeMetadataList.at(0).setReferenceIndex(0);
+    return barcodeMetadataList;
+}
+
+reference::ContigLists makeContigLists(const std::string &ref)
+{
+    std::string contig;
+    std::remove_copy_if(ref.begin(), ref.end(), std::back_inserter(contig),
+                        [](char c){return c == '*' || c == ' ';});
+
+    reference::ContigLists contigLists;
+    contigLists.push_back(TestContigList(contig));
+    return contigLists;
+}
+
+/**
+ * \brief realigns with the supplied realigner so that the state it keeps between fragments can be tested
+ */
 RealignResult realign(
-    const unsigned mismatchCost,
-    const unsigned gapOpenCost,
+    build::GapRealigner &realigner,
+    const reference::ContigLists &contigLists,
     const std::string &read,
     const std::string &ref,
     const build::gapRealigner::RealignerGaps &realignerGaps,
@@ -363,26 +386,13 @@ RealignResult realign(
     const TestFragmentAccessor fragment = initFragment(init, read, ref);
 //        oligo::bclToString(fragment.basesBegin(), fragment.basesEnd() - fragment.basesBegin()) << " " << fragment << std::endl;
 
-    std::string contig;
-    std::remove_copy_if(ref.begin(), ref.end(), std::back_inserter(contig),
-                        [](char c){return c == '*' || c == ' ';});
-
-    reference::ContigLists contigLists;
-    contigLists.push_back(TestContigList(contig));
-
     if (binEndPos.isNoMatch())
     {
         binEndPos = binStartPos + contigLists.at(0).at(0).size();
         ISAAC_THREAD_CERR << "binEndPos:" << binEndPos << std::endl;
     }
 
-
-    isaac::flowcell::BarcodeMetadataList barcodeMetadataList(1);
-    barcodeMetadataList.at(0).setUnknown();
-    barcodeMetadataList.at(0).setIndex(0);
-    barcodeMetadataList.at(0).setReferenceIndex(0);
-
-    alignment::BinMetadata bin(barcodeMetadataList.size(), 0, reference::ReferencePosition(0,0), 1000000, "tada");
+    alignment::BinMetadata bin(getBarcodeMetadataList().size(), 0, reference::ReferencePosition(0,0), 1000000, "tada");
 
     static build::gapRealigner::Gaps foundGaps;
     foundGaps.reserve(100000);
@@ -394,30 +404,45 @@ RealignResult realign(
     build::PackedFragmentBuffer dataBuffer;
     alignment::BinMetadata realBin(bin);
     realBin.incrementDataSize(isaac::reference::ReferencePosition(0,0), sizeof(fragment));
-    realBin.incrementCigarLength(isaac::reference::ReferencePosition(0,0), 1024, 0);
+    realBin.incrementCigarLength(isaac::reference::ReferencePosition(0,0), 1024, 0, 0);
     dataBuffer.resize(realBin);
     std::copy(fragment.begin(), fragment.end(), dataBuffer.begin());
 
     build::PackedFragmentBuffer::Index index(fragment.fStrandPosition_, 0, 0,
-                                             fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse());
+                                             fragment.cigarBegin(), fragment.cigarEnd(), fragment.isReverse(), 0);
 
     const unsigned realignedGapsPerFragment = 8;
     alignment::Cigar realignedCigars; realignedCigars.reserve(1024);
     realignedCigars.reserve(realBin.getTotalCigarLength() + realBin.getTotalElements() * (1 + realignedGapsPerFragment * 2));
-    build::GapRealigner realigner(false, false, 4, mismatchCost, gapOpenCost, 0, false, barcodeMetadataList);
-    realigner.realign(realignerGaps, binStartPos, binEndPos, index, dataBuffer.getFragment(index), dataBuffer, realignedCigars, contigLists);
+    reference::ReferencePosition newRStrandPosition;
+    unsigned short newEditDistance = 0;
+    const bool realigned = realigner.realign(
+        realignerGaps, binStartPos, binEndPos, dataBuffer.getFragment(index), index,
+        newRStrandPosition, newEditDistance, dataBuffer, realignedCigars, contigLists);
 
     ret.realignedPos_ = index.pos_;
     ret.realignedCigar_ = alignment::Cigar::toString(index.cigarBegin_, index.cigarEnd_);
-    const io::FragmentAccessor &updatedFragment = dataBuffer.getFragment(index);
-// this is broken until updatePairDetails is called.
-//    CPPUNIT_ASSERT_EQUAL(updatedFragment.fStrandPosition_, index.pos_);
-
-    ret.realignedEditDistance_ = updatedFragment.editDistance_;
+    // the fragment itself is not updated until updatePairDetails is called.
+    ret.realignedEditDistance_ = realigned ? newEditDistance : dataBuffer.getFragment(index).editDistance_;
 
     return ret;
 }
 
+RealignResult realign(
+    const unsigned mismatchCost,
+    const unsigned gapOpenCost,
+    const std::string &read,
+    const std::string &ref,
+    const build::gapRealigner::RealignerGaps &realignerGaps,
+    const io::FragmentHeader &init,
+    const reference::ReferencePosition binStartPos = reference::ReferencePosition(0, 0),
+    reference::ReferencePosition binEndPos = reference::ReferencePosition(reference::ReferencePosition::NoMatch))
+{
+    const reference::ContigLists contigLists = makeContigLists(ref);
+    build::GapRealigner realigner(false, false, 4, mismatchCost, gapOpenCost, 0, getBarcodeMetadataList());
+    return realign(realigner, contigLists, read, ref, realignerGaps, init, binStartPos, binEndPos);
+}
+
 RealignResult realign(
     const std::string &read,
     const std::string &ref,
@@ -1804,3 +1829,103 @@ void TestGapRealigner::testFull11()
 
 }
 
+namespace
+{
+
+build::gapRealigner::RealignerGaps makeRealignerGaps(const std::string &ref, const std::string &gaps)
+{
+    build::gapRealigner::RealignerGaps ret;
+    addGaps(ref, gaps, ret);
+    ret.finalizeGaps();
+    return ret;
+}
+
+void assertSameResult(const RealignResult &expected, const RealignResult &actual)
+{
+    CPPUNIT_ASSERT_EQUAL(expected.originalCigar_, actual.originalCigar_);
+    CPPUNIT_ASSERT_EQUAL(expected.realignedPos_, actual.realignedPos_);
+    CPPUNIT_ASSERT_EQUAL(expected.realignedCigar_, actual.realignedCigar_);
+    CPPUNIT_ASSERT_EQUAL(int(expected.realignedEditDistance_), int(actual.realignedEditDistance_));
+}
+
+} // namespace
+
+void TestGapRealigner::testGapChoiceCache()
+{
+    const std::string read = "GACCTCAATCAGGCAATATGAAGTTGCAGGAACTGGAAGAGGAGAGATAGTTCAGGCTTATCTTGGCCATACCATTCTTCTCAAGAACCACTACTTCCTT";
+    const std::string ref =  "GACTCAATCAGGCAATATGAAGTTGCAGGAACTGGAAGAGGAGAGATAGTCAGGCTTATCTTGGCATACCATTCTCAAGAACCACTACTTCCTTAAAAAA";
+    const std::string gaps = "  *                                              *              *      ***";
+
+    // fresh realigner has nothing cached
+    const RealignResult uncached = realign(read, ref, gaps);
+    CPPUNIT_ASSERT_EQUAL(std::string("2M1I47M1I15M1I7M3I23M"), uncached.realignedCigar_);
+
+    const reference::ContigLists contigLists = makeContigLists(ref);
+    const build::gapRealigner::RealignerGaps realignerGaps = makeRealignerGaps(ref, gaps);
+    build::GapRealigner realigner(false, false, 4, 1, 0, 0, getBarcodeMetadataList());
+    assertSameResult(uncached, realign(realigner, contigLists, read, ref, realignerGaps, io::FragmentHeader()));
+    const uint64_t misses = realigner.getGapChoiceCacheMisses();
+    const uint64_t hits = realigner.getGapChoiceCacheHits();
+    CPPUNIT_ASSERT(misses);
+
+    // a pile of identical fragments reuses the evaluations of the first one
+    for (unsigned i = 0; 3 != i; ++i)
+    {
+        assertSameResult(uncached, realign(realigner, contigLists, read, ref, realignerGaps, io::FragmentHeader()));
+        CPPUNIT_ASSERT_EQUAL(misses, realigner.getGapChoiceCacheMisses());
+        CPPUNIT_ASSERT(hits < realigner.getGapChoiceCacheHits());
+    }
+}
+
+void TestGapRealigner::testGapChoiceCacheInvalidation()
+{
+    const std::string read = "GACCTCAATCAGGCAATATGAAGTTGCAGGAACTGGAAGAGGAGAGATAGTTCAGGCTTATCTTGGCCATACCATTCTTCTCAAGAACCACTACTTCCTT";
+    const std::string ref =  "GACCTCAATCAGGCAATATGAAGTTGCAGGAACTGGAAGAGGAGAGATAGTTCAGGCTTATCTTGGCCATACCATTCTCAAGAACCACTACTTCCTTAAAAAAAA";
+    const std::string gaps = "                                                                          ***";
+
+    const reference::ContigLists contigLists = makeContigLists(ref);
+    const build::gapRealigner::RealignerGaps realignerGaps = makeRealignerGaps(ref, gaps);
+    build::GapRealigner realigner(false, false, 4, 1, 0, 0, getBarcodeMetadataList());
+
+    // each case first fills the cache with evaluations that favor the insertion
+    const RealignResult warm = realign(read, ref, gaps);
+    CPPUNIT_ASSERT_EQUAL(std::string("74M3I23M"), warm.realignedCigar_);
+
+    {
+        // same fragment, the insertion is not among the gaps
+        const std::string otherGaps = "                    ***";
+        assertSameResult(warm, realign(realigner, contigLists, read, ref, realignerGaps, io::FragmentHeader()));
+        const uint64_t misses = realigner.getGapChoiceCacheMisses();
+        const RealignResult expected = realign(read, ref, otherGaps);
+        CPPUNIT_ASSERT_EQUAL(std::string("100M"), expected.realignedCigar_);
+        assertSameResult(expected, realign(realigner, contigLists, read, ref,
+                                           makeRealignerGaps(ref, otherGaps), io::FragmentHeader()));
+        CPPUNIT_ASSERT(misses < realigner.getGapChoiceCacheMisses());
+    }
+
+    {
+        // same start position and gaps, but the bases match the reference with a single mismatch
+        std::string otherRead = ref.substr(0, read.size());
+        otherRead[10] = 'A' == otherRead[10] ? 'C' : 'A';
+        assertSameResult(warm, realign(realigner, contigLists, read, ref, realignerGaps, io::FragmentHeader()));
+        const uint64_t misses = realigner.getGapChoiceCacheMisses();
+        const RealignResult expected = realign(otherRead, ref, gaps);
+        CPPUNIT_ASSERT_EQUAL(std::string("100M"), expected.realignedCigar_);
+        assertSameResult(expected, realign(realigner, contigLists, otherRead, ref, realignerGaps, io::FragmentHeader()));
+        CPPUNIT_ASSERT(misses < realigner.getGapChoiceCacheMisses());
+    }
+
+    {
+        // same fragment and gaps against a different reference that does not have the insertion
+        std::string otherRef = read + "AAAAAAAA";
+        otherRef[10] = 'A' == otherRef[10] ? 'C' : 'A';
+        const reference::ContigLists otherContigLists = makeContigLists(otherRef);
+        assertSameResult(warm, realign(realigner, contigLists, read, ref, realignerGaps, io::FragmentHeader()));
+        const uint64_t misses = realigner.getGapChoiceCacheMisses();
+        const RealignResult expected = realign(read, otherRef, gaps);
+        CPPUNIT_ASSERT_EQUAL(std::string("100M"), expected.realignedCigar_);
+        assertSameResult(expected, realign(realigner, otherContigLists, read, otherRef,
+                                           makeRealignerGaps(otherRef, gaps), io::FragmentHeader()));
+        CPPUNIT_ASSERT(misses < realigner.getGapChoiceCacheMisses());
+    }
+}
@@ -0,0 +1,117 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <cstdlib>
+
+#include "alignment/Mismatch.hh"
+#include "build/gapRealigner/MismatchProfiles.hh"
+
+using namespace isaac;
+using isaac::build::gapRealigner::MismatchProfiles;
+
+#include "BuilderInit.hh"
+#include "RegistryName.hh"
+#include "testMismatchProfiles.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMismatchProfiles, registryName("TestMismatchProfiles"));
+
+static std::string randomReference(const unsigned length)
+{
+    static const char bases[] = "ACGTN";
+    std::string ret;
+    for (unsigned i = 0; length != i; ++i)
+    {
+        ret.push_back(bases[std::rand() % 5]);
+    }
+    return ret;
+}
+
+/**
+ * \brief bcl read that mostly matches reference at pos. Includes some N
+ */
+static std::vector<unsigned char> randomRead(const std::string &reference, const unsigned pos, const unsigned length)
+{
+    std::vector<unsigned char> ret;
+    for (unsigned i = 0; length != i; ++i)
+    {
+        const char refBase = pos + i < reference.size() ? reference[pos + i] : 'A';
+        const char base = (std::rand() % 4) ? refBase : "ACGTN"[std::rand() % 5];
+        ret.push_back('N' == base ? 0 : (30 << 2) | oligo::getValue(base));
+    }
+    return ret;
+}
+
+static void checkAll(
+    const reference::ContigList &contigList,
+    const std::vector<unsigned char> &read,
+    MismatchProfiles &profiles,
+    const unsigned contigLength)
+{
+    profiles.reset(contigList, &read.front(), read.size());
+    for (unsigned offset = 0; read.size() > offset; offset += 7)
+    {
+        for (unsigned pos = 0; contigLength > pos; pos += 3)
+        {
+            for (unsigned length = 0; read.size() - offset >= length; length += 11)
+            {
+                const reference::ReferencePosition refPos(0, pos);
+                CPPUNIT_ASSERT_EQUAL(
+                    alignment::countEditDistanceMismatches(contigList, &read.front() + offset, refPos, length),
+                    profiles.countMismatches(offset, refPos, length));
+            }
+        }
+    }
+}
+
+void TestMismatchProfiles::testAgainstBaseByBase()
+{
+    std::srand(1);
+    const std::string reference = randomReference(400);
+    const TestContigList contigList(reference);
+    MismatchProfiles profiles;
+    profiles.reserve(300, 1000);
+
+    for (unsigned readLength = 1; 300 > readLength; readLength += 37)
+    {
+        checkAll(contigList, randomRead(reference, 50, readLength), profiles, reference.size() - readLength);
+    }
+}
+
+void TestMismatchProfiles::testContigEdges()
+{
+    std::srand(2);
+    const std::string reference = randomReference(100);
+    const TestContigList contigList(reference);
+    MismatchProfiles profiles;
+    profiles.reserve(150, 1000);
+
+    // reads hanging over the contig end and diagonals that start before the contig
+    checkAll(contigList, randomRead(reference, 20, 150), profiles, reference.size());
+    CPPUNIT_ASSERT(profiles.getProfilesCount());
+}
+
+void TestMismatchProfiles::testOutOfProfiles()
+{
+    std::srand(3);
+    const std::string reference = randomReference(300);
+    const TestContigList contigList(reference);
+    MismatchProfiles profiles;
+    profiles.reserve(100, 2);
+
+    checkAll(contigList, randomRead(reference, 0, 100), profiles, reference.size() - 100);
+    CPPUNIT_ASSERT_EQUAL(2U, profiles.getProfilesCount());
+
+    // read too long for the reserved space falls back to base by base counting
+    checkAll(contigList, randomRead(reference, 0, 101), profiles, reference.size() - 101);
+    CPPUNIT_ASSERT_EQUAL(0U, profiles.getProfilesCount());
+}
@@ -0,0 +1,142 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MismatchProfiles.cpp
+ **
+ ** Gap realigner implementation details.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "alignment/Mismatch.hh"
+#include "build/gapRealigner/MismatchProfiles.hh"
+#include "oligo/Nucleotides.hh"
+
+namespace isaac
+{
+namespace build
+{
+namespace gapRealigner
+{
+
+void MismatchProfiles::reserve(const unsigned readLengthMax, const unsigned profilesMax)
+{
+    readBases_.reserve(readLengthMax);
+    diagonals_.reserve(profilesMax);
+    masks_.resize(profilesMax * ((readLengthMax + BITS_PER_WORD - 1) / BITS_PER_WORD));
+}
+
+void MismatchProfiles::reset(
+    const reference::ContigList &reference,
+    const unsigned char *bases,
+    const unsigned readLength)
+{
+    reference_ = &reference;
+    bclBases_ = bases;
+    readLength_ = readLength;
+    diagonals_.clear();
+    profiles_ = 0;
+    enabled_ = readBases_.capacity() >= readLength && diagonals_.capacity();
+    if (enabled_)
+    {
+        wordsPerProfile_ = (readLength + BITS_PER_WORD - 1) / BITS_PER_WORD;
+        readBases_.clear();
+        std::transform(bases, bases + readLength, std::back_inserter(readBases_), &oligo::getReferenceBaseFromBcl);
+    }
+}
+
+void MismatchProfiles::buildProfile(const Diagonal &diagonal, uint64_t *mask) const
+{
+    std::fill(mask, mask + wordsPerProfile_, 0);
+
+    const reference::Contig &contig = reference_->at(diagonal.contigId_);
+    const int64_t begin = std::max<int64_t>(0, -diagonal.shift_);
+    const int64_t end = std::min<int64_t>(readLength_, int64_t(contig.size()) - diagonal.shift_);
+    const char *read = &readBases_.front();
+    const char *ref = &*contig.begin();
+
+    int64_t i = begin;
+#ifdef __SSE2__
+    for (; i + 16 <= end; i += 16)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(read + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref + diagonal.shift_ + i));
+        const uint64_t mismatches = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) & 0xffff;
+        const unsigned word = i / BITS_PER_WORD;
+        const unsigned offset = i % BITS_PER_WORD;
+        mask[word] |= mismatches << offset;
+        if (offset > BITS_PER_WORD - 16)
+        {
+            mask[word + 1] |= mismatches >> (BITS_PER_WORD - offset);
+        }
+    }
+#endif // __SSE2__
+    for (; i < end; ++i)
+    {
+        mask[i / BITS_PER_WORD] |= uint64_t(read[i] != ref[diagonal.shift_ + i]) << (i % BITS_PER_WORD);
+    }
+}
+
+const uint64_t *MismatchProfiles::getProfile(const Diagonal &diagonal)
+{
+    std::vector<Diagonal>::const_iterator it = std::find(diagonals_.begin(), diagonals_.end(), diagonal);
+    if (diagonals_.end() != it)
+    {
+        return &masks_.at(std::distance<std::vector<Diagonal>::const_iterator>(diagonals_.begin(), it) * wordsPerProfile_);
+    }
+
+    if (diagonals_.capacity() == diagonals_.size())
+    {
+        return 0;
+    }
+
+    uint64_t *mask = &masks_.at(diagonals_.size() * wordsPerProfile_);
+    buildProfile(diagonal, mask);
+    diagonals_.push_back(diagonal);
+    ++profiles_;
+    return mask;
+}
+
+unsigned MismatchProfiles::countMismatches(
+    const unsigned readOffset,
+    const reference::ReferencePosition pos,
+    const unsigned length)
+{
+    const uint64_t *mask = enabled_ ?
+        getProfile(Diagonal(pos.getContigId(), int64_t(pos.getPosition()) - readOffset)) : 0;
+    if (!mask)
+    {
+        return alignment::countEditDistanceMismatches(*reference_, bclBases_ + readOffset, pos, length);
+    }
+
+    const unsigned end = std::min(readLength_, readOffset + length);
+    unsigned ret = 0;
+    for (unsigned i = readOffset; i < end;)
+    {
+        const unsigned offset = i % BITS_PER_WORD;
+        const unsigned bits = std::min(BITS_PER_WORD - offset, end - i);
+        const uint64_t word = mask[i / BITS_PER_WORD] >> offset;
+        ret += __builtin_popcountll(BITS_PER_WORD == bits ? word : word & ((uint64_t(1) << bits) - 1));
+        i += bits;
+    }
+    return ret;
+}
+
+} // namespace gapRealigner
+} // namespace build
+} // namespace isaac
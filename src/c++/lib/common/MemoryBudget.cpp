@@ -0,0 +1,136 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryBudget.cpp
+ **
+ ** \brief See MemoryBudget.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <limits>
+
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/MemoryBudget.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+MemoryBudget::MemoryBudget(const uint64_t limit) :
+    limit_(limit), reserved_(0), highWater_(0)
+{
+    subsystemReserved_.assign(0);
+    subsystemHighWater_.assign(0);
+}
+
+void MemoryBudget::configure(const uint64_t limit)
+{
+    MemoryBudget &budget = instance();
+    boost::lock_guard<boost::mutex> lock(budget.mutex_);
+    budget.limit_ = limit;
+}
+
+MemoryBudget &MemoryBudget::instance()
+{
+    static MemoryBudget processBudget(0);
+    return processBudget;
+}
+
+const char *MemoryBudget::getSubsystemName(const Subsystem subsystem)
+{
+    static const char *names[SubsystemCount] =
+        {"Reference", "Hash", "TileBuffers", "FragmentBinner", "BuildBins", "Bgzf", "BinsInMemory", "UnpairedReads"};
+    ISAAC_ASSERT_MSG(SubsystemCount > subsystem, "Unknown subsystem " << subsystem);
+    return names[subsystem];
+}
+
+bool MemoryBudget::reserveLocked(const Subsystem subsystem, const uint64_t bytes)
+{
+    if (limit_ && limit_ - reserved_ < bytes)
+    {
+        return false;
+    }
+    reserved_ += bytes;
+    highWater_ = std::max(highWater_, reserved_);
+    subsystemReserved_.at(subsystem) += bytes;
+    subsystemHighWater_.at(subsystem) = std::max(subsystemHighWater_.at(subsystem), subsystemReserved_.at(subsystem));
+    return true;
+}
+
+void MemoryBudget::reserve(const Subsystem subsystem, const uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (!reserveLocked(subsystem, bytes))
+    {
+        std::string reserved;
+        for (unsigned other = 0; other < SubsystemCount; ++other)
+        {
+            reserved += (boost::format(" %s:%d") % getSubsystemName(Subsystem(other)) % subsystemReserved_.at(other)).str();
+        }
+        BOOST_THROW_EXCEPTION(MemoryException((boost::format(
+            "%s requires %d bytes while only %d out of %d bytes of memory limit are available. Reserved:%s") %
+            getSubsystemName(subsystem) % bytes % (limit_ - reserved_) % limit_ % reserved).str()));
+    }
+}
+
+bool MemoryBudget::tryReserve(const Subsystem subsystem, const uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return reserveLocked(subsystem, bytes);
+}
+
+void MemoryBudget::release(const Subsystem subsystem, const uint64_t bytes)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(subsystemReserved_.at(subsystem) >= bytes, "Releasing more than reserved for " <<
+                     getSubsystemName(subsystem) << ": " << bytes << " > " << subsystemReserved_.at(subsystem));
+    subsystemReserved_.at(subsystem) -= bytes;
+    reserved_ -= bytes;
+}
+
+uint64_t MemoryBudget::getAvailable() const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return limit_ ? limit_ - reserved_ : std::numeric_limits<uint64_t>::max();
+}
+
+uint64_t MemoryBudget::getReserved() const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return reserved_;
+}
+
+uint64_t MemoryBudget::getReserved(const Subsystem subsystem) const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return subsystemReserved_.at(subsystem);
+}
+
+uint64_t MemoryBudget::getHighWater(const Subsystem subsystem) const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return subsystemHighWater_.at(subsystem);
+}
+
+uint64_t MemoryBudget::getHighWater() const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return highWater_;
+}
+
+} // namespace common
+} // namespace isaac
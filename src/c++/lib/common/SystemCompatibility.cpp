@@ -124,6 +124,29 @@ int linuxFtruncate(int fd, std::size_t len)
     return 0;
 }
 
+int linuxStartWriteBehind(int fd, std::size_t offset, std::size_t len)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    return sync_file_range(fd, offset, len, SYNC_FILE_RANGE_WRITE);
+#endif //HAVE_SYNC_FILE_RANGE
+
+    return 0;
+}
+
+int linuxFinishWriteBehind(int fd, std::size_t offset, std::size_t len)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    if (sync_file_range(fd, offset, len,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER))
+    {
+        return -1;
+    }
+    return posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+#endif //HAVE_SYNC_FILE_RANGE
+
+    return 0;
+}
+
 }//namespace common
 }//namespace isaac
 
@@ -168,6 +191,17 @@ int64_t clock()
 	return ::clock();
 }
 
+uint64_t getAvailablePhysicalMemory()
+{
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (!::GlobalMemoryStatusEx(&status))
+	{
+		return 0;
+	}
+	return status.ullAvailPhys;
+}
+
 bool isLittleEndian()
 {
 	const uint64_t v = 0x0706050403020100;
@@ -347,6 +381,35 @@ int64_t clock()
 #endif
 }
 
+uint64_t getAvailablePhysicalMemory()
+{
+    // MemAvailable counts the page cache that can be reclaimed. Free pages alone are close to 0 on a busy node
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo)
+    {
+        char line[256];
+        unsigned long long kilobytes = 0;
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), meminfo))
+        {
+            found = 1 == sscanf(line, "MemAvailable: %llu kB", &kilobytes);
+        }
+        fclose(meminfo);
+        if (found)
+        {
+            return kilobytes * 1024;
+        }
+    }
+    // kernels before 3.14 don't report MemAvailable
+#ifdef HAVE_SYSCONF
+    const long pages = sysconf(_SC_AVPHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    return (-1 == pages || -1 == pageSize) ? 0 : uint64_t(pages) * pageSize;
+#else
+#error 'sysconf' is required
+#endif
+}
+
 bool isLittleEndian()
 {
     const uint64_t v = 0x0706050403020100;
@@ -0,0 +1,377 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file TaskScheduler.cpp
+ **
+ ** \brief See TaskScheduler.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/Numa.hh"
+#include "common/TaskScheduler.hh"
+
+namespace isaac
+{
+namespace common
+{
+
+iSAAC_THREAD_LOCAL TaskScheduler::Worker *TaskScheduler::currentWorker_ = 0;
+iSAAC_THREAD_LOCAL TaskScheduler *TaskScheduler::currentScheduler_ = 0;
+
+static boost::mutex instanceMutex;
+static unsigned configuredWorkers = 0;
+static boost::scoped_ptr<TaskScheduler> processScheduler;
+
+TaskScheduler::TaskScheduler(const unsigned workers) :
+    queuedTasks_(0), nextExternalQueue_(0), startedWorkers_(0), started_(false), terminateRequested_(false)
+{
+    ISAAC_ASSERT_MSG(0 < workers, "Inadequate pool size");
+    for (unsigned index = 0; index < workers; ++index)
+    {
+        workers_.push_back(new Worker(index));
+    }
+
+    boost::unique_lock<boost::mutex> lock(idleMutex_);
+    BOOST_FOREACH(Worker &worker, workers_)
+    {
+        threads_.push_back(new boost::thread(boost::bind(&TaskScheduler::workerThread, this, boost::ref(worker))));
+    }
+    // workers report the node they got bound to before anyone can decide whom to steal from
+    while (workers_.size() != startedWorkers_)
+    {
+        idleCondition_.wait(lock);
+    }
+
+    BOOST_FOREACH(Worker &worker, workers_)
+    {
+        nodeWorkers_[worker.node_].push_back(&worker);
+    }
+    BOOST_FOREACH(Worker &worker, workers_)
+    {
+        // start with the neighbours of the worker to spread the stealing
+        for (unsigned i = 1; i < workers_.size(); ++i)
+        {
+            Worker &victim = workers_.at((worker.index_ + i) % workers_.size());
+            if (victim.node_ == worker.node_)
+            {
+                worker.victims_.push_back(&victim);
+            }
+        }
+        for (unsigned i = 1; i < workers_.size(); ++i)
+        {
+            Worker &victim = workers_.at((worker.index_ + i) % workers_.size());
+            if (victim.node_ != worker.node_)
+            {
+                worker.victims_.push_back(&victim);
+            }
+        }
+    }
+
+    started_ = true;
+    idleCondition_.notify_all();
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(idleMutex_);
+        ISAAC_ASSERT_MSG(!queuedTasks_, "Tasks must not be outstanding at this point");
+        terminateRequested_ = true;
+        idleCondition_.notify_all();
+    }
+    std::for_each(threads_.begin(), threads_.end(), boost::bind(&boost::thread::join, _1));
+}
+
+void TaskScheduler::configure(const unsigned workers)
+{
+    boost::unique_lock<boost::mutex> lock(instanceMutex);
+    ISAAC_ASSERT_MSG(!processScheduler || processScheduler->getWorkers() == workers,
+                     "Process-wide scheduler is already running with " << processScheduler->getWorkers() << " workers");
+    configuredWorkers = workers;
+}
+
+TaskScheduler &TaskScheduler::instance()
+{
+    boost::unique_lock<boost::mutex> lock(instanceMutex);
+    if (!processScheduler)
+    {
+        processScheduler.reset(new TaskScheduler(
+            configuredWorkers ? configuredWorkers : std::max(1U, boost::thread::hardware_concurrency())));
+    }
+    return *processScheduler;
+}
+
+const std::vector<TaskScheduler::Worker *> &TaskScheduler::getExternalVictims() const
+{
+    const std::map<int, std::vector<Worker *> >::const_iterator it = nodeWorkers_.find(runOnNode_);
+    return nodeWorkers_.end() == it ? nodeWorkers_.begin()->second : it->second;
+}
+
+void TaskScheduler::push(const Task &task)
+{
+    Worker *worker = getCurrentWorker();
+    if (!worker)
+    {
+        // keep the data produced by the thread on the thread's node
+        const std::vector<Worker *> &nodeWorkers = getExternalVictims();
+        worker = nodeWorkers.at(nextExternalQueue_++ % nodeWorkers.size());
+    }
+    // counted before it is visible so that the count never goes below the number of tasks in the queues
+    ++queuedTasks_;
+    {
+        boost::lock_guard<boost::mutex> lock(worker->mutex_);
+        worker->tasks_.push_back(task);
+    }
+
+    boost::lock_guard<boost::mutex> lock(idleMutex_);
+    idleCondition_.notify_one();
+}
+
+bool TaskScheduler::pop(Task &task)
+{
+    Worker *self = getCurrentWorker();
+    if (self)
+    {
+        boost::lock_guard<boost::mutex> lock(self->mutex_);
+        if (!self->tasks_.empty())
+        {
+            task = self->tasks_.back();
+            self->tasks_.pop_back();
+            return true;
+        }
+    }
+
+    const std::vector<Worker *> &victims = self ? self->victims_ : getExternalVictims();
+    BOOST_FOREACH(Worker *victim, victims)
+    {
+        boost::lock_guard<boost::mutex> lock(victim->mutex_);
+        if (!victim->tasks_.empty())
+        {
+            task = victim->tasks_.front();
+            victim->tasks_.pop_front();
+            return true;
+        }
+    }
+
+    if (!self)
+    {
+        // external threads only prefer their own node, they don't have to stay there
+        BOOST_FOREACH(Worker &victim, workers_)
+        {
+            boost::lock_guard<boost::mutex> lock(victim.mutex_);
+            if (!victim.tasks_.empty())
+            {
+                task = victim.tasks_.front();
+                victim.tasks_.pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool TaskScheduler::runOne()
+{
+    if (!queuedTasks_)
+    {
+        return false;
+    }
+
+    Task task;
+    if (!pop(task))
+    {
+        return false;
+    }
+    --queuedTasks_;
+    execute(task);
+    return true;
+}
+
+void TaskScheduler::execute(Task &task)
+{
+    boost::exception_ptr exception;
+    try
+    {
+        task.function_();
+    }
+    catch (...)
+    {
+        exception = boost::current_exception();
+    }
+    // release whatever the task holds before the group owner gets a chance to leave the scope
+    task.function_.clear();
+    task.group_->done(exception);
+}
+
+/**
+ * \brief sleeps until there is something to do
+ *
+ * \param pending   when not 0, the wait is also over when the counter drops to 0
+ */
+void TaskScheduler::waitForWork(const std::atomic<std::size_t> *pending)
+{
+    boost::unique_lock<boost::mutex> lock(idleMutex_);
+    if (!queuedTasks_ && !terminateRequested_ && (!pending || *pending))
+    {
+        idleCondition_.wait(lock);
+    }
+}
+
+void TaskScheduler::taskGroupDone()
+{
+    boost::lock_guard<boost::mutex> lock(idleMutex_);
+    idleCondition_.notify_all();
+}
+
+void TaskScheduler::workerThread(Worker &worker)
+{
+    runOnNode_ = common::bindCurrentThreadToNumaNode(common::getThreadInterleaveNumaNode(worker.index_));
+    currentWorker_ = &worker;
+    currentScheduler_ = this;
+
+    {
+        boost::unique_lock<boost::mutex> lock(idleMutex_);
+        worker.node_ = runOnNode_;
+        ++startedWorkers_;
+        idleCondition_.notify_all();
+        while (!started_)
+        {
+            idleCondition_.wait(lock);
+        }
+    }
+
+    while (true)
+    {
+        if (!runOne())
+        {
+            boost::unique_lock<boost::mutex> lock(idleMutex_);
+            if (terminateRequested_)
+            {
+                break;
+            }
+            if (!queuedTasks_)
+            {
+                idleCondition_.wait(lock);
+            }
+        }
+    }
+}
+
+TaskGroup::~TaskGroup()
+{
+    while (pending_)
+    {
+        if (!scheduler_.runOne())
+        {
+            scheduler_.waitForWork(&pending_);
+        }
+    }
+}
+
+void TaskGroup::wait()
+{
+    while (pending_)
+    {
+        if (!scheduler_.runOne())
+        {
+            scheduler_.waitForWork(&pending_);
+        }
+    }
+
+    if (firstException_)
+    {
+        const boost::exception_ptr exception = firstException_;
+        firstException_ = boost::exception_ptr();
+        boost::rethrow_exception(exception);
+    }
+}
+
+void TaskGroup::done(const boost::exception_ptr &exception)
+{
+    if (exception)
+    {
+        boost::lock_guard<boost::mutex> lock(exceptionMutex_);
+        if (!firstException_)
+        {
+            firstException_ = exception;
+        }
+    }
+    // the group may be gone as soon as the counter drops to 0
+    TaskScheduler &scheduler = scheduler_;
+    if (1 == pending_--)
+    {
+        scheduler.taskGroupDone();
+    }
+}
+
+TaskGraph::NodeId TaskGraph::add(const TaskScheduler::Function &function)
+{
+    nodes_.push_back(new Node(function));
+    return nodes_.size() - 1;
+}
+
+void TaskGraph::depends(const NodeId node, const NodeId prerequisite)
+{
+    ISAAC_ASSERT_MSG(node != prerequisite, "Node can't depend on itself: " << node);
+    nodes_.at(prerequisite).dependents_.push_back(node);
+    ++nodes_.at(node).prerequisites_;
+}
+
+void TaskGraph::run(TaskScheduler &scheduler)
+{
+    BOOST_FOREACH(Node &node, nodes_)
+    {
+        node.waitingFor_ = node.prerequisites_;
+    }
+
+    std::atomic<std::size_t> completed(0);
+    {
+        TaskGroup group(scheduler);
+        for (NodeId nodeId = 0; nodeId < nodes_.size(); ++nodeId)
+        {
+            if (!nodes_.at(nodeId).prerequisites_)
+            {
+                group.run([this, &group, nodeId, &completed](){runNode(group, nodeId, completed);});
+            }
+        }
+        group.wait();
+    }
+
+    if (nodes_.size() != completed)
+    {
+        BOOST_THROW_EXCEPTION(ThreadingException(
+            (boost::format("Only %d out of %d tasks executed. Dependencies must not be circular") %
+                std::size_t(completed) % nodes_.size()).str()));
+    }
+}
+
+void TaskGraph::runNode(TaskGroup &group, const NodeId nodeId, std::atomic<std::size_t> &completed)
+{
+    Node &node = nodes_.at(nodeId);
+    node.function_();
+    ++completed;
+    BOOST_FOREACH(const NodeId dependent, node.dependents_)
+    {
+        if (1 == nodes_.at(dependent).waitingFor_--)
+        {
+            group.run([this, &group, dependent, &completed](){runNode(group, dependent, completed);});
+        }
+    }
+}
+
+} // namespace common
+} // namespace isaac
@@ -0,0 +1,82 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <limits>
+
+#include "RegistryName.hh"
+#include "testMemoryBudget.hh"
+
+#include "common/Exceptions.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMemoryBudget, registryName("MemoryBudget"));
+
+using isaac::common::MemoryBudget;
+using isaac::common::MemoryReservation;
+
+void TestMemoryBudget::setUp()
+{
+}
+
+void TestMemoryBudget::tearDown()
+{
+}
+
+void TestMemoryBudget::testReserve()
+{
+    MemoryBudget budget(1000);
+    budget.reserve(MemoryBudget::Reference, 600);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(400), budget.getAvailable());
+    CPPUNIT_ASSERT(!budget.tryReserve(MemoryBudget::BuildBins, 401));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), budget.getReserved(MemoryBudget::BuildBins));
+    CPPUNIT_ASSERT_THROW(budget.reserve(MemoryBudget::BuildBins, 401), isaac::common::MemoryException);
+    CPPUNIT_ASSERT_THROW(budget.reserve(MemoryBudget::BuildBins, 401), std::bad_alloc);
+
+    CPPUNIT_ASSERT(budget.tryReserve(MemoryBudget::BuildBins, 400));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), budget.getAvailable());
+    budget.release(MemoryBudget::BuildBins, 300);
+    budget.reserve(MemoryBudget::Bgzf, 200);
+
+    CPPUNIT_ASSERT_EQUAL(uint64_t(900), budget.getReserved());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(100), budget.getReserved(MemoryBudget::BuildBins));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(400), budget.getHighWater(MemoryBudget::BuildBins));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(200), budget.getHighWater(MemoryBudget::Bgzf));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1000), budget.getHighWater());
+}
+
+void TestMemoryBudget::testUnlimited()
+{
+    MemoryBudget budget(0);
+    budget.reserve(MemoryBudget::Hash, std::numeric_limits<uint64_t>::max() / 2);
+    CPPUNIT_ASSERT(budget.tryReserve(MemoryBudget::Reference, std::numeric_limits<uint64_t>::max() / 4));
+    CPPUNIT_ASSERT_EQUAL(std::numeric_limits<uint64_t>::max(), budget.getAvailable());
+}
+
+void TestMemoryBudget::testReservation()
+{
+    MemoryBudget budget(1000);
+    {
+        MemoryReservation reservation(MemoryBudget::TileBuffers, 500, budget);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(500), budget.getReserved(MemoryBudget::TileBuffers));
+        reservation.resize(800);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(800), budget.getReserved());
+        // failed growth leaves the reservation as it was
+        CPPUNIT_ASSERT_THROW(reservation.resize(1001), isaac::common::MemoryException);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(800), reservation.getBytes());
+        reservation.resize(100);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(100), budget.getReserved());
+        CPPUNIT_ASSERT_THROW(MemoryReservation(MemoryBudget::Hash, 901, budget), std::bad_alloc);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(100), budget.getReserved());
+    }
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), budget.getReserved());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(800), budget.getHighWater(MemoryBudget::TileBuffers));
+}
@@ -0,0 +1,36 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_COMMON_TEST_MEMORY_BUDGET_HH
+#define iSAAC_COMMON_TEST_MEMORY_BUDGET_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/MemoryBudget.hh"
+
+class TestMemoryBudget : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestMemoryBudget );
+    CPPUNIT_TEST( testReserve );
+    CPPUNIT_TEST( testUnlimited );
+    CPPUNIT_TEST( testReservation );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testReserve();
+    void testUnlimited();
+    void testReservation();
+};
+
+#endif // #ifndef iSAAC_COMMON_TEST_MEMORY_BUDGET_HH
@@ -0,0 +1,142 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "RegistryName.hh"
+#include "testTaskScheduler.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestTaskScheduler, registryName("TaskScheduler"));
+
+using isaac::common::TaskGraph;
+using isaac::common::TaskGroup;
+using isaac::common::TaskScheduler;
+
+void TestTaskScheduler::setUp()
+{
+}
+
+void TestTaskScheduler::tearDown()
+{
+}
+
+void TestTaskScheduler::testParallelFor()
+{
+    TaskScheduler scheduler(4);
+    std::vector<unsigned> visits(10000, 0);
+    std::atomic<unsigned> calls(0);
+    scheduler.parallelFor(0, visits.size(), 7,
+                          [&visits, &calls](const std::size_t begin, const std::size_t end)
+                          {
+                              CPPUNIT_ASSERT(7 >= end - begin);
+                              for (std::size_t i = begin; i < end; ++i)
+                              {
+                                  ++visits[i];
+                              }
+                              ++calls;
+                          });
+    CPPUNIT_ASSERT_EQUAL(std::size_t(visits.size()), std::size_t(std::count(visits.begin(), visits.end(), 1U)));
+    CPPUNIT_ASSERT(visits.size() / 7 <= calls);
+
+    // empty range
+    scheduler.parallelFor(5, 5, 1, [&calls](const std::size_t, const std::size_t){++calls;});
+    CPPUNIT_ASSERT(visits.size() / 7 <= calls);
+}
+
+void TestTaskScheduler::testNestedParallelFor()
+{
+    // fewer workers than outer iterations. Waiting threads must keep executing tasks.
+    TaskScheduler scheduler(2);
+    std::atomic<std::size_t> total(0);
+    scheduler.parallelFor(0, 16, 1,
+                          [&scheduler, &total](const std::size_t, const std::size_t)
+                          {
+                              scheduler.parallelFor(0, 100, 3,
+                                                    [&total](const std::size_t begin, const std::size_t end)
+                                                    {
+                                                        total += end - begin;
+                                                    });
+                          });
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1600), std::size_t(total));
+}
+
+void TestTaskScheduler::testTaskGroupException()
+{
+    TaskScheduler scheduler(3);
+    std::atomic<unsigned> executed(0);
+    TaskGroup group(scheduler);
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        group.run([i, &executed]()
+                  {
+                      ++executed;
+                      if (13 == i)
+                      {
+                          BOOST_THROW_EXCEPTION(isaac::common::ThreadingException("task 13"));
+                      }
+                  });
+    }
+    CPPUNIT_ASSERT_THROW(group.wait(), isaac::common::ThreadingException);
+    CPPUNIT_ASSERT_EQUAL(20U, unsigned(executed));
+
+    // group is reusable after the exception has been delivered
+    group.run([&executed](){++executed;});
+    group.wait();
+    CPPUNIT_ASSERT_EQUAL(21U, unsigned(executed));
+}
+
+void TestTaskScheduler::testTaskGraph()
+{
+    TaskScheduler scheduler(4);
+    std::atomic<unsigned> clock(0);
+    std::vector<unsigned> finished(5, 0);
+    TaskGraph graph;
+    // diamond 0 -> (1, 2) -> 3 and an independent 4
+    std::vector<TaskGraph::NodeId> nodes;
+    for (unsigned i = 0; i < finished.size(); ++i)
+    {
+        nodes.push_back(graph.add([i, &clock, &finished](){finished[i] = ++clock;}));
+    }
+    graph.depends(nodes[1], nodes[0]);
+    graph.depends(nodes[2], nodes[0]);
+    graph.depends(nodes[3], nodes[1]);
+    graph.depends(nodes[3], nodes[2]);
+
+    for (unsigned pass = 0; pass < 10; ++pass)
+    {
+        std::fill(finished.begin(), finished.end(), 0);
+        graph.run(scheduler);
+        CPPUNIT_ASSERT(std::find(finished.begin(), finished.end(), 0U) == finished.end());
+        CPPUNIT_ASSERT(finished[0] < finished[1]);
+        CPPUNIT_ASSERT(finished[0] < finished[2]);
+        CPPUNIT_ASSERT(finished[1] < finished[3]);
+        CPPUNIT_ASSERT(finished[2] < finished[3]);
+    }
+}
+
+void TestTaskScheduler::testCircularTaskGraph()
+{
+    TaskScheduler scheduler(2);
+    unsigned executed = 0;
+    TaskGraph graph;
+    const TaskGraph::NodeId first = graph.add([&executed](){++executed;});
+    const TaskGraph::NodeId second = graph.add([&executed](){++executed;});
+    const TaskGraph::NodeId third = graph.add([&executed](){++executed;});
+    graph.depends(second, first);
+    graph.depends(third, second);
+    graph.depends(second, third);
+    CPPUNIT_ASSERT_THROW(graph.run(scheduler), isaac::common::ThreadingException);
+    CPPUNIT_ASSERT_EQUAL(1U, executed);
+}
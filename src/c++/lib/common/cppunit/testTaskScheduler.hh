@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_COMMON_TEST_TASK_SCHEDULER_HH
+#define iSAAC_COMMON_TEST_TASK_SCHEDULER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "common/TaskScheduler.hh"
+
+class TestTaskScheduler : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestTaskScheduler );
+    CPPUNIT_TEST( testParallelFor );
+    CPPUNIT_TEST( testNestedParallelFor );
+    CPPUNIT_TEST( testTaskGroupException );
+    CPPUNIT_TEST( testTaskGraph );
+    CPPUNIT_TEST( testCircularTaskGraph );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testParallelFor();
+    void testNestedParallelFor();
+    void testTaskGroupException();
+    void testTaskGraph();
+    void testCircularTaskGraph();
+};
+
+#endif // #ifndef iSAAC_COMMON_TEST_TASK_SCHEDULER_HH
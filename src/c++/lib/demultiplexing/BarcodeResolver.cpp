@@ -58,12 +58,6 @@ bool isSequenceBarcodeEqual(const flowcell::BarcodeMetadataList &allBarcodeMetad
     return true;
 }
 
-
-bool orderBySequence(const Barcode &left, const Barcode &right)
-{
-    return left.getSequence() < right.getSequence();
-}
-
 /**
  * \return Number of single-mismatch variations for a kmer of kmerLength. Original kmer is included in the count.
  */
@@ -259,14 +253,265 @@ Barcodes BarcodeResolver::generateMismatches(
     return ret;
 }
 
+BarcodeHashTable::BarcodeHashTable(const std::size_t sizeMax) :
+    slotMask_(0), shift_(64), size_(0)
+{
+    // keep the load factor at or below 50% so that the probe sequences stay short
+    std::size_t slots = 2;
+    --shift_;
+    while (slots < sizeMax * 2)
+    {
+        slots <<= 1;
+        --shift_;
+    }
+    slotMask_ = slots - 1;
+    slots_.resize(slots, Barcode(EMPTY_SLOT, BarcodeId(0)));
+}
+
+std::pair<Barcode *, bool> BarcodeHashTable::insert(const Barcode &barcode)
+{
+    ISAAC_ASSERT_MSG(EMPTY_SLOT != barcode.getSequence(), "Barcode sequence clashes with the empty slot marker");
+    std::size_t slot = hash(barcode.getSequence());
+    while (EMPTY_SLOT != slots_[slot].getSequence())
+    {
+        if (barcode.getSequence() == slots_[slot].getSequence())
+        {
+            return std::make_pair(&slots_[slot], false);
+        }
+        slot = (slot + 1) & slotMask_;
+    }
+    ISAAC_ASSERT_MSG(size_ * 2 < slots_.size(), "Too many barcodes inserted: " << size_ << " slots: " << slots_.size());
+    ++size_;
+    slots_[slot] = barcode;
+    return std::make_pair(&slots_[slot], true);
+}
+
+/**
+ * \return Number of distinct kmers that differ from the original in at most maxMismatches positions
+ */
+static std::size_t getUniqueMismatchKmersCount(const unsigned kmerLength, const unsigned maxMismatches)
+{
+    std::size_t ret = 0;
+    std::size_t positionCombinations = 1;
+    std::size_t baseCombinations = 1;
+    for (unsigned mismatches = 0; maxMismatches >= mismatches && kmerLength >= mismatches; ++mismatches)
+    {
+        ret += positionCombinations * baseCombinations;
+        positionCombinations = positionCombinations * (kmerLength - mismatches) / (mismatches + 1);
+        baseCombinations *= oligo::INVALID_OLIGO;
+    }
+    return ret;
+}
+
+/**
+ * \brief Splits the barcode sequence on '-' into component kmers
+ */
+static void getComponents(const std::string &sequence, std::vector<Kmer> &kmers, std::vector<unsigned> &lengths)
+{
+    static const oligo::Translator<true> translator = {};
+    kmers.clear();
+    lengths.clear();
+    kmers.push_back(0);
+    lengths.push_back(0);
+    BOOST_FOREACH(const char base, sequence)
+    {
+        if ('-' != base)
+        {
+            kmers.back() = (kmers.back() << BITS_PER_BASE) | translator[base];
+            ++lengths.back();
+        }
+        else
+        {
+            kmers.push_back(0);
+            lengths.push_back(0);
+        }
+    }
+}
+
+void BarcodeResolver::buildComponentTables(const flowcell::BarcodeMetadataList &barcodeGroup)
+{
+    const flowcell::BarcodeMetadata &firstBarcode = barcodeGroup.at(1);
+    std::vector<Kmer> componentKmers;
+    std::vector<unsigned> componentLengths;
+    getComponents(firstBarcode.getSequence(), componentKmers, componentLengths);
+    if (COMPONENTS_MAX < componentLengths.size())
+    {
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(
+            (boost::format("Barcode %s has more than %d components") % firstBarcode % unsigned(COMPONENTS_MAX)).str()));
+    }
+
+    // distinct sequences of each component and the barcode each one was first seen in
+    std::vector<std::vector<std::pair<Kmer, unsigned> > > distinct(componentLengths.size());
+    std::vector<Kmer> kmers;
+    std::vector<unsigned> lengths;
+    BOOST_FOREACH(const flowcell::BarcodeMetadata &barcode,
+                  std::make_pair(barcodeGroup.begin() + 1, barcodeGroup.end()))
+    {
+        getComponents(barcode.getSequence(), kmers, lengths);
+        if (lengths != componentLengths)
+        {
+            BOOST_THROW_EXCEPTION(common::InvalidOptionException(
+                (boost::format("Barcode %s components differ in length from those of %s") % barcode % firstBarcode).str()));
+        }
+        for (unsigned component = 0; kmers.size() > component; ++component)
+        {
+            distinct.at(component).push_back(std::make_pair(kmers.at(component), barcode.getIndex()));
+        }
+    }
+
+    unsigned shift = 0;
+    components_.reserve(componentLengths.size());
+    for (int component = componentLengths.size() - 1; 0 <= component; --component)
+    {
+        std::vector<std::pair<Kmer, unsigned> > &sequences = distinct.at(component);
+        // stable, so that the collisions get reported against the first barcode carrying the component
+        std::stable_sort(sequences.begin(), sequences.end(),
+                         boost::bind(&std::pair<Kmer, unsigned>::first, _1) <
+                         boost::bind(&std::pair<Kmer, unsigned>::first, _2));
+        sequences.erase(std::unique(sequences.begin(), sequences.end(),
+                                    boost::bind(&std::pair<Kmer, unsigned>::first, _1) ==
+                                    boost::bind(&std::pair<Kmer, unsigned>::first, _2)), sequences.end());
+
+        const unsigned length = componentLengths.at(component);
+        const unsigned mismatches = firstBarcode.getComponentMismatches().at(component);
+        components_.push_back(Component(shift, length, sequences.size() * getUniqueMismatchKmersCount(length, mismatches)));
+        shift += length * BITS_PER_BASE;
+
+        BarcodeHashTable &variants = components_.back().variants_;
+        const unsigned iterations = getMismatchKmersCount(length, mismatches);
+        for (unsigned componentId = 0; sequences.size() > componentId; ++componentId)
+        {
+            for (unsigned iteration = 0; iterations > iteration; ++iteration)
+            {
+                const Kmer original = sequences.at(componentId).first;
+                const std::pair<Kmer, unsigned> variant =
+                    0 == mismatches ? std::make_pair(original, 0U) :
+                    1 == mismatches ? get1MismatchKmer(original, length, 0, iteration) :
+                        get2MismatchKmer(original, length, 0, iteration);
+                const std::pair<Barcode *, bool> inserted =
+                    variants.insert(Barcode(variant.first, BarcodeId(0, componentId, 0, variant.second)));
+                if (!inserted.second)
+                {
+                    Barcode &existing = *inserted.first;
+                    if (existing.getBarcode() != componentId)
+                    {
+                        BOOST_THROW_EXCEPTION(common::InvalidOptionException(
+                            (boost::format("Barcode collision detected. Component %d of %s collides with that of %s "
+                                "when %d mismatches are allowed") % component %
+                                allBarcodeMetadata_.at(sequences.at(componentId).second) %
+                                allBarcodeMetadata_.at(sequences.at(existing.getBarcode()).second) %
+                                mismatches).str()));
+                    }
+                    if (existing.getMismatches() > variant.second)
+                    {
+                        existing.setBarcodeId(BarcodeId(0, componentId, 0, variant.second));
+                    }
+                }
+            }
+        }
+        ISAAC_THREAD_CERR << "Generated " << variants.size() << " mismatch variants for " << sequences.size() <<
+            " distinct sequences of barcode component " << component << std::endl;
+    }
+    std::reverse(components_.begin(), components_.end());
+
+    BOOST_FOREACH(const flowcell::BarcodeMetadata &barcode,
+                  std::make_pair(barcodeGroup.begin() + 1, barcodeGroup.end()))
+    {
+        getComponents(barcode.getSequence(), kmers, lengths);
+        Kmer sequence = 0;
+        for (unsigned component = 0; kmers.size() > component; ++component)
+        {
+            sequence = (sequence << (lengths.at(component) * BITS_PER_BASE)) | kmers.at(component);
+        }
+        Kmer key = 0;
+        unsigned mismatches = 0;
+        ISAAC_VERIFY_MSG(getSampleKey(sequence, key, mismatches) && !mismatches,
+                         "Barcode components must be found in the component tables " << barcode);
+        const std::pair<Barcode *, bool> inserted = samples_.insert(Barcode(key, BarcodeId(0, barcode.getIndex(), 0, 0)));
+        if (!inserted.second)
+        {
+            BOOST_THROW_EXCEPTION(common::InvalidOptionException("Barcode collision detected. Barcode " +
+                boost::lexical_cast<std::string>(barcode) + " is the same as " +
+                boost::lexical_cast<std::string>(allBarcodeMetadata_.at(inserted.first->getBarcode()))));
+        }
+    }
+}
+
+/**
+ * \brief Combines the ids of the matching component sequences into the key of the samples_ table
+ *
+ * \return false if any of the components does not match
+ */
+bool BarcodeResolver::getSampleKey(const Kmer sequence, Kmer &key, unsigned &mismatches) const
+{
+    key = 0;
+    mismatches = 0;
+    unsigned keyShift = 0;
+    BOOST_FOREACH(const Component &component, components_)
+    {
+        const Barcode *match = component.variants_.find((sequence >> component.shift_) & component.mask_);
+        if (!match)
+        {
+            return false;
+        }
+        key |= match->getBarcode() << keyShift;
+        mismatches += match->getMismatches();
+        keyShift += COMPONENT_ID_BITS;
+    }
+    return true;
+}
+
 BarcodeResolver::BarcodeResolver(
     const flowcell::BarcodeMetadataList &allBarcodeMetadata,
     const flowcell::BarcodeMetadataList &barcodeGroup)
     : allBarcodeMetadata_(allBarcodeMetadata)
-    , mismatchBarcodes_(generateMismatches(allBarcodeMetadata_, barcodeGroup))
     , unknownBarcodeIndex_(barcodeGroup.at(0).getIndex())
+    , samples_(barcodeGroup.size())
     , barcodeHits_(allBarcodeMetadata_.size())
 {
+    ISAAC_ASSERT_MSG(1 < barcodeGroup.size(), "Barcode list must have barcodes other than the default one");
+    ISAAC_ASSERT_MSG(barcodeGroup.at(0).isDefault(), "The very first barcode must be the 'unknown indexes or no index' one");
+    if (BarcodeId::BARCODE_MASK <= allBarcodeMetadata_.size())
+    {
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(
+            (boost::format("Too many barcodes: %d. At most %d are supported") %
+                allBarcodeMetadata_.size() % (BarcodeId::BARCODE_MASK - 1)).str()));
+    }
+    buildComponentTables(barcodeGroup);
+}
+
+/**
+ * \brief Looks up the threadNumber-th contiguous part of barcodes. Sequences that don't match are counted
+ *        in the thread's own table of unknown hits.
+ */
+void BarcodeResolver::resolveThread(
+    Barcodes &barcodes,
+    const unsigned threadNumber,
+    const unsigned threadsTotal)
+{
+    const std::size_t perThread = (barcodes.size() + threadsTotal - 1) / threadsTotal;
+    const Barcodes::iterator begin = barcodes.begin() + std::min(barcodes.size(), perThread * threadNumber);
+    const Barcodes::iterator end = barcodes.begin() + std::min(barcodes.size(), perThread * (threadNumber + 1));
+
+    UnknownHits &unknownHits = threadUnknownHits_.at(threadNumber);
+    unknownHits.clear();
+    for (Barcodes::iterator it = begin; end != it; ++it)
+    {
+        Barcode &dataBarcode = *it;
+        ISAAC_ASSERT_MSG(dataBarcode.getBarcode() == unknownBarcodeIndex_, "Data barcodes are expected to have the index preset to 'unknown'");
+        Kmer key = 0;
+        unsigned mismatches = 0;
+        const Barcode *sample = getSampleKey(dataBarcode.getSequence(), key, mismatches) ? samples_.find(key) : 0;
+        if (sample)
+        {
+            dataBarcode.setBarcodeId(BarcodeId(dataBarcode.getTile(), sample->getBarcode(), dataBarcode.getCluster(),
+                                               std::min<uint64_t>(mismatches, BarcodeId::MISMATCHES_MASK)));
+        }
+        else
+        {
+            ++unknownHits[dataBarcode.getSequence()];
+        }
+    }
 }
 
 inline std::ostream &operator << (std::ostream &os, const std::vector<unsigned> &mismatchesPerComponent)
@@ -281,73 +526,59 @@ inline std::ostream &operator << (std::ostream &os, const std::vector<unsigned>
     return os;
 }
 
-Barcodes::iterator BarcodeResolver::recordSameBarcodeHits(
-    const Barcodes::iterator dataBarcodeIterator,
-    const Barcodes::const_iterator dataBarcodesEnd,
-    demultiplexing::DemultiplexingStats& demultiplexingStats)
-{
-    Barcodes::iterator sameBarcodeIterator = dataBarcodeIterator;
-    while (dataBarcodesEnd != sameBarcodeIterator
-        && sameBarcodeIterator->getSequence()  == dataBarcodeIterator->getSequence())
-    {
-        demultiplexingStats.recordUnknownBarcode(unknownBarcodeIndex_, dataBarcodeIterator->getTile());
-        ++sameBarcodeIterator;
-    }
-    demultiplexingStats.recordUnknownBarcodeHits(dataBarcodeIterator->getSequence(), std::distance(dataBarcodeIterator, sameBarcodeIterator));
-    return sameBarcodeIterator - 1;
-}
-
 /**
  * \brief Updates barcode indexes with those of the matching mismatch barcodes.
  *        Index 0 is reserved for the undetermined barcode.
  */
 void BarcodeResolver::resolve(
+    common::ThreadVector &threads,
+    const unsigned threadsMax,
     Barcodes &dataBarcodes,
     demultiplexing::DemultiplexingStats &demultiplexingStats)
 {
     ISAAC_THREAD_CERR << "Resolving barcodes for " << dataBarcodes.size() << " clusters against " <<
-        mismatchBarcodes_.size() << " mismatch variants" << std::endl;
+        samples_.size() << " barcodes" << std::endl;
 
-    uint64_t totalBarcodeHits = 0;
-    std::sort(dataBarcodes.begin(), dataBarcodes.end(), orderBySequence);
-    Barcodes::const_iterator mismatchBarcodeIterator = mismatchBarcodes_.begin();
+    threadUnknownHits_.resize(std::max<std::size_t>(threadUnknownHits_.size(), threadsMax));
+    threads.execute(boost::bind(&BarcodeResolver::resolveThread, this, boost::ref(dataBarcodes), _1, _2), threadsMax);
 
-    for(Barcodes::iterator dataBarcodeIterator = dataBarcodes.begin();
-        dataBarcodes.end() != dataBarcodeIterator; ++dataBarcodeIterator)
+    // DemultiplexingStats is not thread-safe. Counting is cheap compared to the lookups done above.
+    uint64_t totalBarcodeHits = 0;
+    BOOST_FOREACH(const Barcode &dataBarcode, dataBarcodes)
     {
-        Barcode &dataBarcode = *dataBarcodeIterator;
-        // rewind sample sheet to the first data match
-        while(mismatchBarcodes_.end() != mismatchBarcodeIterator &&
-            dataBarcode.getSequence() > mismatchBarcodeIterator->getSequence())
-        {
-            ISAAC_ASSERT_MSG(dataBarcode.getBarcode() == unknownBarcodeIndex_, "Data barcodes are expected to have the index preset to 'unknown'");
-            ++mismatchBarcodeIterator;
-        }
-
-        if (mismatchBarcodes_.end() != mismatchBarcodeIterator && dataBarcode.getSequence() == mismatchBarcodeIterator->getSequence())
+        if (unknownBarcodeIndex_ != dataBarcode.getBarcode())
         {
-            // match!, set the index in data
-            BarcodeId barcodeId(dataBarcode.getTile(), mismatchBarcodeIterator->getBarcode(),
-                                dataBarcode.getCluster(), mismatchBarcodeIterator->getMismatches());
-            dataBarcode.setBarcodeId(barcodeId);
-            ++barcodeHits_.at(mismatchBarcodeIterator->getBarcode());
+            ++barcodeHits_.at(dataBarcode.getBarcode());
             ++totalBarcodeHits;
-            demultiplexingStats.recordBarcode(barcodeId);
+            demultiplexingStats.recordBarcode(dataBarcode.getBarcodeId());
         }
         else
         {
-            dataBarcodeIterator = recordSameBarcodeHits(dataBarcodeIterator, dataBarcodes.end(), demultiplexingStats);
+            demultiplexingStats.recordUnknownBarcode(unknownBarcodeIndex_, dataBarcode.getTile());
         }
+    }
 
-        // else dataBarcode.getSequence() < mismatchBarcodeIterator->getSequence(), no match, move on
+    UnknownHits &unknownHits = threadUnknownHits_.front();
+    for (std::size_t threadNumber = 1; threadNumber < threadUnknownHits_.size(); ++threadNumber)
+    {
+        BOOST_FOREACH(const UnknownHits::value_type &hits, threadUnknownHits_.at(threadNumber))
+        {
+            unknownHits[hits.first] += hits.second;
+        }
+        threadUnknownHits_.at(threadNumber).clear();
+    }
+    BOOST_FOREACH(const UnknownHits::value_type &hits, unknownHits)
+    {
+        demultiplexingStats.recordUnknownBarcodeHits(hits.first, hits.second);
     }
+    unknownHits.clear();
 
     if (!dataBarcodes.empty())
     {
         demultiplexingStats.finalizeUnknownBarcodeHits(unknownBarcodeIndex_);
     }
     ISAAC_THREAD_CERR << "Resolving barcodes done for " << dataBarcodes.size() << " clusters against " <<
-        mismatchBarcodes_.size() << " mismatch variants. Found barcode hits breakdown. Total(" << totalBarcodeHits << "):"<< std::endl;
+        samples_.size() << " barcodes. Found barcode hits breakdown. Total(" << totalBarcodeHits << "):"<< std::endl;
 
     BOOST_FOREACH(const uint64_t &barcodeHits, barcodeHits_)
     {
@@ -165,3 +165,105 @@ void TestBarcodeResolver::testMismatchCollision()
 
 }
 
+void TestBarcodeResolver::testResolve()
+{
+    isaac::flowcell::BarcodeMetadataList barcodeMetadataList(3);
+    std::vector<unsigned> compMism(1, 1);
+    barcodeMetadataList.at(0).setUnknown();
+    barcodeMetadataList.at(0).setIndex(0);
+    barcodeMetadataList.at(0).setComponentMismatches(compMism);
+    barcodeMetadataList.at(1).setSequence("AAAA");
+    barcodeMetadataList.at(1).setIndex(1);
+    barcodeMetadataList.at(1).setComponentMismatches(compMism);
+    barcodeMetadataList.at(2).setSequence("CCCC");
+    barcodeMetadataList.at(2).setIndex(2);
+    barcodeMetadataList.at(2).setComponentMismatches(compMism);
+
+    BarcodeResolver resolver(barcodeMetadataList, barcodeMetadataList);
+    DemultiplexingStats stats(isaac::flowcell::FlowcellLayoutList(), barcodeMetadataList);
+
+    // octal literals have one digit per base: AAAA, CCCC, ACCC, GGGG, AAAT, GGGG, CCCN
+    Barcodes barcodes = boost::assign::list_of
+        (Barcode(00000, BarcodeId(1, 0, 0, 0)))
+        (Barcode(01111, BarcodeId(1, 0, 1, 0)))
+        (Barcode(00111, BarcodeId(1, 0, 2, 0)))
+        (Barcode(02222, BarcodeId(1, 0, 3, 0)))
+        (Barcode(00003, BarcodeId(1, 0, 4, 0)))
+        (Barcode(02222, BarcodeId(1, 0, 5, 0)))
+        (Barcode(01114, BarcodeId(1, 0, 6, 0)));
+
+    isaac::common::ThreadVector threads(2);
+    resolver.resolve(threads, 2, barcodes, stats);
+
+    const unsigned expectedBarcodes[] = {1, 2, 2, 0, 1, 0, 2};
+    const unsigned expectedMismatches[] = {0, 0, 1, 0, 1, 0, 1};
+    BOOST_FOREACH(const Barcode &barcode, barcodes)
+    {
+        const unsigned cluster = &barcode - &barcodes.front();
+        CPPUNIT_ASSERT_EQUAL(uint64_t(cluster), barcode.getCluster());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), barcode.getTile());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(expectedBarcodes[cluster]), barcode.getBarcode());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(expectedMismatches[cluster]), barcode.getMismatches());
+    }
+}
+
+static isaac::flowcell::BarcodeMetadataList makeDualIndexBarcodes(const std::vector<std::string> &sequences)
+{
+    isaac::flowcell::BarcodeMetadataList barcodeMetadataList(sequences.size() + 1);
+    std::vector<unsigned> compMism(2, 1);
+    barcodeMetadataList.at(0).setUnknown();
+    barcodeMetadataList.at(0).setIndex(0);
+    barcodeMetadataList.at(0).setComponentMismatches(compMism);
+    BOOST_FOREACH(const std::string &sequence, sequences)
+    {
+        const unsigned index = &sequence - &sequences.front() + 1;
+        barcodeMetadataList.at(index).setSequence(sequence);
+        barcodeMetadataList.at(index).setIndex(index);
+        barcodeMetadataList.at(index).setComponentMismatches(compMism);
+    }
+    return barcodeMetadataList;
+}
+
+void TestBarcodeResolver::testResolveDualIndex()
+{
+    const isaac::flowcell::BarcodeMetadataList barcodeMetadataList = makeDualIndexBarcodes(
+        boost::assign::list_of("AAAA-CCCC")("AAAA-GGGG")("TTTT-CCCC"));
+
+    BarcodeResolver resolver(barcodeMetadataList, barcodeMetadataList);
+    DemultiplexingStats stats(isaac::flowcell::FlowcellLayoutList(), barcodeMetadataList);
+
+    // AAAACCCC, AAATCCCG, AAAAGGGN, TTTTCCCC, TTTTGGGG, ACCACCCC
+    Barcodes barcodes = boost::assign::list_of
+        (Barcode(000001111, BarcodeId(0, 0, 0, 0)))
+        (Barcode(000031112, BarcodeId(0, 0, 1, 0)))
+        (Barcode(000002224, BarcodeId(0, 0, 2, 0)))
+        (Barcode(033331111, BarcodeId(0, 0, 3, 0)))
+        (Barcode(033332222, BarcodeId(0, 0, 4, 0)))
+        (Barcode(001101111, BarcodeId(0, 0, 5, 0)));
+
+    isaac::common::ThreadVector threads(1);
+    resolver.resolve(threads, 1, barcodes, stats);
+
+    const unsigned expectedBarcodes[] = {1, 1, 2, 3, 0, 0};
+    const unsigned expectedMismatches[] = {0, 2, 1, 0, 0, 0};
+    BOOST_FOREACH(const Barcode &barcode, barcodes)
+    {
+        const unsigned cluster = &barcode - &barcodes.front();
+        CPPUNIT_ASSERT_EQUAL(uint64_t(expectedBarcodes[cluster]), barcode.getBarcode());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(expectedMismatches[cluster]), barcode.getMismatches());
+    }
+}
+
+void TestBarcodeResolver::testComponentCollision()
+{
+    // first components are one base apart, so a single mismatch makes them indistinguishable
+    const isaac::flowcell::BarcodeMetadataList barcodeMetadataList = makeDualIndexBarcodes(
+        boost::assign::list_of("AAAA-CCCC")("AAAT-GGGG"));
+    CPPUNIT_ASSERT_THROW(BarcodeResolver(barcodeMetadataList, barcodeMetadataList),
+                         isaac::common::InvalidOptionException);
+
+    // same barcode twice
+    const isaac::flowcell::BarcodeMetadataList duplicates = makeDualIndexBarcodes(
+        boost::assign::list_of("AAAA-CCCC")("AAAA-CCCC"));
+    CPPUNIT_ASSERT_THROW(BarcodeResolver(duplicates, duplicates), isaac::common::InvalidOptionException);
+}
@@ -31,6 +31,9 @@ class TestBarcodeResolver : public CppUnit::TestFixture
     CPPUNIT_TEST( testOneComponent );
     CPPUNIT_TEST( testTwoComponents );
     CPPUNIT_TEST( testMismatchCollision );
+    CPPUNIT_TEST( testResolve );
+    CPPUNIT_TEST( testResolveDualIndex );
+    CPPUNIT_TEST( testComponentCollision );
     CPPUNIT_TEST_SUITE_END();
 private:
 public:
@@ -40,6 +43,9 @@ public:
     void testOneComponent();
     void testTwoComponents();
     void testMismatchCollision();
+    void testResolve();
+    void testResolveDualIndex();
+    void testComponentCollision();
 };
 
 #endif // #ifndef iSAAC_OPTIONS_TEST_BARCODE_RESOLVER_HH
@@ -0,0 +1,87 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclLayout.cpp
+ **
+ ** Specialization of Layout attributes for NovaSeq cbcl base calls.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include "common/FileSystem.hh"
+#include "flowcell/CbclLayout.hh"
+
+namespace isaac
+{
+namespace flowcell
+{
+
+template<>
+void Layout::getLaneTileCycleAttribute<Layout::Cbcl, BclFilePathAttributeTag>(
+    const unsigned lane, const unsigned tile, const unsigned cycle, boost::filesystem::path &result) const
+{
+    ISAAC_ASSERT_MSG(Cbcl == format_, BclFilePathAttributeTag() << " is only allowed for cbcl flowcells");
+    ISAAC_ASSERT_MSG(lane <= cbcl::LANE_NUMBER_MAX, "Lane number " << lane << " must not exceed " << cbcl::LANE_NUMBER_MAX);
+    ISAAC_ASSERT_MSG(tile <= cbcl::TILE_NUMBER_MAX, "Tile number must not exceeed 5 digits. got: " << tile);
+    ISAAC_ASSERT_MSG(cycle <= cbcl::CYCLE_NUMBER_MAX, "Cycle number should not exceeed 4 digits");
+
+    // Warning: the code below avoids memory allocations during path formatting.
+    // the result is expected to be pre-sized, else allocations will occur as usual.
+    char laneFolder[100];
+    snprintf(laneFolder, sizeof(laneFolder), "%cL%03d", common::getDirectorySeparatorChar(), lane);
+
+    char cycleFolder[100];
+    snprintf(cycleFolder, sizeof(cycleFolder), "%cC%d.1", common::getDirectorySeparatorChar(), cycle);
+
+    char cbclFileName[100];
+    snprintf(cbclFileName, sizeof(cbclFileName), "%cL%03d_%d.cbcl",
+             common::getDirectorySeparatorChar(), lane, cbcl::getTileSurface(tile));
+
+    result = getBaseCallsPath().c_str();
+    result /= boost::filesystem::path(laneFolder);
+    result /= boost::filesystem::path(cycleFolder);
+    result /= boost::filesystem::path(cbclFileName);
+}
+
+template<>
+void Layout::getLaneTileAttribute<Layout::Cbcl, FiltersFilePathAttributeTag>(
+    const unsigned lane, const unsigned tile, boost::filesystem::path &result) const
+{
+    ISAAC_ASSERT_MSG(Cbcl == format_, FiltersFilePathAttributeTag() << " is only allowed for cbcl flowcells");
+    ISAAC_ASSERT_MSG(lane <= cbcl::LANE_NUMBER_MAX, "Lane number " << lane << " must not exceed " << cbcl::LANE_NUMBER_MAX);
+    ISAAC_ASSERT_MSG(tile <= cbcl::TILE_NUMBER_MAX, "Tile number must not exceeed 5 digits. got: " << tile);
+
+    char laneFolder[100];
+    snprintf(laneFolder, sizeof(laneFolder), "%cL%03d", common::getDirectorySeparatorChar(), lane);
+
+    char filterFileName[100];
+    snprintf(filterFileName, sizeof(filterFileName), "%cs_%d_%04d.filter", common::getDirectorySeparatorChar(), lane, tile);
+
+    result = getBaseCallsPath().c_str();
+    result /= boost::filesystem::path(laneFolder);
+    result /= boost::filesystem::path(filterFileName);
+}
+
+template<>
+void Layout::getLaneAttribute<Layout::Cbcl, PositionsFilePathAttributeTag>(
+    const unsigned lane, boost::filesystem::path &result) const
+{
+    ISAAC_ASSERT_MSG(Cbcl == format_, PositionsFilePathAttributeTag() << " is only allowed for cbcl flowcells");
+
+    // NovaSeq flowcells are patterned. All tiles share the same cluster positions
+    result = getBaseCallsPath().c_str();
+    result /= boost::filesystem::path("..");
+    result /= boost::filesystem::path("s.locs");
+}
+
+} // namespace flowcell
+} // namespace isaac
@@ -0,0 +1,374 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "RegistryName.hh"
+#include "testCbclTileReader.hh"
+
+#include "flowcell/CbclLayout.hh"
+#include "rta/CbclTileReader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestCbclTileReader, registryName("CbclTileReader"));
+
+using isaac::rta::CbclHeader;
+using isaac::rta::CbclTileReader;
+
+namespace
+{
+
+const unsigned LANE = 1;
+const unsigned CYCLE = 1;
+const unsigned MAX_CLUSTERS = 64;
+/// bcl quality of each bin of the synthetic cbcl
+const unsigned BIN_QSCORES[] = {0, 10, 25, 63};
+
+struct Tile
+{
+    unsigned tile_;
+    unsigned clusters_;
+    // two clusters per byte, first one in the low nibble
+    std::string packed_;
+};
+
+/**
+ * \brief Synthetic cbcl file. Bins map 1->10, 2->25, 3->70. 70 exceeds the bcl quality range.
+ */
+struct Cbcl
+{
+    Cbcl() : version_(1), bitsPerBasecall_(2), bitsPerQscore_(2), nonPfExcluded_(false)
+    {
+        bins_.push_back(std::make_pair(0U, 0U));
+        bins_.push_back(std::make_pair(1U, 10U));
+        bins_.push_back(std::make_pair(2U, 25U));
+        bins_.push_back(std::make_pair(3U, 70U));
+    }
+
+    uint16_t version_;
+    uint8_t bitsPerBasecall_;
+    uint8_t bitsPerQscore_;
+    std::vector<std::pair<unsigned, unsigned> > bins_;
+    std::vector<Tile> tiles_;
+    bool nonPfExcluded_;
+
+    std::string header(const std::vector<std::string> &blocks) const
+    {
+        std::string ret;
+        append<uint16_t>(ret, version_);
+        append<uint32_t>(ret, 0);
+        append<uint8_t>(ret, bitsPerBasecall_);
+        append<uint8_t>(ret, bitsPerQscore_);
+        append<uint32_t>(ret, bins_.size());
+        for (const std::pair<unsigned, unsigned> &bin : bins_)
+        {
+            append<uint32_t>(ret, bin.first);
+            append<uint32_t>(ret, bin.second);
+        }
+        append<uint32_t>(ret, tiles_.size());
+        for (std::size_t i = 0; tiles_.size() != i; ++i)
+        {
+            append<uint32_t>(ret, tiles_[i].tile_);
+            append<uint32_t>(ret, tiles_[i].clusters_);
+            append<uint32_t>(ret, tiles_[i].packed_.size());
+            append<uint32_t>(ret, blocks[i].size());
+        }
+        append<uint8_t>(ret, nonPfExcluded_);
+        const uint32_t headerBytes = ret.size();
+        ret.replace(sizeof(uint16_t), sizeof(headerBytes), reinterpret_cast<const char *>(&headerBytes), sizeof(headerBytes));
+        return ret;
+    }
+
+    std::vector<std::string> blocks() const
+    {
+        std::vector<std::string> ret;
+        for (const Tile &tile : tiles_)
+        {
+            std::ostringstream compressed;
+            {
+                boost::iostreams::filtering_ostream os;
+                os.push(boost::iostreams::gzip_compressor());
+                os.push(compressed);
+                os.write(tile.packed_.data(), tile.packed_.size());
+            }
+            ret.push_back(compressed.str());
+        }
+        return ret;
+    }
+
+    std::string str() const
+    {
+        const std::vector<std::string> compressed = blocks();
+        std::string ret = header(compressed);
+        for (const std::string &block : compressed)
+        {
+            ret += block;
+        }
+        return ret;
+    }
+
+    void write(const boost::filesystem::path &path) const
+    {
+        boost::filesystem::create_directories(path.parent_path());
+        std::ofstream os(path.c_str(), std::ios_base::binary);
+        const std::string data = str();
+        CPPUNIT_ASSERT(os.write(data.data(), data.size()));
+    }
+
+private:
+    template <typename T> static void append(std::string &s, const T value)
+    {
+        s.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+};
+
+unsigned char nibble(const unsigned base, const unsigned qBin)
+{
+    return (qBin << 2) | base;
+}
+
+char bcl(const unsigned base, const unsigned qScore)
+{
+    return qScore ? (qScore << 2) | base : 0;
+}
+
+std::string pack(const std::vector<unsigned char> &nibbles)
+{
+    std::string ret((nibbles.size() + 1) / 2, 0);
+    for (std::size_t i = 0; nibbles.size() != i; ++i)
+    {
+        ret[i / 2] |= (i & 1) ? nibbles[i] << 4 : nibbles[i];
+    }
+    return ret;
+}
+
+CbclHeader readHeader(const std::string &data)
+{
+    std::istringstream is(data);
+    CbclHeader ret;
+    ret.read(is, "test.cbcl");
+    return ret;
+}
+
+} // namespace
+
+void TestCbclTileReader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+    readMetadataList_.clear();
+    readMetadataList_.push_back(isaac::flowcell::ReadMetadata(1, 1, 0, 0));
+}
+
+void TestCbclTileReader::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestCbclTileReader::testHeader()
+{
+    Cbcl cbcl;
+    Tile first = {1101, 5, pack(std::vector<unsigned char>(5, nibble(1, 2)))};
+    Tile second = {1102, 2, pack(std::vector<unsigned char>(2, nibble(3, 1)))};
+    cbcl.tiles_.push_back(first);
+    cbcl.tiles_.push_back(second);
+    const std::vector<std::string> blocks = cbcl.blocks();
+    const std::string header = cbcl.header(blocks);
+
+    CbclHeader parsed = readHeader(cbcl.str());
+    CPPUNIT_ASSERT(!parsed.nonPfClustersExcluded());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), parsed.getTiles().size());
+    const CbclHeader::TileRecord &record = parsed.getTiles().at(1);
+    CPPUNIT_ASSERT_EQUAL(1102U, record.tile_);
+    CPPUNIT_ASSERT_EQUAL(2U, record.clusters_);
+    CPPUNIT_ASSERT_EQUAL(1U, record.uncompressedBytes_);
+    CPPUNIT_ASSERT_EQUAL(unsigned(blocks[1].size()), record.compressedBytes_);
+    // compressed blocks follow the header in the order of tile records
+    CPPUNIT_ASSERT_EQUAL(uint64_t(header.size()), parsed.getTiles().at(0).offset_);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(header.size() + blocks[0].size()), record.offset_);
+
+    CPPUNIT_ASSERT(&record == parsed.findTile(1102));
+    CPPUNIT_ASSERT(!parsed.findTile(1103));
+
+    cbcl.nonPfExcluded_ = true;
+    // the same object reads a different header
+    std::istringstream is(cbcl.str());
+    parsed.read(is, "test.cbcl");
+    CPPUNIT_ASSERT(parsed.nonPfClustersExcluded());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), parsed.getTiles().size());
+
+    // no tiles
+    cbcl.tiles_.clear();
+    CPPUNIT_ASSERT(readHeader(cbcl.str()).getTiles().empty());
+}
+
+void TestCbclTileReader::testHeaderErrors()
+{
+    Cbcl cbcl;
+    cbcl.version_ = 2;
+    CPPUNIT_ASSERT_THROW(readHeader(cbcl.str()), isaac::common::UnsupportedVersionException);
+
+    cbcl = Cbcl();
+    cbcl.bitsPerBasecall_ = 3;
+    CPPUNIT_ASSERT_THROW(readHeader(cbcl.str()), isaac::common::UnsupportedVersionException);
+
+    cbcl = Cbcl();
+    cbcl.bitsPerQscore_ = 4;
+    CPPUNIT_ASSERT_THROW(readHeader(cbcl.str()), isaac::common::UnsupportedVersionException);
+
+    // 4 bits of quality allow bins 0-15 only
+    cbcl = Cbcl();
+    cbcl.bins_.push_back(std::make_pair(unsigned(CbclHeader::QSCORE_BINS_MAX), 40U));
+    CPPUNIT_ASSERT_THROW(readHeader(cbcl.str()), isaac::common::IoException);
+
+    // truncated anywhere in the header
+    cbcl = Cbcl();
+    Tile tile = {1101, 2, pack(std::vector<unsigned char>(2, nibble(0, 1)))};
+    cbcl.tiles_.push_back(tile);
+    const std::string header = cbcl.header(cbcl.blocks());
+    for (std::size_t size = 0; header.size() != size; ++size)
+    {
+        CPPUNIT_ASSERT_THROW(readHeader(header.substr(0, size)), isaac::common::IoException);
+    }
+    CPPUNIT_ASSERT_NO_THROW(readHeader(header));
+}
+
+void TestCbclTileReader::testTranslate()
+{
+    Cbcl cbcl;
+    // bin 4 is not listed in the header
+    const CbclHeader header = readHeader(cbcl.str());
+    for (unsigned base = 0; 4 != base; ++base)
+    {
+        // quality bin 0 is a no-call regardless of the base
+        CPPUNIT_ASSERT_EQUAL(uint16_t(0), header.translate(nibble(base, 0)));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(bcl(base, 10)), header.translate(nibble(base, 1)));
+        CPPUNIT_ASSERT_EQUAL(uint16_t(uint8_t(bcl(base, 25))), header.translate(nibble(base, 2)));
+        // capped at the highest quality a bcl byte can hold
+        CPPUNIT_ASSERT_EQUAL(uint16_t(uint8_t(bcl(base, 63))), header.translate(nibble(base, 3)));
+    }
+    // second cluster in the high nibble goes to the high byte
+    CPPUNIT_ASSERT_EQUAL(uint16_t(bcl(2, 10) | (uint8_t(bcl(1, 25)) << 8)),
+                         header.translate(nibble(2, 1) | (nibble(1, 2) << 4)));
+    CPPUNIT_ASSERT_EQUAL(uint16_t(uint8_t(bcl(3, 63)) << 8), header.translate(nibble(3, 0) | (nibble(3, 3) << 4)));
+}
+
+void TestCbclTileReader::testOddClusterCount()
+{
+    isaac::flowcell::Layout layout(
+        tempDir_, isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFlowcellData(), 8, 0,
+        std::vector<unsigned>(), readMetadataList_, "FC");
+
+    // two tiles of the same surface share the file. Odd cluster count leaves the high nibble of the last byte unused
+    Cbcl cbcl;
+    std::vector<unsigned char> nibbles;
+    std::string expected;
+    for (unsigned cluster = 0; 7 != cluster; ++cluster)
+    {
+        nibbles.push_back(nibble(cluster % 4, cluster % 4));
+        expected.push_back(bcl(cluster % 4, BIN_QSCORES[cluster % 4]));
+    }
+    Tile other = {1101, 2, pack(std::vector<unsigned char>(2, nibble(1, 1)))};
+    Tile tile = {1102, 7, pack(nibbles)};
+    cbcl.tiles_.push_back(other);
+    cbcl.tiles_.push_back(tile);
+    boost::filesystem::path cbclPath;
+    layout.getLaneTileCycleAttribute<isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFilePathAttributeTag>(
+        LANE, tile.tile_, CYCLE, cbclPath);
+    cbcl.write(cbclPath);
+
+    CbclTileReader reader(layout.getLongestAttribute<isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFilePathAttributeTag>().string().size(),
+                          false, false, MAX_CLUSTERS);
+    std::vector<char> buffer(sizeof(uint32_t) + MAX_CLUSTERS, 'x');
+    const isaac::flowcell::TileMetadata tileMetadata("FC", 0, tile.tile_, LANE, tile.clusters_, 0);
+    CPPUNIT_ASSERT_EQUAL(tile.clusters_, reader.readTileCycle(layout, tileMetadata, CYCLE, &buffer.front(), buffer.size()));
+    CPPUNIT_ASSERT_EQUAL(tile.clusters_, *reinterpret_cast<const uint32_t *>(&buffer.front()));
+    CPPUNIT_ASSERT(expected == std::string(&buffer[sizeof(uint32_t)], tile.clusters_));
+    // nothing written past the last cluster
+    CPPUNIT_ASSERT_EQUAL('x', buffer[sizeof(uint32_t) + tile.clusters_]);
+
+    // the other tile of the same file, single byte
+    const isaac::flowcell::TileMetadata otherMetadata("FC", 0, other.tile_, LANE, other.clusters_, 1);
+    CPPUNIT_ASSERT_EQUAL(other.clusters_, reader.readTileCycle(layout, otherMetadata, CYCLE, &buffer.front(), buffer.size()));
+    CPPUNIT_ASSERT_EQUAL(std::string(2, bcl(1, 10)), std::string(&buffer[sizeof(uint32_t)], other.clusters_));
+
+    // cluster count that does not match the uncompressed size of the block
+    const isaac::flowcell::TileMetadata wrongMetadata("FC", 0, tile.tile_, LANE, tile.clusters_ + 2, 0);
+    CPPUNIT_ASSERT_THROW(reader.readTileCycle(layout, wrongMetadata, CYCLE, &buffer.front(), buffer.size()),
+                         isaac::common::IoException);
+    // tile that is not in the file
+    const isaac::flowcell::TileMetadata missingMetadata("FC", 0, 1103, LANE, tile.clusters_, 0);
+    CPPUNIT_ASSERT_THROW(reader.readTileCycle(layout, missingMetadata, CYCLE, &buffer.front(), buffer.size()),
+                         isaac::common::IoException);
+}
+
+void TestCbclTileReader::testNonPfExcluded()
+{
+    isaac::flowcell::Layout layout(
+        tempDir_, isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFlowcellData(), 8, 0,
+        std::vector<unsigned>(), readMetadataList_, "FC");
+
+    // 9 clusters in the tile, 5 of them pass filter and are stored
+    const std::string pf("\1\0\0\1\1\0\1\0\1", 9);
+    std::vector<unsigned char> nibbles;
+    std::string expected;
+    for (std::size_t cluster = 0; pf.size() != cluster; ++cluster)
+    {
+        if (pf[cluster])
+        {
+            nibbles.push_back(nibble(cluster % 4, 1 + cluster % 2));
+            expected.push_back(bcl(cluster % 4, BIN_QSCORES[1 + cluster % 2]));
+        }
+        else
+        {
+            expected.push_back(0);
+        }
+    }
+
+    Cbcl cbcl;
+    cbcl.nonPfExcluded_ = true;
+    Tile tile = {1101, unsigned(nibbles.size()), pack(nibbles)};
+    cbcl.tiles_.push_back(tile);
+    boost::filesystem::path cbclPath;
+    layout.getLaneTileCycleAttribute<isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFilePathAttributeTag>(
+        LANE, tile.tile_, CYCLE, cbclPath);
+    cbcl.write(cbclPath);
+
+    // version 3 filter file: 0, version, cluster count, one byte per cluster
+    boost::filesystem::path filterPath;
+    layout.getLaneTileAttribute<isaac::flowcell::Layout::Cbcl, isaac::flowcell::FiltersFilePathAttributeTag>(
+        LANE, tile.tile_, filterPath);
+    {
+        std::ofstream os(filterPath.c_str(), std::ios_base::binary);
+        const uint32_t filterHeader[] = {0, 3, uint32_t(pf.size())};
+        os.write(reinterpret_cast<const char *>(filterHeader), sizeof(filterHeader));
+        os.write(pf.data(), pf.size());
+    }
+
+    CPPUNIT_ASSERT_EQUAL(unsigned(pf.size()), CbclTileReader::getTileClusterCount(
+        layout, readHeader(cbcl.str()), LANE, tile.tile_));
+
+    CbclTileReader reader(layout.getLongestAttribute<isaac::flowcell::Layout::Cbcl, isaac::flowcell::BclFilePathAttributeTag>().string().size(),
+                          false, false, MAX_CLUSTERS);
+    std::vector<char> buffer(sizeof(uint32_t) + MAX_CLUSTERS, 'x');
+    const isaac::flowcell::TileMetadata tileMetadata("FC", 0, tile.tile_, LANE, pf.size(), 0);
+    CPPUNIT_ASSERT_EQUAL(unsigned(pf.size()), reader.readTileCycle(layout, tileMetadata, CYCLE, &buffer.front(), buffer.size()));
+    CPPUNIT_ASSERT(expected == std::string(&buffer[sizeof(uint32_t)], pf.size()));
+    CPPUNIT_ASSERT_EQUAL('x', buffer[sizeof(uint32_t) + pf.size()]);
+}
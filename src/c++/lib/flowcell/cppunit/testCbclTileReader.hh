@@ -0,0 +1,45 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_FLOWCELL_TEST_CBCL_TILE_READER_HH
+#define iSAAC_FLOWCELL_TEST_CBCL_TILE_READER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "flowcell/ReadMetadata.hh"
+
+class TestCbclTileReader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestCbclTileReader );
+    CPPUNIT_TEST( testHeader );
+    CPPUNIT_TEST( testHeaderErrors );
+    CPPUNIT_TEST( testTranslate );
+    CPPUNIT_TEST( testOddClusterCount );
+    CPPUNIT_TEST( testNonPfExcluded );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    isaac::flowcell::ReadMetadataList readMetadataList_;
+public:
+    void setUp();
+    void tearDown();
+    void testHeader();
+    void testHeaderErrors();
+    void testTranslate();
+    void testOddClusterCount();
+    void testNonPfExcluded();
+};
+
+#endif // #ifndef iSAAC_FLOWCELL_TEST_CBCL_TILE_READER_HH
@@ -0,0 +1,269 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "RegistryName.hh"
+#include "testFastqLoader.hh"
+
+#include "io/FastqLoader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFastqLoader, registryName("FastqLoader"));
+
+using isaac::io::FastqLoader;
+using isaac::io::FastqReader;
+
+namespace
+{
+
+const unsigned READ_LENGTH = 37;
+const unsigned RECORDS = 300;
+const unsigned NAME_LENGTH_MAX = 10;
+// a few dozen records fit. Plenty of refills over RECORDS
+const std::size_t SMALL_BUFFER = 4096;
+
+std::string bases(const unsigned record, const unsigned read)
+{
+    std::string ret;
+    for (unsigned i = 0; READ_LENGTH != i; ++i)
+    {
+        ret.push_back("ACGTACGTTGCAN"[(record * 5 + read * 3 + i * 7) % 13]);
+    }
+    return ret;
+}
+
+std::string qualities(const unsigned record, const unsigned read)
+{
+    std::string ret;
+    for (unsigned i = 0; READ_LENGTH != i; ++i)
+    {
+        ret.push_back('!' + (record + read + i * 3) % 42);
+    }
+    return ret;
+}
+
+std::string name(const unsigned record, const unsigned read)
+{
+    return (boost::format("r%05d/%d") % record % (read + 1)).str();
+}
+
+void writeFastq(const boost::filesystem::path &path, const unsigned read, const unsigned records)
+{
+    std::ofstream os(path.c_str());
+    for (unsigned record = 0; records != record; ++record)
+    {
+        os << '@' << name(record, read) << " extra:header\n" << bases(record, read) << "\n+\n" <<
+            qualities(record, read) << '\n';
+    }
+    CPPUNIT_ASSERT(os);
+}
+
+std::string expectedBcl(const unsigned record, const unsigned read)
+{
+    const std::string b = bases(record, read);
+    const std::string q = qualities(record, read);
+    std::string ret;
+    for (unsigned i = 0; READ_LENGTH != i; ++i)
+    {
+        ret.push_back('N' == b[i] ? 0 : std::string("ACGT").find(b[i]) | (q[i] - '!') << 2);
+    }
+    return ret;
+}
+
+std::string expectedCluster(const unsigned record)
+{
+    std::string name2 = name(record, 1);
+    name2.resize(NAME_LENGTH_MAX, 0);
+    return expectedBcl(record, 0) + expectedBcl(record, 1) + name2;
+}
+
+std::string extractBcl(const FastqReader &reader, const FastqReader::Record &record,
+                       const isaac::flowcell::ReadMetadata &readMetadata)
+{
+    std::vector<char> bcl(READ_LENGTH);
+    CPPUNIT_ASSERT(bcl.end() == reader.extractBcl(record, readMetadata, bcl.begin()));
+    return std::string(bcl.begin(), bcl.end());
+}
+
+std::string extractName(const FastqReader &reader, const FastqReader::Record &record)
+{
+    std::vector<char> name(NAME_LENGTH_MAX);
+    CPPUNIT_ASSERT(name.end() == reader.extractReadName(record, NAME_LENGTH_MAX, name.begin()));
+    return std::string(name.begin(), name.end());
+}
+
+std::string paddedName(const unsigned record, const unsigned read)
+{
+    std::string ret = name(record, read);
+    ret.resize(NAME_LENGTH_MAX, 0);
+    return ret;
+}
+
+} // namespace
+
+void TestFastqLoader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+    r1Path_ = tempDir_ / "lane1_read1.fastq";
+    r2Path_ = tempDir_ / "lane1_read2.fastq";
+    shortR2Path_ = tempDir_ / "lane2_read2.fastq";
+    writeFastq(r1Path_, 0, RECORDS);
+    writeFastq(r2Path_, 1, RECORDS);
+    writeFastq(shortR2Path_, 1, RECORDS - 1);
+
+    readMetadataList_.clear();
+    readMetadataList_.push_back(isaac::flowcell::ReadMetadata(1, READ_LENGTH, 0, 0));
+    readMetadataList_.push_back(isaac::flowcell::ReadMetadata(READ_LENGTH + 1, READ_LENGTH * 2, 1, READ_LENGTH));
+}
+
+void TestFastqLoader::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestFastqLoader::testRefill()
+{
+    FastqReader reader(false, 1, 1024, SMALL_BUFFER);
+    reader.open(r1Path_, '!');
+    unsigned record = 0;
+    for (; reader.hasData(); reader.next(), ++record)
+    {
+        std::vector<char> bcl(READ_LENGTH);
+        reader.extractBcl(readMetadataList_.at(0), bcl.begin());
+        CPPUNIT_ASSERT_EQUAL(expectedBcl(record, 0), std::string(bcl.begin(), bcl.end()));
+        std::vector<char> name(NAME_LENGTH_MAX);
+        reader.extractReadName(NAME_LENGTH_MAX, name.begin());
+        CPPUNIT_ASSERT_EQUAL(paddedName(record, 0), std::string(name.begin(), name.end()));
+    }
+    CPPUNIT_ASSERT_EQUAL(RECORDS, record);
+}
+
+void TestFastqLoader::testIndexRetention()
+{
+    FastqReader reader(false, 1, 1024, SMALL_BUFFER);
+    reader.reserveRecords(RECORDS);
+    reader.open(r1Path_, '!');
+
+    // indexed records are limited to half of the buffer so that a refill always has room
+    std::size_t indexed = reader.indexRecords(RECORDS);
+    CPPUNIT_ASSERT(indexed);
+    CPPUNIT_ASSERT(RECORDS > indexed);
+    CPPUNIT_ASSERT(reader.getIndexedRecord(indexed - 1).headerBegin_ - reader.getIndexedRecord(0).headerBegin_ <
+                   SMALL_BUFFER / 2);
+
+    // release only some of the records each time. The rest must survive the refills
+    unsigned first = 0;
+    while (indexed)
+    {
+        for (std::size_t i = 0; indexed != i; ++i)
+        {
+            const FastqReader::Record &record = reader.getIndexedRecord(i);
+            CPPUNIT_ASSERT_EQUAL(expectedBcl(first + i, 0), extractBcl(reader, record, readMetadataList_.at(0)));
+            CPPUNIT_ASSERT_EQUAL(paddedName(first + i, 0), extractName(reader, record));
+        }
+        const std::size_t release = (indexed + 1) / 3;
+        reader.releaseRecords(release);
+        CPPUNIT_ASSERT_EQUAL(indexed - release, reader.getIndexedRecords());
+        first += release;
+        const std::size_t kept = reader.getIndexedRecords();
+        indexed = reader.indexRecords(RECORDS);
+        CPPUNIT_ASSERT(kept <= indexed);
+        if (indexed == kept && !reader.hasData())
+        {
+            reader.releaseRecords(kept);
+            first += kept;
+            indexed = reader.indexRecords(RECORDS);
+        }
+    }
+    CPPUNIT_ASSERT_EQUAL(RECORDS, first);
+}
+
+void TestFastqLoader::testPairedBatches()
+{
+    // different buffer sizes make the two files refill at different records
+    FastqReader r1(false, 1, 1024, SMALL_BUFFER);
+    FastqReader r2(false, 1, 1024, SMALL_BUFFER * 3 / 2);
+    r1.reserveRecords(RECORDS);
+    r2.reserveRecords(RECORDS);
+    r1.open(r1Path_, '!');
+    r2.open(r2Path_, '!');
+
+    unsigned loaded = 0;
+    unsigned batches = 0;
+    while (true)
+    {
+        r1.indexRecords(RECORDS);
+        r2.indexRecords(RECORDS);
+        const std::size_t batch = std::min(r1.getIndexedRecords(), r2.getIndexedRecords());
+        if (!batch)
+        {
+            break;
+        }
+        for (std::size_t i = 0; batch != i; ++i)
+        {
+            CPPUNIT_ASSERT_EQUAL(expectedBcl(loaded + i, 0), extractBcl(r1, r1.getIndexedRecord(i), readMetadataList_.at(0)));
+            CPPUNIT_ASSERT_EQUAL(expectedBcl(loaded + i, 1), extractBcl(r2, r2.getIndexedRecord(i), readMetadataList_.at(1)));
+            CPPUNIT_ASSERT_EQUAL(paddedName(loaded + i, 1), extractName(r2, r2.getIndexedRecord(i)));
+        }
+        r1.releaseRecords(batch);
+        r2.releaseRecords(batch);
+        loaded += batch;
+        ++batches;
+    }
+    CPPUNIT_ASSERT_EQUAL(RECORDS, loaded);
+    CPPUNIT_ASSERT(2 < batches);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), r1.getIndexedRecords());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), r2.getIndexedRecords());
+}
+
+void TestFastqLoader::testLoadClusters()
+{
+    std::string expected;
+    for (unsigned record = 0; RECORDS != record; ++record)
+    {
+        expected += expectedCluster(record);
+    }
+
+    // 1 and 2 loaders read the files one record at a time. 3 loaders with parallel extraction go by batches
+    const unsigned loaders[] = {1, 2, 3, 3};
+    for (unsigned i = 0; sizeof(loaders) / sizeof(loaders[0]) != i; ++i)
+    {
+        isaac::common::ThreadVector threads(3);
+        FastqLoader loader(false, 1024, threads, loaders[i], 3 == i);
+        loader.open(r1Path_, r2Path_, '!');
+        std::vector<char> clusters(expected.size() + 1, 'x');
+        // ask for more than there is
+        CPPUNIT_ASSERT_EQUAL(RECORDS, loader.loadClusters(RECORDS + 1, NAME_LENGTH_MAX, readMetadataList_, clusters.begin()));
+        CPPUNIT_ASSERT_EQUAL(expected, std::string(clusters.begin(), clusters.end() - 1));
+        CPPUNIT_ASSERT_EQUAL('x', clusters.back());
+    }
+}
+
+void TestFastqLoader::testMismatchingRecordCounts()
+{
+    const unsigned loaders[] = {1, 2, 3, 3};
+    for (unsigned i = 0; sizeof(loaders) / sizeof(loaders[0]) != i; ++i)
+    {
+        isaac::common::ThreadVector threads(3);
+        FastqLoader loader(false, 1024, threads, loaders[i], 3 == i);
+        loader.open(r1Path_, shortR2Path_, '!');
+        std::vector<char> clusters((RECORDS + 1) * (READ_LENGTH * 2 + NAME_LENGTH_MAX));
+        CPPUNIT_ASSERT_THROW(loader.loadClusters(RECORDS + 1, NAME_LENGTH_MAX, readMetadataList_, clusters.begin()),
+                             isaac::common::IoException);
+    }
+}
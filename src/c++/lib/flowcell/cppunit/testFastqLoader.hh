@@ -0,0 +1,48 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_FLOWCELL_TEST_FASTQ_LOADER_HH
+#define iSAAC_FLOWCELL_TEST_FASTQ_LOADER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "flowcell/ReadMetadata.hh"
+
+class TestFastqLoader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFastqLoader );
+    CPPUNIT_TEST( testRefill );
+    CPPUNIT_TEST( testIndexRetention );
+    CPPUNIT_TEST( testPairedBatches );
+    CPPUNIT_TEST( testLoadClusters );
+    CPPUNIT_TEST( testMismatchingRecordCounts );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    boost::filesystem::path r1Path_;
+    boost::filesystem::path r2Path_;
+    boost::filesystem::path shortR2Path_;
+    isaac::flowcell::ReadMetadataList readMetadataList_;
+public:
+    void setUp();
+    void tearDown();
+    void testRefill();
+    void testIndexRetention();
+    void testPairedBatches();
+    void testLoadClusters();
+    void testMismatchingRecordCounts();
+};
+
+#endif // #ifndef iSAAC_FLOWCELL_TEST_FASTQ_LOADER_HH
@@ -0,0 +1,252 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "RegistryName.hh"
+#include "testFastqReader.hh"
+
+#include "io/FastqReader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestFastqReader, registryName("FastqReader"));
+
+using isaac::io::FastqFormatException;
+using isaac::io::FastqReader;
+
+namespace
+{
+
+// longer than two 16-byte vectors so that every line end position within the vectors gets exercised
+const unsigned READ_LENGTH_MAX = 70;
+const char Q0 = '!';
+const std::size_t SMALL_BUFFER = 4096;
+
+struct FastqRecord
+{
+    std::string name_;
+    std::string bases_;
+    std::string qualities_;
+};
+
+/**
+ * \brief Records of varying header and read lengths, so that the line ends land on every offset within and at the
+ *        boundaries of the 16 and 32 byte chunks
+ */
+std::vector<FastqRecord> makeRecords(const unsigned count)
+{
+    std::vector<FastqRecord> ret;
+    for (unsigned record = 0; count != record; ++record)
+    {
+        FastqRecord fastqRecord;
+        fastqRecord.name_ = "r" + std::to_string(record);
+        fastqRecord.name_.resize(1 + record % 40, 'x');
+        const unsigned length = 1 + record * 7 % READ_LENGTH_MAX;
+        for (unsigned i = 0; length != i; ++i)
+        {
+            fastqRecord.bases_.push_back("ACGTNacgtn"[(record * 3 + i * 7) % 10]);
+            fastqRecord.qualities_.push_back(Q0 + (record + i * 5) % 64);
+        }
+        ret.push_back(fastqRecord);
+    }
+    return ret;
+}
+
+/**
+ * \brief Every third record uses dos line ends, every fifth repeats the name after the + sign
+ */
+std::string makeFastq(const std::vector<FastqRecord> &records)
+{
+    std::string ret;
+    for (unsigned record = 0; records.size() != record; ++record)
+    {
+        const FastqRecord &fastqRecord = records[record];
+        const std::string eol = record % 3 ? "\n" : "\r\n";
+        ret += "@" + fastqRecord.name_ + eol + fastqRecord.bases_ + eol +
+            "+" + (record % 5 ? "" : fastqRecord.name_) + eol + fastqRecord.qualities_ + eol;
+    }
+    return ret;
+}
+
+/**
+ * \brief Per-base translation of the record padded to READ_LENGTH_MAX
+ */
+std::string expectedBcl(const FastqRecord &fastqRecord)
+{
+    std::string ret(READ_LENGTH_MAX, 0);
+    for (unsigned i = 0; fastqRecord.bases_.size() != i; ++i)
+    {
+        const std::string::size_type base = std::string("ACGT").find(toupper(fastqRecord.bases_[i]));
+        ret[i] = std::string::npos == base ? 0 : char(base | (fastqRecord.qualities_[i] - Q0) << 2);
+    }
+    return ret;
+}
+
+/// contiguous output takes the vectorized translation
+std::string extractVectorized(const FastqReader &reader, const isaac::flowcell::ReadMetadata &readMetadata)
+{
+    std::vector<char> bcl(readMetadata.getLength());
+    CPPUNIT_ASSERT(bcl.end() == reader.extractBcl(readMetadata, bcl.begin()));
+    return std::string(bcl.begin(), bcl.end());
+}
+
+/// any other output iterator takes the per-base translation
+std::string extractPerBase(const FastqReader &reader, const isaac::flowcell::ReadMetadata &readMetadata)
+{
+    std::vector<unsigned char> bcl(readMetadata.getLength());
+    CPPUNIT_ASSERT(bcl.end() == reader.extractBcl(readMetadata, bcl.begin()));
+    return std::string(bcl.begin(), bcl.end());
+}
+
+void checkRecords(FastqReader &reader, const std::vector<FastqRecord> &records)
+{
+    const isaac::flowcell::ReadMetadata readMetadata(1, READ_LENGTH_MAX, 0, 0);
+    unsigned record = 0;
+    for (; reader.hasData(); reader.next(), ++record)
+    {
+        CPPUNIT_ASSERT(records.size() > record);
+        const FastqRecord &fastqRecord = records[record];
+        const FastqReader::IteratorPair header = reader.getHeader();
+        CPPUNIT_ASSERT_EQUAL("@" + fastqRecord.name_, std::string(header.first, header.second));
+        CPPUNIT_ASSERT_EQUAL(unsigned(fastqRecord.bases_.size()), reader.getReadLength());
+        CPPUNIT_ASSERT_EQUAL(expectedBcl(fastqRecord), extractVectorized(reader, readMetadata));
+        CPPUNIT_ASSERT_EQUAL(expectedBcl(fastqRecord), extractPerBase(reader, readMetadata));
+    }
+    CPPUNIT_ASSERT_EQUAL(records.size(), std::size_t(record));
+}
+
+} // namespace
+
+void TestFastqReader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestFastqReader::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+boost::filesystem::path TestFastqReader::write(const std::string &name, const std::string &content) const
+{
+    const boost::filesystem::path ret = tempDir_ / name;
+    std::ofstream os(ret.c_str(), std::ios_base::binary);
+    CPPUNIT_ASSERT(os.write(content.data(), content.size()));
+    return ret;
+}
+
+void TestFastqReader::testLineEnds()
+{
+    const std::vector<FastqRecord> records = makeRecords(400);
+    const boost::filesystem::path path = write("lineEnds.fastq", makeFastq(records));
+    // buffer sizes that are not multiples of the chunk leave tails shorter than a vector at each refill
+    const std::size_t bufferSizes[] = {SMALL_BUFFER, SMALL_BUFFER + 1, SMALL_BUFFER + 17, SMALL_BUFFER + 31};
+    for (const std::size_t bufferSize : bufferSizes)
+    {
+        FastqReader reader(true, 1, 1024, bufferSize);
+        reader.open(path, Q0);
+        checkRecords(reader, records);
+    }
+
+    // files shorter than a vector
+    const std::vector<FastqRecord> tiny(records.begin(), records.begin() + 1);
+    FastqReader reader(true, 1, 1024, SMALL_BUFFER);
+    reader.open(write("tiny.fastq", makeFastq(tiny)), Q0);
+    checkRecords(reader, tiny);
+}
+
+void TestFastqReader::testLineEndIndexCapacity()
+{
+    // more line ends than one indexing pass collects
+    const std::vector<FastqRecord> records = makeRecords(FastqReader::LINE_END_INDEX_CAPACITY / 2);
+    const std::string fastq = makeFastq(records);
+    FastqReader reader(true, 1, 1024, fastq.size() + 1);
+    reader.open(write("capacity.fastq", fastq), Q0);
+    checkRecords(reader, records);
+}
+
+void TestFastqReader::testTranslateBcl()
+{
+    // every length up to three vectors, so that each possible tail length follows whole vectors
+    std::vector<FastqRecord> records;
+    for (unsigned length = 1; 48 >= length; ++length)
+    {
+        FastqRecord fastqRecord;
+        fastqRecord.name_ = "l" + std::to_string(length);
+        for (unsigned i = 0; length != i; ++i)
+        {
+            fastqRecord.bases_.push_back("ACGTNacgtn"[(length + i) % 10]);
+            // qualities 0 and 63 are the edges of what fits into bcl
+            fastqRecord.qualities_.push_back(Q0 + (i % 2 ? 63 : (length * 13 + i) % 64));
+        }
+        records.push_back(fastqRecord);
+    }
+    // quality of N is not stored and is not validated
+    FastqRecord n;
+    n.name_ = "n";
+    n.bases_ = std::string(20, 'A') + "N" + std::string(19, 'n');
+    n.qualities_ = std::string(20, 'I') + char(Q0 + 64) + std::string(19, char(Q0 - 1));
+    records.push_back(n);
+
+    FastqReader reader(false, 1, 1024, SMALL_BUFFER);
+    reader.open(write("translate.fastq", makeFastq(records)), Q0);
+    for (const FastqRecord &fastqRecord : records)
+    {
+        CPPUNIT_ASSERT(reader.hasData());
+        const isaac::flowcell::ReadMetadata readMetadata(1, fastqRecord.bases_.size(), 0, 0);
+        const std::string expected = expectedBcl(fastqRecord).substr(0, fastqRecord.bases_.size());
+        CPPUNIT_ASSERT_EQUAL(expected, extractVectorized(reader, readMetadata));
+        CPPUNIT_ASSERT_EQUAL(expected, extractPerBase(reader, readMetadata));
+        reader.next();
+    }
+    CPPUNIT_ASSERT(!reader.hasData());
+}
+
+void TestFastqReader::testTranslateBclErrors()
+{
+    const unsigned lengths[] = {5, 16, 17, 33};
+    for (const unsigned length : lengths)
+    {
+        const unsigned positions[] = {0, length / 2, 15, length - 1};
+        for (const unsigned position : positions)
+        {
+            if (length <= position)
+            {
+                continue;
+            }
+            const isaac::flowcell::ReadMetadata readMetadata(1, length, 0, 0);
+            FastqRecord fastqRecord;
+            fastqRecord.name_ = "e";
+            fastqRecord.bases_ = std::string(length, 'C');
+            fastqRecord.qualities_ = std::string(length, 'I');
+
+            FastqRecord badBase = fastqRecord;
+            badBase.bases_[position] = 'X';
+            FastqReader baseReader(false, 1, 1024, SMALL_BUFFER);
+            baseReader.open(write("base" + std::to_string(length) + "_" + std::to_string(position),
+                                  makeFastq(std::vector<FastqRecord>(1, badBase))), Q0);
+            CPPUNIT_ASSERT_THROW(extractVectorized(baseReader, readMetadata), FastqFormatException);
+            CPPUNIT_ASSERT_THROW(extractPerBase(baseReader, readMetadata), FastqFormatException);
+
+            FastqRecord badQuality = fastqRecord;
+            badQuality.qualities_[position] = Q0 + 64;
+            FastqReader qualityReader(false, 1, 1024, SMALL_BUFFER);
+            qualityReader.open(write("quality" + std::to_string(length) + "_" + std::to_string(position),
+                                     makeFastq(std::vector<FastqRecord>(1, badQuality))), Q0);
+            CPPUNIT_ASSERT_THROW(extractVectorized(qualityReader, readMetadata), FastqFormatException);
+            CPPUNIT_ASSERT_THROW(extractPerBase(qualityReader, readMetadata), FastqFormatException);
+        }
+    }
+}
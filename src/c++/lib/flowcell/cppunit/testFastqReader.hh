@@ -0,0 +1,43 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_FLOWCELL_TEST_FASTQ_READER_HH
+#define iSAAC_FLOWCELL_TEST_FASTQ_READER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+class TestFastqReader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestFastqReader );
+    CPPUNIT_TEST( testLineEnds );
+    CPPUNIT_TEST( testLineEndIndexCapacity );
+    CPPUNIT_TEST( testTranslateBcl );
+    CPPUNIT_TEST( testTranslateBclErrors );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    boost::filesystem::path write(const std::string &name, const std::string &content) const;
+public:
+    void setUp();
+    void tearDown();
+    void testLineEnds();
+    void testLineEndIndexCapacity();
+    void testTranslateBcl();
+    void testTranslateBclErrors();
+};
+
+#endif // #ifndef iSAAC_FLOWCELL_TEST_FASTQ_READER_HH
@@ -0,0 +1,328 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncFileReader.cpp
+ **
+ ** \brief See AsyncFileReader.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/Threads.hpp"
+#include "io/AsyncFileReader.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+const std::size_t AsyncFileReader::DIRECT_IO_ALIGNMENT;
+const std::size_t AsyncFileReader::DEFAULT_BLOCK_BYTES;
+const uint64_t AsyncFileReader::UNTIL_EOF;
+
+static char *allocateAligned(const std::size_t bytes)
+{
+    void *ret = 0;
+    const int error = posix_memalign(&ret, AsyncFileReader::DIRECT_IO_ALIGNMENT, bytes);
+    if (error)
+    {
+        BOOST_THROW_EXCEPTION(common::MemoryException(
+            (boost::format("Failed to allocate %d bytes for read buffers: %s") % bytes % strerror(error)).str()));
+    }
+    return static_cast<char *>(ret);
+}
+
+static uint64_t microsecondsSince(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+AsyncFileReader::AsyncFileReader(const bool directIo, const std::size_t blockBytes) :
+    directIo_(directIo),
+    blockBytes_(blockBytes),
+    buffer_(allocateAligned(blockBytes * 2), &free),
+    terminate_(false),
+    fd_(-1),
+    path_(""),
+    rangeBegin_(0),
+    rangeEnd_(0),
+    nextRequestOffset_(0),
+    current_(0),
+    tell_(0),
+    thread_(boost::bind(&AsyncFileReader::threadFunc, this))
+{
+    ISAAC_ASSERT_MSG(blockBytes_ && !(blockBytes_ % DIRECT_IO_ALIGNMENT),
+                     "Block size must be a multiple of " << DIRECT_IO_ALIGNMENT << " got: " << blockBytes_);
+    blocks_[0].data_ = buffer_.get();
+    blocks_[1].data_ = buffer_.get() + blockBytes_;
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    close();
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        terminate_ = true;
+        stateChangedCondition_.notify_all();
+    }
+    thread_.join();
+}
+
+void AsyncFileReader::open(const char *path, const uint64_t offset, uint64_t bytes)
+{
+    // previous client could have failed without closing
+    close();
+    path_ = path;
+
+    if (directIo_)
+    {
+        fd_ = ::open(path, O_RDONLY | O_DIRECT);
+        // tmpfs and some network file systems refuse O_DIRECT
+        counters_.direct_ = -1 != fd_;
+    }
+    if (-1 == fd_)
+    {
+        fd_ = ::open(path, O_RDONLY);
+        if (-1 == fd_)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, std::string("Failed to open ") + path));
+        }
+        posix_fadvise(fd_, offset, UNTIL_EOF == bytes ? 0 : bytes, POSIX_FADV_SEQUENTIAL);
+    }
+
+    // don't leak the descriptor if the file turns out to be unusable
+    ISAAC_BLOCK_WITH_CLENAUP([this](const bool failure){if (failure) {::close(fd_); fd_ = -1;}})
+    {
+        if (UNTIL_EOF == bytes)
+        {
+            struct stat fileStat;
+            if (fstat(fd_, &fileStat))
+            {
+                BOOST_THROW_EXCEPTION(common::IoException(errno, std::string("Failed to stat ") + path));
+            }
+            bytes = uint64_t(fileStat.st_size) > offset ? fileStat.st_size - offset : 0;
+        }
+    }
+
+    rangeBegin_ = offset;
+    rangeEnd_ = offset + bytes;
+    tell_ = offset;
+    nextRequestOffset_ = offset & ~uint64_t(DIRECT_IO_ALIGNMENT - 1);
+    current_ = 0;
+    request(0);
+    request(1);
+}
+
+void AsyncFileReader::request(const unsigned blockIndex)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Block &block = blocks_[blockIndex];
+    ISAAC_ASSERT_MSG(!block.requested_, "Block is already requested");
+    block.begin_ = block.end_ = 0;
+    block.errno_ = 0;
+    if (nextRequestOffset_ >= rangeEnd_)
+    {
+        // nothing left to read. Client will see an empty last block
+        block.ready_ = true;
+        block.last_ = true;
+        return;
+    }
+    block.fileOffset_ = nextRequestOffset_;
+    block.ready_ = false;
+    block.last_ = false;
+    block.requested_ = true;
+    nextRequestOffset_ += blockBytes_;
+    stateChangedCondition_.notify_all();
+}
+
+AsyncFileReader::Block &AsyncFileReader::waitReady(const unsigned blockIndex)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Block &block = blocks_[blockIndex];
+    if (!block.ready_)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        while (!block.ready_)
+        {
+            stateChangedCondition_.wait(lock);
+        }
+        counters_.waitMicroseconds_ += microsecondsSince(start);
+    }
+    return block;
+}
+
+std::size_t AsyncFileReader::read(char *buffer, std::size_t bytes)
+{
+    ISAAC_ASSERT_MSG(-1 != fd_, "File must be open");
+    std::size_t ret = 0;
+    while (bytes != ret)
+    {
+        Block &block = waitReady(current_);
+        if (block.errno_)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(
+                block.errno_, (boost::format("Failed to read %d bytes at offset %d from %s") %
+                    blockBytes_ % block.fileOffset_ % path_).str()));
+        }
+        if (block.begin_ == block.end_)
+        {
+            if (block.last_)
+            {
+                break;
+            }
+            // the other block has been reading while this one was consumed
+            request(current_);
+            current_ ^= 1;
+            continue;
+        }
+        const std::size_t copy = std::min(bytes - ret, block.end_ - block.begin_);
+        memcpy(buffer + ret, block.data_ + block.begin_, copy);
+        block.begin_ += copy;
+        ret += copy;
+    }
+    tell_ += ret;
+    counters_.bytes_ += ret;
+    return ret;
+}
+
+void AsyncFileReader::close()
+{
+    if (-1 == fd_)
+    {
+        return;
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (blocks_[0].requested_ || blocks_[1].requested_)
+        {
+            stateChangedCondition_.wait(lock);
+        }
+        blocks_[0].ready_ = blocks_[1].ready_ = false;
+    }
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void AsyncFileReader::readBlock(Block &block)
+{
+    std::size_t want = std::min<uint64_t>(blockBytes_, rangeEnd_ - block.fileOffset_);
+    if (counters_.direct_)
+    {
+        want = (want + DIRECT_IO_ALIGNMENT - 1) & ~(DIRECT_IO_ALIGNMENT - 1);
+    }
+
+    std::size_t got = 0;
+    int error = 0;
+    while (want != got)
+    {
+        const ssize_t result = pread(fd_, block.data_ + got, want - got, block.fileOffset_ + got);
+        if (0 > result)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        if (!result)
+        {
+            break;
+        }
+        got += result;
+    }
+
+    if (!counters_.direct_ && got)
+    {
+        // bin data is read once. Don't let it evict the reference and other bins from page cache
+        posix_fadvise(fd_, block.fileOffset_, got, POSIX_FADV_DONTNEED);
+    }
+
+    block.errno_ = error;
+    block.end_ = std::min<uint64_t>(got, rangeEnd_ - block.fileOffset_);
+    block.begin_ = std::min<uint64_t>(block.end_, block.fileOffset_ < rangeBegin_ ? rangeBegin_ - block.fileOffset_ : 0);
+    block.last_ = want != got || block.fileOffset_ + got >= rangeEnd_;
+}
+
+bool AsyncFileReader::reopenBuffered()
+{
+    // some file systems accept O_DIRECT in open but refuse the reads
+    const int fd = ::open(path_, O_RDONLY);
+    if (-1 == fd)
+    {
+        return false;
+    }
+    // keep the descriptor number so that the client does not notice the reopen
+    const bool ret = -1 != dup2(fd, fd_);
+    ::close(fd);
+    if (ret)
+    {
+        ISAAC_THREAD_CERR << "WARNING: O_DIRECT reads failed, reading through page cache: " << path_ << std::endl;
+        counters_.direct_ = false;
+        posix_fadvise(fd_, rangeBegin_, rangeEnd_ - rangeBegin_, POSIX_FADV_SEQUENTIAL);
+    }
+    return ret;
+}
+
+void AsyncFileReader::threadFunc()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        Block *next = 0;
+        for (Block &block : blocks_)
+        {
+            if (block.requested_ && (!next || block.fileOffset_ < next->fileOffset_))
+            {
+                next = &block;
+            }
+        }
+
+        if (next)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            {
+                lock.unlock();
+                readBlock(*next);
+                lock.lock();
+            }
+            counters_.readMicroseconds_ += microsecondsSince(start);
+            if (EINVAL == next->errno_ && counters_.direct_ && reopenBuffered())
+            {
+                // the block stays requested and gets read again through page cache
+                continue;
+            }
+            next->requested_ = false;
+            next->ready_ = true;
+            stateChangedCondition_.notify_all();
+        }
+        else
+        {
+            stateChangedCondition_.wait(lock);
+        }
+    }
+}
+
+} // namespace io
+} // namespace isaac
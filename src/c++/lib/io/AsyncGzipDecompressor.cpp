@@ -0,0 +1,188 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file AsyncGzipDecompressor.cpp
+ **
+ ** \brief See AsyncGzipDecompressor.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstring>
+
+#include "common/Debug.hh"
+#include "common/Threads.hpp"
+#include "io/AsyncGzipDecompressor.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+const std::size_t AsyncGzipDecompressor::DEFAULT_BLOCK_BYTES;
+
+AsyncGzipDecompressor::AsyncGzipDecompressor(const std::size_t blockBytes) :
+    terminate_(false),
+    compressedStream_(0),
+    active_(false),
+    inflating_(false),
+    produce_(0),
+    consume_(0),
+    eof_(true)
+{
+    for (Block &block : blocks_)
+    {
+        block.data_.resize(blockBytes);
+    }
+}
+
+AsyncGzipDecompressor::~AsyncGzipDecompressor()
+{
+    reset();
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        terminate_ = true;
+        stateChangedCondition_.notify_all();
+    }
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void AsyncGzipDecompressor::start(std::istream &compressedStream)
+{
+    reset();
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    inflater_.reset();
+    compressedStream_ = &compressedStream;
+    eof_ = false;
+    active_ = true;
+    if (thread_.joinable())
+    {
+        stateChangedCondition_.notify_all();
+    }
+    else
+    {
+        // picks up the stream once the lock is released
+        thread_ = boost::thread(boost::bind(&AsyncGzipDecompressor::threadFunc, this));
+    }
+}
+
+void AsyncGzipDecompressor::reset()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    active_ = false;
+    while (inflating_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    for (Block &block : blocks_)
+    {
+        block.ready_ = false;
+        block.last_ = false;
+        block.begin_ = block.end_ = 0;
+        block.error_ = std::exception_ptr();
+    }
+    produce_ = consume_ = 0;
+    compressedStream_ = 0;
+    eof_ = true;
+}
+
+std::size_t AsyncGzipDecompressor::read(char *buffer, std::size_t amount)
+{
+    std::size_t ret = 0;
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (amount != ret && !eof_)
+    {
+        Block &block = blocks_[consume_];
+        while (!block.ready_)
+        {
+            stateChangedCondition_.wait(lock);
+        }
+        if (block.error_)
+        {
+            eof_ = true;
+            std::rethrow_exception(block.error_);
+        }
+
+        {
+            // the helper thread does not touch a ready block
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            const std::size_t copy = std::min(amount - ret, block.end_ - block.begin_);
+            memcpy(buffer + ret, &block.data_.front() + block.begin_, copy);
+            block.begin_ += copy;
+            ret += copy;
+        }
+
+        if (block.end_ == block.begin_)
+        {
+            eof_ = block.last_;
+            block.ready_ = false;
+            consume_ ^= 1;
+            stateChangedCondition_.notify_all();
+        }
+    }
+    return ret;
+}
+
+void AsyncGzipDecompressor::fill(Block &block)
+{
+    try
+    {
+        const std::streamsize uncompressed =
+            inflater_.read(*compressedStream_, 0, &block.data_.front(), block.data_.size());
+        block.begin_ = 0;
+        block.end_ = -1 == uncompressed ? 0 : uncompressed;
+        block.last_ = inflater_.isEof(*compressedStream_);
+        ISAAC_ASSERT_MSG(-1 != uncompressed || block.last_, "Did not reach eof while unable to uncompress anymore");
+    }
+    catch (...)
+    {
+        block.error_ = std::current_exception();
+        block.last_ = true;
+    }
+}
+
+void AsyncGzipDecompressor::threadFunc()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        Block &block = blocks_[produce_];
+        if (active_ && !block.ready_)
+        {
+            inflating_ = true;
+            {
+                common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+                fill(block);
+            }
+            inflating_ = false;
+            // reset could have discarded the stream while the block was being filled
+            if (active_)
+            {
+                block.ready_ = true;
+                produce_ ^= 1;
+                // nothing more to produce until the next start
+                active_ = !block.last_;
+            }
+            stateChangedCondition_.notify_all();
+        }
+        else
+        {
+            stateChangedCondition_.wait(lock);
+        }
+    }
+}
+
+} // namespace io
+} // namespace isaac
@@ -33,31 +33,41 @@ namespace io
 
 BamLoader::BamLoader(
     std::size_t maxPathLength,
-    common::ThreadVector &threads,
-    const unsigned coresMax) :
+    const unsigned coresMax,
+    const cram::References &references) :
+    coresMax_(coresMax),
+    references_(references),
     // one of the threads is busy parsing
-    bgzfReader_(std::max(1U, coresMax - 1), BUFFER_SIZE / std::max(1U, coresMax - 1) / bgzf::BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE / 10),
+    pipeline_(std::max(1U, coresMax - 1), PIPELINE_BUFFERS, BUFFER_SIZE - UNPARSED_BYTES_MAX, UNPARSED_BYTES_MAX,
+              BGZF_BLOCKS_PER_BATCH),
+    cram_(false),
     lastUnparsedBytes_(0),
-    // since the loading from bam has to happen sequentially, and we can have only one thread parsing,
-    // the only parallelization can occur between a thread parsing and a bunch of threads loading and decompressing
-    // so, 2 is a good ceiling here
-    decompressParseParallelization_(std::min<unsigned>(coresMax, 2)),
-    unparsedBytes_(decompressParseParallelization_),
-    decompressionBuffers_(decompressParseParallelization_),
-    decompressParseParallelizationThreads_(threads),
-    nextDecompressorThread_(0),
-    nextParserThread_(0)
+    unparsedBegin_(0)
 {
-    reserveBuffers(maxPathLength);
 }
 
-void BamLoader::reserveBuffers(std::size_t maxPathLength)
+void BamLoader::open(const boost::filesystem::path &bamPath)
 {
-    lastPassBam_.reserve(BUFFER_SIZE);
-    std::for_each(decompressionBuffers_.begin(), decompressionBuffers_.end(), boost::bind(&std::vector<char>::reserve, _1, BUFFER_SIZE));
+    bgzfPasses_ = Passes<bgzf::BgzfInflatePipeline>();
+    cramPasses_ = Passes<CramDecodePipeline>();
+    lastUnparsedBytes_ = 0;
+    unparsedBegin_ = 0;
+    cram_ = cram::isCram(bamPath);
+    if (cram_)
+    {
+        if (!cramPipeline_)
+        {
+            cramPipeline_.reset(new CramDecodePipeline(
+                std::max(1U, coresMax_ - 1), PIPELINE_BUFFERS, CRAM_CONTAINERS_PER_BUFFER, UNPARSED_BYTES_MAX));
+        }
+        cramPipeline_->open(bamPath, references_);
+    }
+    else
+    {
+        pipeline_.open(bamPath);
+    }
+    bamParser_.reset();
 }
 
-
-
 } // namespace io
 } // namespace isaac
@@ -0,0 +1,1879 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file Cram.cpp
+ **
+ ** \brief CRAM 3.0 containers, blocks and the decoder that turns CRAM containers into bam records.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <zlib.h>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "bam/Bam.hh"
+#include "common/Debug.hh"
+#include "common/Endianness.hh"
+#include "io/Cram.hh"
+
+namespace isaac
+{
+namespace io
+{
+namespace cram
+{
+
+const char EOF_CONTAINER[EOF_CONTAINER_LENGTH] =
+{
+    '\x0f', '\x00', '\x00', '\x00', '\xff', '\xff', '\xff', '\xff', '\x0f', '\xe0', '\x45', '\x4f', '\x46', '\x00',
+    '\x00', '\x00', '\x00', '\x01', '\x00', '\x05', '\xbd', '\xd9', '\x4f', '\x00', '\x01', '\x00', '\x06', '\x06',
+    '\x01', '\x00', '\x01', '\x00', '\x01', '\x00', '\xee', '\x63', '\x01', '\x4b'
+};
+
+static void truncated(const char *what)
+{
+    BOOST_THROW_EXCEPTION(CramException(std::string("Truncated CRAM data while reading ") + what));
+}
+
+void putItf8(std::vector<char> &buffer, const int32_t value)
+{
+    const uint32_t v = value;
+    if (!(v & ~0x7fU))
+    {
+        buffer.push_back(v);
+    }
+    else if (!(v & ~0x3fffU))
+    {
+        buffer.push_back(0x80 | (v >> 8));
+        buffer.push_back(v);
+    }
+    else if (!(v & ~0x1fffffU))
+    {
+        buffer.push_back(0xc0 | (v >> 16));
+        buffer.push_back(v >> 8);
+        buffer.push_back(v);
+    }
+    else if (!(v & ~0x0fffffffU))
+    {
+        buffer.push_back(0xe0 | (v >> 24));
+        buffer.push_back(v >> 16);
+        buffer.push_back(v >> 8);
+        buffer.push_back(v);
+    }
+    else
+    {
+        buffer.push_back(0xf0 | (v >> 28));
+        buffer.push_back(v >> 20);
+        buffer.push_back(v >> 12);
+        buffer.push_back(v >> 4);
+        buffer.push_back(v & 0x0f);
+    }
+}
+
+void putLtf8(std::vector<char> &buffer, const int64_t value)
+{
+    const uint64_t v = value;
+    unsigned extra = 0;
+    while (extra < 8 && (v >> (7 * (extra + 1))))
+    {
+        ++extra;
+    }
+    // leading ones tell the number of bytes that follow, the rest of the first byte carries the top of the value
+    const unsigned char prefix = 0xff00 >> extra;
+    buffer.push_back(8 == extra ? prefix : (prefix | (v >> (8 * extra))));
+    while (extra--)
+    {
+        buffer.push_back(v >> (8 * extra));
+    }
+}
+
+void putInt32(std::vector<char> &buffer, const int32_t value)
+{
+    const uint32_t v = value;
+    buffer.push_back(v);
+    buffer.push_back(v >> 8);
+    buffer.push_back(v >> 16);
+    buffer.push_back(v >> 24);
+}
+
+const char *getItf8(const char *p, const char *end, int32_t &value)
+{
+    static const unsigned LENGTHS[16] = {1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 4, 5};
+    if (p == end)
+    {
+        truncated("itf8");
+    }
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+    const unsigned length = LENGTHS[u[0] >> 4];
+    if (std::size_t(end - p) < length)
+    {
+        truncated("itf8");
+    }
+    switch (length)
+    {
+    case 1:
+        value = u[0];
+        break;
+    case 2:
+        value = ((u[0] & 0x3f) << 8) | u[1];
+        break;
+    case 3:
+        value = ((u[0] & 0x1f) << 16) | (u[1] << 8) | u[2];
+        break;
+    case 4:
+        value = ((u[0] & 0x0f) << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+        break;
+    default:
+        value = (uint32_t(u[0] & 0x0f) << 28) | (u[1] << 20) | (u[2] << 12) | (u[3] << 4) | (u[4] & 0x0f);
+        break;
+    }
+    return p + length;
+}
+
+const char *getLtf8(const char *p, const char *end, int64_t &value)
+{
+    if (p == end)
+    {
+        truncated("ltf8");
+    }
+    const unsigned char first = *p++;
+    unsigned extra = 0;
+    while (extra < 8 && (first & (0x80 >> extra)))
+    {
+        ++extra;
+    }
+    if (std::size_t(end - p) < extra)
+    {
+        truncated("ltf8");
+    }
+    uint64_t v = 8 == extra ? 0 : (first & (0xff >> (extra + 1)));
+    while (extra--)
+    {
+        v = (v << 8) | static_cast<unsigned char>(*p++);
+    }
+    value = v;
+    return p;
+}
+
+const char *getInt32(const char *p, const char *end, int32_t &value)
+{
+    if (end - p < 4)
+    {
+        truncated("int32");
+    }
+    const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+    value = uint32_t(u[0]) | (uint32_t(u[1]) << 8) | (uint32_t(u[2]) << 16) | (uint32_t(u[3]) << 24);
+    return p + 4;
+}
+
+static uint32_t crc(const char *begin, const char *end)
+{
+    return crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(begin), end - begin);
+}
+
+/**
+ * \brief reads one itf8 or ltf8 value from the stream, keeping its raw bytes for the crc check
+ */
+template <typename T>
+static T readVarint(std::istream &is, std::vector<char> &raw, const char *(*get)(const char *, const char *, T &))
+{
+    const std::size_t begin = raw.size();
+    const int first = is.get();
+    if (std::char_traits<char>::eof() == first)
+    {
+        truncated("container header");
+    }
+    raw.push_back(first);
+    unsigned extra = 0;
+    while (extra < 8 && (first & (0x80 >> extra)))
+    {
+        ++extra;
+    }
+    // itf8 never has more than 4 bytes following the first one
+    if (sizeof(T) == sizeof(int32_t))
+    {
+        extra = std::min(extra, 4U);
+    }
+    raw.resize(begin + 1 + extra);
+    if (extra && !is.read(&raw[begin + 1], extra))
+    {
+        truncated("container header");
+    }
+    T ret = 0;
+    get(&raw[begin], &raw.back() + 1, ret);
+    return ret;
+}
+
+bool readContainerHeader(std::istream &is, ContainerHeader &header)
+{
+    std::vector<char> raw(4);
+    if (!is.read(&raw.front(), raw.size()))
+    {
+        if (!is.gcount() && is.eof())
+        {
+            return false;
+        }
+        truncated("container header");
+    }
+    getInt32(&raw.front(), &raw.back() + 1, header.length_);
+    header.refId_ = readVarint<int32_t>(is, raw, getItf8);
+    header.start_ = readVarint<int32_t>(is, raw, getItf8);
+    header.span_ = readVarint<int32_t>(is, raw, getItf8);
+    header.records_ = readVarint<int32_t>(is, raw, getItf8);
+    header.recordCounter_ = readVarint<int64_t>(is, raw, getLtf8);
+    header.bases_ = readVarint<int64_t>(is, raw, getLtf8);
+    header.blocks_ = readVarint<int32_t>(is, raw, getItf8);
+    const int32_t landmarks = readVarint<int32_t>(is, raw, getItf8);
+    if (0 > landmarks || 0 > header.length_)
+    {
+        BOOST_THROW_EXCEPTION(CramException("Corrupt CRAM container header"));
+    }
+    header.landmarks_.clear();
+    while (header.landmarks_.size() < std::size_t(landmarks))
+    {
+        header.landmarks_.push_back(readVarint<int32_t>(is, raw, getItf8));
+    }
+
+    char crcBytes[4];
+    if (!is.read(crcBytes, sizeof(crcBytes)))
+    {
+        truncated("container header");
+    }
+    int32_t expectedCrc = 0;
+    getInt32(crcBytes, crcBytes + sizeof(crcBytes), expectedCrc);
+    if (uint32_t(expectedCrc) != crc(&raw.front(), &raw.back() + 1))
+    {
+        BOOST_THROW_EXCEPTION(CramException("CRAM container header CRC32 mismatch"));
+    }
+    return true;
+}
+
+void putContainerHeader(std::vector<char> &buffer, const ContainerHeader &header)
+{
+    const std::size_t begin = buffer.size();
+    putInt32(buffer, header.length_);
+    putItf8(buffer, header.refId_);
+    putItf8(buffer, header.start_);
+    putItf8(buffer, header.span_);
+    putItf8(buffer, header.records_);
+    putLtf8(buffer, header.recordCounter_);
+    putLtf8(buffer, header.bases_);
+    putItf8(buffer, header.blocks_);
+    putItf8(buffer, header.landmarks_.size());
+    BOOST_FOREACH(const int32_t landmark, header.landmarks_)
+    {
+        putItf8(buffer, landmark);
+    }
+    putInt32(buffer, crc(&buffer[begin], &buffer.back() + 1));
+}
+
+static void gunzip(const char *compressed, const std::size_t compressedSize, std::vector<char> &data)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // 32 enables gzip and zlib header detection
+    int error = inflateInit2(&strm, 15 + 32);
+    if (Z_OK != error)
+    {
+        BOOST_THROW_EXCEPTION(CramException((boost::format("inflateInit2 failed: %d") % error).str()));
+    }
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed));
+    strm.avail_in = compressedSize;
+    strm.next_out = reinterpret_cast<Bytef*>(data.empty() ? 0 : &data.front());
+    strm.avail_out = data.size();
+    error = inflate(&strm, Z_FINISH);
+    const std::size_t inflated = strm.total_out;
+    inflateEnd(&strm);
+    if (Z_STREAM_END != error || data.size() != inflated)
+    {
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("Failed to inflate CRAM block. zlib error %d, %d bytes inflated out of %d") %
+                error % inflated % data.size()).str()));
+    }
+}
+
+static void gzip(const std::vector<char> &data, const int gzipLevel, std::vector<char> &compressed)
+{
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // 16 makes zlib produce gzip header and trailer
+    int error = deflateInit2(&strm, gzipLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    if (Z_OK != error)
+    {
+        BOOST_THROW_EXCEPTION(CramException((boost::format("deflateInit2 failed: %d") % error).str()));
+    }
+    compressed.resize(deflateBound(&strm, data.size()) + 32);
+    strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.empty() ? 0 : &data.front()));
+    strm.avail_in = data.size();
+    strm.next_out = reinterpret_cast<Bytef*>(&compressed.front());
+    strm.avail_out = compressed.size();
+    error = deflate(&strm, Z_FINISH);
+    compressed.resize(strm.total_out);
+    deflateEnd(&strm);
+    if (Z_STREAM_END != error)
+    {
+        BOOST_THROW_EXCEPTION(CramException((boost::format("Failed to deflate CRAM block. zlib error %d") % error).str()));
+    }
+}
+
+/**
+ * \brief Bounds-checked reader of the rANS stream
+ */
+struct RansCursor
+{
+    RansCursor(const unsigned char *p, const unsigned char *end) : p_(p), end_(end){}
+    const unsigned char *p_;
+    const unsigned char *end_;
+
+    unsigned char peek() const
+    {
+        if (p_ == end_)
+        {
+            truncated("rANS stream");
+        }
+        return *p_;
+    }
+    unsigned char get()
+    {
+        const unsigned char ret = peek();
+        ++p_;
+        return ret;
+    }
+    unsigned getFrequency()
+    {
+        unsigned ret = get();
+        if (ret >= 128)
+        {
+            ret = ((ret & 127) << 8) | get();
+        }
+        return ret;
+    }
+    uint32_t getState()
+    {
+        uint32_t ret = get();
+        ret |= uint32_t(get()) << 8;
+        ret |= uint32_t(get()) << 16;
+        ret |= uint32_t(get()) << 24;
+        return ret;
+    }
+    void renormalize(uint32_t &state)
+    {
+        while (state < RANS_BYTE_L)
+        {
+            state = (state << 8) | get();
+        }
+    }
+
+    static const unsigned TF_SHIFT = 12;
+    static const unsigned TOTFREQ = 1 << TF_SHIFT;
+    static const uint32_t RANS_BYTE_L = 1 << 23;
+};
+
+/**
+ * \brief Reads the run-length encoded symbol list of a frequency table. Calls symbolFrequency for each symbol
+ */
+template <typename SymbolFrequencyT>
+static void readRansSymbols(RansCursor &cursor, SymbolFrequencyT symbolFrequency)
+{
+    unsigned rle = 0;
+    unsigned symbol = cursor.get();
+    do
+    {
+        symbolFrequency(symbol);
+        if (!rle && symbol + 1 == cursor.peek())
+        {
+            symbol = cursor.get();
+            rle = cursor.get();
+        }
+        else if (rle)
+        {
+            --rle;
+            ++symbol;
+        }
+        else
+        {
+            symbol = cursor.get();
+        }
+        if (symbol > 0xff)
+        {
+            BOOST_THROW_EXCEPTION(CramException("Corrupt rANS frequency table"));
+        }
+    }
+    while (symbol);
+}
+
+struct RansFrequencies
+{
+    RansFrequencies() : total_(0)
+    {
+        std::fill(frequency_, frequency_ + 256, 0);
+        std::fill(cumulative_, cumulative_ + 256, 0);
+    }
+    uint32_t frequency_[256];
+    uint32_t cumulative_[256];
+    unsigned char symbol_[RansCursor::TOTFREQ];
+    unsigned total_;
+
+    void add(const unsigned symbol, const unsigned frequency)
+    {
+        if (total_ + frequency > RansCursor::TOTFREQ)
+        {
+            BOOST_THROW_EXCEPTION(CramException("Corrupt rANS frequency table"));
+        }
+        frequency_[symbol] = frequency;
+        cumulative_[symbol] = total_;
+        std::fill(symbol_ + total_, symbol_ + total_ + frequency, symbol);
+        total_ += frequency;
+    }
+
+    unsigned char decode(uint32_t &state, RansCursor &cursor) const
+    {
+        const uint32_t m = state & (RansCursor::TOTFREQ - 1);
+        const unsigned char symbol = symbol_[m];
+        state = frequency_[symbol] * (state >> RansCursor::TF_SHIFT) + m - cumulative_[symbol];
+        cursor.renormalize(state);
+        return symbol;
+    }
+};
+
+struct AddOrder0Frequency
+{
+    AddOrder0Frequency(RansCursor &cursor, RansFrequencies &frequencies) : cursor_(cursor), frequencies_(frequencies){}
+    RansCursor &cursor_;
+    RansFrequencies &frequencies_;
+    void operator()(const unsigned symbol) const
+    {
+        frequencies_.add(symbol, cursor_.getFrequency());
+    }
+};
+
+struct AddOrder1Frequency
+{
+    AddOrder1Frequency(RansCursor &cursor, RansFrequencies &frequencies) : cursor_(cursor), frequencies_(frequencies){}
+    RansCursor &cursor_;
+    RansFrequencies &frequencies_;
+    void operator()(const unsigned symbol) const
+    {
+        const unsigned frequency = cursor_.getFrequency();
+        frequencies_.add(symbol, frequency ? frequency : unsigned(RansCursor::TOTFREQ));
+    }
+};
+
+struct AddOrder1Context
+{
+    AddOrder1Context(RansCursor &cursor, std::vector<RansFrequencies> &contexts) : cursor_(cursor), contexts_(contexts){}
+    RansCursor &cursor_;
+    std::vector<RansFrequencies> &contexts_;
+    void operator()(const unsigned context) const
+    {
+        readRansSymbols(cursor_, AddOrder1Frequency(cursor_, contexts_.at(context)));
+    }
+};
+
+static void ransUncompressOrder0(RansCursor &cursor, std::vector<char> &data)
+{
+    RansFrequencies frequencies;
+    readRansSymbols(cursor, AddOrder0Frequency(cursor, frequencies));
+
+    uint32_t states[4];
+    for (uint32_t &state : states)
+    {
+        state = cursor.getState();
+    }
+
+    const std::size_t quadsEnd = data.size() & ~std::size_t(3);
+    for (std::size_t i = 0; quadsEnd != i; i += 4)
+    {
+        for (unsigned k = 0; 4 != k; ++k)
+        {
+            data[i + k] = frequencies.decode(states[k], cursor);
+        }
+    }
+    // the tail is decoded without advancing the states
+    for (std::size_t i = quadsEnd; data.size() != i; ++i)
+    {
+        data[i] = frequencies.symbol_[states[i - quadsEnd] & (RansCursor::TOTFREQ - 1)];
+    }
+}
+
+static void ransUncompressOrder1(RansCursor &cursor, std::vector<char> &data)
+{
+    std::vector<RansFrequencies> contexts(256);
+    readRansSymbols(cursor, AddOrder1Context(cursor, contexts));
+
+    uint32_t states[4];
+    for (uint32_t &state : states)
+    {
+        state = cursor.getState();
+    }
+
+    // each state decodes its own quarter of the output
+    const std::size_t quarter = data.size() >> 2;
+    unsigned char context[4] = {0, 0, 0, 0};
+    for (std::size_t i = 0; quarter != i; ++i)
+    {
+        for (unsigned k = 0; 4 != k; ++k)
+        {
+            context[k] = contexts[context[k]].decode(states[k], cursor);
+            data[k * quarter + i] = context[k];
+        }
+    }
+    for (std::size_t i = quarter * 4; data.size() != i; ++i)
+    {
+        context[3] = contexts[context[3]].decode(states[3], cursor);
+        data[i] = context[3];
+    }
+}
+
+static void ransUncompress(const char *compressed, const std::size_t compressedSize, std::vector<char> &data)
+{
+    static const std::size_t RANS_HEADER_LENGTH = 9;
+    if (RANS_HEADER_LENGTH > compressedSize)
+    {
+        truncated("rANS header");
+    }
+    int32_t streamSize = 0;
+    int32_t rawSize = 0;
+    getInt32(compressed + 1, compressed + compressedSize, streamSize);
+    getInt32(compressed + 5, compressed + compressedSize, rawSize);
+    if (std::size_t(rawSize) != data.size() || compressedSize - RANS_HEADER_LENGTH < std::size_t(streamSize))
+    {
+        BOOST_THROW_EXCEPTION(CramException("Corrupt rANS block header"));
+    }
+    if (data.empty())
+    {
+        return;
+    }
+    const unsigned char *begin = reinterpret_cast<const unsigned char*>(compressed) + RANS_HEADER_LENGTH;
+    RansCursor cursor(begin, begin + streamSize);
+    if (compressed[0])
+    {
+        ransUncompressOrder1(cursor, data);
+    }
+    else
+    {
+        ransUncompressOrder0(cursor, data);
+    }
+}
+
+const char *readBlock(const char *p, const char *end, Block &block)
+{
+    const char *const begin = p;
+    if (end - p < 2)
+    {
+        truncated("block");
+    }
+    block.method_ = *p++;
+    block.contentType_ = *p++;
+    int32_t compressedSize = 0;
+    int32_t rawSize = 0;
+    p = getItf8(p, end, block.contentId_);
+    p = getItf8(p, end, compressedSize);
+    p = getItf8(p, end, rawSize);
+    if (0 > compressedSize || 0 > rawSize || end - p < compressedSize + 4)
+    {
+        truncated("block");
+    }
+    const char *const compressed = p;
+    int32_t expectedCrc = 0;
+    p = getInt32(p + compressedSize, end, expectedCrc);
+    if (uint32_t(expectedCrc) != crc(begin, compressed + compressedSize))
+    {
+        BOOST_THROW_EXCEPTION(CramException("CRAM block CRC32 mismatch"));
+    }
+
+    block.data_.resize(rawSize);
+    switch (block.method_)
+    {
+    case RAW:
+        if (compressedSize != rawSize)
+        {
+            BOOST_THROW_EXCEPTION(CramException("Raw CRAM block sizes mismatch"));
+        }
+        std::copy(compressed, compressed + compressedSize, block.data_.begin());
+        break;
+    case GZIP:
+        gunzip(compressed, compressedSize, block.data_);
+        break;
+    case RANS:
+        ransUncompress(compressed, compressedSize, block.data_);
+        break;
+    default:
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("Unsupported CRAM block compression method: %d") % unsigned(block.method_)).str()));
+    }
+    return p;
+}
+
+void putBlock(
+    std::vector<char> &buffer,
+    const BlockContentType contentType,
+    const int32_t contentId,
+    const std::vector<char> &data,
+    const int gzipLevel)
+{
+    std::vector<char> compressed;
+    if (!data.empty() && gzipLevel)
+    {
+        gzip(data, gzipLevel, compressed);
+    }
+    const bool raw = compressed.empty() || compressed.size() >= data.size();
+    const std::vector<char> &payload = raw ? data : compressed;
+
+    const std::size_t begin = buffer.size();
+    buffer.push_back(raw ? RAW : GZIP);
+    buffer.push_back(contentType);
+    putItf8(buffer, contentId);
+    putItf8(buffer, payload.size());
+    putItf8(buffer, data.size());
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+    putInt32(buffer, crc(&buffer[begin], &buffer.back() + 1));
+}
+
+bool isCram(const boost::filesystem::path &path)
+{
+    std::ifstream is(path.c_str(), std::ios_base::binary);
+    char magic[4] = {0};
+    is.read(magic, sizeof(magic));
+    return is && std::equal(magic, magic + sizeof(magic), "CRAM");
+}
+
+std::string readFileHeader(std::istream &is)
+{
+    char definition[FILE_DEFINITION_LENGTH];
+    if (!is.read(definition, sizeof(definition)))
+    {
+        truncated("file definition");
+    }
+    if (0 != memcmp(definition, "CRAM", 4))
+    {
+        BOOST_THROW_EXCEPTION(CramException("CRAM magic bytes are not present"));
+    }
+    if (3 != definition[4])
+    {
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("Unsupported CRAM version %d.%d. Only 3.x is supported") %
+                int(definition[4]) % int(definition[5])).str()));
+    }
+
+    ContainerHeader header;
+    if (!readContainerHeader(is, header))
+    {
+        truncated("SAM header container");
+    }
+    std::vector<char> data(header.length_);
+    if (!data.empty() && !is.read(&data.front(), data.size()))
+    {
+        truncated("SAM header container");
+    }
+    Block block;
+    readBlock(&data.front(), &data.back() + 1, block);
+    int32_t textLength = 0;
+    const char *text = getInt32(
+        block.data_.empty() ? 0 : &block.data_.front(), block.data_.empty() ? 0 : &block.data_.back() + 1, textLength);
+    if (FILE_HEADER != block.contentType_ || 0 > textLength ||
+        std::size_t(textLength) > block.data_.size() - sizeof(int32_t))
+    {
+        BOOST_THROW_EXCEPTION(CramException("Corrupt CRAM SAM header container"));
+    }
+    return std::string(text, text + textLength);
+}
+
+} // namespace cram
+
+namespace
+{
+
+/**
+ * \brief Reads core block bits most significant first
+ */
+class BitReader
+{
+    const unsigned char *p_;
+    const unsigned char *end_;
+    unsigned bit_;
+public:
+    BitReader() : p_(0), end_(0), bit_(0){}
+    void reset(const std::vector<char> &data)
+    {
+        p_ = reinterpret_cast<const unsigned char *>(data.empty() ? 0 : &data.front());
+        end_ = p_ + data.size();
+        bit_ = 0;
+    }
+
+    unsigned get()
+    {
+        if (p_ == end_)
+        {
+            cram::truncated("core data block");
+        }
+        const unsigned ret = (*p_ >> (7 - bit_)) & 1;
+        if (8 == ++bit_)
+        {
+            bit_ = 0;
+            ++p_;
+        }
+        return ret;
+    }
+
+    uint32_t get(unsigned bits)
+    {
+        uint32_t ret = 0;
+        while (bits--)
+        {
+            ret = (ret << 1) | get();
+        }
+        return ret;
+    }
+};
+
+class ExternalReader
+{
+    const char *p_;
+    const char *end_;
+public:
+    ExternalReader() : p_(0), end_(0){}
+    void reset(const std::vector<char> &data)
+    {
+        p_ = data.empty() ? 0 : &data.front();
+        end_ = p_ + data.size();
+    }
+
+    int32_t getItf8()
+    {
+        int32_t ret = 0;
+        p_ = cram::getItf8(p_, end_, ret);
+        return ret;
+    }
+
+    unsigned char getByte()
+    {
+        if (p_ == end_)
+        {
+            cram::truncated("external data block");
+        }
+        return *p_++;
+    }
+
+    const char *getBytes(const std::size_t length)
+    {
+        if (std::size_t(end_ - p_) < length)
+        {
+            cram::truncated("external data block");
+        }
+        const char *ret = p_;
+        p_ += length;
+        return ret;
+    }
+
+    const char *getUntil(const char stop, std::size_t &length)
+    {
+        const char *stopPos = p_ ? static_cast<const char *>(memchr(p_, stop, end_ - p_)) : 0;
+        if (!stopPos)
+        {
+            cram::truncated("external data block");
+        }
+        const char *ret = p_;
+        length = stopPos - p_;
+        p_ = stopPos + 1;
+        return ret;
+    }
+};
+
+/**
+ * \brief Data blocks of the slice being decoded
+ */
+class SliceData
+{
+    // data series normally use small content ids. Tags use 24 bit ids.
+    static const int32_t SMALL_IDS = 256;
+    std::vector<ExternalReader *> small_;
+    std::map<int32_t, ExternalReader *> large_;
+    std::vector<ExternalReader> readers_;
+public:
+    BitReader core_;
+
+    explicit SliceData(const std::vector<cram::Block> &blocks) : small_(SMALL_IDS, 0)
+    {
+        readers_.reserve(blocks.size());
+        BOOST_FOREACH(const cram::Block &block, blocks)
+        {
+            if (cram::CORE_DATA == block.contentType_)
+            {
+                core_.reset(block.data_);
+            }
+            else if (cram::EXTERNAL_DATA == block.contentType_)
+            {
+                readers_.push_back(ExternalReader());
+                readers_.back().reset(block.data_);
+                if (0 <= block.contentId_ && SMALL_IDS > block.contentId_)
+                {
+                    small_[block.contentId_] = &readers_.back();
+                }
+                else
+                {
+                    large_[block.contentId_] = &readers_.back();
+                }
+            }
+        }
+    }
+
+    ExternalReader &external(const int32_t contentId)
+    {
+        ExternalReader *ret = 0;
+        if (0 <= contentId && SMALL_IDS > contentId)
+        {
+            ret = small_[contentId];
+        }
+        else
+        {
+            std::map<int32_t, ExternalReader *>::const_iterator it = large_.find(contentId);
+            ret = large_.end() == it ? 0 : it->second;
+        }
+        if (!ret)
+        {
+            BOOST_THROW_EXCEPTION(CramException(
+                (boost::format("CRAM slice does not have external block with content id %d") % contentId).str()));
+        }
+        return *ret;
+    }
+};
+
+/**
+ * \brief Decoder of a single data series or tag
+ */
+struct Codec
+{
+    Codec() : id_(cram::NULL_CODEC), externalId_(0), offset_(0), bits_(0), stop_(0){}
+
+    int32_t id_;
+    int32_t externalId_;
+    int32_t offset_;
+    // BETA number of bits or SUBEXP k
+    int32_t bits_;
+    char stop_;
+    // HUFFMAN symbols in canonical order
+    std::vector<int32_t> symbols_;
+    std::vector<int32_t> lengths_;
+    std::vector<uint32_t> codes_;
+    // BYTE_ARRAY_LEN lengths and values
+    std::vector<Codec> nested_;
+
+    const char *parse(const char *p, const char *end);
+    int32_t decodeInt(SliceData &slice) const;
+    unsigned char decodeByte(SliceData &slice) const
+    {
+        return cram::EXTERNAL == id_ ? slice.external(externalId_).getByte() : decodeInt(slice);
+    }
+    void decodeBytes(SliceData &slice, std::vector<char> &bytes) const;
+
+private:
+    void makeCanonicalCodes();
+    int32_t decodeHuffman(BitReader &core) const;
+};
+
+const char *Codec::parse(const char *p, const char *end)
+{
+    int32_t length = 0;
+    p = cram::getItf8(p, end, id_);
+    p = cram::getItf8(p, end, length);
+    if (0 > length || end - p < length)
+    {
+        cram::truncated("encoding");
+    }
+    const char *const paramsEnd = p + length;
+    switch (id_)
+    {
+    case cram::NULL_CODEC:
+        break;
+    case cram::EXTERNAL:
+        cram::getItf8(p, paramsEnd, externalId_);
+        break;
+    case cram::HUFFMAN:
+    {
+        int32_t count = 0;
+        p = cram::getItf8(p, paramsEnd, count);
+        symbols_.resize(std::max(count, 0));
+        for (int32_t &symbol : symbols_)
+        {
+            p = cram::getItf8(p, paramsEnd, symbol);
+        }
+        p = cram::getItf8(p, paramsEnd, count);
+        lengths_.resize(std::max(count, 0));
+        for (int32_t &bitLength : lengths_)
+        {
+            p = cram::getItf8(p, paramsEnd, bitLength);
+        }
+        if (symbols_.empty() || symbols_.size() != lengths_.size())
+        {
+            BOOST_THROW_EXCEPTION(CramException("Corrupt HUFFMAN encoding parameters"));
+        }
+        makeCanonicalCodes();
+        break;
+    }
+    case cram::BYTE_ARRAY_LEN:
+        nested_.resize(2);
+        p = nested_[0].parse(p, paramsEnd);
+        nested_[1].parse(p, paramsEnd);
+        break;
+    case cram::BYTE_ARRAY_STOP:
+        if (p == paramsEnd)
+        {
+            cram::truncated("BYTE_ARRAY_STOP parameters");
+        }
+        stop_ = *p++;
+        cram::getItf8(p, paramsEnd, externalId_);
+        break;
+    case cram::BETA:
+    case cram::SUBEXP:
+        p = cram::getItf8(p, paramsEnd, offset_);
+        cram::getItf8(p, paramsEnd, bits_);
+        break;
+    case cram::GAMMA:
+        cram::getItf8(p, paramsEnd, offset_);
+        break;
+    default:
+        BOOST_THROW_EXCEPTION(CramException((boost::format("Unsupported CRAM encoding: %d") % id_).str()));
+    }
+    return paramsEnd;
+}
+
+void Codec::makeCanonicalCodes()
+{
+    std::vector<std::pair<int32_t, int32_t> > ordered;
+    for (std::size_t i = 0; symbols_.size() != i; ++i)
+    {
+        ordered.push_back(std::make_pair(lengths_[i], symbols_[i]));
+    }
+    std::sort(ordered.begin(), ordered.end());
+    codes_.clear();
+    uint32_t code = 0;
+    for (std::size_t i = 0; ordered.size() != i; ++i)
+    {
+        if (i)
+        {
+            code = (code + 1) << (ordered[i].first - ordered[i - 1].first);
+        }
+        lengths_[i] = ordered[i].first;
+        symbols_[i] = ordered[i].second;
+        codes_.push_back(code);
+    }
+}
+
+int32_t Codec::decodeHuffman(BitReader &core) const
+{
+    // single symbol alphabets take no bits at all
+    if (!lengths_.front() && 1 == lengths_.size())
+    {
+        return symbols_.front();
+    }
+    uint32_t code = 0;
+    int32_t length = 0;
+    for (std::size_t i = 0; lengths_.size() != i; ++i)
+    {
+        while (length < lengths_[i])
+        {
+            code = (code << 1) | core.get();
+            ++length;
+        }
+        if (codes_[i] == code)
+        {
+            return symbols_[i];
+        }
+    }
+    BOOST_THROW_EXCEPTION(CramException("Invalid HUFFMAN code in CRAM core data block"));
+    return 0;
+}
+
+int32_t Codec::decodeInt(SliceData &slice) const
+{
+    switch (id_)
+    {
+    case cram::EXTERNAL:
+        return slice.external(externalId_).getItf8();
+    case cram::HUFFMAN:
+        return decodeHuffman(slice.core_);
+    case cram::BETA:
+        return int32_t(slice.core_.get(bits_)) - offset_;
+    case cram::GAMMA:
+    {
+        unsigned zeroes = 0;
+        while (!slice.core_.get())
+        {
+            ++zeroes;
+        }
+        return int32_t((1U << zeroes) | slice.core_.get(zeroes)) - offset_;
+    }
+    case cram::SUBEXP:
+    {
+        unsigned ones = 0;
+        while (slice.core_.get())
+        {
+            ++ones;
+        }
+        if (!ones)
+        {
+            return int32_t(slice.core_.get(bits_)) - offset_;
+        }
+        const unsigned bits = ones + bits_ - 1;
+        return int32_t((1U << bits) | slice.core_.get(bits)) - offset_;
+    }
+    default:
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("CRAM encoding %d cannot be used for integer data series") % id_).str()));
+    }
+    return 0;
+}
+
+void Codec::decodeBytes(SliceData &slice, std::vector<char> &bytes) const
+{
+    bytes.clear();
+    if (cram::BYTE_ARRAY_STOP == id_)
+    {
+        std::size_t length = 0;
+        const char *begin = slice.external(externalId_).getUntil(stop_, length);
+        bytes.insert(bytes.end(), begin, begin + length);
+    }
+    else if (cram::BYTE_ARRAY_LEN == id_)
+    {
+        const int32_t length = nested_[0].decodeInt(slice);
+        if (0 > length)
+        {
+            BOOST_THROW_EXCEPTION(CramException("Negative CRAM byte array length"));
+        }
+        if (cram::EXTERNAL == nested_[1].id_)
+        {
+            const char *begin = slice.external(nested_[1].externalId_).getBytes(length);
+            bytes.insert(bytes.end(), begin, begin + length);
+        }
+        else
+        {
+            for (int32_t i = 0; length != i; ++i)
+            {
+                bytes.push_back(nested_[1].decodeByte(slice));
+            }
+        }
+    }
+    else
+    {
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("CRAM encoding %d cannot be used for byte array data series") % id_).str()));
+    }
+}
+
+enum DataSeries
+{
+    BF, CF, RI, RL, AP, RG, RN, MF, NS, NP, TS, NF, TL, FN, FC, FP, DL, BB, QQ, BS, IN, RS, PD, HC, SC, MQ, BA, QS,
+    DATA_SERIES_COUNT
+};
+
+static int dataSeriesIndex(const char *key)
+{
+    static const char *KEYS[DATA_SERIES_COUNT] =
+    {
+        "BF", "CF", "RI", "RL", "AP", "RG", "RN", "MF", "NS", "NP", "TS", "NF", "TL", "FN", "FC", "FP", "DL", "BB",
+        "QQ", "BS", "IN", "RS", "PD", "HC", "SC", "MQ", "BA", "QS"
+    };
+    for (int i = 0; DATA_SERIES_COUNT != i; ++i)
+    {
+        if (KEYS[i][0] == key[0] && KEYS[i][1] == key[1])
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static unsigned baseIndex(const char base)
+{
+    switch (base)
+    {
+    case 'A': return 0;
+    case 'C': return 1;
+    case 'G': return 2;
+    case 'T': return 3;
+    default: return 4;
+    }
+}
+
+struct CompressionHeader
+{
+    CompressionHeader() : readNamesIncluded_(true), apDelta_(true), referenceRequired_(true), series_(DATA_SERIES_COUNT)
+    {
+        static const unsigned char DEFAULT_SUBSTITUTION_MATRIX[5] = {0x1b, 0x1b, 0x1b, 0x1b, 0x1b};
+        setSubstitutionMatrix(reinterpret_cast<const char *>(DEFAULT_SUBSTITUTION_MATRIX));
+    }
+
+    bool readNamesIncluded_;
+    bool apDelta_;
+    bool referenceRequired_;
+    // read base for each reference base and substitution code
+    char substitutions_[5][4];
+    // tag keys (tag name << 8 | type) for each tag line
+    std::vector<std::vector<int32_t> > tagLines_;
+    std::vector<Codec> series_;
+    std::map<int32_t, Codec> tags_;
+
+    void parse(const std::vector<char> &data);
+    const Codec &operator[](const DataSeries series) const {return series_[series];}
+
+private:
+    void setSubstitutionMatrix(const char *matrix);
+    void setTagDictionary(const char *begin, const char *end);
+};
+
+void CompressionHeader::setSubstitutionMatrix(const char *matrix)
+{
+    static const char BASES[] = "ACGTN";
+    for (unsigned ref = 0; 5 != ref; ++ref)
+    {
+        unsigned alternative = 0;
+        for (unsigned base = 0; 5 != base; ++base)
+        {
+            if (base != ref)
+            {
+                const unsigned code = (static_cast<unsigned char>(matrix[ref]) >> (6 - 2 * alternative)) & 3;
+                substitutions_[ref][code] = BASES[base];
+                ++alternative;
+            }
+        }
+    }
+}
+
+void CompressionHeader::setTagDictionary(const char *begin, const char *end)
+{
+    tagLines_.clear();
+    while (begin != end)
+    {
+        tagLines_.push_back(std::vector<int32_t>());
+        while (end != begin && *begin)
+        {
+            if (3 > end - begin)
+            {
+                cram::truncated("tag dictionary");
+            }
+            tagLines_.back().push_back(
+                (int32_t(static_cast<unsigned char>(begin[0])) << 16) |
+                (int32_t(static_cast<unsigned char>(begin[1])) << 8) |
+                static_cast<unsigned char>(begin[2]));
+            begin += 3;
+        }
+        if (end != begin)
+        {
+            ++begin;
+        }
+    }
+}
+
+void CompressionHeader::parse(const std::vector<char> &data)
+{
+    const char *p = data.empty() ? 0 : &data.front();
+    const char *const end = p + data.size();
+
+    int32_t mapSize = 0;
+    int32_t entries = 0;
+    p = cram::getItf8(p, end, mapSize);
+    if (0 > mapSize || end - p < mapSize)
+    {
+        cram::truncated("preservation map");
+    }
+    const char *mapEnd = p + mapSize;
+    for (p = cram::getItf8(p, mapEnd, entries); entries--;)
+    {
+        if (3 > mapEnd - p)
+        {
+            cram::truncated("preservation map");
+        }
+        const std::string key(p, p + 2);
+        p += 2;
+        if ("RN" == key)
+        {
+            readNamesIncluded_ = *p++;
+        }
+        else if ("AP" == key)
+        {
+            apDelta_ = *p++;
+        }
+        else if ("RR" == key)
+        {
+            referenceRequired_ = *p++;
+        }
+        else if ("SM" == key)
+        {
+            if (5 > mapEnd - p)
+            {
+                cram::truncated("substitution matrix");
+            }
+            setSubstitutionMatrix(p);
+            p += 5;
+        }
+        else if ("TD" == key)
+        {
+            int32_t length = 0;
+            p = cram::getItf8(p, mapEnd, length);
+            if (0 > length || mapEnd - p < length)
+            {
+                cram::truncated("tag dictionary");
+            }
+            setTagDictionary(p, p + length);
+            p += length;
+        }
+        else
+        {
+            BOOST_THROW_EXCEPTION(CramException("Unknown CRAM preservation map key: " + key));
+        }
+    }
+
+    p = cram::getItf8(mapEnd, end, mapSize);
+    if (0 > mapSize || end - p < mapSize)
+    {
+        cram::truncated("data series encoding map");
+    }
+    mapEnd = p + mapSize;
+    for (p = cram::getItf8(p, mapEnd, entries); entries--;)
+    {
+        if (2 > mapEnd - p)
+        {
+            cram::truncated("data series encoding map");
+        }
+        const int index = dataSeriesIndex(p);
+        p += 2;
+        // deprecated series are not used by the records
+        Codec unused;
+        p = (0 > index ? unused : series_[index]).parse(p, mapEnd);
+    }
+
+    p = cram::getItf8(mapEnd, end, mapSize);
+    if (0 > mapSize || end - p < mapSize)
+    {
+        cram::truncated("tag encoding map");
+    }
+    mapEnd = p + mapSize;
+    for (p = cram::getItf8(p, mapEnd, entries); entries--;)
+    {
+        int32_t key = 0;
+        p = cram::getItf8(p, mapEnd, key);
+        p = tags_[key].parse(p, mapEnd);
+    }
+}
+
+static const unsigned BAM_CMATCH = 0;
+static const unsigned BAM_CINS = 1;
+static const unsigned BAM_CDEL = 2;
+static const unsigned BAM_CREF_SKIP = 3;
+static const unsigned BAM_CSOFT_CLIP = 4;
+static const unsigned BAM_CHARD_CLIP = 5;
+static const unsigned BAM_CPAD = 6;
+
+static const unsigned BAM_FUNMAP = 0x4;
+static const unsigned BAM_FMUNMAP = 0x8;
+static const unsigned BAM_FREVERSE = 0x10;
+static const unsigned BAM_FMREVERSE = 0x20;
+
+// offsets of bam record fields, block_size included
+static const std::size_t BAM_FLAG_NC_OFFSET = 16;
+static const std::size_t BAM_NEXT_REFID_OFFSET = 24;
+static const std::size_t BAM_NEXT_POS_OFFSET = 28;
+static const std::size_t BAM_TLEN_OFFSET = 32;
+static const std::size_t BAM_FIXED_LENGTH = 36;
+
+static void storeInt32(std::vector<char> &bam, const std::size_t offset, const int32_t value)
+{
+    const uint32_t v = value;
+    bam[offset] = v;
+    bam[offset + 1] = v >> 8;
+    bam[offset + 2] = v >> 16;
+    bam[offset + 3] = v >> 24;
+}
+
+static unsigned char bamSeqCode(const char base)
+{
+    static const std::string BAM_BASES("=ACMGRSVTWYHKDBN");
+    const std::string::size_type ret = BAM_BASES.find(toupper(base));
+    return std::string::npos == ret ? 15 : ret;
+}
+
+/**
+ * \brief Decoded fields that are required to link the mates once the whole slice is decoded
+ */
+struct DecodedRecord
+{
+    std::size_t offset_;
+    int32_t refId_;
+    int32_t pos_;
+    // 0-based, exclusive
+    int32_t end_;
+    unsigned flag_;
+    int32_t mateLine_;
+};
+
+class SliceDecoder
+{
+public:
+    SliceDecoder(
+        const CompressionHeader &compressionHeader,
+        SliceData &slice,
+        const std::vector<const cram::Reference *> &sqReferences,
+        const std::vector<std::string> &readGroups,
+        std::vector<char> &bam) :
+            compressionHeader_(compressionHeader), slice_(slice), sqReferences_(sqReferences), readGroups_(readGroups),
+            bam_(bam), reference_(0), referenceOffset_(0)
+    {
+    }
+
+    void decode(
+        const int32_t refId,
+        const int32_t start,
+        const int32_t records,
+        const int64_t recordCounter,
+        const cram::Reference *embeddedReference);
+
+private:
+    const CompressionHeader &compressionHeader_;
+    SliceData &slice_;
+    const std::vector<const cram::Reference *> &sqReferences_;
+    const std::vector<std::string> &readGroups_;
+    std::vector<char> &bam_;
+
+    const cram::Reference *reference_;
+    int64_t referenceOffset_;
+
+    std::vector<char> name_;
+    std::vector<char> bytes_;
+    std::vector<char> aux_;
+    std::vector<char> seq_;
+    std::vector<char> qual_;
+    std::vector<uint32_t> cigar_;
+    std::vector<DecodedRecord> decoded_;
+
+    int32_t seqPos_;
+    int64_t refPos_;
+
+    const Codec &series(const DataSeries dataSeries) const {return compressionHeader_[dataSeries];}
+    char referenceBase(const int64_t pos) const {return reference_->base(pos - referenceOffset_);}
+    const cram::Reference *sqReference(const int32_t refId) const;
+    void addCigar(const unsigned op, const uint32_t length);
+    void matches(const int32_t length);
+    void checkReadLength(const std::size_t length) const;
+    void decodeTags(const int32_t tagLine, const int32_t readGroup);
+    void decodeFeatures(const int32_t readLength);
+    void storeRecord(
+        const int32_t refId, const int32_t pos, const int32_t end, const unsigned mapq, const unsigned flag,
+        const int32_t readLength, const int32_t mateRefId, const int32_t matePos, const int32_t tlen);
+    void linkMates(DecodedRecord &record, const DecodedRecord &mate);
+};
+
+const cram::Reference *SliceDecoder::sqReference(const int32_t refId) const
+{
+    if (0 > refId || sqReferences_.size() <= std::size_t(refId))
+    {
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("CRAM reference id %d is not declared in the SAM header") % refId).str()));
+    }
+    if (!sqReferences_[refId])
+    {
+        BOOST_THROW_EXCEPTION(CramException(
+            (boost::format("CRAM reference sequence %d is not among the loaded references") % refId).str()));
+    }
+    return sqReferences_[refId];
+}
+
+void SliceDecoder::addCigar(const unsigned op, const uint32_t length)
+{
+    if (!length)
+    {
+        return;
+    }
+    if (!cigar_.empty() && op == (cigar_.back() & 0xf))
+    {
+        cigar_.back() += length << 4;
+    }
+    else
+    {
+        cigar_.push_back(length << 4 | op);
+    }
+}
+
+void SliceDecoder::checkReadLength(const std::size_t length) const
+{
+    if (seq_.size() - seqPos_ < length)
+    {
+        BOOST_THROW_EXCEPTION(CramException("CRAM read features go beyond the read length"));
+    }
+}
+
+void SliceDecoder::matches(const int32_t length)
+{
+    if (0 >= length)
+    {
+        return;
+    }
+    checkReadLength(length);
+    for (int32_t i = 0; length != i; ++i)
+    {
+        seq_[seqPos_ + i] = referenceBase(refPos_ + i);
+    }
+    addCigar(BAM_CMATCH, length);
+    seqPos_ += length;
+    refPos_ += length;
+}
+
+void SliceDecoder::decodeTags(const int32_t tagLine, const int32_t readGroup)
+{
+    aux_.clear();
+    if (0 > tagLine || compressionHeader_.tagLines_.size() <= std::size_t(tagLine))
+    {
+        BOOST_THROW_EXCEPTION(CramException((boost::format("Invalid CRAM tag line: %d") % tagLine).str()));
+    }
+    BOOST_FOREACH(const int32_t key, compressionHeader_.tagLines_[tagLine])
+    {
+        std::map<int32_t, Codec>::const_iterator codec = compressionHeader_.tags_.find(key);
+        if (compressionHeader_.tags_.end() == codec)
+        {
+            BOOST_THROW_EXCEPTION(CramException((boost::format("No encoding for CRAM tag %x") % key).str()));
+        }
+        codec->second.decodeBytes(slice_, bytes_);
+        const char type = key;
+        aux_.push_back(key >> 16);
+        aux_.push_back(key >> 8);
+        aux_.push_back(type);
+        aux_.insert(aux_.end(), bytes_.begin(), bytes_.end());
+        if (cram::BYTE_ARRAY_STOP == codec->second.id_ && ('Z' == type || 'H' == type))
+        {
+            aux_.push_back(0);
+        }
+    }
+    if (0 <= readGroup)
+    {
+        if (readGroups_.size() <= std::size_t(readGroup))
+        {
+            BOOST_THROW_EXCEPTION(CramException((boost::format("Invalid CRAM read group: %d") % readGroup).str()));
+        }
+        aux_.push_back('R');
+        aux_.push_back('G');
+        aux_.push_back('Z');
+        aux_.insert(aux_.end(), readGroups_[readGroup].begin(), readGroups_[readGroup].end());
+        aux_.push_back(0);
+    }
+}
+
+void SliceDecoder::decodeFeatures(const int32_t readLength)
+{
+    const int32_t features = series(FN).decodeInt(slice_);
+    int32_t prevPos = 0;
+    for (int32_t f = 0; features != f; ++f)
+    {
+        const char code = series(FC).decodeByte(slice_);
+        const int32_t pos = prevPos + series(FP).decodeInt(slice_);
+        prevPos = pos;
+        if (0 >= pos || readLength + 1 < pos)
+        {
+            BOOST_THROW_EXCEPTION(CramException((boost::format("Invalid CRAM read feature position: %d") % pos).str()));
+        }
+        matches(pos - 1 - seqPos_);
+
+        switch (code)
+        {
+        case 'X':
+        {
+            checkReadLength(1);
+            const unsigned substitution = series(BS).decodeByte(slice_);
+            seq_[seqPos_++] = compressionHeader_.substitutions_[baseIndex(referenceBase(refPos_++))][substitution & 3];
+            addCigar(BAM_CMATCH, 1);
+            break;
+        }
+        case 'B':
+            checkReadLength(1);
+            seq_[seqPos_] = series(BA).decodeByte(slice_);
+            qual_[seqPos_++] = series(QS).decodeByte(slice_);
+            ++refPos_;
+            addCigar(BAM_CMATCH, 1);
+            break;
+        case 'b':
+            series(BB).decodeBytes(slice_, bytes_);
+            checkReadLength(bytes_.size());
+            std::copy(bytes_.begin(), bytes_.end(), seq_.begin() + seqPos_);
+            seqPos_ += bytes_.size();
+            refPos_ += bytes_.size();
+            addCigar(BAM_CMATCH, bytes_.size());
+            break;
+        case 'q':
+            series(QQ).decodeBytes(slice_, bytes_);
+            checkReadLength(bytes_.size());
+            std::copy(bytes_.begin(), bytes_.end(), qual_.begin() + seqPos_);
+            break;
+        case 'Q':
+            if (readLength < pos)
+            {
+                BOOST_THROW_EXCEPTION(CramException("CRAM quality feature beyond the read end"));
+            }
+            qual_[pos - 1] = series(QS).decodeByte(slice_);
+            break;
+        case 'I':
+            series(IN).decodeBytes(slice_, bytes_);
+            checkReadLength(bytes_.size());
+            std::copy(bytes_.begin(), bytes_.end(), seq_.begin() + seqPos_);
+            seqPos_ += bytes_.size();
+            addCigar(BAM_CINS, bytes_.size());
+            break;
+        case 'i':
+            checkReadLength(1);
+            seq_[seqPos_++] = series(BA).decodeByte(slice_);
+            addCigar(BAM_CINS, 1);
+            break;
+        case 'S':
+            series(SC).decodeBytes(slice_, bytes_);
+            checkReadLength(bytes_.size());
+            std::copy(bytes_.begin(), bytes_.end(), seq_.begin() + seqPos_);
+            seqPos_ += bytes_.size();
+            addCigar(BAM_CSOFT_CLIP, bytes_.size());
+            break;
+        case 'D':
+        {
+            const int32_t length = series(DL).decodeInt(slice_);
+            refPos_ += length;
+            addCigar(BAM_CDEL, length);
+            break;
+        }
+        case 'N':
+        {
+            const int32_t length = series(RS).decodeInt(slice_);
+            refPos_ += length;
+            addCigar(BAM_CREF_SKIP, length);
+            break;
+        }
+        case 'P':
+            addCigar(BAM_CPAD, series(PD).decodeInt(slice_));
+            break;
+        case 'H':
+            addCigar(BAM_CHARD_CLIP, series(HC).decodeInt(slice_));
+            break;
+        default:
+            BOOST_THROW_EXCEPTION(CramException((boost::format("Unsupported CRAM read feature: %c") % code).str()));
+        }
+    }
+    matches(readLength - seqPos_);
+}
+
+void SliceDecoder::storeRecord(
+    const int32_t refId, const int32_t pos, const int32_t end, const unsigned mapq, const unsigned flag,
+    const int32_t readLength, const int32_t mateRefId, const int32_t matePos, const int32_t tlen)
+{
+    const std::size_t offset = bam_.size();
+    const std::size_t nameLength = name_.size() + 1;
+    bam_.resize(offset + BAM_FIXED_LENGTH);
+    bam_.insert(bam_.end(), name_.begin(), name_.end());
+    bam_.push_back(0);
+    BOOST_FOREACH(const uint32_t op, cigar_)
+    {
+        cram::putInt32(bam_, op);
+    }
+    for (int32_t i = 0; i < readLength; i += 2)
+    {
+        bam_.push_back((bamSeqCode(seq_[i]) << 4) | (readLength == i + 1 ? 0 : bamSeqCode(seq_[i + 1])));
+    }
+    bam_.insert(bam_.end(), qual_.begin(), qual_.begin() + readLength);
+    bam_.insert(bam_.end(), aux_.begin(), aux_.end());
+
+    storeInt32(bam_, offset, bam_.size() - offset - sizeof(int32_t));
+    storeInt32(bam_, offset + 4, refId);
+    storeInt32(bam_, offset + 8, pos);
+    storeInt32(bam_, offset + 12, unsigned(bam::bam_reg2bin(pos, std::max(end, pos + 1))) << 16 | mapq << 8 | nameLength);
+    storeInt32(bam_, offset + BAM_FLAG_NC_OFFSET, flag << 16 | cigar_.size());
+    storeInt32(bam_, offset + 20, readLength);
+    storeInt32(bam_, offset + BAM_NEXT_REFID_OFFSET, mateRefId);
+    storeInt32(bam_, offset + BAM_NEXT_POS_OFFSET, matePos);
+    storeInt32(bam_, offset + BAM_TLEN_OFFSET, tlen);
+}
+
+void SliceDecoder::linkMates(DecodedRecord &record, const DecodedRecord &mate)
+{
+    record.flag_ |= (mate.flag_ & BAM_FREVERSE ? BAM_FMREVERSE : 0) | (mate.flag_ & BAM_FUNMAP ? BAM_FMUNMAP : 0);
+    storeInt32(bam_, record.offset_ + BAM_FLAG_NC_OFFSET,
+               record.flag_ << 16 | (common::extractLittleEndian<uint32_t>(&bam_[record.offset_ + BAM_FLAG_NC_OFFSET]) & 0xffff));
+    storeInt32(bam_, record.offset_ + BAM_NEXT_REFID_OFFSET, mate.refId_);
+    storeInt32(bam_, record.offset_ + BAM_NEXT_POS_OFFSET, mate.pos_);
+}
+
+void SliceDecoder::decode(
+    const int32_t sliceRefId,
+    const int32_t start,
+    const int32_t records,
+    const int64_t recordCounter,
+    const cram::Reference *embeddedReference)
+{
+    static const cram::Reference noReference("", 0, 0);
+    decoded_.resize(records);
+    int32_t prevAp = start;
+    for (int32_t rec = 0; records != rec; ++rec)
+    {
+        unsigned flag = series(BF).decodeInt(slice_);
+        const int32_t cf = series(CF).decodeInt(slice_);
+        const int32_t refId = cram::MULTIPLE_REFERENCES == sliceRefId ? series(RI).decodeInt(slice_) : sliceRefId;
+        const int32_t readLength = series(RL).decodeInt(slice_);
+        int32_t ap = series(AP).decodeInt(slice_);
+        if (compressionHeader_.apDelta_)
+        {
+            ap += prevAp;
+            prevAp = ap;
+        }
+        const int32_t readGroup = series(RG).decodeInt(slice_);
+        name_.clear();
+        if (compressionHeader_.readNamesIncluded_)
+        {
+            series(RN).decodeBytes(slice_, name_);
+        }
+
+        int32_t mateRefId = -1;
+        int32_t matePos = -1;
+        int32_t tlen = 0;
+        int32_t mateLine = -1;
+        if (cf & cram::CF_DETACHED)
+        {
+            const int32_t mf = series(MF).decodeInt(slice_);
+            flag |= (mf & cram::MF_REVERSE ? BAM_FMREVERSE : 0) | (mf & cram::MF_UNMAPPED ? BAM_FMUNMAP : 0);
+            if (!compressionHeader_.readNamesIncluded_)
+            {
+                series(RN).decodeBytes(slice_, name_);
+            }
+            mateRefId = series(NS).decodeInt(slice_);
+            matePos = series(NP).decodeInt(slice_) - 1;
+            tlen = series(TS).decodeInt(slice_);
+        }
+        else if (cf & cram::CF_MATE_DOWNSTREAM)
+        {
+            mateLine = rec + 1 + series(NF).decodeInt(slice_);
+            if (records <= mateLine)
+            {
+                BOOST_THROW_EXCEPTION(CramException("CRAM mate record is outside of the slice"));
+            }
+        }
+        if (name_.empty())
+        {
+            const std::string generated = boost::lexical_cast<std::string>(recordCounter + rec + 1);
+            name_.assign(generated.begin(), generated.end());
+        }
+
+        decodeTags(series(TL).decodeInt(slice_), readGroup);
+
+        if (0 > readLength)
+        {
+            BOOST_THROW_EXCEPTION(CramException("Negative CRAM read length"));
+        }
+        seq_.assign(readLength, 'N');
+        qual_.assign(readLength, char(0xff));
+        cigar_.clear();
+        seqPos_ = 0;
+        refPos_ = ap - 1;
+        unsigned mapq = 0;
+        if (!(flag & BAM_FUNMAP))
+        {
+            if (embeddedReference)
+            {
+                reference_ = embeddedReference;
+                referenceOffset_ = start - 1;
+            }
+            else
+            {
+                reference_ = (0 > refId || sqReferences_.empty() || !compressionHeader_.referenceRequired_) ?
+                    &noReference : sqReference(refId);
+                referenceOffset_ = 0;
+            }
+            decodeFeatures(readLength);
+            mapq = series(MQ).decodeInt(slice_);
+        }
+        else if (!(cf & cram::CF_NO_SEQUENCE))
+        {
+            for (char &base : seq_)
+            {
+                base = series(BA).decodeByte(slice_);
+            }
+        }
+        if (cf & cram::CF_QUALITY_ARRAY)
+        {
+            for (char &q : qual_)
+            {
+                q = series(QS).decodeByte(slice_);
+            }
+        }
+
+        DecodedRecord &decoded = decoded_[rec];
+        decoded.offset_ = bam_.size();
+        decoded.refId_ = refId;
+        decoded.pos_ = ap - 1;
+        decoded.end_ = refPos_;
+        decoded.flag_ = flag;
+        decoded.mateLine_ = mateLine;
+        storeRecord(refId, ap - 1, refPos_, mapq, flag, (cf & cram::CF_NO_SEQUENCE) ? 0 : readLength,
+                    mateRefId, matePos, tlen);
+    }
+
+    for (DecodedRecord &record : decoded_)
+    {
+        if (0 <= record.mateLine_)
+        {
+            DecodedRecord &mate = decoded_[record.mateLine_];
+            linkMates(record, mate);
+            linkMates(mate, record);
+            int32_t tlen = 0;
+            if (!(record.flag_ & BAM_FUNMAP) && !(mate.flag_ & BAM_FUNMAP) && record.refId_ == mate.refId_)
+            {
+                tlen = std::max(record.end_, mate.end_) - std::min(record.pos_, mate.pos_);
+            }
+            const bool recordLeftmost = record.pos_ <= mate.pos_;
+            storeInt32(bam_, record.offset_ + BAM_TLEN_OFFSET, recordLeftmost ? tlen : -tlen);
+            storeInt32(bam_, mate.offset_ + BAM_TLEN_OFFSET, recordLeftmost ? -tlen : tlen);
+        }
+    }
+}
+
+} // namespace
+
+const cram::Reference CramDecoder::noReference_("", 0, 0);
+
+void CramDecoder::open(const std::string &samHeader, const cram::References &references)
+{
+    sqReferences_.clear();
+    readGroups_.clear();
+    std::istringstream is(samHeader);
+    std::string line;
+    while (std::getline(is, line))
+    {
+        const bool sq = !line.compare(0, 4, "@SQ\t");
+        const bool rg = !line.compare(0, 4, "@RG\t");
+        if (!sq && !rg)
+        {
+            continue;
+        }
+        std::string name;
+        std::size_t length = 0;
+        std::istringstream fields(line);
+        std::string field;
+        while (std::getline(fields, field, '\t'))
+        {
+            if (!field.compare(0, 3, sq ? "SN:" : "ID:"))
+            {
+                name = field.substr(3);
+            }
+            else if (sq && !field.compare(0, 3, "LN:"))
+            {
+                length = boost::lexical_cast<std::size_t>(field.substr(3));
+            }
+        }
+        if (rg)
+        {
+            readGroups_.push_back(name);
+            continue;
+        }
+
+        const cram::Reference *match = references.empty() ? &noReference_ : 0;
+        BOOST_FOREACH(const cram::Reference &reference, references)
+        {
+            if (reference.name_ == name && reference.length_ == length)
+            {
+                match = &reference;
+                break;
+            }
+        }
+        if (!match)
+        {
+            ISAAC_THREAD_CERR << "WARNING: CRAM reference sequence " << name << " of length " << length <<
+                " is not among the loaded references" << std::endl;
+        }
+        sqReferences_.push_back(match);
+    }
+}
+
+void CramDecoder::decodeContainer(
+    const cram::ContainerHeader &header,
+    const char *data,
+    const char *dataEnd,
+    std::vector<char> &bam) const
+{
+    if (!header.records_)
+    {
+        return;
+    }
+    cram::Block block;
+    cram::readBlock(data, dataEnd, block);
+    if (cram::COMPRESSION_HEADER != block.contentType_)
+    {
+        BOOST_THROW_EXCEPTION(CramException("CRAM container does not start with compression header block"));
+    }
+    CompressionHeader compressionHeader;
+    compressionHeader.parse(block.data_);
+
+    std::vector<cram::Block> blocks;
+    BOOST_FOREACH(const int32_t landmark, header.landmarks_)
+    {
+        if (0 > landmark || dataEnd - data <= landmark)
+        {
+            BOOST_THROW_EXCEPTION(CramException("CRAM slice landmark is outside of the container"));
+        }
+        const char *p = cram::readBlock(data + landmark, dataEnd, block);
+        if (cram::MAPPED_SLICE != block.contentType_)
+        {
+            BOOST_THROW_EXCEPTION(CramException("CRAM slice does not start with slice header block"));
+        }
+        const char *h = block.data_.empty() ? 0 : &block.data_.front();
+        const char *const hEnd = h + block.data_.size();
+        int32_t refId = 0, start = 0, span = 0, records = 0, blockCount = 0, contentIds = 0, embeddedReferenceId = 0;
+        int64_t recordCounter = 0;
+        h = cram::getItf8(h, hEnd, refId);
+        h = cram::getItf8(h, hEnd, start);
+        h = cram::getItf8(h, hEnd, span);
+        h = cram::getItf8(h, hEnd, records);
+        h = cram::getLtf8(h, hEnd, recordCounter);
+        h = cram::getItf8(h, hEnd, blockCount);
+        h = cram::getItf8(h, hEnd, contentIds);
+        for (int32_t contentId = 0; contentIds > 0; --contentIds)
+        {
+            h = cram::getItf8(h, hEnd, contentId);
+        }
+        cram::getItf8(h, hEnd, embeddedReferenceId);
+
+        blocks.resize(std::max(blockCount, 0));
+        for (cram::Block &sliceBlock : blocks)
+        {
+            p = cram::readBlock(p, dataEnd, sliceBlock);
+        }
+
+        SliceData sliceData(blocks);
+        boost::scoped_ptr<cram::Reference> embeddedReference;
+        if (0 <= embeddedReferenceId)
+        {
+            std::vector<cram::Block>::const_iterator referenceBlock = std::find_if(
+                blocks.begin(), blocks.end(), boost::bind(&cram::Block::contentId_, _1) == embeddedReferenceId);
+            if (blocks.end() == referenceBlock)
+            {
+                BOOST_THROW_EXCEPTION(CramException("CRAM slice embedded reference block is missing"));
+            }
+            const std::vector<char> &bases = referenceBlock->data_;
+            embeddedReference.reset(new cram::Reference("", bases.size(), bases.empty() ? 0 : &bases.front()));
+        }
+        SliceDecoder(compressionHeader, sliceData, sqReferences_, readGroups_, bam).decode(
+            refId, start, records, recordCounter, embeddedReference.get());
+    }
+}
+
+} // namespace io
+} // namespace isaac
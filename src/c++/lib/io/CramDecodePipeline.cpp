@@ -0,0 +1,313 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CramDecodePipeline.cpp
+ **
+ ** \brief see CramDecodePipeline.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Threads.hpp"
+#include "io/CramDecodePipeline.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+CramDecodePipeline::CramDecodePipeline(
+    const unsigned decodersCount,
+    const unsigned buffersCount,
+    const unsigned containersPerBuffer,
+    const std::size_t headroom) :
+    containersPerBuffer_(containersPerBuffer),
+    buffers_(buffersCount),
+    fileBuffer_(std::ios_base::binary|std::ios_base::in),
+    is_(&fileBuffer_),
+    terminate_(false),
+    reading_(false),
+    readerBusy_(false),
+    decodersBusy_(0),
+    eof_(true),
+    fillBuffer_(0),
+    nextBuffer_(0),
+    headerPending_(false)
+{
+    ISAAC_ASSERT_MSG(2 < buffersCount, "At least one buffer must be available to the pipeline while the client holds two");
+    ISAAC_ASSERT_MSG(decodersCount && containersPerBuffer_, "Invalid pipeline geometry");
+
+    decodeQueue_.reserve(buffersCount * containersPerBuffer_);
+    BOOST_FOREACH(Buffer &buffer, buffers_)
+    {
+        buffer.headroom_ = headroom;
+        // containers are referenced from decodeQueue_. Never resize.
+        buffer.containers_.resize(containersPerBuffer_);
+        BOOST_FOREACH(Container &container, buffer.containers_)
+        {
+            container.buffer_ = &buffer;
+        }
+    }
+
+    threads_.create_thread(boost::bind(&CramDecodePipeline::readerThread, this));
+    for (unsigned i = 0; decodersCount != i; ++i)
+    {
+        threads_.create_thread(boost::bind(&CramDecodePipeline::decoderThread, this));
+    }
+}
+
+CramDecodePipeline::~CramDecodePipeline()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        stop(lock);
+        terminate_ = true;
+        stateChangedCondition_.notify_all();
+    }
+    threads_.join_all();
+}
+
+void CramDecodePipeline::stop(boost::unique_lock<boost::mutex> &lock)
+{
+    reading_ = false;
+    decodeQueue_.clear();
+    while (readerBusy_ || decodersBusy_)
+    {
+        stateChangedCondition_.wait(lock);
+    }
+    BOOST_FOREACH(Buffer &buffer, buffers_)
+    {
+        buffer.containersUsed_ = 0;
+        buffer.pendingContainers_ = 0;
+        buffer.sealed_ = false;
+        buffer.free_ = true;
+    }
+    fillBuffer_ = nextBuffer_ = 0;
+    eof_ = true;
+    error_ = std::exception_ptr();
+}
+
+void CramDecodePipeline::open(const boost::filesystem::path &filePath, const cram::References &references)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stop(lock);
+    fileBuffer_.reopen(filePath.c_str(), io::FileBufWithReopen::SequentialOnce);
+    if (!fileBuffer_.is_open())
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to open cram file: %s") % filePath).str()));
+    }
+    is_.clear();
+    is_.rdbuf(&fileBuffer_);
+    // decoders are idle after stop, the decoder state can be changed safely
+    decoder_.open(cram::readFileHeader(is_), references);
+    headerPending_ = true;
+    eof_ = false;
+    reading_ = true;
+    stateChangedCondition_.notify_all();
+    ISAAC_THREAD_CERR << "Opened cram stream on " << filePath << std::endl;
+}
+
+CramDecodePipeline::Buffer *CramDecodePipeline::next()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Buffer &buffer = buffers_[nextBuffer_];
+    while (buffer.free_ || !buffer.sealed_ || buffer.pendingContainers_)
+    {
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+        if (eof_ && buffer.free_)
+        {
+            return 0;
+        }
+        stateChangedCondition_.wait(lock);
+    }
+    nextBuffer_ = (nextBuffer_ + 1) % buffers_.size();
+    lock.unlock();
+
+    // the buffer is owned by the client now. Lay the records out after the headroom.
+    buffer.bam_.resize(buffer.headroom_);
+    if (headerPending_)
+    {
+        // "BAM\1", no header text, no references
+        static const char EMPTY_BAM_HEADER[] = {'B', 'A', 'M', 1, 0, 0, 0, 0, 0, 0, 0, 0};
+        buffer.bam_.insert(buffer.bam_.end(), EMPTY_BAM_HEADER, EMPTY_BAM_HEADER + sizeof(EMPTY_BAM_HEADER));
+        headerPending_ = false;
+    }
+    for (unsigned i = 0; buffer.containersUsed_ != i; ++i)
+    {
+        const std::vector<char> &decoded = buffer.containers_[i].decoded_;
+        buffer.bam_.insert(buffer.bam_.end(), decoded.begin(), decoded.end());
+    }
+    buffer.data_ = &buffer.bam_.front();
+    return &buffer;
+}
+
+void CramDecodePipeline::release(Buffer &buffer)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    ISAAC_ASSERT_MSG(!buffer.free_ && buffer.sealed_, "Attempt to release a buffer not held by the client");
+    buffer.free_ = true;
+    stateChangedCondition_.notify_all();
+}
+
+/**
+ * \brief Reads the next container that has records. Containers without records such as the end of file marker
+ *        are skipped.
+ *
+ * \return false at the end of the stream
+ */
+bool CramDecodePipeline::readContainer(Container &container)
+{
+    while (cram::readContainerHeader(is_, container.header_))
+    {
+        if (0 > container.header_.length_)
+        {
+            BOOST_THROW_EXCEPTION(CramException(
+                (boost::format("Invalid cram container length: %d") % container.header_.length_).str()));
+        }
+        container.compressed_.resize(container.header_.length_);
+        if (container.header_.length_ &&
+            !is_.read(&container.compressed_.front(), container.header_.length_))
+        {
+            BOOST_THROW_EXCEPTION(CramException(
+                (boost::format("Truncated cram container. Expected %d bytes, got %d") %
+                    container.header_.length_ % is_.gcount()).str()));
+        }
+        if (container.header_.records_)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void CramDecodePipeline::readerThread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        Buffer &buffer = buffers_[fillBuffer_];
+        if (!reading_ || (!buffer.free_ && buffer.sealed_))
+        {
+            // nothing to read or the client has not released the buffer yet
+            stateChangedCondition_.wait(lock);
+            continue;
+        }
+        if (buffer.free_)
+        {
+            buffer.free_ = false;
+            buffer.sealed_ = false;
+            buffer.containersUsed_ = 0;
+        }
+
+        Container &container = buffer.containers_[buffer.containersUsed_];
+        bool read = false;
+        std::exception_ptr error;
+        readerBusy_ = true;
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            try
+            {
+                read = readContainer(container);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        readerBusy_ = false;
+
+        if (error)
+        {
+            error_ = error;
+            reading_ = false;
+        }
+
+        if (reading_)
+        {
+            if (read)
+            {
+                ++buffer.containersUsed_;
+                ++buffer.pendingContainers_;
+                decodeQueue_.push_back(&container);
+            }
+            if (!read || containersPerBuffer_ == buffer.containersUsed_)
+            {
+                if (buffer.containersUsed_)
+                {
+                    buffer.sealed_ = true;
+                    fillBuffer_ = (fillBuffer_ + 1) % buffers_.size();
+                }
+                else
+                {
+                    buffer.free_ = true;
+                }
+            }
+            if (!read)
+            {
+                eof_ = true;
+                reading_ = false;
+            }
+        }
+        stateChangedCondition_.notify_all();
+    }
+}
+
+void CramDecodePipeline::decoderThread()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!terminate_)
+    {
+        if (decodeQueue_.empty())
+        {
+            stateChangedCondition_.wait(lock);
+            continue;
+        }
+        Container &container = *decodeQueue_.front();
+        decodeQueue_.erase(decodeQueue_.begin());
+        std::exception_ptr error;
+        ++decodersBusy_;
+        {
+            common::unlock_guard<boost::unique_lock<boost::mutex> > unlock(lock);
+            try
+            {
+                container.decoded_.clear();
+                decoder_.decodeContainer(
+                    container.header_,
+                    container.compressed_.empty() ? 0 : &container.compressed_.front(),
+                    container.compressed_.empty() ? 0 : &container.compressed_.front() + container.compressed_.size(),
+                    container.decoded_);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+        }
+        --decodersBusy_;
+        if (error && !error_)
+        {
+            error_ = error;
+            reading_ = false;
+        }
+        --container.buffer_->pendingContainers_;
+        stateChangedCondition_.notify_all();
+    }
+}
+
+} // namespace io
+} // namespace isaac
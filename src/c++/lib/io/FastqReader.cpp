@@ -16,7 +16,10 @@
  **
  ** \author Roman Petrovski
  **/
-//#include <xmmintrin.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
 #include <boost/bind.hpp>
 
 #include "common/Debug.hh"
@@ -29,11 +32,15 @@ namespace io
 {
 
 const oligo::Translator<true, FastqReader::INCORRECT_FASTQ_BASE> FastqReader::translator_;
+const std::size_t FastqReader::LINE_END_INDEX_CAPACITY;
 
-FastqReader::FastqReader(const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength) :
+FastqReader::FastqReader(
+    const bool allowVariableLength, const unsigned threadsMax, const std::size_t maxPathLength,
+    const std::size_t uncompressedBufferSize) :
     // The uncompressed buffer can be fairly small for flat and gzipped fastq, however we need a decent amount of
     // space for parallel decompression to be effective with bgzf-compressed fastq.
-    uncompressedBufferSize_(std::size_t(bgzf::BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE) * threadsMax * BGZF_BLOCKS_PER_THREAD),
+    uncompressedBufferSize_(uncompressedBufferSize ? uncompressedBufferSize :
+        std::size_t(bgzf::BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE) * threadsMax * BGZF_BLOCKS_PER_THREAD),
     allowVariableLength_(allowVariableLength),
     q0Base_(0),
     fileBuffer_(std::ios_base::in),
@@ -46,10 +53,14 @@ FastqReader::FastqReader(const bool allowVariableLength, const unsigned threadsM
     bgzfCompressed_(false),
     reachedEof_(false),
     filePos_(0),
-    zeroLengthRead_(false)
+    zeroLengthRead_(false),
+    lineEndsPos_(0),
+    indexedEnd_(0),
+    recordsBegin_(0)
 {
     ISAAC_THREAD_CERR << "FastqReader uncompressedBufferSize_=" << uncompressedBufferSize_ << std::endl;
     buffer_.reserve(uncompressedBufferSize_);
+    lineEnds_.reserve(LINE_END_INDEX_CAPACITY);
     resetBuffer();
 }
 
@@ -62,6 +73,9 @@ void FastqReader::resetBuffer()
     baseCallsEnd_ = buffer_.end();
     qScoresBegin_ = buffer_.end();
     endIt_ = buffer_.end();
+    resetLineEnds();
+    records_.clear();
+    recordsBegin_ = 0;
 }
 
 void FastqReader::open(
@@ -75,19 +89,24 @@ void FastqReader::open(
         fastqPath_ = fastqPath.c_str();
         q0Base_ = q0Base;
         compressed_ = common::isDotGzPath(fastqPath_);
+        // stop decompressing the previous file before the stream gets reopened
+        gzReader_.reset();
         if (!fileBuffer_.reopen(fastqPath_.c_str(), FileBufWithReopen::SequentialOnce))
         {
             BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to reopen fastq file %s : %s") %
                 getPath() % strerror(errno)).str()));
         }
         buffer_.resize(uncompressedBufferSize_);
-        gzReader_.reset();
         filePos_ = 0;
 
         if (fileBuffer_.is_open())
         {
             is_.rdbuf(&fileBuffer_);
             bgzfCompressed_ = compressed_ ? bgzf::BgzfReader::isBgzfCompressed(is_) : false;
+            if (compressed_ && !bgzfCompressed_)
+            {
+                gzReader_.start(is_);
+            }
             reachedEof_ = false;
             next();
         }
@@ -121,11 +140,76 @@ IteratorT findNotNewLine(IteratorT itBegin, IteratorT itEnd)
          boost::bind(std::not_equal_to<char>(), '\n', _1));
 }
 
-template <typename IteratorT>
-IteratorT findNewLine(IteratorT itBegin, IteratorT itEnd)
+void FastqReader::resetLineEnds()
+{
+    lineEnds_.clear();
+    lineEndsPos_ = 0;
+    indexedEnd_ = 0;
+}
+
+/**
+ * \brief Collects the offsets of line ends found in buffer_ starting from offset 'from' until either the end of
+ *        the buffer or LINE_END_INDEX_CAPACITY is reached.
+ */
+void FastqReader::indexLineEnds(const std::size_t from)
 {
-    static const char *rn = "\n\r";
-    return std::find_first_of(itBegin, itEnd, rn, rn+2);
+    static const std::size_t CHUNK_BYTES = 32;
+    lineEnds_.clear();
+    lineEndsPos_ = 0;
+    const char *data = &buffer_.front();
+    const std::size_t size = buffer_.size();
+    std::size_t i = from;
+#ifdef __SSE2__
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    for (; i + CHUNK_BYTES <= size && lineEnds_.size() + CHUNK_BYTES <= LINE_END_INDEX_CAPACITY; i += CHUNK_BYTES)
+    {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16));
+        unsigned mask =
+            unsigned(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(lo, lf), _mm_cmpeq_epi8(lo, cr)))) |
+            (unsigned(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(hi, lf), _mm_cmpeq_epi8(hi, cr)))) << 16);
+        while (mask)
+        {
+            lineEnds_.push_back(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif // __SSE2__
+    for (; i != size && lineEnds_.size() + CHUNK_BYTES <= LINE_END_INDEX_CAPACITY; ++i)
+    {
+        if ('\n' == data[i] || '\r' == data[i])
+        {
+            lineEnds_.push_back(i);
+        }
+    }
+    indexedEnd_ = i;
+}
+
+/**
+ * \brief Equivalent of searching for the first '\n' or '\r' at or after it. Must be called with non-decreasing
+ *        iterators between the buffer_ changes.
+ */
+FastqReader::BufferType::const_iterator FastqReader::findNewLine(const BufferType::const_iterator it)
+{
+    const std::size_t offset = std::distance(BufferType::const_iterator(buffer_.begin()), it);
+    while (true)
+    {
+        while (lineEnds_.size() != lineEndsPos_ && lineEnds_[lineEndsPos_] < offset)
+        {
+            ++lineEndsPos_;
+        }
+        if (lineEnds_.size() != lineEndsPos_)
+        {
+            return buffer_.begin() + lineEnds_[lineEndsPos_];
+        }
+        const std::size_t from = std::max(offset, indexedEnd_);
+        if (buffer_.size() <= from)
+        {
+            return buffer_.end();
+        }
+        indexLineEnds(from);
+    }
 }
 
 void FastqReader::findHeader()
@@ -152,7 +236,7 @@ void FastqReader::findHeader()
                 getPath() % getOffset(headerBegin_)).str()));
         }
     }
-    headerEnd_ = findNewLine(headerBegin_, BufferType::const_iterator(buffer_.end()));
+    headerEnd_ = findNewLine(headerBegin_);
     if (buffer_.end() == headerEnd_)
     {
         // We've reached the end of the buffer before we reached the end of the header
@@ -161,7 +245,7 @@ void FastqReader::findHeader()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while reading the header line: %s, offset %u") %
                 getPath() % getOffset(headerEnd_)).str()));
         }
-        headerEnd_ = findNewLine(headerEnd_, BufferType::const_iterator(buffer_.end()));
+        headerEnd_ = findNewLine(headerEnd_);
         if (buffer_.end() == headerEnd_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq header too long to fit in the buffer: %s, offset %u") %
@@ -199,7 +283,7 @@ void FastqReader::findSequence()
     else
     {
         zeroLengthRead_ = false;
-        baseCallsEnd_ = findNewLine(baseCallsBegin_, BufferType::const_iterator(buffer_.end()));
+        baseCallsEnd_ = findNewLine(baseCallsBegin_);
     }
     if (buffer_.end() == baseCallsEnd_)
     {
@@ -209,7 +293,7 @@ void FastqReader::findSequence()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while reading the sequence line: %s, offset %u") %
                 getPath() % getOffset(baseCallsEnd_)).str()));
         }
-        baseCallsEnd_ = findNewLine(baseCallsEnd_, BufferType::const_iterator(buffer_.end()));
+        baseCallsEnd_ = findNewLine(baseCallsEnd_);
         if (buffer_.end() == baseCallsEnd_)
         {
 //            ISAAC_THREAD_CERR << " findSequence " << std::string(buffer_.begin(), buffer_.end()) << " buffer_.size()=" << buffer_.size() << std::endl;
@@ -246,7 +330,7 @@ void FastqReader::findQScores()
             getPath() % getOffset(qScoresBegin_)).str()));
     }
     // in some fastq files (like the ones produced by sra tools) + is followed by the header string. Just skip to the newline...
-    qScoresBegin_ = findNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
+    qScoresBegin_ = findNewLine(qScoresBegin_);
 
     if (buffer_.end() == qScoresBegin_)
     {
@@ -256,7 +340,7 @@ void FastqReader::findQScores()
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format("Fastq file end while looking for + sign: %s, offset %u") %
                 getPath() % getOffset(qScoresBegin_)).str()));
         }
-        qScoresBegin_ = findNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
+        qScoresBegin_ = findNewLine(qScoresBegin_);
         if (buffer_.end() == qScoresBegin_)
         {
             BOOST_THROW_EXCEPTION(FastqFormatException((boost::format(
@@ -292,7 +376,7 @@ void FastqReader::findQScoresEnd()
     }
     else
     {
-        endIt_ = findNewLine(qScoresBegin_, BufferType::const_iterator(buffer_.end()));
+        endIt_ = findNewLine(qScoresBegin_);
         if (buffer_.end() == endIt_)
         {
             // We've reached the end of the buffer before we reached the newline...
@@ -300,17 +384,16 @@ void FastqReader::findQScoresEnd()
             {
                 return;
             }
-            endIt_ = findNewLine(endIt_, BufferType::const_iterator(buffer_.end()));
+            endIt_ = findNewLine(endIt_);
         }
     }
 }
 
-std::size_t FastqReader::readCompressedFastq(std::istream &is, char *buffer, std::size_t amount)
+std::size_t FastqReader::readCompressedFastq(char *buffer, std::size_t amount)
 {
-    const std::streamsize decompressedBytes = gzReader_.read(is, 0, buffer, amount);
-    reachedEof_ = gzReader_.isEof(is);
-    ISAAC_ASSERT_MSG(-1 != decompressedBytes || reachedEof_, "Did not reach eof while unable to uncompress anymore");
-    return -1 == decompressedBytes ? 0 : decompressedBytes;
+    const std::size_t ret = gzReader_.read(buffer, amount);
+    reachedEof_ = gzReader_.isEof();
+    return ret;
 }
 
 std::size_t FastqReader::readBgzfFastq(std::istream &is, char *buffer, std::size_t amount)
@@ -334,6 +417,68 @@ std::size_t FastqReader::readFlatFastq(std::istream &is, char *buffer, std::size
 
 }
 
+/**
+ * \brief Translates up to length bases and quality scores into bcl bytes.
+ *
+ * \return number of bcl bytes produced. Stops at the first base or quality that cannot be stored without
+ *         complaint so that the caller can deal with it.
+ */
+std::size_t FastqReader::translateBcl(
+    const char *baseCalls, const char *qScores, const std::size_t length, char *bcl) const
+{
+    std::size_t i = 0;
+#ifdef __SSE2__
+    const __m128i lowerCase = _mm_set1_epi8(0x20);
+    const __m128i a = _mm_set1_epi8('a');
+    const __m128i c = _mm_set1_epi8('c');
+    const __m128i g = _mm_set1_epi8('g');
+    const __m128i t = _mm_set1_epi8('t');
+    const __m128i n = _mm_set1_epi8('n');
+    const __m128i q0 = _mm_set1_epi8(q0Base_);
+    const __m128i qualityOverflow = _mm_set1_epi8(char(0xff << 6));
+    const __m128i three = _mm_set1_epi8(3);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16)
+    {
+        const __m128i bases = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(baseCalls + i)), lowerCase);
+        const __m128i isN = _mm_cmpeq_epi8(bases, n);
+        const __m128i isAcgt = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bases, a), _mm_cmpeq_epi8(bases, c)),
+            _mm_or_si128(_mm_cmpeq_epi8(bases, g), _mm_cmpeq_epi8(bases, t)));
+        const __m128i qualities = _mm_sub_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(qScores + i)), q0);
+        const __m128i goodQuality = _mm_cmpeq_epi8(_mm_and_si128(qualities, qualityOverflow), zero);
+        // as in the per-base code, quality of N is not validated
+        if (0xffff != _mm_movemask_epi8(_mm_or_si128(isN, _mm_and_si128(isAcgt, goodQuality))))
+        {
+            break;
+        }
+        // a=0x61 c=0x63 g=0x67 t=0x74 -> 0,1,2,3. Bits crossing into neighbour bytes are masked off
+        const __m128i baseValues = _mm_xor_si128(
+            _mm_and_si128(_mm_srli_epi16(bases, 1), three), _mm_and_si128(_mm_srli_epi16(bases, 2), one));
+        // qualities are below 64, shifting by 2 does not spill into the neighbour byte
+        const __m128i bclBytes = _mm_andnot_si128(isN, _mm_or_si128(baseValues, _mm_slli_epi16(qualities, 2)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bcl + i), bclBytes);
+    }
+#endif // __SSE2__
+    for (; i != length; ++i)
+    {
+        const unsigned char baseValue = translator_[baseCalls[i]];
+        if (oligo::INVALID_OLIGO == baseValue)
+        {
+            bcl[i] = 0;
+            continue;
+        }
+        const unsigned char baseQuality = (qScores[i] - q0Base_);
+        if (INCORRECT_FASTQ_BASE == baseValue || (1 << 6) <= baseQuality)
+        {
+            break;
+        }
+        bcl[i] = baseValue | (baseQuality << 2);
+    }
+    return i;
+}
+
 bool FastqReader::fetchMore()
 {
     if (reachedEof_)
@@ -341,11 +486,13 @@ bool FastqReader::fetchMore()
         return false;
     }
 
-    // move the remaining data to the start of the buffer
-    std::copy(headerBegin_, BufferType::const_iterator(buffer_.end()),  buffer_.begin());
-    const std::size_t moved = std::distance(headerBegin_, BufferType::const_iterator(buffer_.end()));
+    // move the remaining data to the start of the buffer. Keep the records that have not been released yet
+    const BufferType::const_iterator keepBegin = records_.size() == recordsBegin_ ?
+        headerBegin_ : std::min(headerBegin_, at(records_[recordsBegin_].headerBegin_));
+    std::copy(keepBegin, BufferType::const_iterator(buffer_.end()),  buffer_.begin());
+    const std::size_t moved = std::distance(keepBegin, BufferType::const_iterator(buffer_.end()));
 //    ISAAC_THREAD_CERR << "fetchMore moved=" << moved << " in buffer of size " << buffer_.size() << std::endl;
-    const std::size_t distance = std::distance(BufferType::const_iterator(buffer_.begin()), headerBegin_);
+    const std::size_t distance = std::distance(BufferType::const_iterator(buffer_.begin()), keepBegin);
     if (!distance)
     {
         BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
@@ -370,11 +517,13 @@ bool FastqReader::fetchMore()
         const std::size_t readBytes = bgzfCompressed_ ?
             readBgzfFastq(is_, &*firstUnreadByte, availableSpace) :
             compressed_ ?
-            readCompressedFastq(is_, &*firstUnreadByte, availableSpace) :
+            readCompressedFastq(&*firstUnreadByte, availableSpace) :
             readFlatFastq(is_, &*firstUnreadByte, availableSpace);
 
         filePos_ += readBytes;
         buffer_.resize(moved + readBytes);
+        // offsets have changed. The moved part is small, just index it again
+        resetLineEnds();
     }
     catch (boost::exception &e)
     {
@@ -384,6 +533,27 @@ bool FastqReader::fetchMore()
     return true;
 }
 
+std::size_t FastqReader::indexRecords(const std::size_t recordsMax)
+{
+    // reuse the reserved space
+    records_.erase(records_.begin(), records_.begin() + recordsBegin_);
+    recordsBegin_ = 0;
+
+    while (hasData() && records_.size() < recordsMax && records_.size() != records_.capacity() &&
+        (records_.empty() || getRecordOffset() - records_.front().headerBegin_ < uncompressedBufferSize_ / 2))
+    {
+        records_.push_back(getRecord());
+        next();
+    }
+    return records_.size();
+}
+
+void FastqReader::releaseRecords(const std::size_t count)
+{
+    ISAAC_ASSERT_MSG(getIndexedRecords() >= count, "Releasing more records than indexed: " << count << " indexed: " << getIndexedRecords());
+    recordsBegin_ += count;
+}
+
 void FastqReader::next()
 {
     findHeader();
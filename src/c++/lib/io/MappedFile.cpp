@@ -0,0 +1,99 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MappedFile.cpp
+ **
+ ** \brief See MappedFile.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "io/MappedFile.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+void MappedFile::map(const boost::filesystem::path &filePath)
+{
+    if (data_ && filePath.string() == path_)
+    {
+        return;
+    }
+    unmap();
+
+    const int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (-1 == fd)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open " + filePath.string()));
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat))
+    {
+        const int error = errno;
+        ::close(fd);
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to stat " + filePath.string()));
+    }
+
+    if (!fileStat.st_size)
+    {
+        ::close(fd);
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, "File is empty: " + filePath.string()));
+    }
+
+    void *data = mmap(0, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    const int error = errno;
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (MAP_FAILED == data)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(error, "Failed to map " + filePath.string()));
+    }
+
+    data_ = static_cast<const char *>(data);
+    size_ = fileStat.st_size;
+    path_ = filePath.string();
+}
+
+void MappedFile::unmap()
+{
+    if (data_)
+    {
+        munmap(const_cast<char *>(data_), size_);
+        data_ = 0;
+        size_ = 0;
+    }
+    path_.clear();
+}
+
+void MappedFile::willNeed(const uint64_t offset, const uint64_t bytes) const
+{
+    ISAAC_ASSERT_MSG(offset + bytes <= size_, "Range " << offset << "+" << bytes << " is outside of " << path_);
+    static const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    const uint64_t alignedOffset = offset & ~(pageSize - 1);
+    // the hint is advisory, failure to apply it is not an error
+    madvise(const_cast<char *>(data_) + alignedOffset, offset + bytes - alignedOffset, MADV_WILLNEED);
+}
+
+} // namespace io
+} // namespace isaac
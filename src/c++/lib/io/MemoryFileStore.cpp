@@ -0,0 +1,260 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file MemoryFileStore.cpp
+ **
+ ** \brief See MemoryFileStore.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/Debug.hh"
+#include "common/MemoryBudget.hh"
+#include "io/MemoryFileStore.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+const std::size_t MemoryFileStore::CHUNK_BYTES;
+const std::size_t MemoryFileStore::CHUNK_DATA_BYTES;
+
+void MemoryFileStore::Reader::open(const File &file, const uint64_t offset, const uint64_t bytes)
+{
+    ISAAC_ASSERT_MSG(offset <= file.size_, "Offset " << offset << " is past the end of file " << file.size_);
+    chunk_ = file.first_;
+    chunkOffset_ = 0;
+    uint64_t skip = offset;
+    while (chunk_ && skip >= chunk_->used_)
+    {
+        skip -= chunk_->used_;
+        chunk_ = chunk_->next_;
+    }
+    chunkOffset_ = skip;
+    tell_ = offset;
+    remaining_ = std::min(bytes, file.size_ - offset);
+}
+
+std::size_t MemoryFileStore::Reader::read(char *buffer, std::size_t bytes)
+{
+    std::size_t ret = 0;
+    bytes = std::min<uint64_t>(bytes, remaining_);
+    while (bytes)
+    {
+        if (chunk_->used_ == chunkOffset_)
+        {
+            chunk_ = chunk_->next_;
+            chunkOffset_ = 0;
+        }
+        const std::size_t copy = std::min(bytes, chunk_->used_ - chunkOffset_);
+        memcpy(buffer + ret, chunk_->data_ + chunkOffset_, copy);
+        chunkOffset_ += copy;
+        ret += copy;
+        bytes -= copy;
+    }
+    tell_ += ret;
+    remaining_ -= ret;
+    return ret;
+}
+
+MemoryFileStore::MemoryFileStore(const uint64_t limit) : limit_(limit), bytes_(0)
+{
+}
+
+MemoryFileStore::~MemoryFileStore()
+{
+    clear();
+}
+
+void MemoryFileStore::configure(const uint64_t limit)
+{
+    MemoryFileStore &store = instance();
+    boost::lock_guard<boost::mutex> lock(store.mutex_);
+    store.limit_ = limit;
+}
+
+MemoryFileStore &MemoryFileStore::instance()
+{
+    static MemoryFileStore processStore(0);
+    return processStore;
+}
+
+MemoryFileStore::File &MemoryFileStore::create(const std::string &path)
+{
+    File old;
+    File *ret = 0;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        File &file = files_[path];
+        std::swap(old, file);
+        ret = &file;
+    }
+    free(old);
+    return *ret;
+}
+
+const MemoryFileStore::File *MemoryFileStore::find(const std::string &path) const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    const std::map<std::string, File>::const_iterator it = files_.find(path);
+    return files_.end() == it ? 0 : &it->second;
+}
+
+bool MemoryFileStore::append(File &file, const iovec *pieces, const std::size_t count)
+{
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; count != i; ++i)
+    {
+        bytes += pieces[i].iov_len;
+    }
+    if (!bytes)
+    {
+        return true;
+    }
+
+    const std::size_t lastFree = file.last_ ? CHUNK_DATA_BYTES - file.last_->used_ : 0;
+    const std::size_t newChunks = bytes > lastFree ? (bytes - lastFree + CHUNK_DATA_BYTES - 1) / CHUNK_DATA_BYTES : 0;
+    if (newChunks)
+    {
+        if (!reserve(newChunks))
+        {
+            return false;
+        }
+        Chunk *first = 0;
+        Chunk *last = 0;
+        for (std::size_t i = 0; newChunks != i; ++i)
+        {
+            void *mapped = mmap(0, CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (MAP_FAILED == mapped)
+            {
+                while (first)
+                {
+                    Chunk *next = first->next_;
+                    munmap(first, CHUNK_BYTES);
+                    first = next;
+                }
+                release(newChunks);
+                return false;
+            }
+            Chunk *chunk = static_cast<Chunk *>(mapped);
+            chunk->next_ = 0;
+            chunk->used_ = 0;
+            (last ? last->next_ : first) = chunk;
+            last = chunk;
+        }
+        (file.last_ ? file.last_->next_ : file.first_) = first;
+    }
+
+    Chunk *chunk = file.last_ ? file.last_ : file.first_;
+    for (std::size_t i = 0; count != i; ++i)
+    {
+        const char *data = static_cast<const char *>(pieces[i].iov_base);
+        std::size_t left = pieces[i].iov_len;
+        while (left)
+        {
+            if (CHUNK_DATA_BYTES == chunk->used_)
+            {
+                chunk = chunk->next_;
+            }
+            const std::size_t copy = std::min(left, CHUNK_DATA_BYTES - chunk->used_);
+            memcpy(chunk->data_ + chunk->used_, data, copy);
+            chunk->used_ += copy;
+            data += copy;
+            left -= copy;
+        }
+    }
+    file.last_ = chunk;
+    file.size_ += bytes;
+    return true;
+}
+
+void MemoryFileStore::remove(const std::string &path)
+{
+    File file;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        const std::map<std::string, File>::iterator it = files_.find(path);
+        if (files_.end() == it)
+        {
+            return;
+        }
+        file = it->second;
+        files_.erase(it);
+    }
+    free(file);
+}
+
+void MemoryFileStore::clear()
+{
+    std::map<std::string, File> files;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        files.swap(files_);
+    }
+    for (std::map<std::string, File>::value_type &file : files)
+    {
+        free(file.second);
+    }
+}
+
+uint64_t MemoryFileStore::getBytes() const
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return bytes_;
+}
+
+bool MemoryFileStore::reserve(const std::size_t chunks)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    const uint64_t bytes = uint64_t(chunks) * CHUNK_BYTES;
+    if (limit_ - std::min(limit_, bytes_) < bytes ||
+        !common::MemoryBudget::instance().tryReserve(common::MemoryBudget::BinsInMemory, bytes))
+    {
+        return false;
+    }
+    bytes_ += bytes;
+    return true;
+}
+
+void MemoryFileStore::release(const std::size_t chunks)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    const uint64_t bytes = uint64_t(chunks) * CHUNK_BYTES;
+    common::MemoryBudget::instance().release(common::MemoryBudget::BinsInMemory, bytes);
+    bytes_ -= bytes;
+}
+
+void MemoryFileStore::free(File &file)
+{
+    std::size_t chunks = 0;
+    while (file.first_)
+    {
+        Chunk *next = file.first_->next_;
+        munmap(file.first_, CHUNK_BYTES);
+        file.first_ = next;
+        ++chunks;
+    }
+    file = File();
+    if (chunks)
+    {
+        release(chunks);
+    }
+}
+
+} // namespace io
+} // namespace isaac
@@ -0,0 +1,485 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file PooledFileWriter.cpp
+ **
+ ** \brief See PooledFileWriter.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/format.hpp>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "common/SystemCompatibility.hh"
+#include "io/PooledFileWriter.hh"
+
+namespace isaac
+{
+namespace io
+{
+
+const std::size_t PooledFileWriter::BUFFER_ALIGNMENT;
+const std::size_t PooledFileWriter::DEFAULT_BUFFER_BYTES;
+const std::size_t PooledFileWriter::NONE;
+
+// pieces given to one pwritev
+static const std::size_t WRITE_BATCH_MAX = std::min<std::size_t>(IOV_MAX, 256);
+
+PooledFileWriter::PooledFileWriter(
+    const unsigned maxOpenFiles,
+    const std::size_t bufferBytes,
+    const std::size_t writeBehindBytes,
+    MemoryFileStore &memoryFiles) :
+    maxOpenFiles_(maxOpenFiles),
+    bufferBytes_(bufferBytes),
+    writeBehindBytes_(writeBehindBytes),
+    memoryFiles_(memoryFiles),
+    openFiles_(0),
+    newest_(NONE),
+    oldest_(NONE),
+    opens_(0),
+    writeCalls_(0),
+    bytes_(0),
+    spills_(0)
+{
+    ISAAC_ASSERT_MSG(maxOpenFiles_, "At least one file must be allowed to be open");
+    ISAAC_ASSERT_MSG(bufferBytes_ && !(bufferBytes_ % BUFFER_ALIGNMENT),
+                     "Buffer size must be a multiple of " << BUFFER_ALIGNMENT << " got: " << bufferBytes_);
+}
+
+PooledFileWriter::~PooledFileWriter()
+{
+    close();
+}
+
+void PooledFileWriter::reset(const std::size_t files)
+{
+    close();
+    std::vector<File> newFiles(files);
+    files_.swap(newFiles);
+}
+
+void PooledFileWriter::create(const std::size_t file, const boost::filesystem::path &path, const uint64_t fallocateBytes)
+{
+    File &f = files_.at(file);
+    ISAAC_ASSERT_MSG(-1 == f.fd_ && !f.users_ && !f.memory_, "File " << file << " is already in use for " << f.path_);
+    f.path_ = path.string();
+    f.offset_ = 0;
+    f.writtenBehind_ = 0;
+    f.writeBehindDue_ = 0;
+    f.buffered_ = 0;
+    if (!f.buffer_)
+    {
+        void *buffer = 0;
+        const int error = posix_memalign(&buffer, BUFFER_ALIGNMENT, bufferBytes_);
+        if (error)
+        {
+            BOOST_THROW_EXCEPTION(common::MemoryException(
+                (boost::format("Failed to allocate %d bytes of write buffer for %s: %s") %
+                    bufferBytes_ % f.path_ % strerror(error)).str()));
+        }
+        f.buffer_.reset(static_cast<char *>(buffer));
+    }
+
+    // make sure file is empty first time we decide to put data in it.
+    if (common::deleteFile(path.c_str()) && ENOENT != errno)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to unlink " + f.path_));
+    }
+
+    if (memoryFiles_.isEnabled())
+    {
+        f.memory_ = &memoryFiles_.create(f.path_);
+    }
+    else
+    {
+        openCreated(file, fallocateBytes);
+    }
+}
+
+/**
+ * \brief Creates the file in the file system and makes it the most recently used one
+ */
+void PooledFileWriter::openCreated(const std::size_t file, const uint64_t fallocateBytes)
+{
+    File &f = files_.at(file);
+    boost::lock_guard<boost::mutex> lock(poolMutex_);
+    // when all open files are being written, the limit is exceeded
+    while (openFiles_ >= maxOpenFiles_ && closeOldestUnused())
+    {
+    }
+    f.fd_ = ::open(f.path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (-1 == f.fd_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open bin file " + f.path_));
+    }
+    ++opens_;
+    ++openFiles_;
+    f.older_ = newest_;
+    if (NONE != newest_)
+    {
+        files_.at(newest_).newer_ = file;
+    }
+    newest_ = file;
+    oldest_ = NONE == oldest_ ? file : oldest_;
+
+    if (fallocateBytes)
+    {
+        // don't check for failures. The size is often a pessimistic guess. Let the writes fail if there is no space.
+        common::linuxFallocate(f.fd_, 0, fallocateBytes);
+    }
+}
+
+/**
+ * \brief Moves the in-memory file to the file system
+ */
+void PooledFileWriter::spill(const std::size_t file)
+{
+    File &f = files_.at(file);
+    ISAAC_THREAD_CERR << "Moving " << f.memory_->getSize() << " bytes of " << f.path_ << " out of memory" << std::endl;
+    openCreated(file, 0);
+    MemoryFileStore::forEachChunk(*f.memory_, [this, file](const char *data, const std::size_t bytes)
+    {
+        iovec piece = {const_cast<char *>(data), bytes};
+        writeOut(file, &piece, 1);
+    });
+    memoryFiles_.remove(f.path_);
+    f.memory_ = 0;
+    ++spills_;
+}
+
+void PooledFileWriter::write(const std::size_t file, const iovec *pieces, const std::size_t count)
+{
+    File &f = files_.at(file);
+    if (f.memory_)
+    {
+        if (memoryFiles_.append(*f.memory_, pieces, count))
+        {
+            return;
+        }
+        spill(file);
+    }
+
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; count != i; ++i)
+    {
+        bytes += pieces[i].iov_len;
+    }
+
+    if (f.buffered_ + bytes <= bufferBytes_)
+    {
+        for (std::size_t i = 0; count != i; ++i)
+        {
+            memcpy(f.buffer_.get() + f.buffered_, pieces[i].iov_base, pieces[i].iov_len);
+            f.buffered_ += pieces[i].iov_len;
+        }
+        return;
+    }
+
+    // buffered data followed by the pieces that don't fit
+    iovec batch[WRITE_BATCH_MAX];
+    std::size_t batchSize = 0;
+    if (f.buffered_)
+    {
+        batch[batchSize].iov_base = f.buffer_.get();
+        batch[batchSize].iov_len = f.buffered_;
+        ++batchSize;
+    }
+    for (std::size_t i = 0; count != i; ++i)
+    {
+        if (WRITE_BATCH_MAX == batchSize)
+        {
+            writeOut(file, batch, batchSize);
+            f.buffered_ = 0;
+            batchSize = 0;
+        }
+        batch[batchSize++] = pieces[i];
+    }
+    writeOut(file, batch, batchSize);
+    f.buffered_ = 0;
+}
+
+void PooledFileWriter::flush(const std::size_t file)
+{
+    File &f = files_.at(file);
+    if (f.buffered_)
+    {
+        iovec piece = {f.buffer_.get(), f.buffered_};
+        writeOut(file, &piece, 1);
+        f.buffered_ = 0;
+    }
+}
+
+void PooledFileWriter::flush()
+{
+    for (std::size_t file = 0; files_.size() != file; ++file)
+    {
+        flush(file);
+    }
+}
+
+void PooledFileWriter::close() noexcept
+{
+    boost::lock_guard<boost::mutex> lock(poolMutex_);
+    for (File &f : files_)
+    {
+        if (f.buffered_)
+        {
+            ISAAC_THREAD_CERR << "WARNING: discarding " << f.buffered_ << " bytes not written into " << f.path_ << std::endl;
+            f.buffered_ = 0;
+        }
+        if (-1 != f.fd_)
+        {
+            ::close(f.fd_);
+            f.fd_ = -1;
+        }
+        // in-memory data stays in the store for the readers
+        f.memory_ = 0;
+        f.newer_ = NONE;
+        f.older_ = NONE;
+    }
+    openFiles_ = 0;
+    newest_ = NONE;
+    oldest_ = NONE;
+}
+
+PooledFileWriter::Counters PooledFileWriter::getCounters() const
+{
+    Counters ret;
+    ret.opens_ = opens_;
+    ret.writeCalls_ = writeCalls_;
+    ret.bytes_ = bytes_;
+    ret.spills_ = spills_;
+    return ret;
+}
+
+void PooledFileWriter::resetCounters()
+{
+    opens_ = 0;
+    writeCalls_ = 0;
+    bytes_ = 0;
+    spills_ = 0;
+}
+
+/**
+ * \brief Opens the file if needed and marks it as the most recently used one
+ *
+ * \return descriptor that stays open until release
+ */
+int PooledFileWriter::acquire(const std::size_t file)
+{
+    boost::lock_guard<boost::mutex> lock(poolMutex_);
+    File &f = files_.at(file);
+    if (-1 == f.fd_)
+    {
+        while (openFiles_ >= maxOpenFiles_ && closeOldestUnused())
+        {
+        }
+        f.fd_ = ::open(f.path_.c_str(), O_WRONLY | O_CLOEXEC);
+        if (-1 == f.fd_)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to reopen bin file " + f.path_));
+        }
+        ++opens_;
+        ++openFiles_;
+    }
+    else
+    {
+        unlink(file);
+    }
+
+    f.older_ = newest_;
+    if (NONE != newest_)
+    {
+        files_.at(newest_).newer_ = file;
+    }
+    newest_ = file;
+    oldest_ = NONE == oldest_ ? file : oldest_;
+    ++f.users_;
+    return f.fd_;
+}
+
+void PooledFileWriter::release(const std::size_t file)
+{
+    boost::lock_guard<boost::mutex> lock(poolMutex_);
+    --files_.at(file).users_;
+}
+
+/**
+ * \brief removes the file from the list of open files. poolMutex_ must be held
+ */
+void PooledFileWriter::unlink(const std::size_t file)
+{
+    File &f = files_.at(file);
+    if (NONE != f.older_)
+    {
+        files_.at(f.older_).newer_ = f.newer_;
+    }
+    else
+    {
+        oldest_ = f.newer_;
+    }
+    if (NONE != f.newer_)
+    {
+        files_.at(f.newer_).older_ = f.older_;
+    }
+    else
+    {
+        newest_ = f.older_;
+    }
+    f.newer_ = NONE;
+    f.older_ = NONE;
+}
+
+/**
+ * \brief closes the least recently used file that is not being written. poolMutex_ must be held
+ *
+ * \return false if all open files are being written
+ */
+bool PooledFileWriter::closeOldestUnused()
+{
+    for (std::size_t file = oldest_; NONE != file; file = files_.at(file).newer_)
+    {
+        File &f = files_.at(file);
+        if (!f.users_)
+        {
+            unlink(file);
+            ::close(f.fd_);
+            f.fd_ = -1;
+            --openFiles_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void PooledFileWriter::writeOut(const std::size_t file, iovec *pieces, std::size_t count)
+{
+    File &f = files_.at(file);
+    const int fd = acquire(file);
+    try
+    {
+        while (count)
+        {
+            const ssize_t written = pwritev(fd, pieces, count, f.offset_);
+            if (-1 == written)
+            {
+                if (EINTR == errno)
+                {
+                    continue;
+                }
+                BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to write into " + f.path_));
+            }
+            ++writeCalls_;
+            bytes_ += written;
+            f.offset_ += written;
+
+            // skip what got written, pwritev is allowed to stop anywhere
+            std::size_t remaining = written;
+            while (count && remaining >= pieces->iov_len)
+            {
+                remaining -= pieces->iov_len;
+                ++pieces;
+                --count;
+            }
+            if (remaining)
+            {
+                pieces->iov_base = static_cast<char *>(pieces->iov_base) + remaining;
+                pieces->iov_len -= remaining;
+            }
+        }
+    }
+    catch (...)
+    {
+        release(file);
+        throw;
+    }
+
+    boost::lock_guard<boost::mutex> lock(poolMutex_);
+    --f.users_;
+    if (writeBehindBytes_)
+    {
+        // the writeback is left to writeBehind so that the caller does not wait for the disk under its lock
+        f.writeBehindDue_ = f.offset_ - f.offset_ % writeBehindBytes_;
+    }
+}
+
+void PooledFileWriter::writeBehind(const std::size_t file)
+{
+    if (!writeBehindBytes_)
+    {
+        return;
+    }
+
+    File &f = files_.at(file);
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    {
+        boost::lock_guard<boost::mutex> lock(poolMutex_);
+        if (f.writingBehind_ || f.writtenBehind_ == f.writeBehindDue_)
+        {
+            return;
+        }
+        f.writingBehind_ = true;
+        begin = f.writtenBehind_;
+        end = f.writeBehindDue_;
+    }
+
+    try
+    {
+        // bin files are not read until Build. Push them out to disk instead of keeping in page cache
+        while (true)
+        {
+            const int fd = acquire(file);
+            for (uint64_t window = begin; end != window; window += writeBehindBytes_)
+            {
+                // by the time the next window is complete, the previous one is normally on the disk
+                if (common::linuxStartWriteBehind(fd, window, writeBehindBytes_) ||
+                    (window && common::linuxFinishWriteBehind(fd, window - writeBehindBytes_, writeBehindBytes_)))
+                {
+                    ISAAC_THREAD_CERR << "WARNING: write-behind failed with " << errno << "(" << strerror(errno) << ")" <<
+                        " for " << f.path_ << std::endl;
+                }
+            }
+            release(file);
+
+            boost::lock_guard<boost::mutex> lock(poolMutex_);
+            f.writtenBehind_ = begin = end;
+            end = f.writeBehindDue_;
+            if (begin == end)
+            {
+                // cleared together with the check so that the windows completed meanwhile are not missed
+                f.writingBehind_ = false;
+                return;
+            }
+        }
+    }
+    catch (...)
+    {
+        boost::lock_guard<boost::mutex> lock(poolMutex_);
+        f.writingBehind_ = false;
+        throw;
+    }
+}
+
+} // namespace io
+} // namespace isaac
@@ -0,0 +1,173 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "RegistryName.hh"
+#include "testAsyncFileReader.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestAsyncFileReader, registryName("AsyncFileReader"));
+
+using isaac::io::AsyncFileReader;
+
+// smallest block the reader accepts, so that the test files span several blocks
+static const std::size_t BLOCK_BYTES = AsyncFileReader::DIRECT_IO_ALIGNMENT * 2;
+
+static std::string makeData(const std::size_t bytes)
+{
+    std::string ret(bytes, 0);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret[i] = char(i * 7 + i / 251);
+    }
+    return ret;
+}
+
+static void writeFile(const boost::filesystem::path &path, const std::string &data)
+{
+    std::ofstream os(path.c_str(), std::ios_base::binary);
+    CPPUNIT_ASSERT(os.write(data.data(), data.size()));
+}
+
+/**
+ * \brief reads the open range in pieces of chunk bytes until read returns less than asked
+ */
+static std::string readAll(AsyncFileReader &reader, const std::size_t chunk)
+{
+    std::string ret;
+    std::string buffer(chunk, 0);
+    std::size_t got = 0;
+    do
+    {
+        got = reader.read(&buffer[0], chunk);
+        ret.append(buffer, 0, got);
+    } while (chunk == got);
+    return ret;
+}
+
+void TestAsyncFileReader::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestAsyncFileReader::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestAsyncFileReader::testPartialBlocks()
+{
+    // last block is partial and not aligned
+    const std::string data = makeData(BLOCK_BYTES * 3 + 123);
+    const boost::filesystem::path path = tempDir_ / "partial.dat";
+    writeFile(path, data);
+
+    for (const bool directIo : {false, true})
+    {
+        AsyncFileReader reader(directIo, BLOCK_BYTES);
+        // ranges starting and ending off the alignment and the block boundaries
+        const std::size_t ranges[][2] = {
+            {0, data.size()},
+            {1, data.size() - 1},
+            {AsyncFileReader::DIRECT_IO_ALIGNMENT - 1, BLOCK_BYTES + 2},
+            {BLOCK_BYTES + 1, 17},
+            {BLOCK_BYTES * 3 + 100, 23},
+            {BLOCK_BYTES, BLOCK_BYTES}};
+        for (const std::size_t *range : ranges)
+        {
+            // reader is reused without close, open has to close the previous file
+            reader.open(path.c_str(), range[0], range[1]);
+            CPPUNIT_ASSERT_EQUAL(uint64_t(range[0]), reader.tell());
+            for (const std::size_t chunk : {std::size_t(1000), BLOCK_BYTES, BLOCK_BYTES * 4})
+            {
+                reader.open(path.c_str(), range[0], range[1]);
+                const std::string got = readAll(reader, chunk);
+                CPPUNIT_ASSERT_EQUAL(range[1], got.size());
+                CPPUNIT_ASSERT(data.substr(range[0], range[1]) == got);
+                CPPUNIT_ASSERT_EQUAL(uint64_t(range[0] + range[1]), reader.tell());
+            }
+        }
+        reader.close();
+        // close is allowed on a closed reader
+        reader.close();
+    }
+}
+
+void TestAsyncFileReader::testEof()
+{
+    const std::string data = makeData(BLOCK_BYTES + 5);
+    const boost::filesystem::path path = tempDir_ / "eof.dat";
+    writeFile(path, data);
+
+    for (const bool directIo : {false, true})
+    {
+        AsyncFileReader reader(directIo, BLOCK_BYTES);
+
+        reader.open(path.c_str(), 3, AsyncFileReader::UNTIL_EOF);
+        CPPUNIT_ASSERT(data.substr(3) == readAll(reader, 4096));
+        // stays at the end once it is reached
+        char c = 0;
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), reader.read(&c, 1));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(data.size()), reader.tell());
+
+        // range past the end of file is cut at the end of file
+        reader.open(path.c_str(), BLOCK_BYTES - 1, BLOCK_BYTES * 10);
+        CPPUNIT_ASSERT(data.substr(BLOCK_BYTES - 1) == readAll(reader, BLOCK_BYTES * 10));
+
+        // nothing to read from the end of file on
+        reader.open(path.c_str(), data.size(), AsyncFileReader::UNTIL_EOF);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), reader.read(&c, 1));
+        reader.open(path.c_str(), data.size() + BLOCK_BYTES, AsyncFileReader::UNTIL_EOF);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), reader.read(&c, 1));
+
+        // empty file
+        const boost::filesystem::path emptyPath = tempDir_ / "empty.dat";
+        writeFile(emptyPath, std::string());
+        reader.open(emptyPath.c_str(), 0, AsyncFileReader::UNTIL_EOF);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(0), reader.read(&c, 1));
+        reader.close();
+    }
+}
+
+void TestAsyncFileReader::testDirectIoFallback()
+{
+    // procfs refuses O_DIRECT, the file must be read through page cache
+    const char *path = "/proc/version";
+    std::ifstream is(path);
+    if (!is)
+    {
+        return;
+    }
+    const std::string expected((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    CPPUNIT_ASSERT(!expected.empty());
+
+    AsyncFileReader reader(true, BLOCK_BYTES);
+    // procfs reports 0 size, the range is cut by the end of the data
+    reader.open(path, 0, BLOCK_BYTES * 2);
+    CPPUNIT_ASSERT(!reader.getCounters().direct_);
+    CPPUNIT_ASSERT(expected == readAll(reader, 10));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(expected.size()), reader.getCounters().bytes_);
+
+    // regular file opened by the same reader goes back to O_DIRECT where the file system allows it
+    const std::string data = makeData(BLOCK_BYTES / 2 + 1);
+    const boost::filesystem::path dataPath = tempDir_ / "direct.dat";
+    writeFile(dataPath, data);
+    reader.resetCounters();
+    reader.open(dataPath.c_str(), 0, AsyncFileReader::UNTIL_EOF);
+    CPPUNIT_ASSERT(data == readAll(reader, data.size() + 1));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(data.size()), reader.getCounters().bytes_);
+    reader.close();
+}
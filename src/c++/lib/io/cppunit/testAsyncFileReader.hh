@@ -0,0 +1,40 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_ASYNC_FILE_READER_HH
+#define iSAAC_IO_TEST_ASYNC_FILE_READER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "io/AsyncFileReader.hh"
+
+class TestAsyncFileReader : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestAsyncFileReader );
+    CPPUNIT_TEST( testPartialBlocks );
+    CPPUNIT_TEST( testEof );
+    CPPUNIT_TEST( testDirectIoFallback );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testPartialBlocks();
+    void testEof();
+    void testDirectIoFallback();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_ASYNC_FILE_READER_HH
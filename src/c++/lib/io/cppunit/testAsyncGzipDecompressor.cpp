@@ -0,0 +1,189 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include "RegistryName.hh"
+#include "testAsyncGzipDecompressor.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestAsyncGzipDecompressor, registryName("AsyncGzipDecompressor"));
+
+namespace bios = boost::iostreams;
+
+namespace
+{
+
+// small blocks make the helper thread go through both of them many times
+const std::size_t BLOCK_BYTES = 1000;
+
+std::string makeData(const std::size_t bytes, const unsigned seed)
+{
+    std::string ret;
+    ret.reserve(bytes);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret.push_back('A' + (i * seed + i / 7) % 26);
+    }
+    return ret;
+}
+
+std::string compress(const std::string &data)
+{
+    std::string ret;
+    bios::filtering_ostream os;
+    os.push(bios::gzip_compressor());
+    os.push(bios::back_inserter(ret));
+    os.write(data.data(), data.size());
+    os.reset();
+    return ret;
+}
+
+/// flips bits past the gzip header and before the trailer
+std::string corrupt(std::string compressed)
+{
+    for (std::size_t i = 20; compressed.size() - 8 > i; i += 3)
+    {
+        compressed[i] = ~compressed[i];
+    }
+    return compressed;
+}
+
+struct FailingStreambuf : public std::streambuf
+{
+    int_type underflow()
+    {
+        throw std::runtime_error("FailingStreambuf");
+    }
+};
+
+/**
+ * \brief reads until eof in pieces that don't line up with the blocks
+ */
+std::string readAll(isaac::io::AsyncGzipDecompressor &decompressor, const std::size_t chunk)
+{
+    std::string ret;
+    std::vector<char> buffer(chunk);
+    while (!decompressor.isEof())
+    {
+        const std::size_t read = decompressor.read(&buffer.front(), buffer.size());
+        CPPUNIT_ASSERT(buffer.size() == read || decompressor.isEof());
+        ret.append(&buffer.front(), read);
+    }
+    return ret;
+}
+
+} // namespace
+
+void TestAsyncGzipDecompressor::setUp()
+{
+    first_ = makeData(10007, 3);
+    second_ = makeData(5003, 5);
+}
+
+void TestAsyncGzipDecompressor::tearDown()
+{
+}
+
+void TestAsyncGzipDecompressor::testMultiMember()
+{
+    isaac::io::AsyncGzipDecompressor decompressor(BLOCK_BYTES);
+    CPPUNIT_ASSERT(decompressor.isEof());
+    char c = 0;
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), decompressor.read(&c, 1));
+
+    std::istringstream is(compress(first_) + compress(second_) + compress(""));
+    decompressor.start(is);
+    CPPUNIT_ASSERT(!decompressor.isEof());
+    CPPUNIT_ASSERT(first_ + second_ == readAll(decompressor, 333));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), decompressor.read(&c, 1));
+
+    // empty stream
+    std::istringstream empty(compress(""));
+    decompressor.start(empty);
+    CPPUNIT_ASSERT(readAll(decompressor, 10).empty());
+    CPPUNIT_ASSERT(decompressor.isEof());
+}
+
+void TestAsyncGzipDecompressor::testResetMidStream()
+{
+    isaac::io::AsyncGzipDecompressor decompressor(BLOCK_BYTES);
+    std::istringstream is(compress(first_));
+    decompressor.start(is);
+    std::vector<char> buffer(BLOCK_BYTES + 10);
+    CPPUNIT_ASSERT_EQUAL(buffer.size(), decompressor.read(&buffer.front(), buffer.size()));
+    CPPUNIT_ASSERT(first_.substr(0, buffer.size()) == std::string(buffer.begin(), buffer.end()));
+
+    // the rest of the stream is discarded
+    decompressor.reset();
+    CPPUNIT_ASSERT(decompressor.isEof());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), decompressor.read(&buffer.front(), buffer.size()));
+
+    // nothing from the discarded stream shows up in the next one
+    std::istringstream next(compress(second_));
+    decompressor.start(next);
+    CPPUNIT_ASSERT(second_ == readAll(decompressor, 777));
+
+    // start discards the unread data of the previous stream too
+    std::istringstream again(compress(first_));
+    decompressor.start(again);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(10), decompressor.read(&buffer.front(), 10));
+    std::istringstream last(compress(second_));
+    decompressor.start(last);
+    CPPUNIT_ASSERT(second_ == readAll(decompressor, 1));
+
+    // destruction while the helper thread might still be inflating. The stream outlives the decompressor
+    std::istringstream abandoned(compress(first_));
+    {
+        isaac::io::AsyncGzipDecompressor abandoning(BLOCK_BYTES);
+        abandoning.start(abandoned);
+    }
+}
+
+void TestAsyncGzipDecompressor::testError()
+{
+    isaac::io::AsyncGzipDecompressor decompressor(BLOCK_BYTES);
+    std::vector<char> buffer(first_.size());
+
+    // damaged deflate data past the header
+    std::istringstream corruptStream(corrupt(compress(first_)));
+    decompressor.start(corruptStream);
+    CPPUNIT_ASSERT_THROW(decompressor.read(&buffer.front(), buffer.size()), isaac::io::ZlibInflateException);
+    CPPUNIT_ASSERT(decompressor.isEof());
+    CPPUNIT_ASSERT_EQUAL(std::size_t(0), decompressor.read(&buffer.front(), buffer.size()));
+
+    // the blocks inflated before the damaged member are delivered first
+    std::istringstream secondCorruptStream(compress(first_) + corrupt(compress(second_)));
+    decompressor.start(secondCorruptStream);
+    const std::size_t goodBytes = first_.size() / BLOCK_BYTES * BLOCK_BYTES;
+    CPPUNIT_ASSERT_EQUAL(goodBytes, decompressor.read(&buffer.front(), goodBytes));
+    CPPUNIT_ASSERT(first_.substr(0, goodBytes) == std::string(buffer.begin(), buffer.begin() + goodBytes));
+    CPPUNIT_ASSERT_THROW(readAll(decompressor, 100), isaac::io::ZlibInflateException);
+    CPPUNIT_ASSERT(decompressor.isEof());
+
+    // failure to read the compressed data
+    FailingStreambuf failing;
+    std::istream failingStream(&failing);
+    decompressor.start(failingStream);
+    CPPUNIT_ASSERT_THROW(decompressor.read(&buffer.front(), buffer.size()), isaac::common::IoException);
+    CPPUNIT_ASSERT(decompressor.isEof());
+
+    // the decompressor recovers on the next stream
+    std::istringstream good(compress(second_));
+    decompressor.start(good);
+    CPPUNIT_ASSERT(second_ == readAll(decompressor, 1000));
+}
@@ -0,0 +1,41 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_ASYNC_GZIP_DECOMPRESSOR_HH
+#define iSAAC_IO_TEST_ASYNC_GZIP_DECOMPRESSOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include "io/AsyncGzipDecompressor.hh"
+
+class TestAsyncGzipDecompressor : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestAsyncGzipDecompressor );
+    CPPUNIT_TEST( testMultiMember );
+    CPPUNIT_TEST( testResetMidStream );
+    CPPUNIT_TEST( testError );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    std::string first_;
+    std::string second_;
+public:
+    void setUp();
+    void tearDown();
+    void testMultiMember();
+    void testResetMidStream();
+    void testError();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_ASYNC_GZIP_DECOMPRESSOR_HH
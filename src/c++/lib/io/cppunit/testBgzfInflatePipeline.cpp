@@ -0,0 +1,295 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+
+#include <zlib.h>
+
+#include "RegistryName.hh"
+#include "testBgzfInflatePipeline.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBgzfInflatePipeline, registryName("BgzfInflatePipeline"));
+
+using isaac::bgzf::BgzfInflatePipeline;
+using isaac::bgzf::BgzfReader;
+
+namespace
+{
+
+// fits two full bgzf blocks
+const std::size_t BUFFER_CAPACITY = 2 * BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE;
+const std::size_t HEADROOM = 100;
+
+std::string makeData(const std::size_t bytes, const unsigned seed)
+{
+    std::string ret;
+    ret.reserve(bytes);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret.push_back('A' + (i * seed + i / 7) % 26);
+    }
+    return ret;
+}
+
+void appendLittleEndian(std::string &s, const unsigned value)
+{
+    for (unsigned i = 0; 4 != i; ++i)
+    {
+        s.push_back(char(value >> (i * 8)));
+    }
+}
+
+/**
+ * \brief Compresses data into a single bgzf block. Empty data makes the end of file marker
+ */
+std::string compressBlock(const std::string &data)
+{
+    z_stream strm = z_stream();
+    CPPUNIT_ASSERT_EQUAL(Z_OK, deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+    std::string cdata(deflateBound(&strm, data.size()), '\0');
+    strm.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    strm.avail_in = data.size();
+    strm.next_out = reinterpret_cast<Bytef *>(&cdata[0]);
+    strm.avail_out = cdata.size();
+    CPPUNIT_ASSERT_EQUAL(Z_STREAM_END, deflate(&strm, Z_FINISH));
+    cdata.resize(strm.total_out);
+    deflateEnd(&strm);
+
+    const unsigned bsize = sizeof(isaac::bgzf::Header) + cdata.size() + sizeof(isaac::bgzf::Footer) - 1;
+    CPPUNIT_ASSERT(0x10000 > bsize);
+    const char header[] = {31, char(139), 8, 4, 0, 0, 0, 0, 0, char(255), 6, 0, 'B', 'C', 2, 0,
+        char(bsize & 0xff), char(bsize >> 8)};
+    std::string ret(header, header + sizeof(header));
+    ret += cdata;
+    appendLittleEndian(ret, crc32(0, reinterpret_cast<const Bytef *>(data.data()), data.size()));
+    appendLittleEndian(ret, data.size());
+    return ret;
+}
+
+/**
+ * \brief Receives buffers until the end of the data the way BamLoader does: the previous buffer is released only
+ *        after the next one is received. Buffers received before an exception stay in ret.
+ */
+void readBuffers(BgzfInflatePipeline &pipeline, std::vector<std::string> &ret)
+{
+    BgzfInflatePipeline::Buffer *last = 0;
+    for (BgzfInflatePipeline::Buffer *buffer = pipeline.next(); buffer; buffer = pipeline.next())
+    {
+        CPPUNIT_ASSERT_EQUAL(HEADROOM, std::size_t(buffer->begin() - buffer->data_));
+        ret.push_back(std::string(buffer->begin(), buffer->end()));
+        if (last)
+        {
+            pipeline.release(*last);
+        }
+        last = buffer;
+    }
+    if (last)
+    {
+        pipeline.release(*last);
+    }
+}
+
+std::vector<std::string> readBuffers(BgzfInflatePipeline &pipeline)
+{
+    std::vector<std::string> ret;
+    readBuffers(pipeline, ret);
+    return ret;
+}
+
+/**
+ * \brief Buffers expected from the blocks: each buffer takes as many whole blocks as fit in BUFFER_CAPACITY
+ */
+std::vector<std::string> splitIntoBuffers(const std::vector<std::string> &blocksData)
+{
+    std::vector<std::string> ret;
+    for (const std::string &data : blocksData)
+    {
+        if (data.empty())
+        {
+            continue;
+        }
+        if (ret.empty() || BUFFER_CAPACITY < ret.back().size() + data.size())
+        {
+            ret.push_back(std::string());
+        }
+        ret.back() += data;
+    }
+    return ret;
+}
+
+std::vector<std::string> compressBlocks(const std::vector<std::string> &blocksData)
+{
+    std::vector<std::string> ret;
+    for (const std::string &data : blocksData)
+    {
+        ret.push_back(compressBlock(data));
+    }
+    return ret;
+}
+
+} // namespace
+
+void TestBgzfInflatePipeline::setUp()
+{
+    tempDirectory_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDirectory_);
+}
+
+void TestBgzfInflatePipeline::tearDown()
+{
+    boost::filesystem::remove_all(tempDirectory_);
+}
+
+boost::filesystem::path TestBgzfInflatePipeline::writeBlocks(
+    const std::string &name, const std::vector<std::string> &blocks) const
+{
+    const boost::filesystem::path ret = tempDirectory_ / name;
+    std::ofstream os(ret.c_str(), std::ios_base::binary);
+    for (const std::string &block : blocks)
+    {
+        os << block;
+    }
+    CPPUNIT_ASSERT(os);
+    return ret;
+}
+
+void TestBgzfInflatePipeline::testOrdering()
+{
+    std::vector<std::string> blocksData;
+    for (unsigned i = 0; 40 != i; ++i)
+    {
+        // sizes from 1000 to a full block in no particular order, with an empty block in the middle
+        blocksData.push_back(20 == i ? std::string() : makeData(1000 + (i * 12345) % 64537, i + 1));
+    }
+    blocksData.push_back(makeData(BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE, 3));
+    blocksData.push_back(std::string());
+    const boost::filesystem::path path = writeBlocks("ordering.bgzf", compressBlocks(blocksData));
+    const std::vector<std::string> expected = splitIntoBuffers(blocksData);
+    CPPUNIT_ASSERT(3 < expected.size());
+
+    // the split does not depend on the number of threads or batch size
+    for (unsigned inflaters = 1; 4 != inflaters; ++inflaters)
+    {
+        for (unsigned blocksPerBatch = 1; 4 != blocksPerBatch; ++blocksPerBatch)
+        {
+            BgzfInflatePipeline pipeline(inflaters, 3, BUFFER_CAPACITY, HEADROOM, blocksPerBatch);
+            pipeline.open(path);
+            const std::vector<std::string> buffers = readBuffers(pipeline);
+            CPPUNIT_ASSERT_EQUAL(expected.size(), buffers.size());
+            for (std::size_t i = 0; expected.size() != i; ++i)
+            {
+                CPPUNIT_ASSERT_MESSAGE("Mismatch in buffer " + std::to_string(i), expected[i] == buffers[i]);
+            }
+        }
+    }
+}
+
+void TestBgzfInflatePipeline::testCarryOver()
+{
+    // the third block does not fit and goes into the next buffer
+    const std::vector<std::string> blocksData(5, makeData(50000, 7));
+    const boost::filesystem::path path = writeBlocks("carry.bgzf", compressBlocks(blocksData));
+
+    // carried block starts a batch (2) or comes in the middle of one (3)
+    for (unsigned blocksPerBatch = 2; 4 != blocksPerBatch; ++blocksPerBatch)
+    {
+        BgzfInflatePipeline pipeline(2, 3, BUFFER_CAPACITY, HEADROOM, blocksPerBatch);
+        pipeline.open(path);
+        const std::vector<std::string> buffers = readBuffers(pipeline);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(3), buffers.size());
+        CPPUNIT_ASSERT(blocksData[0] + blocksData[1] == buffers[0]);
+        CPPUNIT_ASSERT(blocksData[2] + blocksData[3] == buffers[1]);
+        CPPUNIT_ASSERT(blocksData[4] == buffers[2]);
+    }
+
+    // full blocks fill the buffer exactly, nothing is carried
+    const std::vector<std::string> fullBlocksData(3, makeData(BgzfReader::UNCOMPRESSED_BGZF_BLOCK_SIZE, 11));
+    BgzfInflatePipeline pipeline(2, 3, BUFFER_CAPACITY, HEADROOM, 2);
+    pipeline.open(writeBlocks("full.bgzf", compressBlocks(fullBlocksData)));
+    const std::vector<std::string> buffers = readBuffers(pipeline);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(2), buffers.size());
+    CPPUNIT_ASSERT(fullBlocksData[0] + fullBlocksData[1] == buffers[0]);
+    CPPUNIT_ASSERT(fullBlocksData[2] == buffers[1]);
+}
+
+void TestBgzfInflatePipeline::testEof()
+{
+    BgzfInflatePipeline pipeline(2, 3, BUFFER_CAPACITY, HEADROOM, 2);
+    // nothing to read before the first open
+    CPPUNIT_ASSERT(!pipeline.next());
+
+    // end of file marker only
+    pipeline.open(writeBlocks("marker.bgzf", std::vector<std::string>(1, compressBlock(std::string()))));
+    CPPUNIT_ASSERT(!pipeline.next());
+    CPPUNIT_ASSERT(!pipeline.next());
+
+    pipeline.open(writeBlocks("empty.bgzf", std::vector<std::string>()));
+    CPPUNIT_ASSERT(!pipeline.next());
+
+    // end of file keeps being reported until the next open
+    const std::vector<std::string> blocksData(5, makeData(50000, 13));
+    const boost::filesystem::path path = writeBlocks("data.bgzf", compressBlocks(blocksData));
+    pipeline.open(path);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(3), readBuffers(pipeline).size());
+    CPPUNIT_ASSERT(!pipeline.next());
+
+    // reopening in the middle of the file discards the rest of it
+    pipeline.open(path);
+    BgzfInflatePipeline::Buffer *buffer = pipeline.next();
+    CPPUNIT_ASSERT(buffer);
+    const std::vector<std::string> otherBlocksData(1, makeData(1234, 17));
+    pipeline.open(writeBlocks("other.bgzf", compressBlocks(otherBlocksData)));
+    const std::vector<std::string> buffers = readBuffers(pipeline);
+    CPPUNIT_ASSERT_EQUAL(std::size_t(1), buffers.size());
+    CPPUNIT_ASSERT(otherBlocksData[0] == buffers[0]);
+}
+
+void TestBgzfInflatePipeline::testCorruptBlock()
+{
+    // four blocks per buffer
+    const std::vector<std::string> blocksData(10, makeData(30000, 19));
+    std::vector<std::string> blocks = compressBlocks(blocksData);
+    const boost::filesystem::path goodPath = writeBlocks("good.bgzf", blocks);
+    // damage the crc of a block in the second buffer
+    const unsigned corruptBlock = 5;
+    std::string &block = blocks[corruptBlock];
+    block[block.size() - sizeof(isaac::bgzf::Footer)] ^= 0x55;
+    const boost::filesystem::path corruptPath = writeBlocks("corrupt.bgzf", blocks);
+
+    for (unsigned inflaters = 1; 4 != inflaters; ++inflaters)
+    {
+        BgzfInflatePipeline pipeline(inflaters, 3, BUFFER_CAPACITY, HEADROOM, 2);
+        pipeline.open(corruptPath);
+        std::vector<std::string> buffers;
+        CPPUNIT_ASSERT_THROW(readBuffers(pipeline, buffers), isaac::bgzf::BgzfInflateException);
+        // depending on timing, the error may be known before the first buffer is requested. The buffer with the
+        // damaged block is never returned
+        CPPUNIT_ASSERT(1 >= buffers.size());
+        if (!buffers.empty())
+        {
+            CPPUNIT_ASSERT(blocksData[0] + blocksData[1] + blocksData[2] + blocksData[3] == buffers[0]);
+        }
+        // the error stays until the next open
+        CPPUNIT_ASSERT_THROW(pipeline.next(), isaac::bgzf::BgzfInflateException);
+
+        pipeline.open(goodPath);
+        CPPUNIT_ASSERT(splitIntoBuffers(blocksData) == readBuffers(pipeline));
+    }
+
+    // file ends in the middle of the compressed data
+    std::string truncated = blocks[0] + blocks[1];
+    truncated.resize(truncated.size() - sizeof(isaac::bgzf::Footer) - 2);
+    BgzfInflatePipeline pipeline(2, 3, BUFFER_CAPACITY, HEADROOM, 2);
+    pipeline.open(writeBlocks("truncated.bgzf", std::vector<std::string>(1, truncated)));
+    CPPUNIT_ASSERT_THROW(readBuffers(pipeline), isaac::common::IoException);
+}
@@ -0,0 +1,46 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_BGZF_INFLATE_PIPELINE_HH
+#define iSAAC_IO_TEST_BGZF_INFLATE_PIPELINE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "bgzf/BgzfInflatePipeline.hh"
+
+class TestBgzfInflatePipeline : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBgzfInflatePipeline );
+    CPPUNIT_TEST( testOrdering );
+    CPPUNIT_TEST( testCarryOver );
+    CPPUNIT_TEST( testEof );
+    CPPUNIT_TEST( testCorruptBlock );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDirectory_;
+    boost::filesystem::path writeBlocks(const std::string &name, const std::vector<std::string> &blocks) const;
+public:
+    void setUp();
+    void tearDown();
+    void testOrdering();
+    void testCarryOver();
+    void testEof();
+    void testCorruptBlock();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_BGZF_INFLATE_PIPELINE_HH
@@ -0,0 +1,493 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "RegistryName.hh"
+#include "testCram.hh"
+
+#include "io/CramDecodePipeline.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestCram, registryName("Cram"));
+
+namespace cram = isaac::io::cram;
+using isaac::io::CramException;
+
+namespace
+{
+
+/**
+ * \brief Minimal rANS 4x8 encoder producing the streams that the CRAM 3.0 writers produce, so that the decoder
+ *        can be tested without external data.
+ */
+class RansEncoder
+{
+public:
+    explicit RansEncoder(const bool order1) : order1_(order1), contexts_(256){}
+
+    std::vector<char> compress(const std::string &data);
+
+private:
+    static const unsigned TF_SHIFT = 12;
+    static const uint32_t TOTFREQ = 1 << TF_SHIFT;
+    static const uint32_t RANS_BYTE_L = 1 << 23;
+
+    struct Frequencies
+    {
+        Frequencies() : counts_(256, 0), frequency_(256, 0), cumulative_(256, 0){}
+        std::vector<uint64_t> counts_;
+        std::vector<uint32_t> frequency_;
+        std::vector<uint32_t> cumulative_;
+        void normalize();
+        bool empty() const {return counts_.end() == std::find_if(counts_.begin(), counts_.end(), [](uint64_t c){return c;});}
+    };
+
+    struct Step
+    {
+        unsigned state_;
+        unsigned context_;
+        unsigned char symbol_;
+    };
+
+    const bool order1_;
+    std::vector<Frequencies> contexts_;
+    // in the order of decoding
+    std::vector<Step> steps_;
+
+    void addStep(const unsigned state, const unsigned context, const unsigned char symbol)
+    {
+        const Step step = {state, context, symbol};
+        steps_.push_back(step);
+        ++contexts_[context].counts_[symbol];
+    }
+    static void putFrequency(std::vector<char> &table, const unsigned frequency);
+    template <typename PutEntryT>
+    static void putSymbols(std::vector<char> &table, const std::vector<bool> &present, PutEntryT putEntry);
+};
+
+void RansEncoder::Frequencies::normalize()
+{
+    uint64_t total = 0;
+    for (const uint64_t count : counts_)
+    {
+        total += count;
+    }
+    uint32_t sum = 0;
+    unsigned largest = 0;
+    for (unsigned symbol = 0; 256 != symbol; ++symbol)
+    {
+        frequency_[symbol] = counts_[symbol] ? std::max<uint64_t>(1, counts_[symbol] * TOTFREQ / total) : 0;
+        sum += frequency_[symbol];
+        largest = counts_[largest] < counts_[symbol] ? symbol : largest;
+    }
+    frequency_[largest] += TOTFREQ - sum;
+    for (unsigned symbol = 1; 256 != symbol; ++symbol)
+    {
+        cumulative_[symbol] = cumulative_[symbol - 1] + frequency_[symbol - 1];
+    }
+}
+
+void RansEncoder::putFrequency(std::vector<char> &table, const unsigned frequency)
+{
+    if (frequency < 128)
+    {
+        table.push_back(frequency);
+    }
+    else
+    {
+        table.push_back(128 | (frequency >> 8));
+        table.push_back(frequency & 0xff);
+    }
+}
+
+/**
+ * \brief Symbols in ascending order. A symbol following its predecessor starts a run of consecutive symbols that
+ *        are not stored.
+ */
+template <typename PutEntryT>
+void RansEncoder::putSymbols(std::vector<char> &table, const std::vector<bool> &present, PutEntryT putEntry)
+{
+    unsigned rle = 0;
+    for (unsigned symbol = 0; 256 != symbol; ++symbol)
+    {
+        if (!present[symbol])
+        {
+            continue;
+        }
+        if (rle)
+        {
+            --rle;
+        }
+        else
+        {
+            table.push_back(symbol);
+            if (symbol && present[symbol - 1])
+            {
+                while (symbol + 1 + rle < 256 && present[symbol + 1 + rle])
+                {
+                    ++rle;
+                }
+                table.push_back(rle);
+            }
+        }
+        putEntry(symbol);
+    }
+    table.push_back(0);
+}
+
+std::vector<char> RansEncoder::compress(const std::string &data)
+{
+    const std::size_t size = data.size();
+    if (order1_)
+    {
+        const std::size_t quarter = size / 4;
+        unsigned char context[4] = {0, 0, 0, 0};
+        for (std::size_t i = 0; quarter != i; ++i)
+        {
+            for (unsigned k = 0; 4 != k; ++k)
+            {
+                addStep(k, context[k], data[k * quarter + i]);
+                context[k] = data[k * quarter + i];
+            }
+        }
+        for (std::size_t i = quarter * 4; size != i; ++i)
+        {
+            addStep(3, context[3], data[i]);
+            context[3] = data[i];
+        }
+    }
+    else
+    {
+        // the tail goes last and is decoded without advancing the states
+        for (std::size_t i = 0; size != i; ++i)
+        {
+            addStep(i % 4, 0, data[i]);
+        }
+    }
+
+    std::vector<char> stream;
+    std::vector<bool> presentContexts(256, false);
+    for (unsigned context = 0; 256 != context; ++context)
+    {
+        presentContexts[context] = !contexts_[context].empty();
+        contexts_[context].normalize();
+    }
+    const auto putTable = [&stream, this](const unsigned context)
+    {
+        std::vector<bool> present(256, false);
+        for (unsigned symbol = 0; 256 != symbol; ++symbol)
+        {
+            present[symbol] = contexts_[context].frequency_[symbol];
+        }
+        const Frequencies &frequencies = contexts_[context];
+        putSymbols(stream, present, [&stream, &frequencies](const unsigned symbol)
+        {
+            putFrequency(stream, frequencies.frequency_[symbol]);
+        });
+    };
+    if (order1_)
+    {
+        putSymbols(stream, presentContexts, putTable);
+    }
+    else
+    {
+        putTable(0);
+    }
+
+    // encode backwards into reversed bytes
+    uint32_t states[4] = {RANS_BYTE_L, RANS_BYTE_L, RANS_BYTE_L, RANS_BYTE_L};
+    std::vector<char> reversed;
+    for (std::vector<Step>::const_reverse_iterator step = steps_.rbegin(); steps_.rend() != step; ++step)
+    {
+        const Frequencies &frequencies = contexts_[step->context_];
+        const uint32_t frequency = frequencies.frequency_[step->symbol_];
+        uint32_t &x = states[step->state_];
+        const uint32_t xMax = ((RANS_BYTE_L >> TF_SHIFT) << 8) * frequency;
+        while (x >= xMax)
+        {
+            reversed.push_back(x & 0xff);
+            x >>= 8;
+        }
+        x = ((x / frequency) << TF_SHIFT) + (x % frequency) + frequencies.cumulative_[step->symbol_];
+    }
+    for (int k = 3; 0 <= k; --k)
+    {
+        for (int shift = 24; 0 <= shift; shift -= 8)
+        {
+            reversed.push_back(states[k] >> shift);
+        }
+    }
+    stream.insert(stream.end(), reversed.rbegin(), reversed.rend());
+
+    std::vector<char> ret(1, order1_);
+    cram::putInt32(ret, stream.size());
+    cram::putInt32(ret, size);
+    ret.insert(ret.end(), stream.begin(), stream.end());
+    return ret;
+}
+
+/**
+ * \brief Appends the block the way CRAM writers do, with the crc32 of the block bytes at the end
+ */
+void putRawBlock(std::vector<char> &buffer, const int method, const std::vector<char> &payload, const std::size_t rawSize)
+{
+    const std::size_t begin = buffer.size();
+    buffer.push_back(method);
+    buffer.push_back(cram::EXTERNAL_DATA);
+    cram::putItf8(buffer, 7);
+    cram::putItf8(buffer, payload.size());
+    cram::putItf8(buffer, rawSize);
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+    cram::putInt32(buffer, crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(&buffer[begin]), buffer.size() - begin));
+}
+
+std::string uncompressRans(const bool order1, const std::string &data)
+{
+    std::vector<char> buffer;
+    putRawBlock(buffer, cram::RANS, RansEncoder(order1).compress(data), data.size());
+    cram::Block block;
+    CPPUNIT_ASSERT(&buffer.back() + 1 == cram::readBlock(&buffer.front(), &buffer.back() + 1, block));
+    CPPUNIT_ASSERT_EQUAL(int(cram::RANS), int(block.method_));
+    CPPUNIT_ASSERT_EQUAL(int32_t(7), block.contentId_);
+    return std::string(block.data_.begin(), block.data_.end());
+}
+
+/**
+ * \brief Inputs of all sizes modulo 4, consecutive symbol runs, single-symbol contexts and skewed frequencies
+ */
+std::vector<std::string> getRansInputs()
+{
+    std::vector<std::string> ret;
+    ret.push_back("");
+    ret.push_back("A");
+    ret.push_back("ACG");
+    ret.push_back("AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA");
+    std::string qualities;
+    for (unsigned i = 0; 10007 != i; ++i)
+    {
+        qualities.push_back(i % 13 ? '?' + (i * i) % 7 : '#');
+    }
+    ret.push_back(qualities);
+    std::string bytes;
+    for (unsigned i = 0; 4098 != i; ++i)
+    {
+        bytes.push_back(char((i * 2654435761U) >> 24));
+    }
+    ret.push_back(bytes);
+    std::string bases;
+    for (unsigned i = 0; 1001 != i; ++i)
+    {
+        bases.push_back("ACGTTGCAN"[(i * 7 + i / 3) % 9]);
+    }
+    ret.push_back(bases);
+    return ret;
+}
+
+void writeFile(const boost::filesystem::path &path, const std::vector<char> &data)
+{
+    std::ofstream os(path.c_str(), std::ios_base::binary);
+    os.write(&data.front(), data.size());
+    CPPUNIT_ASSERT(os);
+}
+
+} // namespace
+
+void TestCram::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestCram::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestCram::testVarints()
+{
+    const int32_t itf8Values[] = {0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0x1fffff, 0x200000, 0x0fffffff, 0x10000000, -1, -2};
+    std::vector<char> buffer;
+    for (const int32_t value : itf8Values)
+    {
+        cram::putItf8(buffer, value);
+    }
+    const char *p = &buffer.front();
+    for (const int32_t value : itf8Values)
+    {
+        int32_t decoded = 0;
+        p = cram::getItf8(p, &buffer.back() + 1, decoded);
+        CPPUNIT_ASSERT_EQUAL(value, decoded);
+    }
+    CPPUNIT_ASSERT(&buffer.back() + 1 == p);
+
+    const int64_t ltf8Values[] = {0, 0x7f, 0x80, 0x3fff, 0x4000, 1L << 35, 1L << 49, 1L << 56, -1L};
+    buffer.clear();
+    for (const int64_t value : ltf8Values)
+    {
+        cram::putLtf8(buffer, value);
+    }
+    p = &buffer.front();
+    for (const int64_t value : ltf8Values)
+    {
+        int64_t decoded = 0;
+        p = cram::getLtf8(p, &buffer.back() + 1, decoded);
+        CPPUNIT_ASSERT_EQUAL(value, decoded);
+    }
+    CPPUNIT_ASSERT(&buffer.back() + 1 == p);
+
+    // -1 takes 5 bytes
+    int32_t value = 0;
+    CPPUNIT_ASSERT_THROW(cram::getItf8(&buffer.front(), &buffer.front(), value), CramException);
+    buffer.clear();
+    cram::putItf8(buffer, -1);
+    CPPUNIT_ASSERT_THROW(cram::getItf8(&buffer.front(), &buffer.back(), value), CramException);
+}
+
+void TestCram::testRansOrder0()
+{
+    for (const std::string &data : getRansInputs())
+    {
+        CPPUNIT_ASSERT(data == uncompressRans(false, data));
+    }
+}
+
+void TestCram::testRansOrder1()
+{
+    for (const std::string &data : getRansInputs())
+    {
+        CPPUNIT_ASSERT(data == uncompressRans(true, data));
+    }
+}
+
+void TestCram::testCorruptBlock()
+{
+    const std::string data = getRansInputs().back();
+    std::vector<char> buffer;
+    putRawBlock(buffer, cram::RANS, RansEncoder(true).compress(data), data.size());
+    cram::Block block;
+    // every cut of the block is detected rather than read past the end
+    for (std::size_t size = 0; buffer.size() > size; size += std::max<std::size_t>(1, size / 7))
+    {
+        const std::vector<char> cut(buffer.begin(), buffer.begin() + size);
+        CPPUNIT_ASSERT_THROW(cram::readBlock(cut.empty() ? 0 : &cut.front(), cut.empty() ? 0 : &cut.back() + 1, block),
+                             CramException);
+    }
+
+    std::vector<char> flipped(buffer);
+    flipped.at(flipped.size() / 2) ^= 0x10;
+    CPPUNIT_ASSERT_THROW(cram::readBlock(&flipped.front(), &flipped.back() + 1, block), CramException);
+
+    // rANS stream that ends before the data does. The crc is right, so it is the rANS decoder that notices.
+    std::vector<char> shortened = RansEncoder(false).compress(data);
+    shortened.resize(shortened.size() - 100);
+    std::vector<char> streamSize;
+    cram::putInt32(streamSize, shortened.size() - 9);
+    std::copy(streamSize.begin(), streamSize.end(), shortened.begin() + 1);
+    buffer.clear();
+    putRawBlock(buffer, cram::RANS, shortened, data.size());
+    CPPUNIT_ASSERT_THROW(cram::readBlock(&buffer.front(), &buffer.back() + 1, block), CramException);
+
+    buffer.clear();
+    putRawBlock(buffer, cram::LZMA, std::vector<char>(1, 0), 1);
+    CPPUNIT_ASSERT_THROW(cram::readBlock(&buffer.front(), &buffer.back() + 1, block), CramException);
+}
+
+void TestCram::testTruncatedContainerHeader()
+{
+    cram::ContainerHeader header;
+    header.length_ = 1234;
+    header.refId_ = 3;
+    header.start_ = 100000;
+    header.span_ = 500;
+    header.records_ = 10000;
+    header.recordCounter_ = 1L << 40;
+    header.bases_ = 1500000;
+    header.blocks_ = 27;
+    header.landmarks_.push_back(345);
+    std::vector<char> buffer;
+    cram::putContainerHeader(buffer, header);
+
+    {
+        std::istringstream is(std::string(buffer.begin(), buffer.end()));
+        cram::ContainerHeader read;
+        CPPUNIT_ASSERT(cram::readContainerHeader(is, read));
+        CPPUNIT_ASSERT_EQUAL(header.length_, read.length_);
+        CPPUNIT_ASSERT_EQUAL(header.refId_, read.refId_);
+        CPPUNIT_ASSERT_EQUAL(header.start_, read.start_);
+        CPPUNIT_ASSERT_EQUAL(header.span_, read.span_);
+        CPPUNIT_ASSERT_EQUAL(header.records_, read.records_);
+        CPPUNIT_ASSERT_EQUAL(header.recordCounter_, read.recordCounter_);
+        CPPUNIT_ASSERT_EQUAL(header.bases_, read.bases_);
+        CPPUNIT_ASSERT_EQUAL(header.blocks_, read.blocks_);
+        CPPUNIT_ASSERT(header.landmarks_ == read.landmarks_);
+        // clean end of stream
+        CPPUNIT_ASSERT(!cram::readContainerHeader(is, read));
+    }
+
+    for (std::size_t size = 1; buffer.size() != size; ++size)
+    {
+        std::istringstream is(std::string(buffer.begin(), buffer.begin() + size));
+        cram::ContainerHeader read;
+        CPPUNIT_ASSERT_THROW(cram::readContainerHeader(is, read), CramException);
+    }
+
+    buffer[5] ^= 1;
+    std::istringstream is(std::string(buffer.begin(), buffer.end()));
+    cram::ContainerHeader read;
+    CPPUNIT_ASSERT_THROW(cram::readContainerHeader(is, read), CramException);
+}
+
+void TestCram::testTruncatedContainer()
+{
+    // file definition, SAM header container and a container with less data than its header promises
+    std::vector<char> file(cram::FILE_DEFINITION_LENGTH, 0);
+    std::copy("CRAM", "CRAM" + 4, file.begin());
+    file[4] = 3;
+
+    const std::string samHeader("@HD\tVN:1.4\tSO:coordinate\n");
+    std::vector<char> text;
+    cram::putInt32(text, samHeader.size());
+    text.insert(text.end(), samHeader.begin(), samHeader.end());
+    std::vector<char> block;
+    cram::putBlock(block, cram::FILE_HEADER, 0, text, 0);
+    cram::ContainerHeader header;
+    header.length_ = block.size();
+    header.blocks_ = 1;
+    cram::putContainerHeader(file, header);
+    file.insert(file.end(), block.begin(), block.end());
+
+    {
+        std::istringstream is(std::string(file.begin(), file.end()));
+        CPPUNIT_ASSERT_EQUAL(samHeader, cram::readFileHeader(is));
+    }
+
+    header.length_ = 1000;
+    header.records_ = 10;
+    header.blocks_ = 3;
+    header.landmarks_.push_back(0);
+    cram::putContainerHeader(file, header);
+    file.insert(file.end(), 100, 0);
+
+    const boost::filesystem::path path = tempDir_ / "truncated.cram";
+    writeFile(path, file);
+
+    isaac::io::CramDecodePipeline pipeline(2, 3, 2, 16);
+    pipeline.open(path, cram::References());
+    CPPUNIT_ASSERT_THROW(pipeline.next(), CramException);
+}
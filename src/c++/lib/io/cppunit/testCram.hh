@@ -0,0 +1,46 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_CRAM_HH
+#define iSAAC_IO_TEST_CRAM_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "io/Cram.hh"
+
+class TestCram : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestCram );
+    CPPUNIT_TEST( testVarints );
+    CPPUNIT_TEST( testRansOrder0 );
+    CPPUNIT_TEST( testRansOrder1 );
+    CPPUNIT_TEST( testCorruptBlock );
+    CPPUNIT_TEST( testTruncatedContainerHeader );
+    CPPUNIT_TEST( testTruncatedContainer );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testVarints();
+    void testRansOrder0();
+    void testRansOrder1();
+    void testCorruptBlock();
+    void testTruncatedContainerHeader();
+    void testTruncatedContainer();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_CRAM_HH
@@ -0,0 +1,371 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "RegistryName.hh"
+#include "testMappedFile.hh"
+
+#include "common/Exceptions.hh"
+#include "io/ClocsMapper.hh"
+#include "io/FiltersMapper.hh"
+#include "io/LocsMapper.hh"
+#include "io/MappedFile.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMappedFile, registryName("MappedFile"));
+
+using isaac::common::IoException;
+using isaac::io::ClocsMapper;
+using isaac::io::FiltersMapper;
+using isaac::io::LocsMapper;
+using isaac::io::MappedFile;
+
+namespace
+{
+
+typedef std::vector<std::pair<int, int> > Positions;
+
+template <typename T>
+void appendValue(std::string &s, const T value)
+{
+    s.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+std::string makeFilterHeader(const unsigned version, const unsigned clusters)
+{
+    std::string ret;
+    if (2 <= version)
+    {
+        // V2 and V3 start with 0 for disambiguation
+        appendValue<unsigned>(ret, 0);
+        appendValue<unsigned>(ret, version);
+    }
+    appendValue<unsigned>(ret, clusters);
+    return ret;
+}
+
+/**
+ * \brief V0 and V3 store a byte per cluster, V1 and V2 store 16 bits with the control and report key bits
+ */
+unsigned makeFilterValue(const unsigned version, const unsigned cluster)
+{
+    const unsigned pf = !!(cluster % 3);
+    return (1 == version || 2 == version) ? pf | ((cluster % 4) << 1) | ((cluster % 200) << 8) : pf;
+}
+
+std::string makeFilter(const unsigned version, const unsigned clusters)
+{
+    std::string ret = makeFilterHeader(version, clusters);
+    for (unsigned cluster = 0; clusters != cluster; ++cluster)
+    {
+        if (1 == version || 2 == version)
+        {
+            appendValue<unsigned short>(ret, makeFilterValue(version, cluster));
+        }
+        else
+        {
+            appendValue<char>(ret, makeFilterValue(version, cluster));
+        }
+    }
+    return ret;
+}
+
+std::vector<unsigned> getPf(const FiltersMapper &mapper)
+{
+    std::vector<unsigned> ret;
+    mapper.getPf(std::back_inserter(ret));
+    return ret;
+}
+
+float getX(const unsigned cluster) {return cluster * 1.5f;}
+float getY(const unsigned cluster) {return cluster * 2.25f + 0.04f;}
+
+std::string makeLocs(const unsigned headerClusters, const unsigned clusters)
+{
+    std::string ret;
+    appendValue<unsigned>(ret, 1);
+    appendValue<float>(ret, 1.0f);
+    appendValue<unsigned>(ret, headerClusters);
+    for (unsigned cluster = 0; clusters != cluster; ++cluster)
+    {
+        appendValue<float>(ret, getX(cluster));
+        appendValue<float>(ret, getY(cluster));
+    }
+    return ret;
+}
+
+std::pair<int, int> getLocsPosition(const unsigned cluster)
+{
+    return std::make_pair(int(round(1000.0 + 10.0 * getX(cluster))), int(round(1000.0 + 10.0 * getY(cluster))));
+}
+
+// 82 blocks of 25 pixels cover a 2048 pixel line
+const unsigned CLOCS_BLOCKS = 85;
+const unsigned CLOCS_BLOCKS_PER_LINE = 82;
+
+unsigned getClocsBlockClusters(const unsigned block) {return block % 3;}
+
+std::string makeClocs(Positions &positions)
+{
+    std::string ret;
+    appendValue<char>(ret, 1);
+    appendValue<unsigned>(ret, CLOCS_BLOCKS);
+    for (unsigned block = 0; CLOCS_BLOCKS != block; ++block)
+    {
+        appendValue<unsigned char>(ret, getClocsBlockClusters(block));
+        for (unsigned i = 0; getClocsBlockClusters(block) != i; ++i)
+        {
+            const unsigned char dx = block % 25;
+            const unsigned char dy = (block * 7 + i) % 25;
+            appendValue<unsigned char>(ret, dx);
+            appendValue<unsigned char>(ret, dy);
+            positions.push_back(std::make_pair(
+                int(block % CLOCS_BLOCKS_PER_LINE) * 25 + dx, int(block / CLOCS_BLOCKS_PER_LINE) * 25 + dy));
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
+void TestMappedFile::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestMappedFile::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+boost::filesystem::path TestMappedFile::write(const std::string &name, const std::string &content) const
+{
+    const boost::filesystem::path ret = tempDir_ / name;
+    std::ofstream os(ret.c_str(), std::ios_base::binary);
+    CPPUNIT_ASSERT(os.write(content.data(), content.size()));
+    return ret;
+}
+
+void TestMappedFile::testMap()
+{
+    const boost::filesystem::path first = write("first", "first file");
+    const boost::filesystem::path second = write("second", "second");
+
+    MappedFile file;
+    file.map(first);
+    CPPUNIT_ASSERT_EQUAL(std::string("first file"), std::string(file.data(), file.end()));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(10), file.size());
+    CPPUNIT_ASSERT_EQUAL(first.string(), file.getPath());
+    file.willNeed(2, 8);
+
+    // same path keeps the mapping
+    const char *data = file.data();
+    file.map(first);
+    CPPUNIT_ASSERT(data == file.data());
+
+    file.map(second);
+    CPPUNIT_ASSERT_EQUAL(std::string("second"), std::string(file.data(), file.end()));
+
+    file.unmap();
+    CPPUNIT_ASSERT(!file.data());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), file.size());
+
+    CPPUNIT_ASSERT_THROW(file.map(tempDir_ / "missing"), IoException);
+    CPPUNIT_ASSERT(!file.data());
+}
+
+void TestMappedFile::testEmptyFile()
+{
+    const boost::filesystem::path empty = write("empty", "");
+
+    MappedFile file;
+    CPPUNIT_ASSERT_THROW(file.map(empty), IoException);
+    CPPUNIT_ASSERT(!file.data());
+
+    // an existing empty filter file is an error even when missing ones are ignored
+    FiltersMapper filtersMapper(true);
+    CPPUNIT_ASSERT_THROW(filtersMapper.mapTile(empty, 10), IoException);
+    CPPUNIT_ASSERT_THROW(FiltersMapper::getClusterCount(empty), IoException);
+
+    LocsMapper locsMapper;
+    CPPUNIT_ASSERT_THROW(locsMapper.mapTile(empty, 10), IoException);
+
+    ClocsMapper clocsMapper;
+    CPPUNIT_ASSERT_THROW(clocsMapper.mapTile(empty, 10), IoException);
+}
+
+void TestMappedFile::testTileFilters()
+{
+    const unsigned clusters = 37;
+    FiltersMapper mapper(false);
+    for (unsigned version = 0; 4 != version; ++version)
+    {
+        const boost::filesystem::path path = write("s_1_1101_v" + std::to_string(version) + ".filter",
+                                                   makeFilter(version, clusters));
+        CPPUNIT_ASSERT_EQUAL(clusters, FiltersMapper::getClusterCount(path));
+
+        mapper.mapTile(path, clusters);
+        const std::vector<unsigned> pf = getPf(mapper);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(clusters), pf.size());
+        for (unsigned cluster = 0; clusters != cluster; ++cluster)
+        {
+            CPPUNIT_ASSERT_EQUAL(makeFilterValue(version, cluster), pf[cluster]);
+        }
+
+        // tile filter files must describe exactly the tile
+        CPPUNIT_ASSERT_THROW(mapper.mapTile(path, clusters + 1), IoException);
+    }
+}
+
+void TestMappedFile::testLaneFilter()
+{
+    // three tiles of 10, 20 and 7 clusters in one lane file
+    const unsigned tileClusters[] = {10, 20, 7};
+    const boost::filesystem::path path = write("s_1.filter", makeFilter(3, 37));
+
+    FiltersMapper mapper(false);
+    unsigned offset = 0;
+    for (const unsigned clusters : tileClusters)
+    {
+        mapper.mapTile(path, clusters, offset);
+        const std::vector<unsigned> pf = getPf(mapper);
+        CPPUNIT_ASSERT_EQUAL(std::size_t(clusters), pf.size());
+        for (unsigned cluster = 0; clusters != cluster; ++cluster)
+        {
+            // the first value of each tile is the tile's own
+            CPPUNIT_ASSERT_EQUAL(makeFilterValue(3, offset + cluster), pf[cluster]);
+        }
+        offset += clusters;
+    }
+
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(path, 8, 30), IoException);
+}
+
+void TestMappedFile::testMissingFilter()
+{
+    const boost::filesystem::path missing = tempDir_ / "s_1_1101.filter";
+
+    FiltersMapper ignoring(true);
+    ignoring.mapTile(missing, 5);
+    CPPUNIT_ASSERT(std::vector<unsigned>(5, 1) == getPf(ignoring));
+
+    FiltersMapper strict(false);
+    CPPUNIT_ASSERT_THROW(strict.mapTile(missing, 5), IoException);
+}
+
+void TestMappedFile::testTruncatedFilter()
+{
+    FiltersMapper mapper(false);
+    // header promises more values than the file has
+    const std::string full = makeFilter(3, 10);
+    const boost::filesystem::path values = write("values.filter", full.substr(0, full.size() - 5));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(values, 10), IoException);
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(values, 10, 0), IoException);
+
+    // V3 header cut after the disambiguation zero
+    const boost::filesystem::path header = write("header.filter", full.substr(0, 6));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(header, 10), IoException);
+    CPPUNIT_ASSERT_THROW(FiltersMapper::getClusterCount(header), IoException);
+
+    const boost::filesystem::path count = write("count.filter", full.substr(0, 3));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(count, 10), IoException);
+
+    // V0/V1 files whose length fits neither version
+    const std::string v0 = makeFilter(0, 10);
+    const boost::filesystem::path v0Values = write("v0.filter", v0.substr(0, v0.size() - 1));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(v0Values, 10), IoException);
+}
+
+void TestMappedFile::testLocs()
+{
+    const unsigned clusters = 12;
+    const boost::filesystem::path path = write("s_1.locs", makeLocs(clusters, clusters));
+
+    LocsMapper mapper;
+    mapper.mapTile(path, clusters);
+    Positions positions;
+    mapper.getPositions(std::back_inserter(positions));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(clusters), positions.size());
+    for (unsigned cluster = 0; clusters != cluster; ++cluster)
+    {
+        CPPUNIT_ASSERT(getLocsPosition(cluster) == positions[cluster]);
+    }
+
+    // tile within a lane-level file
+    mapper.mapTile(path, 5, 4);
+    positions.clear();
+    mapper.getPositions(std::back_inserter(positions));
+    CPPUNIT_ASSERT_EQUAL(std::size_t(5), positions.size());
+    for (unsigned cluster = 0; 5 != cluster; ++cluster)
+    {
+        CPPUNIT_ASSERT(getLocsPosition(4 + cluster) == positions[cluster]);
+    }
+
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(path, clusters - 1), IoException);
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(path, 5, 8), IoException);
+}
+
+void TestMappedFile::testTruncatedLocs()
+{
+    LocsMapper mapper;
+    const boost::filesystem::path values = write("values.locs", makeLocs(12, 8));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(values, 12), IoException);
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(values, 4, 8), IoException);
+    // the part that is there can still be used
+    mapper.mapTile(values, 4, 4);
+
+    const boost::filesystem::path header = write("header.locs", makeLocs(12, 0).substr(0, 6));
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(header, 12), IoException);
+
+    std::string version = makeLocs(12, 12);
+    version[0] = 2;
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(write("version.locs", version), 12), IoException);
+}
+
+void TestMappedFile::testClocs()
+{
+    Positions expected;
+    const boost::filesystem::path path = write("s_1_1101.clocs", makeClocs(expected));
+
+    ClocsMapper mapper;
+    mapper.mapTile(path, expected.size());
+    Positions positions;
+    mapper.getPositions(std::back_inserter(positions));
+    CPPUNIT_ASSERT(expected == positions);
+}
+
+void TestMappedFile::testTruncatedClocs()
+{
+    Positions expected;
+    const std::string full = makeClocs(expected);
+
+    ClocsMapper mapper;
+    // the bins are only expanded when the positions are requested
+    mapper.mapTile(write("values.clocs", full.substr(0, full.size() - 3)), expected.size());
+    Positions positions;
+    CPPUNIT_ASSERT_THROW(mapper.getPositions(std::back_inserter(positions)), IoException);
+
+    // file describes fewer clusters than the tile has
+    mapper.mapTile(write("clusters.clocs", full), expected.size() + 1);
+    positions.clear();
+    CPPUNIT_ASSERT_THROW(mapper.getPositions(std::back_inserter(positions)), IoException);
+
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(write("header.clocs", full.substr(0, 3)), expected.size()), IoException);
+
+    std::string version = full;
+    version[0] = 0;
+    CPPUNIT_ASSERT_THROW(mapper.mapTile(write("version.clocs", version), expected.size()), IoException);
+}
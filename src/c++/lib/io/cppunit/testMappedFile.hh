@@ -0,0 +1,55 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_MAPPED_FILE_HH
+#define iSAAC_IO_TEST_MAPPED_FILE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+class TestMappedFile : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestMappedFile );
+    CPPUNIT_TEST( testMap );
+    CPPUNIT_TEST( testEmptyFile );
+    CPPUNIT_TEST( testTileFilters );
+    CPPUNIT_TEST( testLaneFilter );
+    CPPUNIT_TEST( testMissingFilter );
+    CPPUNIT_TEST( testTruncatedFilter );
+    CPPUNIT_TEST( testLocs );
+    CPPUNIT_TEST( testTruncatedLocs );
+    CPPUNIT_TEST( testClocs );
+    CPPUNIT_TEST( testTruncatedClocs );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+    boost::filesystem::path write(const std::string &name, const std::string &content) const;
+public:
+    void setUp();
+    void tearDown();
+    void testMap();
+    void testEmptyFile();
+    void testTileFilters();
+    void testLaneFilter();
+    void testMissingFilter();
+    void testTruncatedFilter();
+    void testLocs();
+    void testTruncatedLocs();
+    void testClocs();
+    void testTruncatedClocs();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_MAPPED_FILE_HH
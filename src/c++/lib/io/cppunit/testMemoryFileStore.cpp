@@ -0,0 +1,185 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "RegistryName.hh"
+#include "testMemoryFileStore.hh"
+
+#include "common/MemoryBudget.hh"
+#include "io/PooledFileWriter.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestMemoryFileStore, registryName("MemoryFileStore"));
+
+using isaac::common::MemoryBudget;
+using isaac::io::MemoryFileStore;
+
+static std::string makeData(const std::size_t bytes, const char seed)
+{
+    std::string ret(bytes, 0);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret[i] = char(seed + i * 7);
+    }
+    return ret;
+}
+
+static std::string readBack(const MemoryFileStore::File &file, const uint64_t offset, const uint64_t bytes)
+{
+    MemoryFileStore::Reader reader;
+    reader.open(file, offset, bytes);
+    std::string ret(bytes, 0);
+    ret.resize(reader.read(&ret[0], bytes));
+    CPPUNIT_ASSERT_EQUAL(offset + ret.size(), reader.tell());
+    reader.close();
+    return ret;
+}
+
+void TestMemoryFileStore::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestMemoryFileStore::tearDown()
+{
+    MemoryBudget::configure(0);
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestMemoryFileStore::testAppend()
+{
+    MemoryFileStore store(MemoryFileStore::CHUNK_BYTES * 4);
+    CPPUNIT_ASSERT(store.isEnabled());
+    CPPUNIT_ASSERT(!store.find("a"));
+
+    // pieces crossing the chunk boundary
+    const std::string first = makeData(1000, 'a');
+    const std::string second = makeData(MemoryFileStore::CHUNK_BYTES, 'b');
+    const std::string third = makeData(3, 'c');
+    const iovec pieces[] = {
+        {const_cast<char *>(first.data()), first.size()},
+        {const_cast<char *>(second.data()), second.size()}};
+    MemoryFileStore::File &file = store.create("a");
+    CPPUNIT_ASSERT(store.append(file, pieces, 2));
+    CPPUNIT_ASSERT(store.append(file, pieces, 0));
+    const iovec last = {const_cast<char *>(third.data()), third.size()};
+    CPPUNIT_ASSERT(store.append(file, &last, 1));
+
+    const std::string expected = first + second + third;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(expected.size()), file.getSize());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(MemoryFileStore::CHUNK_BYTES * 2), store.getBytes());
+    CPPUNIT_ASSERT(&file == store.find("a"));
+
+    CPPUNIT_ASSERT(expected == readBack(file, 0, expected.size()));
+    // ranges starting in the second chunk and reads past the end of file
+    CPPUNIT_ASSERT(expected.substr(MemoryFileStore::CHUNK_BYTES, 100) == readBack(file, MemoryFileStore::CHUNK_BYTES, 100));
+    CPPUNIT_ASSERT(expected.substr(expected.size() - 10) == readBack(file, expected.size() - 10, 1000));
+
+    std::string chunks;
+    MemoryFileStore::forEachChunk(file, [&chunks](const char *data, const std::size_t bytes)
+    {
+        chunks.append(data, bytes);
+    });
+    CPPUNIT_ASSERT(expected == chunks);
+
+    // create replaces the contents
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), store.create("a").getSize());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), store.getBytes());
+
+    store.append(store.create("b"), &last, 1);
+    store.remove("b");
+    CPPUNIT_ASSERT(!store.find("b"));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), store.getBytes());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), MemoryBudget::instance().getReserved(MemoryBudget::BinsInMemory));
+}
+
+void TestMemoryFileStore::testLimit()
+{
+    CPPUNIT_ASSERT(!MemoryFileStore(0).isEnabled());
+
+    MemoryFileStore store(MemoryFileStore::CHUNK_BYTES);
+    MemoryFileStore::File &file = store.create("a");
+    const std::string small = makeData(100, 'a');
+    const iovec smallPiece = {const_cast<char *>(small.data()), small.size()};
+    CPPUNIT_ASSERT(store.append(file, &smallPiece, 1));
+
+    // chunk headers make a whole chunk worth of data take two chunks
+    const std::string big = makeData(MemoryFileStore::CHUNK_BYTES, 'b');
+    const iovec pieces[] = {smallPiece, {const_cast<char *>(big.data()), big.size()}};
+    CPPUNIT_ASSERT(!store.append(file, pieces, 2));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(small.size()), file.getSize());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(MemoryFileStore::CHUNK_BYTES), store.getBytes());
+
+    // what fits the chunk that is already there still goes in
+    CPPUNIT_ASSERT(store.append(file, &smallPiece, 1));
+    CPPUNIT_ASSERT(small + small == readBack(file, 0, file.getSize()));
+    store.clear();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), store.getBytes());
+}
+
+void TestMemoryFileStore::testBudgetRefusal()
+{
+    MemoryBudget &budget = MemoryBudget::instance();
+    MemoryBudget::configure(budget.getReserved() + MemoryFileStore::CHUNK_BYTES);
+
+    MemoryFileStore store(MemoryFileStore::CHUNK_BYTES * 4);
+    MemoryFileStore::File &file = store.create("a");
+    const std::string data = makeData(MemoryFileStore::CHUNK_BYTES / 2, 'a');
+    const iovec piece = {const_cast<char *>(data.data()), data.size()};
+    CPPUNIT_ASSERT(store.append(file, &piece, 1));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(MemoryFileStore::CHUNK_BYTES), budget.getReserved(MemoryBudget::BinsInMemory));
+
+    // the store has room but the budget does not
+    CPPUNIT_ASSERT(!store.append(file, &piece, 1));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(data.size()), file.getSize());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(MemoryFileStore::CHUNK_BYTES), store.getBytes());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(MemoryFileStore::CHUNK_BYTES), budget.getReserved(MemoryBudget::BinsInMemory));
+
+    store.clear();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), budget.getReserved(MemoryBudget::BinsInMemory));
+}
+
+void TestMemoryFileStore::testSpill()
+{
+    MemoryFileStore store(MemoryFileStore::CHUNK_BYTES);
+    const boost::filesystem::path path = tempDir_ / "bin.dat";
+    const std::string first = makeData(1000, 'a');
+    const std::string second = makeData(MemoryFileStore::CHUNK_BYTES, 'b');
+    const std::string third = makeData(5000, 'c');
+    {
+        isaac::io::PooledFileWriter writer(1, isaac::io::PooledFileWriter::BUFFER_ALIGNMENT, 0, store);
+        writer.reset(1);
+        writer.create(0, path, 0);
+        writer.write(0, first.data(), first.size());
+        CPPUNIT_ASSERT(store.find(path.string()));
+        CPPUNIT_ASSERT(!boost::filesystem::exists(path));
+
+        writer.write(0, second.data(), second.size());
+        CPPUNIT_ASSERT(!store.find(path.string()));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0), store.getBytes());
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1), writer.getCounters().spills_);
+
+        // once on disk, the file stays there
+        writer.write(0, third.data(), third.size());
+        writer.flush();
+        CPPUNIT_ASSERT(!store.find(path.string()));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(first.size() + second.size() + third.size()), writer.getSize(0));
+    }
+
+    std::ifstream is(path.c_str());
+    const std::string onDisk((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    CPPUNIT_ASSERT(first + second + third == onDisk);
+}
@@ -0,0 +1,42 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_MEMORY_FILE_STORE_HH
+#define iSAAC_IO_TEST_MEMORY_FILE_STORE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "io/MemoryFileStore.hh"
+
+class TestMemoryFileStore : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestMemoryFileStore );
+    CPPUNIT_TEST( testAppend );
+    CPPUNIT_TEST( testLimit );
+    CPPUNIT_TEST( testBudgetRefusal );
+    CPPUNIT_TEST( testSpill );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testAppend();
+    void testLimit();
+    void testBudgetRefusal();
+    void testSpill();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_MEMORY_FILE_STORE_HH
@@ -0,0 +1,263 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "RegistryName.hh"
+#include "testPooledFileWriter.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestPooledFileWriter, registryName("PooledFileWriter"));
+
+using isaac::io::MemoryFileStore;
+using isaac::io::PooledFileWriter;
+
+// bytes one pwritev call is allowed to write. 0 - no limit
+static std::size_t pwritevBytesMax = 0;
+// largest number of pieces given to one pwritev call
+static int pwritevPiecesMax = 0;
+
+/**
+ * \brief Replaces the library function for the writer under test. The kernel is allowed to stop a pwritev anywhere,
+ *        this one stops after pwritevBytesMax bytes.
+ */
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    pwritevPiecesMax = std::max(pwritevPiecesMax, iovcnt);
+    std::size_t ret = 0;
+    for (int i = 0; iovcnt != i && (!pwritevBytesMax || pwritevBytesMax != ret); ++i)
+    {
+        const std::size_t bytes = pwritevBytesMax ? std::min(iov[i].iov_len, pwritevBytesMax - ret) : iov[i].iov_len;
+        const ssize_t written = pwrite(fd, iov[i].iov_base, bytes, offset + ret);
+        if (-1 == written)
+        {
+            return ret ? ret : -1;
+        }
+        ret += written;
+        if (bytes != std::size_t(written))
+        {
+            break;
+        }
+    }
+    return ret;
+}
+
+static const std::size_t BUFFER_BYTES = PooledFileWriter::BUFFER_ALIGNMENT;
+static const std::size_t WRITE_BATCH_MAX = std::min<std::size_t>(IOV_MAX, 256);
+
+static std::string makeData(const std::size_t bytes, const char seed)
+{
+    std::string ret(bytes, 0);
+    for (std::size_t i = 0; bytes != i; ++i)
+    {
+        ret[i] = char(seed + i * 7 + i / 253);
+    }
+    return ret;
+}
+
+static std::string readFile(const boost::filesystem::path &path)
+{
+    std::ifstream is(path.c_str(), std::ios_base::binary);
+    CPPUNIT_ASSERT(is);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+void TestPooledFileWriter::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+    pwritevBytesMax = 0;
+    pwritevPiecesMax = 0;
+}
+
+void TestPooledFileWriter::tearDown()
+{
+    pwritevBytesMax = 0;
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestPooledFileWriter::testEviction()
+{
+    MemoryFileStore noMemory(0);
+    PooledFileWriter writer(2, BUFFER_BYTES, 0, noMemory);
+    writer.reset(3);
+
+    // bigger than the buffer, each write goes to the file
+    std::vector<std::string> expected(3);
+    for (std::size_t file = 0; 3 != file; ++file)
+    {
+        writer.create(file, tempDir_ / (boost::format("%d.dat") % file).str(), 0);
+        expected[file] = makeData(BUFFER_BYTES + 1, 'a' + file);
+        writer.write(file, expected[file].data(), expected[file].size());
+    }
+    // creating the third file closed the least recently used first one
+    CPPUNIT_ASSERT_EQUAL(uint64_t(3), writer.getCounters().opens_);
+
+    const std::string more = makeData(BUFFER_BYTES * 2 + 3, 'x');
+    // reopens 0 closing 1
+    writer.write(0, more.data(), more.size());
+    expected[0] += more;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4), writer.getCounters().opens_);
+    // 2 stays open
+    writer.write(2, more.data(), more.size());
+    expected[2] += more;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(4), writer.getCounters().opens_);
+    // reopens 1 closing 0
+    writer.write(1, more.data(), more.size());
+    expected[1] += more;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(5), writer.getCounters().opens_);
+
+    // buffered data goes to the file at the offset where the previous descriptor stopped
+    writer.write(0, "tail", 4);
+    expected[0] += "tail";
+    CPPUNIT_ASSERT_EQUAL(uint64_t(expected[0].size()), writer.getSize(0));
+    writer.flush();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(6), writer.getCounters().opens_);
+    writer.close();
+
+    for (std::size_t file = 0; 3 != file; ++file)
+    {
+        CPPUNIT_ASSERT(expected[file] == readFile(tempDir_ / (boost::format("%d.dat") % file).str()));
+    }
+}
+
+void TestPooledFileWriter::testPartialWrites()
+{
+    MemoryFileStore noMemory(0);
+    PooledFileWriter writer(1, BUFFER_BYTES, 0, noMemory);
+    writer.reset(1);
+    const boost::filesystem::path path = tempDir_ / "partial.dat";
+    writer.create(0, path, 0);
+
+    const std::string buffered = makeData(100, 'b');
+    writer.write(0, buffered.data(), buffered.size());
+
+    // each pwritev stops in the middle of a piece
+    pwritevBytesMax = 1000;
+    const std::string first = makeData(BUFFER_BYTES * 2 + 7, 'f');
+    const std::string second = makeData(333, 's');
+    const std::string third = makeData(1, 't');
+    const iovec pieces[] = {
+        {const_cast<char *>(first.data()), first.size()},
+        {const_cast<char *>(second.data()), second.size()},
+        {const_cast<char *>(third.data()), third.size()}};
+    writer.resetCounters();
+    writer.write(0, pieces, 3);
+
+    const std::string expected = buffered + first + second + third;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(expected.size()), writer.getCounters().bytes_);
+    CPPUNIT_ASSERT_EQUAL(uint64_t((expected.size() + pwritevBytesMax - 1) / pwritevBytesMax),
+                         writer.getCounters().writeCalls_);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(expected.size()), writer.getSize(0));
+    writer.close();
+    CPPUNIT_ASSERT(expected == readFile(path));
+}
+
+void TestPooledFileWriter::testBatching()
+{
+    MemoryFileStore noMemory(0);
+    PooledFileWriter writer(1, BUFFER_BYTES, 0, noMemory);
+    writer.reset(1);
+    const boost::filesystem::path path = tempDir_ / "batches.dat";
+    writer.create(0, path, 0);
+
+    const std::string buffered = makeData(10, 'b');
+    writer.write(0, buffered.data(), buffered.size());
+
+    // the buffer and the pieces make two full batches and a bit
+    const std::size_t pieceCount = WRITE_BATCH_MAX * 2;
+    std::vector<std::string> data(pieceCount);
+    std::vector<iovec> pieces(pieceCount);
+    std::string expected = buffered;
+    for (std::size_t i = 0; pieceCount != i; ++i)
+    {
+        data[i] = makeData(i % 50 + 1, char(i));
+        pieces[i].iov_base = const_cast<char *>(data[i].data());
+        pieces[i].iov_len = data[i].size();
+        expected += data[i];
+    }
+    CPPUNIT_ASSERT(expected.size() > BUFFER_BYTES);
+    writer.resetCounters();
+    writer.write(0, &pieces.front(), pieces.size());
+
+    CPPUNIT_ASSERT_EQUAL(int(WRITE_BATCH_MAX), pwritevPiecesMax);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(3), writer.getCounters().writeCalls_);
+    writer.close();
+    CPPUNIT_ASSERT(expected == readFile(path));
+}
+
+void TestPooledFileWriter::testCreateTruncates()
+{
+    const boost::filesystem::path path = tempDir_ / "existing.dat";
+    {
+        std::ofstream os(path.c_str(), std::ios_base::binary);
+        os << makeData(BUFFER_BYTES * 3, 'o');
+    }
+
+    MemoryFileStore noMemory(0);
+    PooledFileWriter writer(1, BUFFER_BYTES, 0, noMemory);
+    writer.reset(1);
+    writer.create(0, path, 0);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), boost::filesystem::file_size(path));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), writer.getSize(0));
+
+    // shorter than the old contents
+    writer.write(0, "new", 3);
+    writer.flush();
+    writer.close();
+    CPPUNIT_ASSERT_EQUAL(std::string("new"), readFile(path));
+
+    // same with the file in memory. Nothing is left in the file system
+    MemoryFileStore memory(MemoryFileStore::CHUNK_BYTES);
+    PooledFileWriter memoryWriter(1, BUFFER_BYTES, 0, memory);
+    memoryWriter.reset(1);
+    memoryWriter.create(0, path, 0);
+    CPPUNIT_ASSERT(!boost::filesystem::exists(path));
+    CPPUNIT_ASSERT(memory.find(path.string()));
+    memoryWriter.close();
+}
+
+void TestPooledFileWriter::testWriteBehind()
+{
+    MemoryFileStore noMemory(0);
+    const std::size_t windowBytes = BUFFER_BYTES * 2;
+    PooledFileWriter writer(1, BUFFER_BYTES, windowBytes, noMemory);
+    writer.reset(2);
+    writer.create(0, tempDir_ / "0.dat", 0);
+    writer.create(1, tempDir_ / "1.dat", 0);
+
+    std::string expected;
+    for (unsigned i = 0; 7 != i; ++i)
+    {
+        const std::string data = makeData(windowBytes - 5, char(i));
+        writer.write(0, data.data(), data.size());
+        expected += data;
+        // the other file takes the descriptor, write-behind has to reopen the file
+        writer.write(1, data.data(), data.size());
+        writer.writeBehind(0);
+    }
+    writer.flush();
+    writer.writeBehind(0);
+    writer.writeBehind(1);
+    writer.close();
+    CPPUNIT_ASSERT(expected == readFile(tempDir_ / "0.dat"));
+    CPPUNIT_ASSERT(expected == readFile(tempDir_ / "1.dat"));
+}
@@ -0,0 +1,44 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_IO_TEST_POOLED_FILE_WRITER_HH
+#define iSAAC_IO_TEST_POOLED_FILE_WRITER_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+#include "io/PooledFileWriter.hh"
+
+class TestPooledFileWriter : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestPooledFileWriter );
+    CPPUNIT_TEST( testEviction );
+    CPPUNIT_TEST( testPartialWrites );
+    CPPUNIT_TEST( testBatching );
+    CPPUNIT_TEST( testCreateTruncates );
+    CPPUNIT_TEST( testWriteBehind );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testEviction();
+    void testPartialWrites();
+    void testBatching();
+    void testCreateTruncates();
+    void testWriteBehind();
+};
+
+#endif // #ifndef iSAAC_IO_TEST_POOLED_FILE_WRITER_HH
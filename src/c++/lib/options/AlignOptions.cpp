@@ -39,6 +39,7 @@
 #include "options/AlignOptions.hh"
 #include "package/InstallationPaths.hh"
 
+#include "bam/BamIndexer.hh"
 #include "alignOptions/BamFlowcell.hh"
 #include "alignOptions/BclFlowcell.hh"
 #include "alignOptions/FastqFlowcell.hh"
@@ -172,12 +173,20 @@ AlignOptions::AlignOptions()
     , tempSaversMax(1000 - 256 - inputLoadersMax)   // typical ulimit -f is 1024. Make some room for unusual temporary files (such as bam unpaired cluster cache).
     , tempLoadersMax(4) // assuming the temporary data sits on a low-latency storage (local spinning disk or ssd, reduce the competition for reading to increase the throughput.
                         // raise this number for high-latency temp storage such as network drive.
+    , tempLoadersAdaptive(false)
+    , tempDirectIo(true)
+    , inMemoryBins(0)
     , outputSaversMax(120) // increases the number of threads that can compress bins for bam while the compressed bins
                            // are stuck waiting for one of the prerequisite bins to complete
     , realignGapsString("sample")
     , realignGaps(build::REALIGN_SAMPLE)
     , realignMapqMin(60)
     , bamGzipLevel(boost::iostreams::gzip::best_speed)
+    , outputFormatString("bam")
+    , outputFormat(build::OUTPUT_BAM)
+    , bamIndexFormatString("bai")
+    , bamIndexFormat(bam::BAM_INDEX_BAI)
+    , csiMinShift(bam::BinningScheme::BAI_MIN_SHIFT)
     , bamPuFormat("%F:%L:%B")
     , bamProduceMd5(true)
     , expectedBgzfCompressionRatio(1)
@@ -196,6 +205,8 @@ AlignOptions::AlignOptions()
     , optionalFeatures(parseBamExcludeTags(bamExcludeTags))
     , pessimisticMapQ(false)
     , detectTemplateBlockSize(10000)
+    , reportsDuringBam(false)
+    , fastqParallelExtraction(false)
     , disableResume(false)
 {
     static bool bufferBins = false;
@@ -217,13 +228,15 @@ AlignOptions::AlignOptions()
         ("base-calls-format,f"   , bpo::value<std::vector<std::string> >(&baseCallsFormatStringList)->multitoken(),
                 "Multiple entries allowed. Each entry is applied to the corresponding base-calls. "
                 "Last entry is applied to all --base-calls that don't have --base-calls-format specified."
-                "\n  - bam             : --base-calls points to a Bam file. All data found in bam file is assumed to "
-                                        "come from lane 1 of a single flowcell."
+                "\n  - bam             : --base-calls points to a Bam or Cram file. All data found in the file is assumed to "
+                                        "come from lane 1 of a single flowcell. Cram is decoded against --reference-genome."
                 "\n  - bcl             : --base-calls points to RunInfo.xml file. Data is made of uncompressed bcl files."
                 "\n  - bcl-gz          : --base-calls points to RunInfo.xml file. Bcl cycle tile files are individually "
                                         "compressed and named s_X_YYYY.bcl.gz"
                 "\n  - bcl-bgzf        : --base-calls points to RunInfo.xml file. Bcl data is stored in cycle files that "
                                         "are named CCCC.bcl.bgzf"
+                "\n  - cbcl            : --base-calls points to RunInfo.xml file. Bcl data is stored in NovaSeq cbcl files "
+                                        "named L00X/CN.1/L00X_S.cbcl, one per lane, cycle N and surface S"
                 "\n  - fastq           : --base-calls points to a directory containing one fastq per lane/read named "
                                         "lane<X>_read<Y>.fastq. Use lane<X>_read1.fastq for single-ended data."
                 "\n  - fastq-gz        : --base-calls points to a directory containing one compressed fastq per lane/read "
@@ -275,6 +288,18 @@ AlignOptions::AlignOptions()
                 "path to a VCF file containing known indels fore realignment.")
         ("bam-gzip-level"           , bpo::value<int>(&bamGzipLevel)->default_value(bamGzipLevel),
                 "Gzip level to use for BAM")
+        ("output-format"            , bpo::value<std::string>(&outputFormatString)->default_value(outputFormatString),
+                "Format of the alignment files produced for each sample:"
+                "\n  - bam             : bgzf-compressed BAM with BAI index"
+                "\n  - cram            : CRAM 3.0 compressed against the reference with CRAI index. "
+                "The same reference is required to decode the file. --bam-gzip-level applies to the CRAM blocks")
+        ("bam-index"                , bpo::value<std::string>(&bamIndexFormatString)->default_value(bamIndexFormatString),
+                "Index files produced next to each bam file:"
+                "\n  - bai             : sorted.bam.bai. Not produced for references with contigs longer than 512Mbp"
+                "\n  - csi             : sorted.bam.csi. Depth of the binning is chosen to cover the longest contig"
+                "\n  - bai,csi         : both")
+        ("csi-min-shift"            , bpo::value<unsigned>(&csiMinShift)->default_value(csiMinShift),
+                "Width of the smallest CSI bin is 2^csi-min-shift bases")
         ("bam-header-tag"           , bpo::value<std::vector<std::string> >(&bamHeaderTags)->multitoken(),
                 "Additional bam entries that are copied into the header of each produced bam file. Use '\\t' to represent tab separators.")
         ("bam-produce-md5"     , bpo::value<bool>(&bamProduceMd5)->default_value(bamProduceMd5),
@@ -356,6 +381,16 @@ AlignOptions::AlignOptions()
                 "Maximum number of concurrent file read operations for --base-calls")
         ("temp-concurrent-load"            , bpo::value<unsigned>(&tempLoadersMax)->default_value(tempLoadersMax),
                 "Maximum number of concurrent file read operations for --temp-directory")
+        ("temp-concurrent-load-adaptive"   , bpo::value<bool>(&tempLoadersAdaptive)->default_value(tempLoadersAdaptive)->implicit_value(true),
+                "Allow bam generation to trade compute threads for --temp-directory read operations and back depending on "
+                "the observed load and compute times. --temp-concurrent-load is used as the starting point.")
+        ("temp-direct-io"                  , bpo::value<bool>(&tempDirectIo)->default_value(tempDirectIo),
+                "Read bins from --temp-directory bypassing the file system cache (O_DIRECT) when the file system "
+                "supports it. Keeps the cache for the reference and other data that is read more than once.")
+        ("in-memory-bins"                  , bpo::value<uint64_t>(&inMemoryBins)->default_value(inMemoryBins),
+                "Keep up to this many megabytes of bins in memory and pass them to bam generation without writing "
+                "them into --temp-directory. Bins that don't fit this or --memory-limit are moved to "
+                "--temp-directory. Requires the whole workflow to run in one go. 0 disables.")
         ("temp-concurrent-save"            , bpo::value<unsigned>(&tempSaversMax)->default_value(tempSaversMax),
                 "Maximum number of concurrent file write operations for --temp-directory")
         ("output-concurrent-save"            , bpo::value<unsigned>(&outputSaversMax)->default_value(outputSaversMax),
@@ -395,6 +430,11 @@ AlignOptions::AlignOptions()
                 "The primary purpose of the feature is to reduce the time required to diagnose the issues rather than "
                 "be used on a regular basis."
         )
+        ("reports-during-bam"           , bpo::value<bool>(&reportsDuringBam)->default_value(reportsDuringBam)->implicit_value(true),
+                "Generate alignment reports while bam files are being generated instead of before. Bam generation "
+                "still starts after all the data is aligned, as every bin receives fragments from all tiles. The state for "
+                "--start-from is saved after the alignment and after the bam generation. Requires --memory-control off "
+                "and can't be combined with --stop-at AlignmentReports.")
         ("clusters-at-a-time"         , bpo::value<unsigned>(&clustersAtATimeMax)->default_value(clustersAtATimeMax),
                 "Bam and fastq only. When not set, number of clusters to process together when input is bam or fastq is computed "
                 "automatically based on the amount of available RAM. Set to non-zero value to force deterministic behavior.")
@@ -426,6 +466,10 @@ AlignOptions::AlignOptions()
                 "3' end quality trimming cutoff. Value above 0 causes low quality bases to be soft-clipped. 0 turns the trimming off.")
         ("variable-read-length"  , bpo::value<bool>(&allowVariableReadLength),
                 "Unless set, Isaac will fail if the length of the sequence changes between the records of a fastq or a bam file.")
+        ("fastq-parallel-extraction", bpo::value<bool>(&fastqParallelExtraction)->default_value(fastqParallelExtraction)->implicit_value(true),
+                "Fastq only. Parse each fastq file on its own thread into batches of records and convert the batches "
+                "on all --input-concurrent-load threads. Needs more than 2 --input-concurrent-load threads and "
+                "memory for 64K parsed records per file.")
         ("fastq-q0"  , bpo::value<char>(&fastqQ0)->default_value(fastqQ0),
                 "Character to serve as base quality 0 in fastq input.")
         ("disable-resume"     , bpo::value<bool>(&disableResume)->default_value(disableResume),
@@ -546,7 +590,9 @@ AlignOptions::AlignOptions()
         ("memory-limit,m"           , bpo::value<uint64_t>(&memoryLimit)->default_value(memoryLimit),
                 "Limits major memory consumption operations to a set number of gigabytes. "
                 "0 means no limit, however 0 is not allowed as in such case Isaac will most likely consume "
-                "all the memory on the system and cause it to crash. Default value is taken from ulimit -v.")
+                "all the memory on the system and cause it to crash. Default value is taken from ulimit -v. "
+                "Reference, hash table, tile buffers, bin buffers and bgzf buffers are accounted against this limit. "
+                "Their peak usage is reported in Stats/BuildStats.xml.")
         ("cluster,c"                , bpo::value<std::vector<std::size_t> >(&clusterIdList)->multitoken(),
                 "Restrict the alignment to the specified cluster Id (multiple entries allowed)")
         ("tls"                      , bpo::value<std::string>(&tlsString),
@@ -701,6 +747,51 @@ build::GapRealignerMode AlignOptions::parseGapRealignment()
     return build::REALIGN_NONE;
 }
 
+build::OutputFormat AlignOptions::parseOutputFormat()
+{
+    if (outputFormatString == "cram")
+    {
+        return build::OUTPUT_CRAM;
+    }
+    else if (outputFormatString != "bam")
+    {
+        const format message = format("\n   *** The 'output-format' value is invalid %s ***\n") % outputFormatString;
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+    return build::OUTPUT_BAM;
+}
+
+unsigned AlignOptions::parseBamIndexFormat()
+{
+    unsigned ret = bam::BAM_INDEX_NONE;
+    std::vector<std::string> formats;
+    boost::algorithm::split(formats, bamIndexFormatString, boost::algorithm::is_any_of(","));
+    BOOST_FOREACH(const std::string &indexFormat, formats)
+    {
+        if (indexFormat == "bai")
+        {
+            ret |= bam::BAM_INDEX_BAI;
+        }
+        else if (indexFormat == "csi")
+        {
+            ret |= bam::BAM_INDEX_CSI;
+        }
+        else
+        {
+            const format message = format("\n   *** The 'bam-index' value is invalid %s ***\n") % bamIndexFormatString;
+            BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+        }
+    }
+
+    if (!csiMinShift || bam::BinningScheme::CSI_MIN_SHIFT_MAX < csiMinShift)
+    {
+        const format message = format("\n   *** The 'csi-min-shift' must be between 1 and %d. Got: %d ***\n") %
+            unsigned(bam::BinningScheme::CSI_MIN_SHIFT_MAX) % csiMinShift;
+        BOOST_THROW_EXCEPTION(InvalidOptionException(message.str()));
+    }
+    return ret;
+}
+
 void AlignOptions::parseExecutionTargets()
 {
     const static std::vector<std::string> allowedStageStrings =
@@ -745,6 +836,25 @@ void AlignOptions::parseExecutionTargets()
         3 == stopAtPos ? workflow::AlignWorkflow::BamDone :
         4 == stopAtPos ? workflow::AlignWorkflow::Finish :
                          workflow::AlignWorkflow::Last;
+
+    // in-memory bins don't survive the end of the process
+    if (inMemoryBins &&
+        (workflow::AlignWorkflow::Start != startFrom ||
+            (workflow::AlignWorkflow::BamDone != stopAt && workflow::AlignWorkflow::Finish != stopAt)))
+    {
+        const boost::format message = boost::format(
+            "\n   *** --in-memory-bins requires --start-from Start and --stop-at Bam or Finish. Got %s and %s ***\n") %
+            startFromString % stopAtString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+
+    // with reports during bam generation the workflow goes from Align straight to Bam
+    if (reportsDuringBam && workflow::AlignWorkflow::AlignmentReportsDone == stopAt)
+    {
+        const boost::format message = boost::format(
+            "\n   *** --reports-during-bam can't stop at %s ***\n") % stopAtString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
 }
 
 void AlignOptions::parseMemoryControl()
@@ -765,6 +875,14 @@ void AlignOptions::parseMemoryControl()
         0 == memoryControlPos ? common::ScopedMallocBlock::Warning :
         1 == memoryControlPos ? common::ScopedMallocBlock::Strict : common::ScopedMallocBlock::Off;
 
+    // the allocation block is process-wide and would catch the reports generated during bam generation
+    if (reportsDuringBam && common::ScopedMallocBlock::Off != memoryControl)
+    {
+        const boost::format message = boost::format(
+            "\n   *** --reports-during-bam requires --memory-control off. Got %s ***\n") % memoryControlString;
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(message.str()));
+    }
+
     if (!memoryLimit)
     {
         const format message = format("\n   *** The 'memory-limit' option must be a positive value in gigabytes ***\n");
@@ -1053,6 +1171,10 @@ std::vector<std::pair<flowcell::Layout::Format, bool> > AlignOptions::parseBaseC
         {
             ret.push_back(std::make_pair(flowcell::Layout::BclBgzf, true));
         }
+        else if ("cbcl" == format)
+        {
+            ret.push_back(std::make_pair(flowcell::Layout::Cbcl, true));
+        }
         else if ("fastq" == format)
         {
             ret.push_back(std::make_pair(flowcell::Layout::Fastq, false));
@@ -1383,6 +1505,8 @@ void AlignOptions::postProcess(bpo::variables_map &vm)
     realignGaps = parseGapRealignment();
     std::for_each(bamHeaderTags.begin(), bamHeaderTags.end(), unescapeSlashT);
     validateSampleSheets(realignGaps, barcodeMetadataList);
+    outputFormat = parseOutputFormat();
+    bamIndexFormat = parseBamIndexFormat();
 
     parseExecutionTargets();
     parseMemoryControl();
@@ -0,0 +1,65 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BenchmarkBclTransposeOptions.cpp
+ **
+ ** Command line options for 'benchmarkBclTranspose'
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/format.hpp>
+#include <boost/thread.hpp>
+
+#include "options/BenchmarkBclTransposeOptions.hh"
+
+namespace isaac
+{
+namespace options
+{
+
+namespace bpo = boost::program_options;
+
+BenchmarkBclTransposeOptions::BenchmarkBclTransposeOptions() :
+    clusters(4000000),
+    cycles(302),
+    jobs(boost::thread::hardware_concurrency()),
+    repeat(3)
+{
+    namedOptions_.add_options()
+        ("clusters",        bpo::value<unsigned>(&clusters)->default_value(clusters),
+                "Number of clusters in the tile")
+        ("cycles",          bpo::value<unsigned>(&cycles)->default_value(cycles),
+                "Number of cycles in the tile")
+        ("jobs,j",          bpo::value<unsigned>(&jobs)->default_value(jobs),
+                "Maximum number of threads to transpose the tile with")
+        ("repeat",          bpo::value<unsigned>(&repeat)->default_value(repeat),
+                "Number of times each transpose is timed. The best time is reported")
+        ;
+}
+
+void BenchmarkBclTransposeOptions::postProcess(bpo::variables_map &vm)
+{
+    if(vm.count("help"))
+    {
+        return;
+    }
+    using isaac::common::InvalidOptionException;
+    if (!clusters || !cycles || !jobs || !repeat)
+    {
+        BOOST_THROW_EXCEPTION(InvalidOptionException(
+            "\n   *** clusters, cycles, jobs and repeat must be greater than 0 ***\n"));
+    }
+}
+
+} //namespace option
+} // namespace isaac
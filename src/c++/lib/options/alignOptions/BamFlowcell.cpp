@@ -167,8 +167,8 @@ BamFlowcellInfo BamFlowcell::parseBamFlowcellInfo(
 
     if (!laneFilePath.path_.empty())
     {
-        common::ThreadVector threads(1);
-        io::BamLoader bamLoader(0, threads, 1);
+        // metadata does not need the reference bases
+        io::BamLoader bamLoader(0, 1, io::cram::References());
         bamLoader.open(laneFilePath.path_);
 
         MetadataParser metadataParser(ret);
@@ -27,7 +27,7 @@
 #include "common/Exceptions.hh"
 #include "common/MD5Sum.hh"
 #include "common/SystemCompatibility.hh"
-#include "common/Threads.hpp"
+#include "common/TaskScheduler.hh"
 #include "reference/SortedReferenceFasta.hh"
 #include "reference/SortedReferenceXml.hh"
 
@@ -111,7 +111,7 @@ static void parseFastaThread(
 
 SortedReferenceMetadata loadReferenceMetadataFromFasta(
     const boost::filesystem::path &fastaPath,
-    common::ThreadVector &threads)
+    common::TaskScheduler &scheduler)
 {
     std::vector<char> fileContents(common::getFileSize(fastaPath.c_str()));
     std::ifstream is(fastaPath.c_str());
@@ -138,8 +138,13 @@ SortedReferenceMetadata loadReferenceMetadataFromFasta(
     std::mutex m;
     std::size_t offset = 0;
     std::size_t index = 0;
-    threads.execute([&fileContents, &m, &offset, &index, &fastaPath, &ret](unsigned threadNumber, unsigned threadsTotal)
+    common::TaskGroup parsers(scheduler);
+    for (unsigned parser = 0; parser < scheduler.getWorkers(); ++parser)
+    {
+        parsers.run([&fileContents, &m, &offset, &index, &fastaPath, &ret]()
                     {parseFastaThread(fileContents, m, offset, index, fastaPath, ret);});
+    }
+    parsers.wait();
 
     reference::SortedReferenceMetadata::Contigs &contigs = ret.getContigs();
     std::sort(contigs.begin(), contigs.end(),
@@ -0,0 +1,113 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file BclTranspose.cpp
+ **
+ ** \brief See BclTranspose.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#include "rta/BclTranspose.hh"
+
+namespace isaac
+{
+namespace rta
+{
+
+#ifdef __SSE2__
+/**
+ * \brief Transposes 16 rows of 16 bytes. Each of the four rounds interleaves the rows i and i + 8, after the
+ *        fourth round each byte is at its transposed location.
+ */
+static void transpose16x16(const char *in, const std::size_t inStride, char *out, const std::size_t outStride)
+{
+    __m128i rows[16];
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * inStride));
+    }
+    for (unsigned round = 0; round < 4; ++round)
+    {
+        __m128i interleaved[16];
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            interleaved[i * 2] = _mm_unpacklo_epi8(rows[i], rows[i + 8]);
+            interleaved[i * 2 + 1] = _mm_unpackhi_epi8(rows[i], rows[i + 8]);
+        }
+        std::copy(interleaved, interleaved + 16, rows);
+    }
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * outStride), rows[i]);
+    }
+}
+#endif // __SSE2__
+
+void transposeBcl(
+    const char *cycles,
+    const std::size_t cycleStride,
+    const unsigned cycleCount,
+    const std::size_t clusterBegin,
+    const std::size_t clusterEnd,
+    char *clusters,
+    const std::size_t clusterStride)
+{
+    std::size_t cluster = clusterBegin;
+#ifdef __SSE2__
+    while (cluster + 16 <= clusterEnd)
+    {
+        const std::size_t blockEnd = cluster + std::min(TRANSPOSE_BLOCK_CLUSTERS, (clusterEnd - cluster) & ~std::size_t(15));
+        unsigned cycle = 0;
+        for (; cycle + 16 <= cycleCount; cycle += 16)
+        {
+            for (std::size_t blockCluster = cluster; blockEnd != blockCluster; blockCluster += 16)
+            {
+                transpose16x16(cycles + cycle * cycleStride + blockCluster, cycleStride,
+                               clusters + blockCluster * clusterStride + cycle, clusterStride);
+            }
+        }
+        transposeBclStrided(cycles + cycle * cycleStride, cycleStride, cycleCount - cycle,
+                            cluster, blockEnd, clusters + cycle, clusterStride);
+        cluster = blockEnd;
+    }
+#endif // __SSE2__
+    transposeBclStrided(cycles, cycleStride, cycleCount, cluster, clusterEnd, clusters, clusterStride);
+}
+
+void transposeBclStrided(
+    const char *cycles,
+    const std::size_t cycleStride,
+    const unsigned cycleCount,
+    const std::size_t clusterBegin,
+    const std::size_t clusterEnd,
+    char *clusters,
+    const std::size_t clusterStride)
+{
+    for (std::size_t cluster = clusterBegin; clusterEnd != cluster; ++cluster)
+    {
+        char *clusterCycle = clusters + cluster * clusterStride;
+        for (unsigned cycle = 0; cycleCount != cycle; ++cycle)
+        {
+            *clusterCycle++ = cycles[cycle * cycleStride + cluster];
+        }
+    }
+}
+
+} // namespace rta
+} // namespace isaac
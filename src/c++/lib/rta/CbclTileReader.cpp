@@ -0,0 +1,237 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclTileReader.cpp
+ **
+ ** Reads tile cycles out of NovaSeq cbcl files.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <algorithm>
+#include <fstream>
+
+#include "common/Debug.hh"
+#include "common/Exceptions.hh"
+#include "rta/CbclTileReader.hh"
+
+namespace isaac
+{
+namespace rta
+{
+
+const unsigned CbclHeader::SUPPORTED_VERSION;
+const unsigned CbclHeader::QSCORE_BINS_MAX;
+const unsigned CbclHeader::TILE_RECORDS_RESERVE;
+const std::size_t CbclTileReader::DECOMPRESSOR_BUFFER_BYTES;
+
+template <typename T>
+static T readValue(std::istream &is, const boost::filesystem::path &filePath)
+{
+    T ret = 0;
+    if (!is.read(reinterpret_cast<char *>(&ret), sizeof(ret)))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(
+            errno, (boost::format("Failed to read %d bytes of cbcl header from %s") % sizeof(ret) % filePath).str()));
+    }
+    return ret;
+}
+
+void CbclHeader::read(std::istream &is, const boost::filesystem::path &filePath)
+{
+    if (!is.seekg(0))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to seek to the beginning of " + filePath.string()));
+    }
+
+    const uint16_t version = readValue<uint16_t>(is, filePath);
+    if (SUPPORTED_VERSION != version)
+    {
+        BOOST_THROW_EXCEPTION(common::UnsupportedVersionException(
+            (boost::format("Unsupported cbcl version %d in %s. Expected: %d") % version % filePath % SUPPORTED_VERSION).str()));
+    }
+    headerBytes_ = readValue<uint32_t>(is, filePath);
+
+    const unsigned bitsPerBasecall = readValue<uint8_t>(is, filePath);
+    const unsigned bitsPerQscore = readValue<uint8_t>(is, filePath);
+    if (2 != bitsPerBasecall || 2 != bitsPerQscore)
+    {
+        BOOST_THROW_EXCEPTION(common::UnsupportedVersionException(
+            (boost::format("Unsupported cbcl packing %d bits per base call, %d bits per q-score in %s. Expected 2 and 2") %
+                bitsPerBasecall % bitsPerQscore % filePath).str()));
+    }
+
+    qScores_.fill(0);
+    const unsigned bins = readValue<uint32_t>(is, filePath);
+    for (unsigned i = 0; bins > i; ++i)
+    {
+        const unsigned from = readValue<uint32_t>(is, filePath);
+        const unsigned to = readValue<uint32_t>(is, filePath);
+        if (QSCORE_BINS_MAX <= from)
+        {
+            BOOST_THROW_EXCEPTION(common::IoException(
+                EINVAL, (boost::format("Q-score bin %d is out of range in %s") % from % filePath).str()));
+        }
+        qScores_[from] = to;
+    }
+
+    tiles_.clear();
+    const unsigned tileCount = readValue<uint32_t>(is, filePath);
+    uint64_t offset = headerBytes_;
+    for (unsigned i = 0; tileCount > i; ++i)
+    {
+        TileRecord record;
+        record.tile_ = readValue<uint32_t>(is, filePath);
+        record.clusters_ = readValue<uint32_t>(is, filePath);
+        record.uncompressedBytes_ = readValue<uint32_t>(is, filePath);
+        record.compressedBytes_ = readValue<uint32_t>(is, filePath);
+        record.offset_ = offset;
+        offset += record.compressedBytes_;
+        tiles_.push_back(record);
+    }
+    nonPfClustersExcluded_ = readValue<uint8_t>(is, filePath);
+
+    for (unsigned packed = 0; byteToBcl_.size() > packed; ++packed)
+    {
+        byteToBcl_[packed] = nibbleToBcl(packed & 0x0f) | (uint16_t(nibbleToBcl(packed >> 4)) << 8);
+    }
+}
+
+const CbclHeader::TileRecord *CbclHeader::findTile(const unsigned tile) const
+{
+    const std::vector<TileRecord>::const_iterator it = std::find_if(
+        tiles_.begin(), tiles_.end(), [tile](const TileRecord &record){return tile == record.tile_;});
+    return tiles_.end() == it ? 0 : &*it;
+}
+
+CbclTileReader::CbclTileReader(const CbclTileReader &that) :
+    ignoreMissingBcls_(that.ignoreMissingBcls_),
+    ignoreMissingFilters_(that.ignoreMissingFilters_),
+    maxClusters_(that.maxClusters_),
+    decompressor_(DECOMPRESSOR_BUFFER_BYTES),
+    cbclFileBuffer_(std::ios_base::in | std::ios_base::binary),
+    filtersMapper_(that.ignoreMissingFilters_)
+{
+    reserveBuffers(that.cycleFilePath_.string().capacity());
+}
+
+CbclTileReader::CbclTileReader(
+    const std::size_t reservePathLength,
+    const bool ignoreMissingBcls,
+    const bool ignoreMissingFilters,
+    const unsigned maxClusters) :
+    ignoreMissingBcls_(ignoreMissingBcls),
+    ignoreMissingFilters_(ignoreMissingFilters),
+    maxClusters_(maxClusters),
+    decompressor_(DECOMPRESSOR_BUFFER_BYTES),
+    cbclFileBuffer_(std::ios_base::in | std::ios_base::binary),
+    filtersMapper_(ignoreMissingFilters)
+{
+    reserveBuffers(reservePathLength);
+}
+
+void CbclTileReader::reserveBuffers(const std::size_t reservePathLength)
+{
+    // ensure the paths own a buffer of maxFilePathLen capacity
+    cycleFilePath_ = std::string(reservePathLength, 'a').c_str();
+    cycleFilePath_.clear();
+    openFilePath_ = std::string(reservePathLength, 'a').c_str();
+    openFilePath_.clear();
+    filterFilePath_ = std::string(reservePathLength, 'a').c_str();
+    filterFilePath_.clear();
+    pfFilePath_ = std::string(reservePathLength, 'a').c_str();
+    pfFilePath_.clear();
+
+    packed_.reserve((maxClusters_ + 1) / 2);
+    pf_.reserve(maxClusters_);
+    filtersMapper_.reserveBuffers(reservePathLength, maxClusters_);
+}
+
+void CbclTileReader::readHeader(const boost::filesystem::path &cbclFilePath, CbclHeader &header)
+{
+    std::ifstream is(cbclFilePath.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!is)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, "Failed to open " + cbclFilePath.string()));
+    }
+    header.read(is, cbclFilePath);
+}
+
+void CbclTileReader::inflateTile(
+    std::istream &source,
+    const CbclHeader::TileRecord &record,
+    const unsigned storedClusters)
+{
+    if ((storedClusters + 1) / 2 != record.uncompressedBytes_)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+            "Tile %d in %s has %d uncompressed bytes. Expected %d for %d clusters") % record.tile_ % cycleFilePath_ %
+            record.uncompressedBytes_ % ((storedClusters + 1) / 2) % storedClusters).str()));
+    }
+
+    packed_.resize(record.uncompressedBytes_);
+    if (!record.uncompressedBytes_)
+    {
+        return;
+    }
+
+    decompressor_.reset();
+    if (!source.seekg(record.offset_))
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(errno, (boost::format("Failed to seek to position %d in %s") %
+            record.offset_ % cycleFilePath_).str()));
+    }
+    const std::streamsize inflated = decompressor_.read(source, 0, &packed_.front(), packed_.size());
+    if (std::streamsize(packed_.size()) != inflated)
+    {
+        BOOST_THROW_EXCEPTION(common::IoException(EINVAL, (boost::format(
+            "Inflated %d bytes instead of %d for tile %d in %s") % inflated % packed_.size() % record.tile_ %
+            cycleFilePath_).str()));
+    }
+}
+
+void CbclTileReader::expand(const unsigned clusters, char *bcl) const
+{
+    std::vector<char>::const_iterator packedIt = packed_.begin();
+    char *const end = bcl + clusters;
+    for (; end - bcl >= 2; bcl += 2, ++packedIt)
+    {
+        const uint16_t pair = header_.translate(*packedIt);
+        bcl[0] = pair;
+        bcl[1] = pair >> 8;
+    }
+    if (end != bcl)
+    {
+        *bcl = header_.translate(*packedIt);
+    }
+}
+
+void CbclTileReader::expandPf(char *bcl) const
+{
+    unsigned stored = 0;
+    for (const char pf : pf_)
+    {
+        if (pf & 1)
+        {
+            const uint16_t pair = header_.translate(packed_[stored / 2]);
+            *bcl++ = (stored & 1) ? pair >> 8 : pair;
+            ++stored;
+        }
+        else
+        {
+            *bcl++ = 0;
+        }
+    }
+}
+
+} // namespace rta
+} // namespace isaac
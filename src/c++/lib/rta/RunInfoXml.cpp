@@ -17,6 +17,8 @@
  ** \author Roman Petrovski
  **/
 
+#include <algorithm>
+
 #include <boost/assign.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/foreach.hpp>
@@ -70,6 +72,25 @@ std::vector<unsigned> RunInfoXml::getTiles(unsigned lane) const
 {
     std::vector<unsigned> ret;
     const ptree::ptree &flowcellLayout(get_child("RunInfo.Run.FlowcellLayout"));
+
+    // NovaSeq RunInfo.xml lists the tiles explicitly as <lane>_<tile>
+    const boost::optional<const ptree::ptree &> tiles = flowcellLayout.get_child_optional("TileSet.Tiles");
+    if (tiles)
+    {
+        const std::string lanePrefix = boost::lexical_cast<std::string>(lane) + "_";
+        BOOST_FOREACH (const boost::property_tree::ptree::value_type &tileElement, *tiles)
+        {
+            static const std::string tileElementName("Tile");
+            const std::string tileName = tileElement.second.get_value<std::string>();
+            if (tileElement.first == tileElementName && boost::starts_with(tileName, lanePrefix))
+            {
+                ret.push_back(boost::lexical_cast<unsigned>(tileName.substr(lanePrefix.size())));
+            }
+        }
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
 //    const unsigned laneCount = flowcellLayout.get<unsigned>("<xmlattr>.LaneCount");
     const unsigned surfaceCount = flowcellLayout.get<unsigned>("<xmlattr>.SurfaceCount");
     const unsigned swathCount = flowcellLayout.get<unsigned>("<xmlattr>.SwathCount");
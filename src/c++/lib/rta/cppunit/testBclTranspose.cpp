@@ -0,0 +1,157 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <string>
+#include <vector>
+
+#include "RegistryName.hh"
+#include "testBclTranspose.hh"
+
+#include "rta/BclMapper.hh"
+#include "rta/BclTranspose.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestBclTranspose, registryName("BclTranspose"));
+
+using isaac::rta::transposeBcl;
+using isaac::rta::transposeBclStrided;
+
+namespace
+{
+
+// untouched output bytes
+const char PADDING = char(0xee);
+
+/**
+ * \brief Cycle-major tile with the cycles cycleStride apart. Every byte identifies its cycle and cluster
+ */
+std::vector<char> makeCycles(const unsigned cycleCount, const std::size_t clusterCount, const std::size_t cycleStride)
+{
+    std::vector<char> ret(cycleCount * cycleStride + 1, PADDING);
+    for (unsigned cycle = 0; cycleCount != cycle; ++cycle)
+    {
+        for (std::size_t cluster = 0; clusterCount != cluster; ++cluster)
+        {
+            ret[cycle * cycleStride + cluster] = char(cycle * 31 + cluster * 7 + cluster / 256);
+        }
+    }
+    return ret;
+}
+
+/**
+ * \brief Straightforward cluster-major copy of [clusterBegin, clusterEnd)
+ */
+std::vector<char> transposeScalar(
+    const std::vector<char> &cycles, const std::size_t cycleStride, const unsigned cycleCount,
+    const std::size_t clusterBegin, const std::size_t clusterEnd, const std::size_t clusterStride,
+    const std::size_t clusterCount)
+{
+    std::vector<char> ret(clusterCount * clusterStride, PADDING);
+    for (std::size_t cluster = clusterBegin; clusterEnd != cluster; ++cluster)
+    {
+        for (unsigned cycle = 0; cycleCount != cycle; ++cycle)
+        {
+            ret[cluster * clusterStride + cycle] = cycles[cycle * cycleStride + cluster];
+        }
+    }
+    return ret;
+}
+
+void checkTranspose(
+    const unsigned cycleCount, const std::size_t clusterCount,
+    const std::size_t clusterBegin, const std::size_t clusterEnd)
+{
+    // strides that are not multiples of 16 either
+    const std::size_t cycleStride = clusterCount + 5;
+    const std::size_t clusterStride = cycleCount + 3;
+    const std::vector<char> cycles = makeCycles(cycleCount, clusterCount, cycleStride);
+    const std::vector<char> expected =
+        transposeScalar(cycles, cycleStride, cycleCount, clusterBegin, clusterEnd, clusterStride, clusterCount);
+
+    std::vector<char> clusters(expected.size(), PADDING);
+    transposeBcl(cycles.data(), cycleStride, cycleCount, clusterBegin, clusterEnd, clusters.data(), clusterStride);
+    const std::string message = "cycles " + std::to_string(cycleCount) + " clusters " +
+        std::to_string(clusterBegin) + "-" + std::to_string(clusterEnd) + " of " + std::to_string(clusterCount);
+    CPPUNIT_ASSERT_MESSAGE(message, expected == clusters);
+
+    std::fill(clusters.begin(), clusters.end(), PADDING);
+    transposeBclStrided(cycles.data(), cycleStride, cycleCount, clusterBegin, clusterEnd, clusters.data(), clusterStride);
+    CPPUNIT_ASSERT_MESSAGE(message, expected == clusters);
+}
+
+class BclMapperFixture : public isaac::rta::BclMapper
+{
+public:
+    BclMapperFixture(const unsigned cycles, const unsigned clusters) : isaac::rta::BclMapper(cycles, clusters)
+    {
+        setGeometry(cycles, clusters);
+        for (unsigned cycle = 0; cycles != cycle; ++cycle)
+        {
+            char *cycleClusters = getCycleBufferStart(cycle) + getClusterOffset(0);
+            for (unsigned cluster = 0; clusters != cluster; ++cluster)
+            {
+                cycleClusters[cluster] = char(cycle * 13 + cluster);
+            }
+        }
+    }
+};
+
+} // namespace
+
+void TestBclTranspose::setUp()
+{
+}
+
+void TestBclTranspose::tearDown()
+{
+}
+
+void TestBclTranspose::testRaggedSizes()
+{
+    const unsigned cycleCounts[] = {1, 3, 15, 16, 17, 31, 33, 151};
+    const std::size_t clusterCounts[] = {0, 1, 7, 15, 16, 17, 31, 2047, 2048 + 17, 4096 + 3};
+    for (const unsigned cycleCount : cycleCounts)
+    {
+        for (const std::size_t clusterCount : clusterCounts)
+        {
+            checkTranspose(cycleCount, clusterCount, 0, clusterCount);
+        }
+    }
+}
+
+void TestBclTranspose::testClusterRange()
+{
+    // ranges that start and end in the middle of the 16-cluster and TRANSPOSE_BLOCK_CLUSTERS blocks
+    checkTranspose(37, 5000, 5, 4990);
+    checkTranspose(16, 5000, 17, 18);
+    checkTranspose(16, 5000, 2040, 2049 + 16);
+    checkTranspose(40, 5000, 3, 3);
+}
+
+void TestBclTranspose::testBclMapper()
+{
+    const unsigned cycles = 35;
+    const unsigned clusters = 2048 + 21;
+    const BclMapperFixture mapper(cycles, clusters);
+
+    std::vector<char> transposed(cycles * clusters + 1, PADDING);
+    mapper.transpose(transposed.begin());
+    CPPUNIT_ASSERT_EQUAL(PADDING, transposed.back());
+
+    for (unsigned cluster = 0; clusters != cluster; ++cluster)
+    {
+        std::vector<char> expected;
+        mapper.get(cluster, std::back_inserter(expected));
+        CPPUNIT_ASSERT_EQUAL(std::size_t(cycles), expected.size());
+        CPPUNIT_ASSERT(std::equal(expected.begin(), expected.end(), transposed.begin() + cluster * cycles));
+    }
+}
@@ -0,0 +1,34 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_RTA_TEST_BCL_TRANSPOSE_HH
+#define iSAAC_RTA_TEST_BCL_TRANSPOSE_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestBclTranspose : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestBclTranspose );
+    CPPUNIT_TEST( testRaggedSizes );
+    CPPUNIT_TEST( testClusterRange );
+    CPPUNIT_TEST( testBclMapper );
+    CPPUNIT_TEST_SUITE_END();
+public:
+    void setUp();
+    void tearDown();
+    void testRaggedSizes();
+    void testClusterRange();
+    void testBclMapper();
+};
+
+#endif // #ifndef iSAAC_RTA_TEST_BCL_TRANSPOSE_HH
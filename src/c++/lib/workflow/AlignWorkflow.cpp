@@ -34,8 +34,10 @@
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
 #include "common/FileSystem.hh"
+#include "common/TaskScheduler.hh"
 #include "flowcell/Layout.hh"
 #include "flowcell/ReadMetadata.hh"
+#include "io/MemoryFileStore.hh"
 #include "reference/ContigLoader.hh"
 #include "reference/SortedReferenceXml.hh"
 #include "reference/SortedReferenceFasta.hh"
@@ -128,11 +130,16 @@ AlignWorkflow::AlignWorkflow(
     const unsigned inputLoadersMax,
     const unsigned tempSaversMax,
     const unsigned tempLoadersMax,
+    const bool tempLoadersAdaptive,
+    const bool tempDirectIo,
     const unsigned outputSaversMax,
     const build::GapRealignerMode realignGaps,
     const unsigned realignMapqMin,
     const boost::filesystem::path &knownIndelsPath,
     const int bamGzipLevel,
+    const build::OutputFormat outputFormat,
+    const unsigned bamIndexFormat,
+    const unsigned csiMinShift,
     const std::string &bamPuFormat,
     const bool bamProduceMd5,
     const std::vector<std::string> &bamHeaderTags,
@@ -151,7 +158,9 @@ AlignWorkflow::AlignWorkflow(
     const boost::array<char, 256> &fullBclQScoreTable,
     const OptionalFeatures optionalFeatures,
     const bool pessimisticMapQ,
-    const unsigned detectTemplateBlockSize)
+    const unsigned detectTemplateBlockSize,
+    const bool reportsDuringBam,
+    const bool fastqParallelExtraction)
     : argv_(argv)
     , description_(description)
     , hashTableBucketCount_(hashTableBucketCount)
@@ -186,11 +195,6 @@ AlignWorkflow::AlignWorkflow(
         flowcell::getMaxReadLength(flowcellLayoutList_),
         flowcell::getMaxClusterName(flowcellLayoutList_)))
     , expectedBgzfCompressionRatio_(expectedBgzfCompressionRatio)
-    , targetFragmentsPerBin_(targetBinSize ?
-        targetBinSize / estimatedFragmentSize_ :
-        build::Build::estimateOptimumFragmentsPerBin(estimatedFragmentSize_, availableMemory_, expectedBgzfCompressionRatio_, coresMax_))
-    , targetBinLength_(targetFragmentsPerBin_ / expectedCoverage_ * flowcell::getMaxReadLength(flowcellLayoutList_))
-    , targetBinSize_(targetBinSize ? targetBinSize : targetFragmentsPerBin_ * estimatedFragmentSize_)
     , clustersAtATimeMax_(clustersAtATimeMax)
     , mapqThreshold_(mapqThreshold)
     , perTileTls_(perTileTls)
@@ -219,11 +223,16 @@ AlignWorkflow::AlignWorkflow(
     , inputLoadersMax_(inputLoadersMax)
     , tempSaversMax_(tempSaversMax)
     , tempLoadersMax_(tempLoadersMax)
+    , tempLoadersAdaptive_(tempLoadersAdaptive)
+    , tempDirectIo_(tempDirectIo)
     , outputSaversMax_(outputSaversMax)
     , realignGaps_(realignGaps)
     , realignMapqMin_(realignMapqMin)
     , knownIndelsPath_(knownIndelsPath)
     , bamGzipLevel_(bamGzipLevel)
+    , outputFormat_(outputFormat)
+    , bamIndexFormat_(bamIndexFormat)
+    , csiMinShift_(csiMinShift)
     , bamPuFormat_(bamPuFormat)
     , bamProduceMd5_(bamProduceMd5)
     , bamHeaderTags_(bamHeaderTags)
@@ -241,15 +250,29 @@ AlignWorkflow::AlignWorkflow(
     , demultiplexingStatsXmlPath_(statsDirectory_ / "DemultiplexingStats.xml")
     , statsImageFormat_(statsImageFormat)
     , referenceMetadataList_(referenceMetadataList)
-    , sortedReferenceMetadataList_(loadSortedReferenceXml(referenceMetadataList, coresMax_))
+    , sortedReferenceMetadataList_(loadSortedReferenceXml(referenceMetadataList))
+    , referenceMemory_(common::MemoryBudget::Reference, reference::NumaContigLists::estimateMemoryFootprint(
+        sortedReferenceMetadataList_, flowcell::getMaxReadLength(flowcellLayoutList_)))
     , contigLists_(reference::loadContigs(sortedReferenceMetadataList_, flowcell::getMaxReadLength(flowcellLayoutList_),
-                                          AllowAllContigFilter(), DecoyContigFinder(decoyRegexString), common::ThreadVector(inputLoadersMax_)))
+                                          AllowAllContigFilter(), DecoyContigFinder(decoyRegexString), inputLoadersMax_))
+    , targetFragmentsPerBin_(targetBinSize ?
+        targetBinSize / estimatedFragmentSize_ :
+        build::Build::estimateOptimumFragmentsPerBin(
+            estimatedFragmentSize_,
+            availableMemory_ - std::min(availableMemory_, common::MemoryBudget::instance().getReserved()),
+            expectedBgzfCompressionRatio_, coresMax_))
+    , targetBinLength_(targetFragmentsPerBin_ / expectedCoverage_ * flowcell::getMaxReadLength(flowcellLayoutList_))
+    , targetBinSize_(targetBinSize ? targetBinSize : targetFragmentsPerBin_ * estimatedFragmentSize_)
     , state_(Start)
       // dummy initialization. Will be replaced with real object once match finding is over
     , foundMatchesMetadata_(tempDirectory_, barcodeMetadataList_, 0, sortedReferenceMetadataList_)
     , barcodeTemplateLengthStatistics_(barcodeMetadataList_.size())
     , detectTemplateBlockSize_(detectTemplateBlockSize)
+    , reportsDuringBam_(reportsDuringBam)
+    , fastqParallelExtraction_(fastqParallelExtraction)
 {
+    referenceMemory_.resize(contigLists_.getMemoryFootprint());
+
     ISAAC_THREAD_CERR << "Aligner: expectedCoverage_ " << expectedCoverage_ << std::endl;
     ISAAC_THREAD_CERR << "Aligner: estimatedFragmentSize_ " << estimatedFragmentSize_ << std::endl;
     ISAAC_THREAD_CERR << "Aligner: targetFragmentsPerBin_ " << targetFragmentsPerBin_ << std::endl;
@@ -266,24 +289,26 @@ AlignWorkflow::AlignWorkflow(
     }
 }
 
+/**
+ * \brief References are loaded concurrently. Parsing of fasta references is split further over the workers of
+ *        the process-wide scheduler.
+ */
 reference::SortedReferenceMetadataList AlignWorkflow::loadSortedReferenceXml(
-    const reference::ReferenceMetadataList &referenceMetadataList,
-    const unsigned coresMax)
+    const reference::ReferenceMetadataList &referenceMetadataList)
 {
-    reference::SortedReferenceMetadataList ret;
-    ret.reserve(referenceMetadataList.size());
-    for(const reference::ReferenceMetadata &reference : referenceMetadataList)
+    reference::SortedReferenceMetadataList ret(referenceMetadataList.size());
+    common::TaskGroup loaders;
+    for (std::size_t referenceIndex = 0; referenceIndex < referenceMetadataList.size(); ++referenceIndex)
     {
-        if (reference.isXml())
-        {
-            ret.push_back(reference::loadReferenceMetadataFromXml(reference.getPath()));
-        }
-        else
+        loaders.run([&referenceMetadataList, &ret, referenceIndex]()
         {
-            common::ThreadVector threads(coresMax);
-            ret.push_back(reference::loadReferenceMetadataFromFasta(reference.getPath(), threads));
-        }
+            const reference::ReferenceMetadata &reference = referenceMetadataList.at(referenceIndex);
+            ret.at(referenceIndex) = reference.isXml() ?
+                reference::loadReferenceMetadataFromXml(reference.getPath()) :
+                reference::loadReferenceMetadataFromFasta(reference.getPath(), common::TaskScheduler::instance());
+        });
     }
+    loaders.wait();
     return ret;
 }
 
@@ -337,7 +362,8 @@ void AlignWorkflow::findMatches(
         preSortBins_,
         preAllocateBins_,
         binRegexString_,
-        detectTemplateBlockSize_);
+        detectTemplateBlockSize_,
+        fastqParallelExtraction_);
 
     findMatchesTransition.perform(seedLength_, foundMatches, binMetadataList, barcodeTemplateLengthStatistics, matchSelectorStatsXmlPath_);
 }
@@ -378,8 +404,8 @@ const demultiplexing::BarcodePathMap AlignWorkflow::generateBam(
                        sortedReferenceMetadataList_,
                        contigLists_.node0Container(),
                        projectsDirectory_,
-                       tempLoadersMax_, coresMax_, outputSaversMax_, realignGaps_, realignMapqMin_, knownIndelsPath_,
-                       bamGzipLevel_, bamPuFormat_, bamProduceMd5_, bamHeaderTags_, expectedCoverage_, targetBinSize_, expectedBgzfCompressionRatio_, singleLibrarySamples_,
+                       tempLoadersMax_, coresMax_, outputSaversMax_, tempLoadersAdaptive_, tempDirectIo_, realignGaps_, realignMapqMin_, knownIndelsPath_,
+                       bamGzipLevel_, outputFormat_, bamIndexFormat_, csiMinShift_, bamPuFormat_, bamProduceMd5_, bamHeaderTags_, expectedCoverage_, targetBinSize_, expectedBgzfCompressionRatio_, singleLibrarySamples_,
                        keepDuplicates_, markDuplicates_, anchorMate_,
                        realignGapsVigorously_, realignDodgyFragments_, realignedGapsPerFragment_,
                        clipSemialigned_, alignmentCfg_,
@@ -404,18 +430,38 @@ const demultiplexing::BarcodePathMap AlignWorkflow::generateBam(
         build.run(mallocBlock);
     }
     build.dumpStats(statsDirectory_ / "BuildStats.xml");
+    // bins that were kept in memory are not needed anymore
+    io::MemoryFileStore::instance().clear();
     ISAAC_THREAD_CERR << "Generating the BAM files done" << std::endl;
     return build.getBarcodeBamMapping();
 }
 
+/**
+ * \brief Bam generation does not depend on the alignment reports. Reports are generated by a worker of the
+ *        process-wide scheduler while bam files are being generated.
+ *
+ * Build itself can't start before the alignment is over. Bins cover genomic ranges and receive fragments from all
+ * lanes and tiles, so no bin is complete until the last tile is aligned.
+ */
+void AlignWorkflow::generateBamWithAlignmentReports()
+{
+    common::TaskGroup reports;
+    reports.run([this](){generateAlignmentReports();});
+    barcodeBamMapping_ = generateBam(selectedMatchesMetadata_, barcodeTemplateLengthStatistics_);
+    reports.wait();
+}
+
 void AlignWorkflow::run()
 {
     ISAAC_ASSERT_MSG(Start == state_, "Unexpected state");
     step();
     ISAAC_ASSERT_MSG(AlignDone == state_, "Unexpected state");
     step();
-    ISAAC_ASSERT_MSG(AlignmentReportsDone == state_, "Unexpected state");
-    step();
+    if (!reportsDuringBam_)
+    {
+        ISAAC_ASSERT_MSG(AlignmentReportsDone == state_, "Unexpected state");
+        step();
+    }
     ISAAC_ASSERT_MSG(BamDone == state_, "Unexpected state");
 }
 
@@ -429,7 +475,7 @@ AlignWorkflow::State AlignWorkflow::getNextState() const
     }
     case AlignDone:
     {
-        return AlignmentReportsDone;
+        return reportsDuringBam_ ? BamDone : AlignmentReportsDone;
     }
     case AlignmentReportsDone:
     {
@@ -460,7 +506,14 @@ AlignWorkflow::State AlignWorkflow::step()
     }
     case AlignDone:
     {
-        generateAlignmentReports();
+        if (reportsDuringBam_)
+        {
+            generateBamWithAlignmentReports();
+        }
+        else
+        {
+            generateAlignmentReports();
+        }
         state_ = getNextState();
         break;
     }
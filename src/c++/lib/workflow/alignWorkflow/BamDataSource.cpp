@@ -141,9 +141,17 @@ unsigned BamClusterLoader::loadClusters(
         loadSingleReads(clusterCount, nameLengthMax, readMetadataList, clusterIt, pfIt);
 }
 
+// cram typically is this many times smaller than bam of the same data
+static const std::size_t CRAM_COMPRESSION_ADVANTAGE = 2;
+
+/**
+ * \return the size of the bam file that would hold the same data
+ */
 inline std::size_t getBamFileSize(const flowcell::Layout &flowcell)
 {
-    return common::getFileSize(flowcell.getAttribute<flowcell::Layout::Bam, flowcell::BamFilePathAttributeTag>().c_str());
+    const boost::filesystem::path &path = flowcell.getAttribute<flowcell::Layout::Bam, flowcell::BamFilePathAttributeTag>();
+    const std::size_t fileSize = common::getFileSize(path.c_str());
+    return io::cram::isCram(path) ? fileSize * CRAM_COMPRESSION_ADVANTAGE : fileSize;
 }
 
 BamBaseCallsSource::BamBaseCallsSource(
@@ -153,6 +161,7 @@ BamBaseCallsSource::BamBaseCallsSource(
     const bool cleanupIntermediary,
     const unsigned coresMax,
     const flowcell::Layout &bamFlowcellLayout,
+    const io::cram::References &references,
     common::ThreadVector &threads) :
         bamFlowcellLayout_(bamFlowcellLayout),
         bamPath_(bamFlowcellLayout_.getAttribute<flowcell::Layout::Bam, flowcell::BamFilePathAttributeTag>()),
@@ -163,11 +172,12 @@ BamBaseCallsSource::BamBaseCallsSource(
         currentTile_(0),
         threads_(threads),
         bamClusterLoader_(
-            cleanupIntermediary, 0, threads, coresMax, tempDirectoryPath,
+            cleanupIntermediary, 0, threads, coresMax, references, tempDirectoryPath,
             getBamFileSize(bamFlowcellLayout_), bamFlowcellLayout.getFlowcellId().length(),
             bamFlowcellLayout_.getReadNameLength(),
             flowcell::getTotalReadLength(bamFlowcellLayout.getReadMetadataList()),
-            flowcell::getMinReadLength(bamFlowcellLayout.getReadMetadataList()))
+            flowcell::getMinReadLength(bamFlowcellLayout.getReadMetadataList()),
+            availableMemory / UNPAIRED_MEMORY_FRACTION)
 {
 }
 
@@ -17,6 +17,8 @@
  ** \author Roman Petrovski
  **/
 
+#include <chrono>
+
 #include <boost/foreach.hpp>
 
 #include "workflow/alignWorkflow/BclBgzfDataSource.hh"
@@ -234,8 +236,29 @@ void BclBgzfBaseCallsSource::loadClusters(
         currentLaneNumber_ = tileMetadata.getLane();
     }
 
+    for (rta::BclBgzfTileReader &reader : threadReaders_)
+    {
+        reader.resetLoadStats();
+    }
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     bclMapper_.mapTile(flowcell_, tileMetadata);
-    ISAAC_THREAD_CERR << "Loading Bcl data done for " << tileMetadata << std::endl;
+    const uint64_t microseconds = std::max<uint64_t>(1, std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    rta::BclBgzfTileReader::LoadStats stats;
+    // busy time is relative to the threads that got cycles to load. Tiles with few cycles leave some idle.
+    unsigned busyReaders = 0;
+    for (const rta::BclBgzfTileReader &reader : threadReaders_)
+    {
+        stats += reader.getLoadStats();
+        if (reader.getLoadStats().tileCycles_)
+        {
+            ++busyReaders;
+        }
+    }
+    ISAAC_THREAD_CERR << "Loading Bcl data done for " << tileMetadata << " " << stats.tileCycles_ << " cycles " <<
+        stats.compressedBytes_ << " compressed bytes in " << microseconds / 1000 << "ms (" <<
+        stats.compressedBytes_ / microseconds << "MB/s), " << busyReaders << " loader threads busy " <<
+        stats.microseconds_ * 100 / (microseconds * std::max(1U, busyReaders)) << "%" << std::endl;
 
     ISAAC_THREAD_CERR << "Loading Filter data for " << tileMetadata << std::endl;
     flowcell_.getLaneAttribute<flowcell::Layout::BclBgzf, flowcell::FiltersFilePathAttributeTag>(tileMetadata.getLane(), filterFilePath_);
@@ -0,0 +1,212 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file CbclDataSource.cpp
+ **
+ ** \brief see CbclDataSource.hh
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <boost/foreach.hpp>
+
+#include "workflow/alignWorkflow/CbclDataSource.hh"
+
+namespace isaac
+{
+namespace workflow
+{
+namespace alignWorkflow
+{
+
+/////////////// CbclBaseCallsSource Implementation
+CbclBaseCallsSource::CbclBaseCallsSource(
+    const flowcell::Layout &flowcell,
+    const bool ignoreMissingBcls,
+    const bool ignoreMissingFilters,
+    common::ThreadVector &bclLoadThreads,
+    const unsigned inputLoadersMax,
+    const bool extractClusterXy):
+    flowcell_(flowcell),
+    bclLoadThreads_(bclLoadThreads),
+    filterFilePath_(flowcell_.getLongestAttribute<flowcell::Layout::Cbcl, flowcell::FiltersFilePathAttributeTag>()),
+    positionsFilePath_(flowcell_.getLongestAttribute<flowcell::Layout::Cbcl, flowcell::PositionsFilePathAttributeTag>()),
+    flowcellTiles_(getTiles(flowcell)),
+    undiscoveredTiles_(flowcellTiles_.begin()),
+    threadReaders_(
+        bclLoadThreads_.size(),
+        rta::CbclTileReader(
+            std::max(flowcell_.getLongestAttribute<flowcell::Layout::Cbcl, flowcell::BclFilePathAttributeTag>().string().size(),
+                     filterFilePath_.string().size()),
+            ignoreMissingBcls,
+            ignoreMissingFilters,
+            flowcell::getMaxTileClusters(flowcellTiles_))),
+    bclMapper_(flowcell::getTotalReadLength(flowcell_.getReadMetadataList()) + flowcell_.getBarcodeLength(),
+               bclLoadThreads_, threadReaders_,
+               inputLoadersMax, flowcell::getMaxTileClusters(flowcellTiles_)),
+    filtersMapper_(ignoreMissingFilters),
+    locsMapper_(),
+    barcodeLoader_(bclLoadThreads, inputLoadersMax, flowcell_.getBarcodeLength() ? flowcell::getMaxTileClusters(flowcellTiles_) : 0, threadReaders_)
+{
+    filtersMapper_.reserveBuffers(filterFilePath_.string().size(), flowcell::getMaxTileClusters(flowcellTiles_));
+
+    if (extractClusterXy)
+    {
+        locsMapper_.reserveBuffers(positionsFilePath_.string().size(), flowcell::getMaxTileClusters(flowcellTiles_));
+    }
+}
+
+flowcell::TileMetadataList CbclBaseCallsSource::discoverTiles()
+{
+    flowcell::TileMetadataList ret;
+    while (flowcellTiles_.end() != undiscoveredTiles_)
+    {
+        ret.push_back(*undiscoveredTiles_);
+        if (ret.front().getLane() != ret.back().getLane())
+        {
+            ret.pop_back();
+            break;
+        }
+        ++undiscoveredTiles_;
+    }
+    return ret;
+}
+
+flowcell::TileMetadataList CbclBaseCallsSource::getTiles(const flowcell::Layout &flowcellLayout)
+{
+    flowcell::TileMetadataList tileMetadataList;
+
+    const std::string &flowcellId = flowcellLayout.getFlowcellId();
+    const unsigned firstCycle = flowcellLayout.getDataCycles().front();
+    rta::CbclHeader header;
+    boost::filesystem::path headerFilePath;
+    boost::filesystem::path cbclFilePath;
+    BOOST_FOREACH(const unsigned int lane, flowcellLayout.getLaneIds())
+    {
+        unsigned tilesFound = 0;
+        BOOST_FOREACH(const unsigned int tile, flowcellLayout.getTileIds(lane))
+        {
+            // all tiles of a surface share the same cbcl file
+            flowcellLayout.getLaneTileCycleAttribute<flowcell::Layout::Cbcl, flowcell::BclFilePathAttributeTag>(
+                lane, tile, firstCycle, cbclFilePath);
+            if (headerFilePath != cbclFilePath)
+            {
+                if (!boost::filesystem::exists(cbclFilePath))
+                {
+                    ISAAC_THREAD_CERR << "WARNING: Cbcl file not found: " << cbclFilePath << std::endl;
+                    continue;
+                }
+                rta::CbclTileReader::readHeader(cbclFilePath, header);
+                headerFilePath = cbclFilePath;
+            }
+
+            const unsigned clusterCount = rta::CbclTileReader::getTileClusterCount(flowcellLayout, header, lane, tile);
+            if (clusterCount)
+            {
+                const flowcell::TileMetadata tileMetadata(
+                    flowcellId, flowcellLayout.getIndex(),
+                    tile, lane,
+                    clusterCount,
+                    tileMetadataList.size());
+                tileMetadataList.push_back(tileMetadata);
+                ++tilesFound;
+                ISAAC_THREAD_CERR << tileMetadata << std::endl;
+            }
+        }
+        if (!tilesFound)
+        {
+            ISAAC_THREAD_CERR << "WARNING: No tiles found for lane " << lane << std::endl;
+        }
+    }
+
+    if (tileMetadataList.empty())
+    {
+        BOOST_THROW_EXCEPTION(common::InvalidOptionException(std::string("No tile data found for flowcell ") + boost::lexical_cast<std::string>(flowcellLayout)));
+    }
+
+    return tileMetadataList;
+}
+
+// BarcodeSource implementation
+void CbclBaseCallsSource::loadBarcodes(
+    const flowcell::Layout &flowcell,
+    const unsigned unknownBarcodeIndex,
+    const flowcell::TileMetadataList &tiles,
+    demultiplexing::Barcodes &barcodes)
+{
+    barcodeLoader_.loadBarcodes(unknownBarcodeIndex, flowcell, tiles, barcodes);
+}
+
+void CbclBaseCallsSource::loadClusters(
+    const flowcell::TileMetadata &tileMetadata,
+    alignment::BclClusters &bclData)
+{
+    ISAAC_THREAD_CERR << "Loading Cbcl data for " << tileMetadata << std::endl;
+    const clock_t startLoad = clock();
+    bclMapper_.mapTile(flowcell_, tileMetadata);
+    ISAAC_THREAD_CERR << "Loading Cbcl data done for " << tileMetadata << " in " << (clock() - startLoad) / 1000 << "ms" << std::endl;
+
+    ISAAC_THREAD_CERR << "Loading Filter data for " << tileMetadata << std::endl;
+    flowcell_.getLaneTileAttribute<flowcell::Layout::Cbcl, flowcell::FiltersFilePathAttributeTag>(
+        tileMetadata.getLane(), tileMetadata.getTile(), filterFilePath_);
+    filtersMapper_.mapTile(filterFilePath_, tileMetadata.getClusterCount());
+    ISAAC_THREAD_CERR << "Loading Filter data done for " << tileMetadata << std::endl;
+
+    if (bclData.storeXy())
+    {
+        ISAAC_THREAD_CERR << "Loading Positions data for " << tileMetadata << std::endl;
+        flowcell_.getLaneAttribute<flowcell::Layout::Cbcl, flowcell::PositionsFilePathAttributeTag>(
+            tileMetadata.getLane(), positionsFilePath_);
+        // patterned flowcell. Every tile has the same cluster positions
+        locsMapper_.mapTile(positionsFilePath_, tileMetadata.getClusterCount(), 0);
+        ISAAC_THREAD_CERR << "Loading Positions data done for " << tileMetadata << std::endl;
+    }
+
+    bclToClusters(tileMetadata, bclData);
+}
+
+void CbclBaseCallsSource::resetBclData(
+    const flowcell::TileMetadata& tileMetadata,
+    alignment::BclClusters& bclData) const
+{
+    ISAAC_THREAD_CERR<< "Resetting Bcl data for " << tileMetadata.getClusterCount() << " bcl clusters" << std::endl;
+    bclData.reset(bclMapper_.getCyclesCount(), tileMetadata.getClusterCount(), true);
+    ISAAC_THREAD_CERR << "Resetting Bcl data done for " << bclData.getClusterCount() << " bcl clusters" << std::endl;
+}
+
+void CbclBaseCallsSource::bclToClusters(
+    const flowcell::TileMetadata &tileMetadata,
+    alignment::BclClusters &bclData) const
+{
+    ISAAC_THREAD_CERR << "Transposing Bcl data for " << tileMetadata.getClusterCount() << " bcl clusters" << std::endl;
+    const clock_t startTranspose = clock();
+    bclMapper_.transpose(bclData.addMoreClusters(tileMetadata.getClusterCount()));
+    ISAAC_THREAD_CERR << "Transposing Bcl data done for " << bclData.getClusterCount() << " bcl clusters in " << (clock() - startTranspose) / 1000 << "ms" << std::endl;
+
+    ISAAC_THREAD_CERR << "Extracting Pf values for " << tileMetadata.getClusterCount() << " bcl clusters" << std::endl;
+    filtersMapper_.getPf(std::back_inserter(bclData.pf()));
+
+    ISAAC_ASSERT_MSG(bclData.pf().size() == bclData.getClusterCount(), "Mismatch between data " << bclData.getClusterCount() << " and pf " << bclData.pf().size() << "counts");
+    ISAAC_THREAD_CERR << "Extracting Pf values done for " << bclData.getClusterCount() << " bcl clusters" << std::endl;
+
+    if (bclData.storeXy())
+    {
+        ISAAC_THREAD_CERR << "Extracting Positions values for " << tileMetadata.getClusterCount() << " bcl clusters" << std::endl;
+        locsMapper_.getPositions(std::back_inserter(bclData.xy()));
+        ISAAC_ASSERT_MSG(bclData.xy().size() == bclData.getClusterCount(), "Mismatch between data " << bclData.getClusterCount() << " and position " << bclData.xy().size() << "counts");
+        ISAAC_THREAD_CERR << "Extracting Positions values done for " << bclData.getClusterCount() << " bcl clusters" << std::endl;
+    }
+}
+
+} // namespace alignWorkflow
+} // namespace workflow
+} // namespace isaac
@@ -52,7 +52,8 @@ FastqBaseCallsSource::FastqBaseCallsSource(
     const unsigned coresMax,
     const flowcell::BarcodeMetadataList &barcodeMetadataList,
     const flowcell::Layout &fastqFlowcellLayout,
-    common::ThreadVector &threads) :
+    common::ThreadVector &threads,
+    const bool parallelExtraction) :
         tileClustersMax_(clustersAtATimeMax),
         coresMax_(coresMax),
         fastqFlowcellLayout_(fastqFlowcellLayout),
@@ -61,7 +62,7 @@ FastqBaseCallsSource::FastqBaseCallsSource(
         loadingClusters_(clusterLength_),
         lanes_(fastqFlowcellLayout.getLaneIds()),
         loadingLaneIterator_(lanes_.begin()),
-        fastqLoader_(fastqFlowcellLayout_.getAttribute<flowcell::Layout::Fastq, flowcell::FastqVariableLengthOk>(), 0, threads, coresMax_)
+        fastqLoader_(fastqFlowcellLayout_.getAttribute<flowcell::Layout::Fastq, flowcell::FastqVariableLengthOk>(), 0, threads, coresMax_, parallelExtraction)
 {
     loadedClusters_.reset(clusterLength_, tileClustersMax_);
     // reserve space.
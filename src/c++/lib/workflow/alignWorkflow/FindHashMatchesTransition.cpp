@@ -25,6 +25,7 @@
 #include "build/Build.hh"
 #include "common/Debug.hh"
 #include "common/Exceptions.hh"
+#include "common/MemoryBudget.hh"
 #include "common/Numa.hh"
 #include "demultiplexing/DemultiplexingStatsXml.hh"
 #include "flowcell/Layout.hh"
@@ -32,6 +33,7 @@
 #include "workflow/alignWorkflow/BamDataSource.hh"
 #include "workflow/alignWorkflow/BclBgzfDataSource.hh"
 #include "workflow/alignWorkflow/BclDataSource.hh"
+#include "workflow/alignWorkflow/CbclDataSource.hh"
 #include "workflow/alignWorkflow/MultiTileDataSource.hh"
 #include "workflow/alignWorkflow/FastqDataSource.hh"
 #include "workflow/alignWorkflow/FindHashMatchesTransition.hh"
@@ -248,7 +250,8 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     const bool preSortBins,
     const bool preAllocateBins,
     const std::string &binRegexString,
-    const unsigned detectTemplateBlockSize
+    const unsigned detectTemplateBlockSize,
+    const bool fastqParallelExtraction
     )
     : hashTableBucketCount_(hashTableBucketCount)
     , flowcellLayoutList_(flowcellLayoutList)
@@ -276,6 +279,7 @@ FindHashMatchesTransition::FindHashMatchesTransition(
     , clusterIdList_(clusterIdList)
     , sortedReferenceMetadataList_(sortedReferenceMetadataList)
     , extractClusterXy_(extractClusterXy)
+    , fastqParallelExtraction_(fastqParallelExtraction)
     , debugAlignments_(true)
     , maxGapsPerRead_(std::max<unsigned>(smitWatermanGapsMax, splitAlignments))
     , targetBinLength_(targetBinLength)
@@ -440,7 +444,7 @@ void FindHashMatchesTransition::resolveBarcodes(
             ISAAC_ASSERT_MSG(barcodeGroup.size(), "Barcode list must be not empty");
             ISAAC_ASSERT_MSG(barcodeGroup.at(0).isDefault(), "The very first barcode must be the 'unknown indexes or no index' one");
             barcodeSource.loadBarcodes(flowcell, barcodeGroup.at(0).getIndex(), currentTiles, barcodes);
-            barcodeResolver.resolve(barcodes, demultiplexingStats);
+            barcodeResolver.resolve(threads_, coresMax_, barcodes, demultiplexingStats);
 
             BOOST_FOREACH(const demultiplexing::Barcode &barcode, barcodes)
             {
@@ -619,6 +623,10 @@ void FindHashMatchesTransition::processFlowcellTiles(
     forceTermination_ = false;
 
     ISAAC_TRACE_STAT("FindHashMatchesTransition::findLaneMatches before threads allocation")
+    const common::MemoryReservation tileMemory(
+        common::MemoryBudget::TileBuffers,
+        uint64_t(ioOverlapThreads_.size()) * dataSource.getMaxTileClusters() *
+        (flowcell::getTotalReadLength(flowcell.getReadMetadataList()) + flowcell.getBarcodeLength() + flowcell.getReadNameLength()));
     std::vector<findHashMatchesTransition::IoOverlapThreadWorker> ioOverlapThreadWorkers(
         ioOverlapThreads_.size(),
         findHashMatchesTransition::IoOverlapThreadWorker(
@@ -665,6 +673,22 @@ void FindHashMatchesTransition::processFlowcellTiles(
     }
 }
 
+/**
+ * \brief Contigs of all references for decoding cram input. The bases remain owned by contigLists.
+ */
+static io::cram::References makeCramReferences(const reference::ContigLists &contigLists)
+{
+    io::cram::References ret;
+    for (const reference::ContigList &contigList : contigLists)
+    {
+        for (const reference::Contig &contig : contigList)
+        {
+            ret.push_back(io::cram::Reference(contig.getName(), contig.size(), contig.empty() ? 0 : &*contig.begin()));
+        }
+    }
+    return ret;
+}
+
 template <typename ReferenceHashT>
 void FindHashMatchesTransition::alignFlowcells(
     const ReferenceHashT &referenceHash,
@@ -680,6 +704,7 @@ void FindHashMatchesTransition::alignFlowcells(
         {
             case flowcell::Layout::Bam:
             {
+                const io::cram::References cramReferences = makeCramReferences(contigLists_.node0Container());
                 BackgroundBamBaseCallsSource dataSource(
                     tempDirectory_,
                     availableMemory_,
@@ -690,7 +715,7 @@ void FindHashMatchesTransition::alignFlowcells(
                     // On the other hand, there might be a need to limit the io to 1 thread, while allowing
                     // for the multithreaded processing of other cpu-demanding things.
                     std::min(inputLoadersMax_, coresMax_),
-                    flowcell, threads_);
+                    flowcell, cramReferences, threads_);
                 processFlowcellTiles(referenceHash, flowcell, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
             }
@@ -702,7 +727,8 @@ void FindHashMatchesTransition::alignFlowcells(
                     coresMax_,
                     barcodeMetadataList_,
                     flowcell,
-                    threads_);
+                    threads_,
+                    fastqParallelExtraction_);
 
                 processFlowcellTiles(referenceHash, flowcell, dataSource, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
                 break;
@@ -732,6 +758,17 @@ void FindHashMatchesTransition::alignFlowcells(
                 break;
             }
 
+            case flowcell::Layout::Cbcl:
+            {
+                CbclBaseCallsSource baseCalls(
+                    flowcell, ignoreMissingBcls_, ignoreMissingFilters_, threads_, inputLoadersMax_, extractClusterXy_);
+                MultiTileBaseCallsSource<CbclBaseCallsSource> multitileBaseCalls(
+                    bclTilesPerChunk_, flowcell, baseCalls);
+
+                processFlowcellTiles(referenceHash, flowcell, multitileBaseCalls, demultiplexingStats, barcodeTemplateLengthStatistics, foundMatches, fragmentStorage);
+                break;
+            }
+
             default:
             {
                 ISAAC_ASSERT_MSG(false, "Unexpected flowcell format " << flowcell.getFormat());
@@ -786,8 +823,12 @@ void FindHashMatchesTransition::align(
 //    const NumaReferenceHash referenceHash(buildReferenceHash<ReferenceHash>(contigLists_.node0Container().front(), threads_, coresMax_));
 
     typedef reference::ReferenceHash<KmerT, common::NumaAllocator<void, common::numa::defaultNodeInterleave> > ReferenceHash;
+    // take the budget before building the hash so that running out of memory is reported before it happens
+    common::MemoryReservation hashMemory(common::MemoryBudget::Hash, ReferenceHash::estimateMemoryFootprint(
+        hashTableBucketCount_, contigLists_.node0Container().front().endOffset()));
     const ReferenceHash referenceHash(buildReferenceHash<ReferenceHash>(
         contigLists_.node0Container().front(), hashTableBucketCount_, threads_, coresMax_));
+    hashMemory.resize(referenceHash.getMemoryFootprint());
 
     FoundMatchesMetadata ret(tempDirectory_, barcodeMetadataList_, 1, sortedReferenceMetadataList_);
     demultiplexing::DemultiplexingStats demultiplexingStats(flowcellLayoutList_, barcodeMetadataList_);
@@ -34,6 +34,8 @@ namespace alignWorkflow
 namespace bamDataSource
 {
 
+const std::size_t UnpairedReadsCache::BUCKET_BYTES_MIN;
+
 void TempFileClusterExtractor::open(const boost::filesystem::path &tempFilePath, std::streamsize expectedFileSize)
 {
     if (tempFilePath_ != tempFilePath.c_str())
@@ -99,8 +101,8 @@ void UnpairedReadsCache::storeUnpaired(
         extractReadName(block, maxReadNameLength_, readMetadata, std::back_inserter(byteBuff));
         ISAAC_ASSERT_MSG(byteBuff.size() == maxReadNameLength_, "Invalid number of name bytes extracted");
         byteBuff.push_back(0);// 0 terminator is needed for name comparison during extraction
-        const unsigned nameCrc = getNameCrc<7>(crcWidth_, byteBuff.begin(), maxReadNameLength_);
-        std::ostream os(tempFiles_[nameCrc].get());
+        const unsigned bucket = getNameBucket(byteBuff.begin(), maxReadNameLength_);
+        std::ostream os(tempFiles_[bucket].get());
 
         const TempFileClusterExtractor::FlagsType flags =
             (block.isReadOne() ? TempFileClusterExtractor::READ_ONE_FLAG : 0) |
@@ -109,23 +111,23 @@ void UnpairedReadsCache::storeUnpaired(
         if (!os.write(reinterpret_cast<const char*>(&recordLength), sizeof(unsigned)))
         {
             BOOST_THROW_EXCEPTION(isaac::common::IoException(
-                errno, (boost::format("Failed to write: %d bytes into %s") % sizeof(unsigned) % common::pathStringToStdString(tempFilePaths_[nameCrc])).str()));
+                errno, (boost::format("Failed to write: %d bytes into %s") % sizeof(unsigned) % common::pathStringToStdString(tempFilePaths_[bucket])).str()));
         }
-        tempFileSizes_[nameCrc] += sizeof(unsigned);
+        tempFileSizes_[bucket] += sizeof(unsigned);
 
         if (!os.write(reinterpret_cast<const char*>(&flags), sizeof(flags)))
         {
             BOOST_THROW_EXCEPTION(isaac::common::IoException(
-                errno, (boost::format("Failed to write: %d bytes into %s") % sizeof(flags) % common::pathStringToStdString(tempFilePaths_[nameCrc])).str()));
+                errno, (boost::format("Failed to write: %d bytes into %s") % sizeof(flags) % common::pathStringToStdString(tempFilePaths_[bucket])).str()));
         }
-        tempFileSizes_[nameCrc] += sizeof(flags);
+        tempFileSizes_[bucket] += sizeof(flags);
 
         if (!os.write(byteBuff.begin(), byteBuff.size()))
         {
             BOOST_THROW_EXCEPTION(isaac::common::IoException(
-                errno, (boost::format("Failed to write: %d bytes into %s") % byteBuff.size() % common::pathStringToStdString(tempFilePaths_[nameCrc])).str()));
+                errno, (boost::format("Failed to write: %d bytes into %s") % byteBuff.size() % common::pathStringToStdString(tempFilePaths_[bucket])).str()));
         }
-        tempFileSizes_[nameCrc] += byteBuff.size();
+        tempFileSizes_[bucket] += byteBuff.size();
 
         byteBuff.resize(readMetadata.getLength());
         bam::extractBcl(idx.getBlock(), byteBuff.begin(), readMetadata);
@@ -133,9 +135,9 @@ void UnpairedReadsCache::storeUnpaired(
         if (!os.write(&byteBuff.front(), byteBuff.size()))
         {
             BOOST_THROW_EXCEPTION(isaac::common::IoException(
-                errno, (boost::format("Failed to write: %d bytes into %s") % byteBuff.size() % common::pathStringToStdString(tempFilePaths_[nameCrc])).str()));
+                errno, (boost::format("Failed to write: %d bytes into %s") % byteBuff.size() % common::pathStringToStdString(tempFilePaths_[bucket])).str()));
         }
-        tempFileSizes_[nameCrc] += byteBuff.size();
+        tempFileSizes_[bucket] += byteBuff.size();
     }
 }
 
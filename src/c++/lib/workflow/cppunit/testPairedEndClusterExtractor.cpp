@@ -0,0 +1,223 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#include <cstring>
+
+#include "RegistryName.hh"
+#include "testPairedEndClusterExtractor.hh"
+
+#include "common/MemoryBudget.hh"
+#include "workflow/alignWorkflow/bamDataSource/PairedEndClusterExtractor.hh"
+
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( TestPairedEndClusterExtractor, registryName("PairedEndClusterExtractor"));
+
+using isaac::workflow::alignWorkflow::bamDataSource::PairedEndClusterExtractor;
+
+namespace
+{
+
+const unsigned PAIRS = 3000;
+const unsigned READ_LENGTH = 20;
+const unsigned NAME_LENGTH_MAX = 16;
+const unsigned PAIRING_THREADS = 3;
+// smallest bucket allowed
+const std::size_t BUCKET_BYTES = 1024UL * 1024UL * 64UL;
+// with BUCKET_BYTES per thread, requires 8 buckets
+const std::size_t BAM_FILE_LENGTH = BUCKET_BYTES * 4;
+
+void appendInt(std::string &s, const int value)
+{
+    for (unsigned i = 0; 4 != i; ++i)
+    {
+        s.push_back(char(unsigned(value) >> (i * 8)));
+    }
+}
+
+std::string makeName(const unsigned pair)
+{
+    char name[16];
+    sprintf(name, "pair%05u", pair);
+    return name;
+}
+
+/**
+ * \brief Unaligned read of a pair. All records have the same length so that the headers stay aligned
+ */
+std::string makeRecord(const unsigned pair, const bool readOne)
+{
+    const unsigned flag = 0x1 | 0x4 | (readOne ? 0x40 : 0x80) |
+        // some clusters fail the filter on one read only
+        (!readOne && !(pair % 5) ? 0x200 : 0);
+    const std::string name = makeName(pair);
+    std::string block;
+    // refID, pos
+    appendInt(block, -1);
+    appendInt(block, -1);
+    // bin_mq_nl
+    appendInt(block, (4680 << 16) | (name.size() + 1));
+    // flag_nc: no cigar
+    appendInt(block, flag << 16);
+    appendInt(block, READ_LENGTH);
+    // next_refID, next_pos, tlen
+    appendInt(block, -1);
+    appendInt(block, -1);
+    appendInt(block, 0);
+    block += name;
+    block.push_back('\0');
+    for (unsigned i = 0; READ_LENGTH / 2 != i; ++i)
+    {
+        const unsigned base = pair * 3 + i * 2 + readOne;
+        block.push_back(char(((1 << (base % 4)) << 4) | (1 << ((base + 1) % 4))));
+    }
+    for (unsigned i = 0; READ_LENGTH != i; ++i)
+    {
+        block.push_back(char(2 + (pair + i + readOne * 7) % 40));
+    }
+
+    std::string ret;
+    appendInt(ret, block.size());
+    return ret + block;
+}
+
+/**
+ * \brief Records of one read of every pair, so that nothing pairs while in the bam buffer
+ */
+std::vector<unsigned> makeBuffer(const bool readOne)
+{
+    std::string records;
+    for (unsigned pair = 0; PAIRS != pair; ++pair)
+    {
+        records += makeRecord(pair, readOne);
+    }
+    std::vector<unsigned> ret((records.size() + sizeof(unsigned) - 1) / sizeof(unsigned));
+    memcpy(&ret.front(), records.data(), records.size());
+    return ret;
+}
+
+std::vector<const isaac::bam::BamBlockHeader *> getBlocks(const std::vector<unsigned> &buffer)
+{
+    std::vector<const isaac::bam::BamBlockHeader *> ret;
+    const char *it = reinterpret_cast<const char *>(&buffer.front());
+    for (unsigned pair = 0; PAIRS != pair; ++pair)
+    {
+        ret.push_back(reinterpret_cast<const isaac::bam::BamBlockHeader *>(it));
+        // block_size does not count itself
+        it += sizeof(int32_t) + ret.back()->blockLength();
+    }
+    return ret;
+}
+
+void appendBuffer(
+    PairedEndClusterExtractor &extractor,
+    const std::vector<unsigned> &buffer,
+    const isaac::flowcell::ReadMetadataList &readMetadataList,
+    unsigned &clusterCount,
+    std::vector<char>::iterator &clusterIt,
+    std::vector<bool>::iterator &pfIt)
+{
+    const std::vector<const isaac::bam::BamBlockHeader *> blocks = getBlocks(buffer);
+    for (unsigned i = 0; blocks.size() != i; ++i)
+    {
+        extractor.append(*blocks[i], blocks.size() == i + 1, NAME_LENGTH_MAX, clusterCount, readMetadataList, clusterIt, pfIt);
+    }
+    const char *begin = reinterpret_cast<const char *>(&buffer.front());
+    extractor.removeOld(begin, begin + buffer.size() * sizeof(unsigned), readMetadataList);
+}
+
+} // namespace
+
+void TestPairedEndClusterExtractor::setUp()
+{
+    tempDir_ = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tempDir_);
+}
+
+void TestPairedEndClusterExtractor::tearDown()
+{
+    boost::filesystem::remove_all(tempDir_);
+}
+
+void TestPairedEndClusterExtractor::testPairAcrossBuckets()
+{
+    const isaac::flowcell::ReadMetadataList readMetadataList =
+        {isaac::flowcell::ReadMetadata(1, READ_LENGTH, 0, 0),
+         isaac::flowcell::ReadMetadata(READ_LENGTH + 1, READ_LENGTH * 2, 1, READ_LENGTH)};
+    const unsigned clusterLength = READ_LENGTH * 2 + NAME_LENGTH_MAX;
+    const std::vector<unsigned> r1Buffer = makeBuffer(true);
+    const std::vector<unsigned> r2Buffer = makeBuffer(false);
+
+    isaac::common::MemoryBudget &budget = isaac::common::MemoryBudget::instance();
+    const uint64_t reservedBefore = budget.getReserved(isaac::common::MemoryBudget::UnpairedReads);
+
+    std::vector<char> clusters(PAIRS * clusterLength);
+    std::vector<bool> pf(PAIRS);
+    {
+        isaac::common::ThreadVector threads(PAIRING_THREADS);
+        PairedEndClusterExtractor extractor(
+            tempDir_, BAM_FILE_LENGTH, 10, NAME_LENGTH_MAX, READ_LENGTH, true, PAIRS,
+            BUCKET_BYTES * PAIRING_THREADS, threads, PAIRING_THREADS);
+        extractor.open("FC1");
+
+        std::vector<char>::iterator clusterIt = clusters.begin();
+        std::vector<bool>::iterator pfIt = pf.begin();
+        unsigned clusterCount = PAIRS;
+        appendBuffer(extractor, r1Buffer, readMetadataList, clusterCount, clusterIt, pfIt);
+        appendBuffer(extractor, r2Buffer, readMetadataList, clusterCount, clusterIt, pfIt);
+        CPPUNIT_ASSERT_EQUAL(PAIRS, clusterCount);
+        CPPUNIT_ASSERT(extractor.isEmpty());
+
+        extractor.startExtractingUnpaired();
+        CPPUNIT_ASSERT(extractor.extractingUnpaired());
+        unsigned buckets = 0;
+        unsigned nonEmptyBuckets = 0;
+        for (boost::filesystem::directory_iterator it(tempDir_), end; end != it; ++it)
+        {
+            ++buckets;
+            nonEmptyBuckets += !!boost::filesystem::file_size(it->path());
+        }
+        CPPUNIT_ASSERT_EQUAL(8U, buckets);
+        CPPUNIT_ASSERT(PAIRING_THREADS < nonEmptyBuckets);
+
+        // all threads together stay within the budget and have it reserved
+        CPPUNIT_ASSERT_EQUAL(reservedBefore + BUCKET_BYTES * PAIRING_THREADS,
+                             budget.getReserved(isaac::common::MemoryBudget::UnpairedReads));
+
+        // output buffer filling up in the middle of a bucket must not lose or repeat clusters
+        CPPUNIT_ASSERT_EQUAL(0U, extractor.extractUnpaired(READ_LENGTH, READ_LENGTH, NAME_LENGTH_MAX, PAIRS / 3, clusterIt, pfIt));
+        CPPUNIT_ASSERT_EQUAL(1U, extractor.extractUnpaired(READ_LENGTH, READ_LENGTH, NAME_LENGTH_MAX, PAIRS - PAIRS / 3 + 1, clusterIt, pfIt));
+        CPPUNIT_ASSERT(clusters.end() == clusterIt);
+        CPPUNIT_ASSERT(pf.end() == pfIt);
+    }
+    CPPUNIT_ASSERT_EQUAL(reservedBefore, budget.getReserved(isaac::common::MemoryBudget::UnpairedReads));
+    // cleanup removes the buckets
+    CPPUNIT_ASSERT(boost::filesystem::directory_iterator(tempDir_) == boost::filesystem::directory_iterator());
+
+    const std::vector<const isaac::bam::BamBlockHeader *> r1Blocks = getBlocks(r1Buffer);
+    const std::vector<const isaac::bam::BamBlockHeader *> r2Blocks = getBlocks(r2Buffer);
+    std::vector<bool> seen(PAIRS, false);
+    for (unsigned cluster = 0; PAIRS != cluster; ++cluster)
+    {
+        const std::vector<char>::const_iterator clusterBegin = clusters.begin() + cluster * clusterLength;
+        const std::string name(clusterBegin + READ_LENGTH * 2, clusterBegin + clusterLength);
+        const unsigned pair = std::stoi(name.substr(4));
+        CPPUNIT_ASSERT_EQUAL(makeName(pair) + std::string(NAME_LENGTH_MAX - makeName(pair).size(), '\0'), name);
+        CPPUNIT_ASSERT_MESSAGE(name, !seen[pair]);
+        seen[pair] = true;
+
+        std::vector<char> expected(READ_LENGTH * 2);
+        isaac::bam::extractBcl(*r1Blocks[pair], expected.begin(), readMetadataList[0]);
+        isaac::bam::extractBcl(*r2Blocks[pair], expected.begin() + READ_LENGTH, readMetadataList[1]);
+        CPPUNIT_ASSERT_MESSAGE(name, std::equal(expected.begin(), expected.end(), clusterBegin));
+        CPPUNIT_ASSERT_EQUAL(bool(pair % 5), bool(pf[cluster]));
+    }
+}
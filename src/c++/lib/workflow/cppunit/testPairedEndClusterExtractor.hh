@@ -0,0 +1,34 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **/
+
+#ifndef iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
+#define iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <boost/filesystem.hpp>
+
+class TestPairedEndClusterExtractor : public CppUnit::TestFixture
+{
+    CPPUNIT_TEST_SUITE( TestPairedEndClusterExtractor );
+    CPPUNIT_TEST( testPairAcrossBuckets );
+    CPPUNIT_TEST_SUITE_END();
+private:
+    boost::filesystem::path tempDir_;
+public:
+    void setUp();
+    void tearDown();
+    void testPairAcrossBuckets();
+};
+
+#endif // #ifndef iSAAC_WORKFLOW_TEST_PAIRED_END_CLUSTER_EXTRACTOR_HH
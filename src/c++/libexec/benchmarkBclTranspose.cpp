@@ -0,0 +1,108 @@
+/**
+ ** Isaac Genome Alignment Software
+ ** Copyright (c) 2010-2017 Illumina, Inc.
+ ** All rights reserved.
+ **
+ ** This software is provided under the terms and conditions of the
+ ** GNU GENERAL PUBLIC LICENSE Version 3
+ **
+ ** You should have received a copy of the GNU GENERAL PUBLIC LICENSE Version 3
+ ** along with this program. If not, see
+ ** <https://github.com/illumina/licenses/>.
+ **
+ ** \file benchmarkBclTranspose.cpp
+ **
+ ** Times the conversion of a cycle-major bcl tile into cluster-major layout with byte by byte copying and with
+ ** the tiled transpose used by ParallelBclMapper.
+ **
+ ** \author Roman Petrovski
+ **/
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <boost/format.hpp>
+
+#include "common/Memory.hh"
+#include "common/TaskScheduler.hh"
+#include "common/Threads.hpp"
+#include "options/BenchmarkBclTransposeOptions.hh"
+#include "rta/BclTranspose.hh"
+
+void benchmarkBclTranspose(const isaac::options::BenchmarkBclTransposeOptions &options);
+
+int main(int argc, char *argv[])
+{
+    isaac::common::run(benchmarkBclTranspose, argc, argv);
+}
+
+typedef void (*TransposeFunction)(const char *, const std::size_t, const unsigned,
+                                  const std::size_t, const std::size_t, char *, const std::size_t);
+
+/**
+ * \brief Splits the tile between tasks the same way ParallelBclMapper::transpose does and returns the best
+ *        time in seconds
+ */
+static double timeTranspose(
+    const isaac::options::BenchmarkBclTransposeOptions &options,
+    isaac::common::TaskScheduler &scheduler,
+    const TransposeFunction transpose,
+    const std::vector<char> &tile,
+    const std::size_t cycleStride,
+    std::vector<char> &clusters)
+{
+    double best = 0.0;
+    for (unsigned r = 0; options.repeat != r; ++r)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::size_t blocks =
+            (options.clusters + isaac::rta::TRANSPOSE_BLOCK_CLUSTERS - 1) / isaac::rta::TRANSPOSE_BLOCK_CLUSTERS;
+        scheduler.parallelFor(
+            0, blocks, std::max<std::size_t>(1, (blocks + scheduler.getWorkers() - 1) / scheduler.getWorkers()),
+            [&](const std::size_t blockBegin, const std::size_t blockEnd)
+            {
+                const std::size_t clusterBegin = blockBegin * isaac::rta::TRANSPOSE_BLOCK_CLUSTERS;
+                const std::size_t clusterEnd =
+                    std::min<std::size_t>(options.clusters, blockEnd * isaac::rta::TRANSPOSE_BLOCK_CLUSTERS);
+                transpose(&tile.front(), cycleStride, options.cycles, clusterBegin, clusterEnd,
+                          &clusters.front(), options.cycles);
+            });
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = r ? std::min(best, seconds) : seconds;
+    }
+    return best;
+}
+
+void benchmarkBclTranspose(const isaac::options::BenchmarkBclTransposeOptions &options)
+{
+    // same layout as BclMapper: page-padded cycles, each starting with the 4-byte cluster count
+    const std::size_t cycleStride = isaac::common::pageRoundUp(sizeof(uint32_t) + options.clusters);
+    std::vector<char> tile(cycleStride * options.cycles);
+    std::srand(0);
+    for (char &bcl : tile)
+    {
+        bcl = std::rand();
+    }
+    const std::vector<char> cycleData(tile.begin() + sizeof(uint32_t), tile.end());
+
+    std::vector<char> expected(std::size_t(options.clusters) * options.cycles);
+    std::vector<char> actual(expected.size());
+    isaac::common::TaskScheduler scheduler(options.jobs);
+
+    const double strided = timeTranspose(
+        options, scheduler, isaac::rta::transposeBclStrided, cycleData, cycleStride, expected);
+    const double tiled = timeTranspose(
+        options, scheduler, isaac::rta::transposeBcl, cycleData, cycleStride, actual);
+
+    const double megabytes = double(expected.size()) / 1024 / 1024;
+    std::cout << boost::format("%d clusters, %d cycles, %d threads\n") % options.clusters % options.cycles % options.jobs;
+    std::cout << boost::format("strided: %.3fs %.1fMB/s\n") % strided % (megabytes / strided);
+    std::cout << boost::format("tiled:   %.3fs %.1fMB/s %.2fx\n") % tiled % (megabytes / tiled) % (strided / tiled);
+    if (expected != actual)
+    {
+        BOOST_THROW_EXCEPTION(isaac::common::PostConditionException("Tiled transpose result differs from strided"));
+    }
+}
@@ -60,6 +60,8 @@ CHECK_INCLUDE_FILE(fcntl.h HAVE_FCNTL_H)
 CHECK_INCLUDE_FILE(linux/falloc.h HAVE_LINUX_FALLOC_H)
 CHECK_INCLUDE_FILE(sys/ioctl.h HAVE_SYS_IOCTL_H)
 check_function_exists(fallocate HAVE_FALLOCATE)
+# optional linux-specific write-behind for temporary files
+check_function_exists(sync_file_range HAVE_SYNC_FILE_RANGE)
 
 # Math functions that might be missing in some flavors of c++
 set (CMAKE_REQUIRED_LIBRARIES m)